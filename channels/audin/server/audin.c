@@ -461,8 +461,9 @@ static BOOL audin_server_open(audin_server_context* context)
 			WTSFreeMemory(pSessionId);
 		}
 
-		audin->audin_channel = WTSVirtualChannelOpenEx(audin->SessionId, AUDIN_DVC_CHANNEL_NAME,
-		                                               WTS_CHANNEL_OPTION_DYNAMIC);
+		const DWORD flags = WTS_CHANNEL_OPTION_DYNAMIC | WTS_CHANNEL_OPTION_DYNAMIC_PRI_HIGH;
+		audin->audin_channel =
+		    WTSVirtualChannelOpenEx(audin->SessionId, AUDIN_DVC_CHANNEL_NAME, flags);
 
 		if (!audin->audin_channel)
 		{
@@ -33,12 +33,17 @@
 
 #define TAG CHANNELS_TAG("drdynvc.client")
 
+/* channel PDUs handed to the main thread at a time, the rest waits in the scheduler so a
+ * higher priority channel can overtake a bulk transfer */
+#define DRDYNVC_MAX_IN_FLIGHT 8
+
 static void dvcman_channel_free(DVCMAN_CHANNEL* channel);
 static UINT dvcman_channel_close(DVCMAN_CHANNEL* channel, BOOL perRequest, BOOL fromHashTableFn);
 static void dvcman_free(drdynvcPlugin* drdynvc, IWTSVirtualChannelManager* pChannelMgr);
-static UINT drdynvc_write_data(drdynvcPlugin* drdynvc, UINT32 ChannelId, const BYTE* data,
-                               UINT32 dataSize, BOOL* close);
+static UINT drdynvc_write_data(drdynvcPlugin* drdynvc, DVCMAN_CHANNEL* channel,
+                               const BYTE* data, UINT32 dataSize, BOOL* close);
 static UINT drdynvc_send(drdynvcPlugin* drdynvc, wStream* s);
+static UINT drdynvc_schedule(drdynvcPlugin* drdynvc, UINT32 ChannelId, BYTE priority, wStream* s);
 
 static void dvcman_wtslistener_free(DVCMAN_LISTENER* listener)
 {
@@ -291,6 +296,12 @@ static IWTSVirtualChannelManager* dvcman_new(drdynvcPlugin* plugin)
 	if (!dvcman)
 		return NULL;
 
+	if (!InitializeCriticalSectionEx(&dvcman->sendLock, 0, 0))
+	{
+		free(dvcman);
+		return NULL;
+	}
+
 	dvcman->iface.CreateListener = dvcman_create_listener;
 	dvcman->iface.DestroyListener = dvcman_destroy_listener;
 	dvcman->iface.FindChannelById = dvcman_find_channel_by_id;
@@ -315,6 +326,10 @@ static IWTSVirtualChannelManager* dvcman_new(drdynvcPlugin* plugin)
 	if (!dvcman->pool)
 		goto fail;
 
+	dvcman->scheduler = dvc_scheduler_new(Stream_Release);
+	if (!dvcman->scheduler)
+		goto fail;
+
 	dvcman->listeners = HashTable_New(TRUE);
 	if (!dvcman->listeners)
 		goto fail;
@@ -389,6 +404,8 @@ static void dvcman_channel_free(DVCMAN_CHANNEL* channel)
 	if (channel->dvc_data)
 		Stream_Release(channel->dvc_data);
 
+	zgfx_context_free(channel->compressor);
+	zgfx_context_free(channel->decompressor);
 	DeleteCriticalSection(&(channel->lock));
 	free(channel->channel_name);
 	free(channel);
@@ -420,7 +437,7 @@ static UINT dvcchannel_send_close(DVCMAN_CHANNEL* channel)
 
 	Stream_Write_UINT8(s, (CLOSE_REQUEST_PDU << 4) | 0x02);
 	Stream_Write_UINT32(s, channel->channel_id);
-	return drdynvc_send(drdynvc, s);
+	return drdynvc_schedule(drdynvc, channel->channel_id, channel->priority, s);
 }
 
 static void check_open_close_receive(DVCMAN_CHANNEL* channel)
@@ -553,6 +570,12 @@ static void dvcman_clear(drdynvcPlugin* drdynvc, IWTSVirtualChannelManager* pCha
 	WINPR_UNUSED(drdynvc);
 
 	HashTable_Clear(dvcman->channelsById);
+
+	EnterCriticalSection(&dvcman->sendLock);
+	dvc_scheduler_clear(dvcman->scheduler);
+	dvcman->inFlight = 0;
+	LeaveCriticalSection(&dvcman->sendLock);
+
 	ArrayList_Clear(dvcman->plugins);
 	ArrayList_Clear(dvcman->plugin_names);
 	HashTable_Clear(dvcman->listeners);
@@ -569,7 +592,9 @@ static void dvcman_free(drdynvcPlugin* drdynvc, IWTSVirtualChannelManager* pChan
 	ArrayList_Free(dvcman->plugin_names);
 	HashTable_Free(dvcman->listeners);
 
+	dvc_scheduler_free(dvcman->scheduler);
 	StreamPool_Free(dvcman->pool);
+	DeleteCriticalSection(&dvcman->sendLock);
 	free(dvcman);
 }
 
@@ -620,8 +645,7 @@ static UINT dvcman_write_channel(IWTSVirtualChannel* pChannel, ULONG cbSize, con
 		return CHANNEL_RC_BAD_CHANNEL;
 
 	EnterCriticalSection(&(channel->lock));
-	status =
-	    drdynvc_write_data(channel->dvcman->drdynvc, channel->channel_id, pBuffer, cbSize, &close);
+	status = drdynvc_write_data(channel->dvcman->drdynvc, channel, pBuffer, cbSize, &close);
 	LeaveCriticalSection(&(channel->lock));
 	/* Close delayed, it removes the channel struct */
 	if (close)
@@ -888,6 +912,15 @@ static UINT8 drdynvc_write_variable_uint(wStream* s, UINT32 val)
 	return cb;
 }
 
+static size_t drdynvc_variable_uint_length(UINT32 val)
+{
+	if (val <= 0xFF)
+		return 1;
+	if (val <= 0xFFFF)
+		return 2;
+	return 4;
+}
+
 /**
  * Function description
  *
@@ -910,7 +943,15 @@ static UINT drdynvc_send(drdynvcPlugin* drdynvc, wStream* s)
 	switch (status)
 	{
 		case CHANNEL_RC_OK:
+		{
+			DVCMAN* dvcman = (DVCMAN*)drdynvc->channel_mgr;
+			WINPR_ASSERT(dvcman);
+
+			EnterCriticalSection(&dvcman->sendLock);
+			dvcman->inFlight++;
+			LeaveCriticalSection(&dvcman->sendLock);
 			return CHANNEL_RC_OK;
+		}
 
 		case CHANNEL_RC_NOT_CONNECTED:
 			Stream_Release(s);
@@ -935,26 +976,102 @@ static UINT drdynvc_send(drdynvcPlugin* drdynvc, wStream* s)
  *
  * @return 0 on success, otherwise a Win32 error code
  */
-static UINT drdynvc_write_data(drdynvcPlugin* drdynvc, UINT32 ChannelId, const BYTE* data,
-                               UINT32 dataSize, BOOL* close)
+static UINT drdynvc_pump(drdynvcPlugin* drdynvc)
 {
-	wStream* data_out = NULL;
-	size_t pos = 0;
-	UINT8 cbChId = 0;
-	UINT8 cbLen = 0;
-	unsigned long chunkLength = 0;
-	UINT status = CHANNEL_RC_BAD_INIT_HANDLE;
-	DVCMAN* dvcman = NULL;
+	UINT status = CHANNEL_RC_OK;
 
-	if (!drdynvc)
-		return CHANNEL_RC_BAD_CHANNEL_HANDLE;
+	WINPR_ASSERT(drdynvc);
+	DVCMAN* dvcman = (DVCMAN*)drdynvc->channel_mgr;
+	WINPR_ASSERT(dvcman);
 
-	dvcman = (DVCMAN*)drdynvc->channel_mgr;
+	EnterCriticalSection(&dvcman->sendLock);
+	while ((status == CHANNEL_RC_OK) && (dvcman->inFlight < DRDYNVC_MAX_IN_FLIGHT))
+	{
+		wStream* s = dvc_scheduler_dequeue(dvcman->scheduler);
+		if (!s)
+			break;
+
+		status = drdynvc_send(drdynvc, s);
+	}
+	LeaveCriticalSection(&dvcman->sendLock);
+	return status;
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT drdynvc_schedule(drdynvcPlugin* drdynvc, UINT32 ChannelId, BYTE priority, wStream* s)
+{
+	WINPR_ASSERT(drdynvc);
+	DVCMAN* dvcman = (DVCMAN*)drdynvc->channel_mgr;
 	WINPR_ASSERT(dvcman);
 
-	WLog_Print(drdynvc->log, WLOG_TRACE, "write_data: ChannelId=%" PRIu32 " size=%" PRIu32 "",
-	           ChannelId, dataSize);
-	data_out = StreamPool_Take(dvcman->pool, CHANNEL_CHUNK_LENGTH);
+	if (!dvc_scheduler_enqueue(dvcman->scheduler, ChannelId, priority, s))
+	{
+		WLog_Print(drdynvc->log, WLOG_ERROR, "dvc_scheduler_enqueue failed!");
+		return CHANNEL_RC_NO_MEMORY;
+	}
+
+	return drdynvc_pump(drdynvc);
+}
+
+static void drdynvc_write_completed(drdynvcPlugin* drdynvc)
+{
+	WINPR_ASSERT(drdynvc);
+	DVCMAN* dvcman = (DVCMAN*)drdynvc->channel_mgr;
+	if (!dvcman)
+		return;
+
+	EnterCriticalSection(&dvcman->sendLock);
+	if (dvcman->inFlight > 0)
+		dvcman->inFlight--;
+	LeaveCriticalSection(&dvcman->sendLock);
+
+	const UINT status = drdynvc_pump(drdynvc);
+	if ((status != CHANNEL_RC_OK) && drdynvc->rdpcontext)
+		setChannelError(drdynvc->rdpcontext, status, "drdynvc_pump reported an error");
+}
+
+static void drdynvc_log_scheduler_stats(drdynvcPlugin* drdynvc)
+{
+	WINPR_ASSERT(drdynvc);
+	DVCMAN* dvcman = (DVCMAN*)drdynvc->channel_mgr;
+	if (!dvcman)
+		return;
+
+	for (BYTE x = 0; x < DVC_PRIORITY_CLASSES; x++)
+	{
+		DVC_SCHEDULER_STATS stats = { 0 };
+		if (!dvc_scheduler_get_stats(dvcman->scheduler, x, &stats) || (stats.SentChunks == 0))
+			continue;
+
+		WLog_Print(drdynvc->log, WLOG_DEBUG,
+		           "priority %" PRIu8 ": sent %" PRIu64 " PDUs, %" PRIu64
+		           " bytes, max queued %" PRIuz " bytes, wait avg %" PRIu64 "us max %" PRIu64 "us",
+		           x, stats.SentChunks, stats.SentBytes, stats.MaxQueuedBytes,
+		           stats.TotalWaitUs / stats.SentChunks, stats.MaxWaitUs);
+	}
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT drdynvc_write_chunk(drdynvcPlugin* drdynvc, DVCMAN_CHANNEL* channel, BOOL first,
+                                UINT32 totalLength, const BYTE* data, UINT32 chunkLength)
+{
+	UINT8 cbLen = 0;
+	BYTE cmd = first ? DATA_FIRST_PDU : DATA_PDU;
+
+	WINPR_ASSERT(drdynvc);
+	WINPR_ASSERT(channel);
+	DVCMAN* dvcman = (DVCMAN*)drdynvc->channel_mgr;
+	WINPR_ASSERT(dvcman);
+
+	wStream* data_out = StreamPool_Take(dvcman->pool, CHANNEL_CHUNK_LENGTH);
 
 	if (!data_out)
 	{
@@ -963,62 +1080,77 @@ static UINT drdynvc_write_data(drdynvcPlugin* drdynvc, UINT32 ChannelId, const B
 	}
 
 	Stream_SetPosition(data_out, 1);
-	cbChId = drdynvc_write_variable_uint(data_out, ChannelId);
-	pos = Stream_GetPosition(data_out);
+	const UINT8 cbChId = drdynvc_write_variable_uint(data_out, channel->channel_id);
+
+	if (first)
+		cbLen = drdynvc_write_variable_uint(data_out, totalLength);
+
+	if (channel->compressor)
+	{
+		cmd = first ? DATA_FIRST_COMPRESSED_PDU : DATA_COMPRESSED_PDU;
+
+		if (!zgfx_compress_bulk(channel->compressor, data, chunkLength, data_out))
+		{
+			WLog_Print(drdynvc->log, WLOG_ERROR, "zgfx_compress_bulk failed!");
+			Stream_Release(data_out);
+			return ERROR_INTERNAL_ERROR;
+		}
+	}
+	else
+		Stream_Write(data_out, data, chunkLength);
+
+	Stream_Buffer(data_out)[0] = (BYTE)((cmd << 4) | cbChId | (cbLen << 2));
+	return drdynvc_schedule(drdynvc, channel->channel_id, channel->priority, data_out);
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT drdynvc_write_data(drdynvcPlugin* drdynvc, DVCMAN_CHANNEL* channel,
+                               const BYTE* data, UINT32 dataSize, BOOL* close)
+{
+	size_t pos = 0;
+	UINT32 chunkLength = 0;
+	UINT status = CHANNEL_RC_OK;
+
+	if (!drdynvc)
+		return CHANNEL_RC_BAD_CHANNEL_HANDLE;
+
+	WINPR_ASSERT(channel);
+	WLog_Print(drdynvc->log, WLOG_TRACE, "write_data: ChannelId=%" PRIu32 " size=%" PRIu32 "",
+	           channel->channel_id, dataSize);
 
 	if (dataSize == 0)
 	{
 		/* TODO: shall treat that case with write(0) that do a close */
 		*close = TRUE;
-		Stream_Release(data_out);
-	}
-	else if (dataSize <= CHANNEL_CHUNK_LENGTH - pos)
-	{
-		Stream_SetPosition(data_out, 0);
-		Stream_Write_UINT8(data_out, (DATA_PDU << 4) | cbChId);
-		Stream_SetPosition(data_out, pos);
-		Stream_Write(data_out, data, dataSize);
-		status = drdynvc_send(drdynvc, data_out);
+		return CHANNEL_RC_OK;
 	}
+
+	/* Cmd byte and ChannelId, a compressed chunk needs one more byte if it is sent raw */
+	pos = 1 + drdynvc_variable_uint_length(channel->channel_id);
+	if (channel->compressor)
+		pos++;
+
+	if (dataSize <= CHANNEL_CHUNK_LENGTH - pos)
+		status = drdynvc_write_chunk(drdynvc, channel, FALSE, 0, data, dataSize);
 	else
 	{
 		/* Fragment the data */
-		cbLen = drdynvc_write_variable_uint(data_out, dataSize);
-		pos = Stream_GetPosition(data_out);
-		Stream_SetPosition(data_out, 0);
-		Stream_Write_UINT8(data_out, (DATA_FIRST_PDU << 4) | cbChId | (cbLen << 2));
-		Stream_SetPosition(data_out, pos);
-		chunkLength = CHANNEL_CHUNK_LENGTH - pos;
-		Stream_Write(data_out, data, chunkLength);
+		const size_t first = pos + drdynvc_variable_uint_length(dataSize);
+		chunkLength = (UINT32)(CHANNEL_CHUNK_LENGTH - first);
+		status = drdynvc_write_chunk(drdynvc, channel, TRUE, dataSize, data, chunkLength);
 		data += chunkLength;
 		dataSize -= chunkLength;
-		status = drdynvc_send(drdynvc, data_out);
 
 		while (status == CHANNEL_RC_OK && dataSize > 0)
 		{
-			data_out = StreamPool_Take(dvcman->pool, CHANNEL_CHUNK_LENGTH);
-
-			if (!data_out)
-			{
-				WLog_Print(drdynvc->log, WLOG_ERROR, "StreamPool_Take failed!");
-				return CHANNEL_RC_NO_MEMORY;
-			}
-
-			Stream_SetPosition(data_out, 1);
-			cbChId = drdynvc_write_variable_uint(data_out, ChannelId);
-			pos = Stream_GetPosition(data_out);
-			Stream_SetPosition(data_out, 0);
-			Stream_Write_UINT8(data_out, (DATA_PDU << 4) | cbChId);
-			Stream_SetPosition(data_out, pos);
-			chunkLength = dataSize;
-
-			if (chunkLength > CHANNEL_CHUNK_LENGTH - pos)
-				chunkLength = CHANNEL_CHUNK_LENGTH - pos;
-
-			Stream_Write(data_out, data, chunkLength);
+			chunkLength = MIN(dataSize, (UINT32)(CHANNEL_CHUNK_LENGTH - pos));
+			status = drdynvc_write_chunk(drdynvc, channel, FALSE, 0, data, chunkLength);
 			data += chunkLength;
 			dataSize -= chunkLength;
-			status = drdynvc_send(drdynvc, data_out);
 		}
 	}
 
@@ -1103,6 +1235,14 @@ static UINT drdynvc_process_capability_request(drdynvcPlugin* drdynvc, int Sp, i
 		Stream_Read_UINT16(s, drdynvc->PriorityCharge1);
 		Stream_Read_UINT16(s, drdynvc->PriorityCharge2);
 		Stream_Read_UINT16(s, drdynvc->PriorityCharge3);
+
+		const UINT16 charges[] = { (UINT16)drdynvc->PriorityCharge0,
+			                       (UINT16)drdynvc->PriorityCharge1,
+			                       (UINT16)drdynvc->PriorityCharge2,
+			                       (UINT16)drdynvc->PriorityCharge3 };
+		DVCMAN* dvcman = (DVCMAN*)drdynvc->channel_mgr;
+		WINPR_ASSERT(dvcman);
+		dvc_scheduler_set_priority_charges(dvcman->scheduler, charges, ARRAYSIZE(charges));
 	}
 
 	status = drdynvc_send_capability_response(drdynvc);
@@ -1147,6 +1287,31 @@ static UINT32 drdynvc_read_variable_uint(wStream* s, int cbLen)
 	return val;
 }
 
+/* Compress what we send on channels listed in FreeRDP_DynamicChannelCompression */
+static void drdynvc_channel_setup_compression(drdynvcPlugin* drdynvc, DVCMAN_CHANNEL* channel)
+{
+	WINPR_ASSERT(drdynvc);
+	WINPR_ASSERT(channel);
+
+	if ((drdynvc->version < 3) || !drdynvc->rdpcontext)
+		return;
+
+	const char* list = freerdp_settings_get_string(drdynvc->rdpcontext->settings,
+	                                               FreeRDP_DynamicChannelCompression);
+	if (!drdynvc_channel_name_in_list(list, channel->channel_name))
+		return;
+
+	channel->compressor = zgfx_context_new_lite(TRUE);
+	if (!channel->compressor)
+	{
+		WLog_Print(drdynvc->log, WLOG_WARN, "%s: no memory for compression, sending raw",
+		           channel->channel_name);
+		return;
+	}
+
+	WLog_Print(drdynvc->log, WLOG_DEBUG, "compressing data sent on %s", channel->channel_name);
+}
+
 /**
  * Function description
  *
@@ -1161,7 +1326,6 @@ static UINT drdynvc_process_create_request(drdynvcPlugin* drdynvc, int Sp, int c
 	DVCMAN_CHANNEL* channel = NULL;
 	UINT32 retStatus = 0;
 
-	WINPR_UNUSED(Sp);
 	if (!drdynvc)
 		return CHANNEL_RC_BAD_CHANNEL_HANDLE;
 
@@ -1217,6 +1381,9 @@ static UINT drdynvc_process_create_request(drdynvcPlugin* drdynvc, int Sp, int c
 	{
 		case CHANNEL_RC_OK:
 			WLog_Print(drdynvc->log, WLOG_DEBUG, "channel created");
+			/* The Pri field of the request, only meaningful from version 2 on */
+			channel->priority = (drdynvc->version >= 2) ? (BYTE)Sp : 0;
+			drdynvc_channel_setup_compression(drdynvc, channel);
 			retStatus = 0;
 			break;
 		case CHANNEL_RC_NO_MEMORY:
@@ -1256,13 +1423,65 @@ static UINT drdynvc_process_create_request(drdynvcPlugin* drdynvc, int Sp, int c
 	return status;
 }
 
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT drdynvc_receive_channel_data(drdynvcPlugin* drdynvc, DVCMAN_CHANNEL* channel,
+                                         wStream* s, BOOL compressed, UINT32 ThreadingFlags)
+{
+	WINPR_ASSERT(drdynvc);
+	WINPR_ASSERT(channel);
+
+	if (!compressed)
+		return dvcman_receive_channel_data(channel, s, ThreadingFlags);
+
+	if (drdynvc->version < 3)
+	{
+		WLog_Print(drdynvc->log, WLOG_ERROR, "compressed data requires version 3");
+		return ERROR_INVALID_DATA;
+	}
+
+	if (!channel->decompressor)
+	{
+		channel->decompressor = zgfx_context_new_lite(FALSE);
+		if (!channel->decompressor)
+			return CHANNEL_RC_NO_MEMORY;
+	}
+
+	DVCMAN* dvcman = (DVCMAN*)drdynvc->channel_mgr;
+	WINPR_ASSERT(dvcman);
+
+	wStream* data = StreamPool_Take(dvcman->pool, CHANNEL_CHUNK_LENGTH);
+	if (!data)
+	{
+		WLog_Print(drdynvc->log, WLOG_ERROR, "StreamPool_Take failed!");
+		return CHANNEL_RC_NO_MEMORY;
+	}
+
+	UINT status = ERROR_INVALID_DATA;
+	if (zgfx_decompress_bulk(channel->decompressor, Stream_ConstPointer(s),
+	                         (UINT32)Stream_GetRemainingLength(s), data))
+	{
+		Stream_SealLength(data);
+		Stream_SetPosition(data, 0);
+		status = dvcman_receive_channel_data(channel, data, ThreadingFlags);
+	}
+	else
+		WLog_Print(drdynvc->log, WLOG_ERROR, "zgfx_decompress_bulk failed!");
+
+	Stream_Release(data);
+	return status;
+}
+
 /**
  * Function description
  *
  * @return 0 on success, otherwise a Win32 error code
  */
 static UINT drdynvc_process_data_first(drdynvcPlugin* drdynvc, int Sp, int cbChId, wStream* s,
-                                       UINT32 ThreadingFlags)
+                                       BOOL compressed, UINT32 ThreadingFlags)
 {
 	UINT status = CHANNEL_RC_OK;
 	UINT32 Length = 0;
@@ -1298,7 +1517,7 @@ static UINT drdynvc_process_data_first(drdynvcPlugin* drdynvc, int Sp, int cbChI
 	status = dvcman_receive_channel_data_first(channel, Length);
 
 	if (status == CHANNEL_RC_OK)
-		status = dvcman_receive_channel_data(channel, s, ThreadingFlags);
+		status = drdynvc_receive_channel_data(drdynvc, channel, s, compressed, ThreadingFlags);
 
 	if (status != CHANNEL_RC_OK)
 		status = dvcman_channel_close(channel, FALSE, FALSE);
@@ -1314,7 +1533,7 @@ out:
  * @return 0 on success, otherwise a Win32 error code
  */
 static UINT drdynvc_process_data(drdynvcPlugin* drdynvc, int Sp, int cbChId, wStream* s,
-                                 UINT32 ThreadingFlags)
+                                 BOOL compressed, UINT32 ThreadingFlags)
 {
 	UINT32 ChannelId = 0;
 	DVCMAN_CHANNEL* channel = NULL;
@@ -1343,7 +1562,7 @@ static UINT drdynvc_process_data(drdynvcPlugin* drdynvc, int Sp, int cbChId, wSt
 	if (channel->state != DVC_CHANNEL_RUNNING)
 		goto out;
 
-	status = dvcman_receive_channel_data(channel, s, ThreadingFlags);
+	status = drdynvc_receive_channel_data(drdynvc, channel, s, compressed, ThreadingFlags);
 	if (status != CHANNEL_RC_OK)
 		status = dvcman_channel_close(channel, FALSE, FALSE);
 
@@ -1413,10 +1632,16 @@ static UINT drdynvc_order_recv(drdynvcPlugin* drdynvc, wStream* s, UINT32 Thread
 			return drdynvc_process_create_request(drdynvc, Sp, cbChId, s);
 
 		case DATA_FIRST_PDU:
-			return drdynvc_process_data_first(drdynvc, Sp, cbChId, s, ThreadingFlags);
+			return drdynvc_process_data_first(drdynvc, Sp, cbChId, s, FALSE, ThreadingFlags);
 
 		case DATA_PDU:
-			return drdynvc_process_data(drdynvc, Sp, cbChId, s, ThreadingFlags);
+			return drdynvc_process_data(drdynvc, Sp, cbChId, s, FALSE, ThreadingFlags);
+
+		case DATA_FIRST_COMPRESSED_PDU:
+			return drdynvc_process_data_first(drdynvc, Sp, cbChId, s, TRUE, ThreadingFlags);
+
+		case DATA_COMPRESSED_PDU:
+			return drdynvc_process_data(drdynvc, Sp, cbChId, s, TRUE, ThreadingFlags);
 
 		case CLOSE_REQUEST_PDU:
 			return drdynvc_process_close_request(drdynvc, Sp, cbChId, s);
@@ -1538,6 +1763,7 @@ static void VCAPITYPE drdynvc_virtual_channel_open_event_ex(LPVOID lpUserParam,
 		{
 			wStream* s = (wStream*)pData;
 			Stream_Release(s);
+			drdynvc_write_completed(drdynvc);
 		}
 		break;
 
@@ -1798,6 +2024,7 @@ static UINT drdynvc_virtual_channel_event_disconnected(drdynvcPlugin* drdynvc)
 		           WTSErrorToString(status), status);
 	}
 
+	drdynvc_log_scheduler_stats(drdynvc);
 	dvcman_clear(drdynvc, drdynvc->channel_mgr);
 	if (drdynvc->queue)
 		MessageQueue_Clear(drdynvc->queue);
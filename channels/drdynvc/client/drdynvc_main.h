@@ -34,6 +34,8 @@
 #include <freerdp/channels/log.h>
 #include <freerdp/client/drdynvc.h>
 #include <freerdp/freerdp.h>
+#include <freerdp/utils/dvc_scheduler.h>
+#include <freerdp/codec/zgfx.h>
 
 typedef struct drdynvc_plugin drdynvcPlugin;
 
@@ -49,6 +51,11 @@ typedef struct
 	wHashTable* listeners;
 	wHashTable* channelsById;
 	wStreamPool* pool;
+
+	/* outgoing channel PDUs, sent while fewer than DRDYNVC_MAX_IN_FLIGHT are pending */
+	rdpDvcScheduler* scheduler;
+	CRITICAL_SECTION sendLock;
+	size_t inFlight;
 } DVCMAN;
 
 typedef struct
@@ -87,11 +94,16 @@ typedef struct
 	void* pInterface;
 	UINT32 channel_id;
 	char* channel_name;
+	BYTE priority;
 	IWTSVirtualChannelCallback* channel_callback;
 
 	wStream* dvc_data;
 	UINT32 dvc_data_length;
 	CRITICAL_SECTION lock;
+
+	/* RDP 8.0 Lite contexts for DYNVC_DATA_COMPRESSED, only with version 3 */
+	ZGFX_CONTEXT* compressor;
+	ZGFX_CONTEXT* decompressor;
 } DVCMAN_CHANNEL;
 
 typedef enum
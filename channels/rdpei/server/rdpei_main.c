@@ -102,8 +102,9 @@ UINT rdpei_server_init(RdpeiServerContext* context)
 	UINT32 channelId = 0;
 	BOOL status = TRUE;
 
-	priv->channelHandle = WTSVirtualChannelOpenEx(WTS_CURRENT_SESSION, RDPEI_DVC_CHANNEL_NAME,
-	                                              WTS_CHANNEL_OPTION_DYNAMIC);
+	priv->channelHandle =
+	    WTSVirtualChannelOpenEx(WTS_CURRENT_SESSION, RDPEI_DVC_CHANNEL_NAME,
+	                            WTS_CHANNEL_OPTION_DYNAMIC | WTS_CHANNEL_OPTION_DYNAMIC_PRI_REAL);
 	if (!priv->channelHandle)
 	{
 		WLog_ERR(TAG, "WTSVirtualChannelOpenEx failed!");
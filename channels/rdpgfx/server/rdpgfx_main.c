@@ -1548,8 +1548,11 @@ static BOOL rdpgfx_server_open(RdpgfxServerContext* context)
 
 		priv->SessionId = (DWORD)*pSessionId;
 		WTSFreeMemory(pSessionId);
-		priv->rdpgfx_channel = WTSVirtualChannelOpenEx(priv->SessionId, RDPGFX_DVC_CHANNEL_NAME,
-		                                               WTS_CHANNEL_OPTION_DYNAMIC);
+		/* The PDUs are already ZGFX compressed */
+		const DWORD flags = WTS_CHANNEL_OPTION_DYNAMIC | WTS_CHANNEL_OPTION_DYNAMIC_PRI_HIGH |
+		                    WTS_CHANNEL_OPTION_DYNAMIC_NO_COMPRESS;
+		priv->rdpgfx_channel =
+		    WTSVirtualChannelOpenEx(priv->SessionId, RDPGFX_DVC_CHANNEL_NAME, flags);
 
 		if (!priv->rdpgfx_channel)
 		{
@@ -0,0 +1,312 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Audio Output Virtual Channel
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/assert.h>
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+
+#include "rdpsnd_main.h"
+#include "rdpsnd_jitter.h"
+
+/* Number of queued waves, servers rarely have more than a few in flight */
+#define RDPSND_JITTER_MAX_BLOCKS 128
+
+/* Bounds of the adaptive target latency in ms */
+#define RDPSND_JITTER_MIN_TARGET 20
+#define RDPSND_JITTER_MAX_TARGET 500
+
+/* Blocks are handed to the device this many ms before they are scheduled */
+#define RDPSND_JITTER_LEAD 20
+
+/* A gap longer than this after the buffer ran dry is silence, not an underrun */
+#define RDPSND_JITTER_IDLE 500
+
+struct rdpsnd_jitter
+{
+	CRITICAL_SECTION lock;
+	HANDLE event;
+
+	UINT32 latency; /* configured minimum target in ms */
+	UINT32 target;
+
+	rdpsndJitterBlock blocks[RDPSND_JITTER_MAX_BLOCKS];
+	size_t first;
+	size_t count;
+	UINT32 buffered;
+
+	BOOL primed;
+	UINT64 clock; /* scheduled playout time of the first queued block */
+
+	/* RFC 3550 interarrival jitter, in 1/16 ms */
+	BOOL haveTransit;
+	INT64 transit;
+	UINT64 media;
+	UINT32 jitter16;
+
+	UINT64 played;
+	UINT64 underruns;
+	UINT64 overruns;
+	UINT32 lastLatency;
+};
+
+static UINT32 rdpsnd_jitter_update_target(rdpsndJitter* jitter)
+{
+	WINPR_ASSERT(jitter);
+
+	/* Three times the mean deviation covers nearly all late arrivals */
+	UINT32 target = MAX(jitter->latency, 3 * (jitter->jitter16 >> 4));
+	target = MAX(target, RDPSND_JITTER_MIN_TARGET);
+	target = MIN(target, RDPSND_JITTER_MAX_TARGET);
+	jitter->target = target;
+	return target;
+}
+
+static void rdpsnd_jitter_update_transit(rdpsndJitter* jitter, UINT64 arrival, UINT32 duration)
+{
+	WINPR_ASSERT(jitter);
+
+	if (duration == 0)
+		return;
+
+	const INT64 transit = (INT64)arrival - (INT64)jitter->media;
+	if (jitter->haveTransit)
+	{
+		INT64 d = transit - jitter->transit;
+		if (d < 0)
+			d = -d;
+		d = MIN(d, RDPSND_JITTER_MAX_TARGET);
+
+		/* J += (|D| - J) / 16 */
+		jitter->jitter16 += (UINT32)d;
+		jitter->jitter16 -= (jitter->jitter16 + 8) >> 4;
+	}
+
+	jitter->transit = transit;
+	jitter->haveTransit = TRUE;
+	jitter->media += duration;
+}
+
+void rdpsnd_jitter_free(rdpsndJitter* jitter)
+{
+	if (!jitter)
+		return;
+
+	rdpsndJitterBlock block = { 0 };
+	while (rdpsnd_jitter_flush(jitter, &block))
+		Stream_Release(block.data);
+
+	if (jitter->event)
+		(void)CloseHandle(jitter->event);
+	DeleteCriticalSection(&jitter->lock);
+	free(jitter);
+}
+
+rdpsndJitter* rdpsnd_jitter_new(UINT32 latency)
+{
+	rdpsndJitter* jitter = (rdpsndJitter*)calloc(1, sizeof(rdpsndJitter));
+
+	if (!jitter)
+		return NULL;
+
+	if (!InitializeCriticalSectionAndSpinCount(&jitter->lock, 4000))
+	{
+		free(jitter);
+		return NULL;
+	}
+
+	jitter->event = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (!jitter->event)
+		goto fail;
+
+	jitter->latency = latency;
+	rdpsnd_jitter_update_target(jitter);
+	return jitter;
+
+fail:
+	rdpsnd_jitter_free(jitter);
+	return NULL;
+}
+
+HANDLE rdpsnd_jitter_event(rdpsndJitter* jitter)
+{
+	WINPR_ASSERT(jitter);
+	return jitter->event;
+}
+
+BOOL rdpsnd_jitter_push(rdpsndJitter* jitter, UINT64 now, const rdpsndJitterBlock* block)
+{
+	BOOL rc = FALSE;
+
+	WINPR_ASSERT(jitter);
+	WINPR_ASSERT(block);
+
+	EnterCriticalSection(&jitter->lock);
+
+	if ((jitter->count == 0) && jitter->primed && (now > jitter->clock))
+	{
+		/* The buffer ran dry, start buffering again. Short gaps are late data,
+		 * longer ones the server stopped sending (silence). */
+		if (now - jitter->clock < RDPSND_JITTER_IDLE)
+			jitter->underruns++;
+		else
+			jitter->haveTransit = FALSE;
+
+		jitter->primed = FALSE;
+	}
+
+	rdpsnd_jitter_update_transit(jitter, block->arrival, block->duration);
+	const UINT32 target = rdpsnd_jitter_update_target(jitter);
+	const UINT32 maximum = 2 * target + MAX(block->duration, RDPSND_JITTER_MIN_TARGET);
+
+	if ((jitter->count >= RDPSND_JITTER_MAX_BLOCKS) ||
+	    (jitter->buffered + block->duration > maximum))
+	{
+		jitter->overruns++;
+		goto out;
+	}
+
+	const size_t index = (jitter->first + jitter->count) % RDPSND_JITTER_MAX_BLOCKS;
+	jitter->blocks[index] = *block;
+	jitter->count++;
+	jitter->buffered += block->duration;
+	rc = TRUE;
+
+out:
+	LeaveCriticalSection(&jitter->lock);
+
+	if (rc)
+		(void)SetEvent(jitter->event);
+	return rc;
+}
+
+static void rdpsnd_jitter_remove_first(rdpsndJitter* jitter, rdpsndJitterBlock* block)
+{
+	WINPR_ASSERT(jitter);
+	WINPR_ASSERT(jitter->count > 0);
+	WINPR_ASSERT(block);
+
+	rdpsndJitterBlock* cur = &jitter->blocks[jitter->first];
+	*block = *cur;
+	memset(cur, 0, sizeof(rdpsndJitterBlock));
+
+	jitter->first = (jitter->first + 1) % RDPSND_JITTER_MAX_BLOCKS;
+	jitter->count--;
+	jitter->buffered -= block->duration;
+}
+
+BOOL rdpsnd_jitter_pop(rdpsndJitter* jitter, UINT64 now, rdpsndJitterBlock* block, UINT64* next)
+{
+	BOOL rc = FALSE;
+
+	WINPR_ASSERT(jitter);
+	WINPR_ASSERT(block);
+	WINPR_ASSERT(next);
+
+	*next = UINT64_MAX;
+	EnterCriticalSection(&jitter->lock);
+
+	/* rdpsnd_jitter_push signals the event after queuing, a block pushed from now on
+	 * wakes the caller again */
+	(void)ResetEvent(jitter->event);
+
+	if (jitter->count == 0)
+		goto out;
+
+	if (!jitter->primed)
+	{
+		const rdpsndJitterBlock* first = &jitter->blocks[jitter->first];
+		const UINT64 due = first->arrival + jitter->target;
+
+		if ((jitter->buffered < jitter->target) && (now < due))
+		{
+			*next = due;
+			goto out;
+		}
+
+		jitter->primed = TRUE;
+		jitter->clock = now;
+	}
+
+	if (now + RDPSND_JITTER_LEAD < jitter->clock)
+	{
+		*next = jitter->clock - RDPSND_JITTER_LEAD;
+		goto out;
+	}
+
+	rdpsnd_jitter_remove_first(jitter, block);
+	jitter->clock = MAX(jitter->clock, now) + block->duration;
+	rc = TRUE;
+
+	if (jitter->count > 0)
+		*next = (jitter->clock > RDPSND_JITTER_LEAD) ? jitter->clock - RDPSND_JITTER_LEAD : 0;
+
+out:
+	LeaveCriticalSection(&jitter->lock);
+	return rc;
+}
+
+BOOL rdpsnd_jitter_flush(rdpsndJitter* jitter, rdpsndJitterBlock* block)
+{
+	BOOL rc = FALSE;
+
+	WINPR_ASSERT(jitter);
+	WINPR_ASSERT(block);
+
+	EnterCriticalSection(&jitter->lock);
+	if (jitter->count > 0)
+	{
+		rdpsnd_jitter_remove_first(jitter, block);
+		rc = TRUE;
+	}
+	else
+	{
+		jitter->primed = FALSE;
+		jitter->haveTransit = FALSE;
+	}
+	LeaveCriticalSection(&jitter->lock);
+	return rc;
+}
+
+void rdpsnd_jitter_played(rdpsndJitter* jitter, const rdpsndJitterBlock* block, UINT64 now,
+                          UINT32 latency)
+{
+	WINPR_ASSERT(jitter);
+	WINPR_ASSERT(block);
+
+	EnterCriticalSection(&jitter->lock);
+	jitter->played++;
+	jitter->lastLatency = (UINT32)MIN(UINT32_MAX, now - block->arrival + latency);
+	LeaveCriticalSection(&jitter->lock);
+}
+
+void rdpsnd_jitter_get_stats(rdpsndJitter* jitter, RDPSND_PLAYBACK_STATS* stats)
+{
+	WINPR_ASSERT(jitter);
+	WINPR_ASSERT(stats);
+
+	EnterCriticalSection(&jitter->lock);
+	stats->targetLatency = jitter->target;
+	stats->jitter = jitter->jitter16 >> 4;
+	stats->latency = jitter->lastLatency;
+	stats->buffered = jitter->buffered;
+	stats->played = jitter->played;
+	stats->underruns = jitter->underruns;
+	stats->overruns = jitter->overruns;
+	LeaveCriticalSection(&jitter->lock);
+}
@@ -0,0 +1,82 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Audio Output Virtual Channel
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_CHANNEL_RDPSND_CLIENT_JITTER_H
+#define FREERDP_CHANNEL_RDPSND_CLIENT_JITTER_H
+
+#include <winpr/wtypes.h>
+#include <winpr/stream.h>
+
+#include <freerdp/api.h>
+#include <freerdp/client/rdpsnd.h>
+
+typedef struct rdpsnd_jitter rdpsndJitter;
+
+/** @brief a decoded wave waiting for playout */
+typedef struct
+{
+	UINT16 wTimeStamp;
+	BYTE cBlockNo;
+	UINT64 arrival;    /* ms, time the wave was received */
+	UINT32 duration;   /* ms, 0 if unknown (compressed pass through formats) */
+	UINT32 generation; /* format generation the samples were decoded for */
+	wStream* data;     /* samples in the device format, owned by the block */
+} rdpsndJitterBlock;
+
+FREERDP_LOCAL void rdpsnd_jitter_free(rdpsndJitter* jitter);
+
+WINPR_ATTR_MALLOC(rdpsnd_jitter_free, 1)
+FREERDP_LOCAL rdpsndJitter* rdpsnd_jitter_new(UINT32 latency);
+
+/** @brief event signaled whenever a block was queued, reset by rdpsnd_jitter_pop */
+FREERDP_LOCAL HANDLE rdpsnd_jitter_event(rdpsndJitter* jitter);
+
+/** @brief queue a decoded block
+ *
+ *  Updates the arrival jitter estimate and the adaptive target latency.
+ *
+ *  @return \b TRUE if the block was queued (ownership of block->data is taken),
+ *          \b FALSE if it was dropped because the buffer would exceed the maximum latency
+ */
+FREERDP_LOCAL BOOL rdpsnd_jitter_push(rdpsndJitter* jitter, UINT64 now,
+                                      const rdpsndJitterBlock* block);
+
+/** @brief get the next block due for playout at \b now
+ *
+ *  @param next time the next block becomes due if none is due now, UINT64_MAX if the
+ *              buffer is empty
+ *  @return \b TRUE if a block was returned, ownership of block->data passes to the caller
+ */
+FREERDP_LOCAL BOOL rdpsnd_jitter_pop(rdpsndJitter* jitter, UINT64 now, rdpsndJitterBlock* block,
+                                     UINT64* next);
+
+/** @brief remove the oldest block regardless of its playout time
+ *
+ *  Used to drain the buffer when the device is closed or changes format.
+ */
+FREERDP_LOCAL BOOL rdpsnd_jitter_flush(rdpsndJitter* jitter, rdpsndJitterBlock* block);
+
+/** @brief account a block handed to the device
+ *
+ *  @param latency the output latency reported by the device in ms
+ */
+FREERDP_LOCAL void rdpsnd_jitter_played(rdpsndJitter* jitter, const rdpsndJitterBlock* block,
+                                        UINT64 now, UINT32 latency);
+
+FREERDP_LOCAL void rdpsnd_jitter_get_stats(rdpsndJitter* jitter, RDPSND_PLAYBACK_STATS* stats);
+
+#endif /* FREERDP_CHANNEL_RDPSND_CLIENT_JITTER_H */
@@ -50,6 +50,7 @@
 
 #include "rdpsnd_common.h"
 #include "rdpsnd_main.h"
+#include "rdpsnd_jitter.h"
 
 struct rdpsnd_plugin
 {
@@ -92,8 +93,13 @@ struct rdpsnd_plugin
 	BOOL isOpen;
 	AUDIO_FORMAT* fixed_format;
 
-	UINT32 startPlayTime;
-	size_t totalPlaySize;
+	/* Decoded waves waiting for playout, drained by the playout thread */
+	rdpsndJitter* jitter;
+	UINT32 formatGeneration; /* changes whenever queued waves no longer match the device */
+	HANDLE playout;
+	HANDLE stopPlayout;
+	HANDLE playoutIdle; /* reset while the playout thread plays outside of deviceLock */
+	CRITICAL_SECTION deviceLock;
 
 	char* subsystem;
 	char* device_name;
@@ -125,6 +131,9 @@ static const char* rdpsnd_is_dyn_str(BOOL dynamic)
 }
 
 static void rdpsnd_virtual_channel_event_terminated(rdpsndPlugin* rdpsnd);
+static UINT rdpsnd_playout_start(rdpsndPlugin* rdpsnd);
+static UINT rdpsnd_playout_flush(rdpsndPlugin* rdpsnd);
+static void rdpsnd_playout_wait_idle(rdpsndPlugin* rdpsnd);
 
 /**
  * Function description
@@ -303,7 +312,16 @@ static UINT rdpsnd_recv_server_audio_formats_pdu(rdpsndPlugin* rdpsnd, wStream*
 	ret = IFCALLRESULT(CHANNEL_RC_OK, rdpsnd->device->ServerFormatAnnounce, rdpsnd->device,
 	                   rdpsnd->ServerFormats, rdpsnd->NumberOfServerFormats);
 
+	/* Queued waves refer to the old client formats, confirm them without playing */
+	EnterCriticalSection(&rdpsnd->deviceLock);
+	rdpsnd_playout_wait_idle(rdpsnd);
+	ret = rdpsnd_playout_flush(rdpsnd);
+	rdpsnd->formatGeneration++;
 	rdpsnd_select_supported_audio_formats(rdpsnd);
+	LeaveCriticalSection(&rdpsnd->deviceLock);
+	if (ret != CHANNEL_RC_OK)
+		return ret;
+
 	WLog_Print(rdpsnd->log, WLOG_DEBUG, "%s Server Audio Formats",
 	           rdpsnd_is_dyn_str(rdpsnd->dynamic));
 	ret = rdpsnd_send_client_audio_formats(rdpsnd);
@@ -391,17 +409,30 @@ static BOOL rdpsnd_apply_volume(rdpsndPlugin* rdpsnd)
 static BOOL rdpsnd_ensure_device_is_open(rdpsndPlugin* rdpsnd, UINT32 wFormatNo,
                                          const AUDIO_FORMAT* format)
 {
+	BOOL rc = FALSE;
+
 	if (!rdpsnd)
 		return FALSE;
 	WINPR_ASSERT(format);
 
+	if (rdpsnd_playout_start(rdpsnd) != CHANNEL_RC_OK)
+		return FALSE;
+
+	EnterCriticalSection(&rdpsnd->deviceLock);
 	if (!rdpsnd->isOpen || (wFormatNo != rdpsnd->wCurrentFormatNo))
 	{
-		BOOL rc = 0;
 		BOOL supported = 0;
 		AUDIO_FORMAT deviceFormat = *format;
 
+		/* Queued waves were decoded for the old format, play nothing of them
+		 * but let the server know they are done. */
+		rdpsnd_playout_wait_idle(rdpsnd);
+		rdpsnd->formatGeneration++;
+		if (rdpsnd_playout_flush(rdpsnd) != CHANNEL_RC_OK)
+			goto out;
+
 		IFCALL(rdpsnd->device->Close, rdpsnd->device);
+		rdpsnd->isOpen = FALSE;
 		supported = IFCALLRESULT(FALSE, rdpsnd->device->FormatSupported, rdpsnd->device, format);
 
 		if (!supported)
@@ -419,25 +450,24 @@ static BOOL rdpsnd_ensure_device_is_open(rdpsndPlugin* rdpsnd, UINT32 wFormatNo,
 		           rdpsnd_is_dyn_str(rdpsnd->dynamic),
 		           audio_format_get_tag_string(format->wFormatTag),
 		           audio_format_get_tag_string(deviceFormat.wFormatTag));
-		rc = IFCALLRESULT(FALSE, rdpsnd->device->Open, rdpsnd->device, &deviceFormat,
-		                  rdpsnd->latency);
-
-		if (!rc)
-			return FALSE;
+		if (!IFCALLRESULT(FALSE, rdpsnd->device->Open, rdpsnd->device, &deviceFormat,
+		                  rdpsnd->latency))
+			goto out;
 
 		if (!supported)
 		{
 			if (!freerdp_dsp_context_reset(rdpsnd->dsp_context, format, 0u))
-				return FALSE;
+				goto out;
 		}
 
 		rdpsnd->isOpen = TRUE;
 		rdpsnd->wCurrentFormatNo = wFormatNo;
-		rdpsnd->startPlayTime = 0;
-		rdpsnd->totalPlaySize = 0;
 	}
 
-	return rdpsnd_apply_volume(rdpsnd);
+	rc = rdpsnd_apply_volume(rdpsnd);
+out:
+	LeaveCriticalSection(&rdpsnd->deviceLock);
+	return rc;
 }
 
 /**
@@ -506,101 +536,20 @@ static UINT rdpsnd_send_wave_confirm_pdu(rdpsndPlugin* rdpsnd, UINT16 wTimeStamp
 	return rdpsnd_virtual_channel_write(rdpsnd, pdu);
 }
 
-static BOOL rdpsnd_detect_overrun(rdpsndPlugin* rdpsnd, const AUDIO_FORMAT* format, size_t size)
+static UINT32 rdpsnd_wave_duration(const AUDIO_FORMAT* format, UINT16 wBitsPerSample,
+                                   size_t size)
 {
-	UINT32 bpf = 0;
-	UINT32 now = 0;
-	UINT32 duration = 0;
-	UINT32 totalDuration = 0;
-	UINT32 remainingDuration = 0;
-	UINT32 maxDuration = 0;
-
-	if (!rdpsnd || !format)
-		return FALSE;
-
-	/* Older windows RDP servers do not limit the send buffer, which can
-	 * cause quite a large amount of sound data buffered client side.
-	 * If e.g. sound is paused server side the client will keep playing
-	 * for a long time instead of pausing playback.
-	 *
-	 * To avoid this we check:
-	 *
-	 * 1. Is the sound sample received from a known format these servers
-	 *    support
-	 * 2. If it is calculate the size of the client side sound buffer
-	 * 3. If the buffer is too large silently drop the sample which will
-	 *    trigger a retransmit later on.
-	 *
-	 * This check must only be applied to these known formats, because
-	 * with newer and other formats the sample size can not be calculated
-	 * without decompressing the sample first.
-	 */
-	switch (format->wFormatTag)
-	{
-		case WAVE_FORMAT_PCM:
-		case WAVE_FORMAT_DVI_ADPCM:
-		case WAVE_FORMAT_ADPCM:
-		case WAVE_FORMAT_ALAW:
-		case WAVE_FORMAT_MULAW:
-			break;
-		case WAVE_FORMAT_MSG723:
-		case WAVE_FORMAT_GSM610:
-		case WAVE_FORMAT_AAC_MS:
-		default:
-			return FALSE;
-	}
+	WINPR_ASSERT(format);
 
-	audio_format_print(WLog_Get(TAG), WLOG_DEBUG, format);
-	bpf = format->nChannels * format->wBitsPerSample * format->nSamplesPerSec / 8;
+	const size_t bpf = 1ull * format->nChannels * format->nSamplesPerSec * wBitsPerSample / 8ull;
 	if (bpf == 0)
-		return FALSE;
-
-	duration = (UINT32)(1000 * size / bpf);
-	totalDuration = (UINT32)(1000 * rdpsnd->totalPlaySize / bpf);
-	now = GetTickCountPrecise();
-	if (rdpsnd->startPlayTime == 0)
-	{
-		rdpsnd->startPlayTime = now;
-		rdpsnd->totalPlaySize = size;
-		return FALSE;
-	}
-	else if (now - rdpsnd->startPlayTime > totalDuration + 10)
-	{
-		/* Buffer underrun */
-		WLog_Print(rdpsnd->log, WLOG_DEBUG, "%s Buffer underrun by %u ms",
-		           rdpsnd_is_dyn_str(rdpsnd->dynamic),
-		           (UINT)(now - rdpsnd->startPlayTime - totalDuration));
-		rdpsnd->startPlayTime = now;
-		rdpsnd->totalPlaySize = size;
-		return FALSE;
-	}
-	else
-	{
-		/* Calculate remaining duration to be played */
-		remainingDuration = totalDuration - (now - rdpsnd->startPlayTime);
-
-		/* Maximum allow duration calculation */
-		maxDuration = duration * 2 + rdpsnd->latency;
-
-		if (remainingDuration + duration > maxDuration)
-		{
-			WLog_Print(rdpsnd->log, WLOG_DEBUG, "%s Buffer overrun pending %u ms dropping %u ms",
-			           rdpsnd_is_dyn_str(rdpsnd->dynamic), remainingDuration, duration);
-			return TRUE;
-		}
-
-		rdpsnd->totalPlaySize += size;
-		return FALSE;
-	}
+		return 0;
+	return (UINT32)MIN(UINT32_MAX, 1000ull * size / bpf);
 }
 
 static UINT rdpsnd_treat_wave(rdpsndPlugin* rdpsnd, wStream* s, size_t size)
 {
 	AUDIO_FORMAT* format = NULL;
-	UINT64 end = 0;
-	UINT64 diffMS = 0;
-	UINT64 ts = 0;
-	UINT latency = 0;
 	UINT error = 0;
 
 	if (!Stream_CheckAndLogRequiredLength(TAG, s, size))
@@ -624,50 +573,296 @@ static UINT rdpsnd_treat_wave(rdpsndPlugin* rdpsnd, wStream* s, size_t size)
 	           "%s Wave: cBlockNo: %" PRIu8 " wTimeStamp: %" PRIu16 ", size: %" PRIdz,
 	           rdpsnd_is_dyn_str(rdpsnd->dynamic), rdpsnd->cBlockNo, rdpsnd->wTimeStamp, size);
 
-	if (rdpsnd->device && rdpsnd->attached && !rdpsnd_detect_overrun(rdpsnd, format, size))
+	if (rdpsnd->device && rdpsnd->attached && rdpsnd->jitter)
 	{
-		UINT status = CHANNEL_RC_OK;
-		wStream* pcmData = StreamPool_Take(rdpsnd->pool, 4096);
+		rdpsndJitterBlock block = { 0 };
+		wStream* pcmData = StreamPool_Take(rdpsnd->pool, size);
+
+		if (!pcmData)
+			return CHANNEL_RC_NO_MEMORY;
 
-		if (rdpsnd->device->FormatSupported(rdpsnd->device, format))
+		/* Decode ahead, the playout thread only hands ready samples to the device */
+		if (IFCALLRESULT(FALSE, rdpsnd->device->FormatSupported, rdpsnd->device, format))
 		{
-			if (rdpsnd->device->PlayEx)
-				latency = rdpsnd->device->PlayEx(rdpsnd->device, format, data, size);
-			else
-				latency = IFCALLRESULT(0, rdpsnd->device->Play, rdpsnd->device, data, size);
+			/* Compressed pass through formats have no known duration */
+			Stream_Write(pcmData, data, size);
+			if (format->wFormatTag == WAVE_FORMAT_PCM)
+				block.duration = rdpsnd_wave_duration(format, format->wBitsPerSample, size);
 		}
 		else if (freerdp_dsp_decode(rdpsnd->dsp_context, format, data, size, pcmData))
+			block.duration = rdpsnd_wave_duration(format, 16, Stream_GetPosition(pcmData));
+		else
 		{
-			Stream_SealLength(pcmData);
-
-			if (rdpsnd->device->PlayEx)
-				latency = rdpsnd->device->PlayEx(rdpsnd->device, format, Stream_Buffer(pcmData),
-				                                 Stream_Length(pcmData));
-			else
-				latency = IFCALLRESULT(0, rdpsnd->device->Play, rdpsnd->device,
-				                       Stream_Buffer(pcmData), Stream_Length(pcmData));
+			Stream_Release(pcmData);
+			return ERROR_INTERNAL_ERROR;
 		}
-		else
-			status = ERROR_INTERNAL_ERROR;
 
+		Stream_SealLength(pcmData);
+		block.wTimeStamp = rdpsnd->wTimeStamp;
+		block.cBlockNo = rdpsnd->cBlockNo;
+		block.arrival = rdpsnd->wArrivalTime;
+		block.generation = rdpsnd->formatGeneration;
+		block.data = pcmData;
+
+		if (rdpsnd_jitter_push(rdpsnd->jitter, GetTickCount64(), &block))
+			return CHANNEL_RC_OK;
+
+		/* Older windows RDP servers do not limit the send buffer. Drop the sample
+		 * instead of letting the client side latency grow, the server will
+		 * retransmit or skip ahead. */
+		WLog_Print(rdpsnd->log, WLOG_DEBUG, "%s Buffer overrun, dropping %" PRIu32 " ms",
+		           rdpsnd_is_dyn_str(rdpsnd->dynamic), block.duration);
 		Stream_Release(pcmData);
-
-		if (status != CHANNEL_RC_OK)
-			return status;
 	}
 
-	end = GetTickCount64();
-	diffMS = end - rdpsnd->wArrivalTime + latency;
-	ts = (rdpsnd->wTimeStamp + diffMS) % UINT16_MAX;
-
 	/*
 	 * Send the second WaveConfirm PDU. With the first WaveConfirm PDU,
 	 * the server side uses this second WaveConfirm PDU to determine the actual
 	 * render latency.
 	 */
+	const UINT64 diffMS = GetTickCount64() - rdpsnd->wArrivalTime;
+	const UINT64 ts = (rdpsnd->wTimeStamp + diffMS) % UINT16_MAX;
 	return rdpsnd_send_wave_confirm_pdu(rdpsnd, (UINT16)ts, rdpsnd->cBlockNo);
 }
 
+static UINT rdpsnd_confirm_block(rdpsndPlugin* rdpsnd, const rdpsndJitterBlock* block,
+                                 UINT64 now, UINT latency)
+{
+	WINPR_ASSERT(rdpsnd);
+	WINPR_ASSERT(block);
+
+	/*
+	 * Send the second WaveConfirm PDU once the block was handed to the device,
+	 * the server uses it to determine the actual render latency.
+	 */
+	const UINT64 diffMS = now - block->arrival + latency;
+	const UINT64 ts = (block->wTimeStamp + diffMS) % UINT16_MAX;
+	return rdpsnd_send_wave_confirm_pdu(rdpsnd, (UINT16)ts, block->cBlockNo);
+}
+
+/**
+ * Function description
+ *
+ * Wait until the playout thread handed its current wave to the device. Called with deviceLock
+ * held before the device is closed or the client formats change, the lock keeps the playout
+ * thread from starting the next wave.
+ */
+static void rdpsnd_playout_wait_idle(rdpsndPlugin* rdpsnd)
+{
+	WINPR_ASSERT(rdpsnd);
+
+	if (rdpsnd->playoutIdle)
+		(void)WaitForSingleObject(rdpsnd->playoutIdle, INFINITE);
+}
+
+static UINT rdpsnd_playout_block(rdpsndPlugin* rdpsnd, const rdpsndJitterBlock* block)
+{
+	UINT latency = 0;
+	rdpsndDevicePlugin* device = NULL;
+	const AUDIO_FORMAT* format = NULL;
+
+	WINPR_ASSERT(rdpsnd);
+	WINPR_ASSERT(block);
+
+	EnterCriticalSection(&rdpsnd->deviceLock);
+	if (block->generation != rdpsnd->formatGeneration)
+	{
+		/* The format changed after the block was taken from the queue */
+		WLog_Print(rdpsnd->log, WLOG_DEBUG, "%s Dropping wave %" PRIu8 " of a previous format",
+		           rdpsnd_is_dyn_str(rdpsnd->dynamic), block->cBlockNo);
+	}
+	else if (rdpsnd->isOpen && rdpsnd->device &&
+	         (rdpsnd->wCurrentFormatNo < rdpsnd->NumberOfClientFormats))
+	{
+		/* Devices block in Play until there is room for the samples, do not hold the lock the
+		 * channel thread needs for every wave meanwhile */
+		device = rdpsnd->device;
+		format = &rdpsnd->ClientFormats[rdpsnd->wCurrentFormatNo];
+		(void)ResetEvent(rdpsnd->playoutIdle);
+	}
+	LeaveCriticalSection(&rdpsnd->deviceLock);
+
+	if (device)
+	{
+		const BYTE* data = Stream_Buffer(block->data);
+		const size_t size = Stream_Length(block->data);
+
+		if (device->PlayEx)
+			latency = device->PlayEx(device, format, data, size);
+		else
+			latency = IFCALLRESULT(0, device->Play, device, data, size);
+
+		(void)SetEvent(rdpsnd->playoutIdle);
+	}
+
+	const UINT64 now = GetTickCount64();
+	rdpsnd_jitter_played(rdpsnd->jitter, block, now, latency);
+
+	RDPSND_PLAYBACK_STATS stats = { 0 };
+	rdpsnd_jitter_get_stats(rdpsnd->jitter, &stats);
+	if ((stats.played % 256) == 0)
+		WLog_Print(rdpsnd->log, WLOG_DEBUG,
+		           "%s Playback: target %" PRIu32 " ms, jitter %" PRIu32 " ms, latency %" PRIu32
+		           " ms, underruns %" PRIu64 ", overruns %" PRIu64,
+		           rdpsnd_is_dyn_str(rdpsnd->dynamic), stats.targetLatency, stats.jitter,
+		           stats.latency, stats.underruns, stats.overruns);
+
+	return rdpsnd_confirm_block(rdpsnd, block, now, latency);
+}
+
+/**
+ * Function description
+ *
+ * Drop all queued waves, confirming each of them to the server.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpsnd_playout_flush(rdpsndPlugin* rdpsnd)
+{
+	UINT error = CHANNEL_RC_OK;
+	rdpsndJitterBlock block = { 0 };
+
+	WINPR_ASSERT(rdpsnd);
+
+	if (!rdpsnd->jitter)
+		return CHANNEL_RC_OK;
+
+	while (rdpsnd_jitter_flush(rdpsnd->jitter, &block))
+	{
+		if (error == CHANNEL_RC_OK)
+			error = rdpsnd_confirm_block(rdpsnd, &block, GetTickCount64(), 0);
+		Stream_Release(block.data);
+	}
+
+	return error;
+}
+
+static DWORD WINAPI playout_thread(LPVOID arg)
+{
+	UINT error = CHANNEL_RC_OK;
+	rdpsndPlugin* rdpsnd = arg;
+	UINT64 next = UINT64_MAX;
+
+	if (!rdpsnd || !rdpsnd->jitter)
+		return ERROR_INVALID_PARAMETER;
+
+	while (error == CHANNEL_RC_OK)
+	{
+		DWORD nCount = 0;
+		DWORD timeout = INFINITE;
+		HANDLE handles[MAXIMUM_WAIT_OBJECTS] = { 0 };
+		rdpsndJitterBlock block = { 0 };
+
+		handles[nCount++] = rdpsnd_jitter_event(rdpsnd->jitter);
+		handles[nCount++] = rdpsnd->stopPlayout;
+		if (rdpsnd->rdpcontext)
+			handles[nCount++] = freerdp_abort_event(rdpsnd->rdpcontext);
+
+		if (next != UINT64_MAX)
+		{
+			const UINT64 now = GetTickCount64();
+			timeout = (next > now) ? (DWORD)MIN(next - now, INFINITE - 1) : 0;
+		}
+
+		const DWORD status = WaitForMultipleObjects(nCount, handles, FALSE, timeout);
+		switch (status)
+		{
+			case WAIT_OBJECT_0:
+			case WAIT_TIMEOUT:
+				break;
+			case WAIT_OBJECT_0 + 1: /* stopPlayout */
+			case WAIT_OBJECT_0 + 2: /* abort event */
+				return CHANNEL_RC_OK;
+			default:
+				error = ERROR_TIMEOUT;
+				break;
+		}
+
+		while ((error == CHANNEL_RC_OK) &&
+		       rdpsnd_jitter_pop(rdpsnd->jitter, GetTickCount64(), &block, &next))
+		{
+			error = rdpsnd_playout_block(rdpsnd, &block);
+			Stream_Release(block.data);
+		}
+	}
+
+	/* rdpsnd_playout_start restarts the thread with the next wave */
+	WLog_Print(rdpsnd->log, WLOG_ERROR, "%s Playout thread failed with %s [0x%08" PRIx32 "]",
+	           rdpsnd_is_dyn_str(rdpsnd->dynamic), WTSErrorToString(error), error);
+	return error;
+}
+
+static UINT rdpsnd_playout_start(rdpsndPlugin* rdpsnd)
+{
+	WINPR_ASSERT(rdpsnd);
+
+	if (rdpsnd->playout)
+	{
+		if (WaitForSingleObject(rdpsnd->playout, 0) != WAIT_OBJECT_0)
+			return CHANNEL_RC_OK;
+
+		/* The thread failed, queued waves are still confirmed by the new one */
+		WLog_Print(rdpsnd->log, WLOG_WARN, "%s Restarting the playout thread",
+		           rdpsnd_is_dyn_str(rdpsnd->dynamic));
+		(void)CloseHandle(rdpsnd->playout);
+		rdpsnd->playout = NULL;
+	}
+
+	if (!rdpsnd->jitter)
+	{
+		rdpsnd->jitter = rdpsnd_jitter_new(rdpsnd->latency);
+		if (!rdpsnd->jitter)
+			return CHANNEL_RC_NO_MEMORY;
+	}
+
+	if (!rdpsnd->stopPlayout)
+	{
+		rdpsnd->stopPlayout = CreateEvent(NULL, TRUE, FALSE, NULL);
+		if (!rdpsnd->stopPlayout)
+			return CHANNEL_RC_NO_MEMORY;
+	}
+
+	if (!rdpsnd->playoutIdle)
+	{
+		rdpsnd->playoutIdle = CreateEvent(NULL, TRUE, TRUE, NULL);
+		if (!rdpsnd->playoutIdle)
+			return CHANNEL_RC_NO_MEMORY;
+	}
+
+	rdpsnd->playout = CreateThread(NULL, 0, playout_thread, rdpsnd, 0, NULL);
+	if (!rdpsnd->playout)
+		return CHANNEL_RC_INITIALIZATION_ERROR;
+
+	return CHANNEL_RC_OK;
+}
+
+static void rdpsnd_playout_stop(rdpsndPlugin* rdpsnd)
+{
+	WINPR_ASSERT(rdpsnd);
+
+	if (rdpsnd->playout)
+	{
+		(void)SetEvent(rdpsnd->stopPlayout);
+		(void)WaitForSingleObject(rdpsnd->playout, INFINITE);
+		(void)CloseHandle(rdpsnd->playout);
+		rdpsnd->playout = NULL;
+	}
+
+	/* Releases all queued waves back to the stream pool, the playback statistics
+	 * read the buffer with the device lock held */
+	EnterCriticalSection(&rdpsnd->deviceLock);
+	rdpsnd_jitter_free(rdpsnd->jitter);
+	rdpsnd->jitter = NULL;
+	if (rdpsnd->playoutIdle)
+		(void)CloseHandle(rdpsnd->playoutIdle);
+	rdpsnd->playoutIdle = NULL;
+	LeaveCriticalSection(&rdpsnd->deviceLock);
+
+	if (rdpsnd->stopPlayout)
+		(void)CloseHandle(rdpsnd->stopPlayout);
+	rdpsnd->stopPlayout = NULL;
+}
+
 /**
  * Function description
  *
@@ -749,9 +944,11 @@ static UINT rdpsnd_recv_volume_pdu(rdpsndPlugin* rdpsnd, wStream* s)
 	WLog_Print(rdpsnd->log, WLOG_DEBUG, "%s Volume: 0x%08" PRIX32 "",
 	           rdpsnd_is_dyn_str(rdpsnd->dynamic), dwVolume);
 
+	EnterCriticalSection(&rdpsnd->deviceLock);
 	rdpsnd->volume = dwVolume;
 	rdpsnd->applyVolume = TRUE;
 	rc = rdpsnd_apply_volume(rdpsnd);
+	LeaveCriticalSection(&rdpsnd->deviceLock);
 
 	if (!rc)
 	{
@@ -1305,6 +1502,7 @@ static UINT rdpsnd_virtual_channel_event_disconnected(rdpsndPlugin* rdpsnd)
 	{
 		DWORD opened = rdpsnd->OpenHandle;
 		rdpsnd->OpenHandle = 0;
+		rdpsnd_playout_stop(rdpsnd);
 		if (rdpsnd->device)
 			IFCALL(rdpsnd->device->Close, rdpsnd->device);
 
@@ -1318,6 +1516,7 @@ static UINT rdpsnd_virtual_channel_event_disconnected(rdpsndPlugin* rdpsnd)
 		}
 	}
 
+	rdpsnd_playout_stop(rdpsnd);
 	cleanup_internals(rdpsnd);
 
 	if (rdpsnd->device)
@@ -1463,7 +1662,9 @@ void rdpsnd_virtual_channel_event_terminated(rdpsndPlugin* rdpsnd)
 		}
 		MessageQueue_Free(rdpsnd->queue);
 
+		rdpsnd_playout_stop(rdpsnd);
 		free_internals(rdpsnd);
+		DeleteCriticalSection(&rdpsnd->deviceLock);
 		audio_formats_free(rdpsnd->fixed_format, 1);
 		free(rdpsnd->subsystem);
 		free(rdpsnd->device_name);
@@ -1537,12 +1738,33 @@ rdpContext* freerdp_rdpsnd_get_context(rdpsndPlugin* plugin)
 	return plugin->rdpcontext;
 }
 
+BOOL freerdp_rdpsnd_get_playback_stats(rdpsndPlugin* plugin, RDPSND_PLAYBACK_STATS* stats)
+{
+	if (!plugin || !stats)
+		return FALSE;
+
+	const RDPSND_PLAYBACK_STATS empty = { 0 };
+	*stats = empty;
+
+	EnterCriticalSection(&plugin->deviceLock);
+	if (plugin->jitter)
+		rdpsnd_jitter_get_stats(plugin->jitter, stats);
+	LeaveCriticalSection(&plugin->deviceLock);
+	return TRUE;
+}
+
 static rdpsndPlugin* allocatePlugin(void)
 {
 	rdpsndPlugin* rdpsnd = (rdpsndPlugin*)calloc(1, sizeof(rdpsndPlugin));
 	if (!rdpsnd)
 		goto fail;
 
+	if (!InitializeCriticalSectionAndSpinCount(&rdpsnd->deviceLock, 4000))
+	{
+		free(rdpsnd);
+		return NULL;
+	}
+
 	rdpsnd->fixed_format = audio_format_new();
 	if (!rdpsnd->fixed_format)
 		goto fail;
@@ -1555,7 +1777,10 @@ static rdpsndPlugin* allocatePlugin(void)
 
 fail:
 	if (rdpsnd)
+	{
 		audio_format_free(rdpsnd->fixed_format);
+		DeleteCriticalSection(&rdpsnd->deviceLock);
+	}
 	free(rdpsnd);
 	return NULL;
 }
@@ -1678,6 +1903,7 @@ static UINT rdpsnd_on_close(IWTSVirtualChannelCallback* pChannelCallback)
 	WINPR_ASSERT(rdpsnd);
 
 	rdpsnd->OnOpenCalled = FALSE;
+	rdpsnd_playout_stop(rdpsnd);
 	if (rdpsnd->device)
 		IFCALL(rdpsnd->device->Close, rdpsnd->device);
 
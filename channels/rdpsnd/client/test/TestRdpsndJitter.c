@@ -0,0 +1,326 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/stream.h>
+
+#include "rdpsnd_jitter.h"
+
+/* Every wave carries 20 ms of audio, the usual server block size */
+#define TEST_DURATION 20
+#define TEST_MAX_WAVES 512
+
+/* A fake audio backend driven by a simulated clock: it pulls due waves from the jitter buffer
+ * every millisecond and plays them back to back, like a device with a small hardware buffer. */
+typedef struct
+{
+	wStreamPool* pool;
+	rdpsndJitter* jitter;
+	UINT32 deviceLatency; /* output latency the backend reports per wave */
+
+	UINT64 now;
+	UINT64 busyUntil; /* the backend plays queued samples until then */
+	size_t sent;
+	size_t dropped;
+	size_t played;
+	UINT32 gaps; /* times the backend ran out of samples between two waves */
+	BOOL ordered;
+	UINT16 last;
+} TestBackend;
+
+static BOOL test_backend_init(TestBackend* backend, UINT32 latency)
+{
+	const TestBackend empty = { 0 };
+	*backend = empty;
+	backend->ordered = TRUE;
+	backend->pool = StreamPool_New(TRUE, 64);
+	backend->jitter = rdpsnd_jitter_new(latency);
+	return backend->pool && backend->jitter;
+}
+
+static void test_backend_free(TestBackend* backend)
+{
+	rdpsnd_jitter_free(backend->jitter);
+	StreamPool_Free(backend->pool);
+}
+
+static BOOL test_backend_send(TestBackend* backend, UINT64 arrival)
+{
+	rdpsndJitterBlock block = { 0 };
+
+	block.data = StreamPool_Take(backend->pool, 4);
+	if (!block.data)
+		return FALSE;
+
+	block.wTimeStamp = (UINT16)backend->sent++;
+	block.cBlockNo = (BYTE)block.wTimeStamp;
+	block.arrival = arrival;
+	block.duration = TEST_DURATION;
+	Stream_SealLength(block.data);
+
+	if (!rdpsnd_jitter_push(backend->jitter, backend->now, &block))
+	{
+		backend->dropped++;
+		Stream_Release(block.data);
+	}
+	return TRUE;
+}
+
+static void test_backend_play(TestBackend* backend, const rdpsndJitterBlock* block)
+{
+	if ((backend->played > 0) && (block->wTimeStamp <= backend->last))
+		backend->ordered = FALSE;
+	if ((backend->played > 0) && (backend->now > backend->busyUntil))
+		backend->gaps++;
+
+	backend->last = block->wTimeStamp;
+	backend->played++;
+	backend->busyUntil = MAX(backend->busyUntil, backend->now) + block->duration;
+	rdpsnd_jitter_played(backend->jitter, block, backend->now, backend->deviceLatency);
+	Stream_Release(block->data);
+}
+
+/* Deliver the waves at the given (sorted) arrival times, run the clock until end */
+static BOOL test_backend_run(TestBackend* backend, const UINT64* arrivals, size_t count,
+                             UINT64 end)
+{
+	size_t index = 0;
+
+	for (; backend->now <= end; backend->now++)
+	{
+		rdpsndJitterBlock block = { 0 };
+		UINT64 next = 0;
+
+		while ((index < count) && (arrivals[index] <= backend->now))
+		{
+			if (!test_backend_send(backend, arrivals[index++]))
+				return FALSE;
+		}
+
+		while (rdpsnd_jitter_pop(backend->jitter, backend->now, &block, &next))
+			test_backend_play(backend, &block);
+	}
+
+	return index == count;
+}
+
+static void test_backend_stats(TestBackend* backend, RDPSND_PLAYBACK_STATS* stats)
+{
+	rdpsnd_jitter_get_stats(backend->jitter, stats);
+}
+
+/* Waves arriving in real time play back to back at the configured target */
+static BOOL test_steady(void)
+{
+	BOOL rc = FALSE;
+	TestBackend backend = { 0 };
+	UINT64 arrivals[100] = { 0 };
+	RDPSND_PLAYBACK_STATS stats = { 0 };
+
+	if (!test_backend_init(&backend, 50))
+		goto fail;
+
+	backend.deviceLatency = 30;
+	for (size_t x = 0; x < ARRAYSIZE(arrivals); x++)
+		arrivals[x] = 1000 + x * TEST_DURATION;
+
+	if (!test_backend_run(&backend, arrivals, ARRAYSIZE(arrivals), 4000))
+		goto fail;
+
+	test_backend_stats(&backend, &stats);
+	if ((backend.played != ARRAYSIZE(arrivals)) || !backend.ordered || (backend.gaps != 0) ||
+	    (stats.underruns != 0) || (stats.overruns != 0) || (stats.targetLatency != 50) ||
+	    (stats.buffered != 0) || (stats.latency < backend.deviceLatency))
+	{
+		fprintf(stderr,
+		        "steady: played %" PRIuz " gaps %" PRIu32 " underruns %" PRIu64
+		        " overruns %" PRIu64 " target %" PRIu32 " latency %" PRIu32 "\n",
+		        backend.played, backend.gaps, stats.underruns, stats.overruns,
+		        stats.targetLatency, stats.latency);
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	test_backend_free(&backend);
+	return rc;
+}
+
+/* A stream interrupted by late data counts one underrun, a pause longer than the idle
+ * time is silence and does not */
+static BOOL test_underrun(void)
+{
+	BOOL rc = FALSE;
+	TestBackend backend = { 0 };
+	UINT64 arrivals[150] = { 0 };
+	RDPSND_PLAYBACK_STATS stats = { 0 };
+
+	if (!test_backend_init(&backend, 50))
+		goto fail;
+
+	for (size_t x = 0; x < ARRAYSIZE(arrivals); x++)
+	{
+		arrivals[x] = x * TEST_DURATION;
+		if (x >= 50)
+			arrivals[x] += 100; /* late, the buffer runs dry */
+		if (x >= 100)
+			arrivals[x] += 2000; /* the server paused */
+	}
+
+	if (!test_backend_run(&backend, arrivals, 100, 2500))
+		goto fail;
+
+	test_backend_stats(&backend, &stats);
+	if ((stats.underruns != 1) || (backend.gaps != 1) || (backend.played != 100))
+	{
+		fprintf(stderr, "underrun: underruns %" PRIu64 " gaps %" PRIu32 " played %" PRIuz "\n",
+		        stats.underruns, backend.gaps, backend.played);
+		goto fail;
+	}
+
+	if (!test_backend_run(&backend, &arrivals[100], 50, 6000))
+		goto fail;
+
+	test_backend_stats(&backend, &stats);
+	if ((stats.underruns != 1) || (backend.played != ARRAYSIZE(arrivals)) || !backend.ordered ||
+	    (stats.overruns != 0))
+	{
+		fprintf(stderr, "silence: underruns %" PRIu64 " played %" PRIuz "\n", stats.underruns,
+		        backend.played);
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	test_backend_free(&backend);
+	return rc;
+}
+
+/* A burst larger than twice the target plus one wave is dropped, not buffered */
+static BOOL test_drop(void)
+{
+	BOOL rc = FALSE;
+	TestBackend backend = { 0 };
+	RDPSND_PLAYBACK_STATS stats = { 0 };
+
+	if (!test_backend_init(&backend, 50))
+		goto fail;
+
+	for (size_t x = 0; x < 10; x++)
+	{
+		if (!test_backend_send(&backend, 0))
+			goto fail;
+	}
+
+	test_backend_stats(&backend, &stats);
+	if ((backend.dropped != 4) || (stats.overruns != 4) || (stats.buffered != 120))
+	{
+		fprintf(stderr, "drop: dropped %" PRIuz " overruns %" PRIu64 " buffered %" PRIu32 "\n",
+		        backend.dropped, stats.overruns, stats.buffered);
+		goto fail;
+	}
+
+	/* The accepted waves still play in order once the clock runs */
+	if (!test_backend_run(&backend, NULL, 0, 1000))
+		goto fail;
+
+	if ((backend.played != 6) || !backend.ordered)
+	{
+		fprintf(stderr, "drop: played %" PRIuz "\n", backend.played);
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	test_backend_free(&backend);
+	return rc;
+}
+
+/* The target follows the arrival jitter up and back down, bounded by 20 and 500 ms */
+static BOOL test_adaptive_target(void)
+{
+	BOOL rc = FALSE;
+	TestBackend backend = { 0 };
+	UINT64 arrivals[TEST_MAX_WAVES] = { 0 };
+	RDPSND_PLAYBACK_STATS stats = { 0 };
+
+	if (!test_backend_init(&backend, 0))
+		goto fail;
+
+	test_backend_stats(&backend, &stats);
+	if (stats.targetLatency != 20)
+	{
+		fprintf(stderr, "adaptive: minimum target %" PRIu32 "\n", stats.targetLatency);
+		goto fail;
+	}
+
+	/* every other wave is 19 ms late */
+	for (size_t x = 0; x < 200; x++)
+		arrivals[x] = x * TEST_DURATION + ((x % 2) ? 19 : 0);
+
+	if (!test_backend_run(&backend, arrivals, 200, 4100))
+		goto fail;
+
+	test_backend_stats(&backend, &stats);
+	const UINT32 jittered = stats.targetLatency;
+	if ((jittered < 40) || (jittered > 60) || (backend.dropped != 0) || !backend.ordered)
+	{
+		fprintf(stderr, "adaptive: jittered target %" PRIu32 " dropped %" PRIuz "\n", jittered,
+		        backend.dropped);
+		goto fail;
+	}
+
+	/* steady arrivals let the estimate decay back to the minimum */
+	for (size_t x = 0; x < 300; x++)
+		arrivals[x] = 4200 + x * TEST_DURATION;
+
+	if (!test_backend_run(&backend, arrivals, 300, 11000))
+		goto fail;
+
+	test_backend_stats(&backend, &stats);
+	if ((stats.targetLatency != 20) || (backend.played != 500) || !backend.ordered)
+	{
+		fprintf(stderr, "adaptive: steady target %" PRIu32 " played %" PRIuz "\n",
+		        stats.targetLatency, backend.played);
+		goto fail;
+	}
+
+	/* arrivals off by a second saturate the estimate at the maximum target */
+	for (size_t x = 0; x < 200; x++)
+	{
+		backend.now = 12000 + x * TEST_DURATION;
+		if (!test_backend_send(&backend, backend.now + ((x % 2) ? 1000 : 0)))
+			goto fail;
+	}
+
+	test_backend_stats(&backend, &stats);
+	if (stats.targetLatency != 500)
+	{
+		fprintf(stderr, "adaptive: maximum target %" PRIu32 "\n", stats.targetLatency);
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	test_backend_free(&backend);
+	return rc;
+}
+
+int TestRdpsndJitter(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!test_steady())
+		return -1;
+
+	if (!test_underrun())
+		return -1;
+
+	if (!test_drop())
+		return -1;
+
+	if (!test_adaptive_target())
+		return -1;
+
+	return 0;
+}
@@ -19,6 +19,7 @@
 
 #include <memory>
 #include <mutex>
+#include <algorithm>
 #include <iostream>
 
 #include <freerdp/config.h>
@@ -280,17 +281,6 @@ static BOOL sdl_begin_paint(rdpContext* context)
 
 	WINPR_ASSERT(sdl);
 
-	HANDLE handles[] = { sdl->update_complete.handle(), freerdp_abort_event(context) };
-	const DWORD status = WaitForMultipleObjects(ARRAYSIZE(handles), handles, FALSE, INFINITE);
-	switch (status)
-	{
-		case WAIT_OBJECT_0:
-			break;
-		default:
-			return FALSE;
-	}
-	sdl->update_complete.clear();
-
 	gdi = context->gdi;
 	WINPR_ASSERT(gdi);
 	WINPR_ASSERT(gdi->primary);
@@ -311,126 +301,16 @@ static BOOL sdl_redraw(SdlContext* sdl)
 	return gdi_send_suppress_output(gdi, FALSE);
 }
 
-class SdlEventUpdateTriggerGuard
-{
-  private:
-	SdlContext* _sdl;
-
-  public:
-	explicit SdlEventUpdateTriggerGuard(SdlContext* sdl) : _sdl(sdl)
-	{
-	}
-	~SdlEventUpdateTriggerGuard()
-	{
-		_sdl->update_complete.set();
-	}
-};
-
-static bool sdl_draw_to_window_rect(SdlContext* sdl, SdlWindow& window, SDL_Surface* surface,
-                                    SDL_Point offset, const SDL_Rect& srcRect)
-{
-	SDL_Rect dstRect = { offset.x + srcRect.x, offset.y + srcRect.y, srcRect.w, srcRect.h };
-	return window.blit(surface, srcRect, dstRect);
-}
-
-static bool sdl_draw_to_window_rect(SdlContext* sdl, SdlWindow& window, SDL_Surface* surface,
-                                    SDL_Point offset, const std::vector<SDL_Rect>& rects = {})
-{
-	if (rects.empty())
-	{
-		return sdl_draw_to_window_rect(sdl, window, surface, offset,
-		                               { 0, 0, surface->w, surface->h });
-	}
-	for (auto& srcRect : rects)
-	{
-		if (!sdl_draw_to_window_rect(sdl, window, surface, offset, srcRect))
-			return false;
-	}
-	return true;
-}
-
-static bool sdl_draw_to_window_scaled_rect(SdlContext* sdl, SdlWindow& window, SDL_Surface* surface,
-                                           const SDL_Rect& srcRect)
-{
-	SDL_Rect dstRect = srcRect;
-	sdl_scale_coordinates(sdl, window.id(), &dstRect.x, &dstRect.y, FALSE, TRUE);
-	sdl_scale_coordinates(sdl, window.id(), &dstRect.w, &dstRect.h, FALSE, TRUE);
-	return window.blit(surface, srcRect, dstRect);
-}
-
-static BOOL sdl_draw_to_window_scaled_rect(SdlContext* sdl, SdlWindow& window, SDL_Surface* surface,
-                                           const std::vector<SDL_Rect>& rects = {})
-{
-	if (rects.empty())
-	{
-		return sdl_draw_to_window_scaled_rect(sdl, window, surface,
-		                                      { 0, 0, surface->w, surface->h });
-	}
-	for (const auto& srcRect : rects)
-	{
-		if (!sdl_draw_to_window_scaled_rect(sdl, window, surface, srcRect))
-			return FALSE;
-	}
-	return TRUE;
-}
-
-static BOOL sdl_draw_to_window(SdlContext* sdl, SdlWindow& window,
-                               const std::vector<SDL_Rect>& rects = {})
+/* This function is called when the library completed composing a new
+ * frame. Read out the changed areas and blit them to your output device.
+ * The image buffer will have the format specified by gdi_init
+ */
+static BOOL sdl_end_paint(rdpContext* context)
 {
+	auto sdl = get_context(context);
 	WINPR_ASSERT(sdl);
 
-	auto context = sdl->context();
 	auto gdi = context->gdi;
-
-	auto size = window.rect();
-
-	if (!freerdp_settings_get_bool(context->settings, FreeRDP_SmartSizing))
-	{
-		if (gdi->width < size.w)
-		{
-			window.setOffsetX((size.w - gdi->width) / 2);
-		}
-		if (gdi->height < size.h)
-		{
-			window.setOffsetY((size.h - gdi->height) / 2);
-		}
-
-		auto surface = sdl->primary.get();
-		if (!sdl_draw_to_window_rect(sdl, window, surface, { window.offsetX(), window.offsetY() },
-		                             rects))
-			return FALSE;
-	}
-	else
-	{
-		if (!sdl_draw_to_window_scaled_rect(sdl, window, sdl->primary.get(), rects))
-			return FALSE;
-	}
-	window.updateSurface();
-	return TRUE;
-}
-
-static BOOL sdl_draw_to_window(SdlContext* sdl, std::map<Uint32, SdlWindow>& windows,
-                               const std::vector<SDL_Rect>& rects = {})
-{
-	for (auto& window : windows)
-	{
-		if (!sdl_draw_to_window(sdl, window.second, rects))
-			return FALSE;
-	}
-
-	return TRUE;
-}
-
-static BOOL sdl_end_paint_process(rdpContext* context)
-{
-	rdpGdi* gdi = nullptr;
-	auto sdl = get_context(context);
-
-	WINPR_ASSERT(context);
-
-	SdlEventUpdateTriggerGuard guard(sdl);
-
-	gdi = context->gdi;
 	WINPR_ASSERT(gdi);
 	WINPR_ASSERT(gdi->primary);
 	WINPR_ASSERT(gdi->primary->hdc);
@@ -445,29 +325,9 @@ static BOOL sdl_end_paint_process(rdpContext* context)
 	if (ninvalid < 1)
 		return TRUE;
 
-	std::vector<SDL_Rect> rects;
-	for (INT32 x = 0; x < ninvalid; x++)
-	{
-		auto& rgn = cinvalid[x];
-		rects.push_back({ rgn.x, rgn.y, rgn.w, rgn.h });
-	}
-
-	return sdl_draw_to_window(sdl, sdl->windows, rects);
-}
-
-/* This function is called when the library completed composing a new
- * frame. Read out the changed areas and blit them to your output device.
- * The image buffer will have the format specified by gdi_init
- */
-static BOOL sdl_end_paint(rdpContext* context)
-{
-	auto sdl = get_context(context);
-	WINPR_ASSERT(sdl);
-
+	/* the presenter copies the damage, the next frame may be drawn right away */
 	std::lock_guard<CriticalSection> lock(sdl->critical);
-	const BOOL rc = sdl_push_user_event(SDL_EVENT_USER_UPDATE, context);
-
-	return rc;
+	return sdl->presenter.invalidate(sdl->primary.get(), cinvalid, ninvalid) ? TRUE : FALSE;
 }
 
 static void sdl_destroy_primary(SdlContext* sdl)
@@ -504,7 +364,9 @@ static BOOL sdl_create_primary(SdlContext* sdl)
 	SDL_FillSurfaceRect(sdl->primary.get(), nullptr,
 	                    SDL_MapRGBA(sdl->primary_format.get(), 0, 0, 0, 0xff));
 
-	return TRUE;
+	return sdl->presenter.reset(gdi->width, gdi->height, gdi->dstFormat, sdl->sdl_pixel_format)
+	           ? TRUE
+	           : FALSE;
 }
 
 static BOOL sdl_desktop_resize(rdpContext* context)
@@ -671,6 +533,8 @@ static void sdl_cleanup_sdl(SdlContext* sdl)
 	if (!sdl)
 		return;
 
+	sdl->presenter.stop();
+
 	std::lock_guard<CriticalSection> lock(sdl->critical);
 	sdl->windows.clear();
 	sdl->connection_dialog.reset();
@@ -689,6 +553,7 @@ static BOOL sdl_create_windows(SdlContext* sdl)
 	auto settings = sdl->context()->settings;
 	auto title = sdl_window_get_title(settings);
 	BOOL rc = FALSE;
+	float refreshRate = 0.0f;
 
 	UINT32 windowCount = freerdp_settings_get_uint32(settings, FreeRDP_MonitorCount);
 
@@ -745,9 +610,15 @@ static BOOL sdl_create_windows(SdlContext* sdl)
 			window.setOffsetY(0 - r.y);
 		}
 
+		/* pace frames to the fastest display showing the session */
+		auto mode = SDL_GetCurrentDisplayMode(window.displayIndex());
+		if (mode)
+			refreshRate = std::max(refreshRate, mode->refresh_rate);
+
 		sdl->windows.insert({ window.id(), std::move(window) });
 	}
 
+	sdl->presenter.setRefreshRate(refreshRate);
 	rc = TRUE;
 fail:
 
@@ -933,11 +804,8 @@ static int sdl_run(SdlContext* sdl)
 					    reinterpret_cast<const SDL_UserAuthArg*>(windowEvent.padding));
 					break;
 				case SDL_EVENT_USER_UPDATE:
-				{
-					auto context = static_cast<rdpContext*>(windowEvent.user.data1);
-					sdl_end_paint_process(context);
-				}
-				break;
+					sdl->presenter.present();
+					break;
 				case SDL_EVENT_USER_CREATE_WINDOWS:
 				{
 					auto ctx = static_cast<SdlContext*>(windowEvent.user.data1);
@@ -1019,6 +887,7 @@ static int sdl_run(SdlContext* sdl)
 								{
 									window->second.fill();
 									window->second.updateSurface();
+									sdl->presenter.invalidateAll();
 								}
 							}
 							break;
@@ -1095,6 +964,9 @@ static BOOL sdl_post_connect(freerdp* instance)
 	if (!sdl_create_primary(sdl))
 		return FALSE;
 
+	if (!sdl->presenter.start())
+		return FALSE;
+
 	if (!sdl_register_pointer(instance->context->graphics))
 		return FALSE;
 
@@ -1128,6 +1000,10 @@ static void sdl_post_disconnect(freerdp* instance)
 	                                   sdl_OnChannelConnectedEventHandler);
 	PubSub_UnsubscribeChannelDisconnected(instance->context->pubSub,
 	                                      sdl_OnChannelDisconnectedEventHandler);
+
+	auto sdl = get_context(instance->context);
+	if (sdl)
+		sdl->presenter.stop();
 	gdi_free(instance);
 }
 
@@ -1683,9 +1559,9 @@ BOOL SdlContext::update_resizeable(BOOL enable)
 }
 
 SdlContext::SdlContext(rdpContext* context)
-    : _context(context), log(WLog_Get(SDL_TAG)), update_complete(true), disp(this), clip(this),
-      input(this), primary(nullptr, SDL_DestroySurface),
-      primary_format(nullptr, SDL_DestroyPixelFormat)
+    : _context(context), log(WLog_Get(SDL_TAG)), disp(this), clip(this), input(this),
+      primary(nullptr, SDL_DestroySurface), primary_format(nullptr, SDL_DestroyPixelFormat),
+      presenter(this)
 {
 	WINPR_ASSERT(context);
 	grab_kbd_enabled = freerdp_settings_get_bool(context->settings, FreeRDP_GrabKeyboard);
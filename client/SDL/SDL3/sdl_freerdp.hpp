@@ -38,6 +38,7 @@
 #include "sdl_clip.hpp"
 #include "sdl_utils.hpp"
 #include "sdl_window.hpp"
+#include "sdl_presenter.hpp"
 #include "dialogs/sdl_connection_dialog.hpp"
 
 using SDLSurfacePtr = std::unique_ptr<SDL_Surface, decltype(&SDL_DestroySurface)>;
@@ -67,7 +68,6 @@ class SdlContext
 	std::thread thread;
 	WinPREvent initialize;
 	WinPREvent initialized;
-	WinPREvent update_complete;
 	WinPREvent windows_created;
 	int exit_code = -1;
 
@@ -77,6 +77,7 @@ class SdlContext
 
 	SDLSurfacePtr primary;
 	SDLPixelFormatPtr primary_format;
+	SdlPresenter presenter;
 
 	SDL_PixelFormatEnum sdl_pixel_format = SDL_PIXELFORMAT_UNKNOWN;
 
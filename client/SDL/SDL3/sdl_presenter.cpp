@@ -0,0 +1,616 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * SDL Client presentation pipeline
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+#include <winpr/assert.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/log.h>
+#include <freerdp/metrics.h>
+#include <freerdp/codec/color.h>
+
+#include "sdl_presenter.hpp"
+#include "sdl_freerdp.hpp"
+#include "sdl_utils.hpp"
+
+#define TAG CLIENT_TAG("SDL.presenter")
+
+static const UINT64 SDL_DEFAULT_FRAME_INTERVAL_NS = 1000000000ull / 60;
+
+SdlPresenter::SdlPresenter(SdlContext* sdl) : _sdl(sdl), _log(WLog_Get(TAG))
+{
+	WINPR_ASSERT(sdl);
+	region16_init(&_pending);
+	region16_init(&_ready);
+	region16_init(&_frame);
+	region16_init(&_stale);
+	_stats.targetIntervalNS = SDL_DEFAULT_FRAME_INTERVAL_NS;
+}
+
+SdlPresenter::~SdlPresenter()
+{
+	stop();
+
+	dropScaleBuffers();
+	for (auto& target : _targets)
+		SDL_DestroySurface(target.second.surface);
+	SDL_DestroySurface(_source);
+	region16_uninit(&_stale);
+	region16_uninit(&_frame);
+	region16_uninit(&_ready);
+	region16_uninit(&_pending);
+}
+
+bool SdlPresenter::start()
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	if (_running)
+		return true;
+
+	_running = true;
+	_thread = std::thread([this]() { run(); });
+	return true;
+}
+
+void SdlPresenter::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		_running = false;
+	}
+	_cond.notify_all();
+
+	if (!_thread.joinable())
+		return;
+	_thread.join();
+
+	const auto stats = this->stats();
+	WLog_Print(_log, WLOG_DEBUG,
+	           "%" PRIu64 " frames composed, %" PRIu64 " presented with %" PRIu64 " rects, %" PRIu64
+	           " pixels, latency avg %" PRIu64 " us, max %" PRIu64 " us",
+	           stats.paints, stats.presents, stats.rects, stats.pixels,
+	           stats.presents ? stats.totalLatencyNS / stats.presents / 1000 : 0,
+	           stats.maxLatencyNS / 1000);
+}
+
+bool SdlPresenter::reset(UINT32 width, UINT32 height, UINT32 format, SDL_PixelFormatEnum sdlFormat)
+{
+	std::lock_guard<std::mutex> lock(_lock);
+
+	for (auto& target : _targets)
+		SDL_DestroySurface(target.second.surface);
+	_targets.clear();
+	_generation++;
+
+	SDL_DestroySurface(_source);
+	_source = SDL_CreateSurface(static_cast<int>(width), static_cast<int>(height), sdlFormat);
+	if (!_source)
+		return false;
+
+	SDL_SetSurfaceBlendMode(_source, SDL_BLENDMODE_NONE);
+	_format = format;
+	_sdlFormat = sdlFormat;
+
+	/* damage of the old buffer does not apply any more */
+	region16_clear(&_pending);
+	region16_clear(&_ready);
+	_pendingSince = 0;
+	invalidateAllLocked();
+	return true;
+}
+
+bool SdlPresenter::invalidate(SDL_Surface* primary, const GDI_RGN* rgns, INT32 count)
+{
+	WINPR_ASSERT(rgns || (count <= 0));
+
+	std::vector<RECTANGLE_16> rects;
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		if (!_source || !primary)
+			return false;
+
+		_stats.paints++;
+		rects.reserve(static_cast<size_t>(std::max(count, 0)));
+
+		for (INT32 x = 0; x < count; x++)
+		{
+			const GDI_RGN* rgn = &rgns[x];
+			const INT32 left = std::max(rgn->x, 0);
+			const INT32 top = std::max(rgn->y, 0);
+			const INT32 right = std::min(rgn->x + rgn->w, _source->w);
+			const INT32 bottom = std::min(rgn->y + rgn->h, _source->h);
+
+			if ((left >= right) || (top >= bottom))
+				continue;
+
+			/* copy now, the RDP thread draws the next frame into primary right after this */
+			SDL_Rect srcRect = { left, top, right - left, bottom - top };
+			SDL_Rect dstRect = srcRect;
+			if (SDL_BlitSurface(primary, &srcRect, _source, &dstRect) != 0)
+				return false;
+
+			rects.push_back({ static_cast<UINT16>(left), static_cast<UINT16>(top),
+			                  static_cast<UINT16>(right), static_cast<UINT16>(bottom) });
+		}
+
+		if (rects.empty())
+			return true;
+
+		if (!region16_union_rects(&_pending, &_pending, rects.data(),
+		                          static_cast<UINT32>(rects.size())))
+			return false;
+
+		if (_pendingSince == 0)
+			_pendingSince = winpr_GetTickCount64NS();
+	}
+
+	_cond.notify_all();
+	return true;
+}
+
+void SdlPresenter::invalidateAll()
+{
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		invalidateAllLocked();
+	}
+	_cond.notify_all();
+}
+
+void SdlPresenter::invalidateAllLocked()
+{
+	if (!_source)
+		return;
+
+	const RECTANGLE_16 full = { 0, 0, static_cast<UINT16>(_source->w),
+		                        static_cast<UINT16>(_source->h) };
+	region16_union_rect(&_pending, &_pending, &full);
+	if (_pendingSince == 0)
+		_pendingSince = winpr_GetTickCount64NS();
+}
+
+void SdlPresenter::setRefreshRate(float hz)
+{
+	if (hz <= 0.0f)
+		return;
+
+	std::lock_guard<std::mutex> lock(_lock);
+	_stats.targetIntervalNS = static_cast<UINT64>(1000000000.0 / hz);
+}
+
+SdlPresenter::Stats SdlPresenter::stats() const
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	return _stats;
+}
+
+void SdlPresenter::run()
+{
+	auto settings = _sdl->context()->settings;
+	std::unique_lock<std::mutex> lock(_lock);
+
+	while (true)
+	{
+		_cond.wait(lock, [this]() {
+			return !_running || (!_inFlight && !region16_is_empty(&_pending));
+		});
+		if (!_running)
+			break;
+
+		/* small updates arriving until the display refreshes are coalesced into one frame */
+		const UINT64 now = winpr_GetTickCount64NS();
+		const UINT64 due = _lastPresent + _stats.targetIntervalNS;
+		if (due > now)
+		{
+			_cond.wait_for(lock, std::chrono::nanoseconds(due - now),
+			               [this]() { return !_running; });
+			if (!_running)
+				break;
+		}
+
+		if (!region16_copy(&_frame, &_pending))
+		{
+			WLog_Print(_log, WLOG_ERROR, "failed to take the damaged region");
+			break;
+		}
+		region16_clear(&_pending);
+		const UINT64 since = _pendingSince;
+		_pendingSince = 0;
+
+		if (freerdp_settings_get_bool(settings, FreeRDP_SmartSizing))
+		{
+			/* only the copy of the damage and the buffer swap hold the lock, EndPaint and the
+			 * event thread continue while the frame is scaled */
+			const UINT64 generation = _generation;
+			if (prepareScale())
+			{
+				lock.unlock();
+				const bool scaled = scaleFrame();
+				lock.lock();
+
+				if (!scaled)
+					WLog_Print(_log, WLOG_WARN, "failed to scale the frame");
+
+				/* reset() replaced the buffers and invalidated them while scaling */
+				if (generation != _generation)
+					continue;
+				swapScaled();
+			}
+			else
+			{
+				/* rebuilt from the whole gdi buffer on the next refresh */
+				WLog_Print(_log, WLOG_WARN, "failed to prepare the scaling buffers");
+				dropScaleBuffers();
+			}
+		}
+		else
+			dropScaleBuffers();
+
+		if (!region16_copy(&_ready, &_frame))
+		{
+			WLog_Print(_log, WLOG_ERROR, "failed to hand over the damaged region");
+			break;
+		}
+		_readySince = since;
+
+		_inFlight = true;
+		lock.unlock();
+		const BOOL pushed = sdl_push_user_event(SDL_EVENT_USER_UPDATE, _sdl->context());
+		lock.lock();
+
+		if (!pushed)
+		{
+			/* the event queue is full, retry with the damage of this frame on the next refresh */
+			UINT32 count = 0;
+			const RECTANGLE_16* rects = region16_rects(&_ready, &count);
+			region16_union_rects(&_pending, &_pending, rects, count);
+			region16_clear(&_ready);
+			if (_pendingSince == 0)
+				_pendingSince = _readySince;
+			_inFlight = false;
+			_cond.wait_for(lock, std::chrono::nanoseconds(_stats.targetIntervalNS),
+			               [this]() { return !_running; });
+		}
+	}
+}
+
+bool SdlPresenter::prepareScale()
+{
+	if (!_source)
+		return false;
+
+	/* the snapshot keeps the state of the gdi buffer the frame was taken at */
+	UINT32 count = 0;
+	const RECTANGLE_16* rects = region16_rects(&_frame, &count);
+	const RECTANGLE_16 full = { 0, 0, static_cast<UINT16>(_source->w),
+		                        static_cast<UINT16>(_source->h) };
+
+	if (!_snapshot || (_snapshot->w != _source->w) || (_snapshot->h != _source->h) ||
+	    (_snapshot->format->format != _sdlFormat))
+	{
+		SDL_DestroySurface(_snapshot);
+		_snapshot = SDL_CreateSurface(_source->w, _source->h, _sdlFormat);
+		if (!_snapshot)
+			return false;
+
+		SDL_SetSurfaceBlendMode(_snapshot, SDL_BLENDMODE_NONE);
+		rects = &full;
+		count = 1;
+	}
+	_snapshotFormat = _format;
+
+	for (UINT32 x = 0; x < count; x++)
+	{
+		const RECTANGLE_16* rect = &rects[x];
+		SDL_Rect srcRect = { rect->left, rect->top, rect->right - rect->left,
+			                 rect->bottom - rect->top };
+		SDL_Rect dstRect = srcRect;
+		if (SDL_BlitSurface(_source, &srcRect, _snapshot, &dstRect) != 0)
+			return false;
+	}
+
+	/* back buffers of windows that are gone or not sized yet are not needed */
+	for (auto it = _backs.begin(); it != _backs.end();)
+	{
+		auto target = _targets.find(it->first);
+		if ((target == _targets.end()) || !target->second.surface)
+		{
+			SDL_DestroySurface(it->second.surface);
+			it = _backs.erase(it);
+		}
+		else
+			++it;
+	}
+
+	for (auto& it : _targets)
+	{
+		const auto front = it.second.surface;
+		if (!front)
+			continue;
+
+		auto& back = _backs[it.first];
+		back.rects.clear();
+		if (back.surface && (back.surface->w == front->w) && (back.surface->h == front->h) &&
+		    (back.surface->format->format == _sdlFormat))
+			continue;
+
+		SDL_DestroySurface(back.surface);
+		back.surface = SDL_CreateSurface(front->w, front->h, _sdlFormat);
+		if (!back.surface)
+			return false;
+
+		/* a new back buffer holds nothing, all of it is scaled */
+		SDL_SetSurfaceBlendMode(back.surface, SDL_BLENDMODE_NONE);
+		if (!region16_union_rect(&_stale, &_stale, &full))
+			return false;
+	}
+
+	return true;
+}
+
+bool SdlPresenter::scaleFrame()
+{
+	bool rc = true;
+	UINT32 staleCount = 0;
+	const RECTANGLE_16* stale = region16_rects(&_stale, &staleCount);
+	UINT32 count = 0;
+	const RECTANGLE_16* rects = region16_rects(&_frame, &count);
+
+	for (auto& it : _backs)
+	{
+		/* the back buffer was shown before the last frame, bring it up to date first */
+		if (!scale(it.second, stale, staleCount, false))
+			rc = false;
+		if (!scale(it.second, rects, count, true))
+			rc = false;
+	}
+
+	return rc;
+}
+
+bool SdlPresenter::scale(Target& back, const RECTANGLE_16* rects, UINT32 count, bool present)
+{
+	bool rc = true;
+	auto surface = back.surface;
+
+	WINPR_ASSERT(_snapshot);
+	WINPR_ASSERT(surface);
+
+	const double sx = surface->w / static_cast<double>(_snapshot->w);
+	const double sy = surface->h / static_cast<double>(_snapshot->h);
+
+	for (UINT32 x = 0; x < count; x++)
+	{
+		const RECTANGLE_16* rect = &rects[x];
+		const int left = static_cast<int>(std::floor(rect->left * sx));
+		const int top = static_cast<int>(std::floor(rect->top * sy));
+		const int right = std::min(static_cast<int>(std::ceil(rect->right * sx)), surface->w);
+		const int bottom = std::min(static_cast<int>(std::ceil(rect->bottom * sy)), surface->h);
+
+		if ((left >= right) || (top >= bottom))
+			continue;
+
+		SDL_Rect srcRect = { rect->left, rect->top, rect->right - rect->left,
+			                 rect->bottom - rect->top };
+		SDL_Rect dstRect = { left, top, right - left, bottom - top };
+
+		/* freerdp_image_scale uses the vectorized swscale path where available */
+		if (!_useSdlScaler)
+		{
+			auto dst = static_cast<BYTE*>(surface->pixels);
+			auto src = static_cast<const BYTE*>(_snapshot->pixels);
+			const auto dstStep = static_cast<UINT32>(surface->pitch);
+			const auto srcStep = static_cast<UINT32>(_snapshot->pitch);
+
+			if (!freerdp_image_scale(dst, _snapshotFormat, dstStep, static_cast<UINT32>(dstRect.x),
+			                         static_cast<UINT32>(dstRect.y), static_cast<UINT32>(dstRect.w),
+			                         static_cast<UINT32>(dstRect.h), src, _snapshotFormat, srcStep,
+			                         rect->left, rect->top, static_cast<UINT32>(srcRect.w),
+			                         static_cast<UINT32>(srcRect.h)))
+			{
+				WLog_Print(_log, WLOG_DEBUG, "image scaling failed, using the SDL scaler");
+				_useSdlScaler = true;
+			}
+		}
+
+		if (_useSdlScaler && (SDL_BlitSurfaceScaled(_snapshot, &srcRect, surface, &dstRect,
+		                                            SDL_SCALEMODE_LINEAR) != 0))
+		{
+			rc = false;
+			continue;
+		}
+
+		if (present)
+			back.rects.push_back({ left, top, right - left, bottom - top });
+	}
+
+	return rc;
+}
+
+void SdlPresenter::swapScaled()
+{
+	for (auto& it : _backs)
+	{
+		auto target = _targets.find(it.first);
+		if (target == _targets.end())
+			continue;
+
+		auto& front = target->second;
+		auto& back = it.second;
+		if (!front.surface || (front.surface->w != back.surface->w) ||
+		    (front.surface->h != back.surface->h))
+		{
+			/* the window was resized while scaling, presentScaled scales all of it again */
+			front.rects.clear();
+			continue;
+		}
+
+		std::swap(front.surface, back.surface);
+		std::swap(front.rects, back.rects);
+	}
+
+	/* the old front buffers lack this frame */
+	if (!region16_copy(&_stale, &_frame))
+	{
+		WLog_Print(_log, WLOG_WARN, "failed to track the damage of the back buffers");
+		dropScaleBuffers();
+	}
+}
+
+void SdlPresenter::dropScaleBuffers()
+{
+	for (auto& it : _backs)
+		SDL_DestroySurface(it.second.surface);
+	_backs.clear();
+	SDL_DestroySurface(_snapshot);
+	_snapshot = nullptr;
+	region16_clear(&_stale);
+}
+
+bool SdlPresenter::presentScaled(SdlWindow& window, SDL_Surface* screen,
+                                 std::vector<SDL_Rect>& dstRects)
+{
+	auto& target = _targets[window.id()];
+
+	if (!target.surface || (target.surface->w != screen->w) || (target.surface->h != screen->h))
+	{
+		/* new window size, scale the whole frame for it on the next refresh */
+		SDL_DestroySurface(target.surface);
+		target.rects.clear();
+		target.surface = SDL_CreateSurface(screen->w, screen->h, _sdlFormat);
+		if (!target.surface)
+			return false;
+
+		SDL_SetSurfaceBlendMode(target.surface, SDL_BLENDMODE_NONE);
+		invalidateAllLocked();
+		return true;
+	}
+
+	for (const auto& rect : target.rects)
+	{
+		SDL_Rect srcRect = rect;
+		SDL_Rect dstRect = rect;
+		if (SDL_BlitSurface(target.surface, &srcRect, screen, &dstRect) != 0)
+			return false;
+		dstRects.push_back(dstRect);
+	}
+
+	return true;
+}
+
+bool SdlPresenter::present()
+{
+	bool rc = true;
+	std::unique_lock<std::mutex> lock(_lock);
+	auto context = _sdl->context();
+	UINT32 count = 0;
+	const RECTANGLE_16* rects = region16_rects(&_ready, &count);
+	bool presented = false;
+	UINT64 frameRects = 0;
+	UINT64 framePixels = 0;
+	UINT64 latency = 0;
+	UINT64 interval = 0;
+
+	if (_source && (count > 0))
+	{
+		const BOOL smartSizing = freerdp_settings_get_bool(context->settings, FreeRDP_SmartSizing);
+
+		for (auto& it : _sdl->windows)
+		{
+			auto& window = it.second;
+			auto screen = SDL_GetWindowSurface(window.window());
+			if (!screen)
+				continue;
+
+			std::vector<SDL_Rect> dstRects;
+			if (smartSizing)
+			{
+				if (!presentScaled(window, screen, dstRects))
+					rc = false;
+			}
+			else
+			{
+				const auto size = window.rect();
+				if (_source->w < size.w)
+					window.setOffsetX((size.w - _source->w) / 2);
+				if (_source->h < size.h)
+					window.setOffsetY((size.h - _source->h) / 2);
+
+				for (UINT32 x = 0; x < count; x++)
+				{
+					const RECTANGLE_16* rect = &rects[x];
+					SDL_Rect srcRect = { rect->left, rect->top, rect->right - rect->left,
+						                 rect->bottom - rect->top };
+					SDL_Rect dstRect = { window.offsetX() + srcRect.x, window.offsetY() + srcRect.y,
+						                 srcRect.w, srcRect.h };
+
+					/* the blit clips dstRect to the part that was drawn */
+					if (SDL_BlitSurface(_source, &srcRect, screen, &dstRect) != 0)
+					{
+						rc = false;
+						break;
+					}
+
+					if ((dstRect.w > 0) && (dstRect.h > 0))
+						dstRects.push_back(dstRect);
+				}
+			}
+
+			if (dstRects.empty())
+				continue;
+
+			if (SDL_UpdateWindowSurfaceRects(window.window(), dstRects.data(),
+			                                 static_cast<int>(dstRects.size())) != 0)
+				rc = false;
+
+			frameRects += dstRects.size();
+			for (const auto& rect : dstRects)
+				framePixels += 1ull * static_cast<UINT32>(rect.w) * static_cast<UINT32>(rect.h);
+		}
+
+		const UINT64 now = winpr_GetTickCount64NS();
+		latency = now - _readySince;
+		if (_lastPresent != 0)
+			interval = now - _lastPresent;
+		_lastPresent = now;
+		presented = true;
+
+		_stats.presents++;
+		_stats.rects += frameRects;
+		_stats.pixels += framePixels;
+		_stats.lastLatencyNS = latency;
+		_stats.totalLatencyNS += latency;
+		_stats.maxLatencyNS = std::max(_stats.maxLatencyNS, latency);
+		if (interval != 0)
+			_stats.lastIntervalNS = interval;
+	}
+
+	region16_clear(&_ready);
+	_inFlight = false;
+	lock.unlock();
+
+	_cond.notify_all();
+
+	/* reported next to the decode times of the gdi, see freerdp_metrics_snapshot */
+	if (presented)
+		freerdp_metrics_frame_presented(context->metrics, latency, interval, frameRects,
+		                                framePixels);
+	return rc;
+}
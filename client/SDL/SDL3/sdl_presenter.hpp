@@ -0,0 +1,136 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * SDL Client presentation pipeline
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+#include <winpr/wtypes.h>
+#include <freerdp/gdi/gdi.h>
+#include <freerdp/codec/region.h>
+
+#include <SDL3/SDL.h>
+
+#include "sdl_types.hpp"
+#include "sdl_window.hpp"
+
+/** Moves the frames composed by the RDP thread to the windows.
+ *
+ *  The RDP thread copies the damaged rectangles of the gdi buffer at EndPaint and continues.
+ *  Damage is collected until the next display refresh, a presenter thread then scales it for
+ *  SmartSizing into back buffers and swaps them with the ones of the windows. The event thread
+ *  pushes only the damaged window rectangles to the display.
+ */
+class SdlPresenter
+{
+  public:
+	struct Stats
+	{
+		UINT64 paints = 0;           /**< frames composed by the RDP thread */
+		UINT64 presents = 0;         /**< frames pushed to the windows */
+		UINT64 rects = 0;            /**< window rectangles updated */
+		UINT64 pixels = 0;           /**< window pixels updated */
+		UINT64 lastLatencyNS = 0;    /**< first damage to window update of the last frame */
+		UINT64 maxLatencyNS = 0;     /**< highest latency seen */
+		UINT64 totalLatencyNS = 0;   /**< sum of all latencies */
+		UINT64 lastIntervalNS = 0;   /**< time between the last two window updates */
+		UINT64 targetIntervalNS = 0; /**< display refresh interval the frames are paced to */
+	};
+
+	explicit SdlPresenter(SdlContext* sdl);
+	~SdlPresenter();
+
+	bool start();
+	void stop();
+
+	/** @brief (re)create the copy of the gdi buffer, called with the gdi buffer locked */
+	bool reset(UINT32 width, UINT32 height, UINT32 format, SDL_PixelFormatEnum sdlFormat);
+
+	/** @brief copy the damaged rectangles of \b primary, called from EndPaint */
+	bool invalidate(SDL_Surface* primary, const GDI_RGN* rgns, INT32 count);
+
+	/** @brief redraw all windows, e.g. after they were resized */
+	void invalidateAll();
+
+	/** @brief pace frames to a display refresh rate of \b hz */
+	void setRefreshRate(float hz);
+
+	/** @brief update the windows with the last frame, called from the event thread */
+	bool present();
+
+	[[nodiscard]] Stats stats() const;
+
+  private:
+	struct Target
+	{
+		SDL_Surface* surface = nullptr;
+		std::vector<SDL_Rect> rects;
+	};
+
+	void run();
+	void invalidateAllLocked();
+	bool prepareScale();
+	bool scaleFrame();
+	bool scale(Target& back, const RECTANGLE_16* rects, UINT32 count, bool present);
+	void swapScaled();
+	void dropScaleBuffers();
+	bool presentScaled(SdlWindow& window, SDL_Surface* screen, std::vector<SDL_Rect>& dstRects);
+
+	SdlContext* _sdl;
+	wLog* _log;
+
+	mutable std::mutex _lock;
+	std::condition_variable _cond;
+	std::thread _thread;
+	bool _running = false;
+	bool _inFlight = false;
+	bool _useSdlScaler = false;
+
+	/* damage collected from the RDP thread until the next refresh */
+	REGION16 _pending = {};
+	UINT64 _pendingSince = 0;
+
+	/* damage of the frame waiting for the event thread */
+	REGION16 _ready = {};
+	UINT64 _readySince = 0;
+	UINT64 _lastPresent = 0;
+
+	SDL_Surface* _source = nullptr;
+	UINT32 _format = 0;
+	SDL_PixelFormatEnum _sdlFormat = SDL_PIXELFORMAT_UNKNOWN;
+	std::map<Uint32, Target> _targets;
+	UINT64 _generation = 0;
+
+	/* owned by the presenter thread, scaled without holding the lock */
+	REGION16 _frame = {};
+	REGION16 _stale = {}; /**< damage of the last frame the back buffers do not have yet */
+	SDL_Surface* _snapshot = nullptr;
+	UINT32 _snapshotFormat = 0;
+	std::map<Uint32, Target> _backs;
+
+	Stats _stats;
+
+  private:
+	SdlPresenter(const SdlPresenter& other) = delete;
+	SdlPresenter(SdlPresenter&& other) = delete;
+	SdlPresenter& operator=(const SdlPresenter& other) = delete;
+	SdlPresenter& operator=(SdlPresenter&& other) = delete;
+};
@@ -103,6 +103,7 @@
 #include "xf_channels.h"
 #include "xfreerdp.h"
 #include "xf_utils.h"
+#include "xf_shm.h"
 
 #include <freerdp/log.h>
 #define TAG CLIENT_TAG("x11")
@@ -399,8 +400,8 @@ static BOOL xf_paint(xfContext* xfc, const GDI_RGN* region)
 	}
 	else
 	{
-		XPutImage(xfc->display, xfc->primary, xfc->gc, xfc->image, region->x, region->y, region->x,
-		          region->y, region->w, region->h);
+		xf_shm_put_image(xfc, xfc->primary, xfc->gc, xfc->image, region->x, region->y, region->x,
+		                 region->y, region->w, region->h);
 		xf_draw_screen(xfc, region->x, region->y, region->w, region->h);
 	}
 	return TRUE;
@@ -415,6 +416,8 @@ static BOOL xf_end_paint(rdpContext* context)
 		return TRUE;
 
 	HGDI_DC hdc = gdi->primary->hdc;
+	const UINT64 start = winpr_GetTickCount64NS();
+	UINT64 pixels = 0;
 
 	if (!xfc->complex_regions)
 	{
@@ -424,7 +427,7 @@ static BOOL xf_end_paint(rdpContext* context)
 		xf_lock_x11(xfc);
 		if (!xf_paint(xfc, rgn))
 			return FALSE;
-		xf_unlock_x11(xfc);
+		pixels += 1ull * rgn->w * rgn->h;
 	}
 	else
 	{
@@ -441,12 +444,19 @@ static BOOL xf_end_paint(rdpContext* context)
 			const GDI_RGN* rgn = &cinvalid[i];
 			if (!xf_paint(xfc, rgn))
 				return FALSE;
+			pixels += 1ull * rgn->w * rgn->h;
 		}
 
 		XFlush(xfc->display);
-		xf_unlock_x11(xfc);
 	}
 
+	/* The X server reads shared memory asynchronously, it must be done before
+	 * the next update modifies the framebuffer */
+	if (xf_shm_image_is_shared(xfc->image))
+		XSync(xfc->display, False);
+	xf_unlock_x11(xfc);
+	xf_shm_frame_done(xfc, start, pixels);
+
 	hdc->hwnd->invalid->null = TRUE;
 	hdc->hwnd->ninvalid = 0;
 	return TRUE;
@@ -460,26 +470,37 @@ static BOOL xf_sw_desktop_resize(rdpContext* context)
 	BOOL ret = FALSE;
 	xf_lock_x11(xfc);
 
-	if (!gdi_resize(gdi, freerdp_settings_get_uint32(settings, FreeRDP_DesktopWidth),
-	                freerdp_settings_get_uint32(settings, FreeRDP_DesktopHeight)))
-		goto out;
+	const UINT32 width = freerdp_settings_get_uint32(settings, FreeRDP_DesktopWidth);
+	const UINT32 height = freerdp_settings_get_uint32(settings, FreeRDP_DesktopHeight);
+	XImage* image = xf_shm_create_image(xfc, width, height);
 
-	if (xfc->image)
+	if (image)
 	{
-		xfc->image->data = NULL;
-		XDestroyImage(xfc->image);
+		if (!gdi_resize_ex(gdi, width, height, image->bytes_per_line, 0, (BYTE*)image->data, NULL))
+		{
+			xf_shm_destroy_image(xfc, image);
+			goto out;
+		}
 	}
+	else if (!gdi_resize(gdi, width, height))
+		goto out;
 
-	WINPR_ASSERT(xfc->depth != 0);
-	if (!(xfc->image = XCreateImage(xfc->display, xfc->visual, xfc->depth, ZPixmap, 0,
-	                                (char*)gdi->primary_buffer, gdi->width, gdi->height,
-	                                xfc->scanline_pad, gdi->stride)))
+	xf_shm_destroy_image(xfc, xfc->image);
+	xfc->image = image;
+
+	if (!xfc->image)
 	{
-		goto out;
-	}
+		WINPR_ASSERT(xfc->depth != 0);
+		if (!(xfc->image = XCreateImage(xfc->display, xfc->visual, xfc->depth, ZPixmap, 0,
+		                                (char*)gdi->primary_buffer, gdi->width, gdi->height,
+		                                xfc->scanline_pad, gdi->stride)))
+		{
+			goto out;
+		}
 
-	xfc->image->byte_order = LSBFirst;
-	xfc->image->bitmap_bit_order = LSBFirst;
+		xfc->image->byte_order = LSBFirst;
+		xfc->image->bitmap_bit_order = LSBFirst;
+	}
 	ret = xf_desktop_resize(context);
 out:
 	xf_unlock_x11(xfc);
@@ -685,6 +706,32 @@ BOOL xf_create_window(xfContext* xfc)
 	return TRUE;
 }
 
+/* Place the GDI framebuffer in a MIT-SHM segment if possible, xf_create_image
+ * wraps a plain buffer otherwise */
+static BOOL xf_gdi_init(xfContext* xfc)
+{
+	WINPR_ASSERT(xfc);
+
+	freerdp* instance = xfc->common.context.instance;
+	const rdpSettings* settings = xfc->common.context.settings;
+	const UINT32 format = xf_get_local_color_format(xfc, TRUE);
+
+	xf_shm_init(xfc);
+	xfc->image =
+	    xf_shm_create_image(xfc, freerdp_settings_get_uint32(settings, FreeRDP_DesktopWidth),
+	                        freerdp_settings_get_uint32(settings, FreeRDP_DesktopHeight));
+	if (!xfc->image)
+		return gdi_init(instance, format);
+
+	if (!gdi_init_ex(instance, format, xfc->image->bytes_per_line, (BYTE*)xfc->image->data, NULL))
+	{
+		xf_shm_destroy_image(xfc, xfc->image);
+		xfc->image = NULL;
+		return FALSE;
+	}
+	return TRUE;
+}
+
 BOOL xf_create_image(xfContext* xfc)
 {
 	WINPR_ASSERT(xfc);
@@ -722,12 +769,8 @@ static void xf_window_free(xfContext* xfc)
 	}
 #endif
 
-	if (xfc->image)
-	{
-		xfc->image->data = NULL;
-		XDestroyImage(xfc->image);
-		xfc->image = NULL;
-	}
+	xf_shm_destroy_image(xfc, xfc->image);
+	xfc->image = NULL;
 
 	if (xfc->bitmap_mono)
 	{
@@ -1333,7 +1376,7 @@ static BOOL xf_post_connect(freerdp* instance)
 	if (!xf_get_pixmap_info(xfc))
 		return FALSE;
 
-	if (!gdi_init(instance, xf_get_local_color_format(xfc, TRUE)))
+	if (!xf_gdi_init(xfc))
 		return FALSE;
 
 	if (!xf_create_image(xfc))
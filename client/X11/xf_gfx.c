@@ -23,9 +23,11 @@
 
 #include <math.h>
 #include <winpr/assert.h>
+#include <winpr/sysinfo.h>
 #include <freerdp/log.h>
 #include "xf_gfx.h"
 #include "xf_rail.h"
+#include "xf_shm.h"
 
 #include <X11/Xutil.h>
 
@@ -70,6 +72,9 @@ static UINT xf_OutputUpdate(xfContext* xfc, xfGfxSurface* surface)
 	if (!(rects = region16_rects(&surface->gdi.invalidRegion, &nbRects)))
 		return CHANNEL_RC_OK;
 
+	const UINT64 start = winpr_GetTickCount64NS();
+	UINT64 pixels = 0;
+
 	for (UINT32 x = 0; x < nbRects; x++)
 	{
 		const RECTANGLE_16* rect = &rects[x];
@@ -82,6 +87,7 @@ static UINT xf_OutputUpdate(xfContext* xfc, xfGfxSurface* surface)
 		const UINT32 dwidth = swidth * sx;
 		const UINT32 dheight = sheight * sy;
 
+		pixels += 1ull * dwidth * dheight;
 		if (surface->stage)
 		{
 			if (!freerdp_image_scale(surface->stage, gdi->dstFormat, surface->stageScanline, nXSrc,
@@ -92,8 +98,8 @@ static UINT xf_OutputUpdate(xfContext* xfc, xfGfxSurface* surface)
 
 		if (xfc->remote_app)
 		{
-			XPutImage(xfc->display, xfc->primary, xfc->gc, surface->image, nXSrc, nYSrc, nXDst,
-			          nYDst, dwidth, dheight);
+			xf_shm_put_image(xfc, xfc->primary, xfc->gc, surface->image, nXSrc, nYSrc, nXDst,
+			                 nYDst, dwidth, dheight);
 			xf_lock_x11(xfc);
 			xf_rail_paint_surface(xfc, surface->gdi.windowId, rect);
 			xf_unlock_x11(xfc);
@@ -103,15 +109,15 @@ static UINT xf_OutputUpdate(xfContext* xfc, xfGfxSurface* surface)
 		    if (freerdp_settings_get_bool(settings, FreeRDP_SmartSizing) ||
 		        freerdp_settings_get_bool(settings, FreeRDP_MultiTouchGestures))
 		{
-			XPutImage(xfc->display, xfc->primary, xfc->gc, surface->image, nXSrc, nYSrc, nXDst,
-			          nYDst, dwidth, dheight);
+			xf_shm_put_image(xfc, xfc->primary, xfc->gc, surface->image, nXSrc, nYSrc, nXDst,
+			                 nYDst, dwidth, dheight);
 			xf_draw_screen(xfc, nXDst, nYDst, dwidth, dheight);
 		}
 		else
 #endif
 		{
-			XPutImage(xfc->display, xfc->drawable, xfc->gc, surface->image, nXSrc, nYSrc, nXDst,
-			          nYDst, dwidth, dheight);
+			xf_shm_put_image(xfc, xfc->drawable, xfc->gc, surface->image, nXSrc, nYSrc, nXDst,
+			                 nYDst, dwidth, dheight);
 		}
 	}
 
@@ -120,6 +126,7 @@ fail:
 	region16_clear(&surface->gdi.invalidRegion);
 	XSetClipMask(xfc->display, xfc->gc, None);
 	XSync(xfc->display, False);
+	xf_shm_frame_done(xfc, start, pixels);
 	return rc;
 }
 
@@ -260,6 +267,46 @@ static UINT32 x11_pad_scanline(UINT32 scanline, UINT32 inPad)
 	return scanline;
 }
 
+static BOOL xf_gfx_surface_alloc_data(xfContext* xfc, xfGfxSurface* surface)
+{
+	WINPR_ASSERT(xfc);
+	WINPR_ASSERT(surface);
+
+	surface->gdi.scanline = surface->gdi.width * FreeRDPGetBytesPerPixel(surface->gdi.format);
+	surface->gdi.scanline = x11_pad_scanline(surface->gdi.scanline, xfc->scanline_pad);
+	const size_t size = 1ull * surface->gdi.scanline * surface->gdi.height;
+	surface->gdi.data = (BYTE*)winpr_aligned_malloc(size, 16);
+
+	if (!surface->gdi.data)
+	{
+		WLog_ERR(TAG, "unable to allocate GDI data");
+		return FALSE;
+	}
+
+	ZeroMemory(surface->gdi.data, size);
+	return TRUE;
+}
+
+/* Either the GDI data or the stage buffer may be owned by a MIT-SHM image */
+static void xf_gfx_surface_free_buffers(xfContext* xfc, xfGfxSurface* surface)
+{
+	WINPR_ASSERT(xfc);
+	WINPR_ASSERT(surface);
+
+	const BYTE* shared =
+	    xf_shm_image_is_shared(surface->image) ? (const BYTE*)surface->image->data : NULL;
+
+	if (surface->gdi.data != shared)
+		winpr_aligned_free(surface->gdi.data);
+	if (surface->stage != shared)
+		winpr_aligned_free(surface->stage);
+	xf_shm_destroy_image(xfc, surface->image);
+
+	surface->gdi.data = NULL;
+	surface->stage = NULL;
+	surface->image = NULL;
+}
+
 /**
  * Function description
  *
@@ -310,54 +357,68 @@ static UINT xf_CreateSurface(RdpgfxClientContext* context,
 			goto out_free;
 	}
 
-	surface->gdi.scanline = surface->gdi.width * FreeRDPGetBytesPerPixel(surface->gdi.format);
-	surface->gdi.scanline = x11_pad_scanline(surface->gdi.scanline, xfc->scanline_pad);
-	size = 1ull * surface->gdi.scanline * surface->gdi.height;
-	surface->gdi.data = (BYTE*)winpr_aligned_malloc(size, 16);
-
-	if (!surface->gdi.data)
-	{
-		WLog_ERR(TAG, "unable to allocate GDI data");
-		goto out_free;
-	}
-
-	ZeroMemory(surface->gdi.data, size);
-
 	if (FreeRDPAreColorFormatsEqualNoAlpha(gdi->dstFormat, surface->gdi.format))
 	{
-		WINPR_ASSERT(xfc->depth != 0);
-		surface->image =
-		    XCreateImage(xfc->display, xfc->visual, xfc->depth, ZPixmap, 0,
-		                 (char*)surface->gdi.data, surface->gdi.mappedWidth,
-		                 surface->gdi.mappedHeight, xfc->scanline_pad, surface->gdi.scanline);
+		/* Decode straight into a MIT-SHM segment, the surface is presented as is */
+		surface->image = xf_shm_create_image(xfc, surface->gdi.width, surface->gdi.height);
+
+		if (surface->image)
+		{
+			surface->gdi.data = (BYTE*)surface->image->data;
+			surface->gdi.scanline = surface->image->bytes_per_line;
+		}
+		else
+		{
+			if (!xf_gfx_surface_alloc_data(xfc, surface))
+				goto out_free;
+
+			WINPR_ASSERT(xfc->depth != 0);
+			surface->image =
+			    XCreateImage(xfc->display, xfc->visual, xfc->depth, ZPixmap, 0,
+			                 (char*)surface->gdi.data, surface->gdi.mappedWidth,
+			                 surface->gdi.mappedHeight, xfc->scanline_pad, surface->gdi.scanline);
+		}
 	}
 	else
 	{
-		UINT32 width = surface->gdi.width;
-		UINT32 bytes = FreeRDPGetBytesPerPixel(gdi->dstFormat);
-		surface->stageScanline = width * bytes;
-		surface->stageScanline = x11_pad_scanline(surface->stageScanline, xfc->scanline_pad);
-		size = 1ull * surface->stageScanline * surface->gdi.height;
-		surface->stage = (BYTE*)winpr_aligned_malloc(size, 16);
-
-		if (!surface->stage)
+		if (!xf_gfx_surface_alloc_data(xfc, surface))
+			goto out_free;
+
+		surface->image = xf_shm_create_image(xfc, surface->gdi.width, surface->gdi.height);
+
+		if (surface->image)
 		{
-			WLog_ERR(TAG, "unable to allocate stage buffer");
-			goto out_free_gdidata;
+			surface->stage = (BYTE*)surface->image->data;
+			surface->stageScanline = surface->image->bytes_per_line;
+		}
+		else
+		{
+			UINT32 width = surface->gdi.width;
+			UINT32 bytes = FreeRDPGetBytesPerPixel(gdi->dstFormat);
+			surface->stageScanline = width * bytes;
+			surface->stageScanline = x11_pad_scanline(surface->stageScanline, xfc->scanline_pad);
+			size = 1ull * surface->stageScanline * surface->gdi.height;
+			surface->stage = (BYTE*)winpr_aligned_malloc(size, 16);
+
+			if (!surface->stage)
+			{
+				WLog_ERR(TAG, "unable to allocate stage buffer");
+				goto out_free_buffers;
+			}
+
+			ZeroMemory(surface->stage, size);
+			WINPR_ASSERT(xfc->depth != 0);
+			surface->image = XCreateImage(xfc->display, xfc->visual, xfc->depth, ZPixmap, 0,
+			                              (char*)surface->stage, surface->gdi.mappedWidth,
+			                              surface->gdi.mappedHeight, xfc->scanline_pad,
+			                              surface->stageScanline);
 		}
-
-		ZeroMemory(surface->stage, size);
-		WINPR_ASSERT(xfc->depth != 0);
-		surface->image =
-		    XCreateImage(xfc->display, xfc->visual, xfc->depth, ZPixmap, 0, (char*)surface->stage,
-		                 surface->gdi.mappedWidth, surface->gdi.mappedHeight, xfc->scanline_pad,
-		                 surface->stageScanline);
 	}
 
 	if (!surface->image)
 	{
 		WLog_ERR(TAG, "an error occurred when creating the XImage");
-		goto error_surface_image;
+		goto out_free_buffers;
 	}
 
 	surface->image->byte_order = LSBFirst;
@@ -368,17 +429,12 @@ static UINT xf_CreateSurface(RdpgfxClientContext* context,
 	if (context->SetSurfaceData(context, surface->gdi.surfaceId, (void*)surface) != CHANNEL_RC_OK)
 	{
 		WLog_ERR(TAG, "an error occurred during SetSurfaceData");
-		goto error_set_surface_data;
+		goto out_free_buffers;
 	}
 
 	return CHANNEL_RC_OK;
-error_set_surface_data:
-	surface->image->data = NULL;
-	XDestroyImage(surface->image);
-error_surface_image:
-	winpr_aligned_free(surface->stage);
-out_free_gdidata:
-	winpr_aligned_free(surface->gdi.data);
+out_free_buffers:
+	xf_gfx_surface_free_buffers(xfc, surface);
 out_free:
 	free(surface);
 	return ret;
@@ -395,6 +451,7 @@ static UINT xf_DeleteSurface(RdpgfxClientContext* context,
 	rdpCodecs* codecs = NULL;
 	xfGfxSurface* surface = NULL;
 	UINT status = 0;
+	rdpGdi* gdi = (rdpGdi*)context->custom;
 	EnterCriticalSection(&context->mux);
 	surface = (xfGfxSurface*)context->GetSurfaceData(context, deleteSurface->surfaceId);
 
@@ -406,10 +463,7 @@ static UINT xf_DeleteSurface(RdpgfxClientContext* context,
 #ifdef WITH_GFX_H264
 		h264_context_free(surface->gdi.h264);
 #endif
-		surface->image->data = NULL;
-		XDestroyImage(surface->image);
-		winpr_aligned_free(surface->gdi.data);
-		winpr_aligned_free(surface->stage);
+		xf_gfx_surface_free_buffers((xfContext*)gdi->context, surface);
 		region16_uninit(&surface->gdi.invalidRegion);
 		codecs = surface->gdi.codecs;
 		free(surface);
@@ -0,0 +1,294 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * X11 MIT-SHM presentation helpers
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/assert.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/log.h>
+
+#include "xf_shm.h"
+
+#if defined(WITH_XSHM)
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/extensions/XShm.h>
+#endif
+
+#define TAG CLIENT_TAG("x11.shm")
+
+/* Number of frames to average before logging presentation statistics */
+#define XF_PRESENT_STATS_INTERVAL 256
+
+#if defined(WITH_XSHM)
+static int xf_shm_probe_error_handler(Display* d, XErrorEvent* ev)
+{
+	/* A failed attach is detected by reading the probe pixel back */
+	WINPR_UNUSED(d);
+	WINPR_UNUSED(ev);
+	return 0;
+}
+
+/* A remote X server can not map our segments, but reports that asynchronously. Push one pixel
+ * through a segment and read it back instead of trapping errors for every image created. */
+static BOOL xf_shm_probe(xfContext* xfc)
+{
+	BOOL rc = FALSE;
+	XShmSegmentInfo info = { 0 };
+	XImage* readback = NULL;
+	Pixmap pixmap = 0;
+	GC gc = NULL;
+
+	WINPR_ASSERT(xfc);
+	WINPR_ASSERT(xfc->depth != 0);
+
+	info.shmid = -1;
+	info.shmaddr = (char*)-1;
+
+	XImage* image =
+	    XShmCreateImage(xfc->display, xfc->visual, xfc->depth, ZPixmap, NULL, &info, 1, 1);
+	if (!image)
+		return FALSE;
+
+	info.shmid = shmget(IPC_PRIVATE, 1ull * image->bytes_per_line * image->height,
+	                    IPC_CREAT | 0600);
+	if (info.shmid < 0)
+		goto out;
+
+	info.shmaddr = shmat(info.shmid, NULL, 0);
+	if (info.shmaddr == (char*)-1)
+		goto out;
+
+	info.readOnly = False;
+	image->data = info.shmaddr;
+	image->byte_order = LSBFirst;
+	image->bitmap_bit_order = LSBFirst;
+
+	const unsigned long mask =
+	    xfc->visual->red_mask | xfc->visual->green_mask | xfc->visual->blue_mask;
+	const unsigned long pattern = 0xA5A5A5A5ul & mask;
+	XPutPixel(image, 0, 0, pattern);
+
+	pixmap = XCreatePixmap(xfc->display, RootWindowOfScreen(xfc->screen), 1, 1,
+	                       (unsigned)xfc->depth);
+	gc = XCreateGC(xfc->display, pixmap, 0, NULL);
+	XSetForeground(xfc->display, gc, 0);
+	XFillRectangle(xfc->display, pixmap, gc, 0, 0, 1, 1);
+
+	XSync(xfc->display, False);
+	int (*handler)(Display*, XErrorEvent*) = XSetErrorHandler(xf_shm_probe_error_handler);
+	const Status status = XShmAttach(xfc->display, &info);
+	if (status)
+	{
+		XShmPutImage(xfc->display, pixmap, gc, image, 0, 0, 0, 0, 1, 1, False);
+		readback = XGetImage(xfc->display, pixmap, 0, 0, 1, 1, AllPlanes, ZPixmap);
+		XShmDetach(xfc->display, &info);
+	}
+	XSync(xfc->display, False);
+	XSetErrorHandler(handler);
+
+	if (readback)
+		rc = (XGetPixel(readback, 0, 0) & mask) == pattern;
+
+out:
+	if (readback)
+		XDestroyImage(readback);
+	if (gc)
+		XFreeGC(xfc->display, gc);
+	if (pixmap)
+		XFreePixmap(xfc->display, pixmap);
+	if (info.shmaddr != (char*)-1)
+		shmdt(info.shmaddr);
+	if (info.shmid >= 0)
+		shmctl(info.shmid, IPC_RMID, NULL);
+	image->data = NULL;
+	image->obdata = NULL;
+	XDestroyImage(image);
+	return rc;
+}
+#endif
+
+BOOL xf_shm_init(xfContext* xfc)
+{
+	WINPR_ASSERT(xfc);
+
+	xfc->shmAvailable = FALSE;
+#if defined(WITH_XSHM)
+	if (!XShmQueryExtension(xfc->display))
+	{
+		WLog_INFO(TAG, "MIT-SHM not available, using XPutImage");
+		return FALSE;
+	}
+
+	/* The server reads the segment as is, there is no byte swapping */
+	if (ImageByteOrder(xfc->display) != LSBFirst)
+	{
+		WLog_INFO(TAG, "MIT-SHM disabled, X server byte order does not match");
+		return FALSE;
+	}
+
+	xf_lock_x11(xfc);
+	const BOOL usable = xf_shm_probe(xfc);
+	xf_unlock_x11(xfc);
+
+	if (!usable)
+	{
+		WLog_INFO(TAG, "MIT-SHM disabled, X server can not attach segments");
+		return FALSE;
+	}
+
+	xfc->shmAvailable = TRUE;
+#endif
+	return xfc->shmAvailable;
+}
+
+XImage* xf_shm_create_image(xfContext* xfc, UINT32 width, UINT32 height)
+{
+	WINPR_ASSERT(xfc);
+
+	if (!xfc->shmAvailable)
+		return NULL;
+
+#if defined(WITH_XSHM)
+	XImage* image = NULL;
+	XShmSegmentInfo* info = calloc(1, sizeof(XShmSegmentInfo));
+	if (!info)
+		return NULL;
+
+	info->shmid = -1;
+	info->shmaddr = (char*)-1;
+
+	WINPR_ASSERT(xfc->depth != 0);
+	image = XShmCreateImage(xfc->display, xfc->visual, xfc->depth, ZPixmap, NULL, info, width,
+	                        height);
+	if (!image)
+		goto fail;
+
+	const size_t size = 1ull * image->bytes_per_line * image->height;
+	info->shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+	if (info->shmid < 0)
+		goto fail;
+
+	info->shmaddr = shmat(info->shmid, NULL, 0);
+	if (info->shmaddr == (char*)-1)
+		goto fail;
+
+	info->readOnly = False;
+
+	/* xf_shm_init verified the X server maps our segments, no error trap needed here */
+	xf_lock_x11(xfc);
+	const Status attached = XShmAttach(xfc->display, info);
+	xf_unlock_x11(xfc);
+	if (!attached)
+		goto fail;
+
+	/* Mark for removal now, the segment lives until both sides detached */
+	shmctl(info->shmid, IPC_RMID, NULL);
+
+	image->data = info->shmaddr;
+	image->byte_order = LSBFirst;
+	image->bitmap_bit_order = LSBFirst;
+	memset(image->data, 0, size);
+	return image;
+
+fail:
+	WLog_WARN(TAG, "failed to create %" PRIu32 "x%" PRIu32 " MIT-SHM image, using XPutImage",
+	          width, height);
+	xfc->shmAvailable = FALSE;
+
+	if (info->shmaddr != (char*)-1)
+		shmdt(info->shmaddr);
+	if (info->shmid >= 0)
+		shmctl(info->shmid, IPC_RMID, NULL);
+	if (image)
+	{
+		image->data = NULL;
+		image->obdata = NULL;
+		XDestroyImage(image);
+	}
+	free(info);
+#endif
+	return NULL;
+}
+
+BOOL xf_shm_image_is_shared(const XImage* image)
+{
+	/* XShmCreateImage stores the segment in obdata, XCreateImage leaves it NULL */
+	return image && image->obdata;
+}
+
+void xf_shm_destroy_image(xfContext* xfc, XImage* image)
+{
+	WINPR_ASSERT(xfc);
+
+	if (!image)
+		return;
+
+#if defined(WITH_XSHM)
+	if (xf_shm_image_is_shared(image))
+	{
+		XShmSegmentInfo* info = (XShmSegmentInfo*)image->obdata;
+		xf_lock_x11(xfc);
+		XShmDetach(xfc->display, info);
+		XSync(xfc->display, False);
+		xf_unlock_x11(xfc);
+		shmdt(info->shmaddr);
+		free(info);
+		image->obdata = NULL;
+	}
+#endif
+
+	image->data = NULL;
+	XDestroyImage(image);
+}
+
+void xf_shm_put_image(xfContext* xfc, Drawable d, GC gc, XImage* image, int src_x, int src_y,
+                      int dst_x, int dst_y, unsigned int width, unsigned int height)
+{
+	WINPR_ASSERT(xfc);
+	WINPR_ASSERT(image);
+
+#if defined(WITH_XSHM)
+	if (xf_shm_image_is_shared(image))
+	{
+		XShmPutImage(xfc->display, d, gc, image, src_x, src_y, dst_x, dst_y, width, height, False);
+		return;
+	}
+#endif
+	XPutImage(xfc->display, d, gc, image, src_x, src_y, dst_x, dst_y, width, height);
+}
+
+void xf_shm_frame_done(xfContext* xfc, UINT64 start, UINT64 pixels)
+{
+	WINPR_ASSERT(xfc);
+
+	xfc->presentTime += winpr_GetTickCount64NS() - start;
+	xfc->presentPixels += pixels;
+	xfc->presentCount++;
+
+	if (xfc->presentCount < XF_PRESENT_STATS_INTERVAL)
+		return;
+
+	WLog_DBG(TAG, "present [%s]: %" PRIu64 " frames, %" PRIu64 " us/frame, %" PRIu64 " pixel/frame",
+	         xfc->shmAvailable ? "MIT-SHM" : "XPutImage", xfc->presentCount,
+	         xfc->presentTime / xfc->presentCount / 1000ull, xfc->presentPixels / xfc->presentCount);
+
+	xfc->presentTime = 0;
+	xfc->presentPixels = 0;
+	xfc->presentCount = 0;
+}
@@ -0,0 +1,64 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * X11 MIT-SHM presentation helpers
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_CLIENT_X11_SHM_H
+#define FREERDP_CLIENT_X11_SHM_H
+
+#include <winpr/wtypes.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include "xfreerdp.h"
+
+/** @brief probe the MIT-SHM extension, must be called once the display is open
+ *
+ *  Attaches a test segment while the X11 error handler is swapped, so call it on the UI thread
+ *  during initialization. The result is stored in xfContext::shmAvailable.
+ */
+BOOL xf_shm_init(xfContext* xfc);
+
+/** @brief create a ZPixmap image backed by a shared memory segment
+ *
+ *  The image is \b width pixels wide (including any padding), the resulting
+ *  line length is available as image->bytes_per_line.
+ *
+ *  @return the image or \b NULL if MIT-SHM is not usable, callers fall back to
+ *          XCreateImage in that case.
+ */
+XImage* xf_shm_create_image(xfContext* xfc, UINT32 width, UINT32 height);
+
+/** @brief destroy an image created by xf_shm_create_image or XCreateImage
+ *
+ *  The pixel data of XCreateImage images is owned by the caller and not freed.
+ */
+void xf_shm_destroy_image(xfContext* xfc, XImage* image);
+
+BOOL xf_shm_image_is_shared(const XImage* image);
+
+/** @brief XShmPutImage for shared images, XPutImage otherwise */
+void xf_shm_put_image(xfContext* xfc, Drawable d, GC gc, XImage* image, int src_x, int src_y,
+                      int dst_x, int dst_y, unsigned int width, unsigned int height);
+
+/** @brief account a presented frame for the frame time statistics
+ *
+ *  @param start The winpr_GetTickCount64NS() value when presenting started
+ *  @param pixels The number of pixels pushed to the X server
+ */
+void xf_shm_frame_done(xfContext* xfc, UINT64 start, UINT64 pixels);
+
+#endif /* FREERDP_CLIENT_X11_SHM_H */
@@ -55,6 +55,7 @@
 #include "xf_input.h"
 #include "xf_keyboard.h"
 #include "xf_utils.h"
+#include "xf_shm.h"
 
 #define TAG CLIENT_TAG("x11")
 
@@ -1179,8 +1180,8 @@ void xf_UpdateWindowArea(xfContext* xfc, xfAppWindow* appWindow, int x, int y, i
 
 	if (freerdp_settings_get_bool(settings, FreeRDP_SoftwareGdi))
 	{
-		XPutImage(xfc->display, appWindow->pixmap, appWindow->gc, xfc->image, ax, ay, x, y, width,
-		          height);
+		xf_shm_put_image(xfc, appWindow->pixmap, appWindow->gc, xfc->image, ax, ay, x, y, width,
+		                 height);
 	}
 
 	XCopyArea(xfc->display, appWindow->pixmap, appWindow->handle, appWindow->gc, x, y, width,
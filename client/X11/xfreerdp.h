@@ -284,6 +284,11 @@ struct xf_context
 
 	BOOL xkbAvailable;
 	BOOL xrenderAvailable;
+	BOOL shmAvailable;
+
+	UINT64 presentTime;
+	UINT64 presentPixels;
+	UINT64 presentCount;
 
 	/* value to be sent over wire for each logical client mouse button */
 	button_map button_map[NUM_BUTTONS_MAPPED];
@@ -4278,6 +4278,12 @@ static int freerdp_client_settings_parse_command_line_arguments_int(
 			if (!freerdp_settings_set_bool(settings, FreeRDP_Decorations, enable))
 				return COMMAND_LINE_ERROR;
 		}
+		CommandLineSwitchCase(arg, "dvc-compress")
+		{
+			if (!freerdp_settings_set_string(settings, FreeRDP_DynamicChannelCompression,
+			                                 arg->Value))
+				return COMMAND_LINE_ERROR_MEMORY;
+		}
 		CommandLineSwitchCase(arg, "dynamic-resolution")
 		{
 			const int rc = parse_dynamic_resolution_options(settings, arg);
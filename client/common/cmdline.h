@@ -151,6 +151,8 @@ static const COMMAND_LINE_ARGUMENT_A global_cmd_args[] = {
 	  NULL, "record or replay dump" },
 	{ "dvc", COMMAND_LINE_VALUE_REQUIRED, "<channel>[,<options>]", NULL, NULL, -1, NULL,
 	  "Dynamic virtual channel" },
+	{ "dvc-compress", COMMAND_LINE_VALUE_REQUIRED, "<channel>[,<channel>...]|*", NULL, NULL, -1,
+	  NULL, "Compress the data of the listed dynamic virtual channels (RDP 8.0 Lite)" },
 	{ "dynamic-resolution", COMMAND_LINE_VALUE_FLAG, NULL, NULL, NULL, -1, NULL,
 	  "Send resolution updates when the window is resized" },
 	{ "echo", COMMAND_LINE_VALUE_FLAG, NULL, NULL, NULL, -1, "echo", "Echo channel" },
@@ -82,7 +82,21 @@ typedef FREERDP_RDPSND_DEVICE_ENTRY_POINTS* PFREERDP_RDPSND_DEVICE_ENTRY_POINTS;
 
 typedef UINT (*PFREERDP_RDPSND_DEVICE_ENTRY)(PFREERDP_RDPSND_DEVICE_ENTRY_POINTS pEntryPoints);
 
+/** @brief playback statistics of the client jitter buffer */
+typedef struct
+{
+	UINT32 targetLatency; /* current adaptive jitter buffer target in ms */
+	UINT32 jitter;        /* smoothed wave arrival jitter in ms */
+	UINT32 latency;       /* arrival to audible output of the last played wave in ms */
+	UINT32 buffered;      /* audio queued in the jitter buffer in ms */
+	UINT64 played;        /* waves handed to the device */
+	UINT64 underruns;     /* times the buffer ran dry while playing */
+	UINT64 overruns;      /* waves dropped because the buffer was full */
+} RDPSND_PLAYBACK_STATS;
+
 FREERDP_API rdpContext* freerdp_rdpsnd_get_context(rdpsndPlugin* plugin);
+FREERDP_API BOOL freerdp_rdpsnd_get_playback_stats(rdpsndPlugin* plugin,
+                                                   RDPSND_PLAYBACK_STATS* stats);
 
 #ifdef __cplusplus
 }
@@ -32,6 +32,18 @@ extern "C"
 
 	typedef struct S_FREERDP_DSP_CONTEXT FREERDP_DSP_CONTEXT;
 
+	/** @brief trade resampling quality for CPU time and latency
+	 *
+	 *  Higher quality uses longer filters, which cost more per sample and
+	 *  delay the output by half the filter length.
+	 */
+	typedef enum
+	{
+		FREERDP_DSP_RESAMPLE_QUALITY_LOW,
+		FREERDP_DSP_RESAMPLE_QUALITY_MEDIUM,
+		FREERDP_DSP_RESAMPLE_QUALITY_HIGH
+	} FREERDP_DSP_RESAMPLE_QUALITY;
+
 	FREERDP_API void freerdp_dsp_context_free(FREERDP_DSP_CONTEXT* context);
 
 	WINPR_ATTR_MALLOC(freerdp_dsp_context_free, 1)
@@ -52,6 +64,15 @@ extern "C"
 	                                           const AUDIO_FORMAT* WINPR_RESTRICT targetFormat,
 	                                           UINT32 FramesPerPacket);
 
+	/** @brief select the quality of the built in resampler used by freerdp_dsp_encode
+	 *
+	 *  Has no effect if an external resampler (soxr, ffmpeg) is used.
+	 *  Defaults to \b FREERDP_DSP_RESAMPLE_QUALITY_MEDIUM
+	 */
+	FREERDP_API BOOL
+	freerdp_dsp_context_set_resample_quality(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
+	                                         FREERDP_DSP_RESAMPLE_QUALITY quality);
+
 #ifdef __cplusplus
 }
 #endif
@@ -57,6 +57,8 @@ extern "C"
 		H264_CONTEXT_OPTION_FRAMERATE,
 		H264_CONTEXT_OPTION_QP,
 		H264_CONTEXT_OPTION_USAGETYPE,
+		H264_CONTEXT_OPTION_TEXT_QP_OFFSET,  /** QP decrease hinted for text regions */
+		H264_CONTEXT_OPTION_VIDEO_QP_OFFSET, /** QP increase hinted for natural content */
 	} H264_CONTEXT_OPTION;
 
 	FREERDP_API void free_h264_metablock(RDPGFX_H264_METABLOCK* meta);
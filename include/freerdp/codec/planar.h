@@ -60,6 +60,17 @@ extern "C"
 	FREERDP_API BITMAP_PLANAR_CONTEXT* freerdp_bitmap_planar_context_new(DWORD flags, UINT32 width,
 	                                                                     UINT32 height);
 
+	/** @brief create a planar context
+	 *
+	 *  Unless \b ThreadingFlags contains THREADING_FLAGS_DISABLE_THREADS the color planes of
+	 *  large bitmaps are encoded concurrently on the thread pool.
+	 */
+	WINPR_ATTR_MALLOC(freerdp_bitmap_planar_context_free, 1)
+	FREERDP_API BITMAP_PLANAR_CONTEXT* freerdp_bitmap_planar_context_new_ex(DWORD flags,
+	                                                                        UINT32 width,
+	                                                                        UINT32 height,
+	                                                                        UINT32 ThreadingFlags);
+
 	FREERDP_API void freerdp_planar_switch_bgr(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
 	                                           BOOL bgr);
 	FREERDP_API void freerdp_planar_topdown_image(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
@@ -45,6 +45,21 @@ extern "C"
 	                                     BYTE** WINPR_RESTRICT ppDstData,
 	                                     UINT32* WINPR_RESTRICT pDstSize);
 
+	/** @brief encode the next refinement pass of tiles sent by progressive_compress
+	 *
+	 *  Only produces data if refinement was enabled with
+	 *  progressive_context_set_refinement.
+	 *
+	 *  @param maxSize stop adding tiles once the message exceeds this size, 0 for no limit
+	 *  @return 1 if a message was encoded, 0 if all tiles are at full quality, < 0 on failure
+	 */
+	FREERDP_API int progressive_compress_upgrade(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
+	                                             UINT32 maxSize, BYTE** WINPR_RESTRICT ppDstData,
+	                                             UINT32* WINPR_RESTRICT pDstSize);
+
+	/** @brief number of tiles still waiting for refinement passes */
+	FREERDP_API UINT32 progressive_compress_pending(const PROGRESSIVE_CONTEXT* progressive);
+
 	FREERDP_API INT32 progressive_decompress(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
 	                                         const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcSize,
 	                                         BYTE* WINPR_RESTRICT pDstData, UINT32 DstFormat,
@@ -61,6 +76,18 @@ extern "C"
 
 	FREERDP_API BOOL progressive_context_reset(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive);
 
+	/** @brief enable progressive refinement for a compressor context
+	 *
+	 *  With refinement progressive_compress only sends tiles that changed, at a
+	 *  coarse quality. progressive_compress_upgrade then refines them to full
+	 *  RemoteFX quality in several passes.
+	 *
+	 *  @return \b TRUE on success, \b FALSE for decompressor contexts or on failure
+	 */
+	FREERDP_API BOOL
+	progressive_context_set_refinement(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
+	                                   BOOL enable);
+
 	FREERDP_API void progressive_context_free(PROGRESSIVE_CONTEXT* progressive);
 
 	WINPR_ATTR_MALLOC(progressive_context_free, 1)
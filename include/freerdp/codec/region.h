@@ -136,6 +136,29 @@ extern "C"
 	FREERDP_API BOOL region16_intersect_rect(REGION16* dst, const REGION16* src,
 	                                         const RECTANGLE_16* arg2);
 
+	/** adds an array of rectangles in src and stores the resulting region in dst
+	 *
+	 * The rectangles may overlap each other, the region is rebuilt in a single pass instead
+	 * of once per rectangle as with region16_union_rect().
+	 * @param dst destination region
+	 * @param src source region
+	 * @param rects the rectangles to add
+	 * @param count the number of rectangles
+	 * @return if the operation was successful (false meaning out-of-memory)
+	 */
+	FREERDP_API BOOL region16_union_rects(REGION16* dst, const REGION16* src,
+	                                      const RECTANGLE_16* rects, UINT32 count);
+
+	/** computes the intersection between a region and the union of an array of rectangles
+	 * @param dst destination region
+	 * @param src the source region
+	 * @param rects the rectangles that intersect
+	 * @param count the number of rectangles
+	 * @return if the operation was successful (false meaning out-of-memory)
+	 */
+	FREERDP_API BOOL region16_intersect_rects(REGION16* dst, const REGION16* src,
+	                                          const RECTANGLE_16* rects, UINT32 count);
+
 	/** release internal data associated with this region
 	 * @param region the region to release
 	 */
@@ -29,6 +29,9 @@
 #define ZGFX_SEGMENTED_MULTIPART 0xE1
 
 #define ZGFX_PACKET_COMPR_TYPE_RDP8 0x04
+#define ZGFX_PACKET_COMPR_TYPE_RDP8_LITE 0x06
+
+#define ZGFX_LITE_HISTORY_SIZE 8192
 
 #define ZGFX_SEGMENTED_MAXSIZE 65535
 
@@ -52,6 +55,27 @@ extern "C"
 	                                        const BYTE* WINPR_RESTRICT pUncompressed,
 	                                        UINT32 uncompressedSize, UINT32* WINPR_RESTRICT pFlags);
 
+	/** @brief compress a single RDP8_BULK_ENCODED_DATA block ([MS-RDPEGFX] 2.2.5.3)
+	 *
+	 *  Requires a context from zgfx_context_new_lite(TRUE). The data is written uncompressed
+	 *  if encoding does not make it smaller, the history is updated in both cases.
+	 *
+	 *  @param zgfx the compressor context
+	 *  @param pSrcData the data to compress
+	 *  @param SrcSize the size of the data, 1 to ZGFX_SEGMENTED_MAXSIZE bytes
+	 *  @param sDst the block (header and data) is appended here
+	 *
+	 *  @return TRUE on success
+	 */
+	FREERDP_API BOOL zgfx_compress_bulk(ZGFX_CONTEXT* WINPR_RESTRICT zgfx,
+	                                    const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcSize,
+	                                    wStream* WINPR_RESTRICT sDst);
+
+	/** @brief decompress a single RDP8_BULK_ENCODED_DATA block and append it to sDst */
+	FREERDP_API BOOL zgfx_decompress_bulk(ZGFX_CONTEXT* WINPR_RESTRICT zgfx,
+	                                      const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcSize,
+	                                      wStream* WINPR_RESTRICT sDst);
+
 	FREERDP_API void zgfx_context_reset(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, BOOL flush);
 
 	FREERDP_API void zgfx_context_free(ZGFX_CONTEXT* zgfx);
@@ -59,6 +83,12 @@ extern "C"
 	WINPR_ATTR_MALLOC(zgfx_context_free, 1)
 	FREERDP_API ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor);
 
+	/** @brief context for the RDP 8.0 Lite format with its ZGFX_LITE_HISTORY_SIZE history,
+	 *  as used for compressed dynamic virtual channel data ([MS-RDPEDYC] 3.1.5.1.4)
+	 */
+	WINPR_ATTR_MALLOC(zgfx_context_free, 1)
+	FREERDP_API ZGFX_CONTEXT* zgfx_context_new_lite(BOOL Compressor);
+
 #ifdef __cplusplus
 }
 #endif
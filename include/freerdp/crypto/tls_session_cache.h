@@ -0,0 +1,80 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Server side TLS session resumption cache
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_CRYPTO_TLS_SESSION_CACHE_H
+#define FREERDP_CRYPTO_TLS_SESSION_CACHE_H
+
+#include <winpr/wtypes.h>
+
+#include <freerdp/api.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	typedef struct rdp_tls_session_cache rdpTlsSessionCache;
+
+	/** @brief counters of a session cache, summed over all processes sharing it */
+	typedef struct
+	{
+		UINT64 Handshakes;      /**< completed server handshakes */
+		UINT64 Resumed;         /**< handshakes that resumed an earlier session */
+		UINT64 CacheHits;       /**< session id lookups that found a valid session */
+		UINT64 CacheMisses;     /**< session id lookups that found nothing or an expired one */
+		UINT64 Stored;          /**< sessions added to the cache */
+		UINT64 Evicted;         /**< sessions replaced before they expired */
+		UINT64 TicketsIssued;   /**< session tickets encrypted */
+		UINT64 TicketsAccepted; /**< session tickets decrypted with a known key */
+		UINT64 TicketsRejected; /**< session tickets with an unknown or retired key */
+		UINT64 KeyRotations;    /**< ticket key rotations */
+		UINT32 Entries;         /**< sessions currently cached */
+		UINT32 Capacity;        /**< maximum number of cached sessions */
+	} TLS_SESSION_CACHE_STATS;
+
+	FREERDP_API void freerdp_tls_session_cache_free(rdpTlsSessionCache* cache);
+
+	/** @brief create a session cache for server side TLS
+	 *
+	 *  The cache stores sessions by id (TLS 1.2 without tickets) and holds the keys that
+	 *  encrypt session tickets. Tickets and cached sessions are valid for \b lifetime seconds,
+	 *  the ticket key is rotated after the same time and the previous key is still accepted
+	 *  for one more period.
+	 *
+	 *  @param capacity maximum number of sessions stored by id
+	 *  @param lifetime session and ticket key lifetime in seconds
+	 *  @param sharedName if not NULL the name of a shared memory object, processes that use
+	 *  the same name share sessions, ticket keys and counters. The process that created the
+	 *  object removes the name when freeing the cache.
+	 *
+	 *  @return the new cache or NULL in case of failure
+	 */
+	WINPR_ATTR_MALLOC(freerdp_tls_session_cache_free, 1)
+	FREERDP_API rdpTlsSessionCache* freerdp_tls_session_cache_new(size_t capacity, UINT32 lifetime,
+	                                                              const char* sharedName);
+
+	FREERDP_API BOOL freerdp_tls_session_cache_get_stats(rdpTlsSessionCache* cache,
+	                                                     TLS_SESSION_CACHE_STATS* stats);
+
+	/** @brief replace the ticket key now, tickets of the previous key are still accepted */
+	FREERDP_API BOOL freerdp_tls_session_cache_rotate_keys(rdpTlsSessionCache* cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_CRYPTO_TLS_SESSION_CACHE_H */
@@ -490,6 +490,9 @@ extern "C"
 	};
 	typedef struct gdi_glyph gdiGlyph;
 
+	typedef struct gdi_gfx_scheduler gdiGfxScheduler;
+	typedef struct gdi_glyph_run gdiGlyphRun;
+
 	struct rdp_gdi
 	{
 		rdpContext* context;
@@ -521,6 +524,8 @@ extern "C"
 		GeometryClientContext* geometry;
 
 		wLog* log;
+		gdiGfxScheduler* gfxScheduler;
+		gdiGlyphRun* glyphRun;
 	};
 	typedef struct rdp_gdi rdpGdi;
 
@@ -21,6 +21,7 @@
 #define FREERDP_METRICS_H
 
 #include <freerdp/api.h>
+#include <freerdp/types.h>
 
 #ifdef __cplusplus
 extern "C"
@@ -37,6 +38,89 @@ extern "C"
 	};
 	typedef struct rdp_metrics rdpMetrics;
 
+	/** @brief number of histogram buckets, bucket \b n counts samples below 2^n microseconds and
+	 *  the last one everything that did not fit */
+#define FREERDP_METRICS_HISTOGRAM_BUCKETS 24
+
+	typedef struct
+	{
+		UINT64 Count;
+		UINT64 TotalUs;
+		UINT64 MaxUs;
+		UINT64 Buckets[FREERDP_METRICS_HISTOGRAM_BUCKETS];
+	} FREERDP_METRICS_HISTOGRAM;
+
+	typedef enum
+	{
+		FREERDP_METRICS_PDU_DATA,            /**< slow path data PDUs by PDUType2 */
+		FREERDP_METRICS_PDU_FASTPATH_UPDATE, /**< fast path updates by updateCode */
+		FREERDP_METRICS_PDU_FASTPATH_INPUT,  /**< fast path input events by eventCode */
+		FREERDP_METRICS_PDU_CATEGORY_COUNT
+	} FREERDP_METRICS_PDU_CATEGORY;
+
+	typedef enum
+	{
+		FREERDP_METRICS_CODEC_UNCOMPRESSED,
+		FREERDP_METRICS_CODEC_INTERLEAVED,
+		FREERDP_METRICS_CODEC_PLANAR,
+		FREERDP_METRICS_CODEC_REMOTEFX,
+		FREERDP_METRICS_CODEC_NSCODEC,
+		FREERDP_METRICS_CODEC_CLEARCODEC,
+		FREERDP_METRICS_CODEC_PROGRESSIVE,
+		FREERDP_METRICS_CODEC_AVC420,
+		FREERDP_METRICS_CODEC_AVC444,
+		FREERDP_METRICS_CODEC_ALPHA,
+		FREERDP_METRICS_CODEC_COUNT
+	} FREERDP_METRICS_CODEC;
+
+	/** @brief time from receiving a PDU to returning from its handler */
+	typedef struct
+	{
+		FREERDP_METRICS_PDU_CATEGORY Category;
+		UINT8 Type;
+		FREERDP_METRICS_HISTOGRAM Time;
+	} FREERDP_METRICS_PDU;
+
+	typedef struct
+	{
+		UINT16 ChannelId;
+		char Name[8];
+		UINT64 BytesSent;
+		UINT64 BytesReceived;
+		UINT64 PdusSent;     /**< complete channel PDUs, chunks are not counted */
+		UINT64 PdusReceived; /**< complete channel PDUs, chunks are not counted */
+	} FREERDP_METRICS_CHANNEL;
+
+	/** @brief a copy of the registry of one connection, all values since the last reset */
+	typedef struct
+	{
+		UINT64 DurationUs;
+		UINT64 BytesSent;
+		UINT64 BytesReceived;
+		UINT64 PacketsSent;
+		UINT64 PacketsReceived;
+
+		size_t ChannelCount;
+		FREERDP_METRICS_CHANNEL* Channels;
+
+		size_t PduCount;
+		FREERDP_METRICS_PDU* Pdus;
+
+		UINT64 WriteQueueBytes;    /**< bytes waiting in the transport batch right now */
+		UINT64 WriteQueueBytesMax; /**< largest transport batch */
+		FREERDP_METRICS_HISTOGRAM WriteBlocked; /**< time spent in BIO_wait_write */
+
+		FREERDP_METRICS_HISTOGRAM Encode[FREERDP_METRICS_CODEC_COUNT];
+		FREERDP_METRICS_HISTOGRAM Decode[FREERDP_METRICS_CODEC_COUNT];
+
+		FREERDP_METRICS_HISTOGRAM FrameAckLatency; /**< frame sent to frame acknowledged */
+
+		UINT64 PresentRects;  /**< window rectangles updated by the client */
+		UINT64 PresentPixels; /**< window pixels updated by the client */
+		FREERDP_METRICS_HISTOGRAM PresentLatency;  /**< first damage to window update */
+		FREERDP_METRICS_HISTOGRAM PresentInterval; /**< time between two window updates */
+	} FREERDP_METRICS_SNAPSHOT;
+
 	FREERDP_API double metrics_write_bytes(rdpMetrics* metrics, UINT32 UncompressedBytes,
 	                                       UINT32 CompressedBytes);
 
@@ -45,6 +129,66 @@ extern "C"
 	WINPR_ATTR_MALLOC(metrics_free, 1)
 	FREERDP_API rdpMetrics* metrics_new(rdpContext* context);
 
+	/** @brief record the time a codec took for one surface or bitmap
+	 *
+	 *  @param durationNs the duration in nanoseconds, see winpr_GetTickCount64NS
+	 */
+	FREERDP_API void freerdp_metrics_codec_time(rdpMetrics* metrics, FREERDP_METRICS_CODEC codec,
+	                                            BOOL encode, UINT64 durationNs);
+
+	/** @brief remember when a frame was sent, call freerdp_metrics_frame_acked on its ack */
+	FREERDP_API void freerdp_metrics_frame_sent(rdpMetrics* metrics, UINT32 frameId);
+	FREERDP_API void freerdp_metrics_frame_acked(rdpMetrics* metrics, UINT32 frameId);
+
+	/** @brief record a frame a client pushed to its windows
+	 *
+	 *  @param latencyNs time from the first damage of the frame to the window update
+	 *  @param intervalNs time since the previous window update, 0 for the first one
+	 *  @param rects the number of window rectangles updated
+	 *  @param pixels the number of window pixels updated
+	 */
+	FREERDP_API void freerdp_metrics_frame_presented(rdpMetrics* metrics, UINT64 latencyNs,
+	                                                 UINT64 intervalNs, UINT64 rects,
+	                                                 UINT64 pixels);
+
+	/** @brief clear all counters and histograms of the connection */
+	FREERDP_API void freerdp_metrics_reset(rdpMetrics* metrics);
+
+	FREERDP_API void freerdp_metrics_snapshot_free(FREERDP_METRICS_SNAPSHOT* snapshot);
+
+	/** @brief copy the current state of the registry
+	 *
+	 *  @param metrics the registry of a connection, rdpContext::metrics
+	 *  @param reset clear the registry after copying it
+	 *
+	 *  @return a snapshot to free with freerdp_metrics_snapshot_free or NULL on failure
+	 */
+	WINPR_ATTR_MALLOC(freerdp_metrics_snapshot_free, 1)
+	FREERDP_API FREERDP_METRICS_SNAPSHOT* freerdp_metrics_snapshot(rdpMetrics* metrics,
+	                                                               BOOL reset);
+
+	/** @brief upper bound in microseconds of the bucket holding the given percentile */
+	FREERDP_API UINT64 freerdp_metrics_histogram_percentile(const FREERDP_METRICS_HISTOGRAM* hist,
+	                                                        double percentile);
+
+	FREERDP_API const char* freerdp_metrics_codec_name(FREERDP_METRICS_CODEC codec);
+	FREERDP_API const char*
+	freerdp_metrics_pdu_category_name(FREERDP_METRICS_PDU_CATEGORY category);
+
+	/** @brief format a snapshot as text, one metric per line
+	 *
+	 *  Each line starts with the metric name and its labels followed by key=value pairs, for
+	 *  example \b freerdp_pdu_time{category="data",type="0x1F"} count=3 avg=12 p99=16 max=14
+	 *  with times in microseconds. Empty histograms are skipped.
+	 *
+	 *  @param snapshot the snapshot to format
+	 *  @param prefix prepended to every line, may be NULL
+	 *
+	 *  @return the text to free with free() or NULL on failure
+	 */
+	FREERDP_API char* freerdp_metrics_snapshot_format(const FREERDP_METRICS_SNAPSHOT* snapshot,
+	                                                  const char* prefix);
+
 #ifdef __cplusplus
 }
 #endif
@@ -27,6 +27,7 @@
 #include <freerdp/update.h>
 #include <freerdp/autodetect.h>
 #include <freerdp/redirection.h>
+#include <freerdp/crypto/tls_session_cache.h>
 
 #include <winpr/sspi.h>
 #include <winpr/ntlm.h>
@@ -203,6 +204,22 @@ extern "C"
 	FREERDP_API const char* freerdp_peer_os_major_type_string(freerdp_peer* client);
 	FREERDP_API const char* freerdp_peer_os_minor_type_string(freerdp_peer* client);
 
+	/** @brief resume TLS sessions of \b cache, call after the context was created
+	 *
+	 *  The cache is usually owned by the listener and shared by all peers, it must outlive
+	 *  the peer.
+	 */
+	FREERDP_API BOOL freerdp_peer_set_tls_session_cache(freerdp_peer* client,
+	                                                    rdpTlsSessionCache* cache);
+
+	/** @brief the persistent bitmap cache keys the client offered for bitmap cache \b id
+	 *
+	 *  Key n was loaded into entry n of the cache. The keys are owned by the peer and valid
+	 *  until the next persistent key list PDU is received.
+	 */
+	FREERDP_API BOOL freerdp_peer_get_persistent_keys(freerdp_peer* client, UINT32 id,
+	                                                  const UINT64** keys, UINT32* count);
+
 	FREERDP_API void freerdp_peer_free(freerdp_peer* client);
 
 	WINPR_ATTR_MALLOC(freerdp_peer_free, 1)
@@ -40,6 +40,11 @@ extern "C"
 #define PIXMAP4_ADDR(_dst_, _x_, _y_, _span_) \
 	((void*)(((BYTE*)(_dst_)) + (((_x_) + (_y_) * (_span_)) << 2)))
 
+/* Coverage values of the mask passed to expandMask_8u32u */
+#define PRIM_MASK_NONE 0x00 /* keep the destination pixel */
+#define PRIM_MASK_BACK 0x01 /* any value but NONE and FORE writes the back color */
+#define PRIM_MASK_FORE 0xFF /* write the fore color */
+
 #define PRIM_X86_MMX_AVAILABLE (1U << 0)
 #define PRIM_X86_3DNOW_AVAILABLE (1U << 1)
 #define PRIM_X86_3DNOW_PREFETCH_AVAILABLE (1U << 2)
@@ -176,6 +181,9 @@ typedef pstatus_t (*__andC_32u_t)(const UINT32* WINPR_RESTRICT pSrc, UINT32 val,
 	                              UINT32* WINPR_RESTRICT pDst, INT32 len);
 typedef pstatus_t (*__orC_32u_t)(const UINT32* WINPR_RESTRICT pSrc, UINT32 val,
 	                             UINT32* WINPR_RESTRICT pDst, INT32 len);
+typedef pstatus_t (*__expandMask_8u32u_t)(const BYTE* WINPR_RESTRICT pMask, UINT32 maskStep,
+	                                      BYTE* WINPR_RESTRICT pDst, UINT32 dstStep, UINT32 width,
+	                                      UINT32 height, UINT32 foreColor, UINT32 backColor);
 typedef pstatus_t (*primitives_uninit_t)(void);
 
 typedef struct
@@ -229,6 +237,8 @@ typedef struct
 	__add_16s_inplace_t add_16s_inplace;
 	__lShiftC_16s_inplace_t lShiftC_16s_inplace;
 	__copy_no_overlap_t copy_no_overlap;
+	/** \brief Paint a 32 bit pixel for every byte of a PRIM_MASK_* coverage mask */
+	__expandMask_8u32u_t expandMask_8u32u;
 } primitives_t;
 
 typedef enum
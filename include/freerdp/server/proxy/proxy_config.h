@@ -112,6 +112,14 @@ extern "C"
 
 		/* target continued */
 		UINT32 TargetTlsSecLevel;
+
+		/* security continued */
+		UINT32 TlsSessionCacheSize; /* 0 disables TLS session resumption */
+		UINT32 TlsSessionLifetime;
+		char* TlsSessionCacheName; /* shared memory name, NULL for a private cache */
+
+		/* server continued */
+		UINT32 MetricsInterval; /* seconds between session metrics logs, 0 disables them */
 	};
 
 	/**
@@ -26,6 +26,7 @@
 #include <freerdp/freerdp.h>
 #include <freerdp/settings.h>
 #include <freerdp/listener.h>
+#include <freerdp/crypto/tls_session_cache.h>
 
 #include <freerdp/channels/wtsvc.h>
 #include <freerdp/channels/channels.h>
@@ -174,6 +175,22 @@ extern "C"
 		freerdp_listener* listener;
 
 		size_t maxClientsConnected;
+
+		/* TLS session resumption, shared by all clients */
+		size_t tlsSessionCacheSize;
+		UINT32 tlsSessionLifetime;
+		rdpTlsSessionCache* tlsSessionCache;
+
+		/* log the connection metrics of each client every metricsInterval seconds, 0 to
+		 * deactivate */
+		UINT32 metricsInterval;
+
+		/* mirror the bitmap cache of clients without graphics pipeline to send repeating
+		 * tiles only once */
+		BOOL bitmapCache;
+
+		/* draw the bitmaps a client offers from its persistent cache by their key alone */
+		BOOL bitmapCachePersist;
 	};
 
 	struct rdp_shadow_surface
@@ -299,6 +316,22 @@ extern "C"
 		UINT16 right;
 	} SHADOW_MSG_OUT_AUDIO_OUT_VOLUME;
 
+	/** Inputs and decisions of the per client H.264 rate controller */
+	typedef struct
+	{
+		UINT32 bandwidth;        /* last measured bandwidth in kbit/s, 0 if unknown */
+		UINT32 rtt;              /* last measured round trip time in ms, 0 if unknown */
+		UINT32 ackLatency;       /* smoothed frame acknowledge latency in ms */
+		UINT32 baseLatency;      /* lowest recent frame acknowledge latency in ms */
+		UINT32 bitRate;          /* target bit rate in bit/s */
+		UINT32 fps;              /* frame rate cap */
+		UINT32 qpOffset;         /* QP increase applied in constant QP mode */
+		UINT32 textQPOffset;     /* QP decrease hinted for text regions */
+		UINT32 videoQPOffset;    /* total QP increase for natural content, includes qpOffset */
+		UINT32 congestionEvents; /* number of multiplicative decreases */
+		UINT32 decisions;        /* number of times a decision changed */
+	} SHADOW_RATE_CONTROL_METRICS;
+
 	FREERDP_API void shadow_subsystem_set_entry_builtin(const char* name);
 	FREERDP_API void shadow_subsystem_set_entry(pfnShadowSubsystemEntry pEntry);
 
@@ -356,6 +389,8 @@ extern "C"
 
 	FREERDP_API UINT32 shadow_encoder_preferred_fps(rdpShadowEncoder* encoder);
 	FREERDP_API UINT32 shadow_encoder_inflight_frames(rdpShadowEncoder* encoder);
+	FREERDP_API BOOL shadow_encoder_get_rate_control_metrics(rdpShadowEncoder* encoder,
+	                                                         SHADOW_RATE_CONTROL_METRICS* metrics);
 
 	FREERDP_API BOOL shadow_screen_resize(rdpShadowScreen* screen);
 
@@ -32,6 +32,15 @@ extern "C"
 
 	FREERDP_API const char* drdynvc_get_packet_type(BYTE cmd);
 
+	/** @brief check a dynamic channel name against a comma separated list of names
+	 *
+	 *  @param list the list as in FreeRDP_DynamicChannelCompression, \b * matches all names
+	 *  @param name the channel name
+	 *
+	 *  @return TRUE if the name is in the list, FALSE otherwise or if the list is NULL
+	 */
+	FREERDP_API BOOL drdynvc_channel_name_in_list(const char* list, const char* name);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,101 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ *
+ * Dynamic virtual channel send scheduler
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_UTILS_DVC_SCHEDULER_H
+#define FREERDP_UTILS_DVC_SCHEDULER_H
+
+#include <winpr/wtypes.h>
+#include <winpr/stream.h>
+#include <freerdp/api.h>
+
+/** @brief number of DVC priority classes, [MS-RDPEDYC] 2.2.2.1 */
+#define DVC_PRIORITY_CLASSES 4
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	/** @brief Orders the PDUs of dynamic virtual channels for sending.
+	 *
+	 *  The priority classes share the bandwidth in inverse proportion to their priority
+	 *  charges ([MS-RDPEDYC] 2.2.1.1.2), the channels of a class are served round robin one
+	 *  PDU at a time. PDUs of a single channel keep their order.
+	 */
+	typedef struct s_rdp_dvc_scheduler rdpDvcScheduler;
+
+	typedef void (*pfnDvcSchedulerStreamFree)(wStream* s);
+
+	typedef struct
+	{
+		size_t QueuedChunks;
+		size_t QueuedBytes;
+		size_t MaxQueuedBytes;
+		UINT64 SentChunks;
+		UINT64 SentBytes;
+		UINT64 TotalWaitUs;
+		UINT64 MaxWaitUs;
+	} DVC_SCHEDULER_STATS;
+
+	FREERDP_API void dvc_scheduler_free(rdpDvcScheduler* scheduler);
+
+	/** @brief create a scheduler with the default priority charges
+	 *
+	 *  @param fnStreamFree releases queued streams that are dropped, must not be NULL
+	 */
+	WINPR_ATTR_MALLOC(dvc_scheduler_free, 1)
+	FREERDP_API rdpDvcScheduler* dvc_scheduler_new(pfnDvcSchedulerStreamFree fnStreamFree);
+
+	/** @brief apply the charges of a DYNVC_CAPS_VERSION2 or 3 PDU, 0 keeps the default */
+	FREERDP_API void dvc_scheduler_set_priority_charges(rdpDvcScheduler* scheduler,
+	                                                    const UINT16* charges, size_t count);
+
+	/** @brief the charges in use, to announce them in a DYNVC_CAPS_VERSION2 PDU */
+	FREERDP_API void dvc_scheduler_get_priority_charges(rdpDvcScheduler* scheduler,
+	                                                    UINT16* charges, size_t count);
+
+	/** @brief queue a PDU, the scheduler owns the stream afterwards
+	 *
+	 *  @param scheduler the scheduler
+	 *  @param channelId the dynamic channel the PDU belongs to
+	 *  @param priority the priority class of the channel, 0 (highest) to 3
+	 *  @param s the PDU, the bytes up to the stream position are sent
+	 *
+	 *  @return TRUE on success, FALSE if the stream could not be queued and was released
+	 */
+	FREERDP_API BOOL dvc_scheduler_enqueue(rdpDvcScheduler* scheduler, UINT32 channelId,
+	                                       BYTE priority, wStream* s);
+
+	/** @brief take the next PDU to send, NULL if nothing is queued */
+	FREERDP_API wStream* dvc_scheduler_dequeue(rdpDvcScheduler* scheduler);
+
+	/** @brief number of queued PDUs */
+	FREERDP_API size_t dvc_scheduler_pending(rdpDvcScheduler* scheduler);
+
+	/** @brief release all queued PDUs */
+	FREERDP_API void dvc_scheduler_clear(rdpDvcScheduler* scheduler);
+
+	/** @brief queue depth and wait time of a priority class */
+	FREERDP_API BOOL dvc_scheduler_get_stats(rdpDvcScheduler* scheduler, BYTE priority,
+	                                         DVC_SCHEDULER_STATS* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_UTILS_DVC_SCHEDULER_H */
@@ -19,9 +19,52 @@
 
 #include <freerdp/config.h>
 
+#include <winpr/assert.h>
+#include <winpr/synch.h>
+
 #include <freerdp/codec/bitmap.h>
 #include <freerdp/codec/planar.h>
 
+#include "bitmap_rle.h"
+#include "sse/bitmap_sse2.h"
+
+static BITMAP_RLE_KERNELS bitmap_rle_kernels = { 0 };
+static INIT_ONCE bitmap_rle_init_once = INIT_ONCE_STATIC_INIT;
+
+static size_t bitmap_rle_span_generic(const BYTE* WINPR_RESTRICT line,
+                                      const BYTE* WINPR_RESTRICT above, size_t count,
+                                      size_t pixelSize)
+{
+	size_t x = 1;
+
+	for (; x < count; x++)
+	{
+		if (memcmp(&line[x * pixelSize], line, pixelSize) != 0)
+			break;
+		if (above && (memcmp(&above[x * pixelSize], above, pixelSize) != 0))
+			break;
+	}
+
+	return x - 1;
+}
+
+void bitmap_rle_init_generic(BITMAP_RLE_KERNELS* kernels)
+{
+	WINPR_ASSERT(kernels);
+	kernels->span = bitmap_rle_span_generic;
+}
+
+static BOOL CALLBACK bitmap_rle_init(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	WINPR_UNUSED(once);
+	WINPR_UNUSED(param);
+	WINPR_UNUSED(context);
+
+	bitmap_rle_init_generic(&bitmap_rle_kernels);
+	bitmap_rle_init_sse2(&bitmap_rle_kernels);
+	return TRUE;
+}
+
 static INLINE UINT16 GETPIXEL16(const void* WINPR_RESTRICT d, UINT32 x, UINT32 y, UINT32 w)
 {
 	const BYTE* WINPR_RESTRICT src = (const BYTE*)d + ((y * w + x) * sizeof(UINT16));
@@ -184,7 +227,7 @@ static INLINE UINT16 out_copy_count_3(UINT16 in_count, wStream* WINPR_RESTRICT i
 			Stream_Write_UINT16(in_s, in_count);
 		}
 
-		Stream_Write(in_s, Stream_Pointer(in_data), in_count * 3);
+		Stream_Write(in_s, Stream_Buffer(in_data), in_count * 3);
 	}
 
 	Stream_SetPosition(in_data, 0);
@@ -441,6 +484,53 @@ static INLINE UINT16 out_from_count_3(UINT16 in_count, wStream* WINPR_RESTRICT i
 #define OUT_FOM_COUNT3(in_count, in_s, in_mask, in_mask_len) \
 	in_count = out_from_count_3(in_count, in_s, in_mask, in_mask_len)
 
+/*****************************************************************************/
+/* literal pixels of a span found by bitmap_rle_kernels.span */
+static INLINE BOOL out_repeat_pixel(wStream* WINPR_RESTRICT temp_s, const char* pixel,
+                                    size_t pixelSize, size_t count)
+{
+	const size_t size = pixelSize * count;
+
+	if (Stream_GetRemainingCapacity(temp_s) < size)
+		return FALSE;
+
+	BYTE* dst = Stream_Pointer(temp_s);
+	memcpy(dst, pixel, pixelSize);
+	bitmap_rle_repeat(dst, pixelSize, size);
+	Stream_Seek(temp_s, size);
+	return TRUE;
+}
+
+/*****************************************************************************/
+/* fill or mix mask bits of a span, whole bytes at a time where possible */
+static INLINE void out_fom_mask_span(char* fom_mask, size_t* fom_mask_len, UINT16* fom_count,
+                                     size_t count, BOOL mix)
+{
+	while (count > 0)
+	{
+		const UINT32 bit = *fom_count % 8;
+
+		if (bit == 0)
+		{
+			if (count >= 8)
+			{
+				fom_mask[(*fom_mask_len)++] = mix ? (char)0xFF : 0;
+				*fom_count += 8;
+				count -= 8;
+				continue;
+			}
+
+			fom_mask[(*fom_mask_len)++] = 0;
+		}
+
+		if (mix)
+			fom_mask[*fom_mask_len - 1] |= (char)(1 << bit);
+
+		(*fom_count)++;
+		count--;
+	}
+}
+
 #define TEST_FILL ((last_line == 0 && pixel == 0) || (last_line != 0 && pixel == ypixel))
 #define TEST_MIX ((last_line == 0 && pixel == mix) || (last_line != 0 && pixel == (ypixel ^ mix)))
 #define TEST_FOM TEST_FILL || TEST_MIX
@@ -642,6 +732,32 @@ static INLINE SSIZE_T freerdp_bitmap_compress_24(const void* WINPR_RESTRICT srcD
 			count++;
 			last_pixel = pixel;
 			last_ypixel = ypixel;
+
+			/* while this pixel and the one above repeat, every pixel only extends the
+			 * runs that are already open, so skip the span in one step */
+			if ((color_count > 0) && (j + 1 < width))
+			{
+				const char* src = &line[4ull * j];
+				const char* above = last_line ? &last_line[4ull * j] : NULL;
+				const size_t n = bitmap_rle_kernels.span((const BYTE*)src, (const BYTE*)above,
+				                                         width - j, 4);
+
+				if (n > 0)
+				{
+					if (!out_repeat_pixel(temp_s, src, 3, n))
+						return -1;
+					if (TEST_FILL)
+						fill_count += (UINT16)n;
+					if (TEST_MIX)
+						mix_count += (UINT16)n;
+					if (TEST_FOM)
+						out_fom_mask_span(fom_mask, &fom_mask_len, &fom_count, n,
+						                  pixel == (ypixel ^ mix));
+					color_count += (UINT16)n;
+					count += (UINT16)n;
+					j += (UINT32)n;
+				}
+			}
 		}
 
 		/* can't take fix, mix, or fom past first line */
@@ -946,6 +1062,31 @@ static INLINE SSIZE_T freerdp_bitmap_compress_16(const void* WINPR_RESTRICT srcD
 			count++;
 			last_pixel = pixel;
 			last_ypixel = ypixel;
+
+			/* see freerdp_bitmap_compress_24 */
+			if ((color_count > 0) && (j + 1 < width))
+			{
+				const char* src = &line[2ull * j];
+				const char* above = last_line ? &last_line[2ull * j] : NULL;
+				const size_t n = bitmap_rle_kernels.span((const BYTE*)src, (const BYTE*)above,
+				                                         width - j, 2);
+
+				if (n > 0)
+				{
+					if (!out_repeat_pixel(temp_s, src, 2, n))
+						return -1;
+					if (TEST_FILL)
+						fill_count += (UINT16)n;
+					if (TEST_MIX)
+						mix_count += (UINT16)n;
+					if (TEST_FOM)
+						out_fom_mask_span(fom_mask, &fom_mask_len, &fom_count, n,
+						                  pixel == (ypixel ^ mix));
+					color_count += (UINT16)n;
+					count += (UINT16)n;
+					j += (UINT32)n;
+				}
+			}
 		}
 
 		/* can't take fix, mix, or fom past first line */
@@ -1075,6 +1216,7 @@ SSIZE_T freerdp_bitmap_compress(const void* WINPR_RESTRICT srcData, UINT32 width
                                 wStream* WINPR_RESTRICT s, UINT32 bpp, UINT32 byte_limit,
                                 UINT32 start_line, wStream* WINPR_RESTRICT temp_s, UINT32 e)
 {
+	InitOnceExecuteOnce(&bitmap_rle_init_once, bitmap_rle_init, NULL, NULL);
 	Stream_SetPosition(temp_s, 0);
 
 	switch (bpp)
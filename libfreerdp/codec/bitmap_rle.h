@@ -0,0 +1,57 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Interleaved RLE Run Detection
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CODEC_BITMAP_RLE_H
+#define FREERDP_LIB_CODEC_BITMAP_RLE_H
+
+#include <string.h>
+
+#include <winpr/wtypes.h>
+
+#include <freerdp/api.h>
+#include <freerdp/types.h>
+
+/** @brief number of pixels after the first one that repeat it
+ *
+ *  \b count pixels of \b pixelSize (2 or 4) bytes are available at \b line. If \b above
+ *  is not NULL the span also ends where the pixels of \b above stop repeating its first one.
+ */
+typedef size_t (*pBitmapRleSpan)(const BYTE* WINPR_RESTRICT line,
+                                 const BYTE* WINPR_RESTRICT above, size_t count,
+                                 size_t pixelSize);
+
+typedef struct
+{
+	pBitmapRleSpan span;
+} BITMAP_RLE_KERNELS;
+
+FREERDP_LOCAL void bitmap_rle_init_generic(BITMAP_RLE_KERNELS* kernels);
+
+/** @brief repeat the first \b patternSize bytes of \b data until \b size bytes are filled */
+static INLINE void bitmap_rle_repeat(BYTE* data, size_t patternSize, size_t size)
+{
+	size_t done = MIN(patternSize, size);
+
+	while (done < size)
+	{
+		const size_t chunk = MIN(done, size - done);
+		memcpy(&data[done], data, chunk);
+		done += chunk;
+	}
+}
+
+#endif /* FREERDP_LIB_CODEC_BITMAP_RLE_H */
@@ -57,6 +57,7 @@
 #include <soxr.h>
 #endif
 
+#include "dsp_resample.h"
 #else
 #include "dsp_ffmpeg.h"
 #endif
@@ -117,6 +118,8 @@ struct S_FREERDP_DSP_CONTEXT
 
 #if defined(WITH_SOXR)
 	soxr_t sox;
+#else
+	FREERDP_DSP_RESAMPLER* resampler;
 #endif
 };
 
@@ -144,6 +147,7 @@ static INT16 read_int16(const BYTE* WINPR_RESTRICT src)
 	return (INT16)(src[0] | (src[1] << 8));
 }
 
+#if defined(WITH_SOXR)
 static BOOL freerdp_dsp_channel_mix(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
                                     const BYTE* WINPR_RESTRICT src, size_t size,
                                     const AUDIO_FORMAT* WINPR_RESTRICT srcFormat,
@@ -237,7 +241,6 @@ static BOOL freerdp_dsp_resample(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
                                  const AUDIO_FORMAT* WINPR_RESTRICT srcFormat,
                                  const BYTE** WINPR_RESTRICT data, size_t* WINPR_RESTRICT length)
 {
-#if defined(WITH_SOXR)
 	soxr_error_t error;
 	size_t idone, odone;
 	size_t sframes, rframes;
@@ -246,7 +249,6 @@ static BOOL freerdp_dsp_resample(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
 	size_t dstChannels;
 	size_t srcChannels;
 	size_t srcBytesPerFrame, dstBytesPerFrame;
-#endif
 	AUDIO_FORMAT format;
 
 	if (srcFormat->wFormatTag != WAVE_FORMAT_PCM)
@@ -269,7 +271,6 @@ static BOOL freerdp_dsp_resample(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
 		return TRUE;
 	}
 
-#if defined(WITH_SOXR)
 	srcBytesPerFrame = (srcFormat->wBitsPerSample > 8) ? 2 : 1;
 	dstBytesPerFrame = (context->format.wBitsPerSample > 8) ? 2 : 1;
 	srcChannels = srcFormat->nChannels;
@@ -291,9 +292,38 @@ static BOOL freerdp_dsp_resample(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
 	*data = Stream_Buffer(context->resample);
 	*length = Stream_Length(context->resample);
 	return (error == 0) ? TRUE : FALSE;
+}
+#endif
+
+/**
+ * Mix channels, resample and convert the sample size of PCM input to the
+ * context format. Without soxr this is done in a single pass by the built in
+ * polyphase resampler.
+ */
+static BOOL freerdp_dsp_mix_resample(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
+                                     const BYTE* WINPR_RESTRICT src, size_t size,
+                                     const AUDIO_FORMAT* WINPR_RESTRICT srcFormat,
+                                     const BYTE** WINPR_RESTRICT data,
+                                     size_t* WINPR_RESTRICT length)
+{
+#if defined(WITH_SOXR)
+	const BYTE* resampleData;
+	size_t resampleLength;
+	AUDIO_FORMAT format = *srcFormat;
+
+	if (!freerdp_dsp_channel_mix(context, src, size, srcFormat, &resampleData, &resampleLength))
+		return FALSE;
+
+	format.nChannels = context->format.nChannels;
+	return freerdp_dsp_resample(context, resampleData, resampleLength, &format, data, length);
 #else
-	WLog_ERR(TAG, "Missing resample support, recompile -DWITH_SOXR=ON or -DWITH_DSP_FFMPEG=ON");
-	return FALSE;
+	AUDIO_FORMAT format = context->format;
+
+	/* Encoders other than PCM consume 16bit samples */
+	if (format.wFormatTag != WAVE_FORMAT_PCM)
+		format.wBitsPerSample = 16;
+
+	return dsp_resampler_process(context->resampler, srcFormat, &format, src, size, data, length);
 #endif
 }
 
@@ -1137,6 +1167,13 @@ FREERDP_DSP_CONTEXT* freerdp_dsp_context_new(BOOL encoder)
 	if (!context->buffer)
 		goto fail;
 
+#if !defined(WITH_SOXR)
+	context->resampler = dsp_resampler_new();
+
+	if (!context->resampler)
+		goto fail;
+#endif
+
 	context->encoder = encoder;
 #if defined(WITH_GSM)
 	context->gsm = gsm_create();
@@ -1233,6 +1270,8 @@ void freerdp_dsp_context_free(FREERDP_DSP_CONTEXT* context)
 #endif
 #if defined(WITH_SOXR)
 		soxr_delete(context->sox);
+#else
+		dsp_resampler_free(context->resampler);
 #endif
 		free(context);
 	}
@@ -1247,22 +1286,18 @@ BOOL freerdp_dsp_encode(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
 #if defined(WITH_DSP_FFMPEG)
 	return freerdp_dsp_ffmpeg_encode(context, srcFormat, data, length, out);
 #else
-	const BYTE* resampleData;
-	size_t resampleLength;
-	AUDIO_FORMAT format;
+	const BYTE* resampleData = NULL;
+	size_t resampleLength = 0;
 
 	if (!context || !context->encoder || !srcFormat || !data || !out)
 		return FALSE;
 
-	format = *srcFormat;
-
-	if (!freerdp_dsp_channel_mix(context, data, length, srcFormat, &resampleData, &resampleLength))
+	if (!freerdp_dsp_mix_resample(context, data, length, srcFormat, &resampleData,
+	                              &resampleLength))
 		return FALSE;
 
-	format.nChannels = context->format.nChannels;
-
-	if (!freerdp_dsp_resample(context, resampleData, resampleLength, &format, &data, &length))
-		return FALSE;
+	data = resampleData;
+	length = resampleLength;
 
 	switch (context->format.wFormatTag)
 	{
@@ -1511,7 +1546,9 @@ BOOL freerdp_dsp_context_reset(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
 	}
 
 #endif
-#if defined(WITH_SOXR)
+#if !defined(WITH_SOXR)
+	dsp_resampler_reset(context->resampler);
+#else
 	{
 		soxr_io_spec_t iospec = soxr_io_spec(SOXR_INT16, SOXR_INT16);
 		soxr_error_t error;
@@ -1526,3 +1563,25 @@ BOOL freerdp_dsp_context_reset(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
 	return TRUE;
 #endif
 }
+
+BOOL freerdp_dsp_context_set_resample_quality(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
+                                              FREERDP_DSP_RESAMPLE_QUALITY quality)
+{
+	if (!context)
+		return FALSE;
+
+	switch (quality)
+	{
+		case FREERDP_DSP_RESAMPLE_QUALITY_LOW:
+		case FREERDP_DSP_RESAMPLE_QUALITY_MEDIUM:
+		case FREERDP_DSP_RESAMPLE_QUALITY_HIGH:
+			break;
+		default:
+			return FALSE;
+	}
+
+#if !defined(WITH_DSP_FFMPEG) && !defined(WITH_SOXR)
+	dsp_resampler_set_quality(context->resampler, quality);
+#endif
+	return TRUE;
+}
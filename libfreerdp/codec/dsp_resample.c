@@ -0,0 +1,549 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Digital Sound Processing - Polyphase Resampler
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <math.h>
+
+#include <winpr/crt.h>
+#include <winpr/assert.h>
+
+#include <freerdp/log.h>
+
+#include "dsp_resample.h"
+#include "sse/dsp_sse2.h"
+#include "sse/dsp_avx2.h"
+#include "neon/dsp_neon.h"
+
+#define TAG FREERDP_TAG("codec.dsp.resample")
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* Phases are quantized for rate pairs with a large common multiple */
+#define DSP_RESAMPLE_MAX_PHASES 1024
+#define DSP_RESAMPLE_MAX_TAPS 256
+#define DSP_RESAMPLE_MAX_CHANNELS 2
+
+/* Fraction of the nyquist frequency passed without attenuation */
+#define DSP_RESAMPLE_ROLLOFF 0.92
+
+struct S_FREERDP_DSP_RESAMPLER
+{
+	DSP_RESAMPLE_KERNELS kernels;
+	FREERDP_DSP_RESAMPLE_QUALITY quality;
+
+	/* Formats the current configuration was built for */
+	BOOL configured;
+	UINT32 srcRate;
+	UINT32 dstRate;
+	UINT16 srcChannels;
+	UINT16 dstChannels;
+	UINT16 srcBits;
+	UINT16 dstBits;
+
+	/* Polyphase filter bank, phases rows of taps Q14 coefficients */
+	UINT32 up;
+	UINT32 down;
+	size_t phases;
+	size_t taps;
+	INT16* bank;
+
+	/* Planar history of the filtered channels, min(srcChannels, dstChannels) */
+	UINT16 channels;
+	INT16* history[DSP_RESAMPLE_MAX_CHANNELS];
+	size_t historyLength;
+	size_t historyCapacity;
+	size_t position; /* history index of the next output frame */
+	UINT32 phase;    /* fractional part of the position in 1/up */
+
+	wStream* out;
+};
+
+static INT32 dsp_resample_dot_generic(const INT16* WINPR_RESTRICT coeffs,
+                                      const INT16* WINPR_RESTRICT samples, size_t count)
+{
+	INT32 sum = 0;
+
+	for (size_t x = 0; x < count; x++)
+		sum += coeffs[x] * samples[x];
+
+	return sum;
+}
+
+static UINT32 dsp_resample_gcd(UINT32 a, UINT32 b)
+{
+	while (b != 0)
+	{
+		const UINT32 t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+static size_t dsp_resample_base_taps(FREERDP_DSP_RESAMPLE_QUALITY quality)
+{
+	switch (quality)
+	{
+		case FREERDP_DSP_RESAMPLE_QUALITY_LOW:
+			return 16;
+		case FREERDP_DSP_RESAMPLE_QUALITY_HIGH:
+			return 64;
+		case FREERDP_DSP_RESAMPLE_QUALITY_MEDIUM:
+		default:
+			return 32;
+	}
+}
+
+static BOOL dsp_resample_build_bank(FREERDP_DSP_RESAMPLER* WINPR_RESTRICT resampler)
+{
+	WINPR_ASSERT(resampler);
+
+	const UINT32 gcd = dsp_resample_gcd(resampler->srcRate, resampler->dstRate);
+	resampler->up = resampler->dstRate / gcd;
+	resampler->down = resampler->srcRate / gcd;
+	resampler->phases = MIN(resampler->up, DSP_RESAMPLE_MAX_PHASES);
+
+	/* Downsampling narrows the pass band, the filter must get longer to keep
+	 * the same transition width in output samples. */
+	const size_t factor = (resampler->down + resampler->up - 1) / resampler->up;
+	size_t taps = dsp_resample_base_taps(resampler->quality) * factor;
+	taps = MIN((taps + 15) & ~(size_t)15, DSP_RESAMPLE_MAX_TAPS);
+	resampler->taps = taps;
+
+	free(resampler->bank);
+	resampler->bank = calloc(resampler->phases * taps, sizeof(INT16));
+	if (!resampler->bank)
+		return FALSE;
+
+	/* Cutoff in cycles per input sample */
+	const double ratio = MIN(1.0, (double)resampler->up / resampler->down);
+	const double cutoff = 0.5 * ratio * DSP_RESAMPLE_ROLLOFF;
+	const double half = (double)taps / 2.0;
+	double* tmp = calloc(taps, sizeof(double));
+	if (!tmp)
+		return FALSE;
+
+	for (size_t p = 0; p < resampler->phases; p++)
+	{
+		INT16* row = &resampler->bank[p * taps];
+		const double frac = (double)p / (double)resampler->phases;
+		double sum = 0.0;
+		INT32 isum = 0;
+		size_t center = 0;
+
+		for (size_t k = 0; k < taps; k++)
+		{
+			/* Distance of tap k to the output position, taps are centered on it */
+			const double t = frac + half - 1.0 - (double)k;
+			const double x = 2.0 * cutoff * t;
+			const double sinc = (fabs(x) < 1e-9) ? 1.0 : sin(M_PI * x) / (M_PI * x);
+			/* Blackman window */
+			const double w = (fabs(t) >= half) ? 0.0
+			                                   : 0.42 + 0.5 * cos(M_PI * t / half) +
+			                                         0.08 * cos(2.0 * M_PI * t / half);
+			tmp[k] = 2.0 * cutoff * sinc * w;
+			sum += tmp[k];
+		}
+
+		/* Unity DC gain per phase, rounding error goes to the center tap */
+		for (size_t k = 0; k < taps; k++)
+		{
+			const double c = tmp[k] / sum * (1 << DSP_RESAMPLE_COEFF_SHIFT);
+			row[k] = (INT16)lround(c);
+			isum += row[k];
+			if (fabs(tmp[k]) > fabs(tmp[center]))
+				center = k;
+		}
+		row[center] = (INT16)(row[center] + (1 << DSP_RESAMPLE_COEFF_SHIFT) - isum);
+	}
+
+	free(tmp);
+	return TRUE;
+}
+
+static void dsp_resample_clear_history(FREERDP_DSP_RESAMPLER* WINPR_RESTRICT resampler)
+{
+	WINPR_ASSERT(resampler);
+
+	/* Pre-roll with silence so the first output frame is centered on input frame 0 */
+	const size_t preroll = resampler->taps / 2 - 1;
+	for (size_t c = 0; c < resampler->channels; c++)
+	{
+		if (resampler->history[c])
+			memset(resampler->history[c], 0, preroll * sizeof(INT16));
+	}
+	resampler->historyLength = preroll;
+	resampler->position = preroll;
+	resampler->phase = 0;
+}
+
+static BOOL dsp_resample_ensure_history(FREERDP_DSP_RESAMPLER* WINPR_RESTRICT resampler,
+                                        size_t frames)
+{
+	WINPR_ASSERT(resampler);
+
+	const size_t required = resampler->historyLength + frames;
+	if (required <= resampler->historyCapacity)
+		return TRUE;
+
+	const size_t capacity = MAX(required, resampler->historyCapacity * 2);
+	for (size_t c = 0; c < resampler->channels; c++)
+	{
+		INT16* tmp = realloc(resampler->history[c], capacity * sizeof(INT16));
+		if (!tmp)
+			return FALSE;
+		resampler->history[c] = tmp;
+	}
+	resampler->historyCapacity = capacity;
+	return TRUE;
+}
+
+static BOOL dsp_resample_configure(FREERDP_DSP_RESAMPLER* WINPR_RESTRICT resampler,
+                                   const AUDIO_FORMAT* WINPR_RESTRICT srcFormat,
+                                   const AUDIO_FORMAT* WINPR_RESTRICT dstFormat)
+{
+	WINPR_ASSERT(resampler);
+	WINPR_ASSERT(srcFormat);
+	WINPR_ASSERT(dstFormat);
+
+	const UINT16 srcBits = (srcFormat->wBitsPerSample > 8) ? 16 : 8;
+	const UINT16 dstBits = (dstFormat->wBitsPerSample > 8) ? 16 : 8;
+
+	if (resampler->configured && (resampler->srcRate == srcFormat->nSamplesPerSec) &&
+	    (resampler->dstRate == dstFormat->nSamplesPerSec) &&
+	    (resampler->srcChannels == srcFormat->nChannels) &&
+	    (resampler->dstChannels == dstFormat->nChannels) && (resampler->srcBits == srcBits) &&
+	    (resampler->dstBits == dstBits))
+		return TRUE;
+
+	resampler->configured = FALSE;
+
+	if ((srcFormat->nSamplesPerSec == 0) || (dstFormat->nSamplesPerSec == 0))
+		return FALSE;
+
+	if ((srcFormat->nChannels != dstFormat->nChannels) &&
+	    ((srcFormat->nChannels > DSP_RESAMPLE_MAX_CHANNELS) ||
+	     (dstFormat->nChannels > DSP_RESAMPLE_MAX_CHANNELS)))
+	{
+		WLog_ERR(TAG, "unsupported channel mix %" PRIu16 " -> %" PRIu16, srcFormat->nChannels,
+		         dstFormat->nChannels);
+		return FALSE;
+	}
+
+	if ((srcFormat->nChannels == 0) || (dstFormat->nChannels == 0))
+		return FALSE;
+
+	resampler->srcRate = srcFormat->nSamplesPerSec;
+	resampler->dstRate = dstFormat->nSamplesPerSec;
+	resampler->srcChannels = srcFormat->nChannels;
+	resampler->dstChannels = dstFormat->nChannels;
+	resampler->srcBits = srcBits;
+	resampler->dstBits = dstBits;
+
+	if (resampler->srcRate != resampler->dstRate)
+	{
+		if (MIN(resampler->srcChannels, resampler->dstChannels) > DSP_RESAMPLE_MAX_CHANNELS)
+		{
+			WLog_ERR(TAG, "unsupported channel count %" PRIu16, resampler->srcChannels);
+			return FALSE;
+		}
+
+		for (size_t c = 0; c < DSP_RESAMPLE_MAX_CHANNELS; c++)
+		{
+			free(resampler->history[c]);
+			resampler->history[c] = NULL;
+		}
+		resampler->historyCapacity = 0;
+		resampler->historyLength = 0;
+		resampler->channels = MIN(resampler->srcChannels, resampler->dstChannels);
+
+		if (!dsp_resample_build_bank(resampler))
+			return FALSE;
+		if (!dsp_resample_ensure_history(resampler, resampler->taps))
+			return FALSE;
+		dsp_resample_clear_history(resampler);
+	}
+
+	WLog_DBG(TAG,
+	         "%" PRIu32 " Hz %" PRIu16 " ch %" PRIu16 " bit -> %" PRIu32 " Hz %" PRIu16
+	         " ch %" PRIu16 " bit, %" PRIuz " taps",
+	         resampler->srcRate, resampler->srcChannels, resampler->srcBits, resampler->dstRate,
+	         resampler->dstChannels, resampler->dstBits, resampler->taps);
+	resampler->configured = TRUE;
+	return TRUE;
+}
+
+static INLINE INT32 dsp_resample_read(const BYTE* WINPR_RESTRICT src, UINT16 bits)
+{
+	if (bits == 8)
+		return ((INT32)src[0] - 128) << 8;
+	return (INT16)(src[0] | (src[1] << 8));
+}
+
+static INLINE BYTE* dsp_resample_write(BYTE* WINPR_RESTRICT dst, INT32 value, UINT16 bits)
+{
+	if (value > INT16_MAX)
+		value = INT16_MAX;
+	else if (value < INT16_MIN)
+		value = INT16_MIN;
+
+	if (bits == 8)
+	{
+		*dst++ = (BYTE)((value >> 8) + 128);
+		return dst;
+	}
+
+	*dst++ = (BYTE)(value & 0xFF);
+	*dst++ = (BYTE)((value >> 8) & 0xFF);
+	return dst;
+}
+
+/* Read one frame mixed down to the requested number of channels */
+static INLINE void dsp_resample_read_frame(const FREERDP_DSP_RESAMPLER* WINPR_RESTRICT resampler,
+                                           const BYTE* WINPR_RESTRICT src, UINT16 channels,
+                                           INT32* WINPR_RESTRICT frame)
+{
+	const size_t bps = resampler->srcBits / 8;
+
+	if ((channels == 1) && (resampler->srcChannels == 2))
+	{
+		const INT32 left = dsp_resample_read(src, resampler->srcBits);
+		const INT32 right = dsp_resample_read(src + bps, resampler->srcBits);
+		frame[0] = (left + right) >> 1;
+		return;
+	}
+
+	for (size_t c = 0; c < channels; c++)
+		frame[c] = dsp_resample_read(src + c * bps, resampler->srcBits);
+}
+
+/* Write one frame, upmixing from the given number of channels */
+static INLINE BYTE* dsp_resample_write_frame(const FREERDP_DSP_RESAMPLER* WINPR_RESTRICT resampler,
+                                             BYTE* WINPR_RESTRICT dst, UINT16 channels,
+                                             const INT32* WINPR_RESTRICT frame)
+{
+	for (size_t c = 0; c < resampler->dstChannels; c++)
+		dst = dsp_resample_write(dst, frame[MIN(c, channels - 1u)], resampler->dstBits);
+	return dst;
+}
+
+static BOOL dsp_resample_convert(FREERDP_DSP_RESAMPLER* WINPR_RESTRICT resampler,
+                                 const BYTE* WINPR_RESTRICT src, size_t frames)
+{
+	WINPR_ASSERT(resampler);
+
+	const size_t srcFrameSize = 1ull * resampler->srcChannels * resampler->srcBits / 8;
+	const size_t dstFrameSize = 1ull * resampler->dstChannels * resampler->dstBits / 8;
+	const UINT16 channels = MIN(resampler->srcChannels, resampler->dstChannels);
+
+	if (!Stream_EnsureCapacity(resampler->out, frames * dstFrameSize))
+		return FALSE;
+
+	BYTE* dst = Stream_Buffer(resampler->out);
+	for (size_t x = 0; x < frames; x++)
+	{
+		INT32 frame[32] = { 0 };
+		const UINT16 mixed = MIN(channels, ARRAYSIZE(frame));
+		dsp_resample_read_frame(resampler, &src[x * srcFrameSize], mixed, frame);
+		dst = dsp_resample_write_frame(resampler, dst, mixed, frame);
+	}
+
+	Stream_SetLength(resampler->out, frames * dstFrameSize);
+	return TRUE;
+}
+
+static BOOL dsp_resample_filter(FREERDP_DSP_RESAMPLER* WINPR_RESTRICT resampler,
+                                const BYTE* WINPR_RESTRICT src, size_t frames)
+{
+	WINPR_ASSERT(resampler);
+
+	const size_t srcFrameSize = 1ull * resampler->srcChannels * resampler->srcBits / 8;
+	const size_t dstFrameSize = 1ull * resampler->dstChannels * resampler->dstBits / 8;
+	const size_t taps = resampler->taps;
+	const UINT16 channels = resampler->channels;
+
+	if (!dsp_resample_ensure_history(resampler, frames))
+		return FALSE;
+
+	/* Mix down (if needed) while converting to the planar 16bit history */
+	for (size_t x = 0; x < frames; x++)
+	{
+		INT32 frame[DSP_RESAMPLE_MAX_CHANNELS] = { 0 };
+		dsp_resample_read_frame(resampler, &src[x * srcFrameSize], channels, frame);
+		for (size_t c = 0; c < channels; c++)
+			resampler->history[c][resampler->historyLength + x] = (INT16)frame[c];
+	}
+	resampler->historyLength += frames;
+
+	const size_t pending = resampler->historyLength - resampler->position;
+	const size_t estimate = (pending * resampler->up) / resampler->down + 2;
+	if (!Stream_EnsureCapacity(resampler->out, estimate * dstFrameSize))
+		return FALSE;
+
+	const UINT32 stepInt = resampler->down / resampler->up;
+	const UINT32 stepFrac = resampler->down % resampler->up;
+	BYTE* dst = Stream_Buffer(resampler->out);
+	size_t produced = 0;
+
+	while ((resampler->position + taps / 2 < resampler->historyLength) && (produced < estimate))
+	{
+		INT32 frame[DSP_RESAMPLE_MAX_CHANNELS] = { 0 };
+		size_t phase = resampler->phase;
+		if (resampler->phases != resampler->up)
+			phase = (1ull * phase * resampler->phases) / resampler->up;
+
+		const INT16* coeffs = &resampler->bank[phase * taps];
+		const size_t first = resampler->position + 1 - taps / 2;
+
+		for (size_t c = 0; c < channels; c++)
+		{
+			const INT32 acc = resampler->kernels.dot(coeffs, &resampler->history[c][first], taps);
+			frame[c] = (acc + (1 << (DSP_RESAMPLE_COEFF_SHIFT - 1))) >> DSP_RESAMPLE_COEFF_SHIFT;
+		}
+
+		/* Mono sources are filtered once and duplicated on upmix */
+		dst = dsp_resample_write_frame(resampler, dst, channels, frame);
+		produced++;
+
+		resampler->position += stepInt;
+		resampler->phase += stepFrac;
+		if (resampler->phase >= resampler->up)
+		{
+			resampler->phase -= resampler->up;
+			resampler->position++;
+		}
+	}
+
+	Stream_SetLength(resampler->out, produced * dstFrameSize);
+
+	/* Drop history no longer reachable by the filter */
+	const size_t keep = resampler->position + 1 - taps / 2;
+	const size_t discard = MIN(keep, resampler->historyLength);
+	if (discard > 0)
+	{
+		for (size_t c = 0; c < channels; c++)
+			memmove(resampler->history[c], &resampler->history[c][discard],
+			        (resampler->historyLength - discard) * sizeof(INT16));
+		resampler->historyLength -= discard;
+		resampler->position -= discard;
+	}
+
+	return TRUE;
+}
+
+BOOL dsp_resampler_process(FREERDP_DSP_RESAMPLER* WINPR_RESTRICT resampler,
+                           const AUDIO_FORMAT* WINPR_RESTRICT srcFormat,
+                           const AUDIO_FORMAT* WINPR_RESTRICT dstFormat,
+                           const BYTE* WINPR_RESTRICT src, size_t size,
+                           const BYTE** WINPR_RESTRICT data, size_t* WINPR_RESTRICT length)
+{
+	if (!resampler || !srcFormat || !dstFormat || !src || !data || !length)
+		return FALSE;
+
+	if (srcFormat->wFormatTag != WAVE_FORMAT_PCM)
+	{
+		WLog_ERR(TAG, "requires %s for sample input, got %s",
+		         audio_format_get_tag_string(WAVE_FORMAT_PCM),
+		         audio_format_get_tag_string(srcFormat->wFormatTag));
+		return FALSE;
+	}
+
+	if (!dsp_resample_configure(resampler, srcFormat, dstFormat))
+		return FALSE;
+
+	if ((resampler->srcRate == resampler->dstRate) &&
+	    (resampler->srcChannels == resampler->dstChannels) &&
+	    (resampler->srcBits == resampler->dstBits))
+	{
+		*data = src;
+		*length = size;
+		return TRUE;
+	}
+
+	const size_t srcFrameSize = 1ull * resampler->srcChannels * resampler->srcBits / 8;
+	const size_t frames = size / srcFrameSize;
+	BOOL rc = 0;
+
+	if (resampler->srcRate == resampler->dstRate)
+		rc = dsp_resample_convert(resampler, src, frames);
+	else
+		rc = dsp_resample_filter(resampler, src, frames);
+
+	if (!rc)
+		return FALSE;
+
+	*data = Stream_Buffer(resampler->out);
+	*length = Stream_Length(resampler->out);
+	return TRUE;
+}
+
+void dsp_resampler_set_quality(FREERDP_DSP_RESAMPLER* resampler,
+                               FREERDP_DSP_RESAMPLE_QUALITY quality)
+{
+	if (!resampler || (resampler->quality == quality))
+		return;
+
+	resampler->quality = quality;
+	resampler->configured = FALSE;
+}
+
+void dsp_resampler_reset(FREERDP_DSP_RESAMPLER* resampler)
+{
+	if (!resampler || !resampler->configured)
+		return;
+
+	if (resampler->srcRate != resampler->dstRate)
+		dsp_resample_clear_history(resampler);
+}
+
+void dsp_resampler_free(FREERDP_DSP_RESAMPLER* resampler)
+{
+	if (!resampler)
+		return;
+
+	for (size_t c = 0; c < DSP_RESAMPLE_MAX_CHANNELS; c++)
+		free(resampler->history[c]);
+	free(resampler->bank);
+	Stream_Free(resampler->out, TRUE);
+	free(resampler);
+}
+
+FREERDP_DSP_RESAMPLER* dsp_resampler_new(void)
+{
+	FREERDP_DSP_RESAMPLER* resampler = calloc(1, sizeof(FREERDP_DSP_RESAMPLER));
+
+	if (!resampler)
+		return NULL;
+
+	resampler->out = Stream_New(NULL, 4096);
+	if (!resampler->out)
+		goto fail;
+
+	resampler->quality = FREERDP_DSP_RESAMPLE_QUALITY_MEDIUM;
+	resampler->kernels.dot = dsp_resample_dot_generic;
+	dsp_resample_init_sse2(&resampler->kernels);
+	dsp_resample_init_avx2(&resampler->kernels);
+	dsp_resample_init_neon(&resampler->kernels);
+	return resampler;
+
+fail:
+	dsp_resampler_free(resampler);
+	return NULL;
+}
@@ -0,0 +1,73 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Digital Sound Processing - Polyphase Resampler
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CODEC_DSP_RESAMPLE_H
+#define FREERDP_LIB_CODEC_DSP_RESAMPLE_H
+
+#include <winpr/wtypes.h>
+#include <winpr/stream.h>
+
+#include <freerdp/api.h>
+#include <freerdp/codec/audio.h>
+#include <freerdp/codec/dsp.h>
+
+/** Filter coefficients are Q14 fixed point */
+#define DSP_RESAMPLE_COEFF_SHIFT 14
+
+/** @brief dot product of \b count Q14 coefficients with 16bit samples
+ *
+ *  \b count is always a multiple of 16, neither pointer is aligned.
+ */
+typedef INT32 (*pDspResampleDot)(const INT16* WINPR_RESTRICT coeffs,
+                                 const INT16* WINPR_RESTRICT samples, size_t count);
+
+typedef struct
+{
+	pDspResampleDot dot;
+} DSP_RESAMPLE_KERNELS;
+
+typedef struct S_FREERDP_DSP_RESAMPLER FREERDP_DSP_RESAMPLER;
+
+FREERDP_LOCAL void dsp_resampler_free(FREERDP_DSP_RESAMPLER* resampler);
+
+WINPR_ATTR_MALLOC(dsp_resampler_free, 1)
+FREERDP_LOCAL FREERDP_DSP_RESAMPLER* dsp_resampler_new(void);
+
+FREERDP_LOCAL void dsp_resampler_set_quality(FREERDP_DSP_RESAMPLER* resampler,
+                                             FREERDP_DSP_RESAMPLE_QUALITY quality);
+
+/** @brief drop buffered history, e.g. when a new stream starts */
+FREERDP_LOCAL void dsp_resampler_reset(FREERDP_DSP_RESAMPLER* resampler);
+
+/** @brief channel mix, resample and convert PCM data in one pass
+ *
+ *  Only PCM with 8 or 16 bits per sample is supported. Channel counts may
+ *  differ only between mono and stereo. The filter is rebuilt whenever the
+ *  formats change.
+ *
+ *  @param data   set to \b src if no conversion is required, otherwise to the
+ *                internal output buffer valid until the next call
+ *  @return \b TRUE on success
+ */
+FREERDP_LOCAL BOOL dsp_resampler_process(FREERDP_DSP_RESAMPLER* WINPR_RESTRICT resampler,
+                                         const AUDIO_FORMAT* WINPR_RESTRICT srcFormat,
+                                         const AUDIO_FORMAT* WINPR_RESTRICT dstFormat,
+                                         const BYTE* WINPR_RESTRICT src, size_t size,
+                                         const BYTE** WINPR_RESTRICT data,
+                                         size_t* WINPR_RESTRICT length);
+
+#endif /* FREERDP_LIB_CODEC_DSP_RESAMPLE_H */
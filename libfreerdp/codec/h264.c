@@ -35,6 +35,10 @@
 
 #define TAG FREERDP_TAG("codec")
 
+/* QP hint reduction for blocks with text or other synthetic content */
+#define H264_TEXT_QP_OFFSET 6
+#define H264_MAX_QP 51
+
 static BOOL avc444_ensure_buffer(H264_CONTEXT* h264, DWORD nDstHeight);
 
 BOOL avc420_ensure_buffer(H264_CONTEXT* h264, UINT32 stride, UINT32 width, UINT32 height)
@@ -56,7 +60,7 @@ BOOL avc420_ensure_buffer(H264_CONTEXT* h264, UINT32 stride, UINT32 width, UINT3
 
 	for (size_t x = 0; x < 3; x++)
 	{
-		if (!h264->pYUVData[x] || !h264->pOldYUVData[x])
+		if (!h264->pYUVData[x])
 			isNull = TRUE;
 	}
 
@@ -76,14 +80,19 @@ BOOL avc420_ensure_buffer(H264_CONTEXT* h264, UINT32 stride, UINT32 width, UINT3
 
 		for (size_t x = 0; x < 3; x++)
 		{
-			BYTE* tmp1 = winpr_aligned_recalloc(h264->pYUVData[x], h264->iStride[x], pheight, 16);
-			BYTE* tmp2 =
-			    winpr_aligned_recalloc(h264->pOldYUVData[x], h264->iStride[x], pheight, 16);
-			if (tmp1)
-				h264->pYUVData[x] = tmp1;
-			if (tmp2)
-				h264->pOldYUVData[x] = tmp2;
-			if (!tmp1 || !tmp2)
+			BYTE* tmp = winpr_aligned_recalloc(h264->pYUVData[x], h264->iStride[x], pheight, 16);
+			if (!tmp)
+				return FALSE;
+			h264->pYUVData[x] = tmp;
+		}
+
+		/* A new frame size starts over with a full frame */
+		if (h264->Compressor)
+		{
+			h264->firstLumaFrameDone = FALSE;
+			h264->firstChromaFrameDone = FALSE;
+			if (!yuv_signature_map_reset(&h264->lumaSignatures, width, height) ||
+			    !yuv_signature_map_reset(&h264->chromaSignatures, width, height))
 				return FALSE;
 		}
 	}
@@ -119,117 +128,160 @@ INT32 avc420_decompress(H264_CONTEXT* h264, const BYTE* pSrcData, UINT32 SrcSize
 	return 1;
 }
 
-static BOOL allocate_h264_metablock(UINT32 QP, RECTANGLE_16* rectangles,
-                                    RDPGFX_H264_METABLOCK* meta, size_t count)
+static RDPGFX_H264_QUANT_QUALITY h264_quant_quality(const H264_CONTEXT* h264, BOOL text)
+{
+	RDPGFX_H264_QUANT_QUALITY cur = { 0 };
+	UINT32 QP = h264->QP;
+
+	/* Sharp text and UI suffer most from quantization, hint a finer QP for them.
+	 * Natural content hides coarser quantization, spend fewer bits there. */
+	if (text)
+		QP = (QP > h264->TextQPOffset) ? QP - h264->TextQPOffset : 0;
+	else
+		QP = MIN(QP + h264->VideoQPOffset, H264_MAX_QP);
+
+	cur.qp = (UINT8)QP;
+
+	/* qpVal bit 6 and 7 are flags, so mask them out here.
+	 * qualityVal is [0-100] so 100 - qpVal [0-64] is always in range */
+	cur.qualityVal = 100 - (QP & 0x3F);
+	return cur;
+}
+
+static BOOL h264_ensure_change_buffer(H264_CONTEXT* h264, size_t count)
+{
+	WINPR_ASSERT(h264);
+
+	if (count <= h264->changeCapacity)
+		return TRUE;
+
+	RECTANGLE_16* rects = realloc(h264->changeRects, count * sizeof(RECTANGLE_16));
+	if (!rects)
+		return FALSE;
+	h264->changeRects = rects;
+
+	RDPGFX_H264_QUANT_QUALITY* quality =
+	    realloc(h264->changeQuality, count * sizeof(RDPGFX_H264_QUANT_QUALITY));
+	if (!quality)
+		return FALSE;
+	h264->changeQuality = quality;
+
+	h264->changeCapacity = count;
+	return TRUE;
+}
+
+/* The metablock is owned by the caller and released with free_h264_metablock */
+static BOOL allocate_h264_metablock(const H264_CONTEXT* h264, RDPGFX_H264_METABLOCK* meta,
+                                    size_t count)
 {
 	/* [MS-RDPEGFX] 2.2.4.4.2 RDPGFX_AVC420_QUANT_QUALITY */
-	if (!meta || (QP > UINT8_MAX))
-	{
-		free(rectangles);
+	if (!meta)
 		return FALSE;
-	}
 
-	meta->regionRects = rectangles;
 	if (count == 0)
 		return TRUE;
 
 	if (count > UINT32_MAX)
 		return FALSE;
 
+	meta->regionRects = calloc(count, sizeof(RECTANGLE_16));
 	meta->quantQualityVals = calloc(count, sizeof(RDPGFX_H264_QUANT_QUALITY));
 
 	if (!meta->quantQualityVals || !meta->regionRects)
 		return FALSE;
-	meta->numRegionRects = (UINT32)count;
-	for (size_t x = 0; x < count; x++)
-	{
-		RDPGFX_H264_QUANT_QUALITY* cur = &meta->quantQualityVals[x];
-		cur->qp = (UINT8)QP;
 
-		/* qpVal bit 6 and 7 are flags, so mask them out here.
-		 * qualityVal is [0-100] so 100 - qpVal [0-64] is always in range */
-		cur->qualityVal = 100 - (QP & 0x3F);
-	}
+	memcpy(meta->regionRects, h264->changeRects, count * sizeof(RECTANGLE_16));
+	memcpy(meta->quantQualityVals, h264->changeQuality, count * sizeof(RDPGFX_H264_QUANT_QUALITY));
+	meta->numRegionRects = (UINT32)count;
 	return TRUE;
 }
 
-static INLINE BOOL diff_tile(const RECTANGLE_16* regionRect, BYTE* pYUVData[3],
-                             BYTE* pOldYUVData[3], UINT32 const iStride[3])
+/**
+ * Collect the 64x64 blocks of \b regionRect whose signatures changed while converting
+ * the frame. Neighbouring blocks in a row with the same content type are merged.
+ * Blocks where most luma samples repeat their left neighbour are considered text
+ * or other synthetic content, anything else video.
+ */
+static BOOL detect_changes(H264_CONTEXT* h264, BOOL firstFrameDone,
+                           const RECTANGLE_16* regionRect, const YUV_SIGNATURE_MAP* map,
+                           RDPGFX_H264_METABLOCK* meta)
 {
-	size_t size = 0;
+	size_t count = 0;
 
-	if (!regionRect || !pYUVData || !pOldYUVData || !iStride)
-		return FALSE;
-	size = regionRect->right - regionRect->left;
-	if (regionRect->right > iStride[0])
-		return FALSE;
-	if (regionRect->right / 2u > iStride[1])
-		return FALSE;
-	if (regionRect->right / 2u > iStride[2])
+	if (!h264 || !regionRect || !map || !meta || (h264->QP > UINT8_MAX))
 		return FALSE;
 
-	for (UINT16 y = regionRect->top; y < regionRect->bottom; y++)
-	{
-		const BYTE* cur0 = &pYUVData[0][y * iStride[0]];
-		const BYTE* cur1 = &pYUVData[1][y * iStride[1]];
-		const BYTE* cur2 = &pYUVData[2][y * iStride[2]];
-		const BYTE* old0 = &pOldYUVData[0][y * iStride[0]];
-		const BYTE* old1 = &pOldYUVData[1][y * iStride[1]];
-		const BYTE* old2 = &pOldYUVData[2][y * iStride[2]];
-
-		if (memcmp(&cur0[regionRect->left], &old0[regionRect->left], size) != 0)
-			return TRUE;
-		if (memcmp(&cur1[regionRect->left / 2], &old1[regionRect->left / 2], size / 2) != 0)
-			return TRUE;
-		if (memcmp(&cur2[regionRect->left / 2], &old2[regionRect->left / 2], size / 2) != 0)
-			return TRUE;
-	}
-	return FALSE;
-}
+	const UINT32 bs = YUV_SIGNATURE_BLOCK_SIZE;
+	const UINT32 right = MIN(regionRect->right, map->width);
+	const UINT32 bottom = MIN(regionRect->bottom, map->height);
+	if ((regionRect->left >= right) || (regionRect->top >= bottom))
+		return allocate_h264_metablock(h264, meta, 0);
 
-static BOOL detect_changes(BOOL firstFrameDone, const UINT32 QP, const RECTANGLE_16* regionRect,
-                           BYTE* pYUVData[3], BYTE* pOldYUVData[3], UINT32 const iStride[3],
-                           RDPGFX_H264_METABLOCK* meta)
-{
-	size_t count = 0;
-	size_t wc = 0;
-	size_t hc = 0;
-	RECTANGLE_16* rectangles = NULL;
+	const UINT32 bxStart = regionRect->left / bs;
+	const UINT32 bxEnd = (right + bs - 1) / bs;
+	const UINT32 byStart = regionRect->top / bs;
+	const UINT32 byEnd = (bottom + bs - 1) / bs;
 
-	if (!regionRect || !pYUVData || !pOldYUVData || !iStride || !meta)
+	if (!h264_ensure_change_buffer(h264, 1ull * (bxEnd - bxStart) * (byEnd - byStart)))
 		return FALSE;
 
-	wc = (regionRect->right - regionRect->left) / 64 + 1;
-	hc = (regionRect->bottom - regionRect->top) / 64 + 1;
-	rectangles = calloc(wc * hc, sizeof(RECTANGLE_16));
-	if (!rectangles)
-		return FALSE;
 	if (!firstFrameDone)
 	{
-		rectangles[0] = *regionRect;
-		count = 1;
+		h264->changeRects[0] = *regionRect;
+		h264->changeQuality[0] = h264_quant_quality(h264, FALSE);
+		return allocate_h264_metablock(h264, meta, 1);
 	}
-	else
+
+	for (UINT32 by = byStart; by < byEnd; by++)
 	{
-		for (size_t y = regionRect->top; y < regionRect->bottom; y += 64)
+		const UINT32 top = MAX(by * bs, regionRect->top);
+		const UINT32 bot = MIN(by * bs + bs, bottom);
+		BOOL open = FALSE;
+		BOOL openText = FALSE;
+
+		for (UINT32 bx = bxStart; bx < bxEnd; bx++)
 		{
-			for (size_t x = regionRect->left; x < regionRect->right; x += 64)
+			const UINT32 left = MAX(bx * bs, regionRect->left);
+			const UINT32 width = MIN(bx * bs + bs, map->width) - bx * bs;
+			BOOL changed = FALSE;
+			size_t flat = 0;
+
+			for (UINT32 y = top; y < bot; y++)
+			{
+				const size_t index = 1ull * y * map->blocksPerRow + bx;
+				changed |= map->changed[index];
+				flat += map->flat[index];
+			}
+
+			if (!changed)
 			{
-				RECTANGLE_16 rect;
-				rect.left = (UINT16)MIN(UINT16_MAX, regionRect->left + x);
-				rect.top = (UINT16)MIN(UINT16_MAX, regionRect->top + y);
-				rect.right =
-				    (UINT16)MIN(UINT16_MAX, MIN(regionRect->left + x + 64, regionRect->right));
-				rect.bottom =
-				    (UINT16)MIN(UINT16_MAX, MIN(regionRect->top + y + 64, regionRect->bottom));
-				if (diff_tile(&rect, pYUVData, pOldYUVData, iStride))
-					rectangles[count++] = rect;
+				open = FALSE;
+				continue;
 			}
+
+			const size_t samples = 1ull * (bot - top) * (width > 1 ? width - 1 : 1);
+			const BOOL text = (flat * 4) >= (samples * 3);
+			const UINT16 end = (UINT16)MIN(bx * bs + bs, right);
+
+			if (open && (openText == text))
+			{
+				h264->changeRects[count - 1].right = end;
+				continue;
+			}
+
+			RECTANGLE_16* rect = &h264->changeRects[count];
+			rect->left = (UINT16)left;
+			rect->top = (UINT16)top;
+			rect->right = end;
+			rect->bottom = (UINT16)bot;
+			h264->changeQuality[count] = h264_quant_quality(h264, text);
+			count++;
+			open = TRUE;
+			openText = text;
 		}
 	}
-	if (!allocate_h264_metablock(QP, rectangles, meta, count))
-		return FALSE;
-	return TRUE;
+
+	return allocate_h264_metablock(h264, meta, count);
 }
 
 /**
@@ -275,9 +327,8 @@ INT32 avc420_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
                       BYTE** ppDstData, UINT32* pDstSize, RDPGFX_H264_METABLOCK* meta)
 {
 	INT32 rc = -1;
-	BYTE* pYUVData[3] = { 0 };
+	BYTE** pYUVData = NULL;
 	const BYTE* pcYUVData[3] = { 0 };
-	BYTE* pOldYUVData[3] = { 0 };
 
 	if (!h264 || !regionRect || !meta || !h264->Compressor)
 		return -1;
@@ -288,30 +339,14 @@ INT32 avc420_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
 	if (!avc420_ensure_buffer(h264, nSrcStep, nSrcWidth, nSrcHeight))
 		return -1;
 
-	if (h264->encodingBuffer)
-	{
-		for (size_t x = 0; x < 3; x++)
-		{
-			pYUVData[x] = h264->pYUVData[x];
-			pOldYUVData[x] = h264->pOldYUVData[x];
-		}
-	}
-	else
-	{
-		for (size_t x = 0; x < 3; x++)
-		{
-			pYUVData[x] = h264->pOldYUVData[x];
-			pOldYUVData[x] = h264->pYUVData[x];
-		}
-	}
-	h264->encodingBuffer = !h264->encodingBuffer;
-
-	if (!yuv420_context_encode(h264->yuv, pSrcData, nSrcStep, SrcFormat, h264->iStride, pYUVData,
-	                           regionRect, 1))
+	/* Changes are detected by block signatures computed during the conversion, so the
+	 * previous frame is not needed */
+	pYUVData = h264->pYUVData;
+	if (!yuv420_context_encode_signed(h264->yuv, pSrcData, nSrcStep, SrcFormat, h264->iStride,
+	                                  pYUVData, regionRect, &h264->lumaSignatures))
 		goto fail;
 
-	if (!detect_changes(h264->firstLumaFrameDone, h264->QP, regionRect, pYUVData, pOldYUVData,
-	                    h264->iStride, meta))
+	if (!detect_changes(h264, h264->firstLumaFrameDone, regionRect, &h264->lumaSignatures, meta))
 		goto fail;
 
 	if (meta->numRegionRects == 0)
@@ -343,9 +378,7 @@ INT32 avc444_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
 	BYTE* coded = NULL;
 	UINT32 codedSize = 0;
 	BYTE** pYUV444Data = NULL;
-	BYTE** pOldYUV444Data = NULL;
 	BYTE** pYUVData = NULL;
-	BYTE** pOldYUVData = NULL;
 
 	if (!h264 || !h264->Compressor)
 		return -1;
@@ -359,31 +392,18 @@ INT32 avc444_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
 	if (!avc444_ensure_buffer(h264, nSrcHeight))
 		return -1;
 
-	if (h264->encodingBuffer)
-	{
-		pYUV444Data = h264->pOldYUV444Data;
-		pOldYUV444Data = h264->pYUV444Data;
-		pYUVData = h264->pOldYUVData;
-		pOldYUVData = h264->pYUVData;
-	}
-	else
-	{
-		pYUV444Data = h264->pYUV444Data;
-		pOldYUV444Data = h264->pOldYUV444Data;
-		pYUVData = h264->pYUVData;
-		pOldYUVData = h264->pOldYUVData;
-	}
-	h264->encodingBuffer = !h264->encodingBuffer;
+	pYUV444Data = h264->pYUV444Data;
+	pYUVData = h264->pYUVData;
 
-	if (!yuv444_context_encode(h264->yuv, version, pSrcData, nSrcStep, SrcFormat, h264->iStride,
-	                           pYUV444Data, pYUVData, region, 1))
+	if (!yuv444_context_encode_signed(h264->yuv, version, pSrcData, nSrcStep, SrcFormat,
+	                                  h264->iStride, pYUV444Data, pYUVData, region,
+	                                  &h264->lumaSignatures, &h264->chromaSignatures))
 		goto fail;
 
-	if (!detect_changes(h264->firstLumaFrameDone, h264->QP, region, pYUV444Data, pOldYUV444Data,
-	                    h264->iStride, meta))
+	if (!detect_changes(h264, h264->firstLumaFrameDone, region, &h264->lumaSignatures, meta))
 		goto fail;
-	if (!detect_changes(h264->firstChromaFrameDone, h264->QP, region, pYUVData, pOldYUVData,
-	                    h264->iStride, auxMeta))
+	if (!detect_changes(h264, h264->firstChromaFrameDone, region, &h264->chromaSignatures,
+	                    auxMeta))
 		goto fail;
 
 	/* [MS-RDPEGFX] 2.2.4.5 RFX_AVC444_BITMAP_STREAM
@@ -446,7 +466,6 @@ static BOOL avc444_ensure_buffer(H264_CONTEXT* h264, DWORD nDstHeight)
 	UINT32* piDstSize = h264->iYUV444Size;
 	UINT32* piDstStride = h264->iYUV444Stride;
 	BYTE** ppYUVDstData = h264->pYUV444Data;
-	BYTE** ppOldYUVDstData = h264->pOldYUV444Data;
 
 	nDstHeight = MAX(h264->height, nDstHeight);
 	const UINT32 pad = nDstHeight % 16;
@@ -466,14 +485,10 @@ static BOOL avc444_ensure_buffer(H264_CONTEXT* h264, DWORD nDstHeight)
 			if (piDstSize[x] == 0)
 				return FALSE;
 
-			BYTE* tmp1 = winpr_aligned_recalloc(ppYUVDstData[x], piDstSize[x], 1, 16);
-			if (!tmp1)
-				return FALSE;
-			ppYUVDstData[x] = tmp1;
-			BYTE* tmp2 = winpr_aligned_recalloc(ppOldYUVDstData[x], piDstSize[x], 1, 16);
-			if (!tmp2)
+			BYTE* tmp = winpr_aligned_recalloc(ppYUVDstData[x], piDstSize[x], 1, 16);
+			if (!tmp)
 				return FALSE;
-			ppOldYUVDstData[x] = tmp2;
+			ppYUVDstData[x] = tmp;
 		}
 
 		{
@@ -486,7 +501,7 @@ static BOOL avc444_ensure_buffer(H264_CONTEXT* h264, DWORD nDstHeight)
 
 	for (UINT32 x = 0; x < 3; x++)
 	{
-		if (!ppOldYUVDstData[x] || !ppYUVDstData[x] || (piDstSize[x] == 0) || (piDstStride[x] == 0))
+		if (!ppYUVDstData[x] || (piDstSize[x] == 0) || (piDstStride[x] == 0))
 		{
 			WLog_Print(h264->log, WLOG_ERROR,
 			           "YUV buffer not initialized! check your decoder settings");
@@ -717,6 +732,7 @@ H264_CONTEXT* h264_context_new(BOOL Compressor)
 		/* Default compressor settings, may be changed by caller */
 		h264->BitRate = 1000000;
 		h264->FrameRate = 30;
+		h264->TextQPOffset = H264_TEXT_QP_OFFSET;
 	}
 
 	if (!h264_context_init(h264))
@@ -746,15 +762,16 @@ void h264_context_free(H264_CONTEXT* h264)
 		for (size_t x = 0; x < 3; x++)
 		{
 			if (h264->Compressor)
-			{
 				winpr_aligned_free(h264->pYUVData[x]);
-				winpr_aligned_free(h264->pOldYUVData[x]);
-			}
 			winpr_aligned_free(h264->pYUV444Data[x]);
-			winpr_aligned_free(h264->pOldYUV444Data[x]);
 		}
 		winpr_aligned_free(h264->lumaData);
 
+		yuv_signature_map_uninit(&h264->lumaSignatures);
+		yuv_signature_map_uninit(&h264->chromaSignatures);
+		free(h264->changeRects);
+		free(h264->changeQuality);
+
 		yuv_context_free(h264->yuv);
 		free(h264);
 	}
@@ -790,6 +807,12 @@ BOOL h264_context_set_option(H264_CONTEXT* h264, H264_CONTEXT_OPTION option, UIN
 		case H264_CONTEXT_OPTION_USAGETYPE:
 			h264->UsageType = value;
 			return TRUE;
+		case H264_CONTEXT_OPTION_TEXT_QP_OFFSET:
+			h264->TextQPOffset = value;
+			return TRUE;
+		case H264_CONTEXT_OPTION_VIDEO_QP_OFFSET:
+			h264->VideoQPOffset = value;
+			return TRUE;
 		default:
 			WLog_Print(h264->log, WLOG_WARN, "Unknown H264_CONTEXT_OPTION[0x%08" PRIx32 "]",
 			           option);
@@ -812,6 +835,10 @@ UINT32 h264_context_get_option(H264_CONTEXT* h264, H264_CONTEXT_OPTION option)
 			return h264->QP;
 		case H264_CONTEXT_OPTION_USAGETYPE:
 			return h264->UsageType;
+		case H264_CONTEXT_OPTION_TEXT_QP_OFFSET:
+			return h264->TextQPOffset;
+		case H264_CONTEXT_OPTION_VIDEO_QP_OFFSET:
+			return h264->VideoQPOffset;
 		default:
 			WLog_Print(h264->log, WLOG_WARN, "Unknown H264_CONTEXT_OPTION[0x%08" PRIx32 "]",
 			           option);
@@ -25,6 +25,8 @@
 #include <freerdp/config.h>
 #include <freerdp/codec/h264.h>
 
+#include "yuv_signature.h"
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -63,14 +65,14 @@ extern "C"
 		UINT32 QP;
 		UINT32 UsageType;
 		UINT32 NumberOfThreads;
+		UINT32 TextQPOffset;
+		UINT32 VideoQPOffset;
 
 		UINT32 iStride[3];
-		BYTE* pOldYUVData[3];
 		BYTE* pYUVData[3];
 
 		UINT32 iYUV444Size[3];
 		UINT32 iYUV444Stride[3];
-		BYTE* pOldYUV444Data[3];
 		BYTE* pYUV444Data[3];
 
 		UINT32 numSystemData;
@@ -78,10 +80,16 @@ extern "C"
 		const H264_CONTEXT_SUBSYSTEM* subsystem;
 		YUV_CONTEXT* yuv;
 
-		BOOL encodingBuffer;
 		BOOL firstLumaFrameDone;
 		BOOL firstChromaFrameDone;
 
+		/* change detection of the encoder, reused across frames */
+		YUV_SIGNATURE_MAP lumaSignatures;
+		YUV_SIGNATURE_MAP chromaSignatures;
+		RECTANGLE_16* changeRects;
+		RDPGFX_H264_QUANT_QUALITY* changeQuality;
+		size_t changeCapacity;
+
 		void* lumaData;
 		wLog* log;
 	};
@@ -88,6 +88,45 @@ static INLINE BYTE* WRITEFIRSTLINEFGBGIMAGE(BYTE* WINPR_RESTRICT pbDest,
 	return pbDest;
 }
 
+/**
+ * Write a run of a single pixel value to a destination buffer.
+ */
+static INLINE BYTE* WRITEPIXELRUN(BYTE* WINPR_RESTRICT pbDest, PIXEL pixel, UINT32 runLength)
+{
+	BYTE* start = pbDest;
+
+	if (runLength == 0)
+		return pbDest;
+
+	DESTWRITEPIXEL(pbDest, pixel);
+	bitmap_rle_repeat(start, PIXEL_SIZE, 1ull * runLength * PIXEL_SIZE);
+	return start + 1ull * runLength * PIXEL_SIZE;
+}
+
+/**
+ * Write a run of pixels of the line above XORed with a pixel value to a destination buffer.
+ */
+static INLINE BYTE* WRITEXORRUN(BYTE* WINPR_RESTRICT pbDest, UINT32 rowDelta, PIXEL pixel,
+                                UINT32 runLength)
+{
+	BYTE data[PIXEL_SIZE] = { 0 };
+	BYTE* pdata = data;
+
+	if (rowDelta < XOR_PATTERN_SIZE)
+	{
+		PIXEL temp;
+		UNROLL(runLength, {
+			DESTREADPIXEL(temp, pbDest - rowDelta);
+			DESTWRITEPIXEL(pbDest, temp ^ pixel);
+		});
+		return pbDest;
+	}
+
+	DESTWRITEPIXEL(pdata, pixel);
+	xor_from_above(pbDest, rowDelta, data, PIXEL_SIZE, 1ull * runLength * PIXEL_SIZE);
+	return pbDest + 1ull * runLength * PIXEL_SIZE;
+}
+
 /**
  * Decompress an RLE compressed bitmap.
  */
@@ -175,7 +214,7 @@ static INLINE BOOL RLEDECOMPRESS(const BYTE* WINPR_RESTRICT pbSrcBuffer, UINT32
 				if (!ENSURE_CAPACITY(pbDest, pbDestEnd, runLength))
 					return FALSE;
 
-				UNROLL(runLength, { DESTWRITEPIXEL(pbDest, BLACK_PIXEL); });
+				pbDest = WRITEPIXELRUN(pbDest, BLACK_PIXEL, runLength);
 			}
 			else
 			{
@@ -193,10 +232,8 @@ static INLINE BOOL RLEDECOMPRESS(const BYTE* WINPR_RESTRICT pbSrcBuffer, UINT32
 				if (!ENSURE_CAPACITY(pbDest, pbDestEnd, runLength))
 					return FALSE;
 
-				UNROLL(runLength, {
-					DESTREADPIXEL(temp, pbDest - rowDelta);
-					DESTWRITEPIXEL(pbDest, temp);
-				});
+				copy_from_above(pbDest, rowDelta, 1ull * runLength * PIXEL_SIZE);
+				pbDest += 1ull * runLength * PIXEL_SIZE;
 			}
 
 			/* A follow-on background run order will need a foreground pel inserted. */
@@ -231,16 +268,9 @@ static INLINE BOOL RLEDECOMPRESS(const BYTE* WINPR_RESTRICT pbSrcBuffer, UINT32
 					return FALSE;
 
 				if (fFirstLine)
-				{
-					UNROLL(runLength, { DESTWRITEPIXEL(pbDest, fgPel); });
-				}
+					pbDest = WRITEPIXELRUN(pbDest, fgPel, runLength);
 				else
-				{
-					UNROLL(runLength, {
-						DESTREADPIXEL(temp, pbDest - rowDelta);
-						DESTWRITEPIXEL(pbDest, temp ^ fgPel);
-					});
-				}
+					pbDest = WRITEXORRUN(pbDest, rowDelta, fgPel, runLength);
 
 				break;
 
@@ -261,10 +291,14 @@ static INLINE BOOL RLEDECOMPRESS(const BYTE* WINPR_RESTRICT pbSrcBuffer, UINT32
 				if (!ENSURE_CAPACITY(pbDest, pbDestEnd, runLength * 2))
 					return FALSE;
 
-				UNROLL(runLength, {
+				if (runLength > 0)
+				{
+					BYTE* start = pbDest;
 					DESTWRITEPIXEL(pbDest, pixelA);
 					DESTWRITEPIXEL(pbDest, pixelB);
-				});
+					bitmap_rle_repeat(start, 2 * PIXEL_SIZE, 2ull * runLength * PIXEL_SIZE);
+					pbDest = start + 2ull * runLength * PIXEL_SIZE;
+				}
 				break;
 
 			/* Handle Color Run Orders. */
@@ -281,7 +315,7 @@ static INLINE BOOL RLEDECOMPRESS(const BYTE* WINPR_RESTRICT pbSrcBuffer, UINT32
 				if (!ENSURE_CAPACITY(pbDest, pbDestEnd, runLength))
 					return FALSE;
 
-				UNROLL(runLength, { DESTWRITEPIXEL(pbDest, pixelA); });
+				pbDest = WRITEPIXELRUN(pbDest, pixelA, runLength);
 				break;
 
 			/* Handle Foreground/Background Image Orders. */
@@ -367,10 +401,9 @@ static INLINE BOOL RLEDECOMPRESS(const BYTE* WINPR_RESTRICT pbSrcBuffer, UINT32
 				if (!ENSURE_CAPACITY(pbSrc, pbEnd, runLength))
 					return FALSE;
 
-				UNROLL(runLength, {
-					SRCREADPIXEL(temp, pbSrc);
-					DESTWRITEPIXEL(pbDest, temp);
-				});
+				memcpy(pbDest, pbSrc, 1ull * runLength * PIXEL_SIZE);
+				pbDest += 1ull * runLength * PIXEL_SIZE;
+				pbSrc += 1ull * runLength * PIXEL_SIZE;
 				break;
 
 			/* Handle Special Order 1. */
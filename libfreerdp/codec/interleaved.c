@@ -27,6 +27,8 @@
 #include <freerdp/codec/interleaved.h>
 #include <freerdp/log.h>
 
+#include "bitmap_rle.h"
+
 #define TAG FREERDP_TAG("codec")
 
 #define UNROLL_BODY(_exp, _count)             \
@@ -390,6 +392,42 @@ static INLINE BOOL ensure_capacity_(const BYTE* start, const BYTE* end, size_t s
 	return res;
 }
 
+/* Copy a run from the line above, a run may continue over several lines */
+static INLINE void copy_from_above(BYTE* pbDest, size_t rowDelta, size_t size)
+{
+	while (size > 0)
+	{
+		const size_t chunk = MIN(size, rowDelta);
+		memcpy(pbDest, pbDest - rowDelta, chunk);
+		pbDest += chunk;
+		size -= chunk;
+	}
+}
+
+/* XOR a run from the line above with a pixel value, in blocks the compiler can vectorize.
+ * Blocks must not read pixels they write, so rowDelta must be at least XOR_PATTERN_SIZE */
+#define XOR_PATTERN_SIZE 48 /* a multiple of 16 and of every pixel size */
+static INLINE void xor_from_above(BYTE* pbDest, size_t rowDelta, const BYTE* pixel,
+                                  size_t pixelSize, size_t size)
+{
+	BYTE pattern[XOR_PATTERN_SIZE] = { 0 };
+
+	WINPR_ASSERT(rowDelta >= XOR_PATTERN_SIZE);
+
+	for (size_t x = 0; x < XOR_PATTERN_SIZE; x++)
+		pattern[x] = pixel[x % pixelSize];
+
+	for (size_t offset = 0; offset < size; offset += XOR_PATTERN_SIZE)
+	{
+		const size_t length = MIN(XOR_PATTERN_SIZE, size - offset);
+		BYTE* dst = &pbDest[offset];
+		const BYTE* src = dst - rowDelta;
+
+		for (size_t x = 0; x < length; x++)
+			dst[x] = src[x] ^ pattern[x];
+	}
+}
+
 static INLINE void write_pixel_8(BYTE* _buf, BYTE _pix)
 {
 	WINPR_ASSERT(_buf);
@@ -416,6 +454,8 @@ static INLINE void write_pixel_16(BYTE* _buf, UINT16 _pix)
 #undef SRCREADPIXEL
 #undef WRITEFGBGIMAGE
 #undef WRITEFIRSTLINEFGBGIMAGE
+#undef WRITEPIXELRUN
+#undef WRITEXORRUN
 #undef RLEDECOMPRESS
 #undef RLEEXTRA
 #undef WHITE_PIXEL
@@ -440,6 +480,8 @@ static INLINE void write_pixel_16(BYTE* _buf, UINT16 _pix)
 
 #define WRITEFGBGIMAGE WriteFgBgImage8to8
 #define WRITEFIRSTLINEFGBGIMAGE WriteFirstLineFgBgImage8to8
+#define WRITEPIXELRUN WritePixelRun8to8
+#define WRITEXORRUN WriteXorRun8to8
 #define RLEDECOMPRESS RleDecompress8to8
 #define RLEEXTRA
 #undef ENSURE_CAPACITY
@@ -451,6 +493,8 @@ static INLINE void write_pixel_16(BYTE* _buf, UINT16 _pix)
 #undef SRCREADPIXEL
 #undef WRITEFGBGIMAGE
 #undef WRITEFIRSTLINEFGBGIMAGE
+#undef WRITEPIXELRUN
+#undef WRITEXORRUN
 #undef RLEDECOMPRESS
 #undef RLEEXTRA
 #undef WHITE_PIXEL
@@ -474,6 +518,8 @@ static INLINE void write_pixel_16(BYTE* _buf, UINT16 _pix)
 	} while (0)
 #define WRITEFGBGIMAGE WriteFgBgImage16to16
 #define WRITEFIRSTLINEFGBGIMAGE WriteFirstLineFgBgImage16to16
+#define WRITEPIXELRUN WritePixelRun16to16
+#define WRITEXORRUN WriteXorRun16to16
 #define RLEDECOMPRESS RleDecompress16to16
 #define RLEEXTRA
 #undef ENSURE_CAPACITY
@@ -485,6 +531,8 @@ static INLINE void write_pixel_16(BYTE* _buf, UINT16 _pix)
 #undef SRCREADPIXEL
 #undef WRITEFGBGIMAGE
 #undef WRITEFIRSTLINEFGBGIMAGE
+#undef WRITEPIXELRUN
+#undef WRITEXORRUN
 #undef RLEDECOMPRESS
 #undef RLEEXTRA
 #undef WHITE_PIXEL
@@ -509,6 +557,8 @@ static INLINE void write_pixel_16(BYTE* _buf, UINT16 _pix)
 
 #define WRITEFGBGIMAGE WriteFgBgImage24to24
 #define WRITEFIRSTLINEFGBGIMAGE WriteFirstLineFgBgImage24to24
+#define WRITEPIXELRUN WritePixelRun24to24
+#define WRITEXORRUN WriteXorRun24to24
 #define RLEDECOMPRESS RleDecompress24to24
 #define RLEEXTRA
 #undef ENSURE_CAPACITY
@@ -0,0 +1,57 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Digital Sound Processing - NEON Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/sysinfo.h>
+
+#include "dsp_neon.h"
+
+#if defined(WITH_NEON)
+#include <arm_neon.h>
+
+static INT32 dsp_resample_dot_neon(const INT16* WINPR_RESTRICT coeffs,
+                                   const INT16* WINPR_RESTRICT samples, size_t count)
+{
+	int32x4_t acc0 = vdupq_n_s32(0);
+	int32x4_t acc1 = vdupq_n_s32(0);
+
+	for (size_t x = 0; x < count; x += 8)
+	{
+		const int16x8_t c = vld1q_s16(&coeffs[x]);
+		const int16x8_t s = vld1q_s16(&samples[x]);
+		acc0 = vmlal_s16(acc0, vget_low_s16(c), vget_low_s16(s));
+		acc1 = vmlal_s16(acc1, vget_high_s16(c), vget_high_s16(s));
+	}
+
+	const int32x4_t acc = vaddq_s32(acc0, acc1);
+	const int32x2_t sum = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+	return vget_lane_s32(vpadd_s32(sum, sum), 0);
+}
+#endif
+
+void dsp_resample_init_neon(DSP_RESAMPLE_KERNELS* kernels)
+{
+#if defined(WITH_NEON)
+	if (!IsProcessorFeaturePresent(PF_ARM_NEON_INSTRUCTIONS_AVAILABLE))
+		return;
+
+	kernels->dot = dsp_resample_dot_neon;
+#else
+	WINPR_UNUSED(kernels);
+#endif
+}
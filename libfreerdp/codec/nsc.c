@@ -360,6 +360,8 @@ NSC_CONTEXT* nsc_context_new(void)
 	context->BitmapData = NULL;
 	context->decode = nsc_decode;
 	context->encode = nsc_encode;
+	context->rle_run = nsc_rle_run;
+	context->rle_raw = nsc_rle_raw;
 
 	PROFILER_CREATE(context->priv->prof_nsc_rle_decompress_data, "nsc_rle_decompress_data")
 	PROFILER_CREATE(context->priv->prof_nsc_decode, "nsc_decode")
@@ -33,30 +33,6 @@
 #include "nsc_types.h"
 #include "nsc_encode.h"
 
-typedef struct
-{
-	UINT32 x;
-	UINT32 y;
-	UINT32 width;
-	UINT32 height;
-	const BYTE* data;
-	UINT32 scanline;
-	BYTE* PlaneBuffer;
-	UINT32 MaxPlaneSize;
-	BYTE* PlaneBuffers[5];
-	UINT32 OrgByteCount[4];
-
-	UINT32 LumaPlaneByteCount;
-	UINT32 OrangeChromaPlaneByteCount;
-	UINT32 GreenChromaPlaneByteCount;
-	UINT32 AlphaPlaneByteCount;
-	UINT8 ColorLossLevel;
-	UINT8 ChromaSubsamplingLevel;
-} NSC_MESSAGE;
-
-static BOOL nsc_write_message(NSC_CONTEXT* WINPR_RESTRICT context, wStream* WINPR_RESTRICT s,
-                              const NSC_MESSAGE* WINPR_RESTRICT message);
-
 static BOOL nsc_context_initialize_encode(NSC_CONTEXT* WINPR_RESTRICT context)
 {
 	UINT32 length = 0;
@@ -249,11 +225,13 @@ static BOOL nsc_encode_argb_to_aycocg(NSC_CONTEXT* WINPR_RESTRICT context,
 			*aplane++ = a_val;
 		}
 
-		if (context->ChromaSubsamplingLevel && (x % 2) == 1)
+		/* Repeat the last pixel up to the padded width, the subsampling reads pairs of it */
+		if (context->ChromaSubsamplingLevel && (x > 0))
 		{
-			*yplane = *(yplane - 1);
-			*coplane = *(coplane - 1);
-			*cgplane = *(cgplane - 1);
+			const size_t pad = tempWidth - x;
+			memset(yplane, *(yplane - 1), pad);
+			memset(coplane, *(coplane - 1), pad);
+			memset(cgplane, *(cgplane - 1), pad);
 		}
 	}
 
@@ -332,88 +310,85 @@ BOOL nsc_encode(NSC_CONTEXT* WINPR_RESTRICT context, const BYTE* WINPR_RESTRICT
 	return TRUE;
 }
 
-static UINT32 nsc_rle_encode(const BYTE* WINPR_RESTRICT in, BYTE* WINPR_RESTRICT out,
-                             UINT32 originalSize)
+size_t nsc_rle_run(const BYTE* WINPR_RESTRICT data, size_t count, BYTE symbol)
 {
-	UINT32 left = 0;
-	UINT32 runlength = 1;
-	UINT32 planeSize = 0;
-	left = originalSize;
-
-	/**
-	 * We quit the loop if the running compressed size is larger than the original.
-	 * In such cases data will be sent uncompressed.
-	 */
-	while (left > 4 && planeSize < originalSize - 4)
-	{
-		if (left > 5 && *in == *(in + 1))
-		{
-			runlength++;
-		}
-		else if (runlength == 1)
-		{
-			*out++ = *in;
-			planeSize++;
-		}
-		else if (runlength < 256)
-		{
-			*out++ = *in;
-			*out++ = *in;
-			*out++ = runlength - 2;
-			runlength = 1;
-			planeSize += 3;
-		}
-		else
-		{
-			*out++ = *in;
-			*out++ = *in;
-			*out++ = 0xFF;
-			*out++ = (runlength & 0x000000FF);
-			*out++ = (runlength & 0x0000FF00) >> 8;
-			*out++ = (runlength & 0x00FF0000) >> 16;
-			*out++ = (runlength & 0xFF000000) >> 24;
-			runlength = 1;
-			planeSize += 7;
-		}
+	size_t x = 0;
 
-		in++;
-		left--;
-	}
+	while ((x < count) && (data[x] == symbol))
+		x++;
 
-	if (planeSize < originalSize - 4)
-		CopyMemory(out, in, 4);
+	return x;
+}
 
-	planeSize += 4;
-	return planeSize;
+size_t nsc_rle_raw(const BYTE* WINPR_RESTRICT data, size_t count)
+{
+	size_t x = 0;
+
+	while ((x < count) && (data[x] != data[x - 1]))
+		x++;
+
+	return x;
 }
 
-static void nsc_rle_compress_data(NSC_CONTEXT* WINPR_RESTRICT context)
+/**
+ * Returns originalSize if the encoded plane would not be smaller, the plane is then sent
+ * uncompressed. out must have room for originalSize + 4 bytes.
+ */
+static UINT32 nsc_rle_encode(NSC_CONTEXT* WINPR_RESTRICT context, const BYTE* WINPR_RESTRICT in,
+                             BYTE* WINPR_RESTRICT out, UINT32 originalSize)
 {
-	UINT32 planeSize = 0;
-	UINT32 originalSize = 0;
+	size_t planeSize = 0;
+	size_t pos = 0;
 
-	for (UINT16 i = 0; i < 4; i++)
+	if (originalSize <= 4)
+		return originalSize;
+
+	/* The last 4 bytes are always copied raw and never merged into a run */
+	const size_t count = originalSize - 4;
+
+	while (pos < count)
 	{
-		originalSize = context->OrgByteCount[i];
+		size_t length = context->rle_raw(&in[pos + 1], count - pos - 1);
+
+		if (pos + 1 + length == count)
+			length++;
 
-		if (originalSize == 0)
+		if (length > 0)
 		{
-			planeSize = 0;
+			if (planeSize + length >= count)
+				return originalSize;
+
+			CopyMemory(&out[planeSize], &in[pos], length);
+			planeSize += length;
+			pos += length;
+			continue;
 		}
+
+		const BYTE value = in[pos];
+		const size_t runlength = 1 + context->rle_run(&in[pos + 1], count - pos - 1, value);
+
+		out[planeSize++] = value;
+		out[planeSize++] = value;
+
+		if (runlength < 256)
+			out[planeSize++] = (BYTE)(runlength - 2);
 		else
 		{
-			planeSize = nsc_rle_encode(context->priv->PlaneBuffers[i],
-			                           context->priv->PlaneBuffers[4], originalSize);
-
-			if (planeSize < originalSize)
-				CopyMemory(context->priv->PlaneBuffers[i], context->priv->PlaneBuffers[4],
-				           planeSize);
-			else
-				planeSize = originalSize;
+			out[planeSize++] = 0xFF;
+			out[planeSize++] = (runlength & 0x000000FF);
+			out[planeSize++] = (runlength & 0x0000FF00) >> 8;
+			out[planeSize++] = (runlength & 0x00FF0000) >> 16;
+			out[planeSize++] = (runlength & 0xFF000000) >> 24;
 		}
 
-		context->PlaneByteCount[i] = planeSize;
+		if (planeSize >= count)
+			return originalSize;
+
+		pos += runlength;
 	}
+
+	CopyMemory(&out[planeSize], &in[pos], 4);
+	return (UINT32)(planeSize + 4);
 }
 
 static UINT32 nsc_compute_byte_count(NSC_CONTEXT* WINPR_RESTRICT context,
@@ -444,40 +419,48 @@ static UINT32 nsc_compute_byte_count(NSC_CONTEXT* WINPR_RESTRICT context,
 	return maxPlaneSize;
 }
 
-BOOL nsc_write_message(NSC_CONTEXT* WINPR_RESTRICT context, wStream* WINPR_RESTRICT s,
-                       const NSC_MESSAGE* WINPR_RESTRICT message)
+/* The planes are RLE encoded straight into the stream, the byte counts are written last */
+static BOOL nsc_write_message(NSC_CONTEXT* WINPR_RESTRICT context, wStream* WINPR_RESTRICT s)
 {
-	UINT32 totalPlaneByteCount = 0;
-	totalPlaneByteCount = message->LumaPlaneByteCount + message->OrangeChromaPlaneByteCount +
-	                      message->GreenChromaPlaneByteCount + message->AlphaPlaneByteCount;
-
-	if (!Stream_EnsureRemainingCapacity(s, 20 + totalPlaneByteCount))
+	if (!Stream_EnsureRemainingCapacity(s, 20))
 		return FALSE;
 
-	Stream_Write_UINT32(s, message->LumaPlaneByteCount); /* LumaPlaneByteCount (4 bytes) */
-	Stream_Write_UINT32(
-	    s, message->OrangeChromaPlaneByteCount); /* OrangeChromaPlaneByteCount (4 bytes) */
-	Stream_Write_UINT32(
-	    s, message->GreenChromaPlaneByteCount);           /* GreenChromaPlaneByteCount (4 bytes) */
-	Stream_Write_UINT32(s, message->AlphaPlaneByteCount); /* AlphaPlaneByteCount (4 bytes) */
-	Stream_Write_UINT8(s, message->ColorLossLevel);       /* ColorLossLevel (1 byte) */
-	Stream_Write_UINT8(s, message->ChromaSubsamplingLevel); /* ChromaSubsamplingLevel (1 byte) */
-	Stream_Write_UINT16(s, 0);                              /* Reserved (2 bytes) */
+	const size_t start = Stream_GetPosition(s);
+	Stream_Seek(s, 16); /* Plane byte counts (16 bytes) */
+	Stream_Write_UINT8(s, (BYTE)context->ColorLossLevel); /* ColorLossLevel (1 byte) */
+	Stream_Write_UINT8(s,
+	                   (BYTE)context->ChromaSubsamplingLevel); /* ChromaSubsamplingLevel (1 byte) */
+	Stream_Write_UINT16(s, 0);                                 /* Reserved (2 bytes) */
 
-	if (message->LumaPlaneByteCount)
-		Stream_Write(s, message->PlaneBuffers[0], message->LumaPlaneByteCount); /* LumaPlane */
+	for (size_t i = 0; i < 4; i++)
+	{
+		const UINT32 originalSize = context->OrgByteCount[i];
+		const BYTE* plane = context->priv->PlaneBuffers[i];
 
-	if (message->OrangeChromaPlaneByteCount)
-		Stream_Write(s, message->PlaneBuffers[1],
-		             message->OrangeChromaPlaneByteCount); /* OrangeChromaPlane */
+		if (!Stream_EnsureRemainingCapacity(s, 4ull + originalSize))
+			return FALSE;
 
-	if (message->GreenChromaPlaneByteCount)
-		Stream_Write(s, message->PlaneBuffers[2],
-		             message->GreenChromaPlaneByteCount); /* GreenChromaPlane */
+		UINT32 planeSize = nsc_rle_encode(context, plane, Stream_Pointer(s), originalSize);
 
-	if (message->AlphaPlaneByteCount)
-		Stream_Write(s, message->PlaneBuffers[3], message->AlphaPlaneByteCount); /* AlphaPlane */
+		if (planeSize < originalSize)
+			Stream_Seek(s, planeSize);
+		else
+		{
+			planeSize = originalSize;
+			Stream_Write(s, plane, planeSize);
+		}
+
+		context->PlaneByteCount[i] = planeSize;
+	}
 
+	const size_t end = Stream_GetPosition(s);
+	Stream_SetPosition(s, start);
+	Stream_Write_UINT32(s, context->PlaneByteCount[0]); /* LumaPlaneByteCount (4 bytes) */
+	Stream_Write_UINT32(s,
+	                    context->PlaneByteCount[1]); /* OrangeChromaPlaneByteCount (4 bytes) */
+	Stream_Write_UINT32(s, context->PlaneByteCount[2]); /* GreenChromaPlaneByteCount (4 bytes) */
+	Stream_Write_UINT32(s, context->PlaneByteCount[3]); /* AlphaPlaneByteCount (4 bytes) */
+	Stream_SetPosition(s, end);
 	return TRUE;
 }
 
@@ -486,7 +469,6 @@ BOOL nsc_compose_message(NSC_CONTEXT* WINPR_RESTRICT context, wStream* WINPR_RES
                          UINT32 scanline)
 {
 	BOOL rc = 0;
-	NSC_MESSAGE message = { 0 };
 
 	if (!context || !s || !data)
 		return FALSE;
@@ -506,19 +488,9 @@ BOOL nsc_compose_message(NSC_CONTEXT* WINPR_RESTRICT context, wStream* WINPR_RES
 
 	/* RLE encode */
 	PROFILER_ENTER(context->priv->prof_nsc_rle_compress_data)
-	nsc_rle_compress_data(context);
+	rc = nsc_write_message(context, s);
 	PROFILER_EXIT(context->priv->prof_nsc_rle_compress_data)
-	message.PlaneBuffers[0] = context->priv->PlaneBuffers[0];
-	message.PlaneBuffers[1] = context->priv->PlaneBuffers[1];
-	message.PlaneBuffers[2] = context->priv->PlaneBuffers[2];
-	message.PlaneBuffers[3] = context->priv->PlaneBuffers[3];
-	message.LumaPlaneByteCount = context->PlaneByteCount[0];
-	message.OrangeChromaPlaneByteCount = context->PlaneByteCount[1];
-	message.GreenChromaPlaneByteCount = context->PlaneByteCount[2];
-	message.AlphaPlaneByteCount = context->PlaneByteCount[3];
-	message.ColorLossLevel = context->ColorLossLevel;
-	message.ChromaSubsamplingLevel = context->ChromaSubsamplingLevel;
-	return nsc_write_message(context, s, &message);
+	return rc;
 }
 
 BOOL nsc_decompose_message(NSC_CONTEXT* WINPR_RESTRICT context, wStream* WINPR_RESTRICT s,
@@ -27,4 +27,9 @@
 FREERDP_LOCAL BOOL nsc_encode(NSC_CONTEXT* WINPR_RESTRICT context,
                               const BYTE* WINPR_RESTRICT bmpdata, UINT32 rowstride);
 
+FREERDP_LOCAL size_t nsc_rle_run(const BYTE* WINPR_RESTRICT data, size_t count, BYTE symbol);
+
+/* data[-1] must be readable */
+FREERDP_LOCAL size_t nsc_rle_raw(const BYTE* WINPR_RESTRICT data, size_t count);
+
 #endif /* FREERDP_LIB_CODEC_NSC_ENCODE_H */
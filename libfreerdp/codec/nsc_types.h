@@ -69,6 +69,10 @@ struct S_NSC_CONTEXT
 	BOOL (*decode)(NSC_CONTEXT* context);
 	BOOL (*encode)(NSC_CONTEXT* context, const BYTE* BitmapData, UINT32 rowstride);
 
+	/* RLE scanners: leading bytes equal to symbol, leading bytes differing from the one before */
+	size_t (*rle_run)(const BYTE* WINPR_RESTRICT data, size_t count, BYTE symbol);
+	size_t (*rle_raw)(const BYTE* WINPR_RESTRICT data, size_t count);
+
 	NSC_CONTEXT_PRIV* priv;
 };
 
@@ -25,14 +25,24 @@
 #include <winpr/wtypes.h>
 #include <winpr/assert.h>
 #include <winpr/print.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+#include <winpr/pool.h>
 
 #include <freerdp/primitives.h>
 #include <freerdp/log.h>
+#include <freerdp/settings.h>
 #include <freerdp/codec/bitmap.h>
 #include <freerdp/codec/planar.h>
 
+#include "planar_kernels.h"
+#include "sse/planar_sse2.h"
+
 #define TAG FREERDP_TAG("codec")
 
+/* smallest plane size in pixels for which the planes are encoded on the thread pool */
+#define PLANAR_THREAD_MIN_PLANE_SIZE (128 * 128)
+
 #define PLANAR_ALIGN(val, align) \
 	((val) % (align) == 0) ? (val) : ((val) + (align) - (val) % (align))
 
@@ -66,6 +76,16 @@ typedef struct
 	BYTE formatHeader;
 } RDP6_BITMAP_STREAM;
 
+typedef struct
+{
+	BITMAP_PLANAR_CONTEXT* context;
+	UINT32 plane;
+	UINT32 width;
+	UINT32 height;
+	UINT32 size;
+	BOOL success;
+} PLANAR_PLANE_WORK_PARAM;
+
 struct S_BITMAP_PLANAR_CONTEXT
 {
 	UINT32 maxWidth;
@@ -93,8 +113,167 @@ struct S_BITMAP_PLANAR_CONTEXT
 
 	BOOL bgr;
 	BOOL topdown;
+
+	BOOL useThreads;
+	PLANAR_PLANE_WORK_PARAM workParams[4];
 };
 
+static PLANAR_KERNELS planar_kernels = { 0 };
+static INIT_ONCE planar_kernels_init_once = INIT_ONCE_STATIC_INIT;
+
+static void planar_split32_generic(const BYTE* WINPR_RESTRICT src, size_t count,
+                                   const BYTE pos[4], BYTE* WINPR_RESTRICT a,
+                                   BYTE* WINPR_RESTRICT r, BYTE* WINPR_RESTRICT g,
+                                   BYTE* WINPR_RESTRICT b)
+{
+	for (size_t x = 0; x < count; x++)
+	{
+		const BYTE* pixel = &src[4 * x];
+		a[x] = (pos[0] == PLANAR_CHANNEL_NONE) ? 0xFF : pixel[pos[0]];
+		r[x] = pixel[pos[1]];
+		g[x] = pixel[pos[2]];
+		b[x] = pixel[pos[3]];
+	}
+}
+
+static void planar_merge32_generic(const BYTE* WINPR_RESTRICT a, const BYTE* WINPR_RESTRICT r,
+                                   const BYTE* WINPR_RESTRICT g, const BYTE* WINPR_RESTRICT b,
+                                   BYTE alpha, size_t count, const BYTE pos[4],
+                                   BYTE* WINPR_RESTRICT dst)
+{
+	for (size_t x = 0; x < count; x++)
+	{
+		BYTE* pixel = &dst[4 * x];
+		pixel[pos[0]] = a ? a[x] : alpha;
+		pixel[pos[1]] = r[x];
+		pixel[pos[2]] = g[x];
+		pixel[pos[3]] = b[x];
+	}
+}
+
+static void planar_delta_generic(const BYTE* WINPR_RESTRICT cur, const BYTE* WINPR_RESTRICT prev,
+                                 BYTE* WINPR_RESTRICT out, size_t count)
+{
+	for (size_t x = 0; x < count; x++)
+	{
+		const INT8 d = (INT8)(cur[x] - prev[x]);
+		out[x] = (BYTE)((d < 0) ? ~(2 * d) : (2 * d));
+	}
+}
+
+static void planar_undelta_generic(const BYTE* cur, const BYTE* WINPR_RESTRICT prev, BYTE* out,
+                                   size_t count)
+{
+	for (size_t x = 0; x < count; x++)
+	{
+		const BYTE c = cur[x];
+		const BYTE d = (c & 1) ? (BYTE)~(c >> 1) : (BYTE)(c >> 1);
+		out[x] = (BYTE)(prev[x] + d);
+	}
+}
+
+static size_t planar_run_generic(const BYTE* WINPR_RESTRICT data, size_t count, BYTE symbol)
+{
+	size_t x = 0;
+
+	while ((x < count) && (data[x] == symbol))
+		x++;
+
+	return x;
+}
+
+static size_t planar_raw_generic(const BYTE* WINPR_RESTRICT data, size_t count)
+{
+	size_t x = 0;
+
+	while ((x < count) && (data[x] != data[x - 1]))
+		x++;
+
+	return x;
+}
+
+void planar_init_generic(PLANAR_KERNELS* kernels)
+{
+	WINPR_ASSERT(kernels);
+
+	kernels->split32 = planar_split32_generic;
+	kernels->merge32 = planar_merge32_generic;
+	kernels->delta = planar_delta_generic;
+	kernels->undelta = planar_undelta_generic;
+	kernels->run = planar_run_generic;
+	kernels->raw = planar_raw_generic;
+}
+
+static BOOL CALLBACK planar_kernels_init(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	WINPR_UNUSED(once);
+	WINPR_UNUSED(param);
+	WINPR_UNUSED(context);
+
+	planar_init_generic(&planar_kernels);
+	planar_init_sse2(&planar_kernels);
+	return TRUE;
+}
+
+/** @brief byte offsets of the A, R, G and B channels of a 32bpp format
+ *
+ *  \b alpha receives the value of the alpha byte written for pixels without an alpha plane.
+ */
+static BOOL planar_format_layout(UINT32 format, BYTE pos[4], BYTE* alpha)
+{
+	BYTE a = 0;
+	BYTE r = 0;
+	BYTE g = 0;
+	BYTE b = 0;
+	BYTE value = 0xFF;
+
+	switch (format)
+	{
+		case PIXEL_FORMAT_ARGB32:
+		case PIXEL_FORMAT_XRGB32:
+			a = 0;
+			r = 1;
+			g = 2;
+			b = 3;
+			break;
+		case PIXEL_FORMAT_ABGR32:
+		case PIXEL_FORMAT_XBGR32:
+			a = 0;
+			b = 1;
+			g = 2;
+			r = 3;
+			break;
+		case PIXEL_FORMAT_RGBA32:
+		case PIXEL_FORMAT_RGBX32:
+			r = 0;
+			g = 1;
+			b = 2;
+			a = 3;
+			break;
+		case PIXEL_FORMAT_BGRA32:
+		case PIXEL_FORMAT_BGRX32:
+			b = 0;
+			g = 1;
+			r = 2;
+			a = 3;
+			break;
+		default:
+			return FALSE;
+	}
+
+	/* FreeRDPGetColor leaves the padding byte of the leading X formats zero */
+	if ((format == PIXEL_FORMAT_XRGB32) || (format == PIXEL_FORMAT_XBGR32))
+		value = 0;
+
+	pos[0] = a;
+	pos[1] = r;
+	pos[2] = g;
+	pos[3] = b;
+	if (alpha)
+		*alpha = value;
+	return TRUE;
+}
+
 static INLINE UINT32 planar_invert_format(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar, BOOL alpha,
                                           UINT32 DstFormat)
 {
@@ -234,29 +413,21 @@ static INLINE INT32 planar_decompress_plane_rle_only(const BYTE* WINPR_RESTRICT
                                                      UINT32 SrcSize, BYTE* WINPR_RESTRICT pDstData,
                                                      UINT32 nWidth, UINT32 nHeight)
 {
-	UINT32 pixel = 0;
-	UINT32 cRawBytes = 0;
-	UINT32 nRunLength = 0;
-	INT32 deltaValue = 0;
-	BYTE controlByte = 0;
-	BYTE* currentScanline = NULL;
-	BYTE* previousScanline = NULL;
 	const BYTE* srcp = pSrcData;
+	const BYTE* previousScanline = NULL;
 
 	WINPR_ASSERT(nHeight <= INT32_MAX);
 	WINPR_ASSERT(nWidth <= INT32_MAX);
 
-	previousScanline = NULL;
-
-	for (INT32 y = 0; y < (INT32)nHeight; y++)
+	for (UINT32 y = 0; y < nHeight; y++)
 	{
-		BYTE* dstp = &pDstData[((y) * (INT32)nWidth)];
-		pixel = 0;
-		currentScanline = dstp;
+		BYTE* currentScanline = &pDstData[1ull * y * nWidth];
+		BYTE symbol = 0;
 
-		for (INT32 x = 0; x < (INT32)nWidth;)
+		/* expand the encoded bytes of the scanline, runs repeat the last raw byte */
+		for (UINT32 x = 0; x < nWidth;)
 		{
-			controlByte = *srcp;
+			const BYTE controlByte = *srcp;
 			srcp++;
 
 			if ((srcp - pSrcData) > SrcSize * 1ll)
@@ -265,8 +436,8 @@ static INLINE INT32 planar_decompress_plane_rle_only(const BYTE* WINPR_RESTRICT
 				return -1;
 			}
 
-			nRunLength = PLANAR_CONTROL_BYTE_RUN_LENGTH(controlByte);
-			cRawBytes = PLANAR_CONTROL_BYTE_RAW_BYTES(controlByte);
+			UINT32 nRunLength = PLANAR_CONTROL_BYTE_RUN_LENGTH(controlByte);
+			UINT32 cRawBytes = PLANAR_CONTROL_BYTE_RAW_BYTES(controlByte);
 
 			if (nRunLength == 1)
 			{
@@ -279,71 +450,28 @@ static INLINE INT32 planar_decompress_plane_rle_only(const BYTE* WINPR_RESTRICT
 				cRawBytes = 0;
 			}
 
-			if (((dstp + (cRawBytes + nRunLength)) - currentScanline) > nWidth * 1ll)
+			if ((x + cRawBytes + nRunLength) > nWidth)
 			{
 				WLog_ERR(TAG, "too many pixels in scanline");
 				return -1;
 			}
 
-			if (!previousScanline)
+			if (cRawBytes > 0)
 			{
-				/* first scanline, absolute values */
-				while (cRawBytes > 0)
-				{
-					pixel = *srcp;
-					srcp++;
-					*dstp = pixel;
-					dstp++;
-					x++;
-					cRawBytes--;
-				}
-
-				while (nRunLength > 0)
-				{
-					*dstp = pixel;
-					dstp++;
-					x++;
-					nRunLength--;
-				}
+				CopyMemory(&currentScanline[x], srcp, cRawBytes);
+				symbol = srcp[cRawBytes - 1];
+				srcp += cRawBytes;
+				x += cRawBytes;
 			}
-			else
-			{
-				/* delta values relative to previous scanline */
-				while (cRawBytes > 0)
-				{
-					deltaValue = *srcp;
-					srcp++;
-
-					if (deltaValue & 1)
-					{
-						deltaValue = deltaValue >> 1;
-						deltaValue = deltaValue + 1;
-						pixel = -deltaValue;
-					}
-					else
-					{
-						deltaValue = deltaValue >> 1;
-						pixel = deltaValue;
-					}
 
-					deltaValue = previousScanline[x] + pixel;
-					*dstp = deltaValue;
-					dstp++;
-					x++;
-					cRawBytes--;
-				}
-
-				while (nRunLength > 0)
-				{
-					deltaValue = previousScanline[x] + pixel;
-					*dstp = deltaValue;
-					dstp++;
-					x++;
-					nRunLength--;
-				}
-			}
+			FillMemory(&currentScanline[x], nRunLength, symbol);
+			x += nRunLength;
 		}
 
+		/* all but the first scanline hold deltas to the previous one */
+		if (previousScanline)
+			planar_kernels.undelta(currentScanline, previousScanline, currentScanline, nWidth);
+
 		previousScanline = currentScanline;
 	}
 
@@ -531,62 +659,54 @@ static INLINE BOOL writeLine(BYTE** WINPR_RESTRICT ppRgba, UINT32 DstFormat, UIN
                              const BYTE** WINPR_RESTRICT ppR, const BYTE** WINPR_RESTRICT ppG,
                              const BYTE** WINPR_RESTRICT ppB, const BYTE** WINPR_RESTRICT ppA)
 {
+	BYTE pos[4] = { 0 };
+	BYTE alpha = 0;
+
 	WINPR_ASSERT(ppRgba);
 	WINPR_ASSERT(ppR);
 	WINPR_ASSERT(ppG);
 	WINPR_ASSERT(ppB);
 
-	switch (DstFormat)
+	if (planar_format_layout(DstFormat, pos, &alpha))
 	{
-		case PIXEL_FORMAT_BGRA32:
-			for (UINT32 x = 0; x < width; x++)
-			{
-				*(*ppRgba)++ = *(*ppB)++;
-				*(*ppRgba)++ = *(*ppG)++;
-				*(*ppRgba)++ = *(*ppR)++;
-				*(*ppRgba)++ = *(*ppA)++;
-			}
-
-			return TRUE;
-
-		case PIXEL_FORMAT_BGRX32:
-			for (UINT32 x = 0; x < width; x++)
-			{
-				*(*ppRgba)++ = *(*ppB)++;
-				*(*ppRgba)++ = *(*ppG)++;
-				*(*ppRgba)++ = *(*ppR)++;
-				*(*ppRgba)++ = 0xFF;
-			}
-
-			return TRUE;
-
-		default:
-			if (ppA)
-			{
-				for (UINT32 x = 0; x < width; x++)
-				{
-					BYTE alpha = *(*ppA)++;
-					UINT32 color =
-					    FreeRDPGetColor(DstFormat, *(*ppR)++, *(*ppG)++, *(*ppB)++, alpha);
-					FreeRDPWriteColor(*ppRgba, DstFormat, color);
-					*ppRgba += FreeRDPGetBytesPerPixel(DstFormat);
-				}
-			}
-			else
-			{
-				const BYTE alpha = 0xFF;
-
-				for (UINT32 x = 0; x < width; x++)
-				{
-					UINT32 color =
-					    FreeRDPGetColor(DstFormat, *(*ppR)++, *(*ppG)++, *(*ppB)++, alpha);
-					FreeRDPWriteColor(*ppRgba, DstFormat, color);
-					*ppRgba += FreeRDPGetBytesPerPixel(DstFormat);
-				}
-			}
+		const BYTE* pA = ppA ? *ppA : NULL;
+
+		/* the padding byte of these formats never carries alpha */
+		if ((DstFormat == PIXEL_FORMAT_BGRX32) || (DstFormat == PIXEL_FORMAT_XRGB32) ||
+		    (DstFormat == PIXEL_FORMAT_XBGR32))
+			pA = NULL;
+
+		planar_kernels.merge32(pA, *ppR, *ppG, *ppB, alpha, width, pos, *ppRgba);
+		*ppRgba += 4ull * width;
+		*ppR += width;
+		*ppG += width;
+		*ppB += width;
+		if (pA)
+			*ppA += width;
+		return TRUE;
+	}
 
-			return TRUE;
+	if (ppA && *ppA)
+	{
+		for (UINT32 x = 0; x < width; x++)
+		{
+			const BYTE a = *(*ppA)++;
+			UINT32 color = FreeRDPGetColor(DstFormat, *(*ppR)++, *(*ppG)++, *(*ppB)++, a);
+			FreeRDPWriteColor(*ppRgba, DstFormat, color);
+			*ppRgba += FreeRDPGetBytesPerPixel(DstFormat);
+		}
 	}
+	else
+	{
+		for (UINT32 x = 0; x < width; x++)
+		{
+			UINT32 color = FreeRDPGetColor(DstFormat, *(*ppR)++, *(*ppG)++, *(*ppB)++, 0xFF);
+			FreeRDPWriteColor(*ppRgba, DstFormat, color);
+			*ppRgba += FreeRDPGetBytesPerPixel(DstFormat);
+		}
+	}
+
+	return TRUE;
 }
 
 static INLINE BOOL planar_decompress_planes_raw(const BYTE* WINPR_RESTRICT pSrcData[4],
@@ -655,6 +775,71 @@ static INLINE BOOL planar_decompress_planes_raw(const BYTE* WINPR_RESTRICT pSrcD
 	return TRUE;
 }
 
+static BOOL planar_decompress_planes_rle(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
+                                         const BYTE* WINPR_RESTRICT pSrcData[4],
+                                         const INT32 rleSizes[4], BYTE* WINPR_RESTRICT pDstData,
+                                         UINT32 nDstStep, UINT32 nXDst, UINT32 nYDst,
+                                         UINT32 nWidth, UINT32 nHeight, BOOL vFlip,
+                                         UINT32 totalHeight, BOOL useAlpha)
+{
+	/* same BGRA channel order as the planar_decompress_plane_rle calls */
+	const BYTE pos[4] = { 3, 2, 1, 0 };
+	const size_t planeSize = 1ull * nWidth * nHeight;
+	BYTE* rleBuffer[4] = { 0 };
+
+	WINPR_ASSERT(planar);
+	WINPR_ASSERT(planeSize <= planar->maxPlaneSize);
+
+	if (!planar->rlePlanesBuffer)
+		return FALSE;
+
+	if (nYDst + nHeight > totalHeight)
+	{
+		WLog_ERR(TAG,
+		         "planar plane destination Y %" PRIu32 " + height %" PRIu32
+		         " exceeds totalHeight %" PRIu32,
+		         nYDst, nHeight, totalHeight);
+		return FALSE;
+	}
+
+	if ((nXDst + nWidth) * 4ull > nDstStep)
+	{
+		WLog_ERR(TAG,
+		         "planar plane destination (X %" PRIu32 " + width %" PRIu32
+		         ") * 4 exceeds stride %" PRIu32,
+		         nXDst, nWidth, nDstStep);
+		return FALSE;
+	}
+
+	for (size_t i = 0; i < 4; i++)
+	{
+		rleBuffer[i] = &planar->rlePlanesBuffer[i * planeSize];
+
+		if ((i == 3) && !useAlpha)
+		{
+			rleBuffer[i] = NULL;
+			break;
+		}
+
+		if (planar_decompress_plane_rle_only(pSrcData[i], (UINT32)rleSizes[i], rleBuffer[i],
+		                                     nWidth, nHeight) < 0)
+			return FALSE;
+	}
+
+	for (UINT32 y = 0; y < nHeight; y++)
+	{
+		const UINT32 row = vFlip ? nHeight - y - 1 : y;
+		const size_t offset = 1ull * y * nWidth;
+		BYTE* dst = &pDstData[1ull * (nYDst + row) * nDstStep + 4ull * nXDst];
+
+		planar_kernels.merge32(rleBuffer[3] ? &rleBuffer[3][offset] : NULL,
+		                       &rleBuffer[0][offset], &rleBuffer[1][offset],
+		                       &rleBuffer[2][offset], 0xFF, nWidth, pos, dst);
+	}
+
+	return TRUE;
+}
+
 static BOOL planar_subsample_expand(const BYTE* WINPR_RESTRICT plane, size_t planeLength,
                                     UINT32 nWidth, UINT32 nHeight, UINT32 nPlaneWidth,
                                     UINT32 nPlaneHeight, BYTE* WINPR_RESTRICT deltaPlane)
@@ -941,7 +1126,19 @@ BOOL planar_decompress(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
 			if ((SrcSize - (srcp - pSrcData)) == 1)
 				srcp++; /* pad */
 		}
-		else /* RLE */
+		else if (planeSize <= planar->maxPlaneSize) /* RLE */
+		{
+			if (!planar_decompress_planes_rle(planar, planes, rleSizes, pTempData, nTempStep,
+			                                  nXDst, nYDst, nSrcWidth, nSrcHeight, vFlip,
+			                                  nTotalHeight, useAlpha))
+				return FALSE;
+
+			srcp += rleSizes[0] + rleSizes[1] + rleSizes[2];
+
+			if (alpha)
+				srcp += rleSizes[3];
+		}
+		else /* RLE, larger than the plane buffers */
 		{
 			status =
 			    planar_decompress_plane_rle(planes[0], rleSizes[0], pTempData, nTempStep, nXDst,
@@ -1125,6 +1322,24 @@ static INLINE BOOL freerdp_split_color_planes(BITMAP_PLANAR_CONTEXT* WINPR_RESTR
 	if (scanline == 0)
 		scanline = width * FreeRDPGetBytesPerPixel(format);
 
+	BYTE pos[4] = { 0 };
+	if (planar_format_layout(format, pos, NULL))
+	{
+		if (!FreeRDPColorHasAlpha(format))
+			pos[0] = PLANAR_CHANNEL_NONE;
+
+		for (UINT32 i = 0; i < height; i++)
+		{
+			const UINT32 row = planar->topdown ? i : height - i - 1;
+			const size_t k = 1ull * i * width;
+
+			planar_kernels.split32(&data[1ull * scanline * row], width, pos, &planes[0][k],
+			                       &planes[1][k], &planes[2][k], &planes[3][k]);
+		}
+
+		return TRUE;
+	}
+
 	if (planar->topdown)
 	{
 		UINT32 k = 0;
@@ -1338,6 +1553,20 @@ static INLINE UINT32 freerdp_bitmap_planar_encode_rle_bytes(const BYTE* WINPR_RE
 
 		nRunLength += bSymbolMatch;
 		cRawBytes += (!bSymbolMatch) ? TRUE : FALSE;
+
+		/* the following bytes continue the run or raw sequence without a flush */
+		const size_t count = bSymbolMatch ? planar_kernels.run(pInput, inBufferSize, symbol)
+		                                  : planar_kernels.raw(pInput, inBufferSize);
+
+		if (bSymbolMatch)
+			nRunLength += (UINT32)count;
+		else
+			cRawBytes += (UINT32)count;
+
+		pInput += count;
+		inBufferSize -= (UINT32)count;
+		if (count)
+			symbol = pInput[-1];
 	} while (outBufferSize);
 
 	if (cRawBytes || nRunLength)
@@ -1400,63 +1629,9 @@ BOOL freerdp_bitmap_planar_compress_plane_rle(const BYTE* WINPR_RESTRICT inPlane
 	return TRUE;
 }
 
-static INLINE BOOL freerdp_bitmap_planar_compress_planes_rle(BYTE* WINPR_RESTRICT inPlanes[4],
-                                                             UINT32 width, UINT32 height,
-                                                             BYTE* WINPR_RESTRICT outPlanes,
-                                                             UINT32* WINPR_RESTRICT dstSizes,
-                                                             BOOL skipAlpha)
-{
-	UINT32 outPlanesSize = width * height * 4;
-
-	/* AlphaPlane */
-	if (skipAlpha)
-	{
-		dstSizes[0] = 0;
-	}
-	else
-	{
-		dstSizes[0] = outPlanesSize;
-
-		if (!freerdp_bitmap_planar_compress_plane_rle(inPlanes[0], width, height, outPlanes,
-		                                              &dstSizes[0]))
-			return FALSE;
-
-		outPlanes += dstSizes[0];
-		outPlanesSize -= dstSizes[0];
-	}
-
-	/* LumaOrRedPlane */
-	dstSizes[1] = outPlanesSize;
-
-	if (!freerdp_bitmap_planar_compress_plane_rle(inPlanes[1], width, height, outPlanes,
-	                                              &dstSizes[1]))
-		return FALSE;
-
-	outPlanes += dstSizes[1];
-	outPlanesSize -= dstSizes[1];
-	/* OrangeChromaOrGreenPlane */
-	dstSizes[2] = outPlanesSize;
-
-	if (!freerdp_bitmap_planar_compress_plane_rle(inPlanes[2], width, height, outPlanes,
-	                                              &dstSizes[2]))
-		return FALSE;
-
-	outPlanes += dstSizes[2];
-	outPlanesSize -= dstSizes[2];
-	/* GreenChromeOrBluePlane */
-	dstSizes[3] = outPlanesSize;
-
-	if (!freerdp_bitmap_planar_compress_plane_rle(inPlanes[3], width, height, outPlanes,
-	                                              &dstSizes[3]))
-		return FALSE;
-
-	return TRUE;
-}
-
 BYTE* freerdp_bitmap_planar_delta_encode_plane(const BYTE* WINPR_RESTRICT inPlane, UINT32 width,
                                                UINT32 height, BYTE* WINPR_RESTRICT outPlane)
 {
-	char s2c = 0;
 	BYTE* outPtr = NULL;
 	const BYTE* srcPtr = NULL;
 	const BYTE* prevLinePtr = NULL;
@@ -1478,33 +1653,94 @@ BYTE* freerdp_bitmap_planar_delta_encode_plane(const BYTE* WINPR_RESTRICT inPlan
 
 	for (UINT32 y = 1; y < height; y++)
 	{
-		for (UINT32 x = 0; x < width; x++, outPtr++, srcPtr++, prevLinePtr++)
-		{
-			INT32 delta = *srcPtr - *prevLinePtr;
-			s2c = (delta >= 0) ? (char)delta : (char)(~((BYTE)(-delta)) + 1);
-			s2c = (s2c >= 0) ? (char)((UINT32)s2c << 1)
-			                 : (char)(((UINT32)(~((BYTE)s2c) + 1) << 1) - 1);
-			*outPtr = (BYTE)s2c;
-		}
+		planar_kernels.delta(srcPtr, prevLinePtr, outPtr, width);
+		outPtr += width;
+		srcPtr += width;
+		prevLinePtr += width;
 	}
 
 	return outPlane;
 }
 
-static INLINE BOOL freerdp_bitmap_planar_delta_encode_planes(BYTE* WINPR_RESTRICT inPlanes[4],
-                                                             UINT32 width, UINT32 height,
-                                                             BYTE* WINPR_RESTRICT outPlanes[4])
+static BOOL planar_encode_plane(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT context, UINT32 plane,
+                                UINT32 width, UINT32 height, UINT32* WINPR_RESTRICT dstSize)
 {
-	for (UINT32 i = 0; i < 4; i++)
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(plane < 4);
+
+	context->deltaPlanes[plane] = freerdp_bitmap_planar_delta_encode_plane(
+	    context->planes[plane], width, height, context->deltaPlanes[plane]);
+
+	if (!context->deltaPlanes[plane])
+		return FALSE;
+
+	/* every plane has its own region, a scanline never takes more than two bytes per pixel */
+	*dstSize = width * height * 2;
+	return freerdp_bitmap_planar_compress_plane_rle(context->deltaPlanes[plane], width, height,
+	                                                context->rlePlanes[plane], dstSize);
+}
+
+static void CALLBACK planar_encode_plane_work_callback(PTP_CALLBACK_INSTANCE instance,
+                                                       void* context, PTP_WORK work)
+{
+	PLANAR_PLANE_WORK_PARAM* param = (PLANAR_PLANE_WORK_PARAM*)context;
+	WINPR_UNUSED(instance);
+	WINPR_UNUSED(work);
+	WINPR_ASSERT(param);
+
+	param->success = planar_encode_plane(param->context, param->plane, param->width,
+	                                     param->height, &param->size);
+}
+
+static BOOL freerdp_bitmap_planar_compress_planes_rle(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT context,
+                                                      UINT32 width, UINT32 height,
+                                                      UINT32* WINPR_RESTRICT dstSizes,
+                                                      BOOL skipAlpha)
+{
+	PTP_WORK work[4] = { 0 };
+	BOOL success = TRUE;
+	const UINT32 first = skipAlpha ? 1 : 0;
+	const BOOL useThreads =
+	    context->useThreads && (1ull * width * height >= PLANAR_THREAD_MIN_PLANE_SIZE);
+
+	dstSizes[0] = 0;
+
+	/* the first plane is encoded by the calling thread while the pool works on the others */
+	for (UINT32 i = first; i < 4; i++)
+	{
+		PLANAR_PLANE_WORK_PARAM* param = &context->workParams[i];
+		param->context = context;
+		param->plane = i;
+		param->width = width;
+		param->height = height;
+		param->size = 0;
+		param->success = FALSE;
+
+		if (useThreads && (i > first))
+		{
+			work[i] = CreateThreadpoolWork(planar_encode_plane_work_callback, param, NULL);
+			if (work[i])
+				SubmitThreadpoolWork(work[i]);
+		}
+	}
+
+	for (UINT32 i = first; i < 4; i++)
 	{
-		outPlanes[i] =
-		    freerdp_bitmap_planar_delta_encode_plane(inPlanes[i], width, height, outPlanes[i]);
+		PLANAR_PLANE_WORK_PARAM* param = &context->workParams[i];
 
-		if (!outPlanes[i])
-			return FALSE;
+		if (work[i])
+		{
+			WaitForThreadpoolWorkCallbacks(work[i], FALSE);
+			CloseThreadpoolWork(work[i]);
+		}
+		else
+			planar_encode_plane_work_callback(NULL, param, NULL);
+
+		success &= param->success;
+		dstSizes[i] = param->size;
 	}
 
-	return TRUE;
+	return success;
 }
 
 BYTE* freerdp_bitmap_compress_planar(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT context,
@@ -1526,6 +1762,13 @@ BYTE* freerdp_bitmap_compress_planar(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT conte
 
 	planeSize = width * height;
 
+	if (1ull * width * height > context->maxPlaneSize)
+	{
+		WLog_ERR(TAG, "planar bitmap %" PRIu32 "x%" PRIu32 " exceeds the context size", width,
+		         height);
+		return NULL;
+	}
+
 	if (!context->AllowSkipAlpha)
 		format = planar_invert_format(context, TRUE, format);
 
@@ -1535,25 +1778,20 @@ BYTE* freerdp_bitmap_compress_planar(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT conte
 
 	if (context->AllowRunLengthEncoding)
 	{
-		if (!freerdp_bitmap_planar_delta_encode_planes(context->planes, width, height,
-		                                               context->deltaPlanes))
-			return NULL;
+		for (size_t i = 0; i < 4; i++)
+			context->rlePlanes[i] = &context->rlePlanesBuffer[2ull * context->maxPlaneSize * i];
 
-		if (!freerdp_bitmap_planar_compress_planes_rle(context->deltaPlanes, width, height,
-		                                               context->rlePlanesBuffer, dstSizes,
+		if (!freerdp_bitmap_planar_compress_planes_rle(context, width, height, dstSizes,
 		                                               context->AllowSkipAlpha))
 			return NULL;
 
+		/* a caller supplied buffer is only known to hold the size of the raw planes */
+		const UINT64 rleSize = 1ull * dstSizes[0] + dstSizes[1] + dstSizes[2] + dstSizes[3];
+		if (dstData && (rleSize > 4ull * width * height))
+			return NULL;
+
 		{
-			int offset = 0;
 			FormatHeader |= PLANAR_FORMAT_HEADER_RLE;
-			context->rlePlanes[0] = &context->rlePlanesBuffer[offset];
-			offset += dstSizes[0];
-			context->rlePlanes[1] = &context->rlePlanesBuffer[offset];
-			offset += dstSizes[1];
-			context->rlePlanes[2] = &context->rlePlanesBuffer[offset];
-			offset += dstSizes[2];
-			context->rlePlanes[3] = &context->rlePlanesBuffer[offset];
 
 #if defined(WITH_DEBUG_CODECS)
 			WLog_DBG(TAG,
@@ -1723,7 +1961,7 @@ BOOL freerdp_bitmap_planar_context_reset(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT c
 			return FALSE;
 		context->deltaPlanesBuffer = tmp;
 
-		tmp = winpr_aligned_recalloc(context->rlePlanesBuffer, context->maxPlaneSize, 4, 32);
+		tmp = winpr_aligned_recalloc(context->rlePlanesBuffer, context->maxPlaneSize, 8, 32);
 		if (!tmp)
 			return FALSE;
 		context->rlePlanesBuffer = tmp;
@@ -1742,6 +1980,18 @@ BOOL freerdp_bitmap_planar_context_reset(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT c
 
 BITMAP_PLANAR_CONTEXT* freerdp_bitmap_planar_context_new(DWORD flags, UINT32 maxWidth,
                                                          UINT32 maxHeight)
+{
+	return freerdp_bitmap_planar_context_new_ex(flags, maxWidth, maxHeight, 0);
+}
+
+BITMAP_PLANAR_CONTEXT* freerdp_bitmap_planar_context_new_ex(DWORD flags, UINT32 maxWidth,
+                                                            UINT32 maxHeight, UINT32 ThreadingFlags)
+{
+	return planar_context_new_ex(flags, maxWidth, maxHeight, ThreadingFlags, FALSE);
+}
+
+BITMAP_PLANAR_CONTEXT* planar_context_new_ex(DWORD flags, UINT32 maxWidth, UINT32 maxHeight,
+                                             UINT32 ThreadingFlags, BOOL forceThreads)
 {
 	BITMAP_PLANAR_CONTEXT* context =
 	    (BITMAP_PLANAR_CONTEXT*)winpr_aligned_calloc(1, sizeof(BITMAP_PLANAR_CONTEXT), 32);
@@ -1749,6 +1999,15 @@ BITMAP_PLANAR_CONTEXT* freerdp_bitmap_planar_context_new(DWORD flags, UINT32 max
 	if (!context)
 		return NULL;
 
+	InitOnceExecuteOnce(&planar_kernels_init_once, planar_kernels_init, NULL, NULL);
+
+	if (!(ThreadingFlags & THREADING_FLAGS_DISABLE_THREADS))
+	{
+		SYSTEM_INFO sysInfos = { 0 };
+		GetNativeSystemInfo(&sysInfos);
+		context->useThreads = forceThreads || (sysInfos.dwNumberOfProcessors > 1);
+	}
+
 	if (flags & PLANAR_FORMAT_HEADER_NA)
 		context->AllowSkipAlpha = TRUE;
 
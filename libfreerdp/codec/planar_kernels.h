@@ -0,0 +1,89 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Planar Bitmap Plane Kernels
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CODEC_PLANAR_KERNELS_H
+#define FREERDP_LIB_CODEC_PLANAR_KERNELS_H
+
+#include <winpr/wtypes.h>
+
+#include <freerdp/api.h>
+#include <freerdp/types.h>
+#include <freerdp/codec/planar.h>
+
+/** @brief alpha offset of a pixel format that does not store alpha */
+#define PLANAR_CHANNEL_NONE 0xFF
+
+/** @brief split \b count 32bpp pixels into the A, R, G and B planes
+ *
+ *  \b pos holds the byte offsets of the A, R, G and B channels. An alpha offset of
+ *  \b PLANAR_CHANNEL_NONE fills the alpha plane with 0xFF.
+ */
+typedef void (*pPlanarSplit32)(const BYTE* WINPR_RESTRICT src, size_t count, const BYTE pos[4],
+                               BYTE* WINPR_RESTRICT a, BYTE* WINPR_RESTRICT r,
+                               BYTE* WINPR_RESTRICT g, BYTE* WINPR_RESTRICT b);
+
+/** @brief merge \b count bytes of the A, R, G and B planes into 32bpp pixels
+ *
+ *  \b pos holds the byte offsets of the A, R, G and B channels. If \b a is NULL the byte at
+ *  the alpha offset is set to \b alpha.
+ */
+typedef void (*pPlanarMerge32)(const BYTE* WINPR_RESTRICT a, const BYTE* WINPR_RESTRICT r,
+                               const BYTE* WINPR_RESTRICT g, const BYTE* WINPR_RESTRICT b,
+                               BYTE alpha, size_t count, const BYTE pos[4],
+                               BYTE* WINPR_RESTRICT dst);
+
+/** @brief encode the difference of \b cur to \b prev as planar delta bytes
+ *
+ *  A delta d of the wrapped byte difference is stored as 2d if d >= 0, else as -2d - 1.
+ */
+typedef void (*pPlanarDelta)(const BYTE* WINPR_RESTRICT cur, const BYTE* WINPR_RESTRICT prev,
+                             BYTE* WINPR_RESTRICT out, size_t count);
+
+/** @brief inverse of \b pPlanarDelta, \b out may be the same buffer as \b cur */
+typedef void (*pPlanarUndelta)(const BYTE* cur, const BYTE* WINPR_RESTRICT prev, BYTE* out,
+                               size_t count);
+
+/** @brief number of leading bytes of \b data equal to \b symbol */
+typedef size_t (*pPlanarRun)(const BYTE* WINPR_RESTRICT data, size_t count, BYTE symbol);
+
+/** @brief number of leading bytes of \b data that differ from the byte before them
+ *
+ *  The byte at data[-1] must be readable.
+ */
+typedef size_t (*pPlanarRaw)(const BYTE* WINPR_RESTRICT data, size_t count);
+
+typedef struct
+{
+	pPlanarSplit32 split32;
+	pPlanarMerge32 merge32;
+	pPlanarDelta delta;
+	pPlanarUndelta undelta;
+	pPlanarRun run;
+	pPlanarRaw raw;
+} PLANAR_KERNELS;
+
+/** @brief fill \b kernels with the portable C implementations */
+FREERDP_LOCAL void planar_init_generic(PLANAR_KERNELS* kernels);
+
+/** @brief create a planar context, \b forceThreads encodes the planes in parallel even on a
+ *  single CPU (unless disabled by \b ThreadingFlags)
+ */
+FREERDP_LOCAL BITMAP_PLANAR_CONTEXT* planar_context_new_ex(DWORD flags, UINT32 maxWidth,
+                                                           UINT32 maxHeight, UINT32 ThreadingFlags,
+                                                           BOOL forceThreads);
+
+#endif /* FREERDP_LIB_CODEC_PLANAR_KERNELS_H */
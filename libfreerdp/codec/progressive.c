@@ -39,6 +39,7 @@
 #include "rfx_constants.h"
 #include "rfx_types.h"
 #include "progressive.h"
+#include "progressive_encode.h"
 
 #define TAG FREERDP_TAG("codec.progressive")
 
@@ -2314,19 +2315,34 @@ static INLINE BOOL update_tiles(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
                                 REGION16* WINPR_RESTRICT invalidRegion)
 {
 	BOOL rc = TRUE;
+	UINT32 numTileRects = 0;
 	REGION16 clippingRects = { 0 };
+	REGION16 updatedRegion = { 0 };
 	region16_init(&clippingRects);
+	region16_init(&updatedRegion);
+
+	RECTANGLE_16* clipRects = calloc(region->numRects + 1ull, sizeof(RECTANGLE_16));
+	RECTANGLE_16* tileRects = calloc(surface->numUpdatedTiles + 1ull, sizeof(RECTANGLE_16));
+	if (!clipRects || !tileRects)
+	{
+		rc = FALSE;
+		goto fail;
+	}
 
 	for (UINT32 i = 0; i < region->numRects; i++)
 	{
-		RECTANGLE_16 clippingRect = { 0 };
 		const RFX_RECT* rect = &(region->rects[i]);
 
-		clippingRect.left = (UINT16)nXDst + rect->x;
-		clippingRect.top = (UINT16)nYDst + rect->y;
-		clippingRect.right = clippingRect.left + rect->width;
-		clippingRect.bottom = clippingRect.top + rect->height;
-		region16_union_rect(&clippingRects, &clippingRects, &clippingRect);
+		clipRects[i].left = (UINT16)nXDst + rect->x;
+		clipRects[i].top = (UINT16)nYDst + rect->y;
+		clipRects[i].right = clipRects[i].left + rect->width;
+		clipRects[i].bottom = clipRects[i].top + rect->height;
+	}
+
+	if (!region16_union_rects(&clippingRects, &clippingRects, clipRects, region->numRects))
+	{
+		rc = FALSE;
+		goto fail;
 	}
 
 	for (UINT32 i = 0; i < surface->numUpdatedTiles; i++)
@@ -2355,33 +2371,54 @@ static INLINE BOOL update_tiles(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
 		for (UINT32 j = 0; j < nbUpdateRects; j++)
 		{
 			const RECTANGLE_16* rect = &updateRects[j];
-			if (rect->left < updateRect.left)
-				goto fail;
-			const UINT32 nXSrc = rect->left - updateRect.left;
-			const UINT32 nYSrc = rect->top - updateRect.top;
 			const UINT32 width = rect->right - rect->left;
 			const UINT32 height = rect->bottom - rect->top;
 
-			if (rect->left + width > surface->width)
-				goto fail;
-			if (rect->top + height > surface->height)
-				goto fail;
+			if ((rect->left < updateRect.left) || (rect->left + width > surface->width) ||
+			    (rect->top + height > surface->height))
+			{
+				rc = FALSE;
+				break;
+			}
+
+			const UINT32 nXSrc = rect->left - updateRect.left;
+			const UINT32 nYSrc = rect->top - updateRect.top;
 			rc = freerdp_image_copy_no_overlap(
 			    pDstData, DstFormat, nDstStep, rect->left, rect->top, width, height, tile->data,
 			    progressive->format, tile->stride, nXSrc, nYSrc, NULL, FREERDP_KEEP_DST_ALPHA);
 			if (!rc)
 				break;
-
-			if (invalidRegion)
-				region16_union_rect(invalidRegion, invalidRegion, rect);
 		}
 
 		region16_uninit(&updateRegion);
+		if (!rc)
+			break;
+
+		/* only tiles drawn completely are reported as invalid */
+		tileRects[numTileRects++] = updateRect;
 		tile->dirty = FALSE;
 	}
 
 fail:
+	/* the area drawn is the clipping region restricted to the tiles, add it in one go */
+	if (invalidRegion && (numTileRects > 0))
+	{
+		UINT32 nbUpdatedRects = 0;
+
+		if (!region16_intersect_rects(&updatedRegion, &clippingRects, tileRects, numTileRects))
+			rc = FALSE;
+		else
+		{
+			const RECTANGLE_16* updatedRects = region16_rects(&updatedRegion, &nbUpdatedRects);
+			if (!region16_union_rects(invalidRegion, invalidRegion, updatedRects, nbUpdatedRects))
+				rc = FALSE;
+		}
+	}
+
+	region16_uninit(&updatedRegion);
 	region16_uninit(&clippingRects);
+	free(tileRects);
+	free(clipRects);
 	return rc;
 }
 
@@ -2567,6 +2604,20 @@ int progressive_compress(PROGRESSIVE_CONTEXT* progressive, const BYTE* pSrcData,
 	progressive->rfx_context->width = Width;
 	progressive->rfx_context->height = Height;
 	rfx_context_set_pixel_format(progressive->rfx_context, SrcFormat);
+
+	if (progressive->encoder)
+	{
+		res = progressive_encoder_compress(progressive, pSrcData, SrcFormat, Width, Height,
+		                                   ScanLine, rects, numRects, s);
+		if (res <= 0)
+		{
+			if (res < 0)
+				WLog_ERR(TAG, "failed to encode progressive first pass");
+			return res;
+		}
+		goto out;
+	}
+
 	message = rfx_encode_message(progressive->rfx_context, rects, numRects, pSrcData, Width, Height,
 	                             ScanLine);
 	if (!message)
@@ -2580,20 +2631,71 @@ int progressive_compress(PROGRESSIVE_CONTEXT* progressive, const BYTE* pSrcData,
 	if (!rc)
 		goto fail;
 
-	const size_t pos = Stream_GetPosition(s);
-	WINPR_ASSERT(pos <= UINT32_MAX);
-	*pDstSize = (UINT32)pos;
+out:
+	WINPR_ASSERT(Stream_GetPosition(s) <= UINT32_MAX);
+	*pDstSize = (UINT32)Stream_GetPosition(s);
 	*ppDstData = Stream_Buffer(s);
 	res = 1;
 fail:
 	return res;
 }
 
+int progressive_compress_upgrade(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive, UINT32 maxSize,
+                                 BYTE** WINPR_RESTRICT ppDstData, UINT32* WINPR_RESTRICT pDstSize)
+{
+	if (!progressive || !ppDstData || !pDstSize)
+		return -1;
+
+	if (!progressive->encoder)
+		return 0;
+
+	wStream* s = progressive->buffer;
+	const int res = progressive_encoder_upgrade(progressive, maxSize, s);
+	if (res <= 0)
+	{
+		if (res < 0)
+			WLog_ERR(TAG, "failed to encode progressive upgrade");
+		return res;
+	}
+
+	const size_t pos = Stream_GetPosition(s);
+	WINPR_ASSERT(pos <= UINT32_MAX);
+	*pDstSize = (UINT32)pos;
+	*ppDstData = Stream_Buffer(s);
+	return 1;
+}
+
+UINT32 progressive_compress_pending(const PROGRESSIVE_CONTEXT* progressive)
+{
+	if (!progressive)
+		return 0;
+
+	return progressive_encoder_pending(progressive->encoder);
+}
+
+BOOL progressive_context_set_refinement(PROGRESSIVE_CONTEXT* progressive, BOOL enable)
+{
+	if (!progressive || !progressive->Compressor)
+		return FALSE;
+
+	if (!enable)
+	{
+		progressive_encoder_free(progressive->encoder);
+		progressive->encoder = NULL;
+		return TRUE;
+	}
+
+	if (!progressive->encoder)
+		progressive->encoder = progressive_encoder_new();
+	return progressive->encoder != NULL;
+}
+
 BOOL progressive_context_reset(PROGRESSIVE_CONTEXT* progressive)
 {
 	if (!progressive)
 		return FALSE;
 
+	progressive_encoder_reset(progressive->encoder);
 	return TRUE;
 }
 
@@ -2652,6 +2754,7 @@ void progressive_context_free(PROGRESSIVE_CONTEXT* progressive)
 
 	Stream_Free(progressive->buffer, TRUE);
 	Stream_Free(progressive->rects, TRUE);
+	progressive_encoder_free(progressive->encoder);
 	rfx_context_free(progressive->rfx_context);
 
 	BufferPool_Free(progressive->bufferPool);
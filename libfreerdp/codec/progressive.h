@@ -141,6 +141,7 @@ typedef struct
 } RFX_PROGRESSIVE_TILE;
 
 typedef struct S_PROGRESSIVE_CONTEXT PROGRESSIVE_CONTEXT;
+typedef struct S_PROGRESSIVE_ENCODER PROGRESSIVE_ENCODER;
 typedef struct S_PROGRESSIVE_BLOCK_REGION PROGRESSIVE_BLOCK_REGION;
 
 typedef struct
@@ -228,6 +229,7 @@ struct S_PROGRESSIVE_CONTEXT
 	wStream* buffer;
 	wStream* rects;
 	RFX_CONTEXT* rfx_context;
+	PROGRESSIVE_ENCODER* encoder; /* refinement encoder, NULL if disabled */
 	PROGRESSIVE_TILE_PROCESS_WORK_PARAM params[0x10000];
 	PTP_WORK work_objects[0x10000];
 };
@@ -0,0 +1,810 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Progressive Codec Bitmap Compression - Refinement Encoder
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <stddef.h>
+
+#include <winpr/assert.h>
+#include <winpr/crt.h>
+#include <winpr/bitstream.h>
+
+#include <freerdp/log.h>
+#include <freerdp/primitives.h>
+#include <freerdp/codec/color.h>
+
+#include "rfx_types.h"
+#include "rfx_constants.h"
+#include "rfx_differential.h"
+#include "rfx_dwt.h"
+#include "rfx_encode.h"
+#include "progressive.h"
+#include "progressive_encode.h"
+
+#define TAG FREERDP_TAG("codec.progressive")
+
+#define PROGRESSIVE_QUALITY_FULL 0xFF
+
+/* Most bit planes a single upgrade pass adds to a sub-band */
+#define PROGRESSIVE_ENCODE_MAX_BITS 5
+
+#define PROGRESSIVE_ENCODE_RLGR_SIZE 8192
+#define PROGRESSIVE_ENCODE_RAW_SIZE (4096 * PROGRESSIVE_ENCODE_MAX_BITS / 8 + 4)
+/* run length, sign and unary magnitude of one coefficient fit in 48 bits */
+#define PROGRESSIVE_ENCODE_SRL_SIZE (4096 * 6 + 4)
+
+typedef struct
+{
+	size_t offset;
+	size_t length;
+	size_t quant; /* offset of the band in RFX_COMPONENT_CODEC_QUANT */
+} PROGRESSIVE_ENCODE_BAND;
+
+/* Sub-bands of the reduce extrapolate DWT in the order upgrade passes are coded */
+static const PROGRESSIVE_ENCODE_BAND progressive_encode_bands[] = {
+	{ 0, 1023, offsetof(RFX_COMPONENT_CODEC_QUANT, HL1) },
+	{ 1023, 1023, offsetof(RFX_COMPONENT_CODEC_QUANT, LH1) },
+	{ 2046, 961, offsetof(RFX_COMPONENT_CODEC_QUANT, HH1) },
+	{ 3007, 272, offsetof(RFX_COMPONENT_CODEC_QUANT, HL2) },
+	{ 3279, 272, offsetof(RFX_COMPONENT_CODEC_QUANT, LH2) },
+	{ 3551, 256, offsetof(RFX_COMPONENT_CODEC_QUANT, HH2) },
+	{ 3807, 72, offsetof(RFX_COMPONENT_CODEC_QUANT, HL3) },
+	{ 3879, 72, offsetof(RFX_COMPONENT_CODEC_QUANT, LH3) },
+	{ 3951, 64, offsetof(RFX_COMPONENT_CODEC_QUANT, HH3) },
+	{ 4015, 81, offsetof(RFX_COMPONENT_CODEC_QUANT, LL3) },
+};
+
+#define PROGRESSIVE_ENCODE_BAND_LL3 9
+
+/* RemoteFX default quantization: LL3 HL3 LH3 HH3 HL2 LH2 HH2 HL1 LH1 HH1 */
+static const RFX_COMPONENT_CODEC_QUANT progressive_encode_quant = { 6, 6, 6, 6, 7, 7, 8, 8, 8, 9 };
+
+/* Bit planes withheld at each quality level, the final upgrade sends the rest */
+static const RFX_PROGRESSIVE_CODEC_QUANT progressive_encode_quant_prog[] = {
+	{ 25,
+	  { 2, 3, 3, 3, 4, 4, 4, 5, 5, 5 },
+	  { 2, 3, 3, 3, 4, 4, 4, 5, 5, 5 },
+	  { 2, 3, 3, 3, 4, 4, 4, 5, 5, 5 } },
+	{ 50,
+	  { 1, 2, 2, 2, 3, 3, 3, 3, 3, 3 },
+	  { 1, 2, 2, 2, 3, 3, 3, 3, 3, 3 },
+	  { 1, 2, 2, 2, 3, 3, 3, 3, 3, 3 } },
+	{ 75,
+	  { 0, 1, 1, 1, 1, 1, 1, 2, 2, 2 },
+	  { 0, 1, 1, 1, 1, 1, 1, 2, 2, 2 },
+	  { 0, 1, 1, 1, 1, 1, 1, 2, 2, 2 } },
+};
+
+static const RFX_PROGRESSIVE_CODEC_QUANT progressive_encode_quant_full = {
+	100, { 0 }, { 0 }, { 0 }
+};
+
+typedef struct
+{
+	BOOL valid;    /* the client holds this tile */
+	BYTE quality;  /* quality level the client holds, PROGRESSIVE_QUALITY_FULL when done */
+	UINT32 stamp;  /* last message the tile was written to */
+	INT16* coeffs; /* quantized Y, Cb and Cr coefficients while upgrades are pending */
+} PROGRESSIVE_ENCODE_TILE;
+
+struct S_PROGRESSIVE_ENCODER
+{
+	UINT32 width;
+	UINT32 height;
+	UINT32 format;
+	UINT32 gridWidth;
+	UINT32 gridHeight;
+	PROGRESSIVE_ENCODE_TILE* tiles;
+	BYTE* pixels; /* source pixels every tile was last encoded from */
+
+	UINT32 pending;
+	UINT32 stamp;
+	UINT32 frameIndex;
+
+	wStream* rects;
+	wStream* tileData;
+
+	INT16 srlValues[4096];
+	BYTE srlBits[4096];
+	BYTE rlgr[3][PROGRESSIVE_ENCODE_RLGR_SIZE];
+	BYTE srl[3][PROGRESSIVE_ENCODE_SRL_SIZE];
+	BYTE raw[3][PROGRESSIVE_ENCODE_RAW_SIZE];
+};
+
+static INLINE UINT32 progressive_encode_band_quant(const RFX_COMPONENT_CODEC_QUANT* quant,
+                                                   const PROGRESSIVE_ENCODE_BAND* band)
+{
+	return ((const BYTE*)quant)[band->quant];
+}
+
+static INLINE const RFX_PROGRESSIVE_CODEC_QUANT* progressive_encode_get_quant_prog(BYTE quality)
+{
+	if (quality == PROGRESSIVE_QUALITY_FULL)
+		return &progressive_encode_quant_full;
+
+	WINPR_ASSERT(quality < ARRAYSIZE(progressive_encode_quant_prog));
+	return &progressive_encode_quant_prog[quality];
+}
+
+static void progressive_encoder_free_tiles(PROGRESSIVE_ENCODER* encoder)
+{
+	WINPR_ASSERT(encoder);
+
+	for (size_t x = 0; x < 1ull * encoder->gridWidth * encoder->gridHeight; x++)
+		winpr_aligned_free(encoder->tiles[x].coeffs);
+
+	free(encoder->tiles);
+	winpr_aligned_free(encoder->pixels);
+	encoder->tiles = NULL;
+	encoder->pixels = NULL;
+	encoder->gridWidth = 0;
+	encoder->gridHeight = 0;
+	encoder->pending = 0;
+}
+
+static BOOL progressive_encoder_resize(PROGRESSIVE_ENCODER* encoder, UINT32 width, UINT32 height,
+                                       UINT32 format)
+{
+	WINPR_ASSERT(encoder);
+
+	progressive_encoder_free_tiles(encoder);
+	encoder->width = width;
+	encoder->height = height;
+	encoder->format = format;
+
+	const size_t gridWidth = (width + 63) / 64;
+	const size_t gridHeight = (height + 63) / 64;
+	const size_t gridSize = gridWidth * gridHeight;
+	if (gridSize == 0)
+		return TRUE;
+
+	encoder->tiles = (PROGRESSIVE_ENCODE_TILE*)calloc(gridSize, sizeof(PROGRESSIVE_ENCODE_TILE));
+	encoder->pixels = (BYTE*)winpr_aligned_malloc(gridSize * 64 * 64 * 4, 32);
+	if (!encoder->tiles || !encoder->pixels)
+	{
+		progressive_encoder_free_tiles(encoder);
+		return FALSE;
+	}
+
+	encoder->gridWidth = (UINT32)gridWidth;
+	encoder->gridHeight = (UINT32)gridHeight;
+	return TRUE;
+}
+
+void progressive_encoder_free(PROGRESSIVE_ENCODER* encoder)
+{
+	if (!encoder)
+		return;
+
+	progressive_encoder_free_tiles(encoder);
+	Stream_Free(encoder->rects, TRUE);
+	Stream_Free(encoder->tileData, TRUE);
+	winpr_aligned_free(encoder);
+}
+
+PROGRESSIVE_ENCODER* progressive_encoder_new(void)
+{
+	PROGRESSIVE_ENCODER* encoder =
+	    (PROGRESSIVE_ENCODER*)winpr_aligned_calloc(1, sizeof(PROGRESSIVE_ENCODER), 32);
+
+	if (!encoder)
+		return NULL;
+
+	encoder->rects = Stream_New(NULL, 1024);
+	encoder->tileData = Stream_New(NULL, 64ull * 1024);
+	if (!encoder->rects || !encoder->tileData)
+	{
+		progressive_encoder_free(encoder);
+		return NULL;
+	}
+
+	return encoder;
+}
+
+void progressive_encoder_reset(PROGRESSIVE_ENCODER* encoder)
+{
+	if (!encoder)
+		return;
+
+	for (size_t x = 0; x < 1ull * encoder->gridWidth * encoder->gridHeight; x++)
+	{
+		PROGRESSIVE_ENCODE_TILE* tile = &encoder->tiles[x];
+		winpr_aligned_free(tile->coeffs);
+		memset(tile, 0, sizeof(PROGRESSIVE_ENCODE_TILE));
+	}
+
+	encoder->pending = 0;
+}
+
+UINT32 progressive_encoder_pending(const PROGRESSIVE_ENCODER* encoder)
+{
+	if (!encoder)
+		return 0;
+	return encoder->pending;
+}
+
+static INLINE void progressive_encode_quant_write(wStream* WINPR_RESTRICT s,
+                                                  const RFX_COMPONENT_CODEC_QUANT* WINPR_RESTRICT q)
+{
+	Stream_Write_UINT8(s, (BYTE)(q->LL3 | (q->HL3 << 4))); /* LL3 (4-bit), HL3 (4-bit) */
+	Stream_Write_UINT8(s, (BYTE)(q->LH3 | (q->HH3 << 4))); /* LH3 (4-bit), HH3 (4-bit) */
+	Stream_Write_UINT8(s, (BYTE)(q->HL2 | (q->LH2 << 4))); /* HL2 (4-bit), LH2 (4-bit) */
+	Stream_Write_UINT8(s, (BYTE)(q->HH2 | (q->HL1 << 4))); /* HH2 (4-bit), HL1 (4-bit) */
+	Stream_Write_UINT8(s, (BYTE)(q->LH1 | (q->HH1 << 4))); /* LH1 (4-bit), HH1 (4-bit) */
+}
+
+static BOOL progressive_encode_write_rect(PROGRESSIVE_ENCODER* WINPR_RESTRICT encoder, UINT32 xIdx,
+                                          UINT32 yIdx)
+{
+	const UINT32 x = xIdx * 64;
+	const UINT32 y = yIdx * 64;
+
+	if (!Stream_EnsureRemainingCapacity(encoder->rects, 8))
+		return FALSE;
+
+	/* TS_RFX_RECT */
+	Stream_Write_UINT16(encoder->rects, (UINT16)x);                             /* x (2 bytes) */
+	Stream_Write_UINT16(encoder->rects, (UINT16)y);                             /* y (2 bytes) */
+	Stream_Write_UINT16(encoder->rects, (UINT16)MIN(64, encoder->width - x));  /* width */
+	Stream_Write_UINT16(encoder->rects, (UINT16)MIN(64, encoder->height - y)); /* height */
+	return TRUE;
+}
+
+static BOOL progressive_encode_write_message(PROGRESSIVE_ENCODER* WINPR_RESTRICT encoder,
+                                             wStream* WINPR_RESTRICT s, size_t numTiles)
+{
+	const size_t numProgQuant = ARRAYSIZE(progressive_encode_quant_prog);
+	const size_t rectsLen = Stream_GetPosition(encoder->rects);
+	const size_t tilesDataSize = Stream_GetPosition(encoder->tileData);
+	const size_t regionLen = 18 + rectsLen + 5 + numProgQuant * 16 + tilesDataSize;
+
+	if ((numTiles > UINT16_MAX) || (regionLen > UINT32_MAX))
+		return FALSE;
+
+	Stream_SetPosition(s, 0);
+	if (!Stream_EnsureCapacity(s, 12 + 10 + 12 + regionLen + 6))
+		return FALSE;
+
+	/* RFX_PROGRESSIVE_SYNC */
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_SYNC); /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, 12);                   /* blockLen (4 bytes) */
+	Stream_Write_UINT32(s, 0xCACCACCA);           /* magic (4 bytes) */
+	Stream_Write_UINT16(s, 0x0100);               /* version (2 bytes) */
+
+	/* RFX_PROGRESSIVE_CONTEXT */
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_CONTEXT); /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, 10);                      /* blockLen (4 bytes) */
+	Stream_Write_UINT8(s, 0);                        /* ctxId (1 byte) */
+	Stream_Write_UINT16(s, 64);                      /* tileSize (2 bytes) */
+	Stream_Write_UINT8(s, RFX_SUBBAND_DIFFING);      /* flags (1 byte) */
+
+	/* RFX_PROGRESSIVE_FRAME_BEGIN */
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_FRAME_BEGIN); /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, 12);                          /* blockLen (4 bytes) */
+	Stream_Write_UINT32(s, encoder->frameIndex++);       /* frameIndex (4 bytes) */
+	Stream_Write_UINT16(s, 1);                           /* regionCount (2 bytes) */
+
+	/* RFX_PROGRESSIVE_REGION */
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_REGION);      /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, (UINT32)regionLen);           /* blockLen (4 bytes) */
+	Stream_Write_UINT8(s, 64);                           /* tileSize (1 byte) */
+	Stream_Write_UINT16(s, (UINT16)(rectsLen / 8));      /* numRects (2 bytes) */
+	Stream_Write_UINT8(s, 1);                            /* numQuant (1 byte) */
+	Stream_Write_UINT8(s, (BYTE)numProgQuant);           /* numProgQuant (1 byte) */
+	Stream_Write_UINT8(s, RFX_DWT_REDUCE_EXTRAPOLATE);   /* flags (1 byte) */
+	Stream_Write_UINT16(s, (UINT16)numTiles);            /* numTiles (2 bytes) */
+	Stream_Write_UINT32(s, (UINT32)tilesDataSize);       /* tilesDataSize (4 bytes) */
+	Stream_Write(s, Stream_Buffer(encoder->rects), rectsLen); /* rects */
+	progressive_encode_quant_write(s, &progressive_encode_quant);
+
+	for (size_t x = 0; x < numProgQuant; x++)
+	{
+		const RFX_PROGRESSIVE_CODEC_QUANT* quantProg = &progressive_encode_quant_prog[x];
+		Stream_Write_UINT8(s, quantProg->quality); /* quality (1 byte) */
+		progressive_encode_quant_write(s, &quantProg->yQuantValues);
+		progressive_encode_quant_write(s, &quantProg->cbQuantValues);
+		progressive_encode_quant_write(s, &quantProg->crQuantValues);
+	}
+
+	Stream_Write(s, Stream_Buffer(encoder->tileData), tilesDataSize); /* tiles */
+
+	/* RFX_PROGRESSIVE_FRAME_END */
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_FRAME_END); /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, 6);                         /* blockLen (4 bytes) */
+	return TRUE;
+}
+
+/**
+ * Quantize a DWT transformed component to the final quality, keeping the result in
+ * \b coeffs, and RLGR1 encode the first pass of it at \b progQuant.
+ *
+ * Non LL3 bands are coded sign/magnitude so upgrades can add magnitude bits, LL3
+ * is coded two's complement as upgrade passes only add raw bits to it.
+ */
+static int progressive_encode_component(RFX_CONTEXT* WINPR_RESTRICT rfx,
+                                        const RFX_COMPONENT_CODEC_QUANT* WINPR_RESTRICT progQuant,
+                                        INT16* WINPR_RESTRICT buffer, INT16* WINPR_RESTRICT coeffs,
+                                        BYTE* WINPR_RESTRICT dst, UINT32 dstSize)
+{
+	for (size_t x = 0; x < ARRAYSIZE(progressive_encode_bands); x++)
+	{
+		const PROGRESSIVE_ENCODE_BAND* band = &progressive_encode_bands[x];
+		const UINT32 shift = progressive_encode_band_quant(&progressive_encode_quant, band) - 1;
+		const UINT32 bitPos = progressive_encode_band_quant(progQuant, band);
+		const INT32 half = 1 << (shift - 1);
+		INT16* src = &buffer[band->offset];
+		INT16* coeff = &coeffs[band->offset];
+
+		for (size_t y = 0; y < band->length; y++)
+		{
+			const INT32 val = src[y];
+			const INT32 c = (val < 0) ? -((-val + half) >> shift) : ((val + half) >> shift);
+			coeff[y] = (INT16)c;
+
+			if (x == PROGRESSIVE_ENCODE_BAND_LL3)
+				src[y] = (INT16)(c >> bitPos);
+			else
+				src[y] = (INT16)((c < 0) ? -((-c) >> bitPos) : (c >> bitPos));
+		}
+	}
+
+	rfx_differential_encode(&buffer[4015], 81);
+	ZeroMemory(dst, dstSize);
+	return rfx->rlgr_encode(RLGR1, buffer, 4096, dst, dstSize);
+}
+
+static BOOL progressive_encode_tile_first(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
+                                          PROGRESSIVE_ENCODE_TILE* WINPR_RESTRICT tile,
+                                          UINT32 xIdx, UINT32 yIdx, const BYTE* WINPR_RESTRICT src,
+                                          UINT32 width, UINT32 height, UINT32 scanline)
+{
+	union
+	{
+		const INT16** cpv;
+		INT16** pv;
+	} cnv;
+	BOOL rc = FALSE;
+	INT16* pSrcDst[3] = { 0 };
+	UINT32 len[3] = { 0 };
+	static const prim_size_t roi_64x64 = { 64, 64 };
+	const primitives_t* prims = primitives_get();
+	PROGRESSIVE_ENCODER* encoder = progressive->encoder;
+	RFX_CONTEXT* rfx = progressive->rfx_context;
+	const RFX_PROGRESSIVE_CODEC_QUANT* quantProg = progressive_encode_get_quant_prog(0);
+	const RFX_COMPONENT_CODEC_QUANT* progQuant[3] = { &quantProg->yQuantValues,
+		                                              &quantProg->cbQuantValues,
+		                                              &quantProg->crQuantValues };
+
+	if (!tile->coeffs)
+		tile->coeffs = (INT16*)winpr_aligned_malloc(3ull * 4096 * sizeof(INT16), 32);
+
+	BYTE* pBuffer = (BYTE*)BufferPool_Take(progressive->bufferPool, -1);
+	INT16* temp = (INT16*)BufferPool_Take(progressive->bufferPool, -1); /* DWT buffer */
+	if (!tile->coeffs || !pBuffer || !temp)
+		goto fail;
+
+	pSrcDst[0] = (INT16*)((BYTE*)(&pBuffer[((8192 + 32) * 0) + 16])); /* Y/R buffer */
+	pSrcDst[1] = (INT16*)((BYTE*)(&pBuffer[((8192 + 32) * 1) + 16])); /* Cb/G buffer */
+	pSrcDst[2] = (INT16*)((BYTE*)(&pBuffer[((8192 + 32) * 2) + 16])); /* Cr/B buffer */
+
+	rfx_encode_format_rgb(src, (int)width, (int)height, (int)scanline, rfx->pixel_format,
+	                      rfx->palette, pSrcDst[0], pSrcDst[1], pSrcDst[2]);
+	cnv.pv = pSrcDst;
+	if (prims->RGBToYCbCr_16s16s_P3P3(cnv.cpv, 64 * sizeof(INT16), pSrcDst, 64 * sizeof(INT16),
+	                                  &roi_64x64) != PRIMITIVES_SUCCESS)
+		goto fail;
+
+	for (size_t x = 0; x < 3; x++)
+	{
+		rfx_dwt_2d_extrapolate_encode(pSrcDst[x], temp);
+		const int status =
+		    progressive_encode_component(rfx, progQuant[x], pSrcDst[x], &tile->coeffs[x * 4096],
+		                                 encoder->rlgr[x], sizeof(encoder->rlgr[x]));
+		if ((status < 0) || (status > UINT16_MAX))
+			goto fail;
+		len[x] = (UINT32)status;
+	}
+
+	wStream* s = encoder->tileData;
+	const UINT32 blockLen = 23 + len[0] + len[1] + len[2];
+	if (!Stream_EnsureRemainingCapacity(s, blockLen))
+		goto fail;
+
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_TILE_FIRST); /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, blockLen);                   /* blockLen (4 bytes) */
+	Stream_Write_UINT8(s, 0);                           /* quantIdxY (1 byte) */
+	Stream_Write_UINT8(s, 0);                           /* quantIdxCb (1 byte) */
+	Stream_Write_UINT8(s, 0);                           /* quantIdxCr (1 byte) */
+	Stream_Write_UINT16(s, (UINT16)xIdx);               /* xIdx (2 bytes) */
+	Stream_Write_UINT16(s, (UINT16)yIdx);               /* yIdx (2 bytes) */
+	Stream_Write_UINT8(s, 0);                           /* flags (1 byte) */
+	Stream_Write_UINT8(s, 0);                           /* quality (1 byte) */
+	Stream_Write_UINT16(s, (UINT16)len[0]);             /* yLen (2 bytes) */
+	Stream_Write_UINT16(s, (UINT16)len[1]);             /* cbLen (2 bytes) */
+	Stream_Write_UINT16(s, (UINT16)len[2]);             /* crLen (2 bytes) */
+	Stream_Write_UINT16(s, 0);                          /* tailLen (2 bytes) */
+	Stream_Write(s, encoder->rlgr[0], len[0]);          /* yData */
+	Stream_Write(s, encoder->rlgr[1], len[1]);          /* cbData */
+	Stream_Write(s, encoder->rlgr[2], len[2]);          /* crData */
+
+	if (!tile->valid || (tile->quality == PROGRESSIVE_QUALITY_FULL))
+		encoder->pending++;
+	tile->valid = TRUE;
+	tile->quality = 0;
+	rc = TRUE;
+fail:
+	BufferPool_Return(progressive->bufferPool, temp);
+	BufferPool_Return(progressive->bufferPool, pBuffer);
+	return rc;
+}
+
+static INLINE void progressive_encode_bits(wBitStream* WINPR_RESTRICT bs, UINT32 bits,
+                                           UINT32 nbits)
+{
+	if (nbits > 0)
+		BitStream_Write_Bits(bs, bits, nbits);
+}
+
+/**
+ * Inverse of progressive_rfx_srl_read: adaptive run length coding of the zero
+ * coefficients followed by sign and unary magnitude of each newly significant one.
+ */
+static void progressive_encode_srl(wBitStream* WINPR_RESTRICT bs,
+                                   const INT16* WINPR_RESTRICT values,
+                                   const BYTE* WINPR_RESTRICT bits, size_t count)
+{
+	UINT32 kp = 8;
+	size_t index = 0;
+
+	while (index < count)
+	{
+		const UINT32 k = kp / 8;
+		const size_t run = 1ull << k;
+		size_t nz = 0;
+
+		while ((index + nz < count) && (nz < run) && (values[index + nz] == 0))
+			nz++;
+
+		if ((nz == run) || (index + nz == count))
+		{
+			/* '0' bit, a full run of (1 << k) zeros, trailing zeros are padded */
+			progressive_encode_bits(bs, 0, 1);
+			index += nz;
+			kp = MIN(kp + 4, 80);
+			continue;
+		}
+
+		/* '1' bit, nz < (1 << k) zeros in the next k bits, then the value */
+		progressive_encode_bits(bs, 1, 1);
+		progressive_encode_bits(bs, (UINT32)nz, k);
+		index += nz;
+
+		const INT32 value = values[index];
+		const UINT32 numBits = bits[index];
+		const UINT32 mag = (UINT32)abs(value);
+		const UINT32 max = (1u << numBits) - 1;
+		index++;
+
+		progressive_encode_bits(bs, (value < 0) ? 1 : 0, 1);
+		kp = (kp < 6) ? 0 : kp - 6;
+
+		if (numBits > 1)
+		{
+			progressive_encode_bits(bs, 0, mag - 1);
+			if (mag < max)
+				progressive_encode_bits(bs, 1, 1);
+		}
+	}
+}
+
+static BOOL progressive_encode_upgrade_component(PROGRESSIVE_ENCODER* WINPR_RESTRICT encoder,
+                                                 const INT16* WINPR_RESTRICT coeffs,
+                                                 const RFX_COMPONENT_CODEC_QUANT* WINPR_RESTRICT
+                                                     oldQuant,
+                                                 const RFX_COMPONENT_CODEC_QUANT* WINPR_RESTRICT
+                                                     newQuant,
+                                                 size_t component, UINT16* WINPR_RESTRICT srlLen,
+                                                 UINT16* WINPR_RESTRICT rawLen)
+{
+	size_t count = 0;
+	wBitStream srl = { 0 };
+	wBitStream raw = { 0 };
+
+	BitStream_Attach(&srl, encoder->srl[component], sizeof(encoder->srl[component]));
+	BitStream_Attach(&raw, encoder->raw[component], sizeof(encoder->raw[component]));
+
+	for (size_t x = 0; x < ARRAYSIZE(progressive_encode_bands); x++)
+	{
+		const PROGRESSIVE_ENCODE_BAND* band = &progressive_encode_bands[x];
+		const UINT32 oldPos = progressive_encode_band_quant(oldQuant, band);
+		const UINT32 newPos = progressive_encode_band_quant(newQuant, band);
+		const INT16* coeff = &coeffs[band->offset];
+
+		WINPR_ASSERT(oldPos >= newPos);
+		const UINT32 numBits = oldPos - newPos;
+		if (numBits == 0)
+			continue;
+
+		WINPR_ASSERT(numBits <= PROGRESSIVE_ENCODE_MAX_BITS);
+		const UINT32 mask = (1u << numBits) - 1;
+
+		for (size_t y = 0; y < band->length; y++)
+		{
+			const INT32 c = coeff[y];
+
+			if (x == PROGRESSIVE_ENCODE_BAND_LL3)
+			{
+				progressive_encode_bits(&raw, (UINT32)(c >> newPos) & mask, numBits);
+				continue;
+			}
+
+			const UINT32 mag = (UINT32)abs(c);
+			if ((mag >> oldPos) != 0)
+			{
+				/* already significant, magnitude bits go to RAW */
+				progressive_encode_bits(&raw, (mag >> newPos) & mask, numBits);
+			}
+			else
+			{
+				const INT32 value = (INT32)(mag >> newPos);
+				encoder->srlValues[count] = (INT16)((c < 0) ? -value : value);
+				encoder->srlBits[count] = (BYTE)numBits;
+				count++;
+			}
+		}
+	}
+
+	progressive_encode_srl(&srl, encoder->srlValues, encoder->srlBits, count);
+	BitStream_Flush(&srl);
+	BitStream_Flush(&raw);
+
+	const size_t aSrlLen = (srl.position + 7) / 8;
+	const size_t aRawLen = (raw.position + 7) / 8;
+	if ((aSrlLen > sizeof(encoder->srl[component])) || (aRawLen > sizeof(encoder->raw[component])))
+	{
+		WLog_ERR(TAG, "upgrade pass exceeds buffer, SRL %" PRIuz " RAW %" PRIuz, aSrlLen, aRawLen);
+		return FALSE;
+	}
+
+	*srlLen = (UINT16)aSrlLen;
+	*rawLen = (UINT16)aRawLen;
+	return TRUE;
+}
+
+static BOOL progressive_encode_tile_upgrade(PROGRESSIVE_ENCODER* WINPR_RESTRICT encoder,
+                                            PROGRESSIVE_ENCODE_TILE* WINPR_RESTRICT tile,
+                                            UINT32 xIdx, UINT32 yIdx)
+{
+	UINT16 srlLen[3] = { 0 };
+	UINT16 rawLen[3] = { 0 };
+	const BYTE quality = (tile->quality + 1 < ARRAYSIZE(progressive_encode_quant_prog))
+	                         ? (BYTE)(tile->quality + 1)
+	                         : PROGRESSIVE_QUALITY_FULL;
+	const RFX_PROGRESSIVE_CODEC_QUANT* oldQuant = progressive_encode_get_quant_prog(tile->quality);
+	const RFX_PROGRESSIVE_CODEC_QUANT* newQuant = progressive_encode_get_quant_prog(quality);
+
+	WINPR_ASSERT(tile->coeffs);
+
+	if (!progressive_encode_upgrade_component(encoder, &tile->coeffs[0], &oldQuant->yQuantValues,
+	                                          &newQuant->yQuantValues, 0, &srlLen[0], &rawLen[0]))
+		return FALSE;
+	if (!progressive_encode_upgrade_component(encoder, &tile->coeffs[4096],
+	                                          &oldQuant->cbQuantValues, &newQuant->cbQuantValues,
+	                                          1, &srlLen[1], &rawLen[1]))
+		return FALSE;
+	if (!progressive_encode_upgrade_component(encoder, &tile->coeffs[8192],
+	                                          &oldQuant->crQuantValues, &newQuant->crQuantValues,
+	                                          2, &srlLen[2], &rawLen[2]))
+		return FALSE;
+
+	wStream* s = encoder->tileData;
+	UINT32 blockLen = 26;
+	for (size_t x = 0; x < 3; x++)
+		blockLen += srlLen[x] + rawLen[x];
+
+	if (!Stream_EnsureRemainingCapacity(s, blockLen))
+		return FALSE;
+
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_TILE_UPGRADE); /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, blockLen);                     /* blockLen (4 bytes) */
+	Stream_Write_UINT8(s, 0);                             /* quantIdxY (1 byte) */
+	Stream_Write_UINT8(s, 0);                             /* quantIdxCb (1 byte) */
+	Stream_Write_UINT8(s, 0);                             /* quantIdxCr (1 byte) */
+	Stream_Write_UINT16(s, (UINT16)xIdx);                 /* xIdx (2 bytes) */
+	Stream_Write_UINT16(s, (UINT16)yIdx);                 /* yIdx (2 bytes) */
+	Stream_Write_UINT8(s, quality);                       /* quality (1 byte) */
+	for (size_t x = 0; x < 3; x++)
+	{
+		Stream_Write_UINT16(s, srlLen[x]); /* srlLen (2 bytes) */
+		Stream_Write_UINT16(s, rawLen[x]); /* rawLen (2 bytes) */
+	}
+	for (size_t x = 0; x < 3; x++)
+	{
+		Stream_Write(s, encoder->srl[x], srlLen[x]); /* srlData */
+		Stream_Write(s, encoder->raw[x], rawLen[x]); /* rawData */
+	}
+
+	tile->quality = quality;
+	if (quality == PROGRESSIVE_QUALITY_FULL)
+	{
+		winpr_aligned_free(tile->coeffs);
+		tile->coeffs = NULL;
+		encoder->pending--;
+	}
+
+	return TRUE;
+}
+
+/* Compare a tile with the pixels it was last encoded from and update the copy */
+static BOOL progressive_encode_tile_changed(PROGRESSIVE_ENCODER* WINPR_RESTRICT encoder,
+                                            size_t index, const BYTE* WINPR_RESTRICT src,
+                                            UINT32 scanline, UINT32 width, UINT32 height)
+{
+	const PROGRESSIVE_ENCODE_TILE* tile = &encoder->tiles[index];
+	const size_t rowSize = 1ull * width * FreeRDPGetBytesPerPixel(encoder->format);
+	BYTE* cache = &encoder->pixels[index * 64 * 64 * 4];
+	BOOL changed = !tile->valid;
+
+	for (UINT32 y = 0; y < height; y++)
+	{
+		const BYTE* row = &src[1ull * y * scanline];
+		BYTE* dst = &cache[y * 64ull * 4];
+
+		if (changed || (memcmp(dst, row, rowSize) != 0))
+		{
+			changed = TRUE;
+			memcpy(dst, row, rowSize);
+		}
+	}
+
+	return changed;
+}
+
+int progressive_encoder_compress(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
+                                 const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcFormat,
+                                 UINT32 Width, UINT32 Height, UINT32 ScanLine,
+                                 const RFX_RECT* WINPR_RESTRICT rects, UINT32 numRects,
+                                 wStream* WINPR_RESTRICT s)
+{
+	WINPR_ASSERT(progressive);
+	WINPR_ASSERT(pSrcData);
+	WINPR_ASSERT(rects || (numRects == 0));
+	WINPR_ASSERT(s);
+
+	PROGRESSIVE_ENCODER* encoder = progressive->encoder;
+	WINPR_ASSERT(encoder);
+
+	const size_t bpp = FreeRDPGetBytesPerPixel(SrcFormat);
+	if ((bpp == 0) || (bpp > 4))
+		return -1;
+
+	if ((Width != encoder->width) || (Height != encoder->height) || (SrcFormat != encoder->format))
+	{
+		if (!progressive_encoder_resize(encoder, Width, Height, SrcFormat))
+			return -1;
+	}
+
+	size_t numTiles = 0;
+	encoder->stamp++;
+	Stream_SetPosition(encoder->rects, 0);
+	Stream_SetPosition(encoder->tileData, 0);
+
+	for (UINT32 i = 0; i < numRects; i++)
+	{
+		const RFX_RECT* rect = &rects[i];
+		const UINT32 xStart = rect->x / 64;
+		const UINT32 yStart = rect->y / 64;
+		const UINT32 xEnd = MIN((rect->x + rect->width + 63) / 64, encoder->gridWidth);
+		const UINT32 yEnd = MIN((rect->y + rect->height + 63) / 64, encoder->gridHeight);
+
+		for (UINT32 yIdx = yStart; yIdx < yEnd; yIdx++)
+		{
+			for (UINT32 xIdx = xStart; xIdx < xEnd; xIdx++)
+			{
+				const size_t index = 1ull * yIdx * encoder->gridWidth + xIdx;
+				PROGRESSIVE_ENCODE_TILE* tile = &encoder->tiles[index];
+				const UINT32 x = xIdx * 64;
+				const UINT32 y = yIdx * 64;
+				const UINT32 width = MIN(64, Width - x);
+				const UINT32 height = MIN(64, Height - y);
+				const BYTE* src = &pSrcData[1ull * y * ScanLine + x * bpp];
+
+				if (tile->stamp == encoder->stamp)
+					continue;
+				tile->stamp = encoder->stamp;
+
+				if (!progressive_encode_tile_changed(encoder, index, src, ScanLine, width, height))
+					continue;
+
+				if (numTiles >= UINT16_MAX)
+					return -1;
+
+				if (!progressive_encode_tile_first(progressive, tile, xIdx, yIdx, src, width,
+				                                   height, ScanLine))
+				{
+					/* the client state of the tile is unknown now */
+					tile->valid = FALSE;
+					return -1;
+				}
+
+				if (!progressive_encode_write_rect(encoder, xIdx, yIdx))
+					return -1;
+				numTiles++;
+			}
+		}
+	}
+
+	if (numTiles == 0)
+		return 0;
+
+	if (!progressive_encode_write_message(encoder, s, numTiles))
+		return -1;
+	return 1;
+}
+
+int progressive_encoder_upgrade(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive, UINT32 maxSize,
+                                wStream* WINPR_RESTRICT s)
+{
+	WINPR_ASSERT(progressive);
+	WINPR_ASSERT(s);
+
+	PROGRESSIVE_ENCODER* encoder = progressive->encoder;
+	WINPR_ASSERT(encoder);
+
+	if (encoder->pending == 0)
+		return 0;
+
+	size_t numTiles = 0;
+	const size_t gridSize = 1ull * encoder->gridWidth * encoder->gridHeight;
+	encoder->stamp++;
+	Stream_SetPosition(encoder->rects, 0);
+	Stream_SetPosition(encoder->tileData, 0);
+
+	/* Bring the coarsest tiles up first so the whole screen sharpens evenly */
+	for (BYTE quality = 0; quality < ARRAYSIZE(progressive_encode_quant_prog); quality++)
+	{
+		for (size_t index = 0; index < gridSize; index++)
+		{
+			PROGRESSIVE_ENCODE_TILE* tile = &encoder->tiles[index];
+
+			if (!tile->valid || (tile->quality != quality) || (tile->stamp == encoder->stamp))
+				continue;
+
+			if ((numTiles >= UINT16_MAX) ||
+			    ((maxSize > 0) && (Stream_GetPosition(encoder->tileData) >= maxSize)))
+				goto out;
+
+			const UINT32 xIdx = (UINT32)(index % encoder->gridWidth);
+			const UINT32 yIdx = (UINT32)(index / encoder->gridWidth);
+
+			tile->stamp = encoder->stamp;
+			if (!progressive_encode_tile_upgrade(encoder, tile, xIdx, yIdx))
+				return -1;
+			if (!progressive_encode_write_rect(encoder, xIdx, yIdx))
+				return -1;
+			numTiles++;
+		}
+	}
+
+out:
+	if (numTiles == 0)
+		return 0;
+
+	if (!progressive_encode_write_message(encoder, s, numTiles))
+		return -1;
+	return 1;
+}
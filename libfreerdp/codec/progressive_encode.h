@@ -0,0 +1,63 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Progressive Codec Bitmap Compression - Refinement Encoder
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CODEC_PROGRESSIVE_ENCODE_H
+#define FREERDP_LIB_CODEC_PROGRESSIVE_ENCODE_H
+
+#include <winpr/wtypes.h>
+#include <winpr/stream.h>
+
+#include <freerdp/api.h>
+#include <freerdp/codec/rfx.h>
+
+#include "progressive.h"
+
+FREERDP_LOCAL void progressive_encoder_free(PROGRESSIVE_ENCODER* encoder);
+
+WINPR_ATTR_MALLOC(progressive_encoder_free, 1)
+FREERDP_LOCAL PROGRESSIVE_ENCODER* progressive_encoder_new(void);
+
+/** @brief forget all tiles, the next frame is sent completely */
+FREERDP_LOCAL void progressive_encoder_reset(PROGRESSIVE_ENCODER* encoder);
+
+/** @brief encode the first pass of all changed tiles
+ *
+ *  Tiles touching \b rects are compared to the pixels they were last encoded from, only
+ *  changed ones are sent at the coarsest quality and queued for upgrades.
+ *
+ *  @return 1 if a message was written to \b s, 0 if nothing changed, < 0 on failure
+ */
+FREERDP_LOCAL int progressive_encoder_compress(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
+                                               const BYTE* WINPR_RESTRICT pSrcData,
+                                               UINT32 SrcFormat, UINT32 Width, UINT32 Height,
+                                               UINT32 ScanLine,
+                                               const RFX_RECT* WINPR_RESTRICT rects,
+                                               UINT32 numRects, wStream* WINPR_RESTRICT s);
+
+/** @brief encode the next upgrade pass of queued tiles
+ *
+ *  Tiles at the lowest quality are upgraded first, one pass per tile and message.
+ *
+ *  @param maxSize no more tiles are added once the message exceeds this size, 0 for no limit
+ *  @return 1 if a message was written to \b s, 0 if no tile needs an upgrade, < 0 on failure
+ */
+FREERDP_LOCAL int progressive_encoder_upgrade(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
+                                              UINT32 maxSize, wStream* WINPR_RESTRICT s);
+
+FREERDP_LOCAL UINT32 progressive_encoder_pending(const PROGRESSIVE_ENCODER* encoder);
+
+#endif /* FREERDP_LIB_CODEC_PROGRESSIVE_ENCODE_H */
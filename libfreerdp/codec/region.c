@@ -68,6 +68,9 @@
  * rectangles in the same places (of the same width, of course).
  */
 
+/* size is the allocated size in bytes, it may exceed the nbRects rectangles in use. Shrinking
+ * a region keeps its allocation, the bulk operations grow their output in place.
+ */
 struct S_REGION16_DATA
 {
 	long size;
@@ -225,7 +228,8 @@ BOOL region16_copy(REGION16* dst, const REGION16* src)
 		if (!dst->data)
 			return FALSE;
 
-		CopyMemory(dst->data, src->data, src->data->size);
+		/* src->data->size is the capacity of src, only copy the rectangles in use */
+		CopyMemory(&dst->data[1], &src->data[1], src->data->nbRects * sizeof(RECTANGLE_16));
 	}
 
 	return TRUE;
@@ -467,24 +471,8 @@ static BOOL region16_simplify_bands(REGION16* region)
 		}
 	} while (TRUE);
 
-	if (finalNbRects != nbRects)
-	{
-		size_t allocSize = sizeof(REGION16_DATA) + (finalNbRects * sizeof(RECTANGLE_16));
-		REGION16_DATA* data = realloc(region->data, allocSize);
-		if (!data)
-			free(region->data);
-		region->data = data;
-
-		if (!region->data)
-		{
-			region->data = &empty_region;
-			return FALSE;
-		}
-
-		region->data->nbRects = finalNbRects;
-		region->data->size = allocSize;
-	}
-
+	/* merging bands only shrinks the region, keep the allocation */
+	region->data->nbRects = finalNbRects;
 	return TRUE;
 }
 
@@ -509,6 +497,9 @@ BOOL region16_union_rect(REGION16* dst, const REGION16* src, const RECTANGLE_16*
 	if (!region16_n_rects(src))
 	{
 		/* source is empty, so the union is rect */
+		if ((dst->data->size > 0) && (dst->data != &empty_region))
+			free(dst->data);
+
 		dst->extents = *rect;
 		dst->data = allocateRegion(1);
 
@@ -806,6 +797,383 @@ BOOL region16_intersect_rect(REGION16* dst, const REGION16* src, const RECTANGLE
 	return region16_simplify_bands(dst);
 }
 
+typedef enum
+{
+	REGION16_OP_UNION,
+	REGION16_OP_INTERSECT
+} REGION16_OP;
+
+typedef struct
+{
+	UINT16 left;
+	UINT16 right;
+} REGION16_SPAN;
+
+static int region16_compare_y(const void* pva, const void* pvb)
+{
+	const UINT16* a = pva;
+	const UINT16* b = pvb;
+	return (int)*a - (int)*b;
+}
+
+static int region16_compare_top(const void* pva, const void* pvb)
+{
+	const RECTANGLE_16* a = pva;
+	const RECTANGLE_16* b = pvb;
+	return (int)a->top - (int)b->top;
+}
+
+static int region16_compare_left(const void* pva, const void* pvb)
+{
+	const REGION16_SPAN* a = pva;
+	const REGION16_SPAN* b = pvb;
+	return (int)a->left - (int)b->left;
+}
+
+/** makes room for nbItems rectangles, the allocation grows geometrically so that appending
+ * bands one after the other stays linear
+ */
+static BOOL region16_reserve(REGION16_DATA** pdata, long nbItems)
+{
+	WINPR_ASSERT(pdata);
+	REGION16_DATA* data = *pdata;
+	const size_t needed = sizeof(REGION16_DATA) + (nbItems * sizeof(RECTANGLE_16));
+
+	if (data && ((size_t)data->size >= needed))
+		return TRUE;
+
+	size_t allocSize = MAX(needed, sizeof(REGION16_DATA) + 16 * sizeof(RECTANGLE_16));
+	if (data)
+		allocSize = MAX(allocSize, 2 * (size_t)data->size);
+
+	REGION16_DATA* tmp = realloc(data, allocSize);
+	if (!tmp)
+		return FALSE;
+
+	if (!data)
+		tmp->nbRects = 0;
+	tmp->size = (long)allocSize;
+	*pdata = tmp;
+	return TRUE;
+}
+
+/** merges overlapping and touching spans, spans must be sorted by left
+ * @return the number of remaining spans
+ */
+static UINT32 region16_merge_spans(REGION16_SPAN* spans, UINT32 count)
+{
+	UINT32 used = 0;
+
+	for (UINT32 i = 0; i < count; i++)
+	{
+		if (used && (spans[i].left <= spans[used - 1].right))
+			spans[used - 1].right = MAX(spans[used - 1].right, spans[i].right);
+		else
+			spans[used++] = spans[i];
+	}
+
+	return used;
+}
+
+/** combines the items of a band with a list of spans, both sorted and not touching
+ * @return the number of spans written to dst
+ */
+static UINT32 region16_combine_spans(const RECTANGLE_16* band, UINT32 bandCount,
+                                     const REGION16_SPAN* spans, UINT32 count, REGION16_OP op,
+                                     REGION16_SPAN* dst)
+{
+	UINT32 used = 0;
+	UINT32 i = 0;
+	UINT32 j = 0;
+
+	if (op == REGION16_OP_INTERSECT)
+	{
+		while ((i < bandCount) && (j < count))
+		{
+			const UINT16 left = MAX(band[i].left, spans[j].left);
+			const UINT16 right = MIN(band[i].right, spans[j].right);
+
+			if (left < right)
+			{
+				dst[used].left = left;
+				dst[used].right = right;
+				used++;
+			}
+
+			if (band[i].right < spans[j].right)
+				i++;
+			else
+				j++;
+		}
+
+		return used;
+	}
+
+	while ((i < bandCount) || (j < count))
+	{
+		REGION16_SPAN next = { 0 };
+
+		if ((j >= count) || ((i < bandCount) && (band[i].left < spans[j].left)))
+		{
+			next.left = band[i].left;
+			next.right = band[i].right;
+			i++;
+		}
+		else
+			next = spans[j++];
+
+		if (used && (next.left <= dst[used - 1].right))
+			dst[used - 1].right = MAX(dst[used - 1].right, next.right);
+		else
+			dst[used++] = next;
+	}
+
+	return used;
+}
+
+/** appends a band of spans to the output, the band is coalesced with the previous one if they
+ * touch and have the same items
+ */
+static BOOL region16_append_band(REGION16_DATA** pdata, long* lastBand, UINT16 top,
+                                 UINT16 bottom, const REGION16_SPAN* spans, UINT32 count)
+{
+	REGION16_DATA* data = *pdata;
+	RECTANGLE_16* rects = (RECTANGLE_16*)&data[1];
+	const long previous = *lastBand;
+
+	if ((previous >= 0) && (rects[previous].bottom == top) &&
+	    ((data->nbRects - previous) == (long)count))
+	{
+		BOOL match = TRUE;
+
+		for (UINT32 i = 0; match && (i < count); i++)
+		{
+			const RECTANGLE_16* rect = &rects[previous + i];
+			match = (rect->left == spans[i].left) && (rect->right == spans[i].right);
+		}
+
+		if (match)
+		{
+			for (long i = previous; i < data->nbRects; i++)
+				rects[i].bottom = bottom;
+			return TRUE;
+		}
+	}
+
+	if (!region16_reserve(pdata, data->nbRects + count))
+		return FALSE;
+
+	data = *pdata;
+	rects = (RECTANGLE_16*)&data[1];
+	*lastBand = data->nbRects;
+
+	for (UINT32 i = 0; i < count; i++)
+	{
+		RECTANGLE_16* rect = &rects[data->nbRects++];
+		rect->left = spans[i].left;
+		rect->top = top;
+		rect->right = spans[i].right;
+		rect->bottom = bottom;
+	}
+
+	return TRUE;
+}
+
+/** combines the region src with the union of an array of rectangles
+ *
+ * The plane is swept from top to bottom, cut at every top and bottom of src and rects. In each
+ * slab the items of the src band and the spans of the rectangles crossing the slab are merged
+ * or intersected, and the resulting band is appended to the output. All rectangles are treated
+ * in a single pass and the output is produced directly in y-x-banded form.
+ */
+static BOOL region16_sweep(REGION16* dst, const REGION16* src, const RECTANGLE_16* rects,
+                           UINT32 count, REGION16_OP op)
+{
+	BOOL rc = FALSE;
+	UINT32 nbSrc = 0;
+	UINT32 nbOther = 0;
+	UINT32 nbEdges = 0;
+	UINT32 nbActive = 0;
+	long lastBand = -1;
+	REGION16_DATA* out = NULL;
+	const RECTANGLE_16* srcRects = region16_rects(src, &nbSrc);
+	const RECTANGLE_16* srcEnd = srcRects + nbSrc;
+	const RECTANGLE_16* band = srcRects;
+	const RECTANGLE_16* bandEnd = srcRects;
+
+	WINPR_ASSERT(rects || (count == 0));
+
+	RECTANGLE_16* other = calloc(count + 1, sizeof(RECTANGLE_16));
+	UINT16* edges = calloc(2ull * (nbSrc + count) + 1, sizeof(UINT16));
+	UINT32* active = calloc(count + 1, sizeof(UINT32));
+	REGION16_SPAN* spans = calloc(count + 1, sizeof(REGION16_SPAN));
+	REGION16_SPAN* result = calloc(nbSrc + count + 1, sizeof(REGION16_SPAN));
+
+	if (!other || !edges || !active || !spans || !result)
+		goto fail;
+
+	for (UINT32 i = 0; i < count; i++)
+	{
+		if (!rectangle_is_empty(&rects[i]))
+			other[nbOther++] = rects[i];
+	}
+
+	qsort(other, nbOther, sizeof(RECTANGLE_16), region16_compare_top);
+
+	for (UINT32 i = 0; i < nbSrc; i++)
+	{
+		edges[nbEdges++] = srcRects[i].top;
+		edges[nbEdges++] = srcRects[i].bottom;
+	}
+
+	for (UINT32 i = 0; i < nbOther; i++)
+	{
+		edges[nbEdges++] = other[i].top;
+		edges[nbEdges++] = other[i].bottom;
+	}
+
+	qsort(edges, nbEdges, sizeof(UINT16), region16_compare_y);
+
+	/* reuse the allocation of dst, unless it still holds the rectangles of src */
+	if ((dst != src) && (dst->data->size > 0) && (dst->data != &empty_region))
+	{
+		out = dst->data;
+		out->nbRects = 0;
+		dst->data = &empty_region;
+		ZeroMemory(&dst->extents, sizeof(dst->extents));
+	}
+
+	if (!region16_reserve(&out, nbSrc + nbOther))
+		goto fail;
+
+	for (UINT32 e = 0, next = 0; e + 1 < nbEdges; e++)
+	{
+		const UINT16 top = edges[e];
+		const UINT16 bottom = edges[e + 1];
+		UINT32 nbSpans = 0;
+		UINT32 nbResult = 0;
+
+		if (top == bottom)
+			continue;
+
+		/* the src band covering this slab, if any */
+		while (band < srcEnd)
+		{
+			while ((bandEnd < srcEnd) && (bandEnd->top == band->top))
+				bandEnd++;
+
+			if (band->bottom > top)
+				break;
+
+			band = bandEnd;
+		}
+
+		const UINT32 bandCount =
+		    ((band < srcEnd) && (band->top <= top)) ? (UINT32)(bandEnd - band) : 0;
+
+		/* update the rectangles crossing this slab */
+		while ((next < nbOther) && (other[next].top <= top))
+			active[nbActive++] = next++;
+
+		for (UINT32 i = 0; i < nbActive;)
+		{
+			if (other[active[i]].bottom <= top)
+				active[i] = active[--nbActive];
+			else
+				i++;
+		}
+
+		for (UINT32 i = 0; i < nbActive; i++)
+		{
+			spans[nbSpans].left = other[active[i]].left;
+			spans[nbSpans].right = other[active[i]].right;
+			nbSpans++;
+		}
+
+		qsort(spans, nbSpans, sizeof(REGION16_SPAN), region16_compare_left);
+		nbSpans = region16_merge_spans(spans, nbSpans);
+		nbResult = region16_combine_spans(band, bandCount, spans, nbSpans, op, result);
+
+		if (nbResult == 0)
+			continue;
+
+		if (!region16_append_band(&out, &lastBand, top, bottom, result, nbResult))
+			goto fail;
+	}
+
+	if ((dst->data->size > 0) && (dst->data != &empty_region))
+		free(dst->data);
+
+	if (out->nbRects == 0)
+	{
+		free(out);
+		dst->data = &empty_region;
+		ZeroMemory(&dst->extents, sizeof(dst->extents));
+	}
+	else
+	{
+		const RECTANGLE_16* outRects = (const RECTANGLE_16*)&out[1];
+
+		dst->data = out;
+		dst->extents = outRects[0];
+		dst->extents.bottom = outRects[out->nbRects - 1].bottom;
+
+		for (long i = 1; i < out->nbRects; i++)
+		{
+			dst->extents.left = MIN(dst->extents.left, outRects[i].left);
+			dst->extents.right = MAX(dst->extents.right, outRects[i].right);
+		}
+	}
+
+	out = NULL;
+	rc = TRUE;
+fail:
+	free(out);
+	free(result);
+	free(spans);
+	free(active);
+	free(edges);
+	free(other);
+	return rc;
+}
+
+BOOL region16_union_rects(REGION16* dst, const REGION16* src, const RECTANGLE_16* rects,
+                          UINT32 count)
+{
+	WINPR_ASSERT(dst);
+	WINPR_ASSERT(dst->data);
+	WINPR_ASSERT(src);
+	WINPR_ASSERT(src->data);
+
+	if (count == 0)
+		return region16_copy(dst, src);
+
+	if ((count == 1) && !rectangle_is_empty(rects))
+		return region16_union_rect(dst, src, rects);
+
+	return region16_sweep(dst, src, rects, count, REGION16_OP_UNION);
+}
+
+BOOL region16_intersect_rects(REGION16* dst, const REGION16* src, const RECTANGLE_16* rects,
+                              UINT32 count)
+{
+	WINPR_ASSERT(dst);
+	WINPR_ASSERT(dst->data);
+	WINPR_ASSERT(src);
+	WINPR_ASSERT(src->data);
+
+	if ((count == 0) || region16_is_empty(src))
+	{
+		region16_clear(dst);
+		return TRUE;
+	}
+
+	if (count == 1)
+		return region16_intersect_rect(dst, src, rects);
+
+	return region16_sweep(dst, src, rects, count, REGION16_OP_INTERSECT);
+}
+
 void region16_uninit(REGION16* region)
 {
 	WINPR_ASSERT(region);
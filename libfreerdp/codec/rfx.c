@@ -1287,46 +1287,56 @@ BOOL rfx_process_message(RFX_CONTEXT* WINPR_RESTRICT context, const BYTE* WINPR_
 
 	if (ok)
 	{
+		BOOL rc = FALSE;
 		UINT32 nbUpdateRects = 0;
 		REGION16 clippingRects = { 0 };
+		REGION16 updatedRegion = { 0 };
 		const RECTANGLE_16* updateRects = NULL;
 		const DWORD formatSize = FreeRDPGetBytesPerPixel(context->pixel_format);
 		const UINT32 dstWidth = dstStride / FreeRDPGetBytesPerPixel(dstFormat);
+		RECTANGLE_16* clipRects = calloc(message->numRects + 1ull, sizeof(RECTANGLE_16));
+		RECTANGLE_16* tileRects = calloc(message->numTiles + 1ull, sizeof(RECTANGLE_16));
 		region16_init(&clippingRects);
+		region16_init(&updatedRegion);
+
+		if (!clipRects || !tileRects)
+			goto fail;
 
 		WINPR_ASSERT(dstWidth <= UINT16_MAX);
 		WINPR_ASSERT(dstHeight <= UINT16_MAX);
 		for (UINT32 i = 0; i < message->numRects; i++)
 		{
-			RECTANGLE_16 clippingRect = { 0 };
+			RECTANGLE_16* clippingRect = &clipRects[i];
 			const RFX_RECT* rect = &(message->rects[i]);
 
 			WINPR_ASSERT(left + rect->x <= UINT16_MAX);
 			WINPR_ASSERT(top + rect->y <= UINT16_MAX);
-			WINPR_ASSERT(clippingRect.left + rect->width <= UINT16_MAX);
-			WINPR_ASSERT(clippingRect.top + rect->height <= UINT16_MAX);
-
-			clippingRect.left = (UINT16)MIN(left + rect->x, dstWidth);
-			clippingRect.top = (UINT16)MIN(top + rect->y, dstHeight);
-			clippingRect.right = (UINT16)MIN(clippingRect.left + rect->width, dstWidth);
-			clippingRect.bottom = (UINT16)MIN(clippingRect.top + rect->height, dstHeight);
-			region16_union_rect(&clippingRects, &clippingRects, &clippingRect);
+			WINPR_ASSERT(clippingRect->left + rect->width <= UINT16_MAX);
+			WINPR_ASSERT(clippingRect->top + rect->height <= UINT16_MAX);
+
+			clippingRect->left = (UINT16)MIN(left + rect->x, dstWidth);
+			clippingRect->top = (UINT16)MIN(top + rect->y, dstHeight);
+			clippingRect->right = (UINT16)MIN(clippingRect->left + rect->width, dstWidth);
+			clippingRect->bottom = (UINT16)MIN(clippingRect->top + rect->height, dstHeight);
 		}
 
+		if (!region16_union_rects(&clippingRects, &clippingRects, clipRects, message->numRects))
+			goto fail;
+
 		for (UINT32 i = 0; i < message->numTiles; i++)
 		{
-			RECTANGLE_16 updateRect = { 0 };
+			RECTANGLE_16* updateRect = &tileRects[i];
 			const RFX_TILE* tile = rfx_message_get_tile(message, i);
 
 			WINPR_ASSERT(left + tile->x <= UINT16_MAX);
 			WINPR_ASSERT(top + tile->y <= UINT16_MAX);
 
-			updateRect.left = (UINT16)left + tile->x;
-			updateRect.top = (UINT16)top + tile->y;
-			updateRect.right = updateRect.left + 64;
-			updateRect.bottom = updateRect.top + 64;
+			updateRect->left = (UINT16)left + tile->x;
+			updateRect->top = (UINT16)top + tile->y;
+			updateRect->right = updateRect->left + 64;
+			updateRect->bottom = updateRect->top + 64;
 			region16_init(&updateRegion);
-			region16_intersect_rect(&updateRegion, &clippingRects, &updateRect);
+			region16_intersect_rect(&updateRegion, &clippingRects, updateRect);
 			updateRects = region16_rects(&updateRegion, &nbUpdateRects);
 
 			for (UINT32 j = 0; j < nbUpdateRects; j++)
@@ -1334,8 +1344,8 @@ BOOL rfx_process_message(RFX_CONTEXT* WINPR_RESTRICT context, const BYTE* WINPR_
 				const UINT32 stride = 64 * formatSize;
 				const UINT32 nXDst = updateRects[j].left;
 				const UINT32 nYDst = updateRects[j].top;
-				const UINT32 nXSrc = nXDst - updateRect.left;
-				const UINT32 nYSrc = nYDst - updateRect.top;
+				const UINT32 nXSrc = nXDst - updateRect->left;
+				const UINT32 nYSrc = nYDst - updateRect->top;
 				const UINT32 nWidth = updateRects[j].right - updateRects[j].left;
 				const UINT32 nHeight = updateRects[j].bottom - updateRects[j].top;
 
@@ -1347,18 +1357,32 @@ BOOL rfx_process_message(RFX_CONTEXT* WINPR_RESTRICT context, const BYTE* WINPR_
 					WLog_Print(context->priv->log, WLOG_ERROR,
 					           "nbUpdateRectx[%" PRIu32 " (%" PRIu32 ")] freerdp_image_copy failed",
 					           j, nbUpdateRects);
-					return FALSE;
+					goto fail;
 				}
-
-				if (invalidRegion)
-					region16_union_rect(invalidRegion, invalidRegion, &updateRects[j]);
 			}
 
 			region16_uninit(&updateRegion);
 		}
 
+		/* the area drawn is the clipping region restricted to the tiles, add it in one go */
+		if (invalidRegion && (message->numTiles > 0))
+		{
+			if (!region16_intersect_rects(&updatedRegion, &clippingRects, tileRects,
+			                              message->numTiles))
+				goto fail;
+
+			updateRects = region16_rects(&updatedRegion, &nbUpdateRects);
+			if (!region16_union_rects(invalidRegion, invalidRegion, updateRects, nbUpdateRects))
+				goto fail;
+		}
+
+		rc = TRUE;
+	fail:
+		region16_uninit(&updatedRegion);
 		region16_uninit(&clippingRects);
-		return TRUE;
+		free(tileRects);
+		free(clipRects);
+		return rc;
 	}
 	else
 	{
@@ -1577,23 +1601,31 @@ static INLINE void CALLBACK rfx_compose_message_tile_work_callback(PTP_CALLBACK_
 static INLINE BOOL computeRegion(const RFX_RECT* WINPR_RESTRICT rects, size_t numRects,
                                  REGION16* WINPR_RESTRICT region, size_t width, size_t height)
 {
+	BOOL rc = FALSE;
 	const RECTANGLE_16 mainRect = { 0, 0, width, height };
 
 	WINPR_ASSERT(rects);
+	WINPR_ASSERT(numRects <= UINT32_MAX);
+
+	RECTANGLE_16* rects16 = calloc(numRects + 1, sizeof(RECTANGLE_16));
+	if (!rects16)
+		return FALSE;
+
 	for (size_t i = 0; i < numRects; i++)
 	{
 		const RFX_RECT* rect = &rects[i];
-		RECTANGLE_16 rect16 = { 0 };
-		rect16.left = rect->x;
-		rect16.top = rect->y;
-		rect16.right = rect->x + rect->width;
-		rect16.bottom = rect->y + rect->height;
-
-		if (!region16_union_rect(region, region, &rect16))
-			return FALSE;
+		RECTANGLE_16* rect16 = &rects16[i];
+		rect16->left = rect->x;
+		rect16->top = rect->y;
+		rect16->right = rect->x + rect->width;
+		rect16->bottom = rect->y + rect->height;
 	}
 
-	return region16_intersect_rect(region, region, &mainRect);
+	if (region16_union_rects(region, region, rects16, (UINT32)numRects))
+		rc = region16_intersect_rect(region, region, &mainRect);
+
+	free(rects16);
+	return rc;
 }
 
 #define TILE_NO(v) ((v) / 64)
@@ -1646,8 +1678,7 @@ RFX_MESSAGE* rfx_encode_message(RFX_CONTEXT* WINPR_RESTRICT context,
 	RFX_TILE_COMPOSE_WORK_PARAM* workParam = NULL;
 	BOOL success = FALSE;
 	REGION16 rectsRegion = { 0 };
-	REGION16 tilesRegion = { 0 };
-	RECTANGLE_16 currentTileRect = { 0 };
+	BYTE* tilesDone = NULL;
 	const RECTANGLE_16* regionRect = NULL;
 
 	WINPR_ASSERT(data);
@@ -1660,7 +1691,6 @@ RFX_MESSAGE* rfx_encode_message(RFX_CONTEXT* WINPR_RESTRICT context,
 	if (!(message = (RFX_MESSAGE*)winpr_aligned_calloc(1, sizeof(RFX_MESSAGE), 32)))
 		return NULL;
 
-	region16_init(&tilesRegion);
 	region16_init(&rectsRegion);
 
 	if (context->state == RFX_STATE_SEND_HEADERS)
@@ -1697,6 +1727,10 @@ RFX_MESSAGE* rfx_encode_message(RFX_CONTEXT* WINPR_RESTRICT context,
 	const UINT32 maxTilesY = 1 + TILE_NO(extents->bottom - 1) - TILE_NO(extents->top);
 	const UINT32 maxNbTiles = maxTilesX * maxTilesY;
 
+	/* the rectangles of the region may share tiles, track the tiles already taken in a grid */
+	if (!(tilesDone = calloc(maxNbTiles, sizeof(BYTE))))
+		goto skip_encoding_loop;
+
 	if (!rfx_ensure_tiles(message, maxNbTiles))
 		goto skip_encoding_loop;
 
@@ -1737,9 +1771,6 @@ RFX_MESSAGE* rfx_encode_message(RFX_CONTEXT* WINPR_RESTRICT context,
 			if ((yIdx == endTileY) && (gridRelY + 64 > height))
 				tileHeight = height - gridRelY;
 
-			currentTileRect.top = gridRelY;
-			currentTileRect.bottom = gridRelY + tileHeight;
-
 			for (UINT32 xIdx = startTileX, gridRelX = startTileX * 64; xIdx <= endTileX;
 			     xIdx++, gridRelX += 64)
 			{
@@ -1753,11 +1784,10 @@ RFX_MESSAGE* rfx_encode_message(RFX_CONTEXT* WINPR_RESTRICT context,
 				if ((xIdx == endTileX) && (gridRelX + 64 > width))
 					tileWidth = width - gridRelX;
 
-				currentTileRect.left = gridRelX;
-				currentTileRect.right = gridRelX + tileWidth;
-
 				/* checks if this tile is already treated */
-				if (region16_intersects_rect(&tilesRegion, &currentTileRect))
+				BYTE* tileDone = &tilesDone[(yIdx - TILE_NO(extents->top)) * maxTilesX + xIdx -
+				                            TILE_NO(extents->left)];
+				if (*tileDone)
 					continue;
 
 				RFX_TILE* tile = (RFX_TILE*)ObjectPool_Take(context->priv->TilePool);
@@ -1820,8 +1850,7 @@ RFX_MESSAGE* rfx_encode_message(RFX_CONTEXT* WINPR_RESTRICT context,
 					rfx_encode_rgb(context, tile);
 				}
 
-				if (!region16_union_rect(&tilesRegion, &tilesRegion, &currentTileRect))
-					goto skip_encoding_loop;
+				*tileDone = 1;
 			} /* xIdx */
 		}     /* yIdx */
 	}         /* rects */
@@ -1852,7 +1881,7 @@ skip_encoding_loop:
 			message->tilesDataSize += rfx_tile_length(tile);
 		}
 
-		region16_uninit(&tilesRegion);
+		free(tilesDone);
 		region16_uninit(&rectsRegion);
 
 		return message;
@@ -1860,6 +1889,8 @@ skip_encoding_loop:
 
 	WLog_Print(context->priv->log, WLOG_ERROR, "failed");
 
+	free(tilesDone);
+	region16_uninit(&rectsRegion);
 	rfx_message_free(context, message);
 	return NULL;
 }
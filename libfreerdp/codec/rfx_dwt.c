@@ -208,3 +208,97 @@ void rfx_dwt_2d_encode(INT16* WINPR_RESTRICT buffer, INT16* WINPR_RESTRICT dwt_b
 	rfx_dwt_2d_encode_block(&buffer[3072], dwt_buffer, 16);
 	rfx_dwt_2d_encode_block(&buffer[3840], dwt_buffer, 8);
 }
+
+static INLINE size_t rfx_dwt_extrapolate_band_l_count(size_t level)
+{
+	return (64 >> level) + 1;
+}
+
+static INLINE size_t rfx_dwt_extrapolate_band_h_count(size_t level)
+{
+	if (level == 1)
+		return (64 >> 1) - 1;
+	else
+		return (64 + (1 << (level - 1))) >> level;
+}
+
+/**
+ * Forward lifting step matching progressive_rfx_idwt_x/progressive_rfx_idwt_y.
+ * Lines of odd length keep one more low band sample, 64 sample lines extrapolate
+ * a second one.
+ */
+static INLINE void rfx_dwt_extrapolate_encode_line(const INT16* WINPR_RESTRICT pSrc,
+                                                   size_t nSrcStep, INT16* WINPR_RESTRICT pLow,
+                                                   size_t nLowStep, INT16* WINPR_RESTRICT pHigh,
+                                                   size_t nHighStep, size_t nLowCount,
+                                                   size_t nHighCount)
+{
+	for (size_t j = 0; j < nHighCount; j++)
+	{
+		const INT32 x0 = pSrc[(2 * j) * nSrcStep];
+		const INT32 x1 = pSrc[(2 * j + 1) * nSrcStep];
+		const INT32 x2 = pSrc[(2 * j + 2) * nSrcStep];
+		pHigh[j * nHighStep] = (INT16)((x1 - ((x0 + x2) / 2)) / 2);
+	}
+
+	pLow[0] = (INT16)(pSrc[0] + pHigh[0]);
+
+	for (size_t j = 1; j < nHighCount; j++)
+	{
+		const INT32 h0 = pHigh[(j - 1) * nHighStep];
+		const INT32 h1 = pHigh[j * nHighStep];
+		pLow[j * nLowStep] = (INT16)(pSrc[(2 * j) * nSrcStep] + ((h0 + h1) / 2));
+	}
+
+	const INT32 hn = pHigh[(nHighCount - 1) * nHighStep];
+	const INT32 xn = pSrc[(2 * nHighCount) * nSrcStep];
+
+	if (nLowCount <= (nHighCount + 1))
+	{
+		pLow[nHighCount * nLowStep] = (INT16)(xn + hn);
+	}
+	else
+	{
+		const INT32 xl = pSrc[(2 * nHighCount + 1) * nSrcStep];
+		pLow[nHighCount * nLowStep] = (INT16)(xn + (hn / 2));
+		pLow[(nHighCount + 1) * nLowStep] = (INT16)((2 * xl) - xn);
+	}
+}
+
+static INLINE void rfx_dwt_2d_extrapolate_encode_block(INT16* WINPR_RESTRICT buffer,
+                                                       INT16* WINPR_RESTRICT temp, size_t level)
+{
+	const size_t nBandL = rfx_dwt_extrapolate_band_l_count(level);
+	const size_t nBandH = rfx_dwt_extrapolate_band_h_count(level);
+	const size_t nTotal = nBandL + nBandH;
+	INT16* L = &temp[0];
+	INT16* H = &temp[nBandL * nTotal];
+	INT16* HL = &buffer[0];
+	INT16* LH = &HL[nBandH * nBandL];
+	INT16* HH = &LH[nBandL * nBandH];
+	INT16* LL = &HH[nBandH * nBandH];
+
+	/* vertical (LLx -> L + H) */
+	for (size_t x = 0; x < nTotal; x++)
+		rfx_dwt_extrapolate_encode_line(&buffer[x], nTotal, &L[x], nTotal, &H[x], nTotal, nBandL,
+		                                nBandH);
+
+	/* horizontal (L -> LL + HL) */
+	for (size_t y = 0; y < nBandL; y++)
+		rfx_dwt_extrapolate_encode_line(&L[y * nTotal], 1, &LL[y * nBandL], 1, &HL[y * nBandH], 1,
+		                                nBandL, nBandH);
+
+	/* horizontal (H -> LH + HH) */
+	for (size_t y = 0; y < nBandH; y++)
+		rfx_dwt_extrapolate_encode_line(&H[y * nTotal], 1, &LH[y * nBandL], 1, &HH[y * nBandH], 1,
+		                                nBandL, nBandH);
+}
+
+void rfx_dwt_2d_extrapolate_encode(INT16* WINPR_RESTRICT buffer, INT16* WINPR_RESTRICT temp)
+{
+	WINPR_ASSERT(buffer);
+	WINPR_ASSERT(temp);
+	rfx_dwt_2d_extrapolate_encode_block(&buffer[0], temp, 1);
+	rfx_dwt_2d_extrapolate_encode_block(&buffer[3007], temp, 2);
+	rfx_dwt_2d_extrapolate_encode_block(&buffer[3807], temp, 3);
+}
@@ -23,6 +23,16 @@
 #include <freerdp/codec/rfx.h>
 #include <freerdp/api.h>
 
+/** @brief split a tile of up to 64x64 pixels into 64x64 R, G and B planes
+ *
+ *  Rows and columns beyond \b width and \b height repeat the last pixel.
+ */
+FREERDP_LOCAL void rfx_encode_format_rgb(const BYTE* WINPR_RESTRICT rgb_data, int width, int height,
+                                         int rowstride, UINT32 pixel_format,
+                                         const BYTE* WINPR_RESTRICT palette,
+                                         INT16* WINPR_RESTRICT r_buf, INT16* WINPR_RESTRICT g_buf,
+                                         INT16* WINPR_RESTRICT b_buf);
+
 FREERDP_LOCAL void rfx_encode_rgb(RFX_CONTEXT* WINPR_RESTRICT context,
                                   RFX_TILE* WINPR_RESTRICT tile);
 
@@ -0,0 +1,99 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Interleaved RLE Run Detection - SSE2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/crt.h>
+#include <winpr/sysinfo.h>
+
+#include "bitmap_sse2.h"
+
+#if defined(WITH_SSE2)
+#include <emmintrin.h>
+
+static INLINE __m128i broadcast_pixel(const BYTE* WINPR_RESTRICT pixel, size_t pixelSize)
+{
+	if (pixelSize == 2)
+	{
+		UINT16 value = 0;
+		memcpy(&value, pixel, sizeof(value));
+		return _mm_set1_epi16((short)value);
+	}
+
+	UINT32 value = 0;
+	memcpy(&value, pixel, sizeof(value));
+	return _mm_set1_epi32((int)value);
+}
+
+/* Both pixel sizes divide 16, so whole pixels are compared byte by byte */
+static INLINE BOOL equal_32(const BYTE* WINPR_RESTRICT data, __m128i value)
+{
+	const __m128i lo = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)data), value);
+	const __m128i hi = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)&data[16]), value);
+	return _mm_movemask_epi8(_mm_and_si128(lo, hi)) == 0xFFFF;
+}
+
+static size_t bitmap_rle_span_sse2(const BYTE* WINPR_RESTRICT line,
+                                   const BYTE* WINPR_RESTRICT above, size_t count,
+                                   size_t pixelSize)
+{
+	const size_t length = count * pixelSize;
+	const __m128i value = broadcast_pixel(line, pixelSize);
+	size_t x = pixelSize;
+
+	if (above)
+	{
+		const __m128i valueAbove = broadcast_pixel(above, pixelSize);
+
+		for (; x + 32 <= length; x += 32)
+		{
+			if (!equal_32(&line[x], value) || !equal_32(&above[x], valueAbove))
+				break;
+		}
+	}
+	else
+	{
+		for (; x + 32 <= length; x += 32)
+		{
+			if (!equal_32(&line[x], value))
+				break;
+		}
+	}
+
+	for (; x < length; x += pixelSize)
+	{
+		if (memcmp(&line[x], line, pixelSize) != 0)
+			break;
+		if (above && (memcmp(&above[x], above, pixelSize) != 0))
+			break;
+	}
+
+	return x / pixelSize - 1;
+}
+#endif
+
+void bitmap_rle_init_sse2(BITMAP_RLE_KERNELS* kernels)
+{
+#if defined(WITH_SSE2)
+	if (!IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE))
+		return;
+
+	kernels->span = bitmap_rle_span_sse2;
+#else
+	WINPR_UNUSED(kernels);
+#endif
+}
@@ -0,0 +1,57 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Digital Sound Processing - AVX2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/sysinfo.h>
+
+#include "dsp_avx2.h"
+
+#if defined(WITH_SSE2) && defined(__AVX2__)
+#include <immintrin.h>
+
+static INT32 dsp_resample_dot_avx2(const INT16* WINPR_RESTRICT coeffs,
+                                   const INT16* WINPR_RESTRICT samples, size_t count)
+{
+	__m256i acc = _mm256_setzero_si256();
+
+	for (size_t x = 0; x < count; x += 16)
+	{
+		const __m256i c = _mm256_loadu_si256((const __m256i*)&coeffs[x]);
+		const __m256i s = _mm256_loadu_si256((const __m256i*)&samples[x]);
+		acc = _mm256_add_epi32(acc, _mm256_madd_epi16(c, s));
+	}
+
+	__m128i sum =
+	    _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(sum);
+}
+#endif
+
+void dsp_resample_init_avx2(DSP_RESAMPLE_KERNELS* kernels)
+{
+#if defined(WITH_SSE2) && defined(__AVX2__)
+	if (!IsProcessorFeaturePresent(PF_AVX2_INSTRUCTIONS_AVAILABLE))
+		return;
+
+	kernels->dot = dsp_resample_dot_avx2;
+#else
+	WINPR_UNUSED(kernels);
+#endif
+}
@@ -0,0 +1,60 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Digital Sound Processing - SSE2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/sysinfo.h>
+
+#include "dsp_sse2.h"
+
+#if defined(WITH_SSE2)
+#include <emmintrin.h>
+
+static INT32 dsp_resample_dot_sse2(const INT16* WINPR_RESTRICT coeffs,
+                                   const INT16* WINPR_RESTRICT samples, size_t count)
+{
+	__m128i acc0 = _mm_setzero_si128();
+	__m128i acc1 = _mm_setzero_si128();
+
+	for (size_t x = 0; x < count; x += 16)
+	{
+		const __m128i c0 = _mm_loadu_si128((const __m128i*)&coeffs[x]);
+		const __m128i c1 = _mm_loadu_si128((const __m128i*)&coeffs[x + 8]);
+		const __m128i s0 = _mm_loadu_si128((const __m128i*)&samples[x]);
+		const __m128i s1 = _mm_loadu_si128((const __m128i*)&samples[x + 8]);
+		acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(c0, s0));
+		acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(c1, s1));
+	}
+
+	__m128i acc = _mm_add_epi32(acc0, acc1);
+	acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+	acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(acc);
+}
+#endif
+
+void dsp_resample_init_sse2(DSP_RESAMPLE_KERNELS* kernels)
+{
+#if defined(WITH_SSE2)
+	if (!IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE))
+		return;
+
+	kernels->dot = dsp_resample_dot_sse2;
+#else
+	WINPR_UNUSED(kernels);
+#endif
+}
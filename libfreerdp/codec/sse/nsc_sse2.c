@@ -37,346 +37,305 @@
 #include <winpr/crt.h>
 #include <winpr/sysinfo.h>
 
-static BOOL nsc_encode_argb_to_aycocg_sse2(NSC_CONTEXT* context, const BYTE* data, UINT32 scanline)
+/* Reads pixel x of a source row as B, G, R, A like the generic encoder does */
+static void nsc_read_pixel(const NSC_CONTEXT* WINPR_RESTRICT context,
+                           const BYTE* WINPR_RESTRICT row, UINT32 x, BYTE* WINPR_RESTRICT pixel)
 {
-	UINT16 y = 0;
-	UINT16 rw = 0;
-	BYTE ccl = 0;
 	const BYTE* src = NULL;
-	BYTE* yplane = NULL;
-	BYTE* coplane = NULL;
-	BYTE* cgplane = NULL;
-	BYTE* aplane = NULL;
-	__m128i r_val;
-	__m128i g_val;
-	__m128i b_val;
-	__m128i a_val;
-	__m128i y_val;
-	__m128i co_val;
-	__m128i cg_val;
-	UINT32 tempWidth = 0;
+	BYTE r = 0;
+	BYTE g = 0;
+	BYTE b = 0;
+	BYTE a = 0xFF;
 
-	if (!context || !data || (scanline == 0))
-		return FALSE;
-
-	tempWidth = ROUND_UP_TO(context->width, 8);
-	rw = (context->ChromaSubsamplingLevel > 0 ? tempWidth : context->width);
-	ccl = context->ColorLossLevel;
-
-	for (; y < context->height; y++)
+	switch (context->format)
 	{
-		src = data + (context->height - 1 - y) * scanline;
-		yplane = context->priv->PlaneBuffers[0] + y * rw;
-		coplane = context->priv->PlaneBuffers[1] + y * rw;
-		cgplane = context->priv->PlaneBuffers[2] + y * rw;
-		aplane = context->priv->PlaneBuffers[3] + y * context->width;
-
-		for (UINT16 x = 0; x < context->width; x += 8)
-		{
-			switch (context->format)
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			src = &row[4ull * x];
+			b = src[0];
+			g = src[1];
+			r = src[2];
+			if (context->format == PIXEL_FORMAT_BGRA32)
+				a = src[3];
+			break;
+
+		case PIXEL_FORMAT_RGBX32:
+		case PIXEL_FORMAT_RGBA32:
+			src = &row[4ull * x];
+			r = src[0];
+			g = src[1];
+			b = src[2];
+			if (context->format == PIXEL_FORMAT_RGBA32)
+				a = src[3];
+			break;
+
+		case PIXEL_FORMAT_BGR24:
+			src = &row[3ull * x];
+			b = src[0];
+			g = src[1];
+			r = src[2];
+			break;
+
+		case PIXEL_FORMAT_RGB24:
+			src = &row[3ull * x];
+			r = src[0];
+			g = src[1];
+			b = src[2];
+			break;
+
+		case PIXEL_FORMAT_BGR16:
+		case PIXEL_FORMAT_RGB16:
+			src = &row[2ull * x];
+			b = (BYTE)((src[1] & 0xF8) | (src[1] >> 5));
+			g = (BYTE)(((src[1] & 0x07) << 5) | ((src[0] & 0xE0) >> 3));
+			r = (BYTE)(((src[0] & 0x1F) << 3) | ((src[0] >> 2) & 0x07));
+			if (context->format == PIXEL_FORMAT_RGB16)
 			{
-				case PIXEL_FORMAT_BGRX32:
-					b_val = _mm_set_epi16(*(src + 28), *(src + 24), *(src + 20), *(src + 16),
-					                      *(src + 12), *(src + 8), *(src + 4), *src);
-					g_val = _mm_set_epi16(*(src + 29), *(src + 25), *(src + 21), *(src + 17),
-					                      *(src + 13), *(src + 9), *(src + 5), *(src + 1));
-					r_val = _mm_set_epi16(*(src + 30), *(src + 26), *(src + 22), *(src + 18),
-					                      *(src + 14), *(src + 10), *(src + 6), *(src + 2));
-					a_val = _mm_set1_epi16(0xFF);
-					src += 32;
-					break;
-
-				case PIXEL_FORMAT_BGRA32:
-					b_val = _mm_set_epi16(*(src + 28), *(src + 24), *(src + 20), *(src + 16),
-					                      *(src + 12), *(src + 8), *(src + 4), *src);
-					g_val = _mm_set_epi16(*(src + 29), *(src + 25), *(src + 21), *(src + 17),
-					                      *(src + 13), *(src + 9), *(src + 5), *(src + 1));
-					r_val = _mm_set_epi16(*(src + 30), *(src + 26), *(src + 22), *(src + 18),
-					                      *(src + 14), *(src + 10), *(src + 6), *(src + 2));
-					a_val = _mm_set_epi16(*(src + 31), *(src + 27), *(src + 23), *(src + 19),
-					                      *(src + 15), *(src + 11), *(src + 7), *(src + 3));
-					src += 32;
-					break;
-
-				case PIXEL_FORMAT_RGBX32:
-					r_val = _mm_set_epi16(*(src + 28), *(src + 24), *(src + 20), *(src + 16),
-					                      *(src + 12), *(src + 8), *(src + 4), *src);
-					g_val = _mm_set_epi16(*(src + 29), *(src + 25), *(src + 21), *(src + 17),
-					                      *(src + 13), *(src + 9), *(src + 5), *(src + 1));
-					b_val = _mm_set_epi16(*(src + 30), *(src + 26), *(src + 22), *(src + 18),
-					                      *(src + 14), *(src + 10), *(src + 6), *(src + 2));
-					a_val = _mm_set1_epi16(0xFF);
-					src += 32;
-					break;
-
-				case PIXEL_FORMAT_RGBA32:
-					r_val = _mm_set_epi16(*(src + 28), *(src + 24), *(src + 20), *(src + 16),
-					                      *(src + 12), *(src + 8), *(src + 4), *src);
-					g_val = _mm_set_epi16(*(src + 29), *(src + 25), *(src + 21), *(src + 17),
-					                      *(src + 13), *(src + 9), *(src + 5), *(src + 1));
-					b_val = _mm_set_epi16(*(src + 30), *(src + 26), *(src + 22), *(src + 18),
-					                      *(src + 14), *(src + 10), *(src + 6), *(src + 2));
-					a_val = _mm_set_epi16(*(src + 31), *(src + 27), *(src + 23), *(src + 19),
-					                      *(src + 15), *(src + 11), *(src + 7), *(src + 3));
-					src += 32;
-					break;
-
-				case PIXEL_FORMAT_BGR24:
-					b_val = _mm_set_epi16(*(src + 21), *(src + 18), *(src + 15), *(src + 12),
-					                      *(src + 9), *(src + 6), *(src + 3), *src);
-					g_val = _mm_set_epi16(*(src + 22), *(src + 19), *(src + 16), *(src + 13),
-					                      *(src + 10), *(src + 7), *(src + 4), *(src + 1));
-					r_val = _mm_set_epi16(*(src + 23), *(src + 20), *(src + 17), *(src + 14),
-					                      *(src + 11), *(src + 8), *(src + 5), *(src + 2));
-					a_val = _mm_set1_epi16(0xFF);
-					src += 24;
-					break;
-
-				case PIXEL_FORMAT_RGB24:
-					r_val = _mm_set_epi16(*(src + 21), *(src + 18), *(src + 15), *(src + 12),
-					                      *(src + 9), *(src + 6), *(src + 3), *src);
-					g_val = _mm_set_epi16(*(src + 22), *(src + 19), *(src + 16), *(src + 13),
-					                      *(src + 10), *(src + 7), *(src + 4), *(src + 1));
-					b_val = _mm_set_epi16(*(src + 23), *(src + 20), *(src + 17), *(src + 14),
-					                      *(src + 11), *(src + 8), *(src + 5), *(src + 2));
-					a_val = _mm_set1_epi16(0xFF);
-					src += 24;
-					break;
-
-				case PIXEL_FORMAT_BGR16:
-					b_val = _mm_set_epi16((((*(src + 15)) & 0xF8) | ((*(src + 15)) >> 5)),
-					                      (((*(src + 13)) & 0xF8) | ((*(src + 13)) >> 5)),
-					                      (((*(src + 11)) & 0xF8) | ((*(src + 11)) >> 5)),
-					                      (((*(src + 9)) & 0xF8) | ((*(src + 9)) >> 5)),
-					                      (((*(src + 7)) & 0xF8) | ((*(src + 7)) >> 5)),
-					                      (((*(src + 5)) & 0xF8) | ((*(src + 5)) >> 5)),
-					                      (((*(src + 3)) & 0xF8) | ((*(src + 3)) >> 5)),
-					                      (((*(src + 1)) & 0xF8) | ((*(src + 1)) >> 5)));
-					g_val = _mm_set_epi16(
-					    ((((*(src + 15)) & 0x07) << 5) | (((*(src + 14)) & 0xE0) >> 3)),
-					    ((((*(src + 13)) & 0x07) << 5) | (((*(src + 12)) & 0xE0) >> 3)),
-					    ((((*(src + 11)) & 0x07) << 5) | (((*(src + 10)) & 0xE0) >> 3)),
-					    ((((*(src + 9)) & 0x07) << 5) | (((*(src + 8)) & 0xE0) >> 3)),
-					    ((((*(src + 7)) & 0x07) << 5) | (((*(src + 6)) & 0xE0) >> 3)),
-					    ((((*(src + 5)) & 0x07) << 5) | (((*(src + 4)) & 0xE0) >> 3)),
-					    ((((*(src + 3)) & 0x07) << 5) | (((*(src + 2)) & 0xE0) >> 3)),
-					    ((((*(src + 1)) & 0x07) << 5) | (((*src) & 0xE0) >> 3)));
-					r_val = _mm_set_epi16(
-					    ((((*(src + 14)) & 0x1F) << 3) | (((*(src + 14)) >> 2) & 0x07)),
-					    ((((*(src + 12)) & 0x1F) << 3) | (((*(src + 12)) >> 2) & 0x07)),
-					    ((((*(src + 10)) & 0x1F) << 3) | (((*(src + 10)) >> 2) & 0x07)),
-					    ((((*(src + 8)) & 0x1F) << 3) | (((*(src + 8)) >> 2) & 0x07)),
-					    ((((*(src + 6)) & 0x1F) << 3) | (((*(src + 6)) >> 2) & 0x07)),
-					    ((((*(src + 4)) & 0x1F) << 3) | (((*(src + 4)) >> 2) & 0x07)),
-					    ((((*(src + 2)) & 0x1F) << 3) | (((*(src + 2)) >> 2) & 0x07)),
-					    ((((*src) & 0x1F) << 3) | (((*src) >> 2) & 0x07)));
-					a_val = _mm_set1_epi16(0xFF);
-					src += 16;
-					break;
-
-				case PIXEL_FORMAT_RGB16:
-					r_val = _mm_set_epi16((((*(src + 15)) & 0xF8) | ((*(src + 15)) >> 5)),
-					                      (((*(src + 13)) & 0xF8) | ((*(src + 13)) >> 5)),
-					                      (((*(src + 11)) & 0xF8) | ((*(src + 11)) >> 5)),
-					                      (((*(src + 9)) & 0xF8) | ((*(src + 9)) >> 5)),
-					                      (((*(src + 7)) & 0xF8) | ((*(src + 7)) >> 5)),
-					                      (((*(src + 5)) & 0xF8) | ((*(src + 5)) >> 5)),
-					                      (((*(src + 3)) & 0xF8) | ((*(src + 3)) >> 5)),
-					                      (((*(src + 1)) & 0xF8) | ((*(src + 1)) >> 5)));
-					g_val = _mm_set_epi16(
-					    ((((*(src + 15)) & 0x07) << 5) | (((*(src + 14)) & 0xE0) >> 3)),
-					    ((((*(src + 13)) & 0x07) << 5) | (((*(src + 12)) & 0xE0) >> 3)),
-					    ((((*(src + 11)) & 0x07) << 5) | (((*(src + 10)) & 0xE0) >> 3)),
-					    ((((*(src + 9)) & 0x07) << 5) | (((*(src + 8)) & 0xE0) >> 3)),
-					    ((((*(src + 7)) & 0x07) << 5) | (((*(src + 6)) & 0xE0) >> 3)),
-					    ((((*(src + 5)) & 0x07) << 5) | (((*(src + 4)) & 0xE0) >> 3)),
-					    ((((*(src + 3)) & 0x07) << 5) | (((*(src + 2)) & 0xE0) >> 3)),
-					    ((((*(src + 1)) & 0x07) << 5) | (((*src) & 0xE0) >> 3)));
-					b_val = _mm_set_epi16(
-					    ((((*(src + 14)) & 0x1F) << 3) | (((*(src + 14)) >> 2) & 0x07)),
-					    ((((*(src + 12)) & 0x1F) << 3) | (((*(src + 12)) >> 2) & 0x07)),
-					    ((((*(src + 10)) & 0x1F) << 3) | (((*(src + 10)) >> 2) & 0x07)),
-					    ((((*(src + 8)) & 0x1F) << 3) | (((*(src + 8)) >> 2) & 0x07)),
-					    ((((*(src + 6)) & 0x1F) << 3) | (((*(src + 6)) >> 2) & 0x07)),
-					    ((((*(src + 4)) & 0x1F) << 3) | (((*(src + 4)) >> 2) & 0x07)),
-					    ((((*(src + 2)) & 0x1F) << 3) | (((*(src + 2)) >> 2) & 0x07)),
-					    ((((*src) & 0x1F) << 3) | (((*src) >> 2) & 0x07)));
-					a_val = _mm_set1_epi16(0xFF);
-					src += 16;
-					break;
-
-				case PIXEL_FORMAT_A4:
-				{
-					BYTE idx[8] = { 0 };
-
-					for (int shift = 7; shift >= 0; shift--)
-					{
-						idx[shift] = ((*src) >> shift) & 1;
-						idx[shift] |= (((*(src + 1)) >> shift) & 1) << 1;
-						idx[shift] |= (((*(src + 2)) >> shift) & 1) << 2;
-						idx[shift] |= (((*(src + 3)) >> shift) & 1) << 3;
-						idx[shift] *= 3;
-					}
-
-					r_val = _mm_set_epi16(context->palette[idx[0]], context->palette[idx[1]],
-					                      context->palette[idx[2]], context->palette[idx[3]],
-					                      context->palette[idx[4]], context->palette[idx[5]],
-					                      context->palette[idx[6]], context->palette[idx[7]]);
-					g_val =
-					    _mm_set_epi16(context->palette[idx[0] + 1], context->palette[idx[1] + 1],
-					                  context->palette[idx[2] + 1], context->palette[idx[3] + 1],
-					                  context->palette[idx[4] + 1], context->palette[idx[5] + 1],
-					                  context->palette[idx[6] + 1], context->palette[idx[7] + 1]);
-					b_val =
-					    _mm_set_epi16(context->palette[idx[0] + 2], context->palette[idx[1] + 2],
-					                  context->palette[idx[2] + 2], context->palette[idx[3] + 2],
-					                  context->palette[idx[4] + 2], context->palette[idx[5] + 2],
-					                  context->palette[idx[6] + 2], context->palette[idx[7] + 2]);
-					src += 4;
-				}
-
-					a_val = _mm_set1_epi16(0xFF);
-					break;
-
-				case PIXEL_FORMAT_RGB8:
-				{
-					r_val = _mm_set_epi16(
-					    context->palette[(*(src + 7)) * 3], context->palette[(*(src + 6)) * 3],
-					    context->palette[(*(src + 5)) * 3], context->palette[(*(src + 4)) * 3],
-					    context->palette[(*(src + 3)) * 3], context->palette[(*(src + 2)) * 3],
-					    context->palette[(*(src + 1)) * 3], context->palette[(*src) * 3]);
-					g_val = _mm_set_epi16(context->palette[(*(src + 7)) * 3 + 1],
-					                      context->palette[(*(src + 6)) * 3 + 1],
-					                      context->palette[(*(src + 5)) * 3 + 1],
-					                      context->palette[(*(src + 4)) * 3 + 1],
-					                      context->palette[(*(src + 3)) * 3 + 1],
-					                      context->palette[(*(src + 2)) * 3 + 1],
-					                      context->palette[(*(src + 1)) * 3 + 1],
-					                      context->palette[(*src) * 3 + 1]);
-					b_val = _mm_set_epi16(context->palette[(*(src + 7)) * 3 + 2],
-					                      context->palette[(*(src + 6)) * 3 + 2],
-					                      context->palette[(*(src + 5)) * 3 + 2],
-					                      context->palette[(*(src + 4)) * 3 + 2],
-					                      context->palette[(*(src + 3)) * 3 + 2],
-					                      context->palette[(*(src + 2)) * 3 + 2],
-					                      context->palette[(*(src + 1)) * 3 + 2],
-					                      context->palette[(*src) * 3 + 2]);
-					src += 8;
-				}
-
-					a_val = _mm_set1_epi16(0xFF);
-					break;
-
-				default:
-					r_val = g_val = b_val = a_val = _mm_set1_epi16(0);
-					break;
+				const BYTE t = r;
+				r = b;
+				b = t;
 			}
+			break;
 
-			y_val = _mm_srai_epi16(r_val, 2);
-			y_val = _mm_add_epi16(y_val, _mm_srai_epi16(g_val, 1));
-			y_val = _mm_add_epi16(y_val, _mm_srai_epi16(b_val, 2));
-			co_val = _mm_sub_epi16(r_val, b_val);
-			co_val = _mm_srai_epi16(co_val, ccl);
-			cg_val = _mm_sub_epi16(g_val, _mm_srai_epi16(r_val, 1));
-			cg_val = _mm_sub_epi16(cg_val, _mm_srai_epi16(b_val, 1));
-			cg_val = _mm_srai_epi16(cg_val, ccl);
-			y_val = _mm_packus_epi16(y_val, y_val);
-			_mm_storeu_si128((__m128i*)yplane, y_val);
-			co_val = _mm_packs_epi16(co_val, co_val);
-			_mm_storeu_si128((__m128i*)coplane, co_val);
-			cg_val = _mm_packs_epi16(cg_val, cg_val);
-			_mm_storeu_si128((__m128i*)cgplane, cg_val);
-			a_val = _mm_packus_epi16(a_val, a_val);
-			_mm_storeu_si128((__m128i*)aplane, a_val);
-			yplane += 8;
-			coplane += 8;
-			cgplane += 8;
-			aplane += 8;
+		case PIXEL_FORMAT_A4:
+		{
+			const int shift = 7 - (x % 8);
+			src = &row[4ull * (x / 8)];
+			BYTE idx = (src[0] >> shift) & 1;
+			idx |= ((src[1] >> shift) & 1) << 1;
+			idx |= ((src[2] >> shift) & 1) << 2;
+			idx |= ((src[3] >> shift) & 1) << 3;
+			r = context->palette[3 * idx];
+			g = context->palette[3 * idx + 1];
+			b = context->palette[3 * idx + 2];
 		}
+		break;
 
-		if (context->ChromaSubsamplingLevel > 0 && (context->width % 2) == 1)
+		case PIXEL_FORMAT_RGB8:
 		{
-			context->priv->PlaneBuffers[0][y * rw + context->width] =
-			    context->priv->PlaneBuffers[0][y * rw + context->width - 1];
-			context->priv->PlaneBuffers[1][y * rw + context->width] =
-			    context->priv->PlaneBuffers[1][y * rw + context->width - 1];
-			context->priv->PlaneBuffers[2][y * rw + context->width] =
-			    context->priv->PlaneBuffers[2][y * rw + context->width - 1];
+			const size_t idx = 3ull * row[x];
+			r = context->palette[idx];
+			g = context->palette[idx + 1];
+			b = context->palette[idx + 2];
 		}
+		break;
+
+		default:
+			a = 0;
+			break;
 	}
 
-	if (context->ChromaSubsamplingLevel > 0 && (y % 2) == 1)
+	pixel[0] = b;
+	pixel[1] = g;
+	pixel[2] = r;
+	pixel[3] = a;
+}
+
+/* Splits 8 32bpp pixels into 16 bit channels, rgb swaps the first and third byte */
+static INLINE void nsc_unpack_32(const BYTE* WINPR_RESTRICT src, BOOL rgb, BOOL alpha,
+                                 __m128i* r, __m128i* g, __m128i* b, __m128i* a)
+{
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	const __m128i lo = _mm_loadu_si128((const __m128i*)src);
+	const __m128i hi = _mm_loadu_si128((const __m128i*)&src[16]);
+	const __m128i c0 = _mm_packs_epi32(_mm_and_si128(lo, mask), _mm_and_si128(hi, mask));
+	const __m128i c2 = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(lo, 16), mask),
+	                                   _mm_and_si128(_mm_srli_epi32(hi, 16), mask));
+
+	*g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(lo, 8), mask),
+	                     _mm_and_si128(_mm_srli_epi32(hi, 8), mask));
+	*r = rgb ? c0 : c2;
+	*b = rgb ? c2 : c0;
+
+	if (alpha)
+		*a = _mm_packs_epi32(_mm_srli_epi32(lo, 24), _mm_srli_epi32(hi, 24));
+	else
+		*a = _mm_set1_epi16(0xFF);
+}
+
+/**
+ * Converts 8 pixels starting at x of a source row. Pixels past the width repeat the last
+ * one, so a partial block never reads beyond the row.
+ */
+static INLINE void nsc_load_block(const NSC_CONTEXT* WINPR_RESTRICT context,
+                                  const BYTE* WINPR_RESTRICT row, UINT32 x, UINT32 count,
+                                  __m128i ccl, __m128i* y, __m128i* co, __m128i* cg, __m128i* a)
+{
+	BYTE pixels[32] = { 0 };
+	const BYTE* src = pixels;
+	BOOL rgb = FALSE;
+	BOOL alpha = TRUE;
+	__m128i r;
+	__m128i g;
+	__m128i b;
+
+	switch (context->format)
 	{
-		yplane = context->priv->PlaneBuffers[0] + y * rw;
-		coplane = context->priv->PlaneBuffers[1] + y * rw;
-		cgplane = context->priv->PlaneBuffers[2] + y * rw;
-		CopyMemory(yplane, yplane - rw, rw);
-		CopyMemory(coplane, coplane - rw, rw);
-		CopyMemory(cgplane, cgplane - rw, rw);
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+		case PIXEL_FORMAT_RGBX32:
+		case PIXEL_FORMAT_RGBA32:
+			rgb = (context->format == PIXEL_FORMAT_RGBX32) ||
+			      (context->format == PIXEL_FORMAT_RGBA32);
+			alpha = (context->format == PIXEL_FORMAT_BGRA32) ||
+			        (context->format == PIXEL_FORMAT_RGBA32);
+			if (count == 8)
+			{
+				src = &row[4ull * x];
+				break;
+			}
+
+			memcpy(pixels, &row[4ull * x], 4ull * count);
+			break;
+
+		default:
+			for (UINT32 i = 0; i < count; i++)
+				nsc_read_pixel(context, row, x + i, &pixels[4ull * i]);
+			break;
 	}
 
-	return TRUE;
+	for (UINT32 i = count; i < 8; i++)
+		memcpy(&pixels[4ull * i], &pixels[4ull * (count - 1)], 4);
+
+	nsc_unpack_32(src, rgb, alpha, &r, &g, &b, a);
+	*y = _mm_add_epi16(_mm_srai_epi16(r, 2), _mm_srai_epi16(g, 1));
+	*y = _mm_add_epi16(*y, _mm_srai_epi16(b, 2));
+	*co = _mm_sra_epi16(_mm_sub_epi16(r, b), ccl);
+	*cg = _mm_sub_epi16(_mm_sub_epi16(g, _mm_srai_epi16(r, 1)), _mm_srai_epi16(b, 1));
+	*cg = _mm_sra_epi16(*cg, ccl);
+	/* The generic encoder stores the chroma as bytes, keep the same wrap around */
+	*co = _mm_srai_epi16(_mm_slli_epi16(*co, 8), 8);
+	*cg = _mm_srai_epi16(_mm_slli_epi16(*cg, 8), 8);
 }
 
-static void nsc_encode_subsampling_sse2(NSC_CONTEXT* context)
+/* Stores the low count bytes of v, count is at most 8 */
+static INLINE void nsc_store(BYTE* WINPR_RESTRICT dst, __m128i v, UINT32 count)
 {
-	BYTE* co_dst = NULL;
-	BYTE* cg_dst = NULL;
-	INT8* co_src0 = NULL;
-	INT8* co_src1 = NULL;
-	INT8* cg_src0 = NULL;
-	INT8* cg_src1 = NULL;
-	UINT32 tempWidth = 0;
-	UINT32 tempHeight = 0;
-	__m128i t;
-	__m128i val;
-	__m128i mask = _mm_set1_epi16(0xFF);
-	tempWidth = ROUND_UP_TO(context->width, 8);
-	tempHeight = ROUND_UP_TO(context->height, 2);
-
-	for (UINT32 y = 0; y < tempHeight >> 1; y++)
+	if (count == 8)
 	{
-		co_dst = context->priv->PlaneBuffers[1] + y * (tempWidth >> 1);
-		cg_dst = context->priv->PlaneBuffers[2] + y * (tempWidth >> 1);
-		co_src0 = (INT8*)context->priv->PlaneBuffers[1] + (y << 1) * tempWidth;
-		co_src1 = co_src0 + tempWidth;
-		cg_src0 = (INT8*)context->priv->PlaneBuffers[2] + (y << 1) * tempWidth;
-		cg_src1 = cg_src0 + tempWidth;
-
-		for (UINT32 x = 0; x < tempWidth >> 1; x += 8)
-		{
-			t = _mm_loadu_si128((__m128i*)co_src0);
-			t = _mm_avg_epu8(t, _mm_loadu_si128((__m128i*)co_src1));
-			val = _mm_and_si128(_mm_srli_si128(t, 1), mask);
-			val = _mm_avg_epu16(val, _mm_and_si128(t, mask));
-			val = _mm_packus_epi16(val, val);
-			_mm_storeu_si128((__m128i*)co_dst, val);
-			co_dst += 8;
-			co_src0 += 16;
-			co_src1 += 16;
-			t = _mm_loadu_si128((__m128i*)cg_src0);
-			t = _mm_avg_epu8(t, _mm_loadu_si128((__m128i*)cg_src1));
-			val = _mm_and_si128(_mm_srli_si128(t, 1), mask);
-			val = _mm_avg_epu16(val, _mm_and_si128(t, mask));
-			val = _mm_packus_epi16(val, val);
-			_mm_storeu_si128((__m128i*)cg_dst, val);
-			cg_dst += 8;
-			cg_src0 += 16;
-			cg_src1 += 16;
-		}
+		_mm_storel_epi64((__m128i*)dst, v);
+		return;
 	}
+
+	BYTE tmp[16] = { 0 };
+	_mm_storeu_si128((__m128i*)tmp, v);
+	memcpy(dst, tmp, count);
+}
+
+/* Averages the 2x2 blocks of two rows of 8 chroma values into 4 bytes */
+static INLINE void nsc_store_subsampled(BYTE* WINPR_RESTRICT dst, __m128i c0, __m128i c1)
+{
+	const __m128i sum = _mm_madd_epi16(_mm_add_epi16(c0, c1), _mm_set1_epi16(1));
+	__m128i v = _mm_packs_epi32(_mm_srai_epi32(sum, 2), _mm_setzero_si128());
+	v = _mm_packs_epi16(v, v);
+
+	const INT32 value = _mm_cvtsi128_si32(v);
+	memcpy(dst, &value, sizeof(value));
 }
 
-static BOOL nsc_encode_sse2(NSC_CONTEXT* context, const BYTE* data, UINT32 scanline)
+/**
+ * ARGB to AYCoCg conversion, color loss reduction and chroma subsampling in a single pass.
+ * With subsampling two rows are converted at a time and only the averaged chroma is stored.
+ */
+static BOOL nsc_encode_sse2(NSC_CONTEXT* WINPR_RESTRICT context, const BYTE* WINPR_RESTRICT data,
+                            UINT32 scanline)
 {
-	if (!nsc_encode_argb_to_aycocg_sse2(context, data, scanline))
+	if (!context || !data || (scanline == 0))
 		return FALSE;
 
-	if (context->ChromaSubsamplingLevel > 0)
-		nsc_encode_subsampling_sse2(context);
+	const UINT32 width = context->width;
+	const UINT32 height = context->height;
+	const BOOL subsample = context->ChromaSubsamplingLevel > 0;
+	const size_t tempWidth = ROUND_UP_TO(width, 8);
+	const size_t rw = subsample ? tempWidth : width;
+	const __m128i ccl = _mm_cvtsi32_si128((int)context->ColorLossLevel);
+	BYTE* yplane = context->priv->PlaneBuffers[0];
+	BYTE* coplane = context->priv->PlaneBuffers[1];
+	BYTE* cgplane = context->priv->PlaneBuffers[2];
+	BYTE* aplane = context->priv->PlaneBuffers[3];
+
+	for (UINT32 y = 0; y < height; y += (subsample ? 2 : 1))
+	{
+		const BYTE* src0 = &data[1ull * (height - 1 - y) * scanline];
+		const BOOL second = subsample && (y + 1 < height);
+
+		for (UINT32 x = 0; x < width; x += 8)
+		{
+			const UINT32 count = MIN(8, width - x);
+			__m128i y0;
+			__m128i co0;
+			__m128i cg0;
+			__m128i a0;
+
+			nsc_load_block(context, src0, x, count, ccl, &y0, &co0, &cg0, &a0);
+			nsc_store(&yplane[y * rw + x], _mm_packus_epi16(y0, y0), subsample ? 8 : count);
+			nsc_store(&aplane[1ull * y * width + x], _mm_packus_epi16(a0, a0), count);
+
+			if (!subsample)
+			{
+				nsc_store(&coplane[y * rw + x], _mm_packs_epi16(co0, co0), count);
+				nsc_store(&cgplane[y * rw + x], _mm_packs_epi16(cg0, cg0), count);
+				continue;
+			}
+
+			__m128i co1 = co0;
+			__m128i cg1 = cg0;
+
+			/* An odd height repeats the last row */
+			if (second)
+			{
+				__m128i y1;
+				__m128i a1;
+
+				nsc_load_block(context, src0 - scanline, x, count, ccl, &y1, &co1, &cg1, &a1);
+				nsc_store(&yplane[(y + 1) * rw + x], _mm_packus_epi16(y1, y1), 8);
+				nsc_store(&aplane[(y + 1ull) * width + x], _mm_packus_epi16(a1, a1), count);
+			}
+
+			const size_t offset = (y / 2) * (tempWidth / 2) + x / 2;
+			nsc_store_subsampled(&coplane[offset], co0, co1);
+			nsc_store_subsampled(&cgplane[offset], cg0, cg1);
+		}
+	}
 
 	return TRUE;
 }
+
+static size_t nsc_rle_run_sse2(const BYTE* WINPR_RESTRICT data, size_t count, BYTE symbol)
+{
+	const __m128i value = _mm_set1_epi8((char)symbol);
+	size_t x = 0;
+
+	for (; x + 16 <= count; x += 16)
+	{
+		const __m128i v = _mm_loadu_si128((const __m128i*)&data[x]);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, value)) != 0xFFFF)
+			break;
+	}
+
+	while ((x < count) && (data[x] == symbol))
+		x++;
+
+	return x;
+}
+
+static size_t nsc_rle_raw_sse2(const BYTE* WINPR_RESTRICT data, size_t count)
+{
+	size_t x = 0;
+
+	for (; x + 16 <= count; x += 16)
+	{
+		const __m128i v = _mm_loadu_si128((const __m128i*)&data[x]);
+		const __m128i before = _mm_loadu_si128((const __m128i*)&data[x - 1]);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, before)) != 0)
+			break;
+	}
+
+	while ((x < count) && (data[x] != data[x - 1]))
+		x++;
+
+	return x;
+}
 #endif
 
 void nsc_init_sse2(NSC_CONTEXT* context)
@@ -387,6 +346,8 @@ void nsc_init_sse2(NSC_CONTEXT* context)
 
 	PROFILER_RENAME(context->priv->prof_nsc_encode, "nsc_encode_sse2")
 	context->encode = nsc_encode_sse2;
+	context->rle_run = nsc_rle_run_sse2;
+	context->rle_raw = nsc_rle_raw_sse2;
 #else
 	WINPR_UNUSED(context);
 #endif
@@ -0,0 +1,219 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Planar Bitmap Plane Kernels - SSE2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/crt.h>
+#include <winpr/sysinfo.h>
+
+#include "planar_sse2.h"
+
+
+#if defined(WITH_SSE2)
+#include <emmintrin.h>
+
+static INLINE __m128i extract_channel(const __m128i px[4], BYTE pos)
+{
+	if (pos == PLANAR_CHANNEL_NONE)
+		return _mm_set1_epi8((char)0xFF);
+
+	const __m128i shift = _mm_cvtsi32_si128(pos * 8);
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	const __m128i c0 = _mm_and_si128(_mm_srl_epi32(px[0], shift), mask);
+	const __m128i c1 = _mm_and_si128(_mm_srl_epi32(px[1], shift), mask);
+	const __m128i c2 = _mm_and_si128(_mm_srl_epi32(px[2], shift), mask);
+	const __m128i c3 = _mm_and_si128(_mm_srl_epi32(px[3], shift), mask);
+	return _mm_packus_epi16(_mm_packs_epi32(c0, c1), _mm_packs_epi32(c2, c3));
+}
+
+static void planar_split32_sse2(const BYTE* WINPR_RESTRICT src, size_t count, const BYTE pos[4],
+                                BYTE* WINPR_RESTRICT a, BYTE* WINPR_RESTRICT r,
+                                BYTE* WINPR_RESTRICT g, BYTE* WINPR_RESTRICT b)
+{
+	size_t x = 0;
+
+	for (; x + 16 <= count; x += 16)
+	{
+		const __m128i px[4] = { _mm_loadu_si128((const __m128i*)&src[4 * x]),
+			                    _mm_loadu_si128((const __m128i*)&src[4 * x + 16]),
+			                    _mm_loadu_si128((const __m128i*)&src[4 * x + 32]),
+			                    _mm_loadu_si128((const __m128i*)&src[4 * x + 48]) };
+
+		_mm_storeu_si128((__m128i*)&a[x], extract_channel(px, pos[0]));
+		_mm_storeu_si128((__m128i*)&r[x], extract_channel(px, pos[1]));
+		_mm_storeu_si128((__m128i*)&g[x], extract_channel(px, pos[2]));
+		_mm_storeu_si128((__m128i*)&b[x], extract_channel(px, pos[3]));
+	}
+
+	for (; x < count; x++)
+	{
+		const BYTE* pixel = &src[4 * x];
+		a[x] = (pos[0] == PLANAR_CHANNEL_NONE) ? 0xFF : pixel[pos[0]];
+		r[x] = pixel[pos[1]];
+		g[x] = pixel[pos[2]];
+		b[x] = pixel[pos[3]];
+	}
+}
+
+static INLINE void insert_channel(__m128i px[4], __m128i value, BYTE pos)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i shift = _mm_cvtsi32_si128(pos * 8);
+	const __m128i lo = _mm_unpacklo_epi8(value, zero);
+	const __m128i hi = _mm_unpackhi_epi8(value, zero);
+
+	px[0] = _mm_or_si128(px[0], _mm_sll_epi32(_mm_unpacklo_epi16(lo, zero), shift));
+	px[1] = _mm_or_si128(px[1], _mm_sll_epi32(_mm_unpackhi_epi16(lo, zero), shift));
+	px[2] = _mm_or_si128(px[2], _mm_sll_epi32(_mm_unpacklo_epi16(hi, zero), shift));
+	px[3] = _mm_or_si128(px[3], _mm_sll_epi32(_mm_unpackhi_epi16(hi, zero), shift));
+}
+
+static void planar_merge32_sse2(const BYTE* WINPR_RESTRICT a, const BYTE* WINPR_RESTRICT r,
+                                const BYTE* WINPR_RESTRICT g, const BYTE* WINPR_RESTRICT b,
+                                BYTE alpha, size_t count, const BYTE pos[4],
+                                BYTE* WINPR_RESTRICT dst)
+{
+	const __m128i alphaValue = _mm_set1_epi8((char)alpha);
+	size_t x = 0;
+
+	for (; x + 16 <= count; x += 16)
+	{
+		__m128i px[4] = { _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128(),
+			              _mm_setzero_si128() };
+
+		insert_channel(px, a ? _mm_loadu_si128((const __m128i*)&a[x]) : alphaValue, pos[0]);
+		insert_channel(px, _mm_loadu_si128((const __m128i*)&r[x]), pos[1]);
+		insert_channel(px, _mm_loadu_si128((const __m128i*)&g[x]), pos[2]);
+		insert_channel(px, _mm_loadu_si128((const __m128i*)&b[x]), pos[3]);
+
+		_mm_storeu_si128((__m128i*)&dst[4 * x], px[0]);
+		_mm_storeu_si128((__m128i*)&dst[4 * x + 16], px[1]);
+		_mm_storeu_si128((__m128i*)&dst[4 * x + 32], px[2]);
+		_mm_storeu_si128((__m128i*)&dst[4 * x + 48], px[3]);
+	}
+
+	for (; x < count; x++)
+	{
+		BYTE* pixel = &dst[4 * x];
+		pixel[pos[0]] = a ? a[x] : alpha;
+		pixel[pos[1]] = r[x];
+		pixel[pos[2]] = g[x];
+		pixel[pos[3]] = b[x];
+	}
+}
+
+static void planar_delta_sse2(const BYTE* WINPR_RESTRICT cur, const BYTE* WINPR_RESTRICT prev,
+                              BYTE* WINPR_RESTRICT out, size_t count)
+{
+	const __m128i zero = _mm_setzero_si128();
+	size_t x = 0;
+
+	for (; x + 16 <= count; x += 16)
+	{
+		const __m128i c = _mm_loadu_si128((const __m128i*)&cur[x]);
+		const __m128i p = _mm_loadu_si128((const __m128i*)&prev[x]);
+		const __m128i d = _mm_sub_epi8(c, p);
+		/* 2d for positive, ~2d = -2d - 1 for negative deltas */
+		const __m128i v = _mm_xor_si128(_mm_add_epi8(d, d), _mm_cmpgt_epi8(zero, d));
+		_mm_storeu_si128((__m128i*)&out[x], v);
+	}
+
+	for (; x < count; x++)
+	{
+		const INT8 d = (INT8)(cur[x] - prev[x]);
+		out[x] = (BYTE)((d < 0) ? ~(2 * d) : (2 * d));
+	}
+}
+
+static void planar_undelta_sse2(const BYTE* cur, const BYTE* WINPR_RESTRICT prev, BYTE* out,
+                                size_t count)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi8(1);
+	const __m128i low = _mm_set1_epi8(0x7F);
+	size_t x = 0;
+
+	for (; x + 16 <= count; x += 16)
+	{
+		const __m128i c = _mm_loadu_si128((const __m128i*)&cur[x]);
+		const __m128i p = _mm_loadu_si128((const __m128i*)&prev[x]);
+		const __m128i half = _mm_and_si128(_mm_srli_epi16(c, 1), low);
+		const __m128i sign = _mm_sub_epi8(zero, _mm_and_si128(c, one));
+		_mm_storeu_si128((__m128i*)&out[x], _mm_add_epi8(p, _mm_xor_si128(half, sign)));
+	}
+
+	for (; x < count; x++)
+	{
+		const BYTE c = cur[x];
+		const BYTE d = (c & 1) ? (BYTE)~(c >> 1) : (BYTE)(c >> 1);
+		out[x] = (BYTE)(prev[x] + d);
+	}
+}
+
+static size_t planar_run_sse2(const BYTE* WINPR_RESTRICT data, size_t count, BYTE symbol)
+{
+	const __m128i value = _mm_set1_epi8((char)symbol);
+	size_t x = 0;
+
+	for (; x + 16 <= count; x += 16)
+	{
+		const __m128i v = _mm_loadu_si128((const __m128i*)&data[x]);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, value)) != 0xFFFF)
+			break;
+	}
+
+	while ((x < count) && (data[x] == symbol))
+		x++;
+
+	return x;
+}
+
+static size_t planar_raw_sse2(const BYTE* WINPR_RESTRICT data, size_t count)
+{
+	size_t x = 0;
+
+	for (; x + 16 <= count; x += 16)
+	{
+		const __m128i v = _mm_loadu_si128((const __m128i*)&data[x]);
+		const __m128i before = _mm_loadu_si128((const __m128i*)&data[x - 1]);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, before)) != 0)
+			break;
+	}
+
+	while ((x < count) && (data[x] != data[x - 1]))
+		x++;
+
+	return x;
+}
+#endif
+
+void planar_init_sse2(PLANAR_KERNELS* kernels)
+{
+#if defined(WITH_SSE2)
+	if (!IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE))
+		return;
+
+	kernels->split32 = planar_split32_sse2;
+	kernels->merge32 = planar_merge32_sse2;
+	kernels->delta = planar_delta_sse2;
+	kernels->undelta = planar_undelta_sse2;
+	kernels->run = planar_run_sse2;
+	kernels->raw = planar_raw_sse2;
+#else
+	WINPR_UNUSED(kernels);
+#endif
+}
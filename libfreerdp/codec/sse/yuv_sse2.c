@@ -0,0 +1,120 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * YUV Change Detection Signatures - SSE2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/crt.h>
+#include <winpr/sysinfo.h>
+
+#include "yuv_sse2.h"
+
+#if defined(WITH_SSE2)
+#include <emmintrin.h>
+
+/* Same lanes and constants as yuv_signature_row_generic */
+static INLINE __m128i mullo_epi32(__m128i a, __m128i b)
+{
+	const __m128i even = _mm_mul_epu32(a, b);
+	const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+	                          _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static INLINE __m128i round_epi32(__m128i acc, __m128i data, __m128i pMul, __m128i pIn, int r)
+{
+	acc = _mm_add_epi32(acc, mullo_epi32(data, pIn));
+	acc = _mm_or_si128(_mm_slli_epi32(acc, r), _mm_srli_epi32(acc, 32 - r));
+	return mullo_epi32(acc, pMul);
+}
+
+static INLINE __m128i seed_epi32(UINT32 base, UINT32 step)
+{
+	return _mm_set_epi32((int)(base + 3 * step), (int)(base + 2 * step), (int)(base + step),
+	                     (int)base);
+}
+
+static void yuv_signature_row_sse2(const BYTE* WINPR_RESTRICT data, size_t length,
+                                   YUV_SIGNATURE* WINPR_RESTRICT signature,
+                                   UINT32* WINPR_RESTRICT flat)
+{
+	size_t x = 0;
+	const __m128i p1 = _mm_set1_epi32((int)YUV_SIGNATURE_PRIME1);
+	const __m128i p2 = _mm_set1_epi32((int)YUV_SIGNATURE_PRIME2);
+	const __m128i p3 = _mm_set1_epi32((int)YUV_SIGNATURE_PRIME3);
+	const __m128i p4 = _mm_set1_epi32((int)YUV_SIGNATURE_PRIME4);
+	__m128i a = seed_epi32(YUV_SIGNATURE_PRIME1, YUV_SIGNATURE_PRIME2);
+	__m128i b = seed_epi32(YUV_SIGNATURE_PRIME3, YUV_SIGNATURE_PRIME4);
+
+	for (; x + 16 <= length; x += 16)
+	{
+		const __m128i val = _mm_loadu_si128((const __m128i*)&data[x]);
+		a = round_epi32(a, val, p1, p2, 13);
+		b = round_epi32(b, val, p3, p4, 17);
+	}
+
+	if (x < length)
+	{
+		BYTE tail[16] = { 0 };
+		memcpy(tail, &data[x], length - x);
+		const __m128i val = _mm_loadu_si128((const __m128i*)tail);
+		a = round_epi32(a, val, p1, p2, 13);
+		b = round_epi32(b, val, p3, p4, 17);
+	}
+
+	if (flat && (length > 1))
+	{
+		const __m128i ones = _mm_set1_epi8(1);
+		__m128i sum = _mm_setzero_si128();
+		size_t y = 1;
+
+		for (; y + 16 <= length; y += 16)
+		{
+			const __m128i cur = _mm_loadu_si128((const __m128i*)&data[y]);
+			const __m128i left = _mm_loadu_si128((const __m128i*)&data[y - 1]);
+			const __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(cur, left), ones);
+			sum = _mm_add_epi64(sum, _mm_sad_epu8(eq, _mm_setzero_si128()));
+		}
+
+		UINT32 count = (UINT32)_mm_cvtsi128_si32(sum) +
+		               (UINT32)_mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+		for (; y < length; y++)
+		{
+			if (data[y] == data[y - 1])
+				count++;
+		}
+		*flat += count;
+	}
+
+	UINT32 lanesA[4] = { 0 };
+	UINT32 lanesB[4] = { 0 };
+	_mm_storeu_si128((__m128i*)lanesA, a);
+	_mm_storeu_si128((__m128i*)lanesB, b);
+	yuv_signature_fold(lanesA, lanesB, length, signature);
+}
+#endif
+
+void yuv_signature_init_sse2(YUV_SIGNATURE_KERNELS* kernels)
+{
+#if defined(WITH_SSE2)
+	if (!IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE))
+		return;
+
+	kernels->row = yuv_signature_row_sse2;
+#else
+	WINPR_UNUSED(kernels);
+#endif
+}
@@ -0,0 +1,27 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * YUV Change Detection Signatures - SSE2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CODEC_YUV_SSE2_H
+#define FREERDP_LIB_CODEC_YUV_SSE2_H
+
+#include <freerdp/api.h>
+
+#include "../yuv_signature.h"
+
+FREERDP_LOCAL void yuv_signature_init_sse2(YUV_SIGNATURE_KERNELS* kernels);
+
+#endif /* FREERDP_LIB_CODEC_YUV_SSE2_H */
@@ -0,0 +1,240 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <winpr/crt.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/config.h>
+#include <freerdp/codec/audio.h>
+#include <freerdp/codec/dsp.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define TEST_TONE 1000.0
+#define TEST_AMPLITUDE 16000.0
+
+static void init_format(AUDIO_FORMAT* format, UINT32 rate, UINT16 channels, UINT16 bits)
+{
+	format->wFormatTag = WAVE_FORMAT_PCM;
+	format->nChannels = channels;
+	format->nSamplesPerSec = rate;
+	format->wBitsPerSample = bits;
+	format->nBlockAlign = channels * bits / 8;
+	format->nAvgBytesPerSec = rate * format->nBlockAlign;
+	format->cbSize = 0;
+	format->data = NULL;
+}
+
+static INT16* create_tone(UINT32 rate, UINT16 channels, size_t frames)
+{
+	INT16* data = calloc(frames * channels, sizeof(INT16));
+	if (!data)
+		return NULL;
+
+	for (size_t x = 0; x < frames; x++)
+	{
+		const double v = TEST_AMPLITUDE * sin(2.0 * M_PI * TEST_TONE * (double)x / rate);
+		for (size_t c = 0; c < channels; c++)
+			data[x * channels + c] = (INT16)lround(v);
+	}
+	return data;
+}
+
+static INT16 sample_at(const BYTE* data, size_t index)
+{
+	return (INT16)(data[2 * index] | (data[2 * index + 1] << 8));
+}
+
+/* Resample a tone in chunks and check rate, frequency and level of the result */
+static BOOL test_resample_tone(FREERDP_DSP_RESAMPLE_QUALITY quality, UINT32 srcRate,
+                               UINT16 srcChannels, UINT32 dstRate, UINT16 dstChannels)
+{
+	BOOL rc = FALSE;
+	AUDIO_FORMAT src = { 0 };
+	AUDIO_FORMAT dst = { 0 };
+	const size_t frames = srcRate;
+	const size_t chunk = srcRate / 50;
+	FREERDP_DSP_CONTEXT* context = freerdp_dsp_context_new(TRUE);
+	wStream* out = Stream_New(NULL, 4096);
+	INT16* tone = create_tone(srcRate, srcChannels, frames);
+
+	init_format(&src, srcRate, srcChannels, 16);
+	init_format(&dst, dstRate, dstChannels, 16);
+
+	if (!context || !out || !tone)
+		goto fail;
+
+	if (!freerdp_dsp_context_set_resample_quality(context, quality))
+		goto fail;
+	if (!freerdp_dsp_context_reset(context, &dst, 0))
+		goto fail;
+
+	for (size_t x = 0; x < frames; x += chunk)
+	{
+		const size_t count = MIN(chunk, frames - x);
+		const BYTE* data = (const BYTE*)&tone[x * srcChannels];
+		if (!freerdp_dsp_encode(context, &src, data, count * srcChannels * 2, out))
+			goto fail;
+	}
+
+	const size_t produced = Stream_GetPosition(out) / 2 / dstChannels;
+
+	/* The filter delays the output by at most a few ms */
+	if ((produced > dstRate) || (produced < dstRate - dstRate / 100))
+	{
+		fprintf(stderr, "[%s] expected ~%" PRIu32 " frames, got %" PRIuz "\n", __func__, dstRate,
+		        produced);
+		goto fail;
+	}
+
+	/* Skip the filter startup, then count zero crossings and track the peak */
+	const BYTE* data = Stream_Buffer(out);
+	const size_t start = dstRate / 100;
+	size_t crossings = 0;
+	INT32 peak = 0;
+	for (size_t x = start + 1; x < produced; x++)
+	{
+		for (size_t c = 0; c < dstChannels; c++)
+		{
+			const INT16 v = sample_at(data, x * dstChannels + c);
+			peak = MAX(peak, abs(v));
+		}
+
+		const INT16 prev = sample_at(data, (x - 1) * dstChannels);
+		const INT16 cur = sample_at(data, x * dstChannels);
+		if ((prev < 0) != (cur < 0))
+			crossings++;
+	}
+
+	const double seconds = (double)(produced - start - 1) / dstRate;
+	const double frequency = crossings / seconds / 2.0;
+	if ((fabs(frequency - TEST_TONE) > 5.0) || (peak < TEST_AMPLITUDE * 0.97) ||
+	    (peak > TEST_AMPLITUDE * 1.03))
+	{
+		fprintf(stderr, "[%s] %" PRIu32 " -> %" PRIu32 ": tone %lf Hz, peak %" PRId32 "\n",
+		        __func__, srcRate, dstRate, frequency, peak);
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	free(tone);
+	Stream_Free(out, TRUE);
+	freerdp_dsp_context_free(context);
+	return rc;
+}
+
+/* Same rate conversions are exact: stereo is averaged, 8bit is offset binary */
+static BOOL test_mix_convert(void)
+{
+	BOOL rc = FALSE;
+	AUDIO_FORMAT src = { 0 };
+	AUDIO_FORMAT dst = { 0 };
+	const INT16 stereo[] = { 1000, 3000, -200, -400, 32767, 32767, -32768, -32768 };
+	const BYTE expected[] = { 0x87, 0x7E, 0xFF, 0x00 };
+	FREERDP_DSP_CONTEXT* context = freerdp_dsp_context_new(TRUE);
+	wStream* out = Stream_New(NULL, 64);
+
+	init_format(&src, 22050, 2, 16);
+	init_format(&dst, 22050, 1, 8);
+
+	if (!context || !out)
+		goto fail;
+	if (!freerdp_dsp_context_reset(context, &dst, 0))
+		goto fail;
+	if (!freerdp_dsp_encode(context, &src, (const BYTE*)stereo, sizeof(stereo), out))
+		goto fail;
+
+	/* 2000 -> 0x07 + 0x80, -300 -> 0xFE + 0x80, ... */
+	const BYTE* data = Stream_Buffer(out);
+	if ((Stream_GetPosition(out) != sizeof(expected)) ||
+	    (memcmp(data, expected, sizeof(expected)) != 0))
+	{
+		fprintf(stderr, "[%s] got %02" PRIx8 " %02" PRIx8 " %02" PRIx8 " %02" PRIx8 "\n",
+		        __func__, data[0], data[1], data[2], data[3]);
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	Stream_Free(out, TRUE);
+	freerdp_dsp_context_free(context);
+	return rc;
+}
+
+static BOOL test_resample_speed(FREERDP_DSP_RESAMPLE_QUALITY quality)
+{
+	BOOL rc = FALSE;
+	AUDIO_FORMAT src = { 0 };
+	AUDIO_FORMAT dst = { 0 };
+	const size_t seconds = 10;
+	const size_t chunk = 44100 / 50;
+	FREERDP_DSP_CONTEXT* context = freerdp_dsp_context_new(TRUE);
+	wStream* out = Stream_New(NULL, 4096);
+	INT16* tone = create_tone(44100, 2, chunk);
+
+	init_format(&src, 44100, 2, 16);
+	init_format(&dst, 48000, 2, 16);
+
+	if (!context || !out || !tone)
+		goto fail;
+	if (!freerdp_dsp_context_set_resample_quality(context, quality))
+		goto fail;
+	if (!freerdp_dsp_context_reset(context, &dst, 0))
+		goto fail;
+
+	const UINT64 start = winpr_GetUnixTimeNS();
+	for (size_t x = 0; x < seconds * 50; x++)
+	{
+		Stream_SetPosition(out, 0);
+		if (!freerdp_dsp_encode(context, &src, (const BYTE*)tone, chunk * 4, out))
+			goto fail;
+	}
+	const UINT64 end = winpr_GetUnixTimeNS();
+
+	const double ms = (double)(end - start) / 1000000.0;
+	fprintf(stdout, "[%s] quality %d: %" PRIuz " s 44100 Hz -> 48000 Hz stereo in %lf ms\n",
+	        __func__, quality, seconds, ms);
+	rc = TRUE;
+fail:
+	free(tone);
+	Stream_Free(out, TRUE);
+	freerdp_dsp_context_free(context);
+	return rc;
+}
+
+int TestFreeRDPCodecDsp(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+#if defined(WITH_DSP_FFMPEG) || defined(WITH_SOXR)
+	/* The built in resampler is only used without external libraries */
+	return 0;
+#else
+	const FREERDP_DSP_RESAMPLE_QUALITY qualities[] = { FREERDP_DSP_RESAMPLE_QUALITY_LOW,
+		                                               FREERDP_DSP_RESAMPLE_QUALITY_MEDIUM,
+		                                               FREERDP_DSP_RESAMPLE_QUALITY_HIGH };
+
+	if (!test_mix_convert())
+		return -1;
+
+	for (size_t x = 0; x < ARRAYSIZE(qualities); x++)
+	{
+		if (!test_resample_tone(qualities[x], 44100, 2, 48000, 2))
+			return -1;
+		if (!test_resample_tone(qualities[x], 44100, 2, 22050, 1))
+			return -1;
+		if (!test_resample_tone(qualities[x], 8000, 1, 44100, 2))
+			return -1;
+		if (!test_resample_speed(qualities[x]))
+			return -1;
+	}
+
+	return 0;
+#endif
+}
@@ -11,8 +11,49 @@
 #include <freerdp/codec/bitmap.h>
 #include <freerdp/codec/interleaved.h>
 #include <winpr/crypto.h>
+#include <winpr/sysinfo.h>
 #include <freerdp/utils/profiler.h>
 
+#include "../bitmap_rle.h"
+#include "../sse/bitmap_sse2.h"
+
+static BOOL compare_image(const BYTE* pSrcData, const BYTE* pDstData, size_t step, UINT32 w,
+                          UINT32 h, UINT32 format, float maxDiff)
+{
+	const UINT32 bstep = FreeRDPGetBytesPerPixel(format);
+
+	for (UINT32 i = 0; i < h; i++)
+	{
+		const BYTE* srcLine = &pSrcData[i * step];
+		const BYTE* dstLine = &pDstData[i * step];
+
+		for (UINT32 j = 0; j < w; j++)
+		{
+			BYTE r = 0;
+			BYTE g = 0;
+			BYTE b = 0;
+			BYTE dr = 0;
+			BYTE dg = 0;
+			BYTE db = 0;
+			const UINT32 srcColor = FreeRDPReadColor(&srcLine[j * bstep], format);
+			const UINT32 dstColor = FreeRDPReadColor(&dstLine[j * bstep], format);
+			FreeRDPSplitColor(srcColor, format, &r, &g, &b, NULL, NULL);
+			FreeRDPSplitColor(dstColor, format, &dr, &dg, &db, NULL, NULL);
+
+			if (fabsf((float)r - dr) > maxDiff)
+				return FALSE;
+
+			if (fabsf((float)g - dg) > maxDiff)
+				return FALSE;
+
+			if (fabsf((float)b - db) > maxDiff)
+				return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
 static BOOL run_encode_decode_single(UINT16 bpp, BITMAP_INTERLEAVED_CONTEXT* encoder,
                                      BITMAP_INTERLEAVED_CONTEXT* decoder
 #if defined(WITH_PROFILER)
@@ -28,7 +69,6 @@ static BOOL run_encode_decode_single(UINT16 bpp, BITMAP_INTERLEAVED_CONTEXT* enc
 	const UINT32 x = 0;
 	const UINT32 y = 0;
 	const UINT32 format = PIXEL_FORMAT_RGBX32;
-	const UINT32 bstep = FreeRDPGetBytesPerPixel(format);
 	const size_t step = (w + 13) * 4;
 	const size_t SrcSize = step * h;
 	const float maxDiff = 4.0f * ((bpp < 24) ? 2.0f : 1.0f);
@@ -61,34 +101,8 @@ static BOOL run_encode_decode_single(UINT16 bpp, BITMAP_INTERLEAVED_CONTEXT* enc
 	if (!rc)
 		goto fail;
 
-	for (UINT32 i = 0; i < h; i++)
-	{
-		const BYTE* srcLine = &pSrcData[i * step];
-		const BYTE* dstLine = &pDstData[i * step];
-
-		for (UINT32 j = 0; j < w; j++)
-		{
-			BYTE r = 0;
-			BYTE g = 0;
-			BYTE b = 0;
-			BYTE dr = 0;
-			BYTE dg = 0;
-			BYTE db = 0;
-			const UINT32 srcColor = FreeRDPReadColor(&srcLine[j * bstep], format);
-			const UINT32 dstColor = FreeRDPReadColor(&dstLine[j * bstep], format);
-			FreeRDPSplitColor(srcColor, format, &r, &g, &b, NULL, NULL);
-			FreeRDPSplitColor(dstColor, format, &dr, &dg, &db, NULL, NULL);
-
-			if (fabsf((float)r - dr) > maxDiff)
-				goto fail;
-
-			if (fabsf((float)g - dg) > maxDiff)
-				goto fail;
-
-			if (fabsf((float)b - db) > maxDiff)
-				goto fail;
-		}
-	}
+	if (!compare_image(pSrcData, pDstData, step, w, h, format, maxDiff))
+		goto fail;
 
 	rc2 = TRUE;
 fail:
@@ -156,6 +170,462 @@ fail:
 	return rc;
 }
 
+typedef enum
+{
+	CONTENT_SOLID,
+	CONTENT_TEXT,
+	CONTENT_RANDOM
+} test_content;
+
+static const char* get_content_name(test_content content)
+{
+	switch (content)
+	{
+		case CONTENT_SOLID:
+			return "solid";
+		case CONTENT_TEXT:
+			return "text";
+		case CONTENT_RANDOM:
+			return "random";
+		default:
+			return "configuration error!";
+	}
+}
+
+static void fill_content(BYTE* pSrcData, size_t step, UINT32 w, UINT32 h, UINT32 format,
+                         test_content content)
+{
+	const UINT32 bstep = FreeRDPGetBytesPerPixel(format);
+	const UINT32 background = FreeRDPGetColor(format, 0x33, 0x66, 0x99, 0xFF);
+	const UINT32 foreground = FreeRDPGetColor(format, 0x00, 0x00, 0x00, 0xFF);
+
+	if (content == CONTENT_RANDOM)
+	{
+		winpr_RAND(pSrcData, step * h);
+		return;
+	}
+
+	for (UINT32 y = 0; y < h; y++)
+	{
+		for (UINT32 x = 0; x < w; x++)
+		{
+			UINT32 color = background;
+
+			/* glyph like strokes on a solid background */
+			if ((content == CONTENT_TEXT) && ((y % 12) < 9) && ((x % 7) < 2 || (y % 12) == 4))
+				color = foreground;
+
+			FreeRDPWriteColor(&pSrcData[y * step + x * bstep], format, color);
+		}
+	}
+}
+
+/* Compressed size and throughput of the run detection and run expansion per content kind */
+static BOOL run_content(UINT16 bpp, UINT32 w, UINT32 h, test_content content,
+                        BITMAP_INTERLEAVED_CONTEXT* encoder, BITMAP_INTERLEAVED_CONTEXT* decoder,
+                        UINT32* pSize)
+{
+	BOOL rc = FALSE;
+	const UINT32 rounds = 50;
+	const UINT32 format = PIXEL_FORMAT_RGBX32;
+	const size_t step = 4ull * w;
+	const size_t SrcSize = step * h;
+	const float maxDiff = 4.0f * ((bpp < 24) ? 2.0f : 1.0f);
+	UINT64 encTime = 0;
+	UINT64 decTime = 0;
+	UINT32 DstSize = 0;
+	BYTE* pSrcData = calloc(1, SrcSize);
+	BYTE* pDstData = calloc(1, SrcSize);
+	BYTE* tmp = calloc(1, SrcSize);
+
+	if (!pSrcData || !pDstData || !tmp)
+		goto fail;
+
+	fill_content(pSrcData, step, w, h, format, content);
+
+	for (UINT32 x = 0; x < rounds; x++)
+	{
+		DstSize = (UINT32)SrcSize;
+		const UINT64 start = winpr_GetTickCount64NS();
+		if (!interleaved_compress(encoder, tmp, &DstSize, w, h, pSrcData, format, step, 0, 0, NULL,
+		                          bpp))
+			goto fail;
+		const UINT64 mid = winpr_GetTickCount64NS();
+		if (!interleaved_decompress(decoder, tmp, DstSize, w, h, bpp, pDstData, format, step, 0, 0,
+		                            w, h, NULL))
+			goto fail;
+		const UINT64 end = winpr_GetTickCount64NS();
+		encTime += mid - start;
+		decTime += end - mid;
+	}
+
+	if (!compare_image(pSrcData, pDstData, step, w, h, format, maxDiff))
+		goto fail;
+
+	printf("%-6s %" PRIu32 "x%" PRIu32 " %2" PRIu16 "bpp: %6" PRIu32 " bytes, compress %8.2f us, "
+	       "decompress %8.2f us\n",
+	       get_content_name(content), w, h, bpp, DstSize, encTime / 1000.0 / rounds,
+	       decTime / 1000.0 / rounds);
+	*pSize = DstSize;
+	rc = TRUE;
+fail:
+	free(pSrcData);
+	free(pDstData);
+	free(tmp);
+	return rc;
+}
+
+static BOOL run_content_comparison(BITMAP_INTERLEAVED_CONTEXT* encoder,
+                                   BITMAP_INTERLEAVED_CONTEXT* decoder)
+{
+	const UINT16 bpps[] = { 24, 16, 15 };
+	/* narrow bitmaps expand runs from the line above pixel by pixel */
+	const UINT32 sizes[][2] = { { 64, 64 }, { 4, 16 }, { 60, 17 } };
+
+	for (size_t x = 0; x < ARRAYSIZE(bpps); x++)
+	{
+		for (size_t y = 0; y < ARRAYSIZE(sizes); y++)
+		{
+			UINT32 solid = 0;
+			UINT32 text = 0;
+			UINT32 random = 0;
+			const UINT32 w = sizes[y][0];
+			const UINT32 h = sizes[y][1];
+
+			if (!run_content(bpps[x], w, h, CONTENT_SOLID, encoder, decoder, &solid))
+				return FALSE;
+			if (!run_content(bpps[x], w, h, CONTENT_TEXT, encoder, decoder, &text))
+				return FALSE;
+			if (!run_content(bpps[x], w, h, CONTENT_RANDOM, encoder, decoder, &random))
+				return FALSE;
+
+			/* runs must compress better than noise */
+			if ((solid > text) || (text > random))
+				return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/* The SSE2 span kernel must find the same runs as the generic one */
+static BOOL TestRleSpan(void)
+{
+	BYTE line[4 * 160] = { 0 };
+	BYTE above[4 * 160] = { 0 };
+	BITMAP_RLE_KERNELS generic = { 0 };
+	BITMAP_RLE_KERNELS optimized = { 0 };
+
+	bitmap_rle_init_generic(&generic);
+	optimized = generic;
+	bitmap_rle_init_sse2(&optimized);
+
+	const size_t pixelSizes[] = { 2, 4 };
+	for (size_t run = 0; run < 200; run++)
+	{
+		const size_t pixelSize = pixelSizes[run % ARRAYSIZE(pixelSizes)];
+		const size_t count = sizeof(line) / pixelSize;
+		UINT32 ends[2] = { 0 };
+		winpr_RAND(ends, sizeof(ends));
+
+		/* a run of random length in both lines, then noise */
+		winpr_RAND(line, sizeof(line));
+		winpr_RAND(above, sizeof(above));
+		for (size_t x = 1; x < ends[0] % count; x++)
+			memcpy(&line[x * pixelSize], line, pixelSize);
+		for (size_t x = 1; x < ends[1] % count; x++)
+			memcpy(&above[x * pixelSize], above, pixelSize);
+
+		for (size_t length = 1; length <= count; length += 1 + length / 8)
+		{
+			const BYTE* pabove = (run % 3) ? above : NULL;
+			const size_t expected = generic.span(line, pabove, length, pixelSize);
+			const size_t actual = optimized.span(line, pabove, length, pixelSize);
+			if (expected != actual)
+			{
+				(void)fprintf(stderr,
+				              "span of %" PRIuz " %" PRIuz " byte pixels: %" PRIuz " != %" PRIuz
+				              "\n",
+				              length, pixelSize, actual, expected);
+				return FALSE;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+/* Builds an 8bpp RLE stream of random orders and the image it decodes to, following
+ * [MS-RDPBCGR] 2.2.9.1.1.3.1.2.4 pixel by pixel */
+typedef struct
+{
+	BYTE* image;
+	UINT32 width;
+	size_t size;
+	size_t pos;
+	BYTE fgPel;
+	BOOL firstLine;
+	BOOL insertFgPel;
+	wStream* s;
+} Rle8Model;
+
+static BYTE rle8_rand(void)
+{
+	BYTE value = 0;
+	winpr_RAND(&value, sizeof(value));
+	return value;
+}
+
+static void rle8_put(Rle8Model* model, BYTE value)
+{
+	model->image[model->pos++] = value;
+}
+
+/* a foreground pixel, XORed with the pixel above below the first line */
+static void rle8_put_fg(Rle8Model* model, BOOL first)
+{
+	if (first)
+		rle8_put(model, model->fgPel);
+	else
+		rle8_put(model, model->image[model->pos - model->width] ^ model->fgPel);
+}
+
+static void rle8_put_bg(Rle8Model* model, BOOL first)
+{
+	if (first)
+		rle8_put(model, 0);
+	else
+		rle8_put(model, model->image[model->pos - model->width]);
+}
+
+static void rle8_write_length(wStream* s, BYTE regular, BYTE mega, UINT16 length)
+{
+	if ((length > 0) && (length < 32))
+		Stream_Write_UINT8(s, (BYTE)(regular << 5) | (BYTE)length);
+	else
+	{
+		Stream_Write_UINT8(s, mega);
+		Stream_Write_UINT16(s, length);
+	}
+}
+
+static void rle8_fgbg(Rle8Model* model, BOOL first, UINT16 length, BOOL setFg)
+{
+	BYTE mask[32] = { 0 };
+	winpr_RAND(mask, sizeof(mask));
+
+	if (setFg)
+	{
+		Stream_Write_UINT8(model->s, 0xF7); /* MEGA_MEGA_SET_FGBG_IMAGE */
+		Stream_Write_UINT16(model->s, length);
+		model->fgPel = rle8_rand();
+		Stream_Write_UINT8(model->s, model->fgPel);
+	}
+	else
+	{
+		Stream_Write_UINT8(model->s, 0xF2); /* MEGA_MEGA_FGBG_IMAGE */
+		Stream_Write_UINT16(model->s, length);
+	}
+	Stream_Write(model->s, mask, (length + 7) / 8);
+
+	for (size_t x = 0; x < length; x++)
+	{
+		if (mask[x / 8] & (1 << (x % 8)))
+			rle8_put_fg(model, first);
+		else
+			rle8_put_bg(model, first);
+	}
+}
+
+static BOOL rle8_order(Rle8Model* model)
+{
+	if (model->firstLine && (model->pos >= model->width))
+	{
+		model->firstLine = FALSE;
+		model->insertFgPel = FALSE;
+	}
+
+	const BOOL first = model->firstLine;
+	const size_t left = model->size - model->pos;
+	const size_t wanted = 1 + rle8_rand() % 80;
+	UINT16 length = (UINT16)MIN(wanted, left);
+	BOOL insertFgPel = FALSE;
+	wStream* s = model->s;
+
+	if (!Stream_EnsureRemainingCapacity(s, 128))
+		return FALSE;
+
+	switch (rle8_rand() % 11)
+	{
+		case 0: /* background run */
+			rle8_write_length(s, 0x00, 0xF0, length);
+			if (model->insertFgPel)
+			{
+				rle8_put_fg(model, first);
+				length--;
+			}
+			for (size_t x = 0; x < length; x++)
+				rle8_put_bg(model, first);
+			insertFgPel = TRUE;
+			break;
+
+		case 1: /* foreground run */
+			rle8_write_length(s, 0x01, 0xF1, length);
+			for (size_t x = 0; x < length; x++)
+				rle8_put_fg(model, first);
+			break;
+
+		case 2: /* foreground run with a new foreground */
+			Stream_Write_UINT8(s, 0xF6); /* MEGA_MEGA_SET_FG_RUN */
+			Stream_Write_UINT16(s, length);
+			model->fgPel = rle8_rand();
+			Stream_Write_UINT8(s, model->fgPel);
+			for (size_t x = 0; x < length; x++)
+				rle8_put_fg(model, first);
+			break;
+
+		case 3: /* dithered run */
+		{
+			const BYTE pixels[2] = { rle8_rand(), rle8_rand() };
+			length = MAX(1, length / 2);
+			if (left < 2ull * length)
+				return TRUE;
+			Stream_Write_UINT8(s, 0xF8); /* MEGA_MEGA_DITHERED_RUN */
+			Stream_Write_UINT16(s, length);
+			Stream_Write(s, pixels, sizeof(pixels));
+			for (size_t x = 0; x < 2ull * length; x++)
+				rle8_put(model, pixels[x % 2]);
+		}
+		break;
+
+		case 4: /* color run */
+		{
+			const BYTE pixel = rle8_rand();
+			rle8_write_length(s, 0x03, 0xF3, length);
+			Stream_Write_UINT8(s, pixel);
+			for (size_t x = 0; x < length; x++)
+				rle8_put(model, pixel);
+		}
+		break;
+
+		case 5: /* color image */
+			rle8_write_length(s, 0x04, 0xF4, length);
+			for (size_t x = 0; x < length; x++)
+			{
+				const BYTE pixel = rle8_rand();
+				Stream_Write_UINT8(s, pixel);
+				rle8_put(model, pixel);
+			}
+			break;
+
+		case 6:
+			rle8_fgbg(model, first, length, FALSE);
+			break;
+
+		case 7:
+			rle8_fgbg(model, first, length, TRUE);
+			break;
+
+		case 8: /* SPECIAL_FGBG_1 and SPECIAL_FGBG_2 */
+		{
+			const BOOL special1 = (rle8_rand() % 2) == 0;
+			const BYTE mask = special1 ? 0x03 : 0x05;
+			if (left < 8)
+				return TRUE;
+			Stream_Write_UINT8(s, special1 ? 0xF9 : 0xFA);
+			for (size_t x = 0; x < 8; x++)
+			{
+				if (mask & (1 << x))
+					rle8_put_fg(model, first);
+				else
+					rle8_put_bg(model, first);
+			}
+		}
+		break;
+
+		case 9:
+			Stream_Write_UINT8(s, 0xFD); /* SPECIAL_WHITE */
+			rle8_put(model, 0xFF);
+			break;
+
+		default:
+			Stream_Write_UINT8(s, 0xFE); /* SPECIAL_BLACK */
+			rle8_put(model, 0);
+			break;
+	}
+
+	model->insertFgPel = insertFgPel;
+	return TRUE;
+}
+
+/* The 8bpp decoder expands the same runs as the deeper ones, narrow bitmaps XOR pixel by
+ * pixel, wider ones in blocks */
+static BOOL Test8bppDecode(BITMAP_INTERLEAVED_CONTEXT* decoder)
+{
+	const UINT32 widths[] = { 4, 47, 48, 64, 100 };
+	const UINT32 height = 24;
+	gdiPalette palette = { .format = PIXEL_FORMAT_BGRX32 };
+
+	for (size_t x = 0; x < ARRAYSIZE(palette.palette); x++)
+		palette.palette[x] = FreeRDPGetColor(palette.format, (BYTE)x, 0, 0, 0xFF);
+
+	for (size_t run = 0; run < 20 * ARRAYSIZE(widths); run++)
+	{
+		BOOL rc = FALSE;
+		const UINT32 width = widths[run % ARRAYSIZE(widths)];
+		const size_t dstStep = 4ull * width;
+		Rle8Model model = { .width = width,
+			                .size = 1ull * width * height,
+			                .fgPel = 0xFF,
+			                .firstLine = TRUE };
+		model.image = calloc(model.size, 1);
+		model.s = Stream_New(NULL, 1024);
+		BYTE* dst = calloc(height, dstStep);
+		if (!model.image || !model.s || !dst)
+			goto fail;
+
+		while (model.pos < model.size)
+		{
+			if (!rle8_order(&model))
+				goto fail;
+		}
+
+		if (!interleaved_decompress(decoder, Stream_Buffer(model.s),
+		                            (UINT32)Stream_GetPosition(model.s), width, height, 8, dst,
+		                            PIXEL_FORMAT_BGRX32, (UINT32)dstStep, 0, 0, width, height,
+		                            &palette))
+			goto fail;
+
+		/* the decoder flips the bottom up bitmap */
+		for (size_t y = 0; y < height; y++)
+		{
+			for (size_t px = 0; px < width; px++)
+			{
+				BYTE r = 0;
+				const UINT32 color = FreeRDPReadColor(&dst[y * dstStep + px * 4], palette.format);
+				FreeRDPSplitColor(color, palette.format, &r, NULL, NULL, NULL, NULL);
+				if (r != model.image[(height - 1 - y) * width + px])
+				{
+					(void)fprintf(stderr, "8bpp %" PRIu32 "x%" PRIu32 " mismatch at %" PRIuz
+					                      "x%" PRIuz "\n",
+					              width, height, px, y);
+					goto fail;
+				}
+			}
+		}
+
+		rc = TRUE;
+	fail:
+		free(dst);
+		Stream_Free(model.s, TRUE);
+		free(model.image);
+		if (!rc)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
 static BOOL TestColorConversion(void)
 {
 	const UINT32 formats[] = { PIXEL_FORMAT_RGB15,  PIXEL_FORMAT_BGR15, PIXEL_FORMAT_ABGR15,
@@ -208,9 +678,18 @@ int TestFreeRDPCodecInterleaved(int argc, char* argv[])
 	if (!run_encode_decode(15, encoder, decoder))
 		goto fail;
 
+	if (!run_content_comparison(encoder, decoder))
+		goto fail;
+
 	if (!TestColorConversion())
 		goto fail;
 
+	if (!TestRleSpan())
+		goto fail;
+
+	if (!Test8bppDecode(decoder))
+		goto fail;
+
 	rc = 0;
 fail:
 	bitmap_interleaved_context_free(encoder);
@@ -0,0 +1,264 @@
+#include <freerdp/config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <winpr/crt.h>
+#include <winpr/stream.h>
+#include <winpr/crypto.h>
+
+#include <freerdp/codec/color.h>
+#include <freerdp/codec/nsc.h>
+
+#include "../nsc_types.h"
+#include "../nsc_encode.h"
+
+/* 2x9 BGRX32 filled with 0x66, color loss level 1 with chroma subsampling */
+static const BYTE TEST_NSC_FLAT_2X9[] = {
+	0x07, 0x00, 0x00, 0x00, 0x07, 0x00, 0x00, 0x00, 0x07, 0x00, 0x00, 0x00, 0x07, 0x00, 0x00, 0x00,
+	0x01, 0x01, 0x00, 0x00, 0x65, 0x65, 0x42, 0x65, 0x65, 0x65, 0x65, 0x00, 0x00, 0x0e, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x0e, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0x0c, 0xff, 0xff, 0xff, 0xff
+};
+
+static BOOL TestNscKnownVector(void)
+{
+	BOOL rc = FALSE;
+	BYTE bmp[2 * 9 * 4];
+	NSC_CONTEXT* context = nsc_context_new();
+	wStream* s = Stream_New(NULL, 64);
+
+	printf("%s: ", __func__);
+
+	if (!context || !s)
+		goto fail;
+
+	memset(bmp, 0x66, sizeof(bmp));
+
+	if (!nsc_context_set_parameters(context, NSC_COLOR_FORMAT, PIXEL_FORMAT_BGRX32) ||
+	    !nsc_context_set_parameters(context, NSC_COLOR_LOSS_LEVEL, 1) ||
+	    !nsc_context_set_parameters(context, NSC_ALLOW_SUBSAMPLING, 1))
+		goto fail;
+
+	if (!nsc_compose_message(context, s, bmp, 2, 9, 2 * 4))
+		goto fail;
+
+	if (Stream_GetPosition(s) != sizeof(TEST_NSC_FLAT_2X9))
+		goto fail;
+
+	if (memcmp(Stream_Buffer(s), TEST_NSC_FLAT_2X9, sizeof(TEST_NSC_FLAT_2X9)) != 0)
+		goto fail;
+
+	rc = TRUE;
+fail:
+	printf("%s\n", rc ? "SUCCESS" : "FAIL");
+	Stream_Free(s, TRUE);
+	nsc_context_free(context);
+	return rc;
+}
+
+/**
+ * A luma ramp with a near gray checkerboard on top, so neighbouring pixels have small chroma
+ * values of opposite sign. Averaging those must not move the decoded color.
+ */
+static BOOL TestNscRoundTrip(UINT32 format, UINT32 subsampling, UINT32 width, UINT32 height)
+{
+	BOOL rc = FALSE;
+	const BOOL alpha = FreeRDPColorHasAlpha(format);
+	const size_t stride = 4ull * width;
+	BYTE* bmp = calloc(height, stride);
+	BYTE* decoded = calloc(height, stride);
+	NSC_CONTEXT* encoder = nsc_context_new();
+	NSC_CONTEXT* decoder = nsc_context_new();
+	wStream* s = Stream_New(NULL, 1024);
+
+	printf("%s [%s, %" PRIu32 ", %" PRIu32 "x%" PRIu32 "]: ", __func__,
+	       FreeRDPGetColorFormatName(format), subsampling, width, height);
+
+	if (!bmp || !decoded || !encoder || !decoder || !s)
+		goto fail;
+
+	for (UINT32 y = 0; y < height; y++)
+	{
+		for (UINT32 x = 0; x < width; x++)
+		{
+			const BYTE base = (BYTE)(16 + ((x + 2 * y) % 200));
+			const BYTE d = ((x + y) % 2) ? 2 : 0;
+			const BYTE a = alpha ? (BYTE)(x * 7 + y) : 0xFF;
+			const UINT32 color = FreeRDPGetColor(format, base + d, base + 1, base + 2 - d, a);
+
+			FreeRDPWriteColor(&bmp[y * stride + 4ull * x], format, color);
+		}
+	}
+
+	if (!nsc_context_set_parameters(encoder, NSC_COLOR_FORMAT, format) ||
+	    !nsc_context_set_parameters(encoder, NSC_COLOR_LOSS_LEVEL, 1) ||
+	    !nsc_context_set_parameters(encoder, NSC_ALLOW_SUBSAMPLING, subsampling))
+		goto fail;
+
+	if (!nsc_compose_message(encoder, s, bmp, width, height, (UINT32)stride))
+		goto fail;
+
+	/* The encoder reads the bitmap bottom up */
+	if (!nsc_process_message(decoder, 32, width, height, Stream_Buffer(s),
+	                         (UINT32)Stream_GetPosition(s), decoded, format, (UINT32)stride, 0, 0,
+	                         width, height, FREERDP_FLIP_VERTICAL))
+		goto fail;
+
+	for (UINT32 y = 0; y < height; y++)
+	{
+		for (UINT32 x = 0; x < width; x++)
+		{
+			BYTE sr = 0;
+			BYTE sg = 0;
+			BYTE sb = 0;
+			BYTE sa = 0;
+			BYTE dr = 0;
+			BYTE dg = 0;
+			BYTE db = 0;
+			BYTE da = 0;
+			const size_t offset = y * stride + 4ull * x;
+
+			FreeRDPSplitColor(FreeRDPReadColor(&bmp[offset], format), format, &sr, &sg, &sb, &sa,
+			                  NULL);
+			FreeRDPSplitColor(FreeRDPReadColor(&decoded[offset], format), format, &dr, &dg, &db,
+			                  &da, NULL);
+
+			if ((abs(sr - dr) > 3) || (abs(sg - dg) > 3) || (abs(sb - db) > 3))
+				goto fail;
+
+			if (alpha && (sa != da))
+				goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	printf("%s\n", rc ? "SUCCESS" : "FAIL");
+	Stream_Free(s, TRUE);
+	nsc_context_free(encoder);
+	nsc_context_free(decoder);
+	free(decoded);
+	free(bmp);
+	return rc;
+}
+
+/**
+ * The SSE2 encoder must produce the same stream as the generic one, byte for byte, for every
+ * input format, color loss level and subsampling mode. Flat blocks on random data exercise
+ * both the RLE runs and the raw fallback.
+ */
+static BOOL TestNscEncoders(UINT32 format, UINT32 width, UINT32 height)
+{
+	BOOL rc = FALSE;
+	BYTE palette[256 * 3] = { 0 };
+	const size_t stride = 4ull * width;
+	BYTE* bmp = calloc(height, stride);
+	NSC_CONTEXT* generic = nsc_context_new();
+	NSC_CONTEXT* optimized = nsc_context_new();
+	wStream* sGeneric = Stream_New(NULL, 1024);
+	wStream* sOptimized = Stream_New(NULL, 1024);
+
+	printf("%s [%s, %" PRIu32 "x%" PRIu32 "]: ", __func__, FreeRDPGetColorFormatName(format),
+	       width, height);
+
+	if (!bmp || !generic || !optimized || !sGeneric || !sOptimized)
+		goto fail;
+
+	if (optimized->encode == nsc_encode)
+		printf("(SSE2 encoder not available) ");
+
+	generic->encode = nsc_encode;
+	generic->rle_run = nsc_rle_run;
+	generic->rle_raw = nsc_rle_raw;
+	generic->palette = palette;
+	optimized->palette = palette;
+
+	winpr_RAND(palette, sizeof(palette));
+	winpr_RAND(bmp, height * stride);
+	for (UINT32 y = 0; y < height; y++)
+	{
+		if ((y / 8) % 2)
+			memset(&bmp[y * stride], 0x5A, stride / 2);
+	}
+
+	for (UINT32 colorLoss = 1; colorLoss <= 7; colorLoss++)
+	{
+		for (UINT32 subsampling = 0; subsampling < 2; subsampling++)
+		{
+			NSC_CONTEXT* contexts[] = { generic, optimized };
+			for (size_t x = 0; x < ARRAYSIZE(contexts); x++)
+			{
+				if (!nsc_context_set_parameters(contexts[x], NSC_COLOR_FORMAT, format) ||
+				    !nsc_context_set_parameters(contexts[x], NSC_COLOR_LOSS_LEVEL, colorLoss) ||
+				    !nsc_context_set_parameters(contexts[x], NSC_ALLOW_SUBSAMPLING, subsampling))
+					goto fail;
+			}
+
+			Stream_SetPosition(sGeneric, 0);
+			Stream_SetPosition(sOptimized, 0);
+			if (!nsc_compose_message(generic, sGeneric, bmp, width, height, (UINT32)stride) ||
+			    !nsc_compose_message(optimized, sOptimized, bmp, width, height, (UINT32)stride))
+				goto fail;
+
+			const size_t size = Stream_GetPosition(sGeneric);
+			if ((size != Stream_GetPosition(sOptimized)) ||
+			    (memcmp(Stream_Buffer(sGeneric), Stream_Buffer(sOptimized), size) != 0))
+			{
+				printf("color loss %" PRIu32 ", subsampling %" PRIu32 " differs ", colorLoss,
+				       subsampling);
+				goto fail;
+			}
+		}
+	}
+
+	rc = TRUE;
+fail:
+	printf("%s\n", rc ? "SUCCESS" : "FAIL");
+	Stream_Free(sGeneric, TRUE);
+	Stream_Free(sOptimized, TRUE);
+	nsc_context_free(generic);
+	nsc_context_free(optimized);
+	free(bmp);
+	return rc;
+}
+
+int TestFreeRDPCodecNsc(int argc, char* argv[])
+{
+	const UINT32 formats[] = { PIXEL_FORMAT_BGRX32, PIXEL_FORMAT_BGRA32, PIXEL_FORMAT_RGBX32,
+		                       PIXEL_FORMAT_RGBA32 };
+	const UINT32 encoderFormats[] = { PIXEL_FORMAT_BGRX32, PIXEL_FORMAT_BGRA32,
+		                              PIXEL_FORMAT_RGBX32, PIXEL_FORMAT_RGBA32,
+		                              PIXEL_FORMAT_BGR24,  PIXEL_FORMAT_RGB24,
+		                              PIXEL_FORMAT_BGR16,  PIXEL_FORMAT_RGB16,
+		                              PIXEL_FORMAT_A4,     PIXEL_FORMAT_RGB8 };
+	const UINT32 sizes[][2] = { { 1, 1 }, { 7, 3 }, { 64, 64 }, { 65, 33 }, { 100, 37 } };
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!TestNscKnownVector())
+		return -1;
+
+	for (size_t x = 0; x < ARRAYSIZE(formats); x++)
+	{
+		for (size_t y = 0; y < ARRAYSIZE(sizes); y++)
+		{
+			for (UINT32 subsampling = 0; subsampling < 2; subsampling++)
+			{
+				if (!TestNscRoundTrip(formats[x], subsampling, sizes[y][0], sizes[y][1]))
+					return -2;
+			}
+		}
+	}
+
+	for (size_t x = 0; x < ARRAYSIZE(encoderFormats); x++)
+	{
+		for (size_t y = 0; y < ARRAYSIZE(sizes); y++)
+		{
+			if (!TestNscEncoders(encoderFormats[x], sizes[y][0], sizes[y][1]))
+				return -3;
+		}
+	}
+
+	return 0;
+}
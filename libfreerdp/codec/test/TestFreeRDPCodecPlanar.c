@@ -10,6 +10,9 @@
 #include <freerdp/codec/bitmap.h>
 #include <freerdp/codec/planar.h>
 
+#include "../planar_kernels.h"
+#include "../sse/planar_sse2.h"
+
 /**
  * Experimental Case 01: 64x64 (32bpp)
  */
@@ -5767,6 +5770,273 @@ fail:
 	return rc;
 }
 
+static BOOL TestPlanarKnownVector(void)
+{
+	BOOL rc = FALSE;
+	const UINT32 width = 64;
+	const UINT32 height = 64;
+	const UINT32 format = PIXEL_FORMAT_XRGB32;
+	UINT32 size = 0;
+	BYTE* compressed = NULL;
+	BYTE* bmp = calloc(1ull * width * height, FreeRDPGetBytesPerPixel(format));
+	BYTE* decompressed = calloc(1ull * width * height, FreeRDPGetBytesPerPixel(format));
+	BITMAP_PLANAR_CONTEXT* planar = freerdp_bitmap_planar_context_new(
+	    PLANAR_FORMAT_HEADER_NA | PLANAR_FORMAT_HEADER_RLE, width, height);
+
+	printf("%s: ", __func__);
+
+	if (!bmp || !decompressed || !planar)
+		goto fail;
+
+	for (UINT32 k = 0; k < width * height; k++)
+	{
+		const UINT32 color =
+		    FreeRDPGetColor(format, TEST_64X64_RED_PLANE[k], TEST_64X64_GREEN_PLANE[k],
+		                    TEST_64X64_BLUE_PLANE[k], 0xFF);
+		FreeRDPWriteColor(&bmp[4ull * k], format, color);
+	}
+
+	freerdp_planar_topdown_image(planar, TRUE);
+	compressed = freerdp_bitmap_compress_planar(planar, bmp, format, width, height, 0, NULL, &size);
+
+	if (!compressed || (size != sizeof(TEST_RLE_BITMAP_EXPERIMENTAL_03_RLE)))
+		goto fail;
+
+	/* the planes follow the format header in red, green, blue order */
+	if (memcmp(compressed, TEST_RLE_BITMAP_EXPERIMENTAL_03_RLE, size) != 0)
+		goto fail;
+
+	{
+		const BYTE* plane = &compressed[1];
+		if (memcmp(plane, TEST_64X64_RED_PLANE_RLE, sizeof(TEST_64X64_RED_PLANE_RLE)) != 0)
+			goto fail;
+
+		plane += sizeof(TEST_64X64_RED_PLANE_RLE);
+		if (memcmp(plane, TEST_64X64_GREEN_PLANE_RLE, sizeof(TEST_64X64_GREEN_PLANE_RLE)) != 0)
+			goto fail;
+
+		plane += sizeof(TEST_64X64_GREEN_PLANE_RLE);
+		if (memcmp(plane, TEST_64X64_BLUE_PLANE_RLE, sizeof(TEST_64X64_BLUE_PLANE_RLE)) != 0)
+			goto fail;
+	}
+
+	if (!planar_decompress(planar, compressed, size, width, height, decompressed, format, 0, 0, 0,
+	                       width, height, FALSE))
+		goto fail;
+
+	if (!CompareBitmap(decompressed, format, bmp, format, width, height))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	printf("%s\n", rc ? "SUCCESS" : "FAIL");
+	free(compressed);
+	free(decompressed);
+	free(bmp);
+	freerdp_bitmap_planar_context_free(planar);
+	return rc;
+}
+
+static BOOL TestPlanarKernelsCompare(const char* name, size_t count, size_t offset,
+                                     const BYTE* generic, const BYTE* optimized, size_t size)
+{
+	if (memcmp(generic, optimized, size) == 0)
+		return TRUE;
+
+	(void)fprintf(stderr, "%s differs for %" PRIuz " bytes at offset %" PRIuz "\n", name, count,
+	              offset);
+	return FALSE;
+}
+
+/* The SSE2 plane kernels must match the generic ones for every length and alignment,
+ * including the tails that do not fill a full vector. */
+static BOOL TestPlanarKernels(void)
+{
+	enum
+	{
+		count_max = 75,
+		offset_max = 4
+	};
+	const BYTE positions[][4] = { { 3, 2, 1, 0 },
+		                          { PLANAR_CHANNEL_NONE, 2, 1, 0 },
+		                          { 0, 1, 2, 3 },
+		                          { PLANAR_CHANNEL_NONE, 0, 1, 2 } };
+	BYTE src[4 * (count_max + offset_max)] = { 0 };
+	BYTE prev[count_max + offset_max] = { 0 };
+	BYTE planesGeneric[4][count_max + offset_max] = { 0 };
+	BYTE planesOptimized[4][count_max + offset_max] = { 0 };
+	BYTE dstGeneric[4 * (count_max + offset_max)] = { 0 };
+	BYTE dstOptimized[4 * (count_max + offset_max)] = { 0 };
+	PLANAR_KERNELS generic = { 0 };
+	PLANAR_KERNELS optimized = { 0 };
+
+	printf("%s: ", __func__);
+
+	planar_init_generic(&generic);
+	optimized = generic;
+	planar_init_sse2(&optimized);
+	if (optimized.split32 == generic.split32)
+		printf("(SSE2 kernels not available) ");
+
+	for (size_t run = 0; run < 3; run++)
+	{
+		winpr_RAND(src, sizeof(src));
+		winpr_RAND(prev, sizeof(prev));
+
+		/* runs of equal bytes exercise the run and raw scanners */
+		if (run == 1)
+		{
+			memset(&src[9], 0x42, 51);
+			memcpy(prev, src, sizeof(prev));
+		}
+		else if (run == 2)
+			memset(src, 0, sizeof(src));
+
+		for (size_t offset = 0; offset < offset_max; offset++)
+		{
+			for (size_t count = 0; count <= count_max; count++)
+			{
+				const BYTE* data = &src[offset];
+
+				for (size_t p = 0; p < ARRAYSIZE(positions); p++)
+				{
+					const BYTE* pos = positions[p];
+
+					memset(planesGeneric, 0, sizeof(planesGeneric));
+					memset(planesOptimized, 0, sizeof(planesOptimized));
+					generic.split32(&src[4 * offset], count, pos, planesGeneric[0],
+					                planesGeneric[1], planesGeneric[2], planesGeneric[3]);
+					optimized.split32(&src[4 * offset], count, pos, planesOptimized[0],
+					                  planesOptimized[1], planesOptimized[2], planesOptimized[3]);
+					if (!TestPlanarKernelsCompare("split32", count, offset, &planesGeneric[0][0],
+					                              &planesOptimized[0][0], sizeof(planesGeneric)))
+						return FALSE;
+
+					/* merging always writes a real alpha byte */
+					for (size_t withAlpha = 0;
+					     (pos[0] != PLANAR_CHANNEL_NONE) && (withAlpha < 2); withAlpha++)
+					{
+						const BYTE* a = withAlpha ? &data[3] : NULL;
+
+						memset(dstGeneric, 0x11, sizeof(dstGeneric));
+						memset(dstOptimized, 0x11, sizeof(dstOptimized));
+						generic.merge32(a, &data[0], &data[1], &data[2], 0x80, count, pos,
+						                &dstGeneric[4 * offset]);
+						optimized.merge32(a, &data[0], &data[1], &data[2], 0x80, count, pos,
+						                  &dstOptimized[4 * offset]);
+						if (!TestPlanarKernelsCompare("merge32", count, offset, dstGeneric,
+						                              dstOptimized, sizeof(dstGeneric)))
+							return FALSE;
+					}
+				}
+
+				memset(dstGeneric, 0, sizeof(dstGeneric));
+				memset(dstOptimized, 0, sizeof(dstOptimized));
+				generic.delta(data, &prev[offset], dstGeneric, count);
+				optimized.delta(data, &prev[offset], dstOptimized, count);
+				if (!TestPlanarKernelsCompare("delta", count, offset, dstGeneric, dstOptimized,
+				                              sizeof(dstGeneric)))
+					return FALSE;
+
+				/* undelta runs in place and must restore the input */
+				optimized.undelta(dstOptimized, &prev[offset], dstOptimized, count);
+				generic.undelta(dstGeneric, &prev[offset], dstGeneric, count);
+				if (!TestPlanarKernelsCompare("undelta", count, offset, dstGeneric, dstOptimized,
+				                              sizeof(dstGeneric)) ||
+				    (memcmp(dstGeneric, data, count) != 0))
+					return FALSE;
+
+				/* raw reads the byte before the data */
+				const BYTE* scan = &src[offset + 1];
+				if ((generic.run(scan, count, scan[0]) != optimized.run(scan, count, scan[0])) ||
+				    (generic.run(scan, count, 0) != optimized.run(scan, count, 0)) ||
+				    (generic.raw(scan, count) != optimized.raw(scan, count)))
+				{
+					(void)fprintf(stderr, "run/raw differ for %" PRIuz " bytes at offset %" PRIuz
+					                      "\n",
+					              count, offset);
+					return FALSE;
+				}
+			}
+		}
+	}
+
+	printf("SUCCESS\n");
+	return TRUE;
+}
+
+static BOOL TestPlanarThreading(void)
+{
+	BOOL rc = FALSE;
+	const UINT32 width = 1024;
+	const UINT32 height = 768;
+	const UINT32 format = PIXEL_FORMAT_BGRX32;
+	const DWORD planarFlags = PLANAR_FORMAT_HEADER_NA | PLANAR_FORMAT_HEADER_RLE;
+	UINT32 size = 0;
+	UINT32 sizeSerial = 0;
+	BYTE* compressed = NULL;
+	BYTE* compressedSerial = NULL;
+	BYTE* bmp = calloc(1ull * width * height, FreeRDPGetBytesPerPixel(format));
+	BYTE* decompressed = calloc(1ull * width * height, FreeRDPGetBytesPerPixel(format));
+	/* force the plane workers, a single CPU would otherwise encode serially */
+	BITMAP_PLANAR_CONTEXT* planar = planar_context_new_ex(planarFlags, width, height, 0, TRUE);
+	BITMAP_PLANAR_CONTEXT* serial = freerdp_bitmap_planar_context_new_ex(
+	    planarFlags, width, height, THREADING_FLAGS_DISABLE_THREADS);
+
+	printf("%s: ", __func__);
+
+	if (!bmp || !decompressed || !planar || !serial)
+		goto fail;
+
+	/* gradients, flat blocks and a noisy strip to exercise raw and run sequences */
+	for (UINT32 y = 0; y < height; y++)
+	{
+		for (UINT32 x = 0; x < width; x++)
+		{
+			UINT32 color = 0;
+
+			if (x < width / 3)
+				color = FreeRDPGetColor(format, x & 0xFF, y & 0xFF, (x + y) & 0xFF, 0xFF);
+			else if (x < 2 * width / 3)
+				color = ((x / 32 + y / 16) % 2) ? 0xFF2060A0 : 0xFFE0E0E0;
+			else
+				color = prand(UINT32_MAX);
+
+			FreeRDPWriteColor(&bmp[4ull * (1ull * y * width + x)], format, color);
+		}
+	}
+
+	freerdp_planar_topdown_image(planar, TRUE);
+	freerdp_planar_topdown_image(serial, TRUE);
+	compressed = freerdp_bitmap_compress_planar(planar, bmp, format, width, height, 0, NULL, &size);
+	compressedSerial = freerdp_bitmap_compress_planar(serial, bmp, format, width, height, 0, NULL,
+	                                                  &sizeSerial);
+
+	if (!compressed || !compressedSerial || (size != sizeSerial))
+		goto fail;
+
+	if (memcmp(compressed, compressedSerial, size) != 0)
+		goto fail;
+
+	if (!planar_decompress(planar, compressed, size, width, height, decompressed, format, 0, 0, 0,
+	                       width, height, FALSE))
+		goto fail;
+
+	if (!CompareBitmap(decompressed, format, bmp, format, width, height))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	printf("%s\n", rc ? "SUCCESS" : "FAIL");
+	free(compressed);
+	free(compressedSerial);
+	free(decompressed);
+	free(bmp);
+	freerdp_bitmap_planar_context_free(planar);
+	freerdp_bitmap_planar_context_free(serial);
+	return rc;
+}
+
 int TestFreeRDPCodecPlanar(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -5775,6 +6045,15 @@ int TestFreeRDPCodecPlanar(int argc, char* argv[])
 	if (!FuzzPlanar())
 		return -2;
 
+	if (!TestPlanarKnownVector())
+		return -3;
+
+	if (!TestPlanarThreading())
+		return -4;
+
+	if (!TestPlanarKernels())
+		return -5;
+
 	for (UINT32 x = 0; x < colorFormatCount; x++)
 	{
 		if (!TestPlanar(colorFormatList[x]))
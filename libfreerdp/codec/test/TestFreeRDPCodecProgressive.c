@@ -1114,6 +1114,163 @@ fail:
 	return res;
 }
 
+static BOOL compare_image(const wImage* image, const BYTE* resultData, UINT32 ColorFormat)
+{
+	for (UINT32 y = 0; y < image->height; y++)
+	{
+		const BYTE* orig = &image->data[y * image->scanline];
+		const BYTE* dec = &resultData[y * image->scanline];
+		for (UINT32 x = 0; x < image->width; x++)
+		{
+			const DWORD a = FreeRDPReadColor(&orig[x * 4], ColorFormat);
+			const DWORD b = FreeRDPReadColor(&dec[x * 4], ColorFormat);
+			if (!colordiff(ColorFormat, a, b))
+			{
+				printf("xxxxxxx [%u:%u] [%s] %08X != %08X\n", x, y,
+				       FreeRDPGetColorFormatName(ColorFormat), a, b);
+				return FALSE;
+			}
+		}
+	}
+	return TRUE;
+}
+
+/* Decode upgrade passes until the encoder has no tiles left to refine */
+static BOOL refine_decode(PROGRESSIVE_CONTEXT* progressiveEnc, PROGRESSIVE_CONTEXT* progressiveDec,
+                          const wImage* image, BYTE* resultData, UINT32 ColorFormat,
+                          UINT32* frameId, size_t* passes)
+{
+	for (;;)
+	{
+		BYTE* dstData = NULL;
+		UINT32 dstSize = 0;
+		REGION16 invalidRegion = { 0 };
+
+		const int rc = progressive_compress_upgrade(progressiveEnc, 16 * 1024, &dstData, &dstSize);
+		if (rc < 0)
+			return FALSE;
+		if (rc == 0)
+			break;
+
+		region16_init(&invalidRegion);
+		const INT32 status =
+		    progressive_decompress(progressiveDec, dstData, dstSize, resultData, ColorFormat,
+		                           image->scanline, 0, 0, &invalidRegion, 0, (*frameId)++);
+		region16_uninit(&invalidRegion);
+		if (status < 0)
+			return FALSE;
+		(*passes)++;
+	}
+
+	return progressive_compress_pending(progressiveEnc) == 0;
+}
+
+static BOOL test_encode_decode_refinement(const char* path)
+{
+	BOOL res = FALSE;
+	int rc = 0;
+	size_t passes = 0;
+	UINT32 frameId = 0;
+	BYTE* resultData = NULL;
+	BYTE* dstData = NULL;
+	UINT32 dstSize = 0;
+	UINT32 firstSize = 0;
+	UINT32 ColorFormat = PIXEL_FORMAT_BGRX32;
+	REGION16 invalidRegion = { 0 };
+	RECTANGLE_16 damage = { 70, 10, 90, 30 };
+	wImage* image = winpr_image_new();
+	char* name = GetCombinedPath(path, "progressive.bmp");
+	PROGRESSIVE_CONTEXT* progressiveEnc = progressive_context_new(TRUE);
+	PROGRESSIVE_CONTEXT* progressiveDec = progressive_context_new(FALSE);
+
+	region16_init(&invalidRegion);
+	if (!image || !name || !progressiveEnc || !progressiveDec)
+		goto fail;
+
+	if (progressive_context_set_refinement(progressiveDec, TRUE))
+		goto fail;
+	if (!progressive_context_set_refinement(progressiveEnc, TRUE))
+		goto fail;
+
+	rc = winpr_image_read(image, name);
+	if (rc <= 0)
+		goto fail;
+
+	resultData = calloc(image->scanline, image->height);
+	if (!resultData)
+		goto fail;
+
+	rc = progressive_create_surface_context(progressiveDec, 0, image->width, image->height);
+	if (rc <= 0)
+		goto fail;
+
+	// First pass of all tiles, then refine to full quality
+	rc = progressive_compress(progressiveEnc, image->data, image->scanline * image->height,
+	                          ColorFormat, image->width, image->height, image->scanline, NULL,
+	                          &dstData, &dstSize);
+	if (rc <= 0)
+		goto fail;
+	firstSize = dstSize;
+
+	rc = progressive_decompress(progressiveDec, dstData, dstSize, resultData, ColorFormat,
+	                            image->scanline, 0, 0, &invalidRegion, 0, frameId++);
+	if (rc < 0)
+		goto fail;
+
+	if (!refine_decode(progressiveEnc, progressiveDec, image, resultData, ColorFormat, &frameId,
+	                   &passes))
+		goto fail;
+	if (passes < 4)
+	{
+		printf("expected at least 4 refinement passes, got %" PRIuz "\n", passes);
+		goto fail;
+	}
+	if (!compare_image(image, resultData, ColorFormat))
+		goto fail;
+
+	// Unchanged content must not produce any data
+	rc = progressive_compress(progressiveEnc, image->data, image->scanline * image->height,
+	                          ColorFormat, image->width, image->height, image->scanline, NULL,
+	                          &dstData, &dstSize);
+	if (rc != 0)
+		goto fail;
+
+	// A small change is sent and refined for the touched tiles only
+	for (UINT32 y = damage.top; y < damage.bottom; y++)
+	{
+		BYTE* line = &image->data[y * image->scanline];
+		for (UINT32 x = damage.left; x < damage.right; x++)
+			FreeRDPWriteColor(&line[x * 4], ColorFormat, FreeRDPGetColor(ColorFormat, x, y, 0, 0));
+	}
+
+	rc = progressive_compress(progressiveEnc, image->data, image->scanline * image->height,
+	                          ColorFormat, image->width, image->height, image->scanline, NULL,
+	                          &dstData, &dstSize);
+	if ((rc <= 0) || (dstSize >= firstSize) || (progressive_compress_pending(progressiveEnc) != 1))
+		goto fail;
+
+	rc = progressive_decompress(progressiveDec, dstData, dstSize, resultData, ColorFormat,
+	                            image->scanline, 0, 0, &invalidRegion, 0, frameId++);
+	if (rc < 0)
+		goto fail;
+
+	if (!refine_decode(progressiveEnc, progressiveDec, image, resultData, ColorFormat, &frameId,
+	                   &passes))
+		goto fail;
+	if (!compare_image(image, resultData, ColorFormat))
+		goto fail;
+
+	res = TRUE;
+fail:
+	region16_uninit(&invalidRegion);
+	progressive_context_free(progressiveEnc);
+	progressive_context_free(progressiveDec);
+	winpr_image_free(image, TRUE);
+	free(resultData);
+	free(name);
+	return res;
+}
+
 static BOOL read_cmd(FILE* fp, RDPGFX_SURFACE_COMMAND* cmd, UINT32* frameId)
 {
 	WINPR_ASSERT(fp);
@@ -1485,6 +1642,8 @@ int TestFreeRDPCodecProgressive(int argc, char* argv[])
 		    */
 		if (!test_encode_decode(ms_sample_path))
 			goto fail;
+		if (!test_encode_decode_refinement(ms_sample_path))
+			goto fail;
 		rc = 0;
 	}
 
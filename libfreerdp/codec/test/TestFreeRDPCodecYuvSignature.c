@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <winpr/crt.h>
+#include <winpr/crypto.h>
+
+#include <freerdp/codec/color.h>
+#include <freerdp/codec/yuv.h>
+
+#include "../yuv_signature.h"
+#include "../sse/yuv_sse2.h"
+
+#define TEST_WIDTH 200
+#define TEST_HEIGHT 66
+
+/* The SSE2 row signature must match the generic one bit for bit, including the tails that
+ * do not fill a full vector. */
+static BOOL test_row_kernels(void)
+{
+	BYTE data[4 * YUV_SIGNATURE_BLOCK_SIZE + 7] = { 0 };
+	YUV_SIGNATURE_KERNELS generic = { 0 };
+	YUV_SIGNATURE_KERNELS optimized = { 0 };
+
+	yuv_signature_init_generic(&generic);
+	optimized = generic;
+	yuv_signature_init_sse2(&optimized);
+	if (optimized.row == generic.row)
+		(void)fprintf(stderr, "SSE2 signatures not available, comparing generic only\n");
+
+	for (size_t run = 0; run < 3; run++)
+	{
+		winpr_RAND(data, sizeof(data));
+
+		/* runs of equal bytes exercise the flat counter */
+		if (run == 1)
+			memset(&data[13], 0x42, 77);
+		else if (run == 2)
+			memset(data, 0, sizeof(data));
+
+		for (size_t length = 0; length <= sizeof(data); length++)
+		{
+			UINT32 flatGeneric = 0;
+			UINT32 flatOptimized = 0;
+			YUV_SIGNATURE hashGeneric = { 0 };
+			YUV_SIGNATURE hashOptimized = { 0 };
+			YUV_SIGNATURE hashNoFlat = { 0 };
+
+			generic.row(data, length, &hashGeneric, &flatGeneric);
+			optimized.row(data, length, &hashOptimized, &flatOptimized);
+			if ((hashGeneric.lo != hashOptimized.lo) || (hashGeneric.hi != hashOptimized.hi) ||
+			    (flatGeneric != flatOptimized))
+			{
+				(void)fprintf(stderr,
+				              "length %" PRIuz ": signature 0x%016" PRIx64 "%016" PRIx64
+				              " != 0x%016" PRIx64 "%016" PRIx64 ", flat %" PRIu32 " != %" PRIu32
+				              "\n",
+				              length, hashGeneric.hi, hashGeneric.lo, hashOptimized.hi,
+				              hashOptimized.lo, flatGeneric, flatOptimized);
+				return FALSE;
+			}
+
+			generic.row(data, length, &hashNoFlat, NULL);
+			if ((hashNoFlat.lo != hashGeneric.lo) || (hashNoFlat.hi != hashGeneric.hi))
+				return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/* Both halves must change for changes confined to the words of a single lane, which a
+ * single set of lanes only covers with 32 bits */
+static BOOL test_row_lanes(void)
+{
+	BYTE data[YUV_SIGNATURE_BLOCK_SIZE] = { 0 };
+	YUV_SIGNATURE_KERNELS kernels = { 0 };
+	YUV_SIGNATURE base = { 0 };
+
+	yuv_signature_init_generic(&kernels);
+	winpr_RAND(data, sizeof(data));
+	kernels.row(data, sizeof(data), &base, NULL);
+
+	for (size_t x = 0; x < 4096; x++)
+	{
+		YUV_SIGNATURE hash = { 0 };
+		BYTE changed[YUV_SIGNATURE_BLOCK_SIZE] = { 0 };
+		UINT32 word[2] = { 0 };
+
+		memcpy(changed, data, sizeof(changed));
+		winpr_RAND(word, sizeof(word));
+		if ((word[0] == 0) && (word[1] == 0))
+			continue;
+
+		/* two words of lane 1 in different chunks */
+		changed[4] ^= (BYTE)(word[0] | 1);
+		changed[5] ^= (BYTE)(word[0] >> 8);
+		changed[36] ^= (BYTE)word[1];
+		changed[37] ^= (BYTE)(word[1] >> 8);
+
+		kernels.row(changed, sizeof(changed), &hash, NULL);
+		if ((hash.lo == base.lo) || (hash.hi == base.hi))
+		{
+			(void)fprintf(stderr, "change %" PRIuz " kept half of the signature\n", x);
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+static size_t test_count_changed(const YUV_SIGNATURE_MAP* map)
+{
+	size_t count = 0;
+	for (size_t x = 0; x < 1ull * map->blocksPerRow * map->height; x++)
+		count += map->changed[x];
+	return count;
+}
+
+static BOOL test_encode(YUV_CONTEXT* context, const BYTE* src, UINT32 srcStep,
+                        const UINT32 iStride[3], BYTE* pYUVData[3], YUV_SIGNATURE_MAP* map)
+{
+	const RECTANGLE_16 rect = { 0, 0, TEST_WIDTH, TEST_HEIGHT };
+	return yuv420_context_encode_signed(context, src, srcStep, PIXEL_FORMAT_BGRX32, iStride,
+	                                    pYUVData, &rect, map);
+}
+
+/* Changes are found from the signatures alone, a segment with the same content at another
+ * position does not share its signature. */
+static BOOL test_change_detection(void)
+{
+	BOOL rc = FALSE;
+	const UINT32 bpp = FreeRDPGetBytesPerPixel(PIXEL_FORMAT_BGRX32);
+	const UINT32 srcStep = TEST_WIDTH * bpp;
+	const UINT32 iStride[3] = { TEST_WIDTH, TEST_WIDTH / 2, TEST_WIDTH / 2 };
+	BYTE* pYUVData[3] = { 0 };
+	YUV_SIGNATURE_MAP map = { 0 };
+
+	BYTE* src = calloc(TEST_HEIGHT, srcStep);
+	YUV_CONTEXT* context = yuv_context_new(TRUE, 0);
+	if (!src || !context || !yuv_context_reset(context, TEST_WIDTH, TEST_HEIGHT))
+		goto fail;
+
+	for (size_t x = 0; x < 3; x++)
+	{
+		pYUVData[x] = calloc(TEST_HEIGHT, iStride[x]);
+		if (!pYUVData[x])
+			goto fail;
+	}
+
+	if (!yuv_signature_map_reset(&map, TEST_WIDTH, TEST_HEIGHT))
+		goto fail;
+
+	/* a flat frame, every segment of a row holds the same bytes */
+	memset(src, 0x80, 1ull * TEST_HEIGHT * srcStep);
+	if (!test_encode(context, src, srcStep, iStride, pYUVData, &map))
+		goto fail;
+	if (test_count_changed(&map) != 1ull * map.blocksPerRow * map.height)
+		goto fail;
+
+	const YUV_SIGNATURE* first = &map.hashes[2ull * map.blocksPerRow];
+	if (((first[0].lo == first[1].lo) && (first[0].hi == first[1].hi)) ||
+	    ((first[0].lo == map.hashes[0].lo) && (first[0].hi == map.hashes[0].hi)))
+	{
+		(void)fprintf(stderr, "equal segments at different positions share a signature\n");
+		goto fail;
+	}
+
+	winpr_RAND(src, 1ull * TEST_HEIGHT * srcStep);
+	if (!test_encode(context, src, srcStep, iStride, pYUVData, &map))
+		goto fail;
+
+	/* the same frame again changes nothing */
+	if (!test_encode(context, src, srcStep, iStride, pYUVData, &map))
+		goto fail;
+	if (test_count_changed(&map) != 0)
+		goto fail;
+
+	/* a single pixel changes its luma segment and the one of the even row holding its chroma */
+	const size_t offset = 7ull * srcStep + 130ull * bpp;
+	src[offset] ^= 0xFF;
+	src[offset + 1] ^= 0xFF;
+	if (!test_encode(context, src, srcStep, iStride, pYUVData, &map))
+		goto fail;
+	if ((test_count_changed(&map) != 2) ||
+	    !map.changed[6ull * map.blocksPerRow + 130 / YUV_SIGNATURE_BLOCK_SIZE] ||
+	    !map.changed[7ull * map.blocksPerRow + 130 / YUV_SIGNATURE_BLOCK_SIZE])
+	{
+		(void)fprintf(stderr, "single pixel: %" PRIuz " segments changed\n",
+		              test_count_changed(&map));
+		goto fail;
+	}
+
+	/* small changes anywhere are all found */
+	for (size_t x = 0; x < 256; x++)
+	{
+		UINT32 pos[2] = { 0 };
+		winpr_RAND(pos, sizeof(pos));
+
+		const size_t px = pos[0] % TEST_WIDTH;
+		const size_t py = pos[1] % TEST_HEIGHT;
+		BYTE* pixel = &src[py * srcStep + px * bpp];
+		pixel[x % 3] ^= 0x80;
+		if (!test_encode(context, src, srcStep, iStride, pYUVData, &map))
+			goto fail;
+		if (!map.changed[py * map.blocksPerRow + px / YUV_SIGNATURE_BLOCK_SIZE])
+		{
+			(void)fprintf(stderr, "change at %" PRIuz "x%" PRIuz " not detected\n", px, py);
+			goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	yuv_signature_map_uninit(&map);
+	for (size_t x = 0; x < 3; x++)
+		free(pYUVData[x]);
+	yuv_context_free(context);
+	free(src);
+	return rc;
+}
+
+int TestFreeRDPCodecYuvSignature(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!test_row_kernels())
+	{
+		(void)fprintf(stderr, "test_row_kernels failed\n");
+		return -1;
+	}
+
+	if (!test_row_lanes())
+	{
+		(void)fprintf(stderr, "test_row_lanes failed\n");
+		return -1;
+	}
+
+	if (!test_change_detection())
+	{
+		(void)fprintf(stderr, "test_change_detection failed\n");
+		return -1;
+	}
+	return 0;
+}
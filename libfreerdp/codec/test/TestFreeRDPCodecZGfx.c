@@ -1,6 +1,7 @@
 #include <winpr/crt.h>
 #include <winpr/print.h>
 #include <winpr/bitstream.h>
+#include <winpr/crypto.h>
 
 #include <freerdp/freerdp.h>
 #include <freerdp/codec/zgfx.h>
@@ -253,6 +254,73 @@ fail:
 	return rc;
 }
 
+/* Chunks as sent on a dynamic channel, text must shrink and random data must survive */
+static int test_ZGfxCompressLite(void)
+{
+	int rc = -1;
+	const size_t chunkSize = 1590;
+	const size_t count = 40;
+	size_t total = 0;
+	size_t compressedTotal = 0;
+	BYTE* data = malloc(chunkSize * count);
+	ZGFX_CONTEXT* compressor = zgfx_context_new_lite(TRUE);
+	ZGFX_CONTEXT* decompressor = zgfx_context_new_lite(FALSE);
+	wStream* sCompressed = Stream_New(NULL, 2 * chunkSize);
+	wStream* sDecompressed = Stream_New(NULL, chunkSize);
+
+	if (!data || !compressor || !decompressor || !sCompressed || !sDecompressed)
+		goto fail;
+
+	for (size_t x = 0; x < chunkSize * count; x++)
+		data[x] = TEST_FOX_DATA[(x * 7 / 5) % (sizeof(TEST_FOX_DATA) - 1)];
+	winpr_RAND(&data[chunkSize * 3], chunkSize);
+
+	for (size_t x = 0; x < count; x++)
+	{
+		const BYTE* chunk = &data[x * chunkSize];
+		const UINT32 size = (UINT32)(chunkSize - x);
+
+		Stream_SetPosition(sCompressed, 0);
+		Stream_SetPosition(sDecompressed, 0);
+
+		if (!zgfx_compress_bulk(compressor, chunk, size, sCompressed))
+			goto fail;
+
+		const BYTE header = Stream_Buffer(sCompressed)[0];
+		if ((header & 0x0F) != ZGFX_PACKET_COMPR_TYPE_RDP8_LITE)
+			goto fail;
+		if ((x == 3) && (header & PACKET_COMPRESSED))
+			goto fail;
+
+		if (!zgfx_decompress_bulk(decompressor, Stream_Buffer(sCompressed),
+		                          (UINT32)Stream_GetPosition(sCompressed), sDecompressed))
+			goto fail;
+
+		if ((Stream_GetPosition(sDecompressed) != size) ||
+		    (memcmp(Stream_Buffer(sDecompressed), chunk, size) != 0))
+		{
+			printf("RDP8 Lite chunk %" PRIuz " does not match\n", x);
+			goto fail;
+		}
+
+		total += size;
+		compressedTotal += Stream_GetPosition(sCompressed);
+	}
+
+	printf("RDP8 Lite: %" PRIuz " bytes compressed to %" PRIuz "\n", total, compressedTotal);
+	if (compressedTotal * 4 > total)
+		goto fail;
+
+	rc = 0;
+fail:
+	Stream_Free(sDecompressed, TRUE);
+	Stream_Free(sCompressed, TRUE);
+	zgfx_context_free(decompressor);
+	zgfx_context_free(compressor);
+	free(data);
+	return rc;
+}
+
 int TestFreeRDPCodecZGfx(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -270,5 +338,8 @@ int TestFreeRDPCodecZGfx(int argc, char* argv[])
 	if (test_ZGfxCompressConsistent() < 0)
 		return -1;
 
+	if (test_ZGfxCompressLite() < 0)
+		return -1;
+
 	return 0;
 }
@@ -19,6 +19,7 @@
 
 #include <winpr/crt.h>
 #include <winpr/print.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/codec/region.h>
 
@@ -815,6 +816,260 @@ out:
 	return retCode;
 }
 
+static UINT32 test_random(UINT32* state)
+{
+	*state = *state * 1103515245u + 12345u;
+	return (*state >> 8) & 0xFFFF;
+}
+
+static void fill_random_rects(RECTANGLE_16* rects, UINT32 count, UINT16 maxSize, UINT32* state)
+{
+	for (UINT32 i = 0; i < count; i++)
+	{
+		rects[i].left = (UINT16)(test_random(state) % 1024);
+		rects[i].top = (UINT16)(test_random(state) % 768);
+		rects[i].right = (UINT16)(rects[i].left + test_random(state) % maxSize);
+		rects[i].bottom = (UINT16)(rects[i].top + test_random(state) % maxSize);
+	}
+}
+
+/* the coverage of both regions must match, region must be in y-x-banded form without touching
+ * items. region16_union_rect() does not always merge items touching on the right, so the
+ * rectangles of expected may differ.
+ */
+static BOOL compareRegions(const REGION16* region, const REGION16* expected)
+{
+	BOOL rc = FALSE;
+	const RECTANGLE_16* extents = region16_extents(expected);
+	const size_t width = extents->right;
+	const size_t height = extents->bottom;
+	UINT32 nbRects = 0;
+	UINT32 nbExpected = 0;
+	const RECTANGLE_16* rects = region16_rects(region, &nbRects);
+	const RECTANGLE_16* expectedRects = region16_rects(expected, &nbExpected);
+
+	if (!compareRectangles(region16_extents(region), extents, 1))
+		return FALSE;
+
+	BYTE* coverage = calloc(width * height + 1, 1);
+	if (!coverage)
+		return FALSE;
+
+	for (UINT32 i = 1; i < nbRects; i++)
+	{
+		const RECTANGLE_16* prev = &rects[i - 1];
+		const RECTANGLE_16* cur = &rects[i];
+		const BOOL sameBand = (cur->top == prev->top) && (cur->bottom == prev->bottom);
+
+		if ((sameBand && (cur->left <= prev->right)) || (!sameBand && (cur->top < prev->bottom)))
+		{
+			fprintf(stderr, "rect %" PRIu32 " breaks the banding\n", i);
+			goto out;
+		}
+	}
+
+	for (UINT32 i = 0; i < nbExpected; i++)
+	{
+		for (size_t y = expectedRects[i].top; y < expectedRects[i].bottom; y++)
+			memset(&coverage[y * width + expectedRects[i].left], 1,
+			       expectedRects[i].right - expectedRects[i].left);
+	}
+
+	for (UINT32 i = 0; i < nbRects; i++)
+	{
+		for (size_t y = rects[i].top; y < rects[i].bottom; y++)
+		{
+			for (size_t x = rects[i].left; x < rects[i].right; x++)
+			{
+				if (coverage[y * width + x] != 1)
+				{
+					fprintf(stderr, "pixel %" PRIuz "x%" PRIuz " is not expected\n", x, y);
+					goto out;
+				}
+
+				coverage[y * width + x] = 2;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < width * height; i++)
+	{
+		if (coverage[i] == 1)
+		{
+			fprintf(stderr, "pixel %" PRIuz "x%" PRIuz " is missing\n", i % width, i / width);
+			goto out;
+		}
+	}
+
+	rc = TRUE;
+out:
+	free(coverage);
+	return rc;
+}
+
+static int test_union_rects(void)
+{
+	int retCode = -1;
+	UINT32 state = 42;
+	RECTANGLE_16 rects[200] = { 0 };
+	REGION16 bulk;
+	REGION16 incremental;
+	region16_init(&bulk);
+	region16_init(&incremental);
+
+	for (UINT32 round = 0; round < 20; round++)
+	{
+		const UINT32 count = 1 + round * 10;
+		fill_random_rects(rects, count, (round % 2) ? 300 : 40, &state);
+
+		/* rounds alternate between a fresh and an accumulated source region */
+		if (round % 4 == 0)
+		{
+			region16_clear(&bulk);
+			region16_clear(&incremental);
+		}
+
+		for (UINT32 i = 0; i < count; i++)
+		{
+			if (!rectangle_is_empty(&rects[i]) &&
+			    !region16_union_rect(&incremental, &incremental, &rects[i]))
+				goto out;
+		}
+
+		if (!region16_union_rects(&bulk, &bulk, rects, count))
+			goto out;
+
+		if (!compareRegions(&bulk, &incremental))
+		{
+			fprintf(stderr, "%s: round %" PRIu32 " differs\n", __func__, round);
+			goto out;
+		}
+	}
+
+	retCode = 0;
+out:
+	region16_uninit(&bulk);
+	region16_uninit(&incremental);
+	return retCode;
+}
+
+static int test_intersect_rects(void)
+{
+	int retCode = -1;
+	UINT32 state = 1234;
+	RECTANGLE_16 rects[64] = { 0 };
+	REGION16 src;
+	REGION16 clip;
+	REGION16 bulk;
+	REGION16 piece;
+	REGION16 incremental;
+	region16_init(&src);
+	region16_init(&clip);
+	region16_init(&bulk);
+	region16_init(&piece);
+	region16_init(&incremental);
+
+	for (UINT32 round = 0; round < 10; round++)
+	{
+		const RECTANGLE_16* clipRects = NULL;
+		UINT32 nbClipRects = 0;
+
+		fill_random_rects(rects, ARRAYSIZE(rects), 200, &state);
+		region16_clear(&src);
+		region16_clear(&clip);
+		region16_clear(&incremental);
+
+		if (!region16_union_rects(&src, &src, rects, ARRAYSIZE(rects) / 2) ||
+		    !region16_union_rects(&clip, &clip, &rects[ARRAYSIZE(rects) / 2],
+		                          ARRAYSIZE(rects) / 2))
+			goto out;
+
+		/* src & (r1 + ... + rn) is the union of src & ri over the bands of the clip region */
+		clipRects = region16_rects(&clip, &nbClipRects);
+
+		for (UINT32 i = 0; i < nbClipRects; i++)
+		{
+			const RECTANGLE_16* pieceRects = NULL;
+			UINT32 nbPieceRects = 0;
+
+			if (!region16_intersect_rect(&piece, &src, &clipRects[i]))
+				goto out;
+
+			pieceRects = region16_rects(&piece, &nbPieceRects);
+
+			for (UINT32 j = 0; j < nbPieceRects; j++)
+			{
+				if (!region16_union_rect(&incremental, &incremental, &pieceRects[j]))
+					goto out;
+			}
+		}
+
+		if (!region16_intersect_rects(&bulk, &src, &rects[ARRAYSIZE(rects) / 2],
+		                              ARRAYSIZE(rects) / 2))
+			goto out;
+
+		if (!compareRegions(&bulk, &incremental))
+		{
+			fprintf(stderr, "%s: round %" PRIu32 " differs\n", __func__, round);
+			goto out;
+		}
+	}
+
+	retCode = 0;
+out:
+	region16_uninit(&src);
+	region16_uninit(&clip);
+	region16_uninit(&bulk);
+	region16_uninit(&piece);
+	region16_uninit(&incremental);
+	return retCode;
+}
+
+static int test_bulk_benchmark(void)
+{
+	int retCode = -1;
+	UINT32 state = 99;
+	const UINT32 count = 2000;
+	RECTANGLE_16* rects = calloc(count, sizeof(RECTANGLE_16));
+	REGION16 bulk;
+	REGION16 incremental;
+	region16_init(&bulk);
+	region16_init(&incremental);
+
+	if (!rects)
+		goto out;
+
+	fill_random_rects(rects, count, 64, &state);
+
+	const UINT64 start = winpr_GetTickCount64NS();
+
+	for (UINT32 i = 0; i < count; i++)
+	{
+		if (!rectangle_is_empty(&rects[i]) &&
+		    !region16_union_rect(&incremental, &incremental, &rects[i]))
+			goto out;
+	}
+
+	const UINT64 mid = winpr_GetTickCount64NS();
+
+	if (!region16_union_rects(&bulk, &bulk, rects, count))
+		goto out;
+
+	const UINT64 end = winpr_GetTickCount64NS();
+
+	if (!compareRegions(&bulk, &incremental))
+		goto out;
+
+	printf("%" PRIu32 " rects -> %d: region16_union_rect %8.2f ms, region16_union_rects %8.2f ms\n",
+	       count, region16_n_rects(&bulk), (mid - start) / 1000000.0, (end - mid) / 1000000.0);
+	retCode = 0;
+out:
+	region16_uninit(&bulk);
+	region16_uninit(&incremental);
+	free(rects);
+	return retCode;
+}
+
 typedef int (*TestFunction)(void);
 struct UnitaryTest
 {
@@ -836,6 +1091,9 @@ static struct UnitaryTest tests[] = { { "Basic trivial tests", test_basic },
 	                                  { "norbert's case", test_norbert_case },
 	                                  { "norbert's case 2", test_norbert2_case },
 	                                  { "empty rectangle case", test_empty_rectangle },
+	                                  { "bulk union", test_union_rects },
+	                                  { "bulk intersection", test_intersect_rects },
+	                                  { "bulk union benchmark", test_bulk_benchmark },
 
 	                                  { NULL, NULL } };
 
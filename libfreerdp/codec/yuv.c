@@ -8,6 +8,9 @@
 #include <freerdp/log.h>
 #include <freerdp/codec/yuv.h>
 
+#include "yuv_signature.h"
+#include "sse/yuv_sse2.h"
+
 #define TAG FREERDP_TAG("codec")
 
 #define TILE_SIZE 64
@@ -47,6 +50,9 @@ typedef struct
 	BYTE* pYUVLumaData[3];
 	BYTE* pYUVChromaData[3];
 	UINT32 iStride[3];
+
+	YUV_SIGNATURE_MAP* lumaMap;
+	YUV_SIGNATURE_MAP* chromaMap;
 } YUV_ENCODE_WORK_PARAM;
 
 struct S_YUV_CONTEXT
@@ -65,6 +71,8 @@ struct S_YUV_CONTEXT
 	YUV_ENCODE_WORK_PARAM* work_enc_params;
 	YUV_PROCESS_WORK_PARAM* work_dec_params;
 	YUV_COMBINE_WORK_PARAM* work_combined_params;
+
+	YUV_SIGNATURE_KERNELS signature;
 };
 
 static INLINE BOOL avc420_yuv_to_rgb(const BYTE* WINPR_RESTRICT pYUVData[3],
@@ -166,7 +174,8 @@ BOOL yuv_context_reset(YUV_CONTEXT* WINPR_RESTRICT context, UINT32 width, UINT32
 
 	context->width = width;
 	context->height = height;
-	context->heightStep = (height / context->nthreads);
+	/* Encoder workers split frames at macroblock rows */
+	context->heightStep = MAX(16, ((height / context->nthreads) + 15) & ~15u);
 
 	if (context->useThreads)
 	{
@@ -232,6 +241,8 @@ YUV_CONTEXT* yuv_context_new(BOOL encoder, UINT32 ThreadingFlags)
 
 	ret->encoder = encoder;
 	ret->nthreads = 1;
+	yuv_signature_init_generic(&ret->signature);
+	yuv_signature_init_sse2(&ret->signature);
 	if (!(ThreadingFlags & THREADING_FLAGS_DISABLE_THREADS))
 	{
 		GetNativeSystemInfo(&sysInfos);
@@ -648,6 +659,170 @@ BOOL yuv420_context_decode(YUV_CONTEXT* WINPR_RESTRICT context,
 	                   DstFormat, dest, nDstStep, regionRects, numRegionRects);
 }
 
+static INLINE UINT32 signature_rotl32(UINT32 x, UINT32 r)
+{
+	return (x << r) | (x >> (32 - r));
+}
+
+static INLINE void signature_round(UINT32 a[4], UINT32 b[4], const BYTE* WINPR_RESTRICT data)
+{
+	for (size_t x = 0; x < 4; x++)
+	{
+		UINT32 val = 0;
+		memcpy(&val, &data[x * sizeof(UINT32)], sizeof(UINT32));
+		a[x] = signature_rotl32(a[x] + val * YUV_SIGNATURE_PRIME2, 13) * YUV_SIGNATURE_PRIME1;
+		b[x] = signature_rotl32(b[x] + val * YUV_SIGNATURE_PRIME4, 17) * YUV_SIGNATURE_PRIME3;
+	}
+}
+
+/* Two sets of four interleaved multiply/rotate lanes over 16 byte chunks, matches the SIMD
+ * versions */
+static void yuv_signature_row_generic(const BYTE* WINPR_RESTRICT data, size_t length,
+                                      YUV_SIGNATURE* WINPR_RESTRICT signature,
+                                      UINT32* WINPR_RESTRICT flat)
+{
+	size_t x = 0;
+	UINT32 a[4] = { YUV_SIGNATURE_PRIME1, YUV_SIGNATURE_PRIME1 + YUV_SIGNATURE_PRIME2,
+		            YUV_SIGNATURE_PRIME1 + 2 * YUV_SIGNATURE_PRIME2,
+		            YUV_SIGNATURE_PRIME1 + 3 * YUV_SIGNATURE_PRIME2 };
+	UINT32 b[4] = { YUV_SIGNATURE_PRIME3, YUV_SIGNATURE_PRIME3 + YUV_SIGNATURE_PRIME4,
+		            YUV_SIGNATURE_PRIME3 + 2 * YUV_SIGNATURE_PRIME4,
+		            YUV_SIGNATURE_PRIME3 + 3 * YUV_SIGNATURE_PRIME4 };
+
+	for (; x + 16 <= length; x += 16)
+		signature_round(a, b, &data[x]);
+
+	if (x < length)
+	{
+		BYTE tail[16] = { 0 };
+		memcpy(tail, &data[x], length - x);
+		signature_round(a, b, tail);
+	}
+
+	if (flat)
+	{
+		UINT32 count = 0;
+		for (size_t y = 1; y < length; y++)
+		{
+			if (data[y] == data[y - 1])
+				count++;
+		}
+		*flat += count;
+	}
+
+	yuv_signature_fold(a, b, length, signature);
+}
+
+void yuv_signature_init_generic(YUV_SIGNATURE_KERNELS* kernels)
+{
+	WINPR_ASSERT(kernels);
+	kernels->row = yuv_signature_row_generic;
+}
+
+void yuv_signature_map_uninit(YUV_SIGNATURE_MAP* map)
+{
+	if (!map)
+		return;
+
+	winpr_aligned_free(map->hashes);
+	winpr_aligned_free(map->changed);
+	winpr_aligned_free(map->flat);
+	memset(map, 0, sizeof(YUV_SIGNATURE_MAP));
+}
+
+BOOL yuv_signature_map_reset(YUV_SIGNATURE_MAP* map, UINT32 width, UINT32 height)
+{
+	WINPR_ASSERT(map);
+
+	const UINT32 blocksPerRow = (width + YUV_SIGNATURE_BLOCK_SIZE - 1) / YUV_SIGNATURE_BLOCK_SIZE;
+	const size_t count = 1ull * blocksPerRow * height;
+
+	if ((map->width != width) || (map->height != height) || !map->hashes)
+	{
+		yuv_signature_map_uninit(map);
+		if (count == 0)
+			return FALSE;
+
+		map->hashes = winpr_aligned_malloc(count * sizeof(YUV_SIGNATURE), 32);
+		map->changed = winpr_aligned_malloc(count, 32);
+		map->flat = winpr_aligned_malloc(count, 32);
+		if (!map->hashes || !map->changed || !map->flat)
+		{
+			yuv_signature_map_uninit(map);
+			return FALSE;
+		}
+
+		map->width = width;
+		map->height = height;
+		map->blocksPerRow = blocksPerRow;
+	}
+
+	memset(map->hashes, 0, count * sizeof(YUV_SIGNATURE));
+	memset(map->changed, 1, count);
+	memset(map->flat, 0, count);
+	return TRUE;
+}
+
+/* The chroma signatures and the position and size of the segment are folded into the luma
+ * signature, the same content elsewhere in the frame never matches */
+static INLINE void yuv_signature_combine(YUV_SIGNATURE* WINPR_RESTRICT signature,
+                                         const YUV_SIGNATURE* WINPR_RESTRICT other)
+{
+	signature->lo = yuv_signature_mix64(signature->lo ^ yuv_signature_mix64(other->lo));
+	signature->hi = yuv_signature_mix64(signature->hi + yuv_signature_mix64(other->hi));
+}
+
+/* Sign the rows of a YUV420 frame just converted by this worker, while still in cache */
+static void yuv_signature_update(const YUV_CONTEXT* WINPR_RESTRICT context,
+                                 YUV_SIGNATURE_MAP* WINPR_RESTRICT map, BYTE* pYUVData[3],
+                                 const UINT32 iStride[3], const RECTANGLE_16* WINPR_RESTRICT rect)
+{
+	if (!map)
+		return;
+
+	const pYuvSignatureRow row = context->signature.row;
+	const UINT32 bottom = MIN(rect->bottom, map->height);
+	const UINT32 bxStart = rect->left / YUV_SIGNATURE_BLOCK_SIZE;
+	const UINT32 bxEnd = MIN(map->blocksPerRow,
+	                         (rect->right + YUV_SIGNATURE_BLOCK_SIZE - 1) / YUV_SIGNATURE_BLOCK_SIZE);
+
+	for (UINT32 y = rect->top; y < bottom; y++)
+	{
+		const BYTE* Y = &pYUVData[0][1ull * y * iStride[0]];
+		const BYTE* U = &pYUVData[1][1ull * (y / 2) * iStride[1]];
+		const BYTE* V = &pYUVData[2][1ull * (y / 2) * iStride[2]];
+		const size_t offset = 1ull * y * map->blocksPerRow;
+
+		for (UINT32 bx = bxStart; bx < bxEnd; bx++)
+		{
+			UINT32 flat = 0;
+			const UINT32 x = bx * YUV_SIGNATURE_BLOCK_SIZE;
+			const UINT32 w = MIN(YUV_SIGNATURE_BLOCK_SIZE, map->width - x);
+			const UINT32 cw = (w + 1) / 2;
+			const YUV_SIGNATURE where = { (1ull * y << 32) | x, w };
+			YUV_SIGNATURE hash = { 0 };
+			YUV_SIGNATURE other = { 0 };
+
+			row(&Y[x], w, &hash, &flat);
+
+			/* chroma rows belong to the even luma row */
+			if ((y % 2) == 0)
+			{
+				row(&U[x / 2], cw, &other, NULL);
+				yuv_signature_combine(&hash, &other);
+				row(&V[x / 2], cw, &other, NULL);
+				yuv_signature_combine(&hash, &other);
+			}
+			yuv_signature_combine(&hash, &where);
+
+			YUV_SIGNATURE* last = &map->hashes[offset + bx];
+			map->changed[offset + bx] = ((last->lo != hash.lo) || (last->hi != hash.hi)) ? 1 : 0;
+			map->flat[offset + bx] = (BYTE)flat;
+			*last = hash;
+		}
+	}
+}
+
 static void CALLBACK yuv420_encode_work_callback(PTP_CALLBACK_INSTANCE instance, void* context,
                                                  PTP_WORK work)
 {
@@ -676,6 +851,9 @@ static void CALLBACK yuv420_encode_work_callback(PTP_CALLBACK_INSTANCE instance,
 	{
 		WLog_ERR(TAG, "error when decoding lines");
 	}
+
+	yuv_signature_update(param->context, param->lumaMap, param->pYUVLumaData, param->iStride,
+	                     &param->rect);
 }
 
 static void CALLBACK yuv444v1_encode_work_callback(PTP_CALLBACK_INSTANCE instance, void* context,
@@ -713,6 +891,11 @@ static void CALLBACK yuv444v1_encode_work_callback(PTP_CALLBACK_INSTANCE instanc
 	{
 		WLog_ERR(TAG, "error when decoding lines");
 	}
+
+	yuv_signature_update(param->context, param->lumaMap, param->pYUVLumaData, param->iStride,
+	                     &param->rect);
+	yuv_signature_update(param->context, param->chromaMap, param->pYUVChromaData, param->iStride,
+	                     &param->rect);
 }
 
 static void CALLBACK yuv444v2_encode_work_callback(PTP_CALLBACK_INSTANCE instance, void* context,
@@ -751,12 +934,18 @@ static void CALLBACK yuv444v2_encode_work_callback(PTP_CALLBACK_INSTANCE instanc
 	{
 		WLog_ERR(TAG, "error when decoding lines");
 	}
+
+	yuv_signature_update(param->context, param->lumaMap, param->pYUVLumaData, param->iStride,
+	                     &param->rect);
+	yuv_signature_update(param->context, param->chromaMap, param->pYUVChromaData, param->iStride,
+	                     &param->rect);
 }
 
 static INLINE YUV_ENCODE_WORK_PARAM pool_encode_fill(
     const RECTANGLE_16* WINPR_RESTRICT rect, YUV_CONTEXT* WINPR_RESTRICT context,
     const BYTE* WINPR_RESTRICT pSrcData, UINT32 nSrcStep, UINT32 SrcFormat, const UINT32 iStride[],
-    BYTE* WINPR_RESTRICT pYUVLumaData[], BYTE* WINPR_RESTRICT pYUVChromaData[])
+    BYTE* WINPR_RESTRICT pYUVLumaData[], BYTE* WINPR_RESTRICT pYUVChromaData[],
+    YUV_SIGNATURE_MAP* WINPR_RESTRICT lumaMap, YUV_SIGNATURE_MAP* WINPR_RESTRICT chromaMap)
 {
 	YUV_ENCODE_WORK_PARAM current = { 0 };
 
@@ -784,6 +973,8 @@ static INLINE YUV_ENCODE_WORK_PARAM pool_encode_fill(
 	current.iStride[2] = iStride[2];
 
 	current.rect = *rect;
+	current.lumaMap = lumaMap;
+	current.chromaMap = chromaMap;
 
 	return current;
 }
@@ -792,7 +983,9 @@ static BOOL pool_encode(YUV_CONTEXT* WINPR_RESTRICT context, PTP_WORK_CALLBACK c
                         const BYTE* WINPR_RESTRICT pSrcData, UINT32 nSrcStep, UINT32 SrcFormat,
                         const UINT32 iStride[], BYTE* WINPR_RESTRICT pYUVLumaData[],
                         BYTE* WINPR_RESTRICT pYUVChromaData[],
-                        const RECTANGLE_16* WINPR_RESTRICT regionRects, UINT32 numRegionRects)
+                        const RECTANGLE_16* WINPR_RESTRICT regionRects, UINT32 numRegionRects,
+                        YUV_SIGNATURE_MAP* WINPR_RESTRICT lumaMap,
+                        YUV_SIGNATURE_MAP* WINPR_RESTRICT chromaMap)
 {
 	BOOL rc = FALSE;
 	primitives_t* prims = primitives_get();
@@ -811,33 +1004,31 @@ static BOOL pool_encode(YUV_CONTEXT* WINPR_RESTRICT context, PTP_WORK_CALLBACK c
 		return FALSE;
 	}
 
+	/* Row segments are owned by the worker converting them, overlapping rects would race */
+	if ((lumaMap || chromaMap) && (numRegionRects > 1))
+	{
+		WLog_ERR(TAG, "YUV encoder: signatures require a single region rectangle");
+		return FALSE;
+	}
+
 	if (!context->useThreads || (primitives_flags(prims) & PRIM_FLAGS_HAVE_EXTGPU))
 	{
 		for (UINT32 x = 0; x < numRegionRects; x++)
 		{
 			YUV_ENCODE_WORK_PARAM current =
 			    pool_encode_fill(&regionRects[x], context, pSrcData, nSrcStep, SrcFormat, iStride,
-			                     pYUVLumaData, pYUVChromaData);
+			                     pYUVLumaData, pYUVChromaData, lumaMap, chromaMap);
 			cb(NULL, &current, NULL);
 		}
 		return TRUE;
 	}
 
-	/* case where we use threads */
+	/* case where we use threads, every worker converts a distinct band of rows */
 	for (UINT32 x = 0; x < numRegionRects; x++)
 	{
 		const RECTANGLE_16* rect = &regionRects[x];
 		const UINT32 height = rect->bottom - rect->top;
-		const UINT32 steps = (height + context->heightStep / 2) / context->heightStep;
-
-		waitCount += steps;
-	}
-
-	for (UINT32 x = 0; x < numRegionRects; x++)
-	{
-		const RECTANGLE_16* rect = &regionRects[x];
-		const UINT32 height = rect->bottom - rect->top;
-		const UINT32 steps = (height + context->heightStep / 2) / context->heightStep;
+		const UINT32 steps = (height + context->heightStep - 1) / context->heightStep;
 
 		for (UINT32 y = 0; y < steps; y++)
 		{
@@ -855,8 +1046,9 @@ static BOOL pool_encode(YUV_CONTEXT* WINPR_RESTRICT context, PTP_WORK_CALLBACK c
 
 			current = &context->work_enc_params[waitCount];
 			r.top += y * context->heightStep;
+			r.bottom = (UINT16)MIN(rect->bottom, r.top + context->heightStep);
 			*current = pool_encode_fill(&r, context, pSrcData, nSrcStep, SrcFormat, iStride,
-			                            pYUVLumaData, pYUVChromaData);
+			                            pYUVLumaData, pYUVChromaData, lumaMap, chromaMap);
 			if (!submit_object(&context->work_objects[waitCount], cb, current, context))
 				goto fail;
 			waitCount++;
@@ -878,28 +1070,63 @@ BOOL yuv420_context_encode(YUV_CONTEXT* WINPR_RESTRICT context, const BYTE* WINP
 		return FALSE;
 
 	return pool_encode(context, yuv420_encode_work_callback, pSrcData, nSrcStep, SrcFormat, iStride,
-	                   pYUVData, NULL, regionRects, numRegionRects);
+	                   pYUVData, NULL, regionRects, numRegionRects, NULL, NULL);
 }
 
-BOOL yuv444_context_encode(YUV_CONTEXT* WINPR_RESTRICT context, BYTE version,
-                           const BYTE* WINPR_RESTRICT pSrcData, UINT32 nSrcStep, UINT32 SrcFormat,
-                           const UINT32 iStride[3], BYTE* WINPR_RESTRICT pYUVLumaData[3],
-                           BYTE* WINPR_RESTRICT pYUVChromaData[3],
-                           const RECTANGLE_16* WINPR_RESTRICT regionRects, UINT32 numRegionRects)
+BOOL yuv420_context_encode_signed(YUV_CONTEXT* WINPR_RESTRICT context,
+                                  const BYTE* WINPR_RESTRICT pSrcData, UINT32 nSrcStep,
+                                  UINT32 SrcFormat, const UINT32 iStride[3],
+                                  BYTE* WINPR_RESTRICT pYUVData[3],
+                                  const RECTANGLE_16* WINPR_RESTRICT regionRect,
+                                  YUV_SIGNATURE_MAP* WINPR_RESTRICT map)
+{
+	if (!context || !pSrcData || !iStride || !pYUVData || !regionRect)
+		return FALSE;
+
+	return pool_encode(context, yuv420_encode_work_callback, pSrcData, nSrcStep, SrcFormat, iStride,
+	                   pYUVData, NULL, regionRect, 1, map, NULL);
+}
+
+static PTP_WORK_CALLBACK yuv444_encode_callback(BYTE version)
 {
-	PTP_WORK_CALLBACK cb = NULL;
 	switch (version)
 	{
 		case 1:
-			cb = yuv444v1_encode_work_callback;
-			break;
+			return yuv444v1_encode_work_callback;
 		case 2:
-			cb = yuv444v2_encode_work_callback;
-			break;
+			return yuv444v2_encode_work_callback;
 		default:
-			return FALSE;
+			return NULL;
 	}
+}
+
+BOOL yuv444_context_encode_signed(YUV_CONTEXT* WINPR_RESTRICT context, BYTE version,
+                                  const BYTE* WINPR_RESTRICT pSrcData, UINT32 nSrcStep,
+                                  UINT32 SrcFormat, const UINT32 iStride[3],
+                                  BYTE* WINPR_RESTRICT pYUVLumaData[3],
+                                  BYTE* WINPR_RESTRICT pYUVChromaData[3],
+                                  const RECTANGLE_16* WINPR_RESTRICT regionRect,
+                                  YUV_SIGNATURE_MAP* WINPR_RESTRICT lumaMap,
+                                  YUV_SIGNATURE_MAP* WINPR_RESTRICT chromaMap)
+{
+	PTP_WORK_CALLBACK cb = yuv444_encode_callback(version);
+	if (!cb || !context || !regionRect)
+		return FALSE;
+
+	return pool_encode(context, cb, pSrcData, nSrcStep, SrcFormat, iStride, pYUVLumaData,
+	                   pYUVChromaData, regionRect, 1, lumaMap, chromaMap);
+}
+
+BOOL yuv444_context_encode(YUV_CONTEXT* WINPR_RESTRICT context, BYTE version,
+                           const BYTE* WINPR_RESTRICT pSrcData, UINT32 nSrcStep, UINT32 SrcFormat,
+                           const UINT32 iStride[3], BYTE* WINPR_RESTRICT pYUVLumaData[3],
+                           BYTE* WINPR_RESTRICT pYUVChromaData[3],
+                           const RECTANGLE_16* WINPR_RESTRICT regionRects, UINT32 numRegionRects)
+{
+	PTP_WORK_CALLBACK cb = yuv444_encode_callback(version);
+	if (!cb)
+		return FALSE;
 
 	return pool_encode(context, cb, pSrcData, nSrcStep, SrcFormat, iStride, pYUVLumaData,
-	                   pYUVChromaData, regionRects, numRegionRects);
+	                   pYUVChromaData, regionRects, numRegionRects, NULL, NULL);
 }
@@ -0,0 +1,126 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * YUV Change Detection Signatures
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CODEC_YUV_SIGNATURE_H
+#define FREERDP_LIB_CODEC_YUV_SIGNATURE_H
+
+#include <winpr/wtypes.h>
+
+#include <freerdp/api.h>
+#include <freerdp/types.h>
+#include <freerdp/codec/yuv.h>
+
+/** Width of the row segments signatures are kept for */
+#define YUV_SIGNATURE_BLOCK_SIZE 64
+
+#define YUV_SIGNATURE_PRIME1 2654435761U
+#define YUV_SIGNATURE_PRIME2 2246822519U
+#define YUV_SIGNATURE_PRIME3 3266489917U
+#define YUV_SIGNATURE_PRIME4 668265263U
+
+/** 128bit signature of a row segment
+ *
+ *  Two independent sets of four multiply/rotate lanes are folded into it, so a change is only
+ *  missed if both sets collide. Segments are not compared byte by byte.
+ */
+typedef struct
+{
+	UINT64 lo;
+	UINT64 hi;
+} YUV_SIGNATURE;
+
+/** @brief signature of \b length bytes
+ *
+ *  Every implementation must return the same value for the same input. If \b flat
+ *  is not NULL the number of bytes equal to their left neighbour is added to it.
+ */
+typedef void (*pYuvSignatureRow)(const BYTE* WINPR_RESTRICT data, size_t length,
+                                 YUV_SIGNATURE* WINPR_RESTRICT signature,
+                                 UINT32* WINPR_RESTRICT flat);
+
+typedef struct
+{
+	pYuvSignatureRow row;
+} YUV_SIGNATURE_KERNELS;
+
+static INLINE UINT64 yuv_signature_mix64(UINT64 x)
+{
+	x ^= x >> 33;
+	x *= 0xFF51AFD7ED558CCDull;
+	x ^= x >> 33;
+	x *= 0xC4CEB9FE1A85EC53ull;
+	x ^= x >> 33;
+	return x;
+}
+
+/** @brief fold the lanes of both sets, shared by all implementations */
+static INLINE void yuv_signature_fold(const UINT32 a[4], const UINT32 b[4], size_t length,
+                                      YUV_SIGNATURE* WINPR_RESTRICT signature)
+{
+	const UINT64 a01 = ((UINT64)a[0] << 32) | a[1];
+	const UINT64 a23 = ((UINT64)a[2] << 32) | a[3];
+	const UINT64 b01 = ((UINT64)b[0] << 32) | b[1];
+	const UINT64 b23 = ((UINT64)b[2] << 32) | b[3];
+
+	/* each half holds every lane of one set, a lane of both sets lands in different halves */
+	signature->lo = yuv_signature_mix64(a01 ^ yuv_signature_mix64(b23 + length));
+	signature->hi = yuv_signature_mix64(a23 ^ yuv_signature_mix64(b01 ^ ~(UINT64)length));
+}
+
+/** Per row signatures of every 64 pixel segment of a YUV420 frame
+ *
+ *  Each segment is owned by the encoder thread converting its row, so the maps are
+ *  written without locking. A block of 64 rows changed if any of its segments did.
+ */
+typedef struct
+{
+	UINT32 width;
+	UINT32 height;
+	UINT32 blocksPerRow;
+	YUV_SIGNATURE* hashes; /* luma and chroma signature of each segment */
+	BYTE* changed;         /* segment differs from the last frame */
+	BYTE* flat;            /* luma samples equal to their left neighbour */
+} YUV_SIGNATURE_MAP;
+
+FREERDP_LOCAL void yuv_signature_init_generic(YUV_SIGNATURE_KERNELS* kernels);
+
+FREERDP_LOCAL void yuv_signature_map_uninit(YUV_SIGNATURE_MAP* map);
+
+/** @brief size the map for a frame and forget all signatures */
+FREERDP_LOCAL BOOL yuv_signature_map_reset(YUV_SIGNATURE_MAP* map, UINT32 width, UINT32 height);
+
+/** @brief yuv420_context_encode updating \b map for the converted rows
+ *
+ *  Only a single region rectangle is supported when \b map is not NULL.
+ */
+FREERDP_LOCAL BOOL yuv420_context_encode_signed(YUV_CONTEXT* WINPR_RESTRICT context,
+                                                const BYTE* WINPR_RESTRICT pSrcData,
+                                                UINT32 nSrcStep, UINT32 SrcFormat,
+                                                const UINT32 iStride[3],
+                                                BYTE* WINPR_RESTRICT pYUVData[3],
+                                                const RECTANGLE_16* WINPR_RESTRICT regionRect,
+                                                YUV_SIGNATURE_MAP* WINPR_RESTRICT map);
+
+/** @brief yuv444_context_encode updating the maps of the luma and chroma frame */
+FREERDP_LOCAL BOOL yuv444_context_encode_signed(
+    YUV_CONTEXT* WINPR_RESTRICT context, BYTE version, const BYTE* WINPR_RESTRICT pSrcData,
+    UINT32 nSrcStep, UINT32 SrcFormat, const UINT32 iStride[3],
+    BYTE* WINPR_RESTRICT pYUVLumaData[3], BYTE* WINPR_RESTRICT pYUVChromaData[3],
+    const RECTANGLE_16* WINPR_RESTRICT regionRect, YUV_SIGNATURE_MAP* WINPR_RESTRICT lumaMap,
+    YUV_SIGNATURE_MAP* WINPR_RESTRICT chromaMap);
+
+#endif /* FREERDP_LIB_CODEC_YUV_SIGNATURE_H */
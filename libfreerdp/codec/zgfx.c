@@ -30,6 +30,11 @@
 
 #define TAG FREERDP_TAG("codec")
 
+#define ZGFX_HISTORY_SIZE 2500000
+#define ZGFX_MATCH_HASH_BITS 12
+#define ZGFX_MATCH_MAX_CHAIN 16
+#define ZGFX_MATCH_MIN_LENGTH 3
+
 /**
  * RDP8 Compressor Limits:
  *
@@ -64,11 +69,30 @@ struct S_ZGFX_CONTEXT
 	BYTE OutputBuffer[65536];
 	UINT32 OutputCount;
 
-	BYTE HistoryBuffer[2500000];
+	BYTE* HistoryBuffer;
 	UINT32 HistoryIndex;
 	UINT32 HistoryBufferSize;
+	BYTE PacketType;
+
+	/* Match finder of the RDP 8.0 Lite compressor. Positions count all bytes written to the
+	 * history and are stored plus one, so 0 marks an empty slot. */
+	UINT64 HistoryTotal;
+	UINT64* MatchHead;
+	UINT64* MatchChain;
+	BYTE LiteralPrefixLength[256];
+	BYTE LiteralPrefixCode[256];
 };
 
+typedef struct
+{
+	BYTE* dst;
+	size_t capacity;
+	size_t length;
+	UINT64 bits;
+	UINT32 count;
+	BOOL overflow;
+} ZGFX_BIT_WRITER;
+
 static const ZGFX_TOKEN ZGFX_TOKEN_TABLE[] = {
 	// len code vbits type  vbase
 	{ 1, 0, 8, 0, 0 },           // 0
@@ -306,6 +330,9 @@ static INLINE BOOL zgfx_decompress_segment(ZGFX_CONTEXT* WINPR_RESTRICT zgfx,
 					zgfx_GetBits(zgfx, ZGFX_TOKEN_TABLE[opIndex].valueBits);
 					distance = ZGFX_TOKEN_TABLE[opIndex].valueBase + zgfx->bits;
 
+					if (distance > zgfx->HistoryBufferSize)
+						return FALSE;
+
 					if (distance != 0)
 					{
 						/* Match */
@@ -606,27 +633,324 @@ int zgfx_compress(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, const BYTE* WINPR_RESTRICT
 	return status;
 }
 
+static INLINE void zgfx_bits_write(ZGFX_BIT_WRITER* WINPR_RESTRICT writer, UINT32 value,
+                                   UINT32 nbits)
+{
+	WINPR_ASSERT(nbits <= 32);
+
+	if (nbits == 0)
+		return;
+
+	writer->bits = (writer->bits << nbits) | (value & ((1ull << nbits) - 1ull));
+	writer->count += nbits;
+
+	while (writer->count >= 8)
+	{
+		writer->count -= 8;
+
+		if (writer->length >= writer->capacity)
+			writer->overflow = TRUE;
+		else
+			writer->dst[writer->length++] = (BYTE)(writer->bits >> writer->count);
+	}
+}
+
+/* Pad the last byte and append the number of unused bits, see zgfx_decompress_segment */
+static INLINE void zgfx_bits_finish(ZGFX_BIT_WRITER* WINPR_RESTRICT writer)
+{
+	const UINT32 padding = (8 - writer->count) % 8;
+
+	zgfx_bits_write(writer, 0, padding);
+
+	if (writer->length >= writer->capacity)
+		writer->overflow = TRUE;
+	else
+		writer->dst[writer->length++] = (BYTE)padding;
+}
+
+static INLINE void zgfx_encode_literal(const ZGFX_CONTEXT* WINPR_RESTRICT zgfx,
+                                       ZGFX_BIT_WRITER* WINPR_RESTRICT writer, BYTE c)
+{
+	if (zgfx->LiteralPrefixLength[c] != 0)
+		zgfx_bits_write(writer, zgfx->LiteralPrefixCode[c], zgfx->LiteralPrefixLength[c]);
+	else
+	{
+		zgfx_bits_write(writer, ZGFX_TOKEN_TABLE[0].prefixCode, ZGFX_TOKEN_TABLE[0].prefixLength);
+		zgfx_bits_write(writer, c, ZGFX_TOKEN_TABLE[0].valueBits);
+	}
+}
+
+static INLINE BOOL zgfx_encode_match(ZGFX_BIT_WRITER* WINPR_RESTRICT writer, UINT32 distance,
+                                     UINT32 count)
+{
+	const ZGFX_TOKEN* token = NULL;
+
+	for (size_t x = 0; ZGFX_TOKEN_TABLE[x].prefixLength != 0; x++)
+	{
+		const ZGFX_TOKEN* cur = &ZGFX_TOKEN_TABLE[x];
+
+		if ((cur->tokenType == 1) && (distance >= cur->valueBase) &&
+		    (distance - cur->valueBase < (1ull << cur->valueBits)))
+		{
+			token = cur;
+			break;
+		}
+	}
+
+	if (!token || (count < ZGFX_MATCH_MIN_LENGTH))
+		return FALSE;
+
+	zgfx_bits_write(writer, token->prefixCode, token->prefixLength);
+	zgfx_bits_write(writer, distance - token->valueBase, token->valueBits);
+
+	if (count == 3)
+	{
+		zgfx_bits_write(writer, 0, 1);
+		return TRUE;
+	}
+
+	/* count is 2^k plus k extra bits: a one, k - 2 ones, a zero and the extra bits */
+	UINT32 k = 2;
+	while ((count >> (k + 1)) != 0)
+		k++;
+
+	zgfx_bits_write(writer, 1, 1);
+	for (UINT32 x = 2; x < k; x++)
+		zgfx_bits_write(writer, 1, 1);
+	zgfx_bits_write(writer, 0, 1);
+	zgfx_bits_write(writer, count - (1u << k), k);
+	return TRUE;
+}
+
+/* Byte at an absolute position, either from the input or from the history not yet updated */
+static INLINE BYTE zgfx_match_byte(const ZGFX_CONTEXT* WINPR_RESTRICT zgfx,
+                                   const BYTE* WINPR_RESTRICT pSrcData, UINT64 base, UINT64 pos)
+{
+	if (pos >= base)
+		return pSrcData[pos - base];
+	return zgfx->HistoryBuffer[pos % zgfx->HistoryBufferSize];
+}
+
+static INLINE UINT32 zgfx_match_hash(const BYTE* WINPR_RESTRICT p)
+{
+	const UINT32 value = ((UINT32)p[0] << 16) | ((UINT32)p[1] << 8) | p[2];
+	return (value * 2654435761u) >> (32 - ZGFX_MATCH_HASH_BITS);
+}
+
+static UINT32 zgfx_find_match(const ZGFX_CONTEXT* WINPR_RESTRICT zgfx,
+                              const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcSize, UINT64 base,
+                              UINT32 index, UINT32* WINPR_RESTRICT pDistance)
+{
+	const UINT64 cur = base + index;
+	const UINT32 maxCount = SrcSize - index;
+	UINT32 bestCount = 0;
+	UINT64 candidate = zgfx->MatchHead[zgfx_match_hash(&pSrcData[index])];
+
+	for (size_t steps = 0; (candidate != 0) && (steps < ZGFX_MATCH_MAX_CHAIN); steps++)
+	{
+		const UINT64 pos = candidate - 1;
+
+		if ((pos >= cur) || (cur - pos > zgfx->HistoryBufferSize))
+			break;
+
+		UINT32 count = 0;
+		while ((count < maxCount) &&
+		       (zgfx_match_byte(zgfx, pSrcData, base, pos + count) == pSrcData[index + count]))
+			count++;
+
+		if (count > bestCount)
+		{
+			bestCount = count;
+			*pDistance = (UINT32)(cur - pos);
+
+			if (count == maxCount)
+				break;
+		}
+
+		/* a newer position may have taken the slot, it must not be followed */
+		const UINT64 next = zgfx->MatchChain[pos % zgfx->HistoryBufferSize];
+		if (next > pos)
+			break;
+		candidate = next;
+	}
+
+	return bestCount;
+}
+
+static INLINE void zgfx_match_insert(ZGFX_CONTEXT* WINPR_RESTRICT zgfx,
+                                     const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcSize,
+                                     UINT64 base, UINT32 index)
+{
+	if (index + ZGFX_MATCH_MIN_LENGTH > SrcSize)
+		return;
+
+	const UINT64 pos = base + index;
+	const UINT32 hash = zgfx_match_hash(&pSrcData[index]);
+	zgfx->MatchChain[pos % zgfx->HistoryBufferSize] = zgfx->MatchHead[hash];
+	zgfx->MatchHead[hash] = pos + 1;
+}
+
+BOOL zgfx_compress_bulk(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, const BYTE* WINPR_RESTRICT pSrcData,
+                        UINT32 SrcSize, wStream* WINPR_RESTRICT sDst)
+{
+	WINPR_ASSERT(zgfx);
+	WINPR_ASSERT(pSrcData || (SrcSize == 0));
+	WINPR_ASSERT(sDst);
+
+	if ((SrcSize == 0) || (SrcSize > ZGFX_SEGMENTED_MAXSIZE))
+		return FALSE;
+
+	if (!Stream_EnsureRemainingCapacity(sDst, 1ull + SrcSize))
+		return FALSE;
+
+	const size_t start = Stream_GetPosition(sDst);
+	const UINT64 base = zgfx->HistoryTotal;
+	BOOL compressed = FALSE;
+
+	/* Only keep the encoded data if it is smaller than the input */
+	if (zgfx->MatchHead && (SrcSize > 2))
+	{
+		ZGFX_BIT_WRITER writer = { 0 };
+		writer.dst = Stream_PointerAs(sDst, BYTE) + 1;
+		writer.capacity = SrcSize - 1;
+
+		for (UINT32 index = 0; (index < SrcSize) && !writer.overflow;)
+		{
+			UINT32 distance = 0;
+			UINT32 count = 0;
+
+			if (index + ZGFX_MATCH_MIN_LENGTH <= SrcSize)
+				count = zgfx_find_match(zgfx, pSrcData, SrcSize, base, index, &distance);
+
+			if ((count >= ZGFX_MATCH_MIN_LENGTH) && zgfx_encode_match(&writer, distance, count))
+			{
+				for (UINT32 x = 0; x < count; x++)
+					zgfx_match_insert(zgfx, pSrcData, SrcSize, base, index + x);
+				index += count;
+			}
+			else
+			{
+				zgfx_encode_literal(zgfx, &writer, pSrcData[index]);
+				zgfx_match_insert(zgfx, pSrcData, SrcSize, base, index);
+				index++;
+			}
+		}
+
+		zgfx_bits_finish(&writer);
+
+		if (!writer.overflow)
+		{
+			Stream_Write_UINT8(sDst, zgfx->PacketType | PACKET_COMPRESSED); /* header (1 byte) */
+			Stream_Seek(sDst, writer.length);
+			compressed = TRUE;
+		}
+		else
+		{
+			/* the match finder already knows the input, it ends up in the history anyway */
+			Stream_SetPosition(sDst, start);
+		}
+	}
+
+	if (!compressed)
+	{
+		Stream_Write_UINT8(sDst, zgfx->PacketType); /* header (1 byte) */
+		Stream_Write(sDst, pSrcData, SrcSize);
+	}
+
+	zgfx_history_buffer_ring_write(zgfx, pSrcData, SrcSize);
+	zgfx->HistoryTotal += SrcSize;
+	return TRUE;
+}
+
+BOOL zgfx_decompress_bulk(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, const BYTE* WINPR_RESTRICT pSrcData,
+                          UINT32 SrcSize, wStream* WINPR_RESTRICT sDst)
+{
+	wStream sbuffer = { 0 };
+	wStream* stream = Stream_StaticConstInit(&sbuffer, pSrcData, SrcSize);
+
+	WINPR_ASSERT(zgfx);
+	WINPR_ASSERT(sDst);
+
+	if (!zgfx_decompress_segment(zgfx, stream, SrcSize))
+		return FALSE;
+
+	if (!Stream_EnsureRemainingCapacity(sDst, zgfx->OutputCount))
+		return FALSE;
+
+	Stream_Write(sDst, zgfx->OutputBuffer, zgfx->OutputCount);
+	return TRUE;
+}
+
 void zgfx_context_reset(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, BOOL flush)
 {
 	zgfx->HistoryIndex = 0;
+	zgfx->HistoryTotal = 0;
+
+	if (zgfx->MatchHead)
+		ZeroMemory(zgfx->MatchHead, sizeof(UINT64) * (1ull << ZGFX_MATCH_HASH_BITS));
 }
 
-ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor)
+static ZGFX_CONTEXT* zgfx_context_new_ex(BOOL Compressor, UINT32 HistoryBufferSize,
+                                         BYTE PacketType, BOOL MatchFinder)
 {
 	ZGFX_CONTEXT* zgfx = NULL;
 	zgfx = (ZGFX_CONTEXT*)calloc(1, sizeof(ZGFX_CONTEXT));
 
-	if (zgfx)
+	if (!zgfx)
+		return NULL;
+
+	zgfx->Compressor = Compressor;
+	zgfx->PacketType = PacketType;
+	zgfx->HistoryBufferSize = HistoryBufferSize;
+	zgfx->HistoryBuffer = calloc(HistoryBufferSize, sizeof(BYTE));
+	if (!zgfx->HistoryBuffer)
+		goto fail;
+
+	if (MatchFinder)
 	{
-		zgfx->Compressor = Compressor;
-		zgfx->HistoryBufferSize = sizeof(zgfx->HistoryBuffer);
-		zgfx_context_reset(zgfx, FALSE);
+		zgfx->MatchHead = calloc(1ull << ZGFX_MATCH_HASH_BITS, sizeof(UINT64));
+		zgfx->MatchChain = calloc(HistoryBufferSize, sizeof(UINT64));
+		if (!zgfx->MatchHead || !zgfx->MatchChain)
+			goto fail;
+
+		for (size_t x = 0; ZGFX_TOKEN_TABLE[x].prefixLength != 0; x++)
+		{
+			const ZGFX_TOKEN* token = &ZGFX_TOKEN_TABLE[x];
+
+			if ((token->tokenType == 0) && (token->valueBits == 0))
+			{
+				zgfx->LiteralPrefixLength[token->valueBase] = (BYTE)token->prefixLength;
+				zgfx->LiteralPrefixCode[token->valueBase] = (BYTE)token->prefixCode;
+			}
+		}
 	}
 
+	zgfx_context_reset(zgfx, FALSE);
 	return zgfx;
+
+fail:
+	zgfx_context_free(zgfx);
+	return NULL;
+}
+
+ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor)
+{
+	return zgfx_context_new_ex(Compressor, ZGFX_HISTORY_SIZE, ZGFX_PACKET_COMPR_TYPE_RDP8, FALSE);
+}
+
+ZGFX_CONTEXT* zgfx_context_new_lite(BOOL Compressor)
+{
+	return zgfx_context_new_ex(Compressor, ZGFX_LITE_HISTORY_SIZE,
+	                           ZGFX_PACKET_COMPR_TYPE_RDP8_LITE, Compressor);
 }
 
 void zgfx_context_free(ZGFX_CONTEXT* zgfx)
 {
+	if (!zgfx)
+		return;
+
+	free(zgfx->MatchChain);
+	free(zgfx->MatchHead);
+	free(zgfx->HistoryBuffer);
 	free(zgfx);
 }
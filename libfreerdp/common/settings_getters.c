@@ -2733,6 +2733,9 @@ const char* freerdp_settings_get_string(const rdpSettings* settings,
 		case FreeRDP_DumpRemoteFxFile:
 			return settings->DumpRemoteFxFile;
 
+		case FreeRDP_DynamicChannelCompression:
+			return settings->DynamicChannelCompression;
+
 		case FreeRDP_DynamicDSTTimeZoneKeyName:
 			return settings->DynamicDSTTimeZoneKeyName;
 
@@ -3042,6 +3045,9 @@ char* freerdp_settings_get_string_writable(rdpSettings* settings, FreeRDP_Settin
 		case FreeRDP_DumpRemoteFxFile:
 			return settings->DumpRemoteFxFile;
 
+		case FreeRDP_DynamicChannelCompression:
+			return settings->DynamicChannelCompression;
+
 		case FreeRDP_DynamicDSTTimeZoneKeyName:
 			return settings->DynamicDSTTimeZoneKeyName;
 
@@ -3361,6 +3367,9 @@ BOOL freerdp_settings_set_string_(rdpSettings* settings, FreeRDP_Settings_Keys_S
 		case FreeRDP_DumpRemoteFxFile:
 			return update_string_(&settings->DumpRemoteFxFile, cnv.c, len);
 
+		case FreeRDP_DynamicChannelCompression:
+			return update_string_(&settings->DynamicChannelCompression, cnv.c, len);
+
 		case FreeRDP_DynamicDSTTimeZoneKeyName:
 			return update_string_(&settings->DynamicDSTTimeZoneKeyName, cnv.c, len);
 
@@ -3696,6 +3705,9 @@ BOOL freerdp_settings_set_string_copy_(rdpSettings* settings, FreeRDP_Settings_K
 		case FreeRDP_DumpRemoteFxFile:
 			return update_string_copy_(&settings->DumpRemoteFxFile, cnv.cc, len, cleanup);
 
+		case FreeRDP_DynamicChannelCompression:
+			return update_string_copy_(&settings->DynamicChannelCompression, cnv.cc, len, cleanup);
+
 		case FreeRDP_DynamicDSTTimeZoneKeyName:
 			return update_string_copy_(&settings->DynamicDSTTimeZoneKeyName, cnv.cc, len, cleanup);
 
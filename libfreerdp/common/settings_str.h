@@ -477,6 +477,8 @@ static const struct settings_str_entry settings_map[] = {
 	{ FreeRDP_Domain, FREERDP_SETTINGS_TYPE_STRING, "FreeRDP_Domain" },
 	{ FreeRDP_DrivesToRedirect, FREERDP_SETTINGS_TYPE_STRING, "FreeRDP_DrivesToRedirect" },
 	{ FreeRDP_DumpRemoteFxFile, FREERDP_SETTINGS_TYPE_STRING, "FreeRDP_DumpRemoteFxFile" },
+	{ FreeRDP_DynamicChannelCompression, FREERDP_SETTINGS_TYPE_STRING,
+	  "FreeRDP_DynamicChannelCompression" },
 	{ FreeRDP_DynamicDSTTimeZoneKeyName, FREERDP_SETTINGS_TYPE_STRING,
 	  "FreeRDP_DynamicDSTTimeZoneKeyName" },
 	{ FreeRDP_GatewayAcceptedCert, FREERDP_SETTINGS_TYPE_STRING, "FreeRDP_GatewayAcceptedCert" },
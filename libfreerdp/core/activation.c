@@ -29,7 +29,7 @@
 #define TAG FREERDP_TAG("core.activation")
 
 static BOOL rdp_recv_client_font_list_pdu(wStream* s);
-static BOOL rdp_recv_client_persistent_key_list_pdu(wStream* s);
+static BOOL rdp_recv_client_persistent_key_list_pdu(rdpRdp* rdp, wStream* s);
 static BOOL rdp_send_server_font_map_pdu(rdpRdp* rdp);
 
 static BOOL rdp_write_synchronize_pdu(wStream* s, const rdpSettings* settings)
@@ -424,35 +424,49 @@ BOOL rdp_recv_client_font_list_pdu(wStream* s)
 	return Stream_SafeSeek(s, 8);
 }
 
-BOOL rdp_recv_client_persistent_key_list_pdu(wStream* s)
+void rdp_free_persistent_key_list(rdpRdp* rdp)
+{
+	WINPR_ASSERT(rdp);
+
+	for (size_t x = 0; x < ARRAYSIZE(rdp->persistentKeys); x++)
+	{
+		free(rdp->persistentKeys[x]);
+		rdp->persistentKeys[x] = NULL;
+		rdp->persistentKeyCount[x] = 0;
+		rdp->persistentKeyTotal[x] = 0;
+	}
+}
+
+static BOOL rdp_recv_client_persistent_key_list_pdu(rdpRdp* rdp, wStream* s)
 {
 	BYTE flags = 0;
 	size_t count = 0;
 	size_t total = 0;
-	UINT16 cache = 0;
+	UINT16 numEntries[5] = { 0 };
+	UINT16 totalEntries[5] = { 0 };
 
+	WINPR_ASSERT(rdp);
 	WINPR_ASSERT(s);
 
 	/* 2.2.1.17.1 Persistent Key List PDU Data (TS_BITMAPCACHE_PERSISTENT_LIST_PDU) */
-	if (!Stream_CheckAndLogRequiredLength(TAG, s, 21))
+	if (!Stream_CheckAndLogRequiredLength(TAG, s, 24))
 	{
-		WLog_ERR(TAG, "short TS_BITMAPCACHE_PERSISTENT_LIST_PDU, need 21 bytes, got %" PRIuz,
+		WLog_ERR(TAG, "short TS_BITMAPCACHE_PERSISTENT_LIST_PDU, need 24 bytes, got %" PRIuz,
 		         Stream_GetRemainingLength(s));
 		return FALSE;
 	}
 	/* Read numEntriesCacheX for variable length data in PDU */
-	for (size_t x = 0; x < 5; x++)
+	for (size_t x = 0; x < ARRAYSIZE(numEntries); x++)
 	{
-		Stream_Read_UINT16(s, cache);
-		count += cache;
+		Stream_Read_UINT16(s, numEntries[x]);
+		count += numEntries[x];
 	}
 
-	/* Skip totalEntriesCacheX */
-	for (size_t x = 0; x < 5; x++)
+	/* Read totalEntriesCacheX */
+	for (size_t x = 0; x < ARRAYSIZE(totalEntries); x++)
 	{
-		UINT16 tmp = 0;
-		Stream_Read_UINT16(s, tmp);
-		total += tmp;
+		Stream_Read_UINT16(s, totalEntries[x]);
+		total += totalEntries[x];
 	}
 
 	if (total > 262144)
@@ -472,20 +486,45 @@ BOOL rdp_recv_client_persistent_key_list_pdu(wStream* s)
 	}
 
 	/* Skip padding */
-	if (!Stream_SafeSeek(s, 3))
-	{
-		WLog_ERR(TAG, "short TS_BITMAPCACHE_PERSISTENT_LIST_PDU, need 3 bytes, got %" PRIuz,
-		         Stream_GetRemainingLength(s));
+	Stream_Seek(s, 3);
+
+	if (!Stream_CheckAndLogRequiredLengthOfSize(TAG, s, count, 8ull))
 		return FALSE;
+
+	/* The totals of the first PDU size the key list, later PDUs append to it */
+	if (flags & PERSIST_FIRST_PDU)
+	{
+		rdp_free_persistent_key_list(rdp);
+
+		for (size_t x = 0; x < ARRAYSIZE(totalEntries); x++)
+		{
+			if (totalEntries[x] == 0)
+				continue;
+
+			rdp->persistentKeys[x] = (UINT64*)calloc(totalEntries[x], sizeof(UINT64));
+			if (!rdp->persistentKeys[x])
+				return FALSE;
+			rdp->persistentKeyTotal[x] = totalEntries[x];
+		}
 	}
-	/* Skip actual entries sent by client */
-	if (!Stream_SafeSeek(s, count * sizeof(UINT64)))
+
+	/* Keys are sorted by cache, key n of a cache was loaded into its entry n */
+	for (size_t x = 0; x < ARRAYSIZE(numEntries); x++)
 	{
-		WLog_ERR(TAG,
-		         "short TS_BITMAPCACHE_PERSISTENT_LIST_PDU, need %" PRIuz " bytes, got %" PRIuz,
-		         count * sizeof(UINT64), Stream_GetRemainingLength(s));
-		return FALSE;
+		for (size_t y = 0; y < numEntries[x]; y++)
+		{
+			UINT32 key1 = 0;
+			UINT32 key2 = 0;
+
+			Stream_Read_UINT32(s, key1);
+			Stream_Read_UINT32(s, key2);
+
+			if (rdp->persistentKeyCount[x] < rdp->persistentKeyTotal[x])
+				rdp->persistentKeys[x][rdp->persistentKeyCount[x]++] =
+				    ((UINT64)key2 << 32) | key1;
+		}
 	}
+
 	return TRUE;
 }
 
@@ -775,11 +814,10 @@ BOOL rdp_server_accept_client_persistent_key_list_pdu(rdpRdp* rdp, wStream* s)
 	WINPR_ASSERT(rdp);
 	WINPR_ASSERT(s);
 
-	if (!rdp_recv_client_persistent_key_list_pdu(s))
+	if (!rdp_recv_client_persistent_key_list_pdu(rdp, s))
 		return FALSE;
 
 	rdp_finalize_set_flag(rdp, FINALIZE_CS_PERSISTENT_KEY_LIST_PDU);
-	// TODO: Actually do something with this
 	return TRUE;
 }
 
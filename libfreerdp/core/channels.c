@@ -47,9 +47,23 @@
 #include "client.h"
 #include "server.h"
 #include "channels.h"
+#include "metrics.h"
 
 #define TAG FREERDP_TAG("core.channels")
 
+static const char* channel_name_by_id(const rdpMcs* mcs, UINT16 channelId)
+{
+	WINPR_ASSERT(mcs);
+
+	for (UINT32 i = 0; i < mcs->channelCount; i++)
+	{
+		const rdpMcsChannel* cur = &mcs->channels[i];
+		if (cur->ChannelId == channelId)
+			return cur->Name;
+	}
+	return NULL;
+}
+
 BOOL freerdp_channel_send(rdpRdp* rdp, UINT16 channelId, const BYTE* data, size_t size)
 {
 	size_t left = 0;
@@ -144,6 +158,11 @@ BOOL freerdp_channel_process(freerdp* instance, wStream* s, UINT16 channelId, si
 		return FALSE;
 	}
 
+	WINPR_ASSERT(instance->context);
+	metrics_channel_data(instance->context->metrics, channelId,
+	                     channel_name_by_id(instance->context->rdp->mcs, channelId), chunkLength,
+	                     flags, FALSE);
+
 	IFCALLRET(instance->ReceiveChannelData, rc, instance, channelId, Stream_Pointer(s), chunkLength,
 	          flags, length);
 	if (!rc)
@@ -171,6 +190,11 @@ BOOL freerdp_channel_peer_process(freerdp_peer* client, wStream* s, UINT16 chann
 	Stream_Read_UINT32(s, flags);
 	chunkLength = Stream_GetRemainingLength(s);
 
+	WINPR_ASSERT(client->context);
+	metrics_channel_data(client->context->metrics, channelId,
+	                     channel_name_by_id(client->context->rdp->mcs, channelId), chunkLength,
+	                     flags, FALSE);
+
 	if (client->VirtualChannelRead)
 	{
 		int rc = 0;
@@ -312,5 +336,8 @@ BOOL freerdp_channel_send_packet(rdpRdp* rdp, UINT16 channelId, size_t totalSize
 	Stream_Write(s, data, chunkSize);
 
 	/* WLog_DBG(TAG, "sending data (flags=0x%x size=%d)",  flags, size); */
+	WINPR_ASSERT(rdp->context);
+	metrics_channel_data(rdp->context->metrics, channelId, channel_name_by_id(rdp->mcs, channelId),
+	                     chunkSize, flags, TRUE);
 	return rdp_send(rdp, s, channelId);
 }
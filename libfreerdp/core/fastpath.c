@@ -31,6 +31,7 @@
 #include <winpr/crt.h>
 #include <winpr/assert.h>
 #include <winpr/stream.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/api.h>
 #include <freerdp/log.h>
@@ -41,6 +42,7 @@
 #include "surface.h"
 #include "fastpath.h"
 #include "rdp.h"
+#include "metrics.h"
 
 #include "../cache/pointer.h"
 #include "../cache/palette.h"
@@ -273,7 +275,7 @@ static BOOL fastpath_recv_orders(rdpFastPath* fastpath, wStream* s)
 		numberOrders--;
 	}
 
-	return TRUE;
+	return update_flush_orders(update);
 }
 
 static BOOL fastpath_recv_update_common(rdpFastPath* fastpath, wStream* s)
@@ -345,7 +347,7 @@ static BOOL fastpath_recv_update_synchronize(rdpFastPath* fastpath, wStream* s)
 	return Stream_SafeSeek(s, skip); /* size (2 bytes), MUST be set to zero */
 }
 
-static int fastpath_recv_update(rdpFastPath* fastpath, BYTE updateCode, wStream* s)
+static int fastpath_recv_update_int(rdpFastPath* fastpath, BYTE updateCode, wStream* s)
 {
 	BOOL rc = FALSE;
 	int status = 0;
@@ -489,6 +491,17 @@ static int fastpath_recv_update(rdpFastPath* fastpath, BYTE updateCode, wStream*
 	return status;
 }
 
+static int fastpath_recv_update(rdpFastPath* fastpath, BYTE updateCode, wStream* s)
+{
+	const UINT64 start = winpr_GetTickCount64NS();
+	const int status = fastpath_recv_update_int(fastpath, updateCode, s);
+
+	if (fastpath && fastpath->rdp && fastpath->rdp->context)
+		metrics_pdu_time(fastpath->rdp->context->metrics, FREERDP_METRICS_PDU_FASTPATH_UPDATE,
+		                 updateCode, winpr_GetTickCount64NS() - start);
+	return status;
+}
+
 static int fastpath_recv_update_data(rdpFastPath* fastpath, wStream* s)
 {
 	int status = 0;
@@ -940,9 +953,20 @@ state_run_t fastpath_recv_inputs(rdpFastPath* fastpath, wStream* s)
 		Stream_Read_UINT8(s, fastpath->numberEvents); /* eventHeader (1 byte) */
 	}
 
+	WINPR_ASSERT(fastpath->rdp);
+	WINPR_ASSERT(fastpath->rdp->context);
+
 	for (BYTE i = 0; i < fastpath->numberEvents; i++)
 	{
-		if (!fastpath_recv_input_event(fastpath, s))
+		BYTE eventCode = 0;
+		if (Stream_GetRemainingLength(s) > 0)
+			Stream_Peek_UINT8(s, eventCode);
+		eventCode >>= 5;
+		const UINT64 start = winpr_GetTickCount64NS();
+		const BOOL rc = fastpath_recv_input_event(fastpath, s);
+		metrics_pdu_time(fastpath->rdp->context->metrics, FREERDP_METRICS_PDU_FASTPATH_INPUT,
+		                 eventCode, winpr_GetTickCount64NS() - start);
+		if (!rc)
 			return STATE_RUN_FAILED;
 	}
 
@@ -289,35 +289,53 @@ static BOOL rdg_read_http_unicode_string(wLog* log, wStream* s, const WCHAR** st
 	return TRUE;
 }
 
-static BOOL rdg_write_chunked(BIO* bio, wStream* sPacket)
+/* Packets reserve room for the transport framing so it is added without copying the packet:
+ * the websocket frame header or the chunk size line in front, the chunk trailer behind. */
+#define RDG_PACKET_HEADROOM WEBSOCKET_HEADER_RESERVE
+#define RDG_PACKET_TAILROOM 2
+
+static wStream* rdg_packet_new(size_t packetSize)
 {
-	size_t len = 0;
-	int status = 0;
-	wStream* sChunk = NULL;
-	char chunkSize[11];
-	sprintf_s(chunkSize, sizeof(chunkSize), "%" PRIXz "\r\n", Stream_Length(sPacket));
-	sChunk = Stream_New(NULL, strnlen(chunkSize, sizeof(chunkSize)) + Stream_Length(sPacket) + 2);
+	wStream* s = Stream_New(NULL, RDG_PACKET_HEADROOM + packetSize + RDG_PACKET_TAILROOM);
+	if (!s)
+		return NULL;
+
+	Stream_Seek(s, RDG_PACKET_HEADROOM);
+	return s;
+}
+
+static BOOL rdg_write_chunked(rdpTls* tls, wStream* sPacket)
+{
+	char chunkSize[11] = { 0 };
 
-	if (!sChunk)
+	WINPR_ASSERT(tls);
+	WINPR_ASSERT(sPacket);
+
+	const size_t length = Stream_Length(sPacket);
+	if (length < RDG_PACKET_HEADROOM)
 		return FALSE;
 
-	Stream_Write(sChunk, chunkSize, strnlen(chunkSize, sizeof(chunkSize)));
-	Stream_Write(sChunk, Stream_Buffer(sPacket), Stream_Length(sPacket));
-	Stream_Write(sChunk, "\r\n", 2);
-	Stream_SealLength(sChunk);
-	len = Stream_Length(sChunk);
+	const int rc = sprintf_s(chunkSize, sizeof(chunkSize), "%" PRIXz "\r\n",
+	                         length - RDG_PACKET_HEADROOM);
+	if ((rc <= 0) || (rc > RDG_PACKET_HEADROOM))
+		return FALSE;
 
-	if (len > INT_MAX)
-	{
-		Stream_Free(sChunk, TRUE);
+	Stream_SetPosition(sPacket, length);
+	if (!Stream_EnsureRemainingCapacity(sPacket, RDG_PACKET_TAILROOM))
 		return FALSE;
-	}
+	Stream_Write(sPacket, "\r\n", 2);
 
-	ERR_clear_error();
-	status = BIO_write(bio, Stream_Buffer(sChunk), (int)len);
-	Stream_Free(sChunk, TRUE);
+	/* the chunk size line ends right where the packet starts */
+	const size_t offset = RDG_PACKET_HEADROOM - (size_t)rc;
+	BYTE* chunk = Stream_Buffer(sPacket) + offset;
+	memcpy(chunk, chunkSize, (size_t)rc);
 
-	if (status != (SSIZE_T)len)
+	const size_t len = Stream_GetPosition(sPacket) - offset;
+	if (len > INT_MAX)
+		return FALSE;
+
+	const int status = freerdp_tls_write_all(tls, chunk, (int)len);
+	if (status != (int)len)
 		return FALSE;
 
 	return TRUE;
@@ -332,7 +350,7 @@ static BOOL rdg_write_packet(rdpRdg* rdg, wStream* sPacket)
 		return websocket_write_wstream(rdg->tlsOut->bio, sPacket, WebsocketBinaryOpcode);
 	}
 
-	return rdg_write_chunked(rdg->tlsIn->bio, sPacket);
+	return rdg_write_chunked(rdg->tlsIn, sPacket);
 }
 
 static int rdg_socket_read(BIO* bio, BYTE* pBuffer, size_t size,
@@ -430,7 +448,7 @@ static wStream* rdg_receive_packet(rdpRdg* rdg)
 static BOOL rdg_send_handshake(rdpRdg* rdg)
 {
 	BOOL status = FALSE;
-	wStream* s = Stream_New(NULL, 14);
+	wStream* s = rdg_packet_new(14);
 
 	if (!s)
 		return FALSE;
@@ -467,7 +485,7 @@ static BOOL rdg_send_extauth_sspi(rdpRdg* rdg)
 		return FALSE;
 	packetSize += authToken->cbBuffer;
 
-	s = Stream_New(NULL, packetSize);
+	s = rdg_packet_new(packetSize);
 
 	if (!s)
 		return FALSE;
@@ -513,7 +531,7 @@ static BOOL rdg_send_tunnel_request(rdpRdg* rdg)
 		fieldsPresent = HTTP_TUNNEL_PACKET_FIELD_PAA_COOKIE;
 	}
 
-	s = Stream_New(NULL, packetSize);
+	s = rdg_packet_new(packetSize);
 
 	if (!s)
 	{
@@ -565,7 +583,7 @@ static BOOL rdg_send_tunnel_authorization(rdpRdg* rdg)
 	clientNameLen++; // length including terminating '\0'
 
 	size_t packetSize = 12ull + clientNameLen * sizeof(WCHAR);
-	s = Stream_New(NULL, packetSize);
+	s = rdg_packet_new(packetSize);
 
 	if (!s)
 	{
@@ -608,7 +626,7 @@ static BOOL rdg_send_channel_create(rdpRdg* rdg)
 
 	serverNameLen++; // length including terminating '\0'
 	size_t packetSize = 16ull + serverNameLen * sizeof(WCHAR);
-	s = Stream_New(NULL, packetSize);
+	s = rdg_packet_new(packetSize);
 
 	if (!s)
 		goto fail;
@@ -1613,149 +1631,34 @@ BOOL rdg_connect(rdpRdg* rdg, DWORD timeout, BOOL* rpcFallback)
 	return TRUE;
 }
 
-static int rdg_write_websocket_data_packet(rdpRdg* rdg, const BYTE* buf, int isize)
-{
-	size_t payloadSize = 0;
-	size_t fullLen = 0;
-	int status = 0;
-	wStream* sWS = NULL;
-
-	uint32_t maskingKey = 0;
-	BYTE* maskingKeyByte1 = (BYTE*)&maskingKey;
-	BYTE* maskingKeyByte2 = maskingKeyByte1 + 1;
-	BYTE* maskingKeyByte3 = maskingKeyByte1 + 2;
-	BYTE* maskingKeyByte4 = maskingKeyByte1 + 3;
-
-	int streamPos = 0;
-
-	winpr_RAND(&maskingKey, 4);
-
-	payloadSize = isize + 10;
-	if ((isize < 0) || (isize > UINT16_MAX))
-		return -1;
-
-	if (payloadSize < 1)
-		return 0;
-
-	if (payloadSize < 126)
-		fullLen = payloadSize + 6; /* 2 byte "mini header" + 4 byte masking key */
-	else if (payloadSize < 0x10000)
-		fullLen = payloadSize + 8; /* 2 byte "mini header" + 2 byte length + 4 byte masking key */
-	else
-		fullLen = payloadSize + 14; /* 2 byte "mini header" + 8 byte length + 4 byte masking key */
-
-	sWS = Stream_New(NULL, fullLen);
-	if (!sWS)
-		return FALSE;
-
-	Stream_Write_UINT8(sWS, WEBSOCKET_FIN_BIT | WebsocketBinaryOpcode);
-	if (payloadSize < 126)
-		Stream_Write_UINT8(sWS, payloadSize | WEBSOCKET_MASK_BIT);
-	else if (payloadSize < 0x10000)
-	{
-		Stream_Write_UINT8(sWS, 126 | WEBSOCKET_MASK_BIT);
-		Stream_Write_UINT16_BE(sWS, payloadSize);
-	}
-	else
-	{
-		Stream_Write_UINT8(sWS, 127 | WEBSOCKET_MASK_BIT);
-		/* biggest packet possible is 0xffff + 0xa, so 32bit is always enough */
-		Stream_Write_UINT32_BE(sWS, 0);
-		Stream_Write_UINT32_BE(sWS, payloadSize);
-	}
-	Stream_Write_UINT32(sWS, maskingKey);
-
-	Stream_Write_UINT16(sWS, PKT_TYPE_DATA ^ (*maskingKeyByte1 | *maskingKeyByte2 << 8)); /* Type */
-	Stream_Write_UINT16(sWS, 0 ^ (*maskingKeyByte3 | *maskingKeyByte4 << 8)); /* Reserved */
-	Stream_Write_UINT32(sWS, (UINT32)payloadSize ^ maskingKey);               /* Packet length */
-	Stream_Write_UINT16(sWS,
-	                    (UINT16)isize ^ (*maskingKeyByte1 | *maskingKeyByte2 << 8)); /* Data size */
-
-	/* masking key is now off by 2 bytes. fix that */
-	maskingKey = (maskingKey & 0xffff) << 16 | (maskingKey >> 16);
-
-	/* mask as much as possible with 32bit access */
-	for (streamPos = 0; streamPos + 4 <= isize; streamPos += 4)
-	{
-		uint32_t masked = *((const uint32_t*)((const BYTE*)buf + streamPos)) ^ maskingKey;
-		Stream_Write_UINT32(sWS, masked);
-	}
-
-	/* mask the rest byte by byte */
-	for (; streamPos < isize; streamPos++)
-	{
-		BYTE* partialMask = (BYTE*)(&maskingKey) + streamPos % 4;
-		BYTE masked = *((const BYTE*)((const BYTE*)buf + streamPos)) ^ *partialMask;
-		Stream_Write_UINT8(sWS, masked);
-	}
-
-	Stream_SealLength(sWS);
-
-	status = freerdp_tls_write_all(rdg->tlsOut, Stream_Buffer(sWS), Stream_Length(sWS));
-	Stream_Free(sWS, TRUE);
-
-	if (status < 0)
-		return status;
-
-	return isize;
-}
-
-static int rdg_write_chunked_data_packet(rdpRdg* rdg, const BYTE* buf, int isize)
+static int rdg_write_data_packet(rdpRdg* rdg, const BYTE* buf, int isize)
 {
-	int status = 0;
-	size_t len = 0;
-	wStream* sChunk = NULL;
-	size_t size = (size_t)isize;
-	size_t packetSize = size + 10;
-	char chunkSize[11];
-
 	if ((isize < 0) || (isize > UINT16_MAX))
 		return -1;
 
-	if (size < 1)
+	if (isize == 0)
 		return 0;
 
-	sprintf_s(chunkSize, sizeof(chunkSize), "%" PRIxz "\r\n", packetSize);
-	sChunk = Stream_New(NULL, strnlen(chunkSize, sizeof(chunkSize)) + packetSize + 2);
-
-	if (!sChunk)
+	const size_t size = (size_t)isize;
+	const size_t packetSize = size + 10;
+	wStream* s = rdg_packet_new(packetSize);
+	if (!s)
 		return -1;
 
-	Stream_Write(sChunk, chunkSize, strnlen(chunkSize, sizeof(chunkSize)));
-	Stream_Write_UINT16(sChunk, PKT_TYPE_DATA);      /* Type */
-	Stream_Write_UINT16(sChunk, 0);                  /* Reserved */
-	Stream_Write_UINT32(sChunk, (UINT32)packetSize); /* Packet length */
-	Stream_Write_UINT16(sChunk, (UINT16)size);       /* Data size */
-	Stream_Write(sChunk, buf, size);                 /* Data */
-	Stream_Write(sChunk, "\r\n", 2);
-	Stream_SealLength(sChunk);
-	len = Stream_Length(sChunk);
-
-	if (len > INT_MAX)
-	{
-		Stream_Free(sChunk, TRUE);
-		return -1;
-	}
+	Stream_Write_UINT16(s, PKT_TYPE_DATA);      /* Type */
+	Stream_Write_UINT16(s, 0);                  /* Reserved */
+	Stream_Write_UINT32(s, (UINT32)packetSize); /* Packet length */
+	Stream_Write_UINT16(s, (UINT16)size);       /* Data size */
+	Stream_Write(s, buf, size);                 /* Data */
+	Stream_SealLength(s);
 
-	status = freerdp_tls_write_all(rdg->tlsIn, Stream_Buffer(sChunk), (int)len);
-	Stream_Free(sChunk, TRUE);
+	const BOOL status = rdg_write_packet(rdg, s);
+	Stream_Free(s, TRUE);
 
-	if (status < 0)
+	if (!status)
 		return -1;
 
-	return (int)size;
-}
-
-static int rdg_write_data_packet(rdpRdg* rdg, const BYTE* buf, int isize)
-{
-	if (rdg->transferEncoding.isWebsocketTransport)
-	{
-		if (rdg->transferEncoding.context.websocket.closeSent == TRUE)
-			return -1;
-		return rdg_write_websocket_data_packet(rdg, buf, isize);
-	}
-	else
-		return rdg_write_chunked_data_packet(rdg, buf, isize);
+	return isize;
 }
 
 static BOOL rdg_process_close_packet(rdpRdg* rdg, wStream* s)
@@ -1773,7 +1676,7 @@ static BOOL rdg_process_close_packet(rdpRdg* rdg, wStream* s)
 	if (errorCode != 0)
 		freerdp_set_last_error_log(rdg->context, errorCode);
 
-	sClose = Stream_New(NULL, packetSize);
+	sClose = rdg_packet_new(packetSize);
 	if (!sClose)
 		return FALSE;
 
@@ -1794,7 +1697,7 @@ static BOOL rdg_process_keep_alive_packet(rdpRdg* rdg)
 	wStream* sKeepAlive = NULL;
 	size_t packetSize = 8;
 
-	sKeepAlive = Stream_New(NULL, packetSize);
+	sKeepAlive = rdg_packet_new(packetSize);
 
 	if (!sKeepAlive)
 		return FALSE;
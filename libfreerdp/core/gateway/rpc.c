@@ -618,10 +618,14 @@ static int rpc_out_channel_init(rdpRpc* rpc, RpcOutChannel* outChannel, const GU
 	outChannel->common.rpc = rpc;
 	outChannel->State = CLIENT_OUT_CHANNEL_STATE_INITIAL;
 	outChannel->BytesReceived = 0;
-	outChannel->ReceiverAvailableWindow = rpc->ReceiveWindow;
-	outChannel->ReceiveWindow = rpc->ReceiveWindow;
-	outChannel->ReceiveWindowSize = rpc->ReceiveWindow;
+	/* The declared window is the upper bound, the advertised one grows towards it */
+	outChannel->ReceiverAvailableWindow = rpc->ReceiveWindowMax;
+	outChannel->ReceiveWindow = rpc->ReceiveWindowMax;
+	outChannel->ReceiveWindowSize = rpc->ReceiveWindowMax;
 	outChannel->AvailableWindowAdvertised = rpc->ReceiveWindow;
+	outChannel->AckBytesReceived = 0;
+	outChannel->AckTimestamp = 0;
+	outChannel->RoundTripTime = RTS_DEFAULT_ROUND_TRIP_TIME;
 
 	if (rpc_channel_rpch_init(rpc->client, &outChannel->common, "RPC_OUT_DATA", guid) < 0)
 		return -1;
@@ -945,6 +949,7 @@ rdpRpc* rpc_new(rdpTransport* transport)
 	rpc->max_xmit_frag = 0x0FF8;
 	rpc->max_recv_frag = 0x0FF8;
 	rpc->ReceiveWindow = 0x00010000;
+	rpc->ReceiveWindowMax = 0x00040000; /* MS-RPCH limits ReceiveWindowSize to 256 KiB */
 	rpc->ChannelLifetime = 0x40000000;
 	rpc->KeepAliveInterval = 300000;
 	rpc->CurrentKeepAliveInterval = rpc->KeepAliveInterval;
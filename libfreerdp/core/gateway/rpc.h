@@ -680,6 +680,13 @@ typedef struct
 	UINT32 ReceiverAvailableWindow;
 	UINT32 BytesReceived;
 	UINT32 AvailableWindowAdvertised;
+
+	/* Receive window tuning */
+
+	UINT32 AckBytesReceived;
+	UINT64 AckTimestamp;
+	UINT64 OpenTimestamp;
+	UINT32 RoundTripTime;
 } RpcOutChannel;
 
 /* Client Virtual Connection */
@@ -748,6 +755,7 @@ struct rdp_rpc
 	UINT16 max_recv_frag;
 
 	UINT32 ReceiveWindow;
+	UINT32 ReceiveWindowMax;
 	UINT32 ChannelLifetime;
 	UINT32 KeepAliveInterval;
 	UINT32 CurrentKeepAliveTime;
@@ -354,6 +354,22 @@ static int rpc_client_recv_pdu(rdpRpc* rpc, RPC_PDU* pdu)
 	return rc;
 }
 
+/* Hand a PDU that arrived in a single fragment to the parser without copying it */
+static int rpc_client_recv_pdu_inplace(rdpRpc* rpc, RPC_PDU* pdu, const BYTE* data, size_t length)
+{
+	wStream sbuffer = { 0 };
+
+	WINPR_ASSERT(pdu);
+
+	wStream* s = pdu->s;
+	pdu->s = Stream_StaticConstInit(&sbuffer, data, length);
+	Stream_Seek(pdu->s, length);
+
+	const int rc = rpc_client_recv_pdu(rpc, pdu);
+	pdu->s = s;
+	return rc;
+}
+
 static int rpc_client_recv_fragment(rdpRpc* rpc, wStream* fragment)
 {
 	int rc = -1;
@@ -378,16 +394,12 @@ static int rpc_client_recv_fragment(rdpRpc* rpc, wStream* fragment)
 
 	if (header.common.ptype == PTYPE_RESPONSE)
 	{
-		rpc->VirtualConnection->DefaultOutChannel->BytesReceived += header.common.frag_length;
-		rpc->VirtualConnection->DefaultOutChannel->ReceiverAvailableWindow -=
-		    header.common.frag_length;
+		RpcOutChannel* outChannel = rpc->VirtualConnection->DefaultOutChannel;
 
-		if (rpc->VirtualConnection->DefaultOutChannel->ReceiverAvailableWindow <
-		    (rpc->ReceiveWindow / 2))
-		{
-			if (!rts_send_flow_control_ack_pdu(rpc))
-				goto fail;
-		}
+		/* Acknowledgements are sent by the read loop, see rpc_client_flow_control */
+		outChannel->BytesReceived += header.common.frag_length;
+		outChannel->ReceiverAvailableWindow -=
+		    MIN(header.common.frag_length, outChannel->ReceiverAvailableWindow);
 
 		if (!rpc_get_stub_data_info(rpc, &header, &StubOffset, &StubLength))
 		{
@@ -449,28 +461,51 @@ static int rpc_client_recv_fragment(rdpRpc* rpc, wStream* fragment)
 		{
 			const rpcconn_response_hdr_t* response =
 			    (const rpcconn_response_hdr_t*)&header.response;
-			if (!Stream_EnsureCapacity(pdu->s, response->alloc_hint))
-				goto fail;
 
 			if (Stream_Length(fragment) < StubOffset + StubLength)
 				goto fail;
 
 			Stream_SetPosition(fragment, StubOffset);
-			Stream_Write(pdu->s, Stream_ConstPointer(fragment), StubLength);
-			rpc->StubFragCount++;
 
 			if (response->alloc_hint == StubLength)
 			{
+				int status = 0;
 				pdu->Flags = RPC_PDU_FLAG_STUB;
 				pdu->Type = PTYPE_RESPONSE;
 				pdu->CallId = rpc->StubCallId;
 
-				if (rpc_client_recv_pdu(rpc, pdu) < 0)
+				/* Only PDUs spanning several fragments are reassembled */
+				if (rpc->StubFragCount == 0)
+					status = rpc_client_recv_pdu_inplace(rpc, pdu, Stream_ConstPointer(fragment),
+					                                     StubLength);
+				else
+				{
+					if (!Stream_EnsureRemainingCapacity(pdu->s, StubLength))
+						goto fail;
+
+					Stream_Write(pdu->s, Stream_ConstPointer(fragment), StubLength);
+					status = rpc_client_recv_pdu(rpc, pdu);
+				}
+
+				if (status < 0)
 					goto fail;
 				rpc_pdu_reset(pdu);
 				rpc->StubFragCount = 0;
 				rpc->StubCallId = 0;
 			}
+			else
+			{
+				if (rpc->StubFragCount == 0)
+				{
+					if (!Stream_EnsureCapacity(pdu->s, response->alloc_hint))
+						goto fail;
+				}
+				else if (!Stream_EnsureRemainingCapacity(pdu->s, StubLength))
+					goto fail;
+
+				Stream_Write(pdu->s, Stream_ConstPointer(fragment), StubLength);
+				rpc->StubFragCount++;
+			}
 		}
 		else
 		{
@@ -499,13 +534,8 @@ static int rpc_client_recv_fragment(rdpRpc* rpc, wStream* fragment)
 			pdu->Type = header.common.ptype;
 			pdu->CallId = header.common.call_id;
 
-			const size_t len = Stream_Length(fragment);
-			if (!Stream_EnsureCapacity(pdu->s, len))
-				goto fail;
-
-			Stream_Write(pdu->s, Stream_Buffer(fragment), len);
-
-			if (rpc_client_recv_pdu(rpc, pdu) < 0)
+			if (rpc_client_recv_pdu_inplace(rpc, pdu, Stream_Buffer(fragment),
+			                                Stream_Length(fragment)) < 0)
 				goto fail;
 
 			rpc_pdu_reset(pdu);
@@ -525,13 +555,8 @@ static int rpc_client_recv_fragment(rdpRpc* rpc, wStream* fragment)
 		pdu->Type = header.common.ptype;
 		pdu->CallId = header.common.call_id;
 
-		const size_t len = Stream_Length(fragment);
-		if (!Stream_EnsureCapacity(pdu->s, len))
-			goto fail;
-
-		Stream_Write(pdu->s, Stream_Buffer(fragment), len);
-
-		if (rpc_client_recv_pdu(rpc, pdu) < 0)
+		if (rpc_client_recv_pdu_inplace(rpc, pdu, Stream_Buffer(fragment),
+		                                Stream_Length(fragment)) < 0)
 			goto fail;
 
 		rpc_pdu_reset(pdu);
@@ -557,6 +582,20 @@ fail:
 	return rc;
 }
 
+/* Acknowledge received data once the socket is drained instead of per fragment, unless the
+ * sender would stall before that. */
+static BOOL rpc_client_flow_control(rdpRpc* rpc, BOOL drained)
+{
+	WINPR_ASSERT(rpc);
+	WINPR_ASSERT(rpc->VirtualConnection);
+
+	const RpcOutChannel* outChannel = rpc->VirtualConnection->DefaultOutChannel;
+	if (!rts_flow_control_ack_due(outChannel, drained))
+		return TRUE;
+
+	return rts_send_flow_control_ack_pdu(rpc);
+}
+
 static SSIZE_T rpc_client_default_out_channel_recv(rdpRpc* rpc)
 {
 	SSIZE_T status = -1;
@@ -678,7 +717,7 @@ static SSIZE_T rpc_client_default_out_channel_recv(rdpRpc* rpc)
 					return -1;
 
 				if (Stream_GetPosition(fragment) < RPC_COMMON_FIELDS_LENGTH)
-					return 0;
+					return rpc_client_flow_control(rpc, TRUE) ? 0 : -1;
 			}
 
 			pos = Stream_GetPosition(fragment);
@@ -710,7 +749,7 @@ static SSIZE_T rpc_client_default_out_channel_recv(rdpRpc* rpc)
 				}
 
 				if (Stream_GetPosition(fragment) < header.frag_length)
-					return 0;
+					return rpc_client_flow_control(rpc, TRUE) ? 0 : -1;
 			}
 
 			{
@@ -720,10 +759,18 @@ static SSIZE_T rpc_client_default_out_channel_recv(rdpRpc* rpc)
 				if (status < 0)
 					return status;
 
+				if (!rpc_client_flow_control(rpc, FALSE))
+					return -1;
+
 				/* channel recycling may update channel pointers */
 				if (outChannel->State == CLIENT_OUT_CHANNEL_STATE_RECYCLED &&
 				    connection->NonDefaultOutChannel)
 				{
+					/* the successor continues with the tuned receive window */
+					connection->NonDefaultOutChannel->AvailableWindowAdvertised =
+					    outChannel->AvailableWindowAdvertised;
+					connection->NonDefaultOutChannel->RoundTripTime = outChannel->RoundTripTime;
+
 					rpc_channel_free(&connection->DefaultOutChannel->common);
 					connection->DefaultOutChannel = connection->NonDefaultOutChannel;
 					connection->NonDefaultOutChannel = NULL;
@@ -22,6 +22,7 @@
 #include <winpr/assert.h>
 #include <winpr/crt.h>
 #include <winpr/crypto.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/log.h>
 
@@ -1583,6 +1584,8 @@ BOOL rts_send_CONN_A1_pdu(rdpRpc* rpc)
 	if (!status)
 		goto fail;
 	status = rts_send_buffer(&outChannel->common, buffer, header.header.frag_length);
+	if (status)
+		outChannel->OpenTimestamp = GetTickCount64();
 fail:
 	Stream_Free(buffer, TRUE);
 	return status;
@@ -1607,6 +1610,16 @@ BOOL rts_recv_CONN_A3_pdu(rdpRpc* rpc, wStream* buffer)
 	WINPR_ASSERT(rpc->VirtualConnection->DefaultInChannel);
 
 	rpc->VirtualConnection->DefaultInChannel->PingOriginator.ConnectionTimeout = ConnectionTimeout;
+
+	/* CONN/A3 is the out proxy answer to CONN/A1, the delay seeds the receive window tuning */
+	RpcOutChannel* outChannel = rpc->VirtualConnection->DefaultOutChannel;
+	WINPR_ASSERT(outChannel);
+	if (outChannel->OpenTimestamp != 0)
+	{
+		const UINT64 rtt = GetTickCount64() - outChannel->OpenTimestamp;
+		outChannel->RoundTripTime = (UINT32)MIN(MAX(rtt, 1), UINT32_MAX);
+		WLog_DBG(TAG, "OUT channel round trip time: %" PRIu32 "ms", outChannel->RoundTripTime);
+	}
 	return TRUE;
 }
 
@@ -1707,6 +1720,53 @@ BOOL rts_recv_CONN_C2_pdu(rdpRpc* rpc, wStream* buffer)
 
 /* Out-of-Sequence PDUs */
 
+BOOL rts_flow_control_ack_due(const RpcOutChannel* outChannel, BOOL drained)
+{
+	WINPR_ASSERT(outChannel);
+
+	const UINT32 window = outChannel->AvailableWindowAdvertised;
+	const UINT32 pending = outChannel->BytesReceived - outChannel->AckBytesReceived;
+
+	if (pending == 0)
+		return FALSE;
+
+	/* The sender is about to run out of window, acknowledge right away */
+	if (outChannel->ReceiverAvailableWindow < window / 2)
+		return TRUE;
+
+	/* Otherwise acknowledge once per read burst */
+	return drained && (pending >= window / 4);
+}
+
+void rts_update_receive_window(RpcOutChannel* outChannel, UINT64 now)
+{
+	WINPR_ASSERT(outChannel);
+
+	const UINT32 window = outChannel->AvailableWindowAdvertised;
+	const UINT32 pending = outChannel->BytesReceived - outChannel->AckBytesReceived;
+
+	if ((outChannel->AckTimestamp != 0) && (window < outChannel->ReceiveWindow))
+	{
+		/* Bytes received per millisecond since the last ack times the round trip time */
+		const UINT64 elapsed = MAX(now - outChannel->AckTimestamp, 1);
+		const UINT64 bdp = 1ull * pending * MAX(outChannel->RoundTripTime, 1) / elapsed;
+
+		/* Grow while the window and not the link limits the throughput */
+		if (bdp * 2 > window)
+		{
+			outChannel->AvailableWindowAdvertised =
+			    (UINT32)MIN(2ull * window, outChannel->ReceiveWindow);
+			WLog_DBG(TAG,
+			         "receive window %" PRIu32 " -> %" PRIu32 " (bandwidth-delay product %" PRIu64
+			         ")",
+			         window, outChannel->AvailableWindowAdvertised, bdp);
+		}
+	}
+
+	outChannel->AckTimestamp = now;
+	outChannel->AckBytesReceived = outChannel->BytesReceived;
+}
+
 BOOL rts_send_flow_control_ack_pdu(rdpRpc* rpc)
 {
 	BOOL status = FALSE;
@@ -1736,6 +1796,7 @@ BOOL rts_send_flow_control_ack_pdu(rdpRpc* rpc)
 
 	WLog_DBG(TAG, "Sending FlowControlAck RTS PDU");
 
+	rts_update_receive_window(outChannel, GetTickCount64());
 	BytesReceived = outChannel->BytesReceived;
 	AvailableWindow = outChannel->AvailableWindowAdvertised;
 	ChannelCookie = (BYTE*)&(outChannel->common.Cookie);
@@ -77,6 +77,9 @@
 #define FDServer 0x00000002
 #define FDOutProxy 0x00000003
 
+/* Round trip time assumed for receive window tuning until CONN/A3 arrives, in ms */
+#define RTS_DEFAULT_ROUND_TRIP_TIME 100
+
 FREERDP_LOCAL void rts_generate_cookie(BYTE* cookie);
 
 FREERDP_LOCAL BOOL rts_write_pdu_auth3(wStream* s, const rpcconn_rpc_auth_3_hdr_t* auth);
@@ -100,6 +103,8 @@ FREERDP_LOCAL BOOL rts_recv_CONN_C2_pdu(rdpRpc* rpc, wStream* buffer);
 
 FREERDP_LOCAL BOOL rts_send_OUT_R1_A3_pdu(rdpRpc* rpc);
 
+FREERDP_LOCAL BOOL rts_flow_control_ack_due(const RpcOutChannel* outChannel, BOOL drained);
+FREERDP_LOCAL void rts_update_receive_window(RpcOutChannel* outChannel, UINT64 now);
 FREERDP_LOCAL BOOL rts_send_flow_control_ack_pdu(rdpRpc* rpc);
 
 FREERDP_LOCAL BOOL rts_recv_out_of_sequence_pdu(rdpRpc* rpc, wStream* buffer,
@@ -17,87 +17,85 @@
  * limitations under the License.
  */
 
+#include <freerdp/config.h>
+
 #include "websocket.h"
 #include <freerdp/log.h>
 #include "../tcp.h"
 
+#if defined(WITH_SSE2) && (defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64))
+#include <emmintrin.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#elif defined(WITH_NEON) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#include <arm_neon.h>
+#endif
+
 #define TAG FREERDP_TAG("core.gateway.websocket")
 
-BOOL websocket_write_wstream(BIO* bio, wStream* sPacket, WEBSOCKET_OPCODE opcode)
+/* The masking key is kept in wire order, byte n of the payload is XORed with byte n % 4 */
+static UINT32 websocket_mask_rotate(UINT32 maskingKey, size_t offset)
 {
-	size_t fullLen = 0;
-	int status = 0;
-	wStream* sWS = NULL;
-
-	uint32_t maskingKey = 0;
-
-	size_t streamPos = 0;
-
-	WINPR_ASSERT(bio);
-	WINPR_ASSERT(sPacket);
-
-	const size_t len = Stream_Length(sPacket);
-	Stream_SetPosition(sPacket, 0);
-
-	if (len > INT_MAX)
-		return FALSE;
-
-	if (len < 126)
-		fullLen = len + 6; /* 2 byte "mini header" + 4 byte masking key */
-	else if (len < 0x10000)
-		fullLen = len + 8; /* 2 byte "mini header" + 2 byte length + 4 byte masking key */
-	else
-		fullLen = len + 14; /* 2 byte "mini header" + 8 byte length + 4 byte masking key */
-
-	sWS = Stream_New(NULL, fullLen);
-	if (!sWS)
-		return FALSE;
+	BYTE key[4] = { 0 };
+	BYTE rotated[4] = { 0 };
+
+	memcpy(key, &maskingKey, sizeof(key));
+	for (size_t x = 0; x < ARRAYSIZE(rotated); x++)
+		rotated[x] = key[(x + offset) % ARRAYSIZE(key)];
+	memcpy(&maskingKey, rotated, sizeof(rotated));
+	return maskingKey;
+}
 
-	winpr_RAND(&maskingKey, sizeof(maskingKey));
+/* XOR length bytes of src with the repeated key into dst, dst may be src */
+static void websocket_mask(BYTE* dst, const BYTE* src, size_t length, UINT32 maskingKey)
+{
+	size_t x = 0;
 
-	Stream_Write_UINT8(sWS, WEBSOCKET_FIN_BIT | opcode);
-	if (len < 126)
-		Stream_Write_UINT8(sWS, len | WEBSOCKET_MASK_BIT);
-	else if (len < 0x10000)
-	{
-		Stream_Write_UINT8(sWS, 126 | WEBSOCKET_MASK_BIT);
-		Stream_Write_UINT16_BE(sWS, len);
-	}
-	else
+#if defined(WITH_SSE2) && (defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64))
+#if defined(__AVX2__)
+	const __m256i key256 = _mm256_set1_epi32((int)maskingKey);
+	for (; x + 32 <= length; x += 32)
 	{
-		Stream_Write_UINT8(sWS, 127 | WEBSOCKET_MASK_BIT);
-		Stream_Write_UINT32_BE(sWS, 0); /* payload is limited to INT_MAX */
-		Stream_Write_UINT32_BE(sWS, len);
+		const __m256i data = _mm256_loadu_si256((const __m256i*)&src[x]);
+		_mm256_storeu_si256((__m256i*)&dst[x], _mm256_xor_si256(data, key256));
 	}
-	Stream_Write_UINT32(sWS, maskingKey);
-
-	/* mask as much as possible with 32bit access */
-	for (streamPos = 0; streamPos + 4 <= len; streamPos += 4)
+#endif
+	const __m128i key128 = _mm_set1_epi32((int)maskingKey);
+	for (; x + 16 <= length; x += 16)
 	{
-		uint32_t data = 0;
-		Stream_Read_UINT32(sPacket, data);
-		Stream_Write_UINT32(sWS, data ^ maskingKey);
+		const __m128i data = _mm_loadu_si128((const __m128i*)&src[x]);
+		_mm_storeu_si128((__m128i*)&dst[x], _mm_xor_si128(data, key128));
 	}
+#elif defined(WITH_NEON) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+	const uint8x16_t key128 = vreinterpretq_u8_u32(vdupq_n_u32(maskingKey));
+	for (; x + 16 <= length; x += 16)
+		vst1q_u8(&dst[x], veorq_u8(vld1q_u8(&src[x]), key128));
+#endif
 
-	/* mask the rest byte by byte */
-	for (; streamPos < len; streamPos++)
+	for (; x + 4 <= length; x += 4)
 	{
-		BYTE data = 0;
-		BYTE* partialMask = ((BYTE*)&maskingKey) + (streamPos % 4);
-		Stream_Read_UINT8(sPacket, data);
-		Stream_Write_UINT8(sWS, data ^ *partialMask);
+		UINT32 data = 0;
+		memcpy(&data, &src[x], sizeof(data));
+		data ^= maskingKey;
+		memcpy(&dst[x], &data, sizeof(data));
 	}
 
-	Stream_SealLength(sWS);
+	const BYTE* key = (const BYTE*)&maskingKey;
+	for (; x < length; x++)
+		dst[x] = src[x] ^ key[x % 4];
+}
 
-	ERR_clear_error();
-	status = BIO_write(bio, Stream_Buffer(sWS), Stream_Length(sWS));
-	Stream_Free(sWS, TRUE);
+/* Unmask data received at the current payload position and advance the key */
+static void websocket_unmask(websocket_context* encodingContext, BYTE* data, size_t length)
+{
+	WINPR_ASSERT(encodingContext);
 
-	if (status != (SSIZE_T)fullLen)
-		return FALSE;
+	if (!encodingContext->masking)
+		return;
 
-	return TRUE;
+	websocket_mask(data, data, length, encodingContext->maskingKey);
+	encodingContext->maskingKey = websocket_mask_rotate(encodingContext->maskingKey, length);
 }
 
 static int websocket_write_all(BIO* bio, const BYTE* data, size_t length)
@@ -106,6 +104,9 @@ static int websocket_write_all(BIO* bio, const BYTE* data, size_t length)
 	WINPR_ASSERT(data);
 	size_t offset = 0;
 
+	if (length > INT_MAX)
+		return -1;
+
 	while (offset < length)
 	{
 		ERR_clear_error();
@@ -130,75 +131,99 @@ static int websocket_write_all(BIO* bio, const BYTE* data, size_t length)
 		}
 	}
 
-	return length;
+	return (int)length;
 }
 
-int websocket_write(BIO* bio, const BYTE* buf, int isize, WEBSOCKET_OPCODE opcode)
+/* Writes the frame header into the WEBSOCKET_HEADER_RESERVE bytes in front of the already
+ * masked payload and sends header and payload with a single write. */
+static int websocket_write_frame(BIO* bio, BYTE* payload, size_t payloadLength,
+                                 UINT32 maskingKey, WEBSOCKET_OPCODE opcode)
 {
-	size_t payloadSize = 0;
-	size_t fullLen = 0;
-	int status = 0;
-	wStream* sWS = NULL;
-
-	uint32_t maskingKey = 0;
-
-	int streamPos = 0;
-
-	WINPR_ASSERT(bio);
-	WINPR_ASSERT(buf);
-
-	winpr_RAND(&maskingKey, sizeof(maskingKey));
+	size_t headerLength = 6; /* 2 byte "mini header" + 4 byte masking key */
 
-	payloadSize = isize;
-	if ((isize < 0) || (isize > UINT16_MAX))
+	if (payloadLength > INT_MAX)
 		return -1;
 
-	if (payloadSize < 126)
-		fullLen = payloadSize + 6; /* 2 byte "mini header" + 4 byte masking key */
-	else if (payloadSize < 0x10000)
-		fullLen = payloadSize + 8; /* 2 byte "mini header" + 2 byte length + 4 byte masking key */
-	else
-		fullLen = payloadSize + 14; /* 2 byte "mini header" + 8 byte length + 4 byte masking key */
+	if (payloadLength >= 0x10000)
+		headerLength += 8;
+	else if (payloadLength >= 126)
+		headerLength += 2;
 
-	sWS = Stream_New(NULL, fullLen);
-	if (!sWS)
-		return FALSE;
+	WINPR_ASSERT(headerLength <= WEBSOCKET_HEADER_RESERVE);
+
+	wStream sbuffer = { 0 };
+	BYTE* header = payload - headerLength;
+	wStream* s = Stream_StaticInit(&sbuffer, header, headerLength);
 
-	Stream_Write_UINT8(sWS, WEBSOCKET_FIN_BIT | opcode);
-	if (payloadSize < 126)
-		Stream_Write_UINT8(sWS, payloadSize | WEBSOCKET_MASK_BIT);
-	else if (payloadSize < 0x10000)
+	Stream_Write_UINT8(s, WEBSOCKET_FIN_BIT | opcode);
+	if (payloadLength < 126)
+		Stream_Write_UINT8(s, (UINT8)payloadLength | WEBSOCKET_MASK_BIT);
+	else if (payloadLength < 0x10000)
 	{
-		Stream_Write_UINT8(sWS, 126 | WEBSOCKET_MASK_BIT);
-		Stream_Write_UINT16_BE(sWS, payloadSize);
+		Stream_Write_UINT8(s, 126 | WEBSOCKET_MASK_BIT);
+		Stream_Write_UINT16_BE(s, (UINT16)payloadLength);
 	}
 	else
 	{
-		Stream_Write_UINT8(sWS, 127 | WEBSOCKET_MASK_BIT);
-		/* biggest packet possible is 0xffff + 0xa, so 32bit is always enough */
-		Stream_Write_UINT32_BE(sWS, 0);
-		Stream_Write_UINT32_BE(sWS, payloadSize);
+		Stream_Write_UINT8(s, 127 | WEBSOCKET_MASK_BIT);
+		Stream_Write_UINT32_BE(s, 0); /* payload is limited to INT_MAX */
+		Stream_Write_UINT32_BE(s, (UINT32)payloadLength);
 	}
-	Stream_Write_UINT32(sWS, maskingKey);
+	Stream_Write(s, &maskingKey, sizeof(maskingKey));
 
-	/* mask as much as possible with 32bit access */
-	for (streamPos = 0; streamPos + 4 <= isize; streamPos += 4)
-	{
-		uint32_t masked = *((const uint32_t*)((const BYTE*)buf + streamPos)) ^ maskingKey;
-		Stream_Write_UINT32(sWS, masked);
-	}
+	return websocket_write_all(bio, header, headerLength + payloadLength);
+}
 
-	/* mask the rest byte by byte */
-	for (; streamPos < isize; streamPos++)
-	{
-		BYTE* partialMask = (BYTE*)(&maskingKey) + streamPos % 4;
-		BYTE masked = *((const BYTE*)((const BYTE*)buf + streamPos)) ^ *partialMask;
-		Stream_Write_UINT8(sWS, masked);
-	}
+static wStream* websocket_frame_new(size_t payloadLength)
+{
+	wStream* s = Stream_New(NULL, WEBSOCKET_HEADER_RESERVE + payloadLength);
+	if (!s)
+		return NULL;
 
-	Stream_SealLength(sWS);
+	Stream_Seek(s, WEBSOCKET_HEADER_RESERVE);
+	return s;
+}
 
-	status = websocket_write_all(bio, Stream_Buffer(sWS), Stream_Length(sWS));
+BOOL websocket_write_wstream(BIO* bio, wStream* sPacket, WEBSOCKET_OPCODE opcode)
+{
+	uint32_t maskingKey = 0;
+
+	WINPR_ASSERT(bio);
+	WINPR_ASSERT(sPacket);
+
+	const size_t length = Stream_Length(sPacket);
+	if (length < WEBSOCKET_HEADER_RESERVE)
+		return FALSE;
+
+	BYTE* payload = Stream_Buffer(sPacket) + WEBSOCKET_HEADER_RESERVE;
+	const size_t payloadLength = length - WEBSOCKET_HEADER_RESERVE;
+
+	winpr_RAND(&maskingKey, sizeof(maskingKey));
+	websocket_mask(payload, payload, payloadLength, maskingKey);
+
+	return websocket_write_frame(bio, payload, payloadLength, maskingKey, opcode) >= 0;
+}
+
+int websocket_write(BIO* bio, const BYTE* buf, int isize, WEBSOCKET_OPCODE opcode)
+{
+	uint32_t maskingKey = 0;
+
+	WINPR_ASSERT(bio);
+	WINPR_ASSERT(buf);
+
+	if ((isize < 0) || (isize > UINT16_MAX))
+		return -1;
+
+	wStream* sWS = websocket_frame_new((size_t)isize);
+	if (!sWS)
+		return -1;
+
+	/* copy and mask in one pass */
+	winpr_RAND(&maskingKey, sizeof(maskingKey));
+	websocket_mask(Stream_Pointer(sWS), buf, (size_t)isize, maskingKey);
+
+	const int status =
+	    websocket_write_frame(bio, Stream_Pointer(sWS), (size_t)isize, maskingKey, opcode);
 	Stream_Free(sWS, TRUE);
 
 	if (status < 0)
@@ -229,6 +254,7 @@ static int websocket_read_data(BIO* bio, BYTE* pBuffer, size_t size,
 	if (status <= 0)
 		return status;
 
+	websocket_unmask(encodingContext, pBuffer, (size_t)status);
 	encodingContext->payloadLength -= status;
 
 	if (encodingContext->payloadLength == 0)
@@ -252,7 +278,7 @@ static int websocket_read_discard(BIO* bio, websocket_context* encodingContext)
 	}
 
 	ERR_clear_error();
-	status = BIO_read(bio, _dummy, sizeof(_dummy));
+	status = BIO_read(bio, _dummy, MIN(sizeof(_dummy), encodingContext->payloadLength));
 	if (status <= 0)
 		return status;
 
@@ -290,6 +316,7 @@ static int websocket_read_wstream(BIO* bio, wStream* s, websocket_context* encod
 	if (status <= 0)
 		return status;
 
+	websocket_unmask(encodingContext, Stream_Pointer(s), (size_t)status);
 	Stream_Seek(s, status);
 
 	encodingContext->payloadLength -= status;
@@ -351,32 +378,20 @@ static BOOL websocket_reply_close(BIO* bio, wStream* s)
 
 static BOOL websocket_reply_pong(BIO* bio, wStream* s)
 {
-	wStream* closeFrame = NULL;
-	uint32_t maskingKey = 0;
-	int status = 0;
-
 	WINPR_ASSERT(bio);
 
-	if (s != NULL)
-		return websocket_write_wstream(bio, s, WebsocketPongOpcode);
-
-	closeFrame = Stream_New(NULL, 6);
-	if (!closeFrame)
+	const size_t length = s ? Stream_Length(s) : 0;
+	wStream* pongFrame = websocket_frame_new(length);
+	if (!pongFrame)
 		return FALSE;
 
-	Stream_Write_UINT8(closeFrame, WEBSOCKET_FIN_BIT | WebsocketPongOpcode);
-	Stream_Write_UINT8(closeFrame, 0 | WEBSOCKET_MASK_BIT); /* no payload */
-	winpr_RAND(&maskingKey, sizeof(maskingKey));
-	Stream_Write_UINT32(closeFrame, maskingKey); /* dummy masking key. */
-	Stream_SealLength(closeFrame);
-
-	ERR_clear_error();
-	status = BIO_write(bio, Stream_Buffer(closeFrame), Stream_Length(closeFrame));
-	Stream_Free(closeFrame, TRUE);
+	if (length > 0)
+		Stream_Write(pongFrame, Stream_Buffer(s), length);
+	Stream_SealLength(pongFrame);
 
-	if (status < 0)
-		return FALSE;
-	return TRUE;
+	const BOOL rc = websocket_write_wstream(bio, pongFrame, WebsocketPongOpcode);
+	Stream_Free(pongFrame, TRUE);
+	return rc;
 }
 
 static int websocket_handle_payload(BIO* bio, BYTE* pBuffer, size_t size,
@@ -497,6 +512,7 @@ int websocket_read(BIO* bio, BYTE* pBuffer, size_t size, websocket_context* enco
 				encodingContext->masking = ((buffer[0] & WEBSOCKET_MASK_BIT) == WEBSOCKET_MASK_BIT);
 				encodingContext->lengthAndMaskPosition = 0;
 				encodingContext->payloadLength = 0;
+				encodingContext->maskingKey = 0;
 				len = buffer[0] & 0x7f;
 				if (len < 126)
 				{
@@ -526,16 +542,33 @@ int websocket_read(BIO* bio, BYTE* pBuffer, size_t size, websocket_context* enco
 					    (encodingContext->payloadLength) << 8 | buffer[0];
 					encodingContext->lengthAndMaskPosition += status;
 				}
+				encodingContext->lengthAndMaskPosition = 0;
 				encodingContext->state =
 				    (encodingContext->masking ? WebSocketStateMaskingKey : WebSocketStatePayload);
 			}
 			break;
 			case WebSocketStateMaskingKey:
 			{
-				WLog_WARN(
-				    TAG, "Websocket Server sends data with masking key. This is against RFC 6455.");
-				return -1;
+				if (!encodingContext->serverMode)
+				{
+					WLog_WARN(TAG, "Websocket Server sends data with masking key. This is "
+					               "against RFC 6455.");
+					return -1;
+				}
+
+				BYTE* key = (BYTE*)&encodingContext->maskingKey;
+				while (encodingContext->lengthAndMaskPosition < sizeof(encodingContext->maskingKey))
+				{
+					ERR_clear_error();
+					status = BIO_read(bio, (char*)&key[encodingContext->lengthAndMaskPosition], 1);
+					if (status <= 0)
+						return (effectiveDataLen > 0 ? effectiveDataLen : status);
+
+					encodingContext->lengthAndMaskPosition += status;
+				}
+				encodingContext->state = WebSocketStatePayload;
 			}
+			break;
 			case WebSocketStatePayload:
 			{
 				status = websocket_handle_payload(bio, pBuffer, size, encodingContext);
@@ -30,6 +30,9 @@
 #define WEBSOCKET_MASK_BIT 0x80
 #define WEBSOCKET_FIN_BIT 0x80
 
+/* Largest frame header a client sends: 2 byte header, 8 byte length and 4 byte masking key */
+#define WEBSOCKET_HEADER_RESERVE 14
+
 typedef enum
 {
 	WebsocketContinuationOpcode = 0x0,
@@ -55,6 +58,7 @@ typedef struct
 	size_t payloadLength;
 	uint32_t maskingKey;
 	BOOL masking;
+	BOOL serverMode; /* the peer is a client and masks its frames, RFC 6455 5.1 */
 	BOOL closeSent;
 	BYTE opcode;
 	BYTE fragmentOriginalOpcode;
@@ -63,6 +67,8 @@ typedef struct
 	wStream* responseStreamBuffer;
 } websocket_context;
 
+/* The first WEBSOCKET_HEADER_RESERVE bytes of sPacket are left free for the frame header,
+ * the payload follows up to Stream_Length and is masked in place. */
 FREERDP_LOCAL BOOL websocket_write_wstream(BIO* bio, wStream* sPacket, WEBSOCKET_OPCODE opcode);
 FREERDP_LOCAL int websocket_write(BIO* bio, const BYTE* buf, int isize, WEBSOCKET_OPCODE opcode);
 FREERDP_LOCAL int websocket_read(BIO* bio, BYTE* pBuffer, size_t size,
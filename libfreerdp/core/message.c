@@ -2764,7 +2764,9 @@ static BOOL update_message_register_interface(rdpUpdateProxy* message, rdpUpdate
 	primary->MultiDstBlt = update_message_MultiDstBlt;
 	primary->MultiPatBlt = update_message_MultiPatBlt;
 	primary->MultiScrBlt = update_message_MultiScrBlt;
-	primary->MultiOpaqueRect = update_message_MultiOpaqueRect;
+	/* OpaqueRect runs are only batched for clients drawing MultiOpaqueRect themselves */
+	if (message->MultiOpaqueRect)
+		primary->MultiOpaqueRect = update_message_MultiOpaqueRect;
 	primary->MultiDrawNineGrid = update_message_MultiDrawNineGrid;
 	primary->LineTo = update_message_LineTo;
 	primary->Polyline = update_message_Polyline;
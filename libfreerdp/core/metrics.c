@@ -19,7 +19,80 @@
 
 #include <freerdp/config.h>
 
+#include <stdarg.h>
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/assert.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+#include <winpr/wtsapi.h>
+
 #include "rdp.h"
+#include "metrics.h"
+
+#define METRICS_PDU_TYPES 256
+#define METRICS_FRAMES 64
+
+typedef struct
+{
+	UINT32 frameId;
+	UINT64 timestamp;
+} rdpMetricsFrame;
+
+/* The public rdpMetrics is the first member so rdpContext::metrics can be cast back */
+typedef struct
+{
+	rdpMetrics common;
+
+	CRITICAL_SECTION lock;
+	UINT64 resetTime;
+	UINT64 baseBytesSent;
+	UINT64 baseBytesReceived;
+	UINT64 basePacketsSent;
+	UINT64 basePacketsReceived;
+
+	size_t channelCount;
+	FREERDP_METRICS_CHANNEL* channels;
+
+	FREERDP_METRICS_HISTOGRAM* pdus[FREERDP_METRICS_PDU_CATEGORY_COUNT][METRICS_PDU_TYPES];
+
+	UINT64 writeQueueBytes;
+	UINT64 writeQueueBytesMax;
+	FREERDP_METRICS_HISTOGRAM writeBlocked;
+
+	FREERDP_METRICS_HISTOGRAM encode[FREERDP_METRICS_CODEC_COUNT];
+	FREERDP_METRICS_HISTOGRAM decode[FREERDP_METRICS_CODEC_COUNT];
+
+	rdpMetricsFrame frames[METRICS_FRAMES];
+	FREERDP_METRICS_HISTOGRAM frameAckLatency;
+
+	UINT64 presentRects;
+	UINT64 presentPixels;
+	FREERDP_METRICS_HISTOGRAM presentLatency;
+	FREERDP_METRICS_HISTOGRAM presentInterval;
+} rdpMetricsRegistry;
+
+static rdpMetricsRegistry* metrics_registry(rdpMetrics* metrics)
+{
+	return (rdpMetricsRegistry*)metrics;
+}
+
+static void metrics_histogram_add(FREERDP_METRICS_HISTOGRAM* hist, UINT64 durationNs)
+{
+	size_t bucket = 0;
+	const UINT64 us = durationNs / 1000ull;
+
+	WINPR_ASSERT(hist);
+
+	for (UINT64 x = us; (x > 0) && (bucket < FREERDP_METRICS_HISTOGRAM_BUCKETS - 1); x >>= 1)
+		bucket++;
+
+	hist->Count++;
+	hist->TotalUs += us;
+	hist->MaxUs = MAX(hist->MaxUs, us);
+	hist->Buckets[bucket]++;
+}
 
 double metrics_write_bytes(rdpMetrics* metrics, UINT32 UncompressedBytes, UINT32 CompressedBytes)
 {
@@ -37,21 +110,543 @@ double metrics_write_bytes(rdpMetrics* metrics, UINT32 UncompressedBytes, UINT32
 	return CompressionRatio;
 }
 
+void metrics_channel_data(rdpMetrics* metrics, UINT16 channelId, const char* name, size_t bytes,
+                          UINT32 flags, BOOL sent)
+{
+	rdpMetricsRegistry* registry = metrics_registry(metrics);
+	FREERDP_METRICS_CHANNEL* channel = NULL;
+
+	if (!registry)
+		return;
+
+	EnterCriticalSection(&registry->lock);
+	for (size_t x = 0; x < registry->channelCount; x++)
+	{
+		if (registry->channels[x].ChannelId == channelId)
+		{
+			channel = &registry->channels[x];
+			break;
+		}
+	}
+
+	if (!channel)
+	{
+		FREERDP_METRICS_CHANNEL* channels =
+		    realloc(registry->channels, (registry->channelCount + 1) * sizeof(*channels));
+		if (!channels)
+			goto out;
+
+		registry->channels = channels;
+		channel = &channels[registry->channelCount++];
+		memset(channel, 0, sizeof(*channel));
+		channel->ChannelId = channelId;
+		if (name)
+			strncpy(channel->Name, name, sizeof(channel->Name) - 1);
+	}
+
+	if (sent)
+	{
+		channel->BytesSent += bytes;
+		if (flags & CHANNEL_FLAG_LAST)
+			channel->PdusSent++;
+	}
+	else
+	{
+		channel->BytesReceived += bytes;
+		if (flags & CHANNEL_FLAG_LAST)
+			channel->PdusReceived++;
+	}
+
+out:
+	LeaveCriticalSection(&registry->lock);
+}
+
+void metrics_pdu_time(rdpMetrics* metrics, FREERDP_METRICS_PDU_CATEGORY category, UINT8 type,
+                      UINT64 durationNs)
+{
+	rdpMetricsRegistry* registry = metrics_registry(metrics);
+
+	if (!registry || (category >= FREERDP_METRICS_PDU_CATEGORY_COUNT))
+		return;
+
+	EnterCriticalSection(&registry->lock);
+	FREERDP_METRICS_HISTOGRAM* hist = registry->pdus[category][type];
+	if (!hist)
+		hist = registry->pdus[category][type] = calloc(1, sizeof(FREERDP_METRICS_HISTOGRAM));
+	if (hist)
+		metrics_histogram_add(hist, durationNs);
+	LeaveCriticalSection(&registry->lock);
+}
+
+void metrics_write_blocked(rdpMetrics* metrics, UINT64 durationNs)
+{
+	rdpMetricsRegistry* registry = metrics_registry(metrics);
+
+	if (!registry)
+		return;
+
+	EnterCriticalSection(&registry->lock);
+	metrics_histogram_add(&registry->writeBlocked, durationNs);
+	LeaveCriticalSection(&registry->lock);
+}
+
+void metrics_write_queue(rdpMetrics* metrics, size_t bytes)
+{
+	rdpMetricsRegistry* registry = metrics_registry(metrics);
+
+	if (!registry)
+		return;
+
+	EnterCriticalSection(&registry->lock);
+	registry->writeQueueBytes = bytes;
+	registry->writeQueueBytesMax = MAX(registry->writeQueueBytesMax, bytes);
+	LeaveCriticalSection(&registry->lock);
+}
+
+void freerdp_metrics_codec_time(rdpMetrics* metrics, FREERDP_METRICS_CODEC codec, BOOL encode,
+                                UINT64 durationNs)
+{
+	rdpMetricsRegistry* registry = metrics_registry(metrics);
+
+	if (!registry || (codec >= FREERDP_METRICS_CODEC_COUNT))
+		return;
+
+	EnterCriticalSection(&registry->lock);
+	metrics_histogram_add(encode ? &registry->encode[codec] : &registry->decode[codec],
+	                      durationNs);
+	LeaveCriticalSection(&registry->lock);
+}
+
+void freerdp_metrics_frame_sent(rdpMetrics* metrics, UINT32 frameId)
+{
+	rdpMetricsRegistry* registry = metrics_registry(metrics);
+
+	if (!registry)
+		return;
+
+	EnterCriticalSection(&registry->lock);
+	rdpMetricsFrame* frame = &registry->frames[frameId % METRICS_FRAMES];
+	frame->frameId = frameId;
+	frame->timestamp = winpr_GetTickCount64NS();
+	LeaveCriticalSection(&registry->lock);
+}
+
+void freerdp_metrics_frame_acked(rdpMetrics* metrics, UINT32 frameId)
+{
+	rdpMetricsRegistry* registry = metrics_registry(metrics);
+
+	if (!registry)
+		return;
+
+	EnterCriticalSection(&registry->lock);
+	rdpMetricsFrame* frame = &registry->frames[frameId % METRICS_FRAMES];
+	if ((frame->timestamp != 0) && (frame->frameId == frameId))
+	{
+		metrics_histogram_add(&registry->frameAckLatency,
+		                      winpr_GetTickCount64NS() - frame->timestamp);
+		frame->timestamp = 0;
+	}
+	LeaveCriticalSection(&registry->lock);
+}
+
+void freerdp_metrics_frame_presented(rdpMetrics* metrics, UINT64 latencyNs, UINT64 intervalNs,
+                                     UINT64 rects, UINT64 pixels)
+{
+	rdpMetricsRegistry* registry = metrics_registry(metrics);
+
+	if (!registry)
+		return;
+
+	EnterCriticalSection(&registry->lock);
+	registry->presentRects += rects;
+	registry->presentPixels += pixels;
+	metrics_histogram_add(&registry->presentLatency, latencyNs);
+	if (intervalNs != 0)
+		metrics_histogram_add(&registry->presentInterval, intervalNs);
+	LeaveCriticalSection(&registry->lock);
+}
+
+static void metrics_reset_locked(rdpMetricsRegistry* registry)
+{
+	WINPR_ASSERT(registry);
+
+	const rdpRdp* rdp = registry->common.context ? registry->common.context->rdp : NULL;
+
+	registry->resetTime = winpr_GetTickCount64NS();
+	if (rdp)
+	{
+		registry->baseBytesSent = rdp->outBytes;
+		registry->baseBytesReceived = rdp->inBytes;
+		registry->basePacketsSent = rdp->outPackets;
+		registry->basePacketsReceived = rdp->inPackets;
+	}
+
+	for (size_t x = 0; x < registry->channelCount; x++)
+	{
+		FREERDP_METRICS_CHANNEL* channel = &registry->channels[x];
+		channel->BytesSent = channel->BytesReceived = 0;
+		channel->PdusSent = channel->PdusReceived = 0;
+	}
+
+	for (size_t x = 0; x < FREERDP_METRICS_PDU_CATEGORY_COUNT; x++)
+	{
+		for (size_t y = 0; y < METRICS_PDU_TYPES; y++)
+		{
+			free(registry->pdus[x][y]);
+			registry->pdus[x][y] = NULL;
+		}
+	}
+
+	registry->writeQueueBytesMax = registry->writeQueueBytes;
+	memset(&registry->writeBlocked, 0, sizeof(registry->writeBlocked));
+	memset(registry->encode, 0, sizeof(registry->encode));
+	memset(registry->decode, 0, sizeof(registry->decode));
+	memset(&registry->frameAckLatency, 0, sizeof(registry->frameAckLatency));
+	registry->presentRects = 0;
+	registry->presentPixels = 0;
+	memset(&registry->presentLatency, 0, sizeof(registry->presentLatency));
+	memset(&registry->presentInterval, 0, sizeof(registry->presentInterval));
+}
+
+void freerdp_metrics_reset(rdpMetrics* metrics)
+{
+	rdpMetricsRegistry* registry = metrics_registry(metrics);
+
+	if (!registry)
+		return;
+
+	EnterCriticalSection(&registry->lock);
+	metrics_reset_locked(registry);
+	LeaveCriticalSection(&registry->lock);
+}
+
+void freerdp_metrics_snapshot_free(FREERDP_METRICS_SNAPSHOT* snapshot)
+{
+	if (!snapshot)
+		return;
+
+	free(snapshot->Channels);
+	free(snapshot->Pdus);
+	free(snapshot);
+}
+
+FREERDP_METRICS_SNAPSHOT* freerdp_metrics_snapshot(rdpMetrics* metrics, BOOL reset)
+{
+	rdpMetricsRegistry* registry = metrics_registry(metrics);
+
+	if (!registry)
+		return NULL;
+
+	FREERDP_METRICS_SNAPSHOT* snapshot = calloc(1, sizeof(FREERDP_METRICS_SNAPSHOT));
+	if (!snapshot)
+		return NULL;
+
+	EnterCriticalSection(&registry->lock);
+
+	const rdpRdp* rdp = registry->common.context ? registry->common.context->rdp : NULL;
+	snapshot->DurationUs = (winpr_GetTickCount64NS() - registry->resetTime) / 1000ull;
+	if (rdp)
+	{
+		snapshot->BytesSent = rdp->outBytes - registry->baseBytesSent;
+		snapshot->BytesReceived = rdp->inBytes - registry->baseBytesReceived;
+		snapshot->PacketsSent = rdp->outPackets - registry->basePacketsSent;
+		snapshot->PacketsReceived = rdp->inPackets - registry->basePacketsReceived;
+	}
+
+	if (registry->channelCount > 0)
+	{
+		snapshot->Channels = calloc(registry->channelCount, sizeof(FREERDP_METRICS_CHANNEL));
+		if (!snapshot->Channels)
+			goto fail;
+
+		memcpy(snapshot->Channels, registry->channels,
+		       registry->channelCount * sizeof(FREERDP_METRICS_CHANNEL));
+		snapshot->ChannelCount = registry->channelCount;
+	}
+
+	for (size_t x = 0; x < FREERDP_METRICS_PDU_CATEGORY_COUNT; x++)
+	{
+		for (size_t y = 0; y < METRICS_PDU_TYPES; y++)
+		{
+			if (!registry->pdus[x][y])
+				continue;
+
+			FREERDP_METRICS_PDU* pdus =
+			    realloc(snapshot->Pdus, (snapshot->PduCount + 1) * sizeof(FREERDP_METRICS_PDU));
+			if (!pdus)
+				goto fail;
+
+			snapshot->Pdus = pdus;
+			FREERDP_METRICS_PDU* pdu = &pdus[snapshot->PduCount++];
+			pdu->Category = (FREERDP_METRICS_PDU_CATEGORY)x;
+			pdu->Type = (UINT8)y;
+			pdu->Time = *registry->pdus[x][y];
+		}
+	}
+
+	snapshot->WriteQueueBytes = registry->writeQueueBytes;
+	snapshot->WriteQueueBytesMax = registry->writeQueueBytesMax;
+	snapshot->WriteBlocked = registry->writeBlocked;
+	memcpy(snapshot->Encode, registry->encode, sizeof(snapshot->Encode));
+	memcpy(snapshot->Decode, registry->decode, sizeof(snapshot->Decode));
+	snapshot->FrameAckLatency = registry->frameAckLatency;
+	snapshot->PresentRects = registry->presentRects;
+	snapshot->PresentPixels = registry->presentPixels;
+	snapshot->PresentLatency = registry->presentLatency;
+	snapshot->PresentInterval = registry->presentInterval;
+
+	if (reset)
+		metrics_reset_locked(registry);
+
+	LeaveCriticalSection(&registry->lock);
+	return snapshot;
+
+fail:
+	LeaveCriticalSection(&registry->lock);
+	freerdp_metrics_snapshot_free(snapshot);
+	return NULL;
+}
+
+UINT64 freerdp_metrics_histogram_percentile(const FREERDP_METRICS_HISTOGRAM* hist,
+                                            double percentile)
+{
+	UINT64 seen = 0;
+
+	if (!hist || (hist->Count == 0))
+		return 0;
+
+	const double wanted = (double)hist->Count * MIN(MAX(percentile, 0.0), 100.0) / 100.0;
+	for (size_t x = 0; x < FREERDP_METRICS_HISTOGRAM_BUCKETS - 1; x++)
+	{
+		seen += hist->Buckets[x];
+		if ((double)seen >= wanted)
+			return MIN(1ull << x, hist->MaxUs);
+	}
+
+	return hist->MaxUs;
+}
+
+const char* freerdp_metrics_codec_name(FREERDP_METRICS_CODEC codec)
+{
+	switch (codec)
+	{
+		case FREERDP_METRICS_CODEC_UNCOMPRESSED:
+			return "uncompressed";
+		case FREERDP_METRICS_CODEC_INTERLEAVED:
+			return "interleaved";
+		case FREERDP_METRICS_CODEC_PLANAR:
+			return "planar";
+		case FREERDP_METRICS_CODEC_REMOTEFX:
+			return "remotefx";
+		case FREERDP_METRICS_CODEC_NSCODEC:
+			return "nscodec";
+		case FREERDP_METRICS_CODEC_CLEARCODEC:
+			return "clearcodec";
+		case FREERDP_METRICS_CODEC_PROGRESSIVE:
+			return "progressive";
+		case FREERDP_METRICS_CODEC_AVC420:
+			return "avc420";
+		case FREERDP_METRICS_CODEC_AVC444:
+			return "avc444";
+		case FREERDP_METRICS_CODEC_ALPHA:
+			return "alpha";
+		default:
+			return "unknown";
+	}
+}
+
+const char* freerdp_metrics_pdu_category_name(FREERDP_METRICS_PDU_CATEGORY category)
+{
+	switch (category)
+	{
+		case FREERDP_METRICS_PDU_DATA:
+			return "data";
+		case FREERDP_METRICS_PDU_FASTPATH_UPDATE:
+			return "fastpath-update";
+		case FREERDP_METRICS_PDU_FASTPATH_INPUT:
+			return "fastpath-input";
+		default:
+			return "unknown";
+	}
+}
+
+static BOOL metrics_append(char** str, size_t* len, size_t* size, const char* fmt, ...)
+{
+	WINPR_ASSERT(str);
+	WINPR_ASSERT(len);
+	WINPR_ASSERT(size);
+
+	while (TRUE)
+	{
+		va_list ap;
+		va_start(ap, fmt);
+		const int rc = vsnprintf(&(*str)[*len], *size - *len, fmt, ap);
+		va_end(ap);
+
+		if (rc < 0)
+			return FALSE;
+
+		if ((size_t)rc < *size - *len)
+		{
+			*len += (size_t)rc;
+			return TRUE;
+		}
+
+		const size_t newSize = MAX(*size * 2, *len + (size_t)rc + 1);
+		char* tmp = realloc(*str, newSize);
+		if (!tmp)
+			return FALSE;
+
+		*str = tmp;
+		*size = newSize;
+	}
+}
+
+static BOOL metrics_append_histogram(char** str, size_t* len, size_t* size, const char* prefix,
+                                     const char* name, const char* labels,
+                                     const FREERDP_METRICS_HISTOGRAM* hist)
+{
+	if (hist->Count == 0)
+		return TRUE;
+
+	return metrics_append(str, len, size,
+	                      "%s%s{%s} count=%" PRIu64 " avg=%" PRIu64 " p50=%" PRIu64
+	                      " p99=%" PRIu64 " max=%" PRIu64 "\n",
+	                      prefix, name, labels, hist->Count, hist->TotalUs / hist->Count,
+	                      freerdp_metrics_histogram_percentile(hist, 50.0),
+	                      freerdp_metrics_histogram_percentile(hist, 99.0), hist->MaxUs);
+}
+
+char* freerdp_metrics_snapshot_format(const FREERDP_METRICS_SNAPSHOT* snapshot, const char* prefix)
+{
+	char labels[64] = { 0 };
+	size_t len = 0;
+	size_t size = 1024;
+	char* str = NULL;
+
+	if (!snapshot)
+		return NULL;
+
+	if (!prefix)
+		prefix = "";
+
+	str = calloc(size, sizeof(char));
+	if (!str)
+		return NULL;
+
+	if (!metrics_append(&str, &len, &size,
+	                    "%sfreerdp_connection{} duration=%" PRIu64 " bytes_sent=%" PRIu64
+	                    " bytes_received=%" PRIu64 " packets_sent=%" PRIu64
+	                    " packets_received=%" PRIu64 "\n",
+	                    prefix, snapshot->DurationUs, snapshot->BytesSent, snapshot->BytesReceived,
+	                    snapshot->PacketsSent, snapshot->PacketsReceived))
+		goto fail;
+
+	for (size_t x = 0; x < snapshot->ChannelCount; x++)
+	{
+		const FREERDP_METRICS_CHANNEL* channel = &snapshot->Channels[x];
+		if (!metrics_append(&str, &len, &size,
+		                    "%sfreerdp_channel{name=\"%s\",id=\"%" PRIu16 "\"} bytes_sent=%" PRIu64
+		                    " bytes_received=%" PRIu64 " pdus_sent=%" PRIu64
+		                    " pdus_received=%" PRIu64 "\n",
+		                    prefix, channel->Name, channel->ChannelId, channel->BytesSent,
+		                    channel->BytesReceived, channel->PdusSent, channel->PdusReceived))
+			goto fail;
+	}
+
+	for (size_t x = 0; x < snapshot->PduCount; x++)
+	{
+		const FREERDP_METRICS_PDU* pdu = &snapshot->Pdus[x];
+		(void)_snprintf(labels, sizeof(labels), "category=\"%s\",type=\"0x%02" PRIX8 "\"",
+		                freerdp_metrics_pdu_category_name(pdu->Category), pdu->Type);
+		if (!metrics_append_histogram(&str, &len, &size, prefix, "freerdp_pdu_time", labels,
+		                              &pdu->Time))
+			goto fail;
+	}
+
+	if (!metrics_append(&str, &len, &size,
+	                    "%sfreerdp_write_queue{} bytes=%" PRIu64 " bytes_max=%" PRIu64 "\n", prefix,
+	                    snapshot->WriteQueueBytes, snapshot->WriteQueueBytesMax))
+		goto fail;
+
+	if (!metrics_append_histogram(&str, &len, &size, prefix, "freerdp_write_blocked", "",
+	                              &snapshot->WriteBlocked))
+		goto fail;
+
+	for (size_t x = 0; x < FREERDP_METRICS_CODEC_COUNT; x++)
+	{
+		const char* name = freerdp_metrics_codec_name((FREERDP_METRICS_CODEC)x);
+
+		(void)_snprintf(labels, sizeof(labels), "codec=\"%s\",direction=\"encode\"", name);
+		if (!metrics_append_histogram(&str, &len, &size, prefix, "freerdp_codec_time", labels,
+		                              &snapshot->Encode[x]))
+			goto fail;
+
+		(void)_snprintf(labels, sizeof(labels), "codec=\"%s\",direction=\"decode\"", name);
+		if (!metrics_append_histogram(&str, &len, &size, prefix, "freerdp_codec_time", labels,
+		                              &snapshot->Decode[x]))
+			goto fail;
+	}
+
+	if (!metrics_append_histogram(&str, &len, &size, prefix, "freerdp_frame_ack_latency", "",
+	                              &snapshot->FrameAckLatency))
+		goto fail;
+
+	if (snapshot->PresentLatency.Count > 0)
+	{
+		if (!metrics_append(&str, &len, &size,
+		                    "%sfreerdp_present{} rects=%" PRIu64 " pixels=%" PRIu64 "\n", prefix,
+		                    snapshot->PresentRects, snapshot->PresentPixels))
+			goto fail;
+	}
+
+	if (!metrics_append_histogram(&str, &len, &size, prefix, "freerdp_present_latency", "",
+	                              &snapshot->PresentLatency))
+		goto fail;
+
+	if (!metrics_append_histogram(&str, &len, &size, prefix, "freerdp_present_interval", "",
+	                              &snapshot->PresentInterval))
+		goto fail;
+
+	return str;
+
+fail:
+	free(str);
+	return NULL;
+}
+
 rdpMetrics* metrics_new(rdpContext* context)
 {
-	rdpMetrics* metrics = NULL;
+	rdpMetricsRegistry* registry = (rdpMetricsRegistry*)calloc(1, sizeof(rdpMetricsRegistry));
 
-	metrics = (rdpMetrics*)calloc(1, sizeof(rdpMetrics));
+	if (!registry)
+		return NULL;
 
-	if (metrics)
+	if (!InitializeCriticalSectionAndSpinCount(&registry->lock, 4000))
 	{
-		metrics->context = context;
+		free(registry);
+		return NULL;
 	}
 
-	return metrics;
+	registry->common.context = context;
+	registry->resetTime = winpr_GetTickCount64NS();
+	return &registry->common;
 }
 
 void metrics_free(rdpMetrics* metrics)
 {
-	free(metrics);
+	rdpMetricsRegistry* registry = metrics_registry(metrics);
+
+	if (!registry)
+		return;
+
+	for (size_t x = 0; x < FREERDP_METRICS_PDU_CATEGORY_COUNT; x++)
+	{
+		for (size_t y = 0; y < METRICS_PDU_TYPES; y++)
+			free(registry->pdus[x][y]);
+	}
+
+	free(registry->channels);
+	DeleteCriticalSection(&registry->lock);
+	free(registry);
 }
@@ -0,0 +1,34 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Protocol Metrics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CORE_METRICS_H
+#define FREERDP_LIB_CORE_METRICS_H
+
+#include <freerdp/api.h>
+#include <freerdp/metrics.h>
+
+/* One virtual channel chunk, a channel PDU is counted on its CHANNEL_FLAG_LAST chunk */
+FREERDP_LOCAL void metrics_channel_data(rdpMetrics* metrics, UINT16 channelId, const char* name,
+                                        size_t bytes, UINT32 flags, BOOL sent);
+
+FREERDP_LOCAL void metrics_pdu_time(rdpMetrics* metrics, FREERDP_METRICS_PDU_CATEGORY category,
+                                    UINT8 type, UINT64 durationNs);
+
+FREERDP_LOCAL void metrics_write_blocked(rdpMetrics* metrics, UINT64 durationNs);
+FREERDP_LOCAL void metrics_write_queue(rdpMetrics* metrics, size_t bytes);
+
+#endif /* FREERDP_LIB_CORE_METRICS_H */
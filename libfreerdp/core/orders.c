@@ -23,6 +23,8 @@
 
 #include "settings.h"
 
+#include <stddef.h>
+
 #include <winpr/wtypes.h>
 #include <winpr/crt.h>
 #include <winpr/assert.h>
@@ -1091,28 +1093,6 @@ static INLINE BOOL read_order_field_byte(const char* orderName, const ORDER_INFO
 	return TRUE;
 }
 
-static INLINE BOOL read_order_field_2bytes(const char* orderName, const ORDER_INFO* orderInfo,
-                                           wStream* s, BYTE number, UINT32* target1,
-                                           UINT32* target2, BOOL optional)
-{
-	WINPR_ASSERT(orderName);
-	WINPR_ASSERT(orderInfo);
-	WINPR_ASSERT(target1);
-	WINPR_ASSERT(target2);
-
-	if (!order_field_flag_is_set(orderInfo, number))
-	{
-		WLog_DBG(TAG, "order %s field %" PRIu8 " not found [optional:%d]", orderName, number,
-		         optional);
-		return TRUE;
-	}
-	if (!Stream_CheckAndLogRequiredLength(TAG, s, 2))
-		return FALSE;
-	Stream_Read_UINT8(s, *target1);
-	Stream_Read_UINT8(s, *target2);
-	return TRUE;
-}
-
 static INLINE BOOL read_order_field_uint16(const char* orderName, const ORDER_INFO* orderInfo,
                                            wStream* s, BYTE number, UINT32* target, BOOL optional)
 {
@@ -1155,43 +1135,6 @@ static INLINE BOOL read_order_field_int16(const char* orderName, const ORDER_INF
 	return TRUE;
 }
 
-static INLINE BOOL read_order_field_uint32(const char* orderName, const ORDER_INFO* orderInfo,
-                                           wStream* s, BYTE number, UINT32* target, BOOL optional)
-{
-	WINPR_ASSERT(orderName);
-	WINPR_ASSERT(orderInfo);
-	WINPR_ASSERT(target);
-
-	if (!order_field_flag_is_set(orderInfo, number))
-	{
-		WLog_DBG(TAG, "order %s field %" PRIu8 " not found [optional:%d]", orderName, number,
-		         optional);
-		return TRUE;
-	}
-
-	if (!Stream_CheckAndLogRequiredLength(TAG, s, 4))
-		return FALSE;
-
-	Stream_Read_UINT32(s, *target);
-	return TRUE;
-}
-
-static INLINE BOOL read_order_field_coord(const char* orderName, const ORDER_INFO* orderInfo,
-                                          wStream* s, UINT32 NO, INT32* TARGET, BOOL optional)
-{
-	WINPR_ASSERT(orderName);
-	WINPR_ASSERT(orderInfo);
-	WINPR_ASSERT(TARGET);
-
-	if (!order_field_flag_is_set(orderInfo, NO))
-	{
-		WLog_DBG(TAG, "order %s field %" PRIu8 " not found [optional:%d]", orderName, NO, optional);
-		return TRUE;
-	}
-
-	return update_read_coord(s, TARGET, orderInfo->deltaCoordinates);
-}
-
 static INLINE BOOL read_order_field_color(const char* orderName, const ORDER_INFO* orderInfo,
                                           wStream* s, UINT32 NO, UINT32* TARGET, BOOL optional)
 {
@@ -1225,17 +1168,185 @@ static INLINE BOOL FIELD_SKIP_BUFFER16(wStream* s, UINT32 TARGET_LEN)
 
 	return TRUE;
 }
+/* Fixed size fields of the primary drawing orders are described by a table per order type.
+ * All present fields are length checked at once and decoded in one loop over the set field
+ * flags, the variable size parts (brushes, delta lists, glyph data) follow as before. */
+typedef enum
+{
+	PRIMARY_FIELD_COORD,       /* INT32, 2 byte signed or 1 byte signed delta */
+	PRIMARY_FIELD_INT16,       /* INT32 */
+	PRIMARY_FIELD_BYTE,        /* UINT32 */
+	PRIMARY_FIELD_UINT16,      /* UINT32 */
+	PRIMARY_FIELD_UINT32,      /* UINT32 */
+	PRIMARY_FIELD_COLOR,       /* UINT32, 3 byte RGB */
+	PRIMARY_FIELD_COLOR_BYTE0, /* UINT32, one byte of a color split over three fields */
+	PRIMARY_FIELD_COLOR_BYTE1,
+	PRIMARY_FIELD_COLOR_BYTE2,
+	PRIMARY_FIELD_2BYTES /* two UINT32 of one byte each in a single field */
+} PRIMARY_FIELD_TYPE;
+
+typedef struct
+{
+	PRIMARY_FIELD_TYPE type;
+	size_t offset;
+	size_t offset2;
+} PRIMARY_ORDER_FIELD;
+
+#define PRIMARY_FIELD(type, order, member) \
+	{                                      \
+		type, offsetof(order, member), 0   \
+	}
+#define PRIMARY_FIELD_PAIR(order, first, second)                            \
+	{                                                                       \
+		PRIMARY_FIELD_2BYTES, offsetof(order, first), offsetof(order, second) \
+	}
+
+/* encoded size of a field with absolute and with delta coordinates */
+static const BYTE primary_field_size[][2] = {
+	{ 2, 1 }, /* PRIMARY_FIELD_COORD */
+	{ 2, 2 }, /* PRIMARY_FIELD_INT16 */
+	{ 1, 1 }, /* PRIMARY_FIELD_BYTE */
+	{ 2, 2 }, /* PRIMARY_FIELD_UINT16 */
+	{ 4, 4 }, /* PRIMARY_FIELD_UINT32 */
+	{ 3, 3 }, /* PRIMARY_FIELD_COLOR */
+	{ 1, 1 }, /* PRIMARY_FIELD_COLOR_BYTE0 */
+	{ 1, 1 }, /* PRIMARY_FIELD_COLOR_BYTE1 */
+	{ 1, 1 }, /* PRIMARY_FIELD_COLOR_BYTE2 */
+	{ 2, 2 }  /* PRIMARY_FIELD_2BYTES */
+};
+
+/* index of the lowest set field flag */
+static INLINE size_t primary_field_index(UINT32 flags)
+{
+	WINPR_ASSERT(flags != 0);
+#if defined(__GNUC__)
+	return (size_t)__builtin_ctz(flags);
+#else
+	size_t index = 0;
+	while ((flags & 1) == 0)
+	{
+		flags >>= 1;
+		index++;
+	}
+	return index;
+#endif
+}
+
+static INLINE void read_primary_color_byte(wStream* s, UINT32* color, UINT32 shift)
+{
+	BYTE byte = 0;
+	Stream_Read_UINT8(s, byte);
+	*color = (*color & ~(0xFFUL << shift)) | ((UINT32)byte << shift);
+}
+
+/* decode the fields 1 to count of an order, fields that are not present keep their value */
+static BOOL read_primary_order_fields(wStream* s, const ORDER_INFO* orderInfo,
+                                      const PRIMARY_ORDER_FIELD* fields, size_t count, void* order)
+{
+	BYTE* base = order;
+	size_t length = 0;
+
+	WINPR_ASSERT(orderInfo);
+	WINPR_ASSERT(fields);
+	WINPR_ASSERT(order);
+	WINPR_ASSERT((count > 0) && (count < 32));
+
+	const size_t delta = orderInfo->deltaCoordinates ? 1 : 0;
+
+	const UINT32 present = orderInfo->fieldFlags & ((1UL << count) - 1UL);
+
+	for (UINT32 flags = present; flags != 0; flags &= flags - 1)
+		length += primary_field_size[fields[primary_field_index(flags)].type][delta];
+
+	if (!Stream_CheckAndLogRequiredLength(TAG, s, length))
+		return FALSE;
+
+	for (UINT32 flags = present; flags != 0; flags &= flags - 1)
+	{
+		const PRIMARY_ORDER_FIELD* field = &fields[primary_field_index(flags)];
+		INT32* i32 = (INT32*)&base[field->offset];
+		UINT32* u32 = (UINT32*)&base[field->offset];
+
+		switch (field->type)
+		{
+			case PRIMARY_FIELD_COORD:
+				if (delta)
+				{
+					INT8 lsi8 = 0;
+					Stream_Read_INT8(s, lsi8);
+					*i32 += lsi8;
+				}
+				else
+				{
+					INT16 lsi16 = 0;
+					Stream_Read_INT16(s, lsi16);
+					*i32 = lsi16;
+				}
+				break;
+
+			case PRIMARY_FIELD_INT16:
+				Stream_Read_INT16(s, *i32);
+				break;
+
+			case PRIMARY_FIELD_BYTE:
+				Stream_Read_UINT8(s, *u32);
+				break;
+
+			case PRIMARY_FIELD_UINT16:
+				Stream_Read_UINT16(s, *u32);
+				break;
+
+			case PRIMARY_FIELD_UINT32:
+				Stream_Read_UINT32(s, *u32);
+				break;
+
+			case PRIMARY_FIELD_COLOR:
+				*u32 = 0;
+				read_primary_color_byte(s, u32, 0);
+				read_primary_color_byte(s, u32, 8);
+				read_primary_color_byte(s, u32, 16);
+				break;
+
+			case PRIMARY_FIELD_COLOR_BYTE0:
+				read_primary_color_byte(s, u32, 0);
+				break;
+
+			case PRIMARY_FIELD_COLOR_BYTE1:
+				read_primary_color_byte(s, u32, 8);
+				break;
+
+			case PRIMARY_FIELD_COLOR_BYTE2:
+				read_primary_color_byte(s, u32, 16);
+				break;
+
+			case PRIMARY_FIELD_2BYTES:
+				Stream_Read_UINT8(s, *u32);
+				Stream_Read_UINT8(s, *(UINT32*)&base[field->offset2]);
+				break;
+
+			default:
+				return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
 /* Primary Drawing Orders */
+static const PRIMARY_ORDER_FIELD dstblt_fields[] = {
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, DSTBLT_ORDER, nLeftRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, DSTBLT_ORDER, nTopRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, DSTBLT_ORDER, nWidth),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, DSTBLT_ORDER, nHeight),
+	PRIMARY_FIELD(PRIMARY_FIELD_BYTE, DSTBLT_ORDER, bRop)
+};
+
 static BOOL update_read_dstblt_order(const char* orderName, wStream* s, const ORDER_INFO* orderInfo,
                                      DSTBLT_ORDER* dstblt)
 {
-	if (read_order_field_coord(orderName, orderInfo, s, 1, &dstblt->nLeftRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 2, &dstblt->nTopRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 3, &dstblt->nWidth, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 4, &dstblt->nHeight, FALSE) &&
-	    read_order_field_byte(orderName, orderInfo, s, 5, &dstblt->bRop, TRUE))
-		return TRUE;
-	return FALSE;
+	WINPR_UNUSED(orderName);
+	return read_primary_order_fields(s, orderInfo, dstblt_fields, ARRAYSIZE(dstblt_fields),
+	                                 dstblt);
 }
 
 size_t update_approximate_dstblt_order(ORDER_INFO* orderInfo, const DSTBLT_ORDER* dstblt)
@@ -1264,19 +1375,23 @@ BOOL update_write_dstblt_order(wStream* s, ORDER_INFO* orderInfo, const DSTBLT_O
 	return TRUE;
 }
 
+static const PRIMARY_ORDER_FIELD patblt_fields[] = {
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, PATBLT_ORDER, nLeftRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, PATBLT_ORDER, nTopRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, PATBLT_ORDER, nWidth),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, PATBLT_ORDER, nHeight),
+	PRIMARY_FIELD(PRIMARY_FIELD_BYTE, PATBLT_ORDER, bRop),
+	PRIMARY_FIELD(PRIMARY_FIELD_COLOR, PATBLT_ORDER, backColor),
+	PRIMARY_FIELD(PRIMARY_FIELD_COLOR, PATBLT_ORDER, foreColor)
+};
+
 static BOOL update_read_patblt_order(const char* orderName, wStream* s, const ORDER_INFO* orderInfo,
                                      PATBLT_ORDER* patblt)
 {
-	if (read_order_field_coord(orderName, orderInfo, s, 1, &patblt->nLeftRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 2, &patblt->nTopRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 3, &patblt->nWidth, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 4, &patblt->nHeight, FALSE) &&
-	    read_order_field_byte(orderName, orderInfo, s, 5, &patblt->bRop, TRUE) &&
-	    read_order_field_color(orderName, orderInfo, s, 6, &patblt->backColor, TRUE) &&
-	    read_order_field_color(orderName, orderInfo, s, 7, &patblt->foreColor, TRUE) &&
-	    update_read_brush(s, &patblt->brush, orderInfo->fieldFlags >> 7))
-		return TRUE;
-	return FALSE;
+	WINPR_UNUSED(orderName);
+	return read_primary_order_fields(s, orderInfo, patblt_fields, ARRAYSIZE(patblt_fields),
+	                                 patblt) &&
+	       update_read_brush(s, &patblt->brush, orderInfo->fieldFlags >> 7);
 }
 
 size_t update_approximate_patblt_order(ORDER_INFO* orderInfo, PATBLT_ORDER* patblt)
@@ -1315,18 +1430,22 @@ BOOL update_write_patblt_order(wStream* s, ORDER_INFO* orderInfo, PATBLT_ORDER*
 	return TRUE;
 }
 
+static const PRIMARY_ORDER_FIELD scrblt_fields[] = {
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, SCRBLT_ORDER, nLeftRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, SCRBLT_ORDER, nTopRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, SCRBLT_ORDER, nWidth),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, SCRBLT_ORDER, nHeight),
+	PRIMARY_FIELD(PRIMARY_FIELD_BYTE, SCRBLT_ORDER, bRop),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, SCRBLT_ORDER, nXSrc),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, SCRBLT_ORDER, nYSrc)
+};
+
 static BOOL update_read_scrblt_order(const char* orderName, wStream* s, const ORDER_INFO* orderInfo,
                                      SCRBLT_ORDER* scrblt)
 {
-	if (read_order_field_coord(orderName, orderInfo, s, 1, &scrblt->nLeftRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 2, &scrblt->nTopRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 3, &scrblt->nWidth, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 4, &scrblt->nHeight, FALSE) &&
-	    read_order_field_byte(orderName, orderInfo, s, 5, &scrblt->bRop, TRUE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 6, &scrblt->nXSrc, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 7, &scrblt->nYSrc, FALSE))
-		return TRUE;
-	return FALSE;
+	WINPR_UNUSED(orderName);
+	return read_primary_order_fields(s, orderInfo, scrblt_fields, ARRAYSIZE(scrblt_fields),
+	                                 scrblt);
 }
 
 size_t update_approximate_scrblt_order(ORDER_INFO* orderInfo, const SCRBLT_ORDER* scrblt)
@@ -1358,45 +1477,24 @@ BOOL update_write_scrblt_order(wStream* s, ORDER_INFO* orderInfo, const SCRBLT_O
 	update_write_coord(s, scrblt->nYSrc);
 	return TRUE;
 }
+
+static const PRIMARY_ORDER_FIELD opaque_rect_fields[] = {
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, OPAQUE_RECT_ORDER, nLeftRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, OPAQUE_RECT_ORDER, nTopRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, OPAQUE_RECT_ORDER, nWidth),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, OPAQUE_RECT_ORDER, nHeight),
+	PRIMARY_FIELD(PRIMARY_FIELD_COLOR_BYTE0, OPAQUE_RECT_ORDER, color),
+	PRIMARY_FIELD(PRIMARY_FIELD_COLOR_BYTE1, OPAQUE_RECT_ORDER, color),
+	PRIMARY_FIELD(PRIMARY_FIELD_COLOR_BYTE2, OPAQUE_RECT_ORDER, color)
+};
+
 static BOOL update_read_opaque_rect_order(const char* orderName, wStream* s,
                                           const ORDER_INFO* orderInfo,
                                           OPAQUE_RECT_ORDER* opaque_rect)
 {
-	BYTE byte = 0;
-	if (!read_order_field_coord(orderName, orderInfo, s, 1, &opaque_rect->nLeftRect, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 2, &opaque_rect->nTopRect, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 3, &opaque_rect->nWidth, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 4, &opaque_rect->nHeight, FALSE))
-		return FALSE;
-
-	if ((orderInfo->fieldFlags & ORDER_FIELD_05) != 0)
-	{
-		if (!Stream_CheckAndLogRequiredLength(TAG, s, 1))
-			return FALSE;
-
-		Stream_Read_UINT8(s, byte);
-		opaque_rect->color = (opaque_rect->color & 0x00FFFF00) | ((UINT32)byte);
-	}
-
-	if ((orderInfo->fieldFlags & ORDER_FIELD_06) != 0)
-	{
-		if (!Stream_CheckAndLogRequiredLength(TAG, s, 1))
-			return FALSE;
-
-		Stream_Read_UINT8(s, byte);
-		opaque_rect->color = (opaque_rect->color & 0x00FF00FF) | ((UINT32)byte << 8);
-	}
-
-	if ((orderInfo->fieldFlags & ORDER_FIELD_07) != 0)
-	{
-		if (!Stream_CheckAndLogRequiredLength(TAG, s, 1))
-			return FALSE;
-
-		Stream_Read_UINT8(s, byte);
-		opaque_rect->color = (opaque_rect->color & 0x0000FFFF) | ((UINT32)byte << 16);
-	}
-
-	return TRUE;
+	WINPR_UNUSED(orderName);
+	return read_primary_order_fields(s, orderInfo, opaque_rect_fields,
+	                                 ARRAYSIZE(opaque_rect_fields), opaque_rect);
 }
 
 size_t update_approximate_opaque_rect_order(ORDER_INFO* orderInfo,
@@ -1438,29 +1536,38 @@ BOOL update_write_opaque_rect_order(wStream* s, ORDER_INFO* orderInfo,
 	return TRUE;
 }
 
+static const PRIMARY_ORDER_FIELD draw_nine_grid_fields[] = {
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, DRAW_NINE_GRID_ORDER, srcLeft),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, DRAW_NINE_GRID_ORDER, srcTop),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, DRAW_NINE_GRID_ORDER, srcRight),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, DRAW_NINE_GRID_ORDER, srcBottom),
+	PRIMARY_FIELD(PRIMARY_FIELD_UINT16, DRAW_NINE_GRID_ORDER, bitmapId)
+};
+
 static BOOL update_read_draw_nine_grid_order(const char* orderName, wStream* s,
                                              const ORDER_INFO* orderInfo,
                                              DRAW_NINE_GRID_ORDER* draw_nine_grid)
 {
-	if (read_order_field_coord(orderName, orderInfo, s, 1, &draw_nine_grid->srcLeft, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 2, &draw_nine_grid->srcTop, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 3, &draw_nine_grid->srcRight, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 4, &draw_nine_grid->srcBottom, FALSE) &&
-	    read_order_field_uint16(orderName, orderInfo, s, 5, &draw_nine_grid->bitmapId, FALSE))
-		return TRUE;
-	return FALSE;
+	WINPR_UNUSED(orderName);
+	return read_primary_order_fields(s, orderInfo, draw_nine_grid_fields,
+	                                 ARRAYSIZE(draw_nine_grid_fields), draw_nine_grid);
 }
 
+static const PRIMARY_ORDER_FIELD multi_dstblt_fields[] = {
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MULTI_DSTBLT_ORDER, nLeftRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MULTI_DSTBLT_ORDER, nTopRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MULTI_DSTBLT_ORDER, nWidth),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MULTI_DSTBLT_ORDER, nHeight),
+	PRIMARY_FIELD(PRIMARY_FIELD_BYTE, MULTI_DSTBLT_ORDER, bRop)
+};
+
 static BOOL update_read_multi_dstblt_order(const char* orderName, wStream* s,
                                            const ORDER_INFO* orderInfo,
                                            MULTI_DSTBLT_ORDER* multi_dstblt)
 {
 	UINT32 numRectangles = multi_dstblt->numRectangles;
-	if (!read_order_field_coord(orderName, orderInfo, s, 1, &multi_dstblt->nLeftRect, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 2, &multi_dstblt->nTopRect, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 3, &multi_dstblt->nWidth, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 4, &multi_dstblt->nHeight, FALSE) ||
-	    !read_order_field_byte(orderName, orderInfo, s, 5, &multi_dstblt->bRop, TRUE) ||
+	if (!read_primary_order_fields(s, orderInfo, multi_dstblt_fields,
+	                               ARRAYSIZE(multi_dstblt_fields), multi_dstblt) ||
 	    !read_order_field_byte(orderName, orderInfo, s, 6, &numRectangles, TRUE))
 		return FALSE;
 
@@ -1483,17 +1590,22 @@ static BOOL update_read_multi_dstblt_order(const char* orderName, wStream* s,
 	return TRUE;
 }
 
+static const PRIMARY_ORDER_FIELD multi_patblt_fields[] = {
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MULTI_PATBLT_ORDER, nLeftRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MULTI_PATBLT_ORDER, nTopRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MULTI_PATBLT_ORDER, nWidth),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MULTI_PATBLT_ORDER, nHeight),
+	PRIMARY_FIELD(PRIMARY_FIELD_BYTE, MULTI_PATBLT_ORDER, bRop),
+	PRIMARY_FIELD(PRIMARY_FIELD_COLOR, MULTI_PATBLT_ORDER, backColor),
+	PRIMARY_FIELD(PRIMARY_FIELD_COLOR, MULTI_PATBLT_ORDER, foreColor)
+};
+
 static BOOL update_read_multi_patblt_order(const char* orderName, wStream* s,
                                            const ORDER_INFO* orderInfo,
                                            MULTI_PATBLT_ORDER* multi_patblt)
 {
-	if (!read_order_field_coord(orderName, orderInfo, s, 1, &multi_patblt->nLeftRect, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 2, &multi_patblt->nTopRect, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 3, &multi_patblt->nWidth, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 4, &multi_patblt->nHeight, FALSE) ||
-	    !read_order_field_byte(orderName, orderInfo, s, 5, &multi_patblt->bRop, TRUE) ||
-	    !read_order_field_color(orderName, orderInfo, s, 6, &multi_patblt->backColor, TRUE) ||
-	    !read_order_field_color(orderName, orderInfo, s, 7, &multi_patblt->foreColor, TRUE))
+	if (!read_primary_order_fields(s, orderInfo, multi_patblt_fields,
+	                               ARRAYSIZE(multi_patblt_fields), multi_patblt))
 		return FALSE;
 
 	if (!update_read_brush(s, &multi_patblt->brush, orderInfo->fieldFlags >> 7))
@@ -1526,6 +1638,16 @@ static BOOL update_read_multi_patblt_order(const char* orderName, wStream* s,
 	return TRUE;
 }
 
+static const PRIMARY_ORDER_FIELD multi_scrblt_fields[] = {
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MULTI_SCRBLT_ORDER, nLeftRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MULTI_SCRBLT_ORDER, nTopRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MULTI_SCRBLT_ORDER, nWidth),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MULTI_SCRBLT_ORDER, nHeight),
+	PRIMARY_FIELD(PRIMARY_FIELD_BYTE, MULTI_SCRBLT_ORDER, bRop),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MULTI_SCRBLT_ORDER, nXSrc),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MULTI_SCRBLT_ORDER, nYSrc)
+};
+
 static BOOL update_read_multi_scrblt_order(const char* orderName, wStream* s,
                                            const ORDER_INFO* orderInfo,
                                            MULTI_SCRBLT_ORDER* multi_scrblt)
@@ -1534,13 +1656,8 @@ static BOOL update_read_multi_scrblt_order(const char* orderName, wStream* s,
 	WINPR_ASSERT(multi_scrblt);
 
 	UINT32 numRectangles = multi_scrblt->numRectangles;
-	if (!read_order_field_coord(orderName, orderInfo, s, 1, &multi_scrblt->nLeftRect, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 2, &multi_scrblt->nTopRect, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 3, &multi_scrblt->nWidth, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 4, &multi_scrblt->nHeight, FALSE) ||
-	    !read_order_field_byte(orderName, orderInfo, s, 5, &multi_scrblt->bRop, TRUE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 6, &multi_scrblt->nXSrc, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 7, &multi_scrblt->nYSrc, FALSE) ||
+	if (!read_primary_order_fields(s, orderInfo, multi_scrblt_fields,
+	                               ARRAYSIZE(multi_scrblt_fields), multi_scrblt) ||
 	    !read_order_field_byte(orderName, orderInfo, s, 8, &numRectangles, TRUE))
 		return FALSE;
 
@@ -1565,44 +1682,24 @@ static BOOL update_read_multi_scrblt_order(const char* orderName, wStream* s,
 	return TRUE;
 }
 
+static const PRIMARY_ORDER_FIELD multi_opaque_rect_fields[] = {
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MULTI_OPAQUE_RECT_ORDER, nLeftRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MULTI_OPAQUE_RECT_ORDER, nTopRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MULTI_OPAQUE_RECT_ORDER, nWidth),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MULTI_OPAQUE_RECT_ORDER, nHeight),
+	PRIMARY_FIELD(PRIMARY_FIELD_COLOR_BYTE0, MULTI_OPAQUE_RECT_ORDER, color),
+	PRIMARY_FIELD(PRIMARY_FIELD_COLOR_BYTE1, MULTI_OPAQUE_RECT_ORDER, color),
+	PRIMARY_FIELD(PRIMARY_FIELD_COLOR_BYTE2, MULTI_OPAQUE_RECT_ORDER, color)
+};
+
 static BOOL update_read_multi_opaque_rect_order(const char* orderName, wStream* s,
                                                 const ORDER_INFO* orderInfo,
                                                 MULTI_OPAQUE_RECT_ORDER* multi_opaque_rect)
 {
-	BYTE byte = 0;
-	if (!read_order_field_coord(orderName, orderInfo, s, 1, &multi_opaque_rect->nLeftRect, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 2, &multi_opaque_rect->nTopRect, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 3, &multi_opaque_rect->nWidth, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 4, &multi_opaque_rect->nHeight, FALSE))
+	if (!read_primary_order_fields(s, orderInfo, multi_opaque_rect_fields,
+	                               ARRAYSIZE(multi_opaque_rect_fields), multi_opaque_rect))
 		return FALSE;
 
-	if ((orderInfo->fieldFlags & ORDER_FIELD_05) != 0)
-	{
-		if (!Stream_CheckAndLogRequiredLength(TAG, s, 1))
-			return FALSE;
-
-		Stream_Read_UINT8(s, byte);
-		multi_opaque_rect->color = (multi_opaque_rect->color & 0x00FFFF00) | ((UINT32)byte);
-	}
-
-	if ((orderInfo->fieldFlags & ORDER_FIELD_06) != 0)
-	{
-		if (!Stream_CheckAndLogRequiredLength(TAG, s, 1))
-			return FALSE;
-
-		Stream_Read_UINT8(s, byte);
-		multi_opaque_rect->color = (multi_opaque_rect->color & 0x00FF00FF) | ((UINT32)byte << 8);
-	}
-
-	if ((orderInfo->fieldFlags & ORDER_FIELD_07) != 0)
-	{
-		if (!Stream_CheckAndLogRequiredLength(TAG, s, 1))
-			return FALSE;
-
-		Stream_Read_UINT8(s, byte);
-		multi_opaque_rect->color = (multi_opaque_rect->color & 0x0000FFFF) | ((UINT32)byte << 16);
-	}
-
 	UINT32 numRectangles = multi_opaque_rect->numRectangles;
 	if (!read_order_field_byte(orderName, orderInfo, s, 8, &numRectangles, TRUE))
 		return FALSE;
@@ -1628,20 +1725,21 @@ static BOOL update_read_multi_opaque_rect_order(const char* orderName, wStream*
 	return TRUE;
 }
 
+static const PRIMARY_ORDER_FIELD multi_draw_nine_grid_fields[] = {
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MULTI_DRAW_NINE_GRID_ORDER, srcLeft),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MULTI_DRAW_NINE_GRID_ORDER, srcTop),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MULTI_DRAW_NINE_GRID_ORDER, srcRight),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MULTI_DRAW_NINE_GRID_ORDER, srcBottom),
+	PRIMARY_FIELD(PRIMARY_FIELD_UINT16, MULTI_DRAW_NINE_GRID_ORDER, bitmapId)
+};
+
 static BOOL update_read_multi_draw_nine_grid_order(const char* orderName, wStream* s,
                                                    const ORDER_INFO* orderInfo,
                                                    MULTI_DRAW_NINE_GRID_ORDER* multi_draw_nine_grid)
 {
 	UINT32 nDeltaEntries = multi_draw_nine_grid->nDeltaEntries;
-	if (!read_order_field_coord(orderName, orderInfo, s, 1, &multi_draw_nine_grid->srcLeft,
-	                            FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 2, &multi_draw_nine_grid->srcTop, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 3, &multi_draw_nine_grid->srcRight,
-	                            FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 4, &multi_draw_nine_grid->srcBottom,
-	                            FALSE) ||
-	    !read_order_field_uint16(orderName, orderInfo, s, 5, &multi_draw_nine_grid->bitmapId,
-	                             TRUE) ||
+	if (!read_primary_order_fields(s, orderInfo, multi_draw_nine_grid_fields,
+	                               ARRAYSIZE(multi_draw_nine_grid_fields), multi_draw_nine_grid) ||
 	    !read_order_field_byte(orderName, orderInfo, s, 6, &nDeltaEntries, TRUE))
 		return FALSE;
 
@@ -1666,21 +1764,25 @@ static BOOL update_read_multi_draw_nine_grid_order(const char* orderName, wStrea
 
 	return TRUE;
 }
+
+static const PRIMARY_ORDER_FIELD line_to_fields[] = {
+	PRIMARY_FIELD(PRIMARY_FIELD_UINT16, LINE_TO_ORDER, backMode),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, LINE_TO_ORDER, nXStart),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, LINE_TO_ORDER, nYStart),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, LINE_TO_ORDER, nXEnd),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, LINE_TO_ORDER, nYEnd),
+	PRIMARY_FIELD(PRIMARY_FIELD_COLOR, LINE_TO_ORDER, backColor),
+	PRIMARY_FIELD(PRIMARY_FIELD_BYTE, LINE_TO_ORDER, bRop2),
+	PRIMARY_FIELD(PRIMARY_FIELD_BYTE, LINE_TO_ORDER, penStyle),
+	PRIMARY_FIELD(PRIMARY_FIELD_BYTE, LINE_TO_ORDER, penWidth),
+	PRIMARY_FIELD(PRIMARY_FIELD_COLOR, LINE_TO_ORDER, penColor)
+};
+
 static BOOL update_read_line_to_order(const char* orderName, wStream* s,
                                       const ORDER_INFO* orderInfo, LINE_TO_ORDER* line_to)
 {
-	if (read_order_field_uint16(orderName, orderInfo, s, 1, &line_to->backMode, TRUE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 2, &line_to->nXStart, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 3, &line_to->nYStart, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 4, &line_to->nXEnd, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 5, &line_to->nYEnd, FALSE) &&
-	    read_order_field_color(orderName, orderInfo, s, 6, &line_to->backColor, TRUE) &&
-	    read_order_field_byte(orderName, orderInfo, s, 7, &line_to->bRop2, TRUE) &&
-	    read_order_field_byte(orderName, orderInfo, s, 8, &line_to->penStyle, TRUE) &&
-	    read_order_field_byte(orderName, orderInfo, s, 9, &line_to->penWidth, TRUE) &&
-	    read_order_field_color(orderName, orderInfo, s, 10, &line_to->penColor, TRUE))
-		return TRUE;
-	return FALSE;
+	return read_primary_order_fields(s, orderInfo, line_to_fields,
+	                                 ARRAYSIZE(line_to_fields), line_to);
 }
 
 size_t update_approximate_line_to_order(ORDER_INFO* orderInfo, const LINE_TO_ORDER* line_to)
@@ -1719,14 +1821,19 @@ BOOL update_write_line_to_order(wStream* s, ORDER_INFO* orderInfo, const LINE_TO
 	return TRUE;
 }
 
+static const PRIMARY_ORDER_FIELD polyline_fields[] = {
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, POLYLINE_ORDER, xStart),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, POLYLINE_ORDER, yStart),
+	PRIMARY_FIELD(PRIMARY_FIELD_BYTE, POLYLINE_ORDER, bRop2)
+};
+
 static BOOL update_read_polyline_order(const char* orderName, wStream* s,
                                        const ORDER_INFO* orderInfo, POLYLINE_ORDER* polyline)
 {
 	UINT32 word = 0;
 	UINT32 new_num = polyline->numDeltaEntries;
-	if (!read_order_field_coord(orderName, orderInfo, s, 1, &polyline->xStart, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 2, &polyline->yStart, FALSE) ||
-	    !read_order_field_byte(orderName, orderInfo, s, 3, &polyline->bRop2, TRUE) ||
+	if (!read_primary_order_fields(s, orderInfo, polyline_fields,
+	                               ARRAYSIZE(polyline_fields), polyline) ||
 	    !read_order_field_uint16(orderName, orderInfo, s, 4, &word, TRUE) ||
 	    !read_order_field_color(orderName, orderInfo, s, 5, &polyline->penColor, TRUE) ||
 	    !read_order_field_byte(orderName, orderInfo, s, 6, &new_num, TRUE))
@@ -1757,21 +1864,25 @@ static BOOL update_read_polyline_order(const char* orderName, wStream* s,
 	return TRUE;
 }
 
+static const PRIMARY_ORDER_FIELD memblt_fields[] = {
+	PRIMARY_FIELD(PRIMARY_FIELD_UINT16, MEMBLT_ORDER, cacheId),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MEMBLT_ORDER, nLeftRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MEMBLT_ORDER, nTopRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MEMBLT_ORDER, nWidth),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MEMBLT_ORDER, nHeight),
+	PRIMARY_FIELD(PRIMARY_FIELD_BYTE, MEMBLT_ORDER, bRop),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MEMBLT_ORDER, nXSrc),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MEMBLT_ORDER, nYSrc),
+	PRIMARY_FIELD(PRIMARY_FIELD_UINT16, MEMBLT_ORDER, cacheIndex)
+};
+
 static BOOL update_read_memblt_order(const char* orderName, wStream* s, const ORDER_INFO* orderInfo,
                                      MEMBLT_ORDER* memblt)
 {
 	if (!s || !orderInfo || !memblt)
 		return FALSE;
 
-	if (!read_order_field_uint16(orderName, orderInfo, s, 1, &memblt->cacheId, TRUE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 2, &memblt->nLeftRect, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 3, &memblt->nTopRect, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 4, &memblt->nWidth, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 5, &memblt->nHeight, FALSE) ||
-	    !read_order_field_byte(orderName, orderInfo, s, 6, &memblt->bRop, TRUE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 7, &memblt->nXSrc, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 8, &memblt->nYSrc, FALSE) ||
-	    !read_order_field_uint16(orderName, orderInfo, s, 9, &memblt->cacheIndex, TRUE))
+	if (!read_primary_order_fields(s, orderInfo, memblt_fields, ARRAYSIZE(memblt_fields), memblt))
 		return FALSE;
 	memblt->colorIndex = (memblt->cacheId >> 8);
 	memblt->cacheId = (memblt->cacheId & 0xFF);
@@ -1814,19 +1925,25 @@ BOOL update_write_memblt_order(wStream* s, ORDER_INFO* orderInfo, const MEMBLT_O
 	Stream_Write_UINT16(s, memblt->cacheIndex);
 	return TRUE;
 }
+
+static const PRIMARY_ORDER_FIELD mem3blt_fields[] = {
+	PRIMARY_FIELD(PRIMARY_FIELD_UINT16, MEM3BLT_ORDER, cacheId),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MEM3BLT_ORDER, nLeftRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MEM3BLT_ORDER, nTopRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MEM3BLT_ORDER, nWidth),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MEM3BLT_ORDER, nHeight),
+	PRIMARY_FIELD(PRIMARY_FIELD_BYTE, MEM3BLT_ORDER, bRop),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MEM3BLT_ORDER, nXSrc),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, MEM3BLT_ORDER, nYSrc),
+	PRIMARY_FIELD(PRIMARY_FIELD_COLOR, MEM3BLT_ORDER, backColor),
+	PRIMARY_FIELD(PRIMARY_FIELD_COLOR, MEM3BLT_ORDER, foreColor)
+};
+
 static BOOL update_read_mem3blt_order(const char* orderName, wStream* s,
                                       const ORDER_INFO* orderInfo, MEM3BLT_ORDER* mem3blt)
 {
-	if (!read_order_field_uint16(orderName, orderInfo, s, 1, &mem3blt->cacheId, TRUE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 2, &mem3blt->nLeftRect, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 3, &mem3blt->nTopRect, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 4, &mem3blt->nWidth, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 5, &mem3blt->nHeight, FALSE) ||
-	    !read_order_field_byte(orderName, orderInfo, s, 6, &mem3blt->bRop, TRUE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 7, &mem3blt->nXSrc, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 8, &mem3blt->nYSrc, FALSE) ||
-	    !read_order_field_color(orderName, orderInfo, s, 9, &mem3blt->backColor, TRUE) ||
-	    !read_order_field_color(orderName, orderInfo, s, 10, &mem3blt->foreColor, TRUE))
+	if (!read_primary_order_fields(s, orderInfo, mem3blt_fields,
+	                               ARRAYSIZE(mem3blt_fields), mem3blt))
 		return FALSE;
 
 	if (!update_read_brush(s, &mem3blt->brush, orderInfo->fieldFlags >> 10) ||
@@ -1837,38 +1954,47 @@ static BOOL update_read_mem3blt_order(const char* orderName, wStream* s,
 	mem3blt->bitmap = NULL;
 	return TRUE;
 }
+
+static const PRIMARY_ORDER_FIELD save_bitmap_fields[] = {
+	PRIMARY_FIELD(PRIMARY_FIELD_UINT32, SAVE_BITMAP_ORDER, savedBitmapPosition),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, SAVE_BITMAP_ORDER, nLeftRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, SAVE_BITMAP_ORDER, nTopRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, SAVE_BITMAP_ORDER, nRightRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, SAVE_BITMAP_ORDER, nBottomRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_BYTE, SAVE_BITMAP_ORDER, operation)
+};
+
 static BOOL update_read_save_bitmap_order(const char* orderName, wStream* s,
                                           const ORDER_INFO* orderInfo,
                                           SAVE_BITMAP_ORDER* save_bitmap)
 {
-	if (read_order_field_uint32(orderName, orderInfo, s, 1, &save_bitmap->savedBitmapPosition,
-	                            TRUE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 2, &save_bitmap->nLeftRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 3, &save_bitmap->nTopRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 4, &save_bitmap->nRightRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 5, &save_bitmap->nBottomRect, FALSE) &&
-	    read_order_field_byte(orderName, orderInfo, s, 6, &save_bitmap->operation, TRUE))
-		return TRUE;
-	return FALSE;
+	return read_primary_order_fields(s, orderInfo, save_bitmap_fields,
+	                                 ARRAYSIZE(save_bitmap_fields), save_bitmap);
 }
+
+static const PRIMARY_ORDER_FIELD glyph_index_fields[] = {
+	PRIMARY_FIELD(PRIMARY_FIELD_BYTE, GLYPH_INDEX_ORDER, cacheId),
+	PRIMARY_FIELD(PRIMARY_FIELD_BYTE, GLYPH_INDEX_ORDER, flAccel),
+	PRIMARY_FIELD(PRIMARY_FIELD_BYTE, GLYPH_INDEX_ORDER, ulCharInc),
+	PRIMARY_FIELD(PRIMARY_FIELD_BYTE, GLYPH_INDEX_ORDER, fOpRedundant),
+	PRIMARY_FIELD(PRIMARY_FIELD_COLOR, GLYPH_INDEX_ORDER, backColor),
+	PRIMARY_FIELD(PRIMARY_FIELD_COLOR, GLYPH_INDEX_ORDER, foreColor),
+	PRIMARY_FIELD(PRIMARY_FIELD_INT16, GLYPH_INDEX_ORDER, bkLeft),
+	PRIMARY_FIELD(PRIMARY_FIELD_INT16, GLYPH_INDEX_ORDER, bkTop),
+	PRIMARY_FIELD(PRIMARY_FIELD_INT16, GLYPH_INDEX_ORDER, bkRight),
+	PRIMARY_FIELD(PRIMARY_FIELD_INT16, GLYPH_INDEX_ORDER, bkBottom),
+	PRIMARY_FIELD(PRIMARY_FIELD_INT16, GLYPH_INDEX_ORDER, opLeft),
+	PRIMARY_FIELD(PRIMARY_FIELD_INT16, GLYPH_INDEX_ORDER, opTop),
+	PRIMARY_FIELD(PRIMARY_FIELD_INT16, GLYPH_INDEX_ORDER, opRight),
+	PRIMARY_FIELD(PRIMARY_FIELD_INT16, GLYPH_INDEX_ORDER, opBottom)
+};
+
 static BOOL update_read_glyph_index_order(const char* orderName, wStream* s,
                                           const ORDER_INFO* orderInfo,
                                           GLYPH_INDEX_ORDER* glyph_index)
 {
-	if (!read_order_field_byte(orderName, orderInfo, s, 1, &glyph_index->cacheId, TRUE) ||
-	    !read_order_field_byte(orderName, orderInfo, s, 2, &glyph_index->flAccel, TRUE) ||
-	    !read_order_field_byte(orderName, orderInfo, s, 3, &glyph_index->ulCharInc, TRUE) ||
-	    !read_order_field_byte(orderName, orderInfo, s, 4, &glyph_index->fOpRedundant, TRUE) ||
-	    !read_order_field_color(orderName, orderInfo, s, 5, &glyph_index->backColor, TRUE) ||
-	    !read_order_field_color(orderName, orderInfo, s, 6, &glyph_index->foreColor, TRUE) ||
-	    !read_order_field_int16(orderName, orderInfo, s, 7, &glyph_index->bkLeft, TRUE) ||
-	    !read_order_field_int16(orderName, orderInfo, s, 8, &glyph_index->bkTop, TRUE) ||
-	    !read_order_field_int16(orderName, orderInfo, s, 9, &glyph_index->bkRight, TRUE) ||
-	    !read_order_field_int16(orderName, orderInfo, s, 10, &glyph_index->bkBottom, TRUE) ||
-	    !read_order_field_int16(orderName, orderInfo, s, 11, &glyph_index->opLeft, TRUE) ||
-	    !read_order_field_int16(orderName, orderInfo, s, 12, &glyph_index->opTop, TRUE) ||
-	    !read_order_field_int16(orderName, orderInfo, s, 13, &glyph_index->opRight, TRUE) ||
-	    !read_order_field_int16(orderName, orderInfo, s, 14, &glyph_index->opBottom, TRUE) ||
+	if (!read_primary_order_fields(s, orderInfo, glyph_index_fields,
+	                               ARRAYSIZE(glyph_index_fields), glyph_index) ||
 	    !update_read_brush(s, &glyph_index->brush, orderInfo->fieldFlags >> 14) ||
 	    !read_order_field_int16(orderName, orderInfo, s, 20, &glyph_index->x, TRUE) ||
 	    !read_order_field_int16(orderName, orderInfo, s, 21, &glyph_index->y, TRUE))
@@ -1951,24 +2077,29 @@ BOOL update_write_glyph_index_order(wStream* s, ORDER_INFO* orderInfo,
 	Stream_Write(s, glyph_index->data, glyph_index->cbData);
 	return TRUE;
 }
+
+static const PRIMARY_ORDER_FIELD fast_index_fields[] = {
+	PRIMARY_FIELD(PRIMARY_FIELD_BYTE, FAST_INDEX_ORDER, cacheId),
+	PRIMARY_FIELD_PAIR(FAST_INDEX_ORDER, ulCharInc, flAccel),
+	PRIMARY_FIELD(PRIMARY_FIELD_COLOR, FAST_INDEX_ORDER, backColor),
+	PRIMARY_FIELD(PRIMARY_FIELD_COLOR, FAST_INDEX_ORDER, foreColor),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, FAST_INDEX_ORDER, bkLeft),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, FAST_INDEX_ORDER, bkTop),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, FAST_INDEX_ORDER, bkRight),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, FAST_INDEX_ORDER, bkBottom),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, FAST_INDEX_ORDER, opLeft),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, FAST_INDEX_ORDER, opTop),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, FAST_INDEX_ORDER, opRight),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, FAST_INDEX_ORDER, opBottom),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, FAST_INDEX_ORDER, x),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, FAST_INDEX_ORDER, y)
+};
+
 static BOOL update_read_fast_index_order(const char* orderName, wStream* s,
                                          const ORDER_INFO* orderInfo, FAST_INDEX_ORDER* fast_index)
 {
-	if (!read_order_field_byte(orderName, orderInfo, s, 1, &fast_index->cacheId, TRUE) ||
-	    !read_order_field_2bytes(orderName, orderInfo, s, 2, &fast_index->ulCharInc,
-	                             &fast_index->flAccel, TRUE) ||
-	    !read_order_field_color(orderName, orderInfo, s, 3, &fast_index->backColor, TRUE) ||
-	    !read_order_field_color(orderName, orderInfo, s, 4, &fast_index->foreColor, TRUE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 5, &fast_index->bkLeft, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 6, &fast_index->bkTop, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 7, &fast_index->bkRight, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 8, &fast_index->bkBottom, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 9, &fast_index->opLeft, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 10, &fast_index->opTop, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 11, &fast_index->opRight, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 12, &fast_index->opBottom, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 13, &fast_index->x, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 14, &fast_index->y, FALSE))
+	if (!read_primary_order_fields(s, orderInfo, fast_index_fields,
+	                               ARRAYSIZE(fast_index_fields), fast_index))
 		return FALSE;
 
 	if ((orderInfo->fieldFlags & ORDER_FIELD_15) != 0)
@@ -1987,29 +2118,33 @@ static BOOL update_read_fast_index_order(const char* orderName, wStream* s,
 
 	return TRUE;
 }
+
+static const PRIMARY_ORDER_FIELD fast_glyph_fields[] = {
+	PRIMARY_FIELD(PRIMARY_FIELD_BYTE, FAST_GLYPH_ORDER, cacheId),
+	PRIMARY_FIELD_PAIR(FAST_GLYPH_ORDER, ulCharInc, flAccel),
+	PRIMARY_FIELD(PRIMARY_FIELD_COLOR, FAST_GLYPH_ORDER, backColor),
+	PRIMARY_FIELD(PRIMARY_FIELD_COLOR, FAST_GLYPH_ORDER, foreColor),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, FAST_GLYPH_ORDER, bkLeft),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, FAST_GLYPH_ORDER, bkTop),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, FAST_GLYPH_ORDER, bkRight),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, FAST_GLYPH_ORDER, bkBottom),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, FAST_GLYPH_ORDER, opLeft),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, FAST_GLYPH_ORDER, opTop),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, FAST_GLYPH_ORDER, opRight),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, FAST_GLYPH_ORDER, opBottom),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, FAST_GLYPH_ORDER, x),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, FAST_GLYPH_ORDER, y)
+};
+
 static BOOL update_read_fast_glyph_order(const char* orderName, wStream* s,
                                          const ORDER_INFO* orderInfo, FAST_GLYPH_ORDER* fastGlyph)
 {
 	GLYPH_DATA_V2* glyph = &fastGlyph->glyphData;
-	if (!read_order_field_byte(orderName, orderInfo, s, 1, &fastGlyph->cacheId, TRUE))
+	if (!read_primary_order_fields(s, orderInfo, fast_glyph_fields, ARRAYSIZE(fast_glyph_fields),
+	                               fastGlyph))
 		return FALSE;
 	if (fastGlyph->cacheId > 9)
 		return FALSE;
-	if (!read_order_field_2bytes(orderName, orderInfo, s, 2, &fastGlyph->ulCharInc,
-	                             &fastGlyph->flAccel, TRUE) ||
-	    !read_order_field_color(orderName, orderInfo, s, 3, &fastGlyph->backColor, TRUE) ||
-	    !read_order_field_color(orderName, orderInfo, s, 4, &fastGlyph->foreColor, TRUE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 5, &fastGlyph->bkLeft, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 6, &fastGlyph->bkTop, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 7, &fastGlyph->bkRight, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 8, &fastGlyph->bkBottom, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 9, &fastGlyph->opLeft, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 10, &fastGlyph->opTop, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 11, &fastGlyph->opRight, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 12, &fastGlyph->opBottom, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 13, &fastGlyph->x, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 14, &fastGlyph->y, FALSE))
-		return FALSE;
 
 	if ((orderInfo->fieldFlags & ORDER_FIELD_15) != 0)
 	{
@@ -2066,15 +2201,21 @@ static BOOL update_read_fast_glyph_order(const char* orderName, wStream* s,
 
 	return TRUE;
 }
+
+static const PRIMARY_ORDER_FIELD polygon_sc_fields[] = {
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, POLYGON_SC_ORDER, xStart),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, POLYGON_SC_ORDER, yStart),
+	PRIMARY_FIELD(PRIMARY_FIELD_BYTE, POLYGON_SC_ORDER, bRop2),
+	PRIMARY_FIELD(PRIMARY_FIELD_BYTE, POLYGON_SC_ORDER, fillMode),
+	PRIMARY_FIELD(PRIMARY_FIELD_COLOR, POLYGON_SC_ORDER, brushColor)
+};
+
 static BOOL update_read_polygon_sc_order(const char* orderName, wStream* s,
                                          const ORDER_INFO* orderInfo, POLYGON_SC_ORDER* polygon_sc)
 {
 	UINT32 num = polygon_sc->numPoints;
-	if (!read_order_field_coord(orderName, orderInfo, s, 1, &polygon_sc->xStart, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 2, &polygon_sc->yStart, FALSE) ||
-	    !read_order_field_byte(orderName, orderInfo, s, 3, &polygon_sc->bRop2, TRUE) ||
-	    !read_order_field_byte(orderName, orderInfo, s, 4, &polygon_sc->fillMode, TRUE) ||
-	    !read_order_field_color(orderName, orderInfo, s, 5, &polygon_sc->brushColor, TRUE) ||
+	if (!read_primary_order_fields(s, orderInfo, polygon_sc_fields,
+	                               ARRAYSIZE(polygon_sc_fields), polygon_sc) ||
 	    !read_order_field_byte(orderName, orderInfo, s, 6, &num, TRUE))
 		return FALSE;
 
@@ -2101,16 +2242,22 @@ static BOOL update_read_polygon_sc_order(const char* orderName, wStream* s,
 
 	return TRUE;
 }
+
+static const PRIMARY_ORDER_FIELD polygon_cb_fields[] = {
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, POLYGON_CB_ORDER, xStart),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, POLYGON_CB_ORDER, yStart),
+	PRIMARY_FIELD(PRIMARY_FIELD_BYTE, POLYGON_CB_ORDER, bRop2),
+	PRIMARY_FIELD(PRIMARY_FIELD_BYTE, POLYGON_CB_ORDER, fillMode),
+	PRIMARY_FIELD(PRIMARY_FIELD_COLOR, POLYGON_CB_ORDER, backColor),
+	PRIMARY_FIELD(PRIMARY_FIELD_COLOR, POLYGON_CB_ORDER, foreColor)
+};
+
 static BOOL update_read_polygon_cb_order(const char* orderName, wStream* s,
                                          const ORDER_INFO* orderInfo, POLYGON_CB_ORDER* polygon_cb)
 {
 	UINT32 num = polygon_cb->numPoints;
-	if (!read_order_field_coord(orderName, orderInfo, s, 1, &polygon_cb->xStart, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 2, &polygon_cb->yStart, FALSE) ||
-	    !read_order_field_byte(orderName, orderInfo, s, 3, &polygon_cb->bRop2, TRUE) ||
-	    !read_order_field_byte(orderName, orderInfo, s, 4, &polygon_cb->fillMode, TRUE) ||
-	    !read_order_field_color(orderName, orderInfo, s, 5, &polygon_cb->backColor, TRUE) ||
-	    !read_order_field_color(orderName, orderInfo, s, 6, &polygon_cb->foreColor, TRUE))
+	if (!read_primary_order_fields(s, orderInfo, polygon_cb_fields,
+	                               ARRAYSIZE(polygon_cb_fields), polygon_cb))
 		return FALSE;
 
 	if (!update_read_brush(s, &polygon_cb->brush, orderInfo->fieldFlags >> 6))
@@ -2146,33 +2293,41 @@ static BOOL update_read_polygon_cb_order(const char* orderName, wStream* s,
 	polygon_cb->bRop2 = (polygon_cb->bRop2 & 0x1F);
 	return TRUE;
 }
+
+static const PRIMARY_ORDER_FIELD ellipse_sc_fields[] = {
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, ELLIPSE_SC_ORDER, leftRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, ELLIPSE_SC_ORDER, topRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, ELLIPSE_SC_ORDER, rightRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, ELLIPSE_SC_ORDER, bottomRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_BYTE, ELLIPSE_SC_ORDER, bRop2),
+	PRIMARY_FIELD(PRIMARY_FIELD_BYTE, ELLIPSE_SC_ORDER, fillMode),
+	PRIMARY_FIELD(PRIMARY_FIELD_COLOR, ELLIPSE_SC_ORDER, color)
+};
+
 static BOOL update_read_ellipse_sc_order(const char* orderName, wStream* s,
                                          const ORDER_INFO* orderInfo, ELLIPSE_SC_ORDER* ellipse_sc)
 {
-	if (read_order_field_coord(orderName, orderInfo, s, 1, &ellipse_sc->leftRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 2, &ellipse_sc->topRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 3, &ellipse_sc->rightRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 4, &ellipse_sc->bottomRect, FALSE) &&
-	    read_order_field_byte(orderName, orderInfo, s, 5, &ellipse_sc->bRop2, TRUE) &&
-	    read_order_field_byte(orderName, orderInfo, s, 6, &ellipse_sc->fillMode, TRUE) &&
-	    read_order_field_color(orderName, orderInfo, s, 7, &ellipse_sc->color, TRUE))
-		return TRUE;
-	return FALSE;
+	return read_primary_order_fields(s, orderInfo, ellipse_sc_fields,
+	                                 ARRAYSIZE(ellipse_sc_fields), ellipse_sc);
 }
+
+static const PRIMARY_ORDER_FIELD ellipse_cb_fields[] = {
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, ELLIPSE_CB_ORDER, leftRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, ELLIPSE_CB_ORDER, topRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, ELLIPSE_CB_ORDER, rightRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_COORD, ELLIPSE_CB_ORDER, bottomRect),
+	PRIMARY_FIELD(PRIMARY_FIELD_BYTE, ELLIPSE_CB_ORDER, bRop2),
+	PRIMARY_FIELD(PRIMARY_FIELD_BYTE, ELLIPSE_CB_ORDER, fillMode),
+	PRIMARY_FIELD(PRIMARY_FIELD_COLOR, ELLIPSE_CB_ORDER, backColor),
+	PRIMARY_FIELD(PRIMARY_FIELD_COLOR, ELLIPSE_CB_ORDER, foreColor)
+};
+
 static BOOL update_read_ellipse_cb_order(const char* orderName, wStream* s,
                                          const ORDER_INFO* orderInfo, ELLIPSE_CB_ORDER* ellipse_cb)
 {
-	if (read_order_field_coord(orderName, orderInfo, s, 1, &ellipse_cb->leftRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 2, &ellipse_cb->topRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 3, &ellipse_cb->rightRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 4, &ellipse_cb->bottomRect, FALSE) &&
-	    read_order_field_byte(orderName, orderInfo, s, 5, &ellipse_cb->bRop2, TRUE) &&
-	    read_order_field_byte(orderName, orderInfo, s, 6, &ellipse_cb->fillMode, TRUE) &&
-	    read_order_field_color(orderName, orderInfo, s, 7, &ellipse_cb->backColor, TRUE) &&
-	    read_order_field_color(orderName, orderInfo, s, 8, &ellipse_cb->foreColor, TRUE) &&
-	    update_read_brush(s, &ellipse_cb->brush, orderInfo->fieldFlags >> 8))
-		return TRUE;
-	return FALSE;
+	return read_primary_order_fields(s, orderInfo, ellipse_cb_fields,
+	                                 ARRAYSIZE(ellipse_cb_fields), ellipse_cb) &&
+	       update_read_brush(s, &ellipse_cb->brush, orderInfo->fieldFlags >> 8);
 }
 
 /* Secondary Drawing Orders */
@@ -3631,6 +3786,70 @@ static BOOL read_primary_order(wLog* log, const char* orderName, wStream* s,
 	return TRUE;
 }
 
+static BOOL update_queue_opaque_rect(rdpUpdate* update, const OPAQUE_RECT_ORDER* opaque_rect)
+{
+	rdp_primary_update_internal* primary = primary_update_cast(update->primary);
+	MULTI_OPAQUE_RECT_ORDER* batch = &primary->opaque_rect_batch;
+
+	if ((batch->numRectangles > 0) && ((batch->color != opaque_rect->color) ||
+	                                   (batch->numRectangles >= ARRAYSIZE(batch->rectangles))))
+	{
+		if (!update_flush_orders(update))
+			return FALSE;
+	}
+
+	const INT32 right = opaque_rect->nLeftRect + opaque_rect->nWidth;
+	const INT32 bottom = opaque_rect->nTopRect + opaque_rect->nHeight;
+	if (batch->numRectangles == 0)
+	{
+		batch->color = opaque_rect->color;
+		batch->nLeftRect = opaque_rect->nLeftRect;
+		batch->nTopRect = opaque_rect->nTopRect;
+		batch->nWidth = opaque_rect->nWidth;
+		batch->nHeight = opaque_rect->nHeight;
+	}
+	else
+	{
+		const INT32 left = MIN(batch->nLeftRect, opaque_rect->nLeftRect);
+		const INT32 top = MIN(batch->nTopRect, opaque_rect->nTopRect);
+		batch->nWidth = MAX(batch->nLeftRect + batch->nWidth, right) - left;
+		batch->nHeight = MAX(batch->nTopRect + batch->nHeight, bottom) - top;
+		batch->nLeftRect = left;
+		batch->nTopRect = top;
+	}
+
+	DELTA_RECT* rect = &batch->rectangles[batch->numRectangles++];
+	rect->left = opaque_rect->nLeftRect;
+	rect->top = opaque_rect->nTopRect;
+	rect->width = opaque_rect->nWidth;
+	rect->height = opaque_rect->nHeight;
+	return TRUE;
+}
+
+/**
+ * Deliver the OpaqueRect orders queued by update_recv_primary_order as a single
+ * MultiOpaqueRect. Must be called before anything that depends on their output, at the
+ * latest at the end of each orders update.
+ */
+BOOL update_flush_orders(rdpUpdate* update)
+{
+	WINPR_ASSERT(update);
+	WINPR_ASSERT(update->context);
+
+	rdp_primary_update_internal* primary = primary_update_cast(update->primary);
+	MULTI_OPAQUE_RECT_ORDER* batch = &primary->opaque_rect_batch;
+
+	if (batch->numRectangles == 0)
+		return TRUE;
+
+	rdpContext* context = update->context;
+	const BOOL defaultReturn =
+	    freerdp_settings_get_bool(context->settings, FreeRDP_DeactivateClientDecoding);
+	const BOOL rc = IFCALLRESULT(defaultReturn, primary->common.MultiOpaqueRect, context, batch);
+	batch->numRectangles = 0;
+	return rc;
+}
+
 static BOOL update_recv_primary_order(rdpUpdate* update, wStream* s, BYTE flags)
 {
 	BYTE field = 0;
@@ -3680,6 +3899,10 @@ static BOOL update_recv_primary_order(rdpUpdate* update, wStream* s, BYTE flags)
 
 	if (flags & ORDER_BOUNDS)
 	{
+		/* queued rectangles were sent without bounds */
+		if (!update_flush_orders(update))
+			return FALSE;
+
 		if (!(flags & ORDER_ZERO_BOUNDS_DELTAS))
 		{
 			if (!update_read_bounds(s, &orderInfo->bounds))
@@ -3700,10 +3923,20 @@ static BOOL update_recv_primary_order(rdpUpdate* update, wStream* s, BYTE flags)
 	if (!read_primary_order(up->log, orderName, s, orderInfo, &primary->common))
 		return FALSE;
 
+	/* Runs of unbounded OpaqueRect orders are drawn with one MultiOpaqueRect call */
+	const BOOL batch = (orderInfo->orderType == ORDER_TYPE_OPAQUE_RECT) &&
+	                   ((flags & ORDER_BOUNDS) == 0) && primary->common.OpaqueRect &&
+	                   primary->common.MultiOpaqueRect;
+	if (!batch && !update_flush_orders(update))
+		return FALSE;
+
 	rc = IFCALLRESULT(TRUE, primary->common.OrderInfo, context, orderInfo, orderName);
 	if (!rc)
 		return FALSE;
 
+	if (batch)
+		return update_queue_opaque_rect(update, &primary->opaque_rect);
+
 	switch (orderInfo->orderType)
 	{
 		case ORDER_TYPE_DSTBLT:
@@ -4282,6 +4515,12 @@ static BOOL update_recv_altsec_order(rdpUpdate* update, wStream* s, BYTE flags)
 
 	return rc;
 }
+static void update_discard_orders(rdpUpdate* update)
+{
+	rdp_primary_update_internal* primary = primary_update_cast(update->primary);
+	primary->opaque_rect_batch.numRectangles = 0;
+}
+
 BOOL update_recv_order(rdpUpdate* update, wStream* s)
 {
 	BOOL rc = 0;
@@ -4294,14 +4533,18 @@ BOOL update_recv_order(rdpUpdate* update, wStream* s)
 	Stream_Read_UINT8(s, controlFlags); /* controlFlags (1 byte) */
 
 	if (!(controlFlags & ORDER_STANDARD))
-		rc = update_recv_altsec_order(update, s, controlFlags);
+		rc = update_flush_orders(update) && update_recv_altsec_order(update, s, controlFlags);
 	else if (controlFlags & ORDER_SECONDARY)
-		rc = update_recv_secondary_order(update, s, controlFlags);
+		rc = update_flush_orders(update) && update_recv_secondary_order(update, s, controlFlags);
 	else
 		rc = update_recv_primary_order(update, s, controlFlags);
 
 	if (!rc)
+	{
+		/* the update is broken, rectangles queued from it are not drawn */
+		update_discard_orders(update);
 		WLog_Print(up->log, WLOG_ERROR, "order flags %02" PRIx8 " failed", controlFlags);
+	}
 
 	return rc;
 }
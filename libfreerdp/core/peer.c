@@ -27,6 +27,7 @@
 #include <winpr/assert.h>
 #include <winpr/crt.h>
 #include <winpr/winsock.h>
+#include <winpr/sysinfo.h>
 
 #include "info.h"
 #include "display.h"
@@ -39,6 +40,7 @@
 #include "rdp.h"
 #include "peer.h"
 #include "multitransport.h"
+#include "metrics.h"
 
 #define TAG FREERDP_TAG("core.peer")
 
@@ -485,8 +487,14 @@ static state_run_t peer_recv_tpkt_pdu(freerdp_peer* client, wStream* s)
 		switch (pduType)
 		{
 			case PDU_TYPE_DATA:
+			{
+				const BYTE type = rdp_peek_share_data_type(s);
+				const UINT64 start = winpr_GetTickCount64NS();
 				rc = peer_recv_data_pdu(client, s, pduLength);
-				break;
+				metrics_pdu_time(client->context->metrics, FREERDP_METRICS_PDU_DATA, type,
+				                 winpr_GetTickCount64NS() - start);
+			}
+			break;
 
 			case PDU_TYPE_CONFIRM_ACTIVE:
 				if (!rdp_server_accept_confirm_active(rdp, s, pduLength))
@@ -1443,6 +1451,40 @@ const char* freerdp_peer_os_minor_type_string(freerdp_peer* client)
 	return os_minor_type_to_string(osMinorType);
 }
 
+BOOL freerdp_peer_set_tls_session_cache(freerdp_peer* client, rdpTlsSessionCache* cache)
+{
+	WINPR_ASSERT(client);
+
+	if (!client->context || !client->context->rdp)
+		return FALSE;
+
+	transport_set_tls_session_cache(client->context->rdp->transport, cache);
+	return TRUE;
+}
+
+BOOL freerdp_peer_get_persistent_keys(freerdp_peer* client, UINT32 id, const UINT64** keys,
+                                      UINT32* count)
+{
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(keys);
+	WINPR_ASSERT(count);
+
+	*keys = NULL;
+	*count = 0;
+
+	if (!client->context || !client->context->rdp)
+		return FALSE;
+
+	rdpRdp* rdp = client->context->rdp;
+
+	if (id >= ARRAYSIZE(rdp->persistentKeys))
+		return FALSE;
+
+	*keys = rdp->persistentKeys[id];
+	*count = rdp->persistentKeyCount[id];
+	return TRUE;
+}
+
 freerdp_peer* freerdp_peer_new(int sockfd)
 {
 	UINT32 option_value = 0;
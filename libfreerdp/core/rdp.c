@@ -26,6 +26,7 @@
 #include <winpr/string.h>
 #include <winpr/synch.h>
 #include <winpr/assert.h>
+#include <winpr/sysinfo.h>
 
 #include "rdp.h"
 
@@ -34,6 +35,7 @@
 #include "utils.h"
 #include "mcs.h"
 #include "redirection.h"
+#include "metrics.h"
 
 #include <freerdp/codec/bulk.h>
 #include <freerdp/crypto/per.h>
@@ -339,6 +341,18 @@ BOOL rdp_read_share_data_header(rdpRdp* rdp, wStream* s, UINT16* length, BYTE* t
 	return TRUE;
 }
 
+/* pduType2 of the share data header at the current position, 0 if the header is incomplete */
+BYTE rdp_peek_share_data_type(wStream* s)
+{
+	WINPR_ASSERT(s);
+
+	if (Stream_GetRemainingLength(s) < 12)
+		return 0;
+
+	const BYTE* header = Stream_ConstPointer(s);
+	return header[8];
+}
+
 BOOL rdp_write_share_data_header(rdpRdp* rdp, wStream* s, UINT16 length, BYTE type, UINT32 share_id)
 {
 	const size_t headerLen = RDP_PACKET_HEADER_MAX_LENGTH + RDP_SHARE_CONTROL_HEADER_LENGTH +
@@ -1063,7 +1077,7 @@ static BOOL rdp_recv_monitor_layout_pdu(rdpRdp* rdp, wStream* s)
 	return rdp_set_monitor_layout_pdu_state(rdp, TRUE);
 }
 
-state_run_t rdp_recv_data_pdu(rdpRdp* rdp, wStream* s)
+static state_run_t rdp_recv_data_pdu_int(rdpRdp* rdp, wStream* s)
 {
 	BYTE type = 0;
 	wStream* cs = NULL;
@@ -1289,6 +1303,19 @@ out_fail:
 	return STATE_RUN_FAILED;
 }
 
+state_run_t rdp_recv_data_pdu(rdpRdp* rdp, wStream* s)
+{
+	WINPR_ASSERT(rdp);
+	WINPR_ASSERT(rdp->context);
+
+	const BYTE type = rdp_peek_share_data_type(s);
+	const UINT64 start = winpr_GetTickCount64NS();
+	const state_run_t rc = rdp_recv_data_pdu_int(rdp, s);
+	metrics_pdu_time(rdp->context->metrics, FREERDP_METRICS_PDU_DATA, type,
+	                 winpr_GetTickCount64NS() - start);
+	return rc;
+}
+
 state_run_t rdp_recv_message_channel_pdu(rdpRdp* rdp, wStream* s, UINT16 securityFlags)
 {
 	WINPR_ASSERT(rdp);
@@ -2475,6 +2502,7 @@ void rdp_free(rdpRdp* rdp)
 	{
 		DeleteCriticalSection(&rdp->critical);
 		rdp_reset_free(rdp);
+		rdp_free_persistent_key_list(rdp);
 
 		freerdp_settings_free(rdp->settings);
 		freerdp_settings_free(rdp->originalSettings);
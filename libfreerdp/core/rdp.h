@@ -204,6 +204,11 @@ struct rdp_rdp
 	UINT32 deactivated_width;
 	UINT32 deactivated_height;
 
+	/* persistent bitmap cache keys offered by the client, key n was loaded into entry n */
+	UINT64* persistentKeys[5];
+	UINT32 persistentKeyCount[5];
+	UINT32 persistentKeyTotal[5];
+
 	wLog* log;
 	char log_context[64];
 };
@@ -218,6 +223,7 @@ FREERDP_LOCAL BOOL rdp_read_share_control_header(rdpRdp* rdp, wStream* s, UINT16
 FREERDP_LOCAL BOOL rdp_read_share_data_header(rdpRdp* rdp, wStream* s, UINT16* length, BYTE* type,
                                               UINT32* share_id, BYTE* compressed_type,
                                               UINT16* compressed_len);
+FREERDP_LOCAL BYTE rdp_peek_share_data_type(wStream* s);
 
 FREERDP_LOCAL wStream* rdp_send_stream_init(rdpRdp* rdp);
 FREERDP_LOCAL wStream* rdp_send_stream_pdu_init(rdpRdp* rdp);
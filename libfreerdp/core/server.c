@@ -51,6 +51,9 @@
 
 #define DVC_MAX_DATA_PDU_SIZE 1600
 
+/* Dynamic channel bytes written per WTSVirtualChannelManagerCheckFileDescriptor call */
+#define DVC_MAX_SEND_BUDGET (256 * 1024)
+
 typedef struct
 {
 	UINT16 channelId;
@@ -101,6 +104,43 @@ static BOOL wts_queue_send_item(rdpPeerChannel* channel, BYTE* Buffer, UINT32 Le
 	                         (void*)(UINT_PTR)length);
 }
 
+/* Map WTS_CHANNEL_OPTION_DYNAMIC_PRI_* to the priority class of [MS-RDPEDYC] 2.2.2.1 */
+static BYTE wts_get_dvc_priority(const rdpPeerChannel* channel)
+{
+	WINPR_ASSERT(channel);
+
+	switch (channel->channelFlags & WTS_CHANNEL_OPTION_DYNAMIC_PRI_REAL)
+	{
+		case WTS_CHANNEL_OPTION_DYNAMIC_PRI_REAL:
+			return 0;
+		case WTS_CHANNEL_OPTION_DYNAMIC_PRI_HIGH:
+			return 1;
+		case WTS_CHANNEL_OPTION_DYNAMIC_PRI_MED:
+			return 2;
+		case WTS_CHANNEL_OPTION_DYNAMIC_PRI_LOW:
+		default:
+			return 3;
+	}
+}
+
+static BOOL wts_queue_dvc_send_item(rdpPeerChannel* channel, wStream* s)
+{
+	WINPR_ASSERT(channel);
+	WTSVirtualChannelManager* vcm = channel->vcm;
+	WINPR_ASSERT(vcm);
+
+	if (!dvc_scheduler_enqueue(vcm->dvc_scheduler, channel->channelId,
+	                           wts_get_dvc_priority(channel), s))
+		return FALSE;
+
+	return SetEvent(MessageQueue_Event(vcm->queue));
+}
+
+static void wts_dvc_stream_free(wStream* s)
+{
+	Stream_Free(s, TRUE);
+}
+
 static int wts_read_variable_uint(wStream* s, int cbLen, UINT32* val)
 {
 	WINPR_ASSERT(s);
@@ -156,8 +196,10 @@ static BOOL wts_read_drdynvc_capabilities_response(rdpPeerChannel* channel, UINT
 	WTSVirtualChannelManager* vcm = channel->vcm;
 	vcm->drdynvc_state = DRDYNVC_STATE_READY;
 
-	/* we only support version 1 for now (no compression yet) */
-	vcm->dvc_spoken_version = MAX(Version, 1);
+	/* The capabilities request announced version 3, the response carries the version the
+	 * client speaks. Version 2 enables channel priorities, version 3 compressed data PDUs in
+	 * both directions (see wts_decompress_drdynvc_data). Nothing above what we announced. */
+	vcm->dvc_spoken_version = MIN(Version, 3);
 
 	return SetEvent(MessageQueue_Event(vcm->queue));
 }
@@ -195,8 +237,45 @@ static BOOL wts_read_drdynvc_create_response(rdpPeerChannel* channel, wStream* s
 	return status;
 }
 
+/* Replace the payload of a compressed PDU with its decompressed data */
+static wStream* wts_decompress_drdynvc_data(rdpPeerChannel* channel, wStream* s, UINT32* length)
+{
+	WINPR_ASSERT(channel);
+	WINPR_ASSERT(channel->vcm);
+	WINPR_ASSERT(length);
+
+	if (channel->vcm->dvc_spoken_version < 3)
+	{
+		WLog_ERR(TAG, "compressed data requires version 3");
+		return NULL;
+	}
+
+	if (!Stream_CheckAndLogRequiredLength(TAG, s, *length))
+		return NULL;
+
+	if (!channel->decompressor)
+	{
+		channel->decompressor = zgfx_context_new_lite(FALSE);
+		channel->decompressedData = Stream_New(NULL, DVC_MAX_DATA_PDU_SIZE);
+		if (!channel->decompressor || !channel->decompressedData)
+			return NULL;
+	}
+
+	Stream_SetPosition(channel->decompressedData, 0);
+	if (!zgfx_decompress_bulk(channel->decompressor, Stream_ConstPointer(s), *length,
+	                          channel->decompressedData))
+	{
+		WLog_ERR(TAG, "ChannelId %" PRIu32 " invalid compressed data", channel->channelId);
+		return NULL;
+	}
+
+	*length = (UINT32)Stream_GetPosition(channel->decompressedData);
+	Stream_SetPosition(channel->decompressedData, 0);
+	return channel->decompressedData;
+}
+
 static BOOL wts_read_drdynvc_data_first(rdpPeerChannel* channel, wStream* s, int cbLen,
-                                        UINT32 length)
+                                        UINT32 length, BOOL compressed)
 {
 	int value = 0;
 	WINPR_ASSERT(channel);
@@ -208,6 +287,13 @@ static BOOL wts_read_drdynvc_data_first(rdpPeerChannel* channel, wStream* s, int
 
 	length -= value;
 
+	if (compressed)
+	{
+		s = wts_decompress_drdynvc_data(channel, s, &length);
+		if (!s)
+			return FALSE;
+	}
+
 	if (length > channel->dvc_total_length)
 		return FALSE;
 
@@ -220,12 +306,20 @@ static BOOL wts_read_drdynvc_data_first(rdpPeerChannel* channel, wStream* s, int
 	return TRUE;
 }
 
-static BOOL wts_read_drdynvc_data(rdpPeerChannel* channel, wStream* s, UINT32 length)
+static BOOL wts_read_drdynvc_data(rdpPeerChannel* channel, wStream* s, UINT32 length,
+                                  BOOL compressed)
 {
 	BOOL ret = FALSE;
 
 	WINPR_ASSERT(channel);
 	WINPR_ASSERT(s);
+
+	if (compressed)
+	{
+		s = wts_decompress_drdynvc_data(channel, s, &length);
+		if (!s)
+			return FALSE;
+	}
 	if (channel->dvc_total_length > 0)
 	{
 		if (Stream_GetPosition(channel->receiveData) + length > channel->dvc_total_length)
@@ -328,38 +422,37 @@ static BOOL wts_read_drdynvc_pdu(rdpPeerChannel* channel)
 				return wts_read_drdynvc_create_response(dvc, channel->receiveData, length);
 
 			case DATA_FIRST_PDU:
+			case DATA_FIRST_COMPRESSED_PDU:
 				if (dvc->dvc_open_state != DVC_OPEN_STATE_SUCCEEDED)
 				{
 					WLog_ERR(TAG,
 					         "ChannelId %" PRIu32 " did not open successfully. "
-					         "Ignoring DYNVC_DATA_FIRST PDU",
-					         ChannelId);
+					         "Ignoring %s",
+					         ChannelId, drdynvc_get_packet_type(Cmd));
 					return TRUE;
 				}
 
-				return wts_read_drdynvc_data_first(dvc, channel->receiveData, Sp, length);
+				return wts_read_drdynvc_data_first(dvc, channel->receiveData, Sp, length,
+				                                   Cmd == DATA_FIRST_COMPRESSED_PDU);
 
 			case DATA_PDU:
+			case DATA_COMPRESSED_PDU:
 				if (dvc->dvc_open_state != DVC_OPEN_STATE_SUCCEEDED)
 				{
 					WLog_ERR(TAG,
 					         "ChannelId %" PRIu32 " did not open successfully. "
-					         "Ignoring DYNVC_DATA PDU",
-					         ChannelId);
+					         "Ignoring %s",
+					         ChannelId, drdynvc_get_packet_type(Cmd));
 					return TRUE;
 				}
 
-				return wts_read_drdynvc_data(dvc, channel->receiveData, length);
+				return wts_read_drdynvc_data(dvc, channel->receiveData, length,
+				                             Cmd == DATA_COMPRESSED_PDU);
 
 			case CLOSE_REQUEST_PDU:
 				wts_read_drdynvc_close_response(dvc);
 				break;
 
-			case DATA_FIRST_COMPRESSED_PDU:
-			case DATA_COMPRESSED_PDU:
-				WLog_ERR(TAG, "Compressed data not handled");
-				break;
-
 			case SOFT_SYNC_RESPONSE_PDU:
 				WLog_ERR(TAG, "SoftSync response not handled yet(and rather strange to receive "
 				              "that packet as our code doesn't send SoftSync requests");
@@ -419,14 +512,17 @@ static void wts_write_drdynvc_header(wStream* s, BYTE Cmd, UINT32 ChannelId)
 	*bm = ((Cmd & 0x0F) << 4) | cbChId;
 }
 
-static BOOL wts_write_drdynvc_create_request(wStream* s, UINT32 ChannelId, const char* ChannelName)
+static BOOL wts_write_drdynvc_create_request(wStream* s, UINT32 ChannelId, BYTE Priority,
+                                             const char* ChannelName)
 {
 	size_t len = 0;
 
 	WINPR_ASSERT(s);
 	WINPR_ASSERT(ChannelName);
 
+	BYTE* bm = Stream_Pointer(s);
 	wts_write_drdynvc_header(s, CREATE_REQUEST_PDU, ChannelId);
+	*bm |= (Priority & 0x03) << 2;
 	len = strlen(ChannelName) + 1;
 
 	if (!Stream_EnsureRemainingCapacity(s, len))
@@ -562,6 +658,7 @@ BOOL WTSVirtualChannelManagerOpen(HANDLE hServer)
 		if (channel)
 		{
 			BYTE capaBuffer[12];
+			UINT16 charges[DVC_PRIORITY_CLASSES] = { 0 };
 			wStream staticS;
 			wStream* s = Stream_StaticInit(&staticS, capaBuffer, sizeof(capaBuffer));
 
@@ -569,9 +666,12 @@ BOOL WTSVirtualChannelManagerOpen(HANDLE hServer)
 			vcm->dvc_spoken_version = 1;
 			Stream_Write_UINT8(s, 0x50);    /* Cmd=5 sp=0 cbId=0 */
 			Stream_Write_UINT8(s, 0x00);    /* Pad */
-			Stream_Write_UINT16(s, 0x0001); /* Version */
+			Stream_Write_UINT16(s, 0x0003); /* Version, 3 adds compressed data PDUs */
 
-			/* TODO: shall implement version 2 and 3 */
+			/* The charges our scheduler uses, so the client weighs its channels alike */
+			dvc_scheduler_get_priority_charges(vcm->dvc_scheduler, charges, ARRAYSIZE(charges));
+			for (size_t x = 0; x < ARRAYSIZE(charges); x++)
+				Stream_Write_UINT16(s, charges[x]); /* PriorityCharge0..3 */
 
 			ULONG written = 0;
 			if (!WTSVirtualChannelWrite(channel, (PCHAR)capaBuffer, Stream_GetPosition(s),
@@ -600,6 +700,15 @@ BOOL WTSVirtualChannelManagerCheckFileDescriptorEx(HANDLE hServer, BOOL autoOpen
 			return FALSE;
 	}
 
+	/* Channel data queued since the last call, typically a whole graphics pipeline frame,
+	 * is written to the transport as one batch. */
+	WINPR_ASSERT(vcm->client);
+	WINPR_ASSERT(vcm->client->context);
+	WINPR_ASSERT(vcm->client->context->rdp);
+	rdpTransport* transport = vcm->client->context->rdp->transport;
+	if (!transport_begin_batch(transport))
+		return FALSE;
+
 	while (MessageQueue_Peek(vcm->queue, &message, TRUE))
 	{
 		BYTE* buffer = NULL;
@@ -622,6 +731,36 @@ BOOL WTSVirtualChannelManagerCheckFileDescriptorEx(HANDLE hServer, BOOL autoOpen
 			break;
 	}
 
+	/* Dynamic channel PDUs go after the static channel data, which carries their create
+	 * requests, interleaved by priority class. Whatever exceeds the budget is left for the
+	 * next call so the batch stays bounded. */
+	size_t budget = DVC_MAX_SEND_BUDGET;
+	while (status && (budget > 0))
+	{
+		wStream* s = dvc_scheduler_dequeue(vcm->dvc_scheduler);
+		if (!s)
+			break;
+
+		const size_t length = Stream_GetPosition(s);
+		WINPR_ASSERT(vcm->drdynvc_channel);
+		if (!vcm->client->SendChannelData(vcm->client, (UINT16)vcm->drdynvc_channel->channelId,
+		                                  Stream_Buffer(s), length))
+			status = FALSE;
+
+		Stream_Free(s, TRUE);
+		budget -= MIN(budget, length);
+	}
+
+	/* The event stays signaled while anything is left. It is reset first so data queued
+	 * concurrently sets it again and is not missed. */
+	HANDLE event = MessageQueue_Event(vcm->queue);
+	(void)ResetEvent(event);
+	if ((MessageQueue_Size(vcm->queue) > 0) || (dvc_scheduler_pending(vcm->dvc_scheduler) > 0))
+		(void)SetEvent(event);
+
+	if (!transport_end_batch(transport))
+		status = FALSE;
+
 	return status;
 }
 
@@ -1009,6 +1148,11 @@ HANDLE WINAPI FreeRDP_WTSOpenServerA(LPSTR pServerName)
 	if (!vcm->queue)
 		goto error_queue;
 
+	vcm->dvc_scheduler = dvc_scheduler_new(wts_dvc_stream_free);
+
+	if (!vcm->dvc_scheduler)
+		goto error_dvc_scheduler;
+
 	vcm->dvc_channel_id_seq = 0;
 	vcm->dynamicVirtualChannels = HashTable_New(TRUE);
 
@@ -1033,6 +1177,8 @@ HANDLE WINAPI FreeRDP_WTSOpenServerA(LPSTR pServerName)
 error_hashFunction:
 	HashTable_Free(vcm->dynamicVirtualChannels);
 error_dynamicVirtualChannels:
+	dvc_scheduler_free(vcm->dvc_scheduler);
+error_dvc_scheduler:
 	MessageQueue_Free(vcm->queue);
 error_queue:
 	HashTable_Remove(g_ServerHandles, (void*)(UINT_PTR)vcm->SessionId);
@@ -1070,6 +1216,7 @@ VOID WINAPI FreeRDP_WTSCloseServer(HANDLE hServer)
 			vcm->drdynvc_channel = NULL;
 		}
 
+		dvc_scheduler_free(vcm->dvc_scheduler);
 		MessageQueue_Free(vcm->queue);
 		free(vcm);
 	}
@@ -1396,6 +1543,23 @@ HANDLE WINAPI FreeRDP_WTSVirtualChannelOpenEx(DWORD SessionId, LPSTR pVirtualNam
 	}
 
 	channel->channelId = InterlockedIncrement(&vcm->dvc_channel_id_seq);
+	channel->channelFlags = flags;
+
+	/* Channels carrying already compressed data opt out with
+	 * WTS_CHANNEL_OPTION_DYNAMIC_NO_COMPRESS */
+	if ((vcm->dvc_spoken_version >= 3) && !(flags & WTS_CHANNEL_OPTION_DYNAMIC_NO_COMPRESS) &&
+	    drdynvc_channel_name_in_list(freerdp_settings_get_string(client->context->settings,
+	                                                             FreeRDP_DynamicChannelCompression),
+	                                 pVirtualName))
+	{
+		channel->compressor = zgfx_context_new_lite(TRUE);
+		if (!channel->compressor)
+		{
+			channel_free(channel);
+			SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+			return NULL;
+		}
+	}
 
 	if (!HashTable_Insert(vcm->dynamicVirtualChannels, &channel->channelId, channel))
 	{
@@ -1408,7 +1572,9 @@ HANDLE WINAPI FreeRDP_WTSVirtualChannelOpenEx(DWORD SessionId, LPSTR pVirtualNam
 	if (!s)
 		goto fail;
 
-	if (!wts_write_drdynvc_create_request(s, channel->channelId, pVirtualName))
+	/* The Pri field is reserved before version 2 */
+	const BYTE priority = (vcm->dvc_spoken_version >= 2) ? wts_get_dvc_priority(channel) : 0;
+	if (!wts_write_drdynvc_create_request(s, channel->channelId, priority, pVirtualName))
 		goto fail;
 
 	if (!WTSVirtualChannelWrite(vcm->drdynvc_channel, (PCHAR)Stream_Buffer(s),
@@ -1458,7 +1624,6 @@ BOOL WINAPI FreeRDP_WTSVirtualChannelClose(HANDLE hChannelHandle)
 		{
 			if (channel->dvc_open_state == DVC_OPEN_STATE_SUCCEEDED)
 			{
-				ULONG written = 0;
 				s = Stream_New(NULL, 8);
 
 				if (!s)
@@ -1468,10 +1633,9 @@ BOOL WINAPI FreeRDP_WTSVirtualChannelClose(HANDLE hChannelHandle)
 				}
 				else
 				{
+					/* Queued behind the data of the channel so it can not overtake it */
 					wts_write_drdynvc_header(s, CLOSE_REQUEST_PDU, channel->channelId);
-					ret = WTSVirtualChannelWrite(vcm->drdynvc_channel, (PCHAR)Stream_Buffer(s),
-					                             Stream_GetPosition(s), &written);
-					Stream_Free(s, TRUE);
+					ret = wts_queue_dvc_send_item(channel, s);
 				}
 			}
 			HashTable_Remove(vcm->dynamicVirtualChannels, &channel->channelId);
@@ -1584,33 +1748,43 @@ BOOL WINAPI FreeRDP_WTSVirtualChannelWrite(HANDLE hChannelHandle, PCHAR Buffer,
 				goto fail;
 			}
 
+			/* a compressed chunk needs one more byte if it is sent raw */
+			const size_t overhead = channel->compressor ? 1 : 0;
 			buffer = Stream_Buffer(s);
 			Stream_Seek_UINT8(s);
 			cbChId = wts_write_variable_uint(s, channel->channelId);
 
-			if (first && (Length > Stream_GetRemainingLength(s)))
+			if (first && (Length > Stream_GetRemainingLength(s) - overhead))
 			{
+				const BYTE cmd = channel->compressor ? DATA_FIRST_COMPRESSED_PDU : DATA_FIRST_PDU;
 				cbLen = wts_write_variable_uint(s, Length);
-				buffer[0] = (DATA_FIRST_PDU << 4) | (cbLen << 2) | cbChId;
+				buffer[0] = (cmd << 4) | (cbLen << 2) | cbChId;
 			}
 			else
 			{
-				buffer[0] = (DATA_PDU << 4) | cbChId;
+				const BYTE cmd = channel->compressor ? DATA_COMPRESSED_PDU : DATA_PDU;
+				buffer[0] = (cmd << 4) | cbChId;
 			}
 
 			first = FALSE;
-			written = Stream_GetRemainingLength(s);
+			written = Stream_GetRemainingLength(s) - overhead;
 
 			if (written > Length)
 				written = Length;
 
-			Stream_Write(s, Buffer, written);
-			length = Stream_GetPosition(s);
-			Stream_Free(s, FALSE);
+			if (!channel->compressor)
+				Stream_Write(s, Buffer, written);
+			else if (!zgfx_compress_bulk(channel->compressor, (const BYTE*)Buffer, written, s))
+			{
+				WLog_ERR(TAG, "zgfx_compress_bulk failed!");
+				Stream_Free(s, TRUE);
+				goto fail;
+			}
+
 			Length -= written;
 			Buffer += written;
 			totalWritten += written;
-			if (!wts_queue_send_item(channel->vcm->drdynvc_channel, buffer, length))
+			if (!wts_queue_dvc_send_item(channel, s))
 				goto fail;
 		}
 	}
@@ -1918,6 +2092,9 @@ void server_channel_common_free(rdpPeerChannel* channel)
 		return;
 	MessageQueue_Free(channel->queue);
 	Stream_Free(channel->receiveData, TRUE);
+	zgfx_context_free(channel->compressor);
+	zgfx_context_free(channel->decompressor);
+	Stream_Free(channel->decompressedData, TRUE);
 	DeleteCriticalSection(&channel->writeLock);
 	free(channel);
 }
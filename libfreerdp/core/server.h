@@ -24,6 +24,8 @@
 #include <freerdp/freerdp.h>
 #include <freerdp/api.h>
 #include <freerdp/channels/wtsvc.h>
+#include <freerdp/utils/dvc_scheduler.h>
+#include <freerdp/codec/zgfx.h>
 
 #include <winpr/synch.h>
 #include <winpr/stream.h>
@@ -70,6 +72,11 @@ struct rdp_peer_channel
 
 	char channelName[128];
 	CRITICAL_SECTION writeLock;
+
+	/* RDP 8.0 Lite contexts for DYNVC_DATA_COMPRESSED, only with version 3 */
+	ZGFX_CONTEXT* compressor;
+	ZGFX_CONTEXT* decompressor;
+	wStream* decompressedData;
 };
 
 struct WTSVirtualChannelManager
@@ -84,6 +91,7 @@ struct WTSVirtualChannelManager
 	BYTE drdynvc_state;
 	LONG dvc_channel_id_seq;
 	UINT16 dvc_spoken_version;
+	rdpDvcScheduler* dvc_scheduler;
 
 	psDVCCreationStatusCallback dvc_creation_status;
 	void* dvc_creation_status_userdata;
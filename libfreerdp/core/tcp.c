@@ -39,6 +39,7 @@
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <net/if.h>
@@ -139,6 +140,60 @@ static int transport_bio_simple_write(BIO* bio, const char* buf, int size)
 	return status;
 }
 
+/* Gathers the chunks into a single system call, the same as a write of their concatenation */
+static int transport_bio_simple_writev(BIO* bio, const DataChunk* chunks, size_t count)
+{
+	WINPR_BIO_SIMPLE_SOCKET* ptr = (WINPR_BIO_SIMPLE_SOCKET*)BIO_get_data(bio);
+
+	WINPR_ASSERT(ptr);
+
+	if (!chunks || (count == 0))
+		return 0;
+
+#if defined(_WIN32)
+	WINPR_UNUSED(ptr);
+	return transport_bio_simple_write(bio, (const char*)chunks[0].data, (int)chunks[0].size);
+#else
+	struct iovec iov[TRANSPORT_BIO_MAX_IOV] = { 0 };
+	size_t total = 0;
+	int iovcnt = 0;
+
+	for (; (iovcnt < TRANSPORT_BIO_MAX_IOV) && ((size_t)iovcnt < count); iovcnt++)
+	{
+		const DataChunk* chunk = &chunks[iovcnt];
+		if (chunk->size > INT32_MAX - total)
+			break;
+
+		iov[iovcnt].iov_base = (void*)chunk->data;
+		iov[iovcnt].iov_len = chunk->size;
+		total += chunk->size;
+	}
+
+	if (iovcnt == 0)
+		return transport_bio_simple_write(bio, (const char*)chunks[0].data, INT32_MAX);
+
+	BIO_clear_flags(bio, BIO_FLAGS_WRITE);
+	const ssize_t status = writev(ptr->socket, iov, iovcnt);
+
+	if (status <= 0)
+	{
+		const int error = WSAGetLastError();
+
+		if ((error == WSAEWOULDBLOCK) || (error == WSAEINTR) || (error == WSAEINPROGRESS) ||
+		    (error == WSAEALREADY))
+		{
+			BIO_set_flags(bio, (BIO_FLAGS_WRITE | BIO_FLAGS_SHOULD_RETRY));
+		}
+		else
+		{
+			BIO_clear_flags(bio, BIO_FLAGS_SHOULD_RETRY);
+		}
+	}
+
+	return (int)status;
+#endif
+}
+
 static int transport_bio_simple_read(BIO* bio, char* buf, int size)
 {
 	int error = 0;
@@ -344,6 +399,10 @@ static long transport_bio_simple_ctrl(BIO* bio, int cmd, long arg1, void* arg2)
 			status = 1;
 			break;
 
+		case BIO_C_WRITEV:
+			status = transport_bio_simple_writev(bio, (const DataChunk*)arg2, (size_t)arg1);
+			break;
+
 		default:
 			status = 0;
 			break;
@@ -495,34 +554,46 @@ static int transport_bio_buffered_write(BIO* bio, const char* buf, int num)
 	nchunks = ringbuffer_peek(&ptr->xmitBuffer, chunks, ringbuffer_used(&ptr->xmitBuffer));
 	next_bio = BIO_next(bio);
 
-	for (int i = 0; i < nchunks; i++)
+	/* A wrapped ring buffer is sent with one vectored write when the socket is ours */
+	const BOOL vectored = (nchunks > 1) && (BIO_method_type(next_bio) == BIO_TYPE_SIMPLE);
+
+	for (int i = 0; i < nchunks;)
 	{
-		while (chunks[i].size)
-		{
-			ERR_clear_error();
-			const int status = BIO_write(next_bio, chunks[i].data, chunks[i].size);
+		ERR_clear_error();
+		const int status =
+		    vectored ? (int)BIO_writev(next_bio, &chunks[i], (size_t)(nchunks - i))
+		             : BIO_write(next_bio, chunks[i].data, (int)chunks[i].size);
 
-			if (status <= 0)
+		if (status <= 0)
+		{
+			if (!BIO_should_retry(next_bio))
 			{
-				if (!BIO_should_retry(next_bio))
-				{
-					BIO_clear_flags(bio, BIO_FLAGS_SHOULD_RETRY);
-					ret = -1; /* fatal error */
-					goto out;
-				}
+				BIO_clear_flags(bio, BIO_FLAGS_SHOULD_RETRY);
+				ret = -1; /* fatal error */
+				goto out;
+			}
 
-				if (BIO_should_write(next_bio))
-				{
-					BIO_set_flags(bio, BIO_FLAGS_WRITE);
-					ptr->writeBlocked = TRUE;
-					goto out; /* EWOULDBLOCK */
-				}
+			if (BIO_should_write(next_bio))
+			{
+				BIO_set_flags(bio, BIO_FLAGS_WRITE);
+				ptr->writeBlocked = TRUE;
+				goto out; /* EWOULDBLOCK */
 			}
-			else
+		}
+		else
+		{
+			size_t written = (size_t)status;
+			committedBytes += written;
+
+			while ((written > 0) && (i < nchunks))
 			{
-				committedBytes += (size_t)status;
-				chunks[i].size -= (size_t)status;
-				chunks[i].data += status;
+				const size_t consumed = MIN(written, chunks[i].size);
+				chunks[i].size -= consumed;
+				chunks[i].data += consumed;
+				written -= consumed;
+
+				if (chunks[i].size == 0)
+					i++;
 			}
 		}
 	}
@@ -0,0 +1,148 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/wtsapi.h>
+
+#include <freerdp/metrics.h>
+
+#include "../metrics.h"
+
+static BOOL test_histogram(void)
+{
+	FREERDP_METRICS_HISTOGRAM hist = { 0 };
+
+	if (freerdp_metrics_histogram_percentile(&hist, 50.0) != 0)
+		return FALSE;
+
+	/* 90 samples of 3us, 10 samples of 1000us */
+	hist.Count = 100;
+	hist.Buckets[2] = 90;
+	hist.Buckets[10] = 10;
+	hist.MaxUs = 1000;
+	hist.TotalUs = 90 * 3 + 10 * 1000;
+
+	if (freerdp_metrics_histogram_percentile(&hist, 50.0) != 4)
+		return FALSE;
+	if (freerdp_metrics_histogram_percentile(&hist, 90.0) != 4)
+		return FALSE;
+	if (freerdp_metrics_histogram_percentile(&hist, 99.0) != 1000)
+		return FALSE;
+	return TRUE;
+}
+
+static BOOL test_registry(void)
+{
+	BOOL rc = FALSE;
+	char* text = NULL;
+	FREERDP_METRICS_SNAPSHOT* snapshot = NULL;
+	rdpMetrics* metrics = metrics_new(NULL);
+	if (!metrics)
+		return FALSE;
+
+	metrics_channel_data(metrics, 1004, "cliprdr", 100, CHANNEL_FLAG_FIRST, TRUE);
+	metrics_channel_data(metrics, 1004, "cliprdr", 50, CHANNEL_FLAG_LAST, TRUE);
+	metrics_channel_data(metrics, 1005, "drdynvc", 20, CHANNEL_FLAG_FIRST | CHANNEL_FLAG_LAST,
+	                     FALSE);
+	metrics_pdu_time(metrics, FREERDP_METRICS_PDU_DATA, 0x1F, 12000);
+	metrics_pdu_time(metrics, FREERDP_METRICS_PDU_DATA, 0x1F, 2000);
+	metrics_pdu_time(metrics, FREERDP_METRICS_PDU_FASTPATH_UPDATE, 0x0A, 500);
+	metrics_write_queue(metrics, 4096);
+	metrics_write_queue(metrics, 0);
+	metrics_write_blocked(metrics, 1500000);
+	freerdp_metrics_codec_time(metrics, FREERDP_METRICS_CODEC_PLANAR, FALSE, 300000);
+	freerdp_metrics_codec_time(metrics, FREERDP_METRICS_CODEC_COUNT, FALSE, 300000);
+	freerdp_metrics_frame_sent(metrics, 7);
+	freerdp_metrics_frame_acked(metrics, 7);
+	freerdp_metrics_frame_acked(metrics, 7);
+	freerdp_metrics_frame_acked(metrics, 8);
+	freerdp_metrics_frame_presented(metrics, 4000000, 0, 2, 640);
+	freerdp_metrics_frame_presented(metrics, 2000000, 16000000, 1, 64);
+
+	snapshot = freerdp_metrics_snapshot(metrics, TRUE);
+	if (!snapshot)
+		goto fail;
+
+	if ((snapshot->ChannelCount != 2) || (snapshot->Channels[0].BytesSent != 150) ||
+	    (snapshot->Channels[0].PdusSent != 1) || (snapshot->Channels[1].BytesReceived != 20) ||
+	    (snapshot->Channels[1].PdusReceived != 1) ||
+	    (strcmp(snapshot->Channels[0].Name, "cliprdr") != 0))
+	{
+		fprintf(stderr, "channel counters mismatch\n");
+		goto fail;
+	}
+
+	if ((snapshot->PduCount != 2) || (snapshot->Pdus[0].Category != FREERDP_METRICS_PDU_DATA) ||
+	    (snapshot->Pdus[0].Type != 0x1F) || (snapshot->Pdus[0].Time.Count != 2) ||
+	    (snapshot->Pdus[0].Time.MaxUs != 12) || (snapshot->Pdus[1].Time.Count != 1))
+	{
+		fprintf(stderr, "pdu histograms mismatch\n");
+		goto fail;
+	}
+
+	if ((snapshot->WriteQueueBytes != 0) || (snapshot->WriteQueueBytesMax != 4096) ||
+	    (snapshot->WriteBlocked.TotalUs != 1500) ||
+	    (snapshot->Decode[FREERDP_METRICS_CODEC_PLANAR].Count != 1) ||
+	    (snapshot->FrameAckLatency.Count != 1))
+	{
+		fprintf(stderr, "transport or codec metrics mismatch\n");
+		goto fail;
+	}
+
+	/* the first frame has no interval */
+	if ((snapshot->PresentRects != 3) || (snapshot->PresentPixels != 704) ||
+	    (snapshot->PresentLatency.Count != 2) || (snapshot->PresentLatency.MaxUs != 4000) ||
+	    (snapshot->PresentInterval.Count != 1) || (snapshot->PresentInterval.TotalUs != 16000))
+	{
+		fprintf(stderr, "presentation metrics mismatch\n");
+		goto fail;
+	}
+
+	text = freerdp_metrics_snapshot_format(snapshot, "test ");
+	if (!text ||
+	    !strstr(text, "test freerdp_channel{name=\"cliprdr\",id=\"1004\"} bytes_sent=150") ||
+	    !strstr(text, "freerdp_pdu_time{category=\"data\",type=\"0x1F\"} count=2") ||
+	    !strstr(text, "freerdp_codec_time{codec=\"planar\",direction=\"decode\"} count=1") ||
+	    !strstr(text, "freerdp_present{} rects=3 pixels=704") ||
+	    !strstr(text, "freerdp_present_interval{} count=1") ||
+	    strstr(text, "direction=\"encode\""))
+	{
+		fprintf(stderr, "unexpected format:\n%s", text ? text : "(null)");
+		goto fail;
+	}
+
+	/* the snapshot reset the registry, channels stay known with zero counters */
+	freerdp_metrics_snapshot_free(snapshot);
+	snapshot = freerdp_metrics_snapshot(metrics, FALSE);
+	if (!snapshot || (snapshot->ChannelCount != 2) || (snapshot->Channels[0].BytesSent != 0) ||
+	    (snapshot->PduCount != 0) || (snapshot->WriteBlocked.Count != 0) ||
+	    (snapshot->Decode[FREERDP_METRICS_CODEC_PLANAR].Count != 0) ||
+	    (snapshot->PresentPixels != 0) || (snapshot->PresentLatency.Count != 0))
+	{
+		fprintf(stderr, "reset did not clear the registry\n");
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	free(text);
+	freerdp_metrics_snapshot_free(snapshot);
+	metrics_free(metrics);
+	return rc;
+}
+
+int TestMetrics(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!test_histogram())
+	{
+		fprintf(stderr, "histogram percentiles mismatch\n");
+		return -1;
+	}
+
+	if (!test_registry())
+		return -1;
+
+	return 0;
+}
@@ -0,0 +1,354 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/stream.h>
+#include <winpr/sysinfo.h>
+#include <winpr/crypto.h>
+
+#include <freerdp/client.h>
+
+#include "../orders.h"
+#include "../update.h"
+
+typedef struct
+{
+	size_t dstBlt;
+	size_t opaqueRect;
+	size_t multiOpaqueRect;
+	size_t rectangles;
+	size_t setBounds;
+	DSTBLT_ORDER lastDstBlt;
+	MULTI_OPAQUE_RECT_ORDER lastMulti;
+} TestCounters;
+
+static TestCounters counters = { 0 };
+
+static BOOL test_dstblt(rdpContext* context, const DSTBLT_ORDER* dstblt)
+{
+	WINPR_UNUSED(context);
+	counters.dstBlt++;
+	counters.lastDstBlt = *dstblt;
+	return TRUE;
+}
+
+static BOOL test_opaque_rect(rdpContext* context, const OPAQUE_RECT_ORDER* opaque_rect)
+{
+	WINPR_UNUSED(context);
+	WINPR_UNUSED(opaque_rect);
+	counters.opaqueRect++;
+	return TRUE;
+}
+
+static BOOL test_multi_opaque_rect(rdpContext* context,
+                                   const MULTI_OPAQUE_RECT_ORDER* multi_opaque_rect)
+{
+	WINPR_UNUSED(context);
+	counters.multiOpaqueRect++;
+	counters.rectangles += multi_opaque_rect->numRectangles;
+	counters.lastMulti = *multi_opaque_rect;
+	return TRUE;
+}
+
+static BOOL test_set_bounds(rdpContext* context, const rdpBounds* bounds)
+{
+	WINPR_UNUSED(context);
+	WINPR_UNUSED(bounds);
+	counters.setBounds++;
+	return TRUE;
+}
+
+/* Writes one primary order with all fields present, the order body is taken from tmp */
+static BOOL test_write_order(wStream* s, wStream* tmp, BYTE orderType, UINT32 fieldFlags,
+                             BYTE controlFlags)
+{
+	BOOL valid = FALSE;
+	const BYTE fieldBytes = get_primary_drawing_order_field_bytes(orderType, &valid);
+
+	if (!valid || !Stream_EnsureRemainingCapacity(s, 5 + Stream_GetPosition(tmp)))
+		return FALSE;
+
+	Stream_Write_UINT8(s, ORDER_STANDARD | ORDER_TYPE_CHANGE | controlFlags);
+	Stream_Write_UINT8(s, orderType);
+	if (!update_write_field_flags(s, fieldFlags, controlFlags, fieldBytes))
+		return FALSE;
+	Stream_Write(s, Stream_Buffer(tmp), Stream_GetPosition(tmp));
+	Stream_SetPosition(tmp, 0);
+	return TRUE;
+}
+
+static BOOL test_write_opaque_rect(wStream* s, wStream* tmp, INT32 x, INT32 y, UINT32 color,
+                                   BYTE controlFlags)
+{
+	ORDER_INFO info = { 0 };
+	const OPAQUE_RECT_ORDER rect = {
+		.nLeftRect = x, .nTopRect = y, .nWidth = 16, .nHeight = 8, .color = color
+	};
+
+	if (!update_write_opaque_rect_order(tmp, &info, &rect))
+		return FALSE;
+	return test_write_order(s, tmp, ORDER_TYPE_OPAQUE_RECT, info.fieldFlags, controlFlags);
+}
+
+static BOOL test_write_dstblt(wStream* s, wStream* tmp, INT32 x, INT32 y)
+{
+	ORDER_INFO info = { 0 };
+	const DSTBLT_ORDER dstblt = {
+		.nLeftRect = x, .nTopRect = y, .nWidth = 100, .nHeight = 200, .bRop = 0x55
+	};
+
+	if (!update_write_dstblt_order(tmp, &info, &dstblt))
+		return FALSE;
+	return test_write_order(s, tmp, ORDER_TYPE_DSTBLT, info.fieldFlags, 0);
+}
+
+static BOOL test_recv(rdpUpdate* update, wStream* s, size_t count)
+{
+	Stream_SealLength(s);
+	Stream_SetPosition(s, 0);
+
+	for (size_t x = 0; x < count; x++)
+	{
+		if (!update_recv_order(update, s))
+			return FALSE;
+	}
+
+	const BOOL rc = update_flush_orders(update) && (Stream_GetRemainingLength(s) == 0);
+	Stream_SetPosition(s, 0);
+	return rc;
+}
+
+/* Full, partial and delta encoded fields end up in the order structs */
+static BOOL test_fields(rdpUpdate* update, wStream* s, wStream* tmp)
+{
+	counters = (TestCounters){ 0 };
+	if (!test_write_dstblt(s, tmp, -300, 1234) || !test_recv(update, s, 1))
+		return FALSE;
+	if ((counters.dstBlt != 1) || (counters.lastDstBlt.nLeftRect != -300) ||
+	    (counters.lastDstBlt.nTopRect != 1234) || (counters.lastDstBlt.nWidth != 100) ||
+	    (counters.lastDstBlt.nHeight != 200) || (counters.lastDstBlt.bRop != 0x55))
+		return FALSE;
+
+	/* nTopRect as delta -5, bRop, everything else is kept */
+	Stream_Write_UINT8(s, ORDER_STANDARD | ORDER_DELTA_COORDINATES);
+	Stream_Write_UINT8(s, ORDER_FIELD_02 | ORDER_FIELD_05);
+	Stream_Write_UINT8(s, (BYTE)-5);
+	Stream_Write_UINT8(s, 0xAA);
+	if (!test_recv(update, s, 1))
+		return FALSE;
+	if ((counters.dstBlt != 2) || (counters.lastDstBlt.nLeftRect != -300) ||
+	    (counters.lastDstBlt.nTopRect != 1229) || (counters.lastDstBlt.nHeight != 200) ||
+	    (counters.lastDstBlt.bRop != 0xAA))
+		return FALSE;
+
+	/* a single color byte of an opaque rect replaces only that channel */
+	if (!test_write_opaque_rect(s, tmp, 10, 20, 0x123456, 0))
+		return FALSE;
+	Stream_Write_UINT8(s, ORDER_STANDARD);
+	Stream_Write_UINT8(s, ORDER_FIELD_06);
+	Stream_Write_UINT8(s, 0xAB);
+	if (!test_recv(update, s, 2))
+		return FALSE;
+	return (counters.rectangles == 2) && (counters.lastMulti.color == 0x12AB56);
+}
+
+/* Runs of opaque rects are delivered as one MultiOpaqueRect */
+static BOOL test_batching(rdpUpdate* update, wStream* s, wStream* tmp)
+{
+	counters = (TestCounters){ 0 };
+	for (INT32 x = 0; x < 10; x++)
+	{
+		if (!test_write_opaque_rect(s, tmp, x * 16, 100 - x, 0xFF0000, 0))
+			return FALSE;
+	}
+	if (!test_recv(update, s, 10))
+		return FALSE;
+	if ((counters.opaqueRect != 0) || (counters.multiOpaqueRect != 1) ||
+	    (counters.rectangles != 10) || (counters.lastMulti.nLeftRect != 0) ||
+	    (counters.lastMulti.nTopRect != 91) || (counters.lastMulti.nWidth != 160) ||
+	    (counters.lastMulti.nHeight != 17) || (counters.lastMulti.rectangles[9].left != 144))
+		return FALSE;
+
+	/* a color change, another order and a bounded rect each end the run */
+	counters = (TestCounters){ 0 };
+	if (!test_write_opaque_rect(s, tmp, 0, 0, 1, 0) ||
+	    !test_write_opaque_rect(s, tmp, 0, 0, 2, 0) || !test_write_dstblt(s, tmp, 0, 0) ||
+	    !test_write_opaque_rect(s, tmp, 0, 0, 2, 0) ||
+	    !test_write_opaque_rect(s, tmp, 0, 0, 2, ORDER_BOUNDS | ORDER_ZERO_BOUNDS_DELTAS))
+		return FALSE;
+	if (!test_recv(update, s, 5))
+		return FALSE;
+	if ((counters.multiOpaqueRect != 3) || (counters.rectangles != 3) ||
+	    (counters.opaqueRect != 1) || (counters.dstBlt != 1) || (counters.setBounds != 2))
+		return FALSE;
+
+	/* the batch never exceeds the MultiOpaqueRect limit */
+	counters = (TestCounters){ 0 };
+	for (INT32 x = 0; x < 100; x++)
+	{
+		if (!test_write_opaque_rect(s, tmp, x, x, 7, 0))
+			return FALSE;
+	}
+	if (!test_recv(update, s, 100))
+		return FALSE;
+	if ((counters.multiOpaqueRect != 3) || (counters.rectangles != 100))
+		return FALSE;
+
+	/* rects queued before a broken order are dropped with it */
+	counters = (TestCounters){ 0 };
+	for (INT32 x = 0; x < 3; x++)
+	{
+		if (!test_write_opaque_rect(s, tmp, x, x, 7, 0))
+			return FALSE;
+	}
+	Stream_Write_UINT8(s, ORDER_STANDARD | ORDER_TYPE_CHANGE);
+	Stream_Write_UINT8(s, 0x7F); /* no such order */
+	const BOOL broken = test_recv(update, s, 4);
+	Stream_SetPosition(s, 0);
+	if (broken || !update_flush_orders(update) || (counters.multiOpaqueRect != 0) ||
+	    (counters.opaqueRect != 0))
+		return FALSE;
+
+	/* without a MultiOpaqueRect callback every rect is drawn on its own */
+	counters = (TestCounters){ 0 };
+	update->primary->MultiOpaqueRect = NULL;
+	for (INT32 x = 0; x < 3; x++)
+	{
+		if (!test_write_opaque_rect(s, tmp, x, x, 7, 0))
+			return FALSE;
+	}
+	const BOOL rc = test_recv(update, s, 3);
+	update->primary->MultiOpaqueRect = test_multi_opaque_rect;
+	return rc && (counters.opaqueRect == 3) && (counters.multiOpaqueRect == 0);
+}
+
+/* Truncated and corrupted order streams must fail cleanly */
+static BOOL test_fuzz(rdpUpdate* update, wStream* s, wStream* tmp)
+{
+	for (INT32 x = 0; x < 8; x++)
+	{
+		if (!test_write_opaque_rect(s, tmp, x, -x, 0x10203, 0) ||
+		    !test_write_dstblt(s, tmp, -x, x))
+			return FALSE;
+	}
+	Stream_SealLength(s);
+
+	const size_t length = Stream_Length(s);
+	BYTE* data = malloc(length);
+	if (!data)
+		return FALSE;
+
+	for (size_t x = 0; x < 2000; x++)
+	{
+		wStream sbuffer = { 0 };
+		size_t len = length;
+
+		CopyMemory(data, Stream_Buffer(s), length);
+		if (x < length)
+			len = x;
+		else
+		{
+			UINT32 pos = 0;
+			winpr_RAND(&pos, sizeof(pos));
+			winpr_RAND(&data[pos % length], 1);
+		}
+
+		wStream* fuzz = Stream_StaticConstInit(&sbuffer, data, len);
+		while (Stream_GetRemainingLength(fuzz) > 0)
+		{
+			if (!update_recv_order(update, fuzz))
+				break;
+		}
+		update_flush_orders(update);
+	}
+
+	free(data);
+	Stream_SetPosition(s, 0);
+	return TRUE;
+}
+
+static BOOL test_throughput(rdpUpdate* update, wStream* s, wStream* tmp)
+{
+	const size_t count = 1000;
+	const size_t rounds = 200;
+
+	for (size_t x = 0; x < count / 2; x++)
+	{
+		if (!test_write_opaque_rect(s, tmp, (INT32)x, (INT32)x, (UINT32)x / 8, 0) ||
+		    !test_write_dstblt(s, tmp, (INT32)x, 2))
+			return FALSE;
+	}
+
+	const size_t length = Stream_GetPosition(s);
+	const UINT64 start = GetTickCount64();
+	for (size_t x = 0; x < rounds; x++)
+	{
+		Stream_SetPosition(s, length);
+		if (!test_recv(update, s, count))
+			return FALSE;
+	}
+	const UINT64 elapsed = MAX(GetTickCount64() - start, 1);
+
+	printf("decoded %" PRIuz " orders in %" PRIu64 "ms, %" PRIu64 " orders/s\n", count * rounds,
+	       elapsed, UINT64_C(1000) * count * rounds / elapsed);
+	return TRUE;
+}
+
+int TestPrimaryOrders(int argc, char* argv[])
+{
+	int rc = -1;
+	RDP_CLIENT_ENTRY_POINTS entry = { 0 };
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	entry.Version = RDP_CLIENT_INTERFACE_VERSION;
+	entry.Size = sizeof(RDP_CLIENT_ENTRY_POINTS_V1);
+	entry.ContextSize = sizeof(rdpContext);
+
+	wStream* s = Stream_New(NULL, 1024);
+	wStream* tmp = Stream_New(NULL, 1024);
+	rdpContext* context = freerdp_client_context_new(&entry);
+	if (!s || !tmp || !context)
+		goto fail;
+
+	if (!freerdp_settings_set_bool(context->settings, FreeRDP_AllowUnanouncedOrdersFromServer,
+	                               TRUE))
+		goto fail;
+
+	rdpUpdate* update = context->update;
+	update->SetBounds = test_set_bounds;
+	update->primary->DstBlt = test_dstblt;
+	update->primary->OpaqueRect = test_opaque_rect;
+	update->primary->MultiOpaqueRect = test_multi_opaque_rect;
+
+	if (!test_fields(update, s, tmp))
+	{
+		fprintf(stderr, "field decoding test failed\n");
+		goto fail;
+	}
+
+	if (!test_batching(update, s, tmp))
+	{
+		fprintf(stderr, "opaque rect batching test failed\n");
+		goto fail;
+	}
+
+	if (!test_fuzz(update, s, tmp))
+	{
+		fprintf(stderr, "fuzz test failed\n");
+		goto fail;
+	}
+
+	if (!test_throughput(update, s, tmp))
+	{
+		fprintf(stderr, "throughput test failed\n");
+		goto fail;
+	}
+
+	rc = 0;
+fail:
+	freerdp_client_context_free(context);
+	Stream_Free(tmp, TRUE);
+	Stream_Free(s, TRUE);
+	return rc;
+}
@@ -0,0 +1,137 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+
+#include "../gateway/rts.h"
+
+/* Simulated OUT channel between the out proxy and the client, one step per millisecond */
+#define TEST_DURATION 5000
+#define TEST_MAX_DELAY 256
+
+typedef struct
+{
+	UINT32 bytes;
+	UINT32 bytesReceived;
+	UINT32 availableWindow;
+} TestSlot;
+
+typedef struct
+{
+	UINT64 delivered;
+	UINT32 window;
+	size_t acks;
+} TestResult;
+
+static BOOL test_link(UINT32 receiveWindowMax, UINT32 rtt, UINT32 bandwidth, TestResult* result)
+{
+	RpcOutChannel outChannel = { 0 };
+	TestSlot data[TEST_MAX_DELAY] = { 0 };
+	TestSlot acks[TEST_MAX_DELAY] = { 0 };
+	const UINT32 delay = rtt / 2;
+	UINT32 bytesSent = 0;
+
+	if ((delay == 0) || (delay >= TEST_MAX_DELAY))
+		return FALSE;
+
+	outChannel.ReceiveWindow = receiveWindowMax;
+	outChannel.ReceiverAvailableWindow = receiveWindowMax;
+	outChannel.AvailableWindowAdvertised = MIN(0x10000, receiveWindowMax);
+	outChannel.RoundTripTime = rtt;
+
+	/* The sender starts with the window declared in CONN/A1 */
+	INT64 senderWindow = receiveWindowMax;
+
+	for (UINT64 now = 1; now <= TEST_DURATION; now++)
+	{
+		const size_t slot = now % delay;
+
+		/* acknowledgement sent one delay ago reaches the out proxy */
+		if (acks[slot].availableWindow != 0)
+		{
+			senderWindow = 1ll * acks[slot].availableWindow -
+			               (bytesSent - acks[slot].bytesReceived);
+			acks[slot].availableWindow = 0;
+		}
+
+		/* data sent one delay ago reaches the client */
+		const UINT32 arrived = data[slot].bytes;
+		outChannel.BytesReceived += arrived;
+		outChannel.ReceiverAvailableWindow -= MIN(arrived, outChannel.ReceiverAvailableWindow);
+		result->delivered += arrived;
+
+		const UINT32 sent = (UINT32)MAX(MIN(senderWindow, bandwidth), 0);
+		data[slot].bytes = sent;
+		senderWindow -= sent;
+		bytesSent += sent;
+
+		/* the client drained the socket, acknowledge like rts_send_flow_control_ack_pdu */
+		if (rts_flow_control_ack_due(&outChannel, TRUE))
+		{
+			rts_update_receive_window(&outChannel, now);
+			outChannel.ReceiverAvailableWindow = outChannel.AvailableWindowAdvertised;
+			acks[slot].bytesReceived = outChannel.BytesReceived;
+			acks[slot].availableWindow = outChannel.AvailableWindowAdvertised;
+			result->acks++;
+		}
+	}
+
+	result->window = outChannel.AvailableWindowAdvertised;
+	return TRUE;
+}
+
+static void test_print(const char* name, UINT32 rtt, const TestResult* result)
+{
+	printf("%-10s rtt %3" PRIu32 "ms: %8.2f Mbit/s, window %7" PRIu32 ", %" PRIuz " acks\n",
+	       name, rtt, result->delivered * 8.0 / 1000.0 / TEST_DURATION, result->window,
+	       result->acks);
+}
+
+int TestRpcFlowControl(int argc, char* argv[])
+{
+	const UINT32 rtts[] = { 10, 50, 120 };
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	for (size_t x = 0; x < ARRAYSIZE(rtts); x++)
+	{
+		/* 100 Mbit/s link, the receive window limits the throughput */
+		TestResult fixed = { 0 };
+		TestResult adaptive = { 0 };
+
+		if (!test_link(0x10000, rtts[x], 12500, &fixed) ||
+		    !test_link(0x40000, rtts[x], 12500, &adaptive))
+			return -1;
+
+		test_print("fixed", rtts[x], &fixed);
+		test_print("adaptive", rtts[x], &adaptive);
+
+		if (adaptive.window != 0x40000)
+		{
+			fprintf(stderr, "receive window did not grow with rtt %" PRIu32 "ms\n", rtts[x]);
+			return -1;
+		}
+
+		if ((rtts[x] >= 50) && (adaptive.delivered < 3 * fixed.delivered))
+		{
+			fprintf(stderr, "adaptive window did not raise the throughput\n");
+			return -1;
+		}
+
+		/* 800 kbit/s link, the window must stay where it is */
+		TestResult slow = { 0 };
+		if (!test_link(0x40000, rtts[x], 100, &slow))
+			return -1;
+
+		test_print("slow link", rtts[x], &slow);
+
+		if (slow.window != 0x10000)
+		{
+			fprintf(stderr, "receive window grew on a slow link with rtt %" PRIu32 "ms\n",
+			        rtts[x]);
+			return -1;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,140 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/stream.h>
+
+#include <freerdp/peer.h>
+#include <freerdp/channels/wtsvc.h>
+#include <freerdp/utils/dvc_scheduler.h>
+
+#include "../server.h"
+
+#define TEST_DRDYNVC_ID 1004
+#define TEST_PDU_SIZE 1600
+
+static size_t test_sent_bytes = 0;
+
+static BOOL test_send_channel_data(freerdp_peer* client, UINT16 channelId, const BYTE* data,
+                                   size_t size)
+{
+	WINPR_UNUSED(client);
+	WINPR_UNUSED(channelId);
+	WINPR_UNUSED(data);
+
+	test_sent_bytes += size;
+	return TRUE;
+}
+
+static BOOL test_signaled(HANDLE event)
+{
+	return WaitForSingleObject(event, 0) == WAIT_OBJECT_0;
+}
+
+static BOOL test_queue_dvc(WTSVirtualChannelManager* vcm, size_t count)
+{
+	for (size_t x = 0; x < count; x++)
+	{
+		wStream* s = Stream_New(NULL, TEST_PDU_SIZE);
+		if (!s)
+			return FALSE;
+		Stream_Zero(s, TEST_PDU_SIZE);
+		if (!dvc_scheduler_enqueue(vcm->dvc_scheduler, 7, 3, s))
+			return FALSE;
+	}
+	return SetEvent(MessageQueue_Event(vcm->queue));
+}
+
+/* The event handle must not stay signaled once static and dynamic channel data is drained,
+ * otherwise server loops waiting on it spin. */
+static BOOL test_drain(WTSVirtualChannelManager* vcm)
+{
+	HANDLE event = WTSVirtualChannelManagerGetEventHandle(vcm);
+
+	/* static channel data only */
+	BYTE* buffer = calloc(1, 64);
+	if (!buffer || !MessageQueue_Post(vcm->queue, (void*)(UINT_PTR)1003, 0, buffer,
+	                                  (void*)(UINT_PTR)64))
+	{
+		free(buffer);
+		return FALSE;
+	}
+	if (!test_signaled(event) || !WTSVirtualChannelManagerCheckFileDescriptorEx(vcm, FALSE))
+		return FALSE;
+	if (test_signaled(event) || (test_sent_bytes != 64))
+	{
+		(void)fprintf(stderr, "event signaled after draining static channel data\n");
+		return FALSE;
+	}
+
+	/* a single dynamic channel PDU */
+	test_sent_bytes = 0;
+	if (!test_queue_dvc(vcm, 1) || !WTSVirtualChannelManagerCheckFileDescriptorEx(vcm, FALSE))
+		return FALSE;
+	if (test_signaled(event) || (test_sent_bytes != TEST_PDU_SIZE))
+	{
+		(void)fprintf(stderr, "event signaled after draining dynamic channel data\n");
+		return FALSE;
+	}
+
+	/* more than one call sends, the event stays signaled until everything went out */
+	const size_t count = 512;
+	size_t calls = 0;
+	test_sent_bytes = 0;
+	if (!test_queue_dvc(vcm, count))
+		return FALSE;
+	while (test_signaled(event))
+	{
+		if (!WTSVirtualChannelManagerCheckFileDescriptorEx(vcm, FALSE) || (++calls > count))
+			return FALSE;
+	}
+
+	if ((calls < 2) || (test_sent_bytes != count * TEST_PDU_SIZE) ||
+	    (dvc_scheduler_pending(vcm->dvc_scheduler) != 0))
+	{
+		(void)fprintf(stderr, "%" PRIuz " calls sent %" PRIuz " bytes\n", calls, test_sent_bytes);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+int TestVirtualChannelManager(int argc, char* argv[])
+{
+	int rc = -1;
+	HANDLE hServer = INVALID_HANDLE_VALUE;
+	rdpPeerChannel drdynvc = { 0 };
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	freerdp_peer* client = freerdp_peer_new(-1);
+	if (!client || !freerdp_peer_context_new(client))
+		goto fail;
+	client->SendChannelData = test_send_channel_data;
+
+	hServer = FreeRDP_WTSOpenServerA((LPSTR)client->context);
+	if (hServer == INVALID_HANDLE_VALUE)
+		goto fail;
+
+	WTSVirtualChannelManager* vcm = (WTSVirtualChannelManager*)hServer;
+	drdynvc.channelId = TEST_DRDYNVC_ID;
+	vcm->drdynvc_channel = &drdynvc;
+
+	if (!test_drain(vcm))
+	{
+		(void)fprintf(stderr, "test_drain failed\n");
+		goto fail;
+	}
+
+	rc = 0;
+fail:
+	if (hServer != INVALID_HANDLE_VALUE)
+	{
+		((WTSVirtualChannelManager*)hServer)->drdynvc_channel = NULL;
+		FreeRDP_WTSCloseServer(hServer);
+	}
+	if (client)
+		freerdp_peer_context_free(client);
+	freerdp_peer_free(client);
+	return rc;
+}
@@ -0,0 +1,196 @@
+#include <stdio.h>
+
+#include <winpr/stream.h>
+#include <winpr/crypto.h>
+
+#include "../gateway/websocket.h"
+
+static const size_t test_lengths[] = { 0,  1,  3,   4,   5,   15,   16,   17,    31,    32,
+	                                   33, 63, 125, 126, 127, 1000, 4097, 65535, 65536, 70001 };
+
+/* Parse a client frame from the BIO and unmask it byte by byte */
+static BOOL test_check_frame(BIO* bio, const BYTE* expected, size_t length, BYTE opcode)
+{
+	BYTE header[14] = { 0 };
+	size_t headerLength = 6;
+	size_t payloadLength = 0;
+
+	if (BIO_read(bio, header, 2) != 2)
+		return FALSE;
+	if ((header[0] != (WEBSOCKET_FIN_BIT | opcode)) || ((header[1] & WEBSOCKET_MASK_BIT) == 0))
+		return FALSE;
+
+	payloadLength = header[1] & 0x7f;
+	if (payloadLength == 126)
+		headerLength += 2;
+	else if (payloadLength == 127)
+		headerLength += 8;
+
+	if (BIO_read(bio, &header[2], (int)headerLength - 2) != (int)headerLength - 2)
+		return FALSE;
+
+	if (payloadLength >= 126)
+	{
+		payloadLength = 0;
+		for (size_t x = 2; x < headerLength - 4; x++)
+			payloadLength = (payloadLength << 8) | header[x];
+	}
+	if (payloadLength != length)
+		return FALSE;
+
+	BYTE* payload = malloc(length + 1);
+	if (!payload)
+		return FALSE;
+
+	BOOL rc = (length == 0) || (BIO_read(bio, payload, (int)length) == (int)length);
+	const BYTE* key = &header[headerLength - 4];
+	for (size_t x = 0; rc && (x < length); x++)
+	{
+		if ((payload[x] ^ key[x % 4]) != expected[x])
+			rc = FALSE;
+	}
+	free(payload);
+	return rc;
+}
+
+static BOOL test_write(const BYTE* data)
+{
+	BOOL rc = FALSE;
+	BIO* bio = BIO_new(BIO_s_mem());
+	if (!bio)
+		return FALSE;
+
+	for (size_t x = 0; x < ARRAYSIZE(test_lengths); x++)
+	{
+		const size_t length = test_lengths[x];
+		wStream* s = Stream_New(NULL, WEBSOCKET_HEADER_RESERVE + length);
+		if (!s)
+			goto fail;
+
+		Stream_Seek(s, WEBSOCKET_HEADER_RESERVE);
+		Stream_Write(s, data, length);
+		Stream_SealLength(s);
+		const BOOL written = websocket_write_wstream(bio, s, WebsocketBinaryOpcode);
+		Stream_Free(s, TRUE);
+
+		if (!written || !test_check_frame(bio, data, length, WebsocketBinaryOpcode))
+		{
+			fprintf(stderr, "websocket_write_wstream failed for %" PRIuz " bytes\n", length);
+			goto fail;
+		}
+
+		if (length > UINT16_MAX)
+			continue;
+
+		if ((websocket_write(bio, data, (int)length, WebsocketBinaryOpcode) != (int)length) ||
+		    !test_check_frame(bio, data, length, WebsocketBinaryOpcode))
+		{
+			fprintf(stderr, "websocket_write failed for %" PRIuz " bytes\n", length);
+			goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	BIO_free_all(bio);
+	return rc;
+}
+
+/* A client must close the connection on a masked frame from the server */
+static BOOL test_read_client(const BYTE* data)
+{
+	BYTE buffer[64] = { 0 };
+	websocket_context context = { 0 };
+	BIO* bio = BIO_new(BIO_s_mem());
+	if (!bio)
+		return FALSE;
+
+	const BOOL rc =
+	    (websocket_write(bio, data, sizeof(buffer), WebsocketBinaryOpcode) == sizeof(buffer)) &&
+	    (websocket_read(bio, buffer, sizeof(buffer), &context) < 0);
+	BIO_free_all(bio);
+	return rc;
+}
+
+/* Masked frames read back in small pieces by a server must keep the masking key phase */
+static BOOL test_read(const BYTE* data, size_t chunkSize)
+{
+	BOOL rc = FALSE;
+	size_t total = 0;
+	size_t received = 0;
+	websocket_context context = { .serverMode = TRUE };
+	BYTE* buffer = malloc(chunkSize);
+	BIO* bio = BIO_new(BIO_s_mem());
+	if (!bio || !buffer)
+		goto fail;
+
+	for (size_t x = 0; x < ARRAYSIZE(test_lengths); x++)
+	{
+		const size_t length = MIN(test_lengths[x], UINT16_MAX);
+		if (websocket_write(bio, &data[total], (int)length, WebsocketBinaryOpcode) != (int)length)
+			goto fail;
+		total += length;
+	}
+
+	while (received < total)
+	{
+		const int status = websocket_read(bio, buffer, chunkSize, &context);
+		if (status <= 0)
+			break;
+
+		if (memcmp(buffer, &data[received], (size_t)status) != 0)
+		{
+			fprintf(stderr, "websocket_read mismatch at offset %" PRIuz "\n", received);
+			goto fail;
+		}
+		received += (size_t)status;
+	}
+
+	if (received != total)
+	{
+		fprintf(stderr, "websocket_read returned %" PRIuz " of %" PRIuz " bytes\n", received,
+		        total);
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	BIO_free_all(bio);
+	free(buffer);
+	return rc;
+}
+
+int TestWebsocket(int argc, char* argv[])
+{
+	int rc = -1;
+	const size_t size = 256 * 1024;
+	BYTE* data = malloc(size);
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!data)
+		return -1;
+	winpr_RAND(data, size);
+
+	if (!test_write(data))
+		goto fail;
+
+	if (!test_read_client(data))
+	{
+		fprintf(stderr, "websocket_read accepted a masked frame in client mode\n");
+		goto fail;
+	}
+
+	const size_t chunks[] = { 1, 7, 33, 4096, 100000 };
+	for (size_t x = 0; x < ARRAYSIZE(chunks); x++)
+	{
+		if (!test_read(data, chunks[x]))
+			goto fail;
+	}
+
+	rc = 0;
+fail:
+	free(data);
+	return rc;
+}
@@ -381,6 +381,7 @@ static const size_t string_list_indices[] = {
 	FreeRDP_Domain,
 	FreeRDP_DrivesToRedirect,
 	FreeRDP_DumpRemoteFxFile,
+	FreeRDP_DynamicChannelCompression,
 	FreeRDP_DynamicDSTTimeZoneKeyName,
 	FreeRDP_GatewayAcceptedCert,
 	FreeRDP_GatewayAccessToken,
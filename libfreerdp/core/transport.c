@@ -29,6 +29,7 @@
 #include <winpr/stream.h>
 #include <winpr/winsock.h>
 #include <winpr/crypto.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/log.h>
 #include <freerdp/error.h>
@@ -56,6 +57,7 @@
 #include "utils.h"
 #include "state.h"
 #include "childsession.h"
+#include "metrics.h"
 
 #include "gateway/rdg.h"
 #include "gateway/wst.h"
@@ -65,6 +67,9 @@
 
 #define BUFFER_SIZE 16384
 
+/* A batch is written once it holds this many bytes, enough for four full TLS records */
+#define TRANSPORT_BATCH_THRESHOLD (4 * 16384)
+
 struct rdp_transport
 {
 	TRANSPORT_LAYER layer;
@@ -73,6 +78,7 @@ struct rdp_transport
 	rdpTsg* tsg;
 	rdpWst* wst;
 	rdpTls* tls;
+	rdpTlsSessionCache* tlsSessionCache;
 	rdpContext* context;
 	rdpNla* nla;
 	void* ReceiveExtra;
@@ -87,6 +93,8 @@ struct rdp_transport
 	BOOL GatewayEnabled;
 	CRITICAL_SECTION ReadLock;
 	CRITICAL_SECTION WriteLock;
+	wStream* WriteQueue;
+	UINT32 BatchDepth;
 	ULONG written;
 	HANDLE rereadEvent;
 	BOOL haveMoreBytesToRead;
@@ -630,7 +638,10 @@ static BOOL transport_default_accept_tls(rdpTransport* transport)
 
 	if (!transport->tls)
 		transport->tls = freerdp_tls_new(settings);
+	if (!transport->tls)
+		return FALSE;
 
+	transport->tls->sessionCache = transport->tlsSessionCache;
 	transport->layer = TRANSPORT_LAYER_TLS;
 
 	if (!freerdp_tls_accept(transport->tls, transport->frontBio, settings))
@@ -1119,44 +1130,34 @@ int transport_write(rdpTransport* transport, wStream* s)
 	return IFCALLRESULT(-1, transport->io.WritePdu, transport, s);
 }
 
-static int transport_default_write(rdpTransport* transport, wStream* s)
+/* BIO_wait_write that accounts the time spent blocked to the connection metrics */
+static int transport_wait_write(rdpTransport* transport, rdpContext* context)
 {
-	size_t length = 0;
-	int status = -1;
-	int writtenlength = 0;
-	rdpRdp* rdp = NULL;
-	rdpContext* context = transport_get_context(transport);
-
 	WINPR_ASSERT(transport);
 	WINPR_ASSERT(context);
 
-	if (!s)
-		return -1;
+	const UINT64 start = winpr_GetTickCount64NS();
+	const int rc = BIO_wait_write(transport->frontBio, 100);
+	metrics_write_blocked(context->metrics, winpr_GetTickCount64NS() - start);
+	return rc;
+}
 
-	Stream_AddRef(s);
+/* Writes the data to the front BIO, the caller holds the WriteLock */
+static int transport_write_locked(rdpTransport* transport, const BYTE* data, size_t length)
+{
+	int status = -1;
+	rdpContext* context = transport_get_context(transport);
 
-	rdp = context->rdp;
-	if (!rdp)
-		goto fail;
+	WINPR_ASSERT(transport);
+	WINPR_ASSERT(context);
 
-	EnterCriticalSection(&(transport->WriteLock));
 	if (!transport->frontBio)
 		goto out_cleanup;
 
-	length = Stream_GetPosition(s);
-	writtenlength = length;
-	Stream_SetPosition(s, 0);
-
-	if (length > 0)
-	{
-		rdp->outBytes += length;
-		WLog_Packet(transport->log, WLOG_TRACE, Stream_Buffer(s), length, WLOG_PACKET_OUTBOUND);
-	}
-
 	while (length > 0)
 	{
 		ERR_clear_error();
-		status = BIO_write(transport->frontBio, Stream_ConstPointer(s), length);
+		status = BIO_write(transport->frontBio, data, (int)MIN(length, INT32_MAX));
 
 		if (status <= 0)
 		{
@@ -1177,7 +1178,7 @@ static int transport_default_write(rdpTransport* transport, wStream* s)
 				goto out_cleanup;
 			}
 
-			if (BIO_wait_write(transport->frontBio, 100) < 0)
+			if (transport_wait_write(transport, context) < 0)
 			{
 				WLog_ERR_BIO(transport, "BIO_wait_write", transport->frontBio);
 				status = -1;
@@ -1192,7 +1193,7 @@ static int transport_default_write(rdpTransport* transport, wStream* s)
 		{
 			while (BIO_write_blocked(transport->frontBio))
 			{
-				if (BIO_wait_write(transport->frontBio, 100) < 0)
+				if (transport_wait_write(transport, context) < 0)
 				{
 					WLog_Print(transport->log, WLOG_ERROR, "error when selecting for write");
 					status = -1;
@@ -1208,11 +1209,10 @@ static int transport_default_write(rdpTransport* transport, wStream* s)
 			}
 		}
 
-		length -= status;
-		Stream_Seek(s, status);
+		length -= (size_t)status;
+		data += status;
 	}
 
-	transport->written += writtenlength;
 out_cleanup:
 
 	if (status < 0)
@@ -1222,12 +1222,125 @@ out_cleanup:
 		freerdp_set_last_error_if_not(context, FREERDP_ERROR_CONNECT_TRANSPORT_FAILED);
 	}
 
+	return status;
+}
+
+/* Sends everything collected by the current batch, the caller holds the WriteLock */
+static int transport_flush_locked(rdpTransport* transport)
+{
+	WINPR_ASSERT(transport);
+
+	const size_t length = Stream_GetPosition(transport->WriteQueue);
+	if (length == 0)
+		return 1;
+
+	Stream_SetPosition(transport->WriteQueue, 0);
+	metrics_write_queue(transport_get_context(transport)->metrics, 0);
+	return transport_write_locked(transport, Stream_ConstBuffer(transport->WriteQueue), length);
+}
+
+static int transport_queue_write(rdpTransport* transport, const BYTE* data, size_t length)
+{
+	WINPR_ASSERT(transport);
+
+	wStream* queue = transport->WriteQueue;
+
+	/* Large PDUs fill whole TLS records on their own, copying them gains nothing */
+	if ((Stream_GetPosition(queue) == 0) && (length >= TRANSPORT_BATCH_THRESHOLD))
+		return transport_write_locked(transport, data, length);
+
+	if (!Stream_EnsureRemainingCapacity(queue, length))
+		return -1;
+
+	Stream_Write(queue, data, length);
+	metrics_write_queue(transport_get_context(transport)->metrics, Stream_GetPosition(queue));
+
+	if (Stream_GetPosition(queue) >= TRANSPORT_BATCH_THRESHOLD)
+		return transport_flush_locked(transport);
+
+	return (int)length;
+}
+
+static int transport_default_write(rdpTransport* transport, wStream* s)
+{
+	size_t length = 0;
+	int status = -1;
+	rdpRdp* rdp = NULL;
+	rdpContext* context = transport_get_context(transport);
+
+	WINPR_ASSERT(transport);
+	WINPR_ASSERT(context);
+
+	if (!s)
+		return -1;
+
+	Stream_AddRef(s);
+
+	rdp = context->rdp;
+	if (!rdp)
+		goto fail;
+
+	EnterCriticalSection(&(transport->WriteLock));
+	length = Stream_GetPosition(s);
+
+	if (transport->frontBio && (length > 0))
+	{
+		rdp->outBytes += length;
+		WLog_Packet(transport->log, WLOG_TRACE, Stream_Buffer(s), length, WLOG_PACKET_OUTBOUND);
+	}
+
+	if (transport->frontBio && (transport->BatchDepth > 0) && (length > 0))
+		status = transport_queue_write(transport, Stream_ConstBuffer(s), length);
+	else
+		status = transport_write_locked(transport, Stream_ConstBuffer(s), length);
+
+	if (status >= 0)
+		transport->written += length;
+
 	LeaveCriticalSection(&(transport->WriteLock));
 fail:
 	Stream_Release(s);
 	return status;
 }
 
+BOOL transport_begin_batch(rdpTransport* transport)
+{
+	WINPR_ASSERT(transport);
+
+	EnterCriticalSection(&(transport->WriteLock));
+	transport->BatchDepth++;
+	LeaveCriticalSection(&(transport->WriteLock));
+	return TRUE;
+}
+
+BOOL transport_end_batch(rdpTransport* transport)
+{
+	BOOL rc = TRUE;
+
+	WINPR_ASSERT(transport);
+
+	EnterCriticalSection(&(transport->WriteLock));
+	if (transport->BatchDepth == 0)
+	{
+		WLog_Print(transport->log, WLOG_WARN, "transport_end_batch without transport_begin_batch");
+		rc = FALSE;
+	}
+	else if (--transport->BatchDepth == 0)
+		rc = transport_flush_locked(transport) >= 0;
+	LeaveCriticalSection(&(transport->WriteLock));
+	return rc;
+}
+
+BOOL transport_flush(rdpTransport* transport)
+{
+	WINPR_ASSERT(transport);
+
+	EnterCriticalSection(&(transport->WriteLock));
+	const BOOL rc = transport_flush_locked(transport) >= 0;
+	LeaveCriticalSection(&(transport->WriteLock));
+	return rc;
+}
+
 BOOL transport_get_public_key(rdpTransport* transport, const BYTE** data, DWORD* length)
 {
 	return IFCALLRESULT(FALSE, transport->io.GetPublicKey, transport, data, length);
@@ -1395,6 +1508,11 @@ int transport_check_fds(rdpTransport* transport)
 		return -1;
 	}
 
+	/* A batch never outlives an iteration of the event loop, a frame that was not
+	 * closed properly is sent latest here. */
+	if (!transport_flush(transport))
+		return -1;
+
 	/**
 	 * Note: transport_read_pdu tries to read one PDU from
 	 * the transport layer.
@@ -1541,6 +1659,10 @@ static BOOL transport_default_disconnect(rdpTransport* transport)
 		transport->wst = NULL;
 	}
 
+	/* Data batched for the old connection must not leak into a new one */
+	if (transport->WriteQueue)
+		Stream_SetPosition(transport->WriteQueue, 0);
+
 	transport->frontBio = NULL;
 	transport->layer = TRANSPORT_LAYER_TCP;
 	transport->earlyUserAuth = FALSE;
@@ -1584,6 +1706,11 @@ rdpTransport* transport_new(rdpContext* context)
 	if (!transport->ReceiveBuffer)
 		goto fail;
 
+	transport->WriteQueue = Stream_New(NULL, TRANSPORT_BATCH_THRESHOLD);
+
+	if (!transport->WriteQueue)
+		goto fail;
+
 	transport->connectedEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
 
 	if (!transport->connectedEvent || transport->connectedEvent == INVALID_HANDLE_VALUE)
@@ -1630,6 +1757,7 @@ void transport_free(rdpTransport* transport)
 		Stream_Release(transport->ReceiveBuffer);
 
 	nla_free(transport->nla);
+	Stream_Free(transport->WriteQueue, TRUE);
 	StreamPool_Free(transport->ReceivePool);
 	CloseHandle(transport->connectedEvent);
 	CloseHandle(transport->rereadEvent);
@@ -1696,6 +1824,12 @@ rdpTls* transport_get_tls(rdpTransport* transport)
 	return transport->tls;
 }
 
+void transport_set_tls_session_cache(rdpTransport* transport, rdpTlsSessionCache* cache)
+{
+	WINPR_ASSERT(transport);
+	transport->tlsSessionCache = cache;
+}
+
 BOOL transport_set_tsg(rdpTransport* transport, rdpTsg* tsg)
 {
 	WINPR_ASSERT(transport);
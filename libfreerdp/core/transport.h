@@ -48,6 +48,7 @@ typedef enum
 #include <time.h>
 #include <freerdp/types.h>
 #include <freerdp/settings.h>
+#include <freerdp/crypto/tls_session_cache.h>
 #include <freerdp/transport_io.h>
 
 #include "state.h"
@@ -88,6 +89,18 @@ FREERDP_LOCAL BOOL transport_accept_rdstls(rdpTransport* transport);
 FREERDP_LOCAL int transport_read_pdu(rdpTransport* transport, wStream* s);
 FREERDP_LOCAL int transport_write(rdpTransport* transport, wStream* s);
 
+/** @brief Collect the PDUs written until the matching transport_end_batch and send them
+ *  together, as few TLS records and system calls as possible.
+ *
+ *  Batches nest, the outermost transport_end_batch sends the data. Large batches are sent
+ *  early, so the amount of buffered data is bounded.
+ */
+FREERDP_LOCAL BOOL transport_begin_batch(rdpTransport* transport);
+FREERDP_LOCAL BOOL transport_end_batch(rdpTransport* transport);
+
+/** @brief Send the data batched so far without ending the batch */
+FREERDP_LOCAL BOOL transport_flush(rdpTransport* transport);
+
 FREERDP_LOCAL BOOL transport_get_public_key(rdpTransport* transport, const BYTE** data,
                                             DWORD* length);
 
@@ -123,6 +136,10 @@ FREERDP_LOCAL rdpNla* transport_get_nla(rdpTransport* transport);
 FREERDP_LOCAL BOOL transport_set_tls(rdpTransport* transport, rdpTls* tls);
 FREERDP_LOCAL rdpTls* transport_get_tls(rdpTransport* transport);
 
+/** @brief sessions of server side TLS handshakes are stored in and resumed from \b cache */
+FREERDP_LOCAL void transport_set_tls_session_cache(rdpTransport* transport,
+                                                   rdpTlsSessionCache* cache);
+
 FREERDP_LOCAL BOOL transport_set_tsg(rdpTransport* transport, rdpTsg* tsg);
 FREERDP_LOCAL rdpTsg* transport_get_tsg(rdpTransport* transport);
 
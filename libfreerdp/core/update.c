@@ -78,7 +78,7 @@ static BOOL update_recv_orders(rdpUpdate* update, wStream* s)
 		numberOrders--;
 	}
 
-	return TRUE;
+	return update_flush_orders(update);
 }
 
 static BOOL update_read_bitmap_data(rdpUpdate* update, wStream* s, BITMAP_DATA* bitmapData)
@@ -1344,6 +1344,24 @@ out_fail:
 	return ret;
 }
 
+/* The PDUs of a surface frame are written to the transport as one batch. Frame markers
+ * do not nest, a repeated begin or an end without begin is ignored here. */
+static BOOL update_frame_batch(rdpContext* context, BOOL begin)
+{
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(context->rdp);
+
+	rdp_update_internal* update = update_cast(context->update);
+
+	if (update->frameBatch == begin)
+		return TRUE;
+
+	update->frameBatch = begin;
+	if (begin)
+		return transport_begin_batch(context->rdp->transport);
+	return transport_end_batch(context->rdp->transport);
+}
+
 static BOOL update_send_surface_frame_marker(rdpContext* context,
                                              const SURFACE_FRAME_MARKER* surfaceFrameMarker)
 {
@@ -1359,12 +1377,20 @@ static BOOL update_send_surface_frame_marker(rdpContext* context,
 	if (!s)
 		return FALSE;
 
+	if ((surfaceFrameMarker->frameAction == SURFACECMD_FRAMEACTION_BEGIN) &&
+	    !update_frame_batch(context, TRUE))
+		goto out_fail;
+
 	if (!update_write_surfcmd_frame_marker(s, surfaceFrameMarker->frameAction,
 	                                       surfaceFrameMarker->frameId) ||
 	    !fastpath_send_update_pdu(rdp->fastpath, FASTPATH_UPDATETYPE_SURFCMDS, s, FALSE))
 		goto out_fail;
 
 	update_force_flush(context);
+
+	if ((surfaceFrameMarker->frameAction == SURFACECMD_FRAMEACTION_END) &&
+	    !update_frame_batch(context, FALSE))
+		goto out_fail;
 	ret = TRUE;
 out_fail:
 	Stream_Release(s);
@@ -1390,7 +1416,8 @@ static BOOL update_send_surface_frame_bits(rdpContext* context, const SURFACE_BI
 
 	if (first)
 	{
-		if (!update_write_surfcmd_frame_marker(s, SURFACECMD_FRAMEACTION_BEGIN, frameId))
+		if (!update_frame_batch(context, TRUE) ||
+		    !update_write_surfcmd_frame_marker(s, SURFACECMD_FRAMEACTION_BEGIN, frameId))
 			goto out_fail;
 	}
 
@@ -1406,6 +1433,9 @@ static BOOL update_send_surface_frame_bits(rdpContext* context, const SURFACE_BI
 	ret = fastpath_send_update_pdu(rdp->fastpath, FASTPATH_UPDATETYPE_SURFCMDS, s,
 	                               cmd->skipCompression);
 	update_force_flush(context);
+
+	if (last && !update_frame_batch(context, FALSE))
+		ret = FALSE;
 out_fail:
 	Stream_Release(s);
 	return ret;
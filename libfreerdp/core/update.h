@@ -64,6 +64,7 @@ typedef struct
 	rdpBounds currentBounds;
 	rdpBounds previousBounds;
 	CRITICAL_SECTION mux;
+	BOOL frameBatch; /* a surface frame is collected in a transport batch */
 } rdp_update_internal;
 
 typedef struct
@@ -111,6 +112,9 @@ typedef struct
 	POLYGON_CB_ORDER polygon_cb;
 	ELLIPSE_SC_ORDER ellipse_sc;
 	ELLIPSE_CB_ORDER ellipse_cb;
+
+	/* consecutive unbounded OpaqueRect orders of one color, see update_flush_orders */
+	MULTI_OPAQUE_RECT_ORDER opaque_rect_batch;
 } rdp_primary_update_internal;
 
 typedef struct
@@ -0,0 +1,488 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+
+#include <freerdp/settings.h>
+#include <freerdp/crypto/certificate.h>
+#include <freerdp/crypto/privatekey.h>
+#include <freerdp/crypto/tls_session_cache.h>
+
+#include "../tls.h"
+#include "../../core/tcp.h"
+
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <openssl/ec.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+typedef struct
+{
+	int fd;
+	BOOL tls12;
+	SSL_SESSION* session;
+	BOOL resumed;
+	BOOL valid;
+} TestTlsClient;
+
+static char* test_bio_to_string(BIO* bio)
+{
+	char* data = NULL;
+	const long len = BIO_get_mem_data(bio, &data);
+	if ((len <= 0) || !data)
+		return NULL;
+
+	char* str = calloc((size_t)len + 1, sizeof(char));
+	if (str)
+		memcpy(str, data, (size_t)len);
+	return str;
+}
+
+static BOOL test_create_credentials(rdpSettings* settings)
+{
+	BOOL rc = FALSE;
+	EVP_PKEY* pkey = NULL;
+	X509* x509 = NULL;
+	BIO* keyBio = BIO_new(BIO_s_mem());
+	BIO* certBio = BIO_new(BIO_s_mem());
+	EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+	char* keyPem = NULL;
+	char* certPem = NULL;
+
+	if (!keyBio || !certBio || !ctx)
+		goto fail;
+	if ((EVP_PKEY_keygen_init(ctx) <= 0) ||
+	    (EVP_PKEY_CTX_set_ec_paramgen_curve_nid(ctx, NID_X9_62_prime256v1) <= 0) ||
+	    (EVP_PKEY_keygen(ctx, &pkey) <= 0))
+		goto fail;
+
+	x509 = X509_new();
+	if (!x509)
+		goto fail;
+
+	X509_set_version(x509, 2);
+	ASN1_INTEGER_set(X509_get_serialNumber(x509), 1);
+	X509_gmtime_adj(X509_getm_notBefore(x509), 0);
+	X509_gmtime_adj(X509_getm_notAfter(x509), 3600);
+	X509_NAME* name = X509_get_subject_name(x509);
+	X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char*)"localhost", -1,
+	                           -1, 0);
+	X509_set_issuer_name(x509, name);
+	X509_set_pubkey(x509, pkey);
+	if (X509_sign(x509, pkey, EVP_sha256()) <= 0)
+		goto fail;
+
+	if (!PEM_write_bio_PrivateKey(keyBio, pkey, NULL, NULL, 0, NULL, NULL) ||
+	    !PEM_write_bio_X509(certBio, x509))
+		goto fail;
+
+	keyPem = test_bio_to_string(keyBio);
+	certPem = test_bio_to_string(certBio);
+
+	rdpPrivateKey* key = freerdp_key_new_from_pem(keyPem);
+	if (!freerdp_settings_set_pointer_len(settings, FreeRDP_RdpServerRsaKey, key, 1))
+		goto fail;
+
+	rdpCertificate* cert = freerdp_certificate_new_from_pem(certPem);
+	if (!freerdp_settings_set_pointer_len(settings, FreeRDP_RdpServerCertificate, cert, 1))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	free(keyPem);
+	free(certPem);
+	X509_free(x509);
+	EVP_PKEY_free(pkey);
+	EVP_PKEY_CTX_free(ctx);
+	BIO_free(keyBio);
+	BIO_free(certBio);
+	return rc;
+}
+
+static DWORD WINAPI test_client_thread(LPVOID arg)
+{
+	TestTlsClient* client = arg;
+	SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
+	SSL* ssl = NULL;
+	BYTE byte = 0;
+
+	if (!ctx)
+		goto fail;
+
+	/* TLS 1.2 without tickets exercises the session id cache */
+	if (client->tls12)
+	{
+		SSL_CTX_set_max_proto_version(ctx, TLS1_2_VERSION);
+		SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+	}
+
+	ssl = SSL_new(ctx);
+	if (!ssl || (SSL_set_fd(ssl, client->fd) != 1))
+		goto fail;
+	if (client->session && (SSL_set_session(ssl, client->session) != 1))
+		goto fail;
+	if (SSL_connect(ssl) != 1)
+		goto fail;
+
+	/* TLS 1.3 tickets arrive after the handshake, the server sends a byte to deliver them */
+	if (SSL_read(ssl, &byte, 1) != 1)
+		goto fail;
+
+	client->resumed = SSL_session_reused(ssl) ? TRUE : FALSE;
+	SSL_SESSION_free(client->session);
+	client->session = SSL_get1_session(ssl);
+	client->valid = (byte == 0x42) && client->session;
+
+	/* without a clean shutdown OpenSSL marks the session as not resumable */
+	SSL_shutdown(ssl);
+
+fail:
+	SSL_free(ssl);
+	SSL_CTX_free(ctx);
+	return 0;
+}
+
+static BOOL test_loopback_pair(int fds[2])
+{
+	struct sockaddr_in addr = { 0 };
+	socklen_t len = sizeof(addr);
+	const int listener = socket(AF_INET, SOCK_STREAM, 0);
+	if (listener < 0)
+		return FALSE;
+
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if ((bind(listener, (struct sockaddr*)&addr, sizeof(addr)) != 0) ||
+	    (listen(listener, 1) != 0) || (getsockname(listener, (struct sockaddr*)&addr, &len) != 0))
+		goto fail;
+
+	fds[1] = socket(AF_INET, SOCK_STREAM, 0);
+	if ((fds[1] < 0) || (connect(fds[1], (struct sockaddr*)&addr, sizeof(addr)) != 0))
+		goto fail;
+
+	fds[0] = accept(listener, NULL, NULL);
+	if (fds[0] >= 0)
+	{
+		const int nodelay = 1;
+		setsockopt(fds[0], IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+		setsockopt(fds[1], IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+	}
+fail:
+	close(listener);
+	return fds[0] >= 0;
+}
+
+static BIO* test_server_bio(int fd)
+{
+	BIO* socketBio = BIO_new(BIO_s_simple_socket());
+	BIO* bufferedBio = BIO_new(BIO_s_buffered_socket());
+
+	if (!socketBio || !bufferedBio)
+	{
+		BIO_free(socketBio);
+		BIO_free(bufferedBio);
+		return NULL;
+	}
+
+	bufferedBio = BIO_push(bufferedBio, socketBio);
+	BIO_set_fd(socketBio, fd, BIO_CLOSE);
+	return bufferedBio;
+}
+
+/* One connection of client to a server using cache, TRUE if both sides completed */
+static BOOL test_connect(rdpSettings* settings, rdpTlsSessionCache* cache, TestTlsClient* client)
+{
+	BOOL rc = FALSE;
+	int fds[2] = { -1, -1 };
+	HANDLE thread = NULL;
+	rdpTls* tls = NULL;
+	BIO* bio = NULL;
+	const BYTE byte = 0x42;
+
+	client->valid = FALSE;
+	client->resumed = FALSE;
+
+	if (!test_loopback_pair(fds))
+		goto fail;
+
+	bio = test_server_bio(fds[0]);
+	if (!bio)
+		goto fail;
+	fds[0] = -1;
+
+	client->fd = fds[1];
+	thread = CreateThread(NULL, 0, test_client_thread, client, 0, NULL);
+	if (!thread)
+		goto fail;
+
+	tls = freerdp_tls_new(settings);
+	if (!tls)
+		goto fail;
+	tls->sessionCache = cache;
+
+	const BOOL accepted = freerdp_tls_accept(tls, bio, settings);
+	bio = NULL;
+	if (!accepted)
+		goto fail;
+
+	if (freerdp_tls_write_all(tls, &byte, 1) != 1)
+		goto fail;
+
+	while (BIO_write_blocked(tls->bio))
+	{
+		if ((BIO_wait_write(tls->bio, 100) < 0) || (BIO_flush(tls->bio) < 1))
+			goto fail;
+	}
+
+	WaitForSingleObject(thread, INFINITE);
+	if (!client->valid)
+		goto fail;
+
+	if (client->resumed != (SSL_session_reused(tls->ssl) ? TRUE : FALSE))
+	{
+		fprintf(stderr, "client and server disagree about resumption\n");
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	freerdp_tls_free(tls);
+	BIO_free_all(bio);
+	if (fds[0] >= 0)
+		close(fds[0]);
+	if (thread)
+	{
+		if (fds[1] >= 0)
+			shutdown(fds[1], SHUT_RDWR);
+		WaitForSingleObject(thread, INFINITE);
+		CloseHandle(thread);
+	}
+	if (fds[1] >= 0)
+		close(fds[1]);
+	return rc;
+}
+
+static BOOL test_expect(const char* what, BOOL tls12, rdpSettings* settings,
+                        rdpTlsSessionCache* cache, TestTlsClient* client, BOOL resumed)
+{
+	client->tls12 = tls12;
+	if (!test_connect(settings, cache, client))
+	{
+		fprintf(stderr, "%s: connection failed\n", what);
+		return FALSE;
+	}
+
+	if (client->resumed != resumed)
+	{
+		fprintf(stderr, "%s: expected a %s handshake\n", what, resumed ? "resumed" : "full");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static BOOL test_session_ids(rdpSettings* settings)
+{
+	BOOL rc = FALSE;
+	TestTlsClient client = { 0 };
+	TLS_SESSION_CACHE_STATS stats = { 0 };
+	rdpTlsSessionCache* cache = freerdp_tls_session_cache_new(16, 3600, NULL);
+
+	if (!cache)
+		return FALSE;
+
+	if (!test_expect("tls1.2 first", TRUE, settings, cache, &client, FALSE) ||
+	    !test_expect("tls1.2 resume", TRUE, settings, cache, &client, TRUE))
+		goto fail;
+
+	/* a server without the cache can not resume */
+	if (!test_expect("tls1.2 no cache", TRUE, settings, NULL, &client, FALSE))
+		goto fail;
+
+	if (!freerdp_tls_session_cache_get_stats(cache, &stats))
+		goto fail;
+	if ((stats.Handshakes != 2) || (stats.Resumed != 1) || (stats.Stored != 1) ||
+	    (stats.CacheHits != 1) || (stats.Entries != 1) || (stats.Capacity != 16))
+	{
+		fprintf(stderr, "unexpected session id statistics\n");
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	SSL_SESSION_free(client.session);
+	freerdp_tls_session_cache_free(cache);
+	return rc;
+}
+
+static BOOL test_tickets(rdpSettings* settings)
+{
+	BOOL rc = FALSE;
+	TestTlsClient client = { 0 };
+	TLS_SESSION_CACHE_STATS stats = { 0 };
+	rdpTlsSessionCache* cache = freerdp_tls_session_cache_new(16, 3600, NULL);
+
+	if (!cache)
+		return FALSE;
+
+	if (!test_expect("ticket first", FALSE, settings, cache, &client, FALSE) ||
+	    !test_expect("ticket resume", FALSE, settings, cache, &client, TRUE))
+		goto fail;
+
+	/* tickets of the previous key are still accepted and replaced */
+	if (!freerdp_tls_session_cache_rotate_keys(cache) ||
+	    !test_expect("ticket rotated", FALSE, settings, cache, &client, TRUE))
+		goto fail;
+
+	/* the ticket now uses the current key, two rotations retire it */
+	if (!freerdp_tls_session_cache_rotate_keys(cache) ||
+	    !freerdp_tls_session_cache_rotate_keys(cache) ||
+	    !test_expect("ticket retired", FALSE, settings, cache, &client, FALSE))
+		goto fail;
+
+	if (!freerdp_tls_session_cache_get_stats(cache, &stats))
+		goto fail;
+	if ((stats.Handshakes != 4) || (stats.Resumed != 2) || (stats.TicketsAccepted != 2) ||
+	    (stats.TicketsRejected != 1) || (stats.KeyRotations != 3) || (stats.TicketsIssued < 3))
+	{
+		fprintf(stderr, "unexpected ticket statistics\n");
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	SSL_SESSION_free(client.session);
+	freerdp_tls_session_cache_free(cache);
+	return rc;
+}
+
+static BOOL test_shared(rdpSettings* settings)
+{
+	BOOL rc = FALSE;
+	char name[64] = { 0 };
+	TestTlsClient client = { 0 };
+	TLS_SESSION_CACHE_STATS stats = { 0 };
+
+	(void)_snprintf(name, sizeof(name), "/freerdp-test-tls-cache-%d", (int)getpid());
+
+	/* two mappings of the same object stand in for two worker processes */
+	rdpTlsSessionCache* first = freerdp_tls_session_cache_new(16, 3600, name);
+	rdpTlsSessionCache* second = freerdp_tls_session_cache_new(16, 3600, name);
+	rdpTlsSessionCache* mismatch = freerdp_tls_session_cache_new(32, 3600, name);
+
+	if (!first || !second)
+		goto fail;
+	if (mismatch)
+	{
+		fprintf(stderr, "attached to a shared cache of a different size\n");
+		goto fail;
+	}
+
+	if (!test_expect("shared tls1.2 first", TRUE, settings, first, &client, FALSE) ||
+	    !test_expect("shared tls1.2 resume", TRUE, settings, second, &client, TRUE))
+		goto fail;
+
+	SSL_SESSION_free(client.session);
+	client.session = NULL;
+	if (!test_expect("shared ticket first", FALSE, settings, second, &client, FALSE) ||
+	    !test_expect("shared ticket resume", FALSE, settings, first, &client, TRUE))
+		goto fail;
+
+	if (!freerdp_tls_session_cache_get_stats(first, &stats))
+		goto fail;
+	if ((stats.Handshakes != 4) || (stats.Resumed != 2))
+	{
+		fprintf(stderr, "unexpected shared statistics\n");
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	SSL_SESSION_free(client.session);
+	freerdp_tls_session_cache_free(mismatch);
+	freerdp_tls_session_cache_free(second);
+	freerdp_tls_session_cache_free(first);
+	return rc;
+}
+
+/* A shared cache left behind by a crashed creator is replaced, not attached to */
+static BOOL test_shared_stale(rdpSettings* settings)
+{
+	BOOL rc = FALSE;
+	char name[64] = { 0 };
+	TestTlsClient client = { 0 };
+	TLS_SESSION_CACHE_STATS stats = { 0 };
+
+	(void)_snprintf(name, sizeof(name), "/freerdp-test-tls-stale-%d", (int)getpid());
+
+	const pid_t pid = fork();
+	if (pid < 0)
+		return FALSE;
+	if (pid == 0)
+	{
+		/* exits without freeing the cache, so the segment is not unlinked */
+		rdpTlsSessionCache* crashed = freerdp_tls_session_cache_new(16, 3600, name);
+		_exit(crashed ? 0 : 1);
+	}
+
+	int status = 0;
+	if ((waitpid(pid, &status, 0) != pid) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+		return FALSE;
+
+	/* a different size only works with a new table */
+	rdpTlsSessionCache* cache = freerdp_tls_session_cache_new(32, 3600, name);
+	if (!cache)
+	{
+		fprintf(stderr, "stale shared cache was not replaced\n");
+		goto fail;
+	}
+
+	if (!test_expect("stale tls1.2 first", TRUE, settings, cache, &client, FALSE) ||
+	    !test_expect("stale tls1.2 resume", TRUE, settings, cache, &client, TRUE))
+		goto fail;
+
+	if (!freerdp_tls_session_cache_get_stats(cache, &stats) || (stats.Capacity != 32))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	SSL_SESSION_free(client.session);
+	freerdp_tls_session_cache_free(cache);
+	return rc;
+}
+#endif
+
+int TestTlsSessionCache(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+#if defined(__linux__)
+	int rc = -1;
+	rdpSettings* settings = freerdp_settings_new(FREERDP_SETTINGS_SERVER_MODE);
+
+	if (!settings || !test_create_credentials(settings))
+		goto fail;
+
+	if (freerdp_tls_session_cache_new(0, 3600, NULL) || freerdp_tls_session_cache_new(16, 0, NULL))
+		goto fail;
+
+	if (!test_session_ids(settings) || !test_tickets(settings) || !test_shared(settings) ||
+	    !test_shared_stale(settings))
+		goto fail;
+
+	rc = 0;
+fail:
+	freerdp_settings_free(settings);
+	return rc;
+#else
+	return 0;
+#endif
+}
@@ -45,6 +45,7 @@
 #include "opensslcompat.h"
 #include "certificate.h"
 #include "privatekey.h"
+#include "tls_session_cache.h"
 
 #ifdef WINPR_HAVE_POLL_H
 #include <poll.h>
@@ -794,6 +795,15 @@ static BOOL tls_prepare(rdpTls* tls, BIO* underlying, SSL_METHOD* method, int op
 		}
 	}
 
+	if (!clientMode && tls->sessionCache)
+	{
+		if (!freerdp_tls_session_cache_attach(tls->sessionCache, tls->ctx))
+		{
+			WLog_ERR(TAG, "failed to attach the TLS session cache");
+			return FALSE;
+		}
+	}
+
 	tls->bio = BIO_new_rdp_tls(tls->ctx, clientMode);
 
 	if (BIO_get_ssl(tls->bio, &tls->ssl) < 0)
@@ -954,6 +964,10 @@ TlsHandshakeResult freerdp_tls_handshake(rdpTls* tls)
 		/* server-side NLA needs public keys (keys from us, the server) but no certificate verify */
 		ret = TLS_HANDSHAKE_SUCCESS;
 
+		if (!tls->isClientMode && tls->sessionCache)
+			freerdp_tls_session_cache_handshake(tls->sessionCache,
+			                                    SSL_session_reused(tls->ssl) ? TRUE : FALSE);
+
 		if (tls->isClientMode)
 		{
 			verify_status = tls_verify_certificate(tls, cert, tls_get_server_name(tls), tls->port);
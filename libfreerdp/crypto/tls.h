@@ -29,6 +29,7 @@
 #include <freerdp/api.h>
 #include <freerdp/types.h>
 #include <freerdp/crypto/certificate_store.h>
+#include <freerdp/crypto/tls_session_cache.h>
 
 #include <winpr/stream.h>
 
@@ -82,6 +83,7 @@ struct rdp_tls
 	int alertDescription;
 	BOOL isGatewayTransport;
 	BOOL isClientMode;
+	rdpTlsSessionCache* sessionCache;
 };
 
 /** @brief result of a handshake operation */
@@ -0,0 +1,775 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Server side TLS session resumption cache
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <time.h>
+#include <errno.h>
+
+#include <winpr/assert.h>
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+
+#include <openssl/rand.h>
+#include <openssl/evp.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(LIBRESSL_VERSION_NUMBER)
+#include <openssl/core_names.h>
+#else
+#include <openssl/hmac.h>
+#endif
+
+#include <freerdp/log.h>
+#include <freerdp/types.h>
+
+#include "tls_session_cache.h"
+
+#define TAG FREERDP_TAG("crypto.tls.cache")
+
+#if !defined(_WIN32)
+#define TLS_SESSION_CACHE_SHARED_MEMORY
+#include <fcntl.h>
+#include <signal.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define TLS_SESSION_CACHE_MAGIC 0x46524353 /* FRCS */
+#define TLS_SESSION_CACHE_VERSION 1
+#define TLS_SESSION_CACHE_WAYS 4
+#define TLS_SESSION_CACHE_MAX_ID 32
+#define TLS_SESSION_CACHE_MAX_DER 1024
+#define TLS_SESSION_CACHE_MAX_ENTRIES (1024 * 1024)
+#define TLS_SESSION_TICKET_NAME_SIZE 16
+#define TLS_SESSION_TICKET_KEY_SIZE 32
+
+/* Sessions are bound to this context, a session of another application is never resumed */
+static const unsigned char tls_session_id_context[] = "FreeRDP";
+
+typedef struct
+{
+	BYTE name[TLS_SESSION_TICKET_NAME_SIZE];
+	BYTE aesKey[TLS_SESSION_TICKET_KEY_SIZE];
+	BYTE hmacKey[TLS_SESSION_TICKET_KEY_SIZE];
+	INT64 created;
+} TLS_SESSION_TICKET_KEY;
+
+typedef struct
+{
+	UINT64 lastUsed;
+	INT64 expires;
+	UINT32 idLength;
+	UINT32 derLength;
+	BYTE id[TLS_SESSION_CACHE_MAX_ID];
+	BYTE der[TLS_SESSION_CACHE_MAX_DER];
+} TLS_SESSION_CACHE_ENTRY;
+
+/* Everything in here may live in shared memory, so no pointers */
+typedef struct
+{
+	UINT32 magic;
+	UINT32 version;
+	UINT32 capacity;
+	UINT32 lifetime;
+#if defined(TLS_SESSION_CACHE_SHARED_MEMORY)
+	INT32 ownerPid; /* process that created the shared table */
+	pthread_mutex_t mutex;
+#endif
+	UINT64 clock;
+	TLS_SESSION_TICKET_KEY keys[2]; /* current and previous ticket key */
+	TLS_SESSION_CACHE_STATS stats;
+	TLS_SESSION_CACHE_ENTRY entries[];
+} TLS_SESSION_CACHE_TABLE;
+
+struct rdp_tls_session_cache
+{
+	TLS_SESSION_CACHE_TABLE* table;
+	size_t tableSize;
+	char* sharedName;
+	BOOL owner;
+#if !defined(TLS_SESSION_CACHE_SHARED_MEMORY)
+	CRITICAL_SECTION lock;
+#endif
+};
+
+static INIT_ONCE tls_session_cache_idx_once = INIT_ONCE_STATIC_INIT;
+static int tls_session_cache_idx = -1;
+
+static BOOL CALLBACK tls_session_cache_idx_init_cb(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	WINPR_UNUSED(once);
+	WINPR_UNUSED(param);
+	WINPR_UNUSED(context);
+
+	tls_session_cache_idx = SSL_CTX_get_ex_new_index(0, NULL, NULL, NULL, NULL);
+	return (tls_session_cache_idx != -1);
+}
+
+static rdpTlsSessionCache* tls_session_cache_from_ssl(const SSL* ssl)
+{
+	if (!ssl || (tls_session_cache_idx == -1))
+		return NULL;
+	return SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), tls_session_cache_idx);
+}
+
+static void tls_session_cache_lock(rdpTlsSessionCache* cache)
+{
+	WINPR_ASSERT(cache);
+#if defined(TLS_SESSION_CACHE_SHARED_MEMORY)
+	const int rc = pthread_mutex_lock(&cache->table->mutex);
+#if defined(__linux__)
+	/* A worker died while holding the lock, the table is consistent between operations */
+	if (rc == EOWNERDEAD)
+		pthread_mutex_consistent(&cache->table->mutex);
+#else
+	WINPR_UNUSED(rc);
+#endif
+#else
+	EnterCriticalSection(&cache->lock);
+#endif
+}
+
+static void tls_session_cache_unlock(rdpTlsSessionCache* cache)
+{
+	WINPR_ASSERT(cache);
+#if defined(TLS_SESSION_CACHE_SHARED_MEMORY)
+	pthread_mutex_unlock(&cache->table->mutex);
+#else
+	LeaveCriticalSection(&cache->lock);
+#endif
+}
+
+static BOOL tls_session_cache_new_key(TLS_SESSION_TICKET_KEY* key, INT64 now)
+{
+	WINPR_ASSERT(key);
+
+	if ((RAND_bytes(key->name, sizeof(key->name)) != 1) ||
+	    (RAND_bytes(key->aesKey, sizeof(key->aesKey)) != 1) ||
+	    (RAND_bytes(key->hmacKey, sizeof(key->hmacKey)) != 1))
+	{
+		WLog_ERR(TAG, "failed to generate a session ticket key");
+		return FALSE;
+	}
+
+	key->created = now;
+	return TRUE;
+}
+
+/* must be called with the lock held */
+static BOOL tls_session_cache_rotate(rdpTlsSessionCache* cache, INT64 now)
+{
+	TLS_SESSION_CACHE_TABLE* table = cache->table;
+	TLS_SESSION_TICKET_KEY key = { 0 };
+
+	if (!tls_session_cache_new_key(&key, now))
+		return FALSE;
+
+	table->keys[1] = table->keys[0];
+	table->keys[0] = key;
+	table->stats.KeyRotations++;
+	return TRUE;
+}
+
+/* must be called with the lock held */
+static void tls_session_cache_rotate_if_due(rdpTlsSessionCache* cache, INT64 now)
+{
+	TLS_SESSION_CACHE_TABLE* table = cache->table;
+
+	if (now - table->keys[0].created >= table->lifetime)
+		tls_session_cache_rotate(cache, now);
+}
+
+static UINT32 tls_session_cache_set(const TLS_SESSION_CACHE_TABLE* table, const BYTE* id,
+                                    size_t length)
+{
+	/* FNV-1a, session ids are random so this only has to fold the bytes */
+	UINT32 hash = 2166136261u;
+	for (size_t x = 0; x < length; x++)
+		hash = (hash ^ id[x]) * 16777619u;
+
+	return (hash % (table->capacity / TLS_SESSION_CACHE_WAYS)) * TLS_SESSION_CACHE_WAYS;
+}
+
+/* must be called with the lock held */
+static TLS_SESSION_CACHE_ENTRY* tls_session_cache_find(TLS_SESSION_CACHE_TABLE* table,
+                                                       const BYTE* id, size_t length)
+{
+	const UINT32 set = tls_session_cache_set(table, id, length);
+
+	for (UINT32 x = 0; x < TLS_SESSION_CACHE_WAYS; x++)
+	{
+		TLS_SESSION_CACHE_ENTRY* entry = &table->entries[set + x];
+		if ((entry->idLength == length) && (memcmp(entry->id, id, length) == 0))
+			return entry;
+	}
+
+	return NULL;
+}
+
+/* must be called with the lock held */
+static void tls_session_cache_remove_entry(TLS_SESSION_CACHE_TABLE* table,
+                                           TLS_SESSION_CACHE_ENTRY* entry)
+{
+	entry->idLength = 0;
+	entry->derLength = 0;
+	entry->lastUsed = 0;
+	if (table->stats.Entries > 0)
+		table->stats.Entries--;
+}
+
+static int tls_session_cache_new_session_cb(SSL* ssl, SSL_SESSION* session)
+{
+	rdpTlsSessionCache* cache = tls_session_cache_from_ssl(ssl);
+	if (!cache)
+		return 0;
+
+	unsigned int idLength = 0;
+	const BYTE* id = SSL_SESSION_get_id(session, &idLength);
+	const int derLength = i2d_SSL_SESSION(session, NULL);
+
+	if ((idLength == 0) || (idLength > TLS_SESSION_CACHE_MAX_ID))
+		return 0;
+
+	if ((derLength <= 0) || (derLength > TLS_SESSION_CACHE_MAX_DER))
+	{
+		WLog_DBG(TAG, "session of %d bytes does not fit the cache", derLength);
+		return 0;
+	}
+
+	BYTE der[TLS_SESSION_CACHE_MAX_DER] = { 0 };
+	BYTE* ptr = der;
+	if (i2d_SSL_SESSION(session, &ptr) != derLength)
+		return 0;
+
+	const INT64 expires = (INT64)SSL_SESSION_get_time(session) + SSL_SESSION_get_timeout(session);
+
+	tls_session_cache_lock(cache);
+	TLS_SESSION_CACHE_TABLE* table = cache->table;
+	TLS_SESSION_CACHE_ENTRY* entry = tls_session_cache_find(table, id, idLength);
+
+	if (!entry)
+	{
+		const UINT32 set = tls_session_cache_set(table, id, idLength);
+		const INT64 now = time(NULL);
+
+		/* prefer a free or expired way, otherwise evict the least recently used */
+		for (UINT32 x = 0; x < TLS_SESSION_CACHE_WAYS; x++)
+		{
+			TLS_SESSION_CACHE_ENTRY* cur = &table->entries[set + x];
+			if ((cur->idLength != 0) && (cur->expires <= now))
+				tls_session_cache_remove_entry(table, cur);
+
+			if (!entry || (cur->lastUsed < entry->lastUsed))
+				entry = cur;
+		}
+
+		if (entry->idLength != 0)
+		{
+			table->stats.Evicted++;
+			tls_session_cache_remove_entry(table, entry);
+		}
+		table->stats.Entries++;
+	}
+
+	entry->idLength = idLength;
+	memcpy(entry->id, id, idLength);
+	entry->derLength = (UINT32)derLength;
+	memcpy(entry->der, der, (size_t)derLength);
+	entry->expires = expires;
+	entry->lastUsed = ++table->clock;
+	table->stats.Stored++;
+	tls_session_cache_unlock(cache);
+
+	/* the session was serialized, OpenSSL keeps its reference */
+	return 0;
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L || defined(LIBRESSL_VERSION_NUMBER)
+static SSL_SESSION* tls_session_cache_get_session_cb(SSL* ssl, const unsigned char* id,
+                                                     int length, int* copy)
+#else
+static SSL_SESSION* tls_session_cache_get_session_cb(SSL* ssl, unsigned char* id, int length,
+                                                     int* copy)
+#endif
+{
+	rdpTlsSessionCache* cache = tls_session_cache_from_ssl(ssl);
+	BYTE der[TLS_SESSION_CACHE_MAX_DER] = { 0 };
+	UINT32 derLength = 0;
+
+	WINPR_ASSERT(copy);
+	*copy = 0;
+
+	if (!cache || (length <= 0) || (length > TLS_SESSION_CACHE_MAX_ID))
+		return NULL;
+
+	tls_session_cache_lock(cache);
+	TLS_SESSION_CACHE_TABLE* table = cache->table;
+	TLS_SESSION_CACHE_ENTRY* entry = tls_session_cache_find(table, id, (size_t)length);
+
+	if (entry && (entry->expires <= time(NULL)))
+	{
+		tls_session_cache_remove_entry(table, entry);
+		entry = NULL;
+	}
+
+	if (entry)
+	{
+		derLength = entry->derLength;
+		memcpy(der, entry->der, derLength);
+		entry->lastUsed = ++table->clock;
+		table->stats.CacheHits++;
+	}
+	else
+		table->stats.CacheMisses++;
+	tls_session_cache_unlock(cache);
+
+	if (derLength == 0)
+		return NULL;
+
+	/* the returned reference is handed over to OpenSSL */
+	const BYTE* ptr = der;
+	return d2i_SSL_SESSION(NULL, &ptr, (long)derLength);
+}
+
+static void tls_session_cache_remove_session_cb(SSL_CTX* ctx, SSL_SESSION* session)
+{
+	if (tls_session_cache_idx == -1)
+		return;
+
+	rdpTlsSessionCache* cache = SSL_CTX_get_ex_data(ctx, tls_session_cache_idx);
+	if (!cache)
+		return;
+
+	unsigned int idLength = 0;
+	const BYTE* id = SSL_SESSION_get_id(session, &idLength);
+	if ((idLength == 0) || (idLength > TLS_SESSION_CACHE_MAX_ID))
+		return;
+
+	tls_session_cache_lock(cache);
+	TLS_SESSION_CACHE_ENTRY* entry = tls_session_cache_find(cache->table, id, idLength);
+	if (entry)
+		tls_session_cache_remove_entry(cache->table, entry);
+	tls_session_cache_unlock(cache);
+}
+
+/* Looks up the key for a ticket or the current key for a new one.
+ * Returns 0 if the ticket key is unknown, 1 if it is valid and 2 if the ticket should be
+ * replaced by one of the current key. */
+static int tls_session_cache_ticket_key(rdpTlsSessionCache* cache, BYTE* name, BOOL encrypt,
+                                        TLS_SESSION_TICKET_KEY* key)
+{
+	int rc = 0;
+	const INT64 now = time(NULL);
+
+	tls_session_cache_lock(cache);
+	TLS_SESSION_CACHE_TABLE* table = cache->table;
+	tls_session_cache_rotate_if_due(cache, now);
+
+	if (encrypt)
+	{
+		*key = table->keys[0];
+		memcpy(name, key->name, sizeof(key->name));
+		table->stats.TicketsIssued++;
+		rc = 1;
+	}
+	else
+	{
+		for (size_t x = 0; x < ARRAYSIZE(table->keys); x++)
+		{
+			const TLS_SESSION_TICKET_KEY* cur = &table->keys[x];
+
+			/* the previous key is retired one lifetime after the rotation */
+			if ((cur->created == 0) || (now - cur->created >= 2ll * table->lifetime))
+				continue;
+
+			if (memcmp(cur->name, name, sizeof(cur->name)) == 0)
+			{
+				*key = *cur;
+				rc = (x == 0) ? 1 : 2;
+				break;
+			}
+		}
+
+		if (rc > 0)
+			table->stats.TicketsAccepted++;
+		else
+			table->stats.TicketsRejected++;
+	}
+	tls_session_cache_unlock(cache);
+	return rc;
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(LIBRESSL_VERSION_NUMBER)
+static int tls_session_cache_ticket_cb(SSL* ssl, unsigned char* name, unsigned char* iv,
+                                       EVP_CIPHER_CTX* cipher, EVP_MAC_CTX* hmac, int encrypt)
+#else
+static int tls_session_cache_ticket_cb(SSL* ssl, unsigned char* name, unsigned char* iv,
+                                       EVP_CIPHER_CTX* cipher, HMAC_CTX* hmac, int encrypt)
+#endif
+{
+	rdpTlsSessionCache* cache = tls_session_cache_from_ssl(ssl);
+	TLS_SESSION_TICKET_KEY key = { 0 };
+
+	if (!cache)
+		return -1;
+
+	const int rc = tls_session_cache_ticket_key(cache, name, encrypt ? TRUE : FALSE, &key);
+	if (rc <= 0)
+		return rc;
+
+	if (encrypt && (RAND_bytes(iv, EVP_MAX_IV_LENGTH) != 1))
+		return -1;
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(LIBRESSL_VERSION_NUMBER)
+	char digest[] = "SHA256";
+	OSSL_PARAM params[] = { OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest, 0),
+		                    OSSL_PARAM_construct_end() };
+	if (EVP_MAC_init(hmac, key.hmacKey, sizeof(key.hmacKey), params) != 1)
+		return -1;
+#else
+	if (HMAC_Init_ex(hmac, key.hmacKey, sizeof(key.hmacKey), EVP_sha256(), NULL) != 1)
+		return -1;
+#endif
+
+	if (encrypt)
+	{
+		if (EVP_EncryptInit_ex(cipher, EVP_aes_256_cbc(), NULL, key.aesKey, iv) != 1)
+			return -1;
+	}
+	else if (EVP_DecryptInit_ex(cipher, EVP_aes_256_cbc(), NULL, key.aesKey, iv) != 1)
+		return -1;
+
+	return rc;
+}
+
+BOOL freerdp_tls_session_cache_attach(rdpTlsSessionCache* cache, SSL_CTX* ctx)
+{
+	WINPR_ASSERT(cache);
+	WINPR_ASSERT(ctx);
+
+	if (!InitOnceExecuteOnce(&tls_session_cache_idx_once, tls_session_cache_idx_init_cb, NULL,
+	                         NULL) ||
+	    (tls_session_cache_idx == -1))
+		return FALSE;
+
+	if (SSL_CTX_set_ex_data(ctx, tls_session_cache_idx, cache) != 1)
+		return FALSE;
+
+	if (SSL_CTX_set_session_id_context(ctx, tls_session_id_context,
+	                                   sizeof(tls_session_id_context) - 1) != 1)
+		return FALSE;
+
+	/* Every connection has its own SSL_CTX, so the internal cache would never hit */
+	SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL);
+	SSL_CTX_set_timeout(ctx, cache->table->lifetime);
+	SSL_CTX_sess_set_new_cb(ctx, tls_session_cache_new_session_cb);
+	SSL_CTX_sess_set_get_cb(ctx, tls_session_cache_get_session_cb);
+	SSL_CTX_sess_set_remove_cb(ctx, tls_session_cache_remove_session_cb);
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(LIBRESSL_VERSION_NUMBER)
+	if (SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, tls_session_cache_ticket_cb) != 1)
+		return FALSE;
+#else
+	if (SSL_CTX_set_tlsext_ticket_key_cb(ctx, tls_session_cache_ticket_cb) != 1)
+		return FALSE;
+#endif
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L && !defined(LIBRESSL_VERSION_NUMBER)
+	/* A reconnect uses one ticket, the default of two only costs bandwidth */
+	SSL_CTX_set_num_tickets(ctx, 1);
+#endif
+	return TRUE;
+}
+
+void freerdp_tls_session_cache_handshake(rdpTlsSessionCache* cache, BOOL resumed)
+{
+	WINPR_ASSERT(cache);
+
+	tls_session_cache_lock(cache);
+	cache->table->stats.Handshakes++;
+	if (resumed)
+		cache->table->stats.Resumed++;
+	tls_session_cache_unlock(cache);
+}
+
+static BOOL tls_session_cache_init_table(rdpTlsSessionCache* cache, UINT32 capacity,
+                                         UINT32 lifetime)
+{
+	TLS_SESSION_CACHE_TABLE* table = cache->table;
+
+	table->version = TLS_SESSION_CACHE_VERSION;
+	table->capacity = capacity;
+	table->lifetime = lifetime;
+	table->stats.Capacity = capacity;
+
+#if defined(TLS_SESSION_CACHE_SHARED_MEMORY)
+	pthread_mutexattr_t attr;
+	if (pthread_mutexattr_init(&attr) != 0)
+		return FALSE;
+
+	BOOL rc = TRUE;
+	if (cache->sharedName)
+	{
+		rc = (pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) == 0);
+#if defined(__linux__)
+		if (rc)
+			rc = (pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST) == 0);
+#endif
+	}
+	if (rc)
+		rc = (pthread_mutex_init(&table->mutex, &attr) == 0);
+	pthread_mutexattr_destroy(&attr);
+	if (!rc)
+	{
+		WLog_ERR(TAG, "failed to initialize the session cache lock");
+		return FALSE;
+	}
+#endif
+
+	if (!tls_session_cache_new_key(&table->keys[0], time(NULL)))
+		return FALSE;
+
+#if defined(TLS_SESSION_CACHE_SHARED_MEMORY)
+	/* processes attaching to the table wait for this */
+	__atomic_store_n(&table->magic, TLS_SESSION_CACHE_MAGIC, __ATOMIC_RELEASE);
+#else
+	table->magic = TLS_SESSION_CACHE_MAGIC;
+#endif
+	return TRUE;
+}
+
+#if defined(TLS_SESSION_CACHE_SHARED_MEMORY)
+/* The creator unlinks the table when it is freed, a table whose creator is gone was left
+ * behind by a crash. A table that is still being created counts as alive. */
+static BOOL tls_session_cache_owner_gone(rdpTlsSessionCache* cache, int fd)
+{
+	INT32 pid = 0;
+	if (pread(fd, &pid, sizeof(pid), offsetof(TLS_SESSION_CACHE_TABLE, ownerPid)) !=
+	    sizeof(pid))
+		return FALSE;
+	if ((pid <= 0) || (kill((pid_t)pid, 0) == 0) || (errno != ESRCH))
+		return FALSE;
+
+	WLog_WARN(TAG, "shared session cache %s was left behind by process %" PRId32 ", recreating it",
+	          cache->sharedName, pid);
+	return TRUE;
+}
+
+static int tls_session_cache_open_shared(rdpTlsSessionCache* cache)
+{
+	for (size_t attempt = 0; attempt < 2; attempt++)
+	{
+		int fd = shm_open(cache->sharedName, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+		if (fd >= 0)
+		{
+			cache->owner = TRUE;
+			if (ftruncate(fd, (off_t)cache->tableSize) != 0)
+			{
+				WLog_ERR(TAG, "failed to size shared session cache %s: %s", cache->sharedName,
+				         strerror(errno));
+				close(fd);
+				return -1;
+			}
+			return fd;
+		}
+		if (errno != EEXIST)
+			return -1;
+
+		fd = shm_open(cache->sharedName, O_RDWR, 0);
+		if (fd < 0)
+		{
+			/* unlinked by its owner in between */
+			if (errno == ENOENT)
+				continue;
+			return -1;
+		}
+
+		if (!tls_session_cache_owner_gone(cache, fd))
+			return fd;
+
+		close(fd);
+		shm_unlink(cache->sharedName);
+	}
+
+	errno = EEXIST;
+	return -1;
+}
+
+static BOOL tls_session_cache_map_shared(rdpTlsSessionCache* cache, UINT32 capacity)
+{
+	int fd = tls_session_cache_open_shared(cache);
+	if (fd < 0)
+	{
+		WLog_ERR(TAG, "failed to open shared session cache %s: %s", cache->sharedName,
+		         strerror(errno));
+		return FALSE;
+	}
+
+	struct stat st = { 0 };
+	if ((fstat(fd, &st) != 0) || ((size_t)st.st_size != cache->tableSize))
+	{
+		WLog_ERR(TAG, "shared session cache %s exists with a different size", cache->sharedName);
+		close(fd);
+		return FALSE;
+	}
+
+	void* ptr = mmap(NULL, cache->tableSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (ptr == MAP_FAILED)
+	{
+		WLog_ERR(TAG, "failed to map shared session cache %s: %s", cache->sharedName,
+		         strerror(errno));
+		return FALSE;
+	}
+	cache->table = ptr;
+
+	if (cache->owner)
+	{
+		cache->table->ownerPid = (INT32)getpid();
+		return TRUE;
+	}
+
+	/* the creating process might still be initializing the table */
+	for (size_t x = 0; x < 100; x++)
+	{
+		if (__atomic_load_n(&cache->table->magic, __ATOMIC_ACQUIRE) == TLS_SESSION_CACHE_MAGIC)
+		{
+			if ((cache->table->version != TLS_SESSION_CACHE_VERSION) ||
+			    (cache->table->capacity != capacity))
+				break;
+			return TRUE;
+		}
+		Sleep(10);
+	}
+
+	WLog_ERR(TAG, "shared session cache %s is not compatible", cache->sharedName);
+	return FALSE;
+}
+#endif
+
+rdpTlsSessionCache* freerdp_tls_session_cache_new(size_t capacity, UINT32 lifetime,
+                                                  const char* sharedName)
+{
+	if ((capacity == 0) || (lifetime == 0))
+		return NULL;
+
+	/* round up to full sets */
+	capacity = MIN(capacity, TLS_SESSION_CACHE_MAX_ENTRIES);
+	capacity = (capacity + TLS_SESSION_CACHE_WAYS - 1) / TLS_SESSION_CACHE_WAYS;
+	capacity *= TLS_SESSION_CACHE_WAYS;
+
+	rdpTlsSessionCache* cache = calloc(1, sizeof(rdpTlsSessionCache));
+	if (!cache)
+		return NULL;
+
+	cache->tableSize =
+	    sizeof(TLS_SESSION_CACHE_TABLE) + capacity * sizeof(TLS_SESSION_CACHE_ENTRY);
+
+#if defined(TLS_SESSION_CACHE_SHARED_MEMORY)
+	if (sharedName)
+	{
+		cache->sharedName = _strdup(sharedName);
+		if (!cache->sharedName || !tls_session_cache_map_shared(cache, (UINT32)capacity))
+			goto fail;
+		if (!cache->owner)
+			return cache;
+	}
+#else
+	if (sharedName)
+		WLog_WARN(TAG, "shared session caches are not supported, using a private cache");
+	InitializeCriticalSection(&cache->lock);
+#endif
+
+	if (!cache->table)
+	{
+		cache->table = calloc(1, cache->tableSize);
+		if (!cache->table)
+			goto fail;
+	}
+
+	if (!tls_session_cache_init_table(cache, (UINT32)capacity, lifetime))
+		goto fail;
+
+	return cache;
+
+fail:
+	freerdp_tls_session_cache_free(cache);
+	return NULL;
+}
+
+void freerdp_tls_session_cache_free(rdpTlsSessionCache* cache)
+{
+	if (!cache)
+		return;
+
+	/* in a shared cache the counters cover all processes, the creator reports them */
+	const BOOL report = !cache->sharedName || cache->owner;
+	if (report && cache->table && (cache->table->stats.Handshakes > 0))
+	{
+		const TLS_SESSION_CACHE_STATS* stats = &cache->table->stats;
+		WLog_INFO(TAG, "%" PRIu64 " of %" PRIu64 " TLS handshakes resumed a session (%.1f%%)",
+		          stats->Resumed, stats->Handshakes,
+		          100.0 * (double)stats->Resumed / (double)stats->Handshakes);
+	}
+
+#if defined(TLS_SESSION_CACHE_SHARED_MEMORY)
+	if (cache->sharedName)
+	{
+		if (cache->table)
+			munmap(cache->table, cache->tableSize);
+		if (cache->owner)
+			shm_unlink(cache->sharedName);
+	}
+	else
+	{
+		if (cache->table && (cache->table->magic == TLS_SESSION_CACHE_MAGIC))
+			pthread_mutex_destroy(&cache->table->mutex);
+		free(cache->table);
+	}
+#else
+	DeleteCriticalSection(&cache->lock);
+	free(cache->table);
+#endif
+
+	free(cache->sharedName);
+	free(cache);
+}
+
+BOOL freerdp_tls_session_cache_get_stats(rdpTlsSessionCache* cache, TLS_SESSION_CACHE_STATS* stats)
+{
+	if (!cache || !stats)
+		return FALSE;
+
+	tls_session_cache_lock(cache);
+	*stats = cache->table->stats;
+	tls_session_cache_unlock(cache);
+	return TRUE;
+}
+
+BOOL freerdp_tls_session_cache_rotate_keys(rdpTlsSessionCache* cache)
+{
+	if (!cache)
+		return FALSE;
+
+	tls_session_cache_lock(cache);
+	const BOOL rc = tls_session_cache_rotate(cache, time(NULL));
+	tls_session_cache_unlock(cache);
+	return rc;
+}
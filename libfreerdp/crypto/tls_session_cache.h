@@ -0,0 +1,42 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Server side TLS session resumption cache
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CRYPTO_TLS_SESSION_CACHE_H
+#define FREERDP_LIB_CRYPTO_TLS_SESSION_CACHE_H
+
+#include <freerdp/api.h>
+#include <freerdp/crypto/tls_session_cache.h>
+
+#include <openssl/ssl.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	/** @brief install the session id and ticket callbacks, call before the first SSL_new */
+	FREERDP_LOCAL BOOL freerdp_tls_session_cache_attach(rdpTlsSessionCache* cache, SSL_CTX* ctx);
+
+	/** @brief count a completed handshake */
+	FREERDP_LOCAL void freerdp_tls_session_cache_handshake(rdpTlsSessionCache* cache,
+	                                                       BOOL resumed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_LIB_CRYPTO_TLS_SESSION_CACHE_H */
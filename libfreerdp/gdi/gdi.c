@@ -26,6 +26,7 @@
 
 #include <winpr/crt.h>
 #include <winpr/assert.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/api.h>
 #include <freerdp/log.h>
@@ -43,6 +44,7 @@
 #include "brush.h"
 #include "line.h"
 #include "gdi.h"
+#include "graphics.h"
 #include "../core/graphics.h"
 #include "../core/update.h"
 #include "../cache/cache.h"
@@ -1069,10 +1071,13 @@ static BOOL gdi_surface_bits(rdpContext* context, const SURFACE_BITS_COMMAND* cm
 	if (!intersect_rect(gdi, cmd, &cmdRect))
 		goto out;
 
+	FREERDP_METRICS_CODEC codec = FREERDP_METRICS_CODEC_COUNT;
+	const UINT64 start = winpr_GetTickCount64NS();
 	switch (cmd->bmp.codecID)
 	{
 		case RDP_CODEC_ID_REMOTEFX:
 		case RDP_CODEC_ID_IMAGE_REMOTEFX:
+			codec = FREERDP_METRICS_CODEC_REMOTEFX;
 			if (!rfx_process_message(context->codecs->rfx, cmd->bmp.bitmapData,
 			                         cmd->bmp.bitmapDataLength, cmdRect.left, cmdRect.top,
 			                         gdi->primary_buffer, gdi->dstFormat, gdi->stride, gdi->height,
@@ -1085,6 +1090,7 @@ static BOOL gdi_surface_bits(rdpContext* context, const SURFACE_BITS_COMMAND* cm
 			break;
 
 		case RDP_CODEC_ID_NSCODEC:
+			codec = FREERDP_METRICS_CODEC_NSCODEC;
 			format = gdi->dstFormat;
 
 			if (!nsc_process_message(
@@ -1101,6 +1107,7 @@ static BOOL gdi_surface_bits(rdpContext* context, const SURFACE_BITS_COMMAND* cm
 			break;
 
 		case RDP_CODEC_ID_NONE:
+			codec = FREERDP_METRICS_CODEC_UNCOMPRESSED;
 			format = gdi_get_pixel_format(cmd->bmp.bpp);
 			size = 1ull * cmd->bmp.width * cmd->bmp.height * FreeRDPGetBytesPerPixel(format);
 			if (size > cmd->bmp.bitmapDataLength)
@@ -1127,6 +1134,8 @@ static BOOL gdi_surface_bits(rdpContext* context, const SURFACE_BITS_COMMAND* cm
 			break;
 	}
 
+	freerdp_metrics_codec_time(context->metrics, codec, FALSE, winpr_GetTickCount64NS() - start);
+
 	if (!(rects = region16_rects(&region, &nbRects)))
 		goto out;
 
@@ -1409,6 +1418,7 @@ void gdi_free(freerdp* instance)
 	{
 		gdi_bitmap_free_ex(gdi->primary);
 		gdi_DeleteDC(gdi->hdc);
+		gdi_glyph_run_free(gdi->glyphRun);
 		free(gdi);
 	}
 
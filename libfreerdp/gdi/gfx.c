@@ -30,6 +30,10 @@
 #include <freerdp/utils/gfx.h>
 #include <math.h>
 
+#include <winpr/sysinfo.h>
+
+#include "gfx_scheduler.h"
+
 #define TAG FREERDP_TAG("gdi")
 
 static BOOL is_rect_valid(const RECTANGLE_16* rect, size_t width, size_t height)
@@ -105,6 +109,9 @@ static UINT gdi_ResetGraphics(RdpgfxClientContext* context,
 	settings = gdi->context->settings;
 	WINPR_ASSERT(settings);
 	EnterCriticalSection(&context->mux);
+	if (gdi_gfx_scheduler_join(gdi->gfxScheduler) != CHANNEL_RC_OK)
+		WLog_WARN(TAG, "pending surface commands failed before graphics reset");
+
 	DesktopWidth = resetGraphics->width;
 	DesktopHeight = resetGraphics->height;
 
@@ -323,8 +330,23 @@ static UINT gdi_EndFrame(RdpgfxClientContext* context, const RDPGFX_END_FRAME_PD
 
 	rdpGdi* gdi = (rdpGdi*)context->custom;
 	WINPR_ASSERT(gdi);
+
+	EnterCriticalSection(&context->mux);
+	const UINT rc = gdi_gfx_scheduler_join(gdi->gfxScheduler);
+	LeaveCriticalSection(&context->mux);
+
+	/* Present what was decoded either way. A failed surface command fails the frame, so
+	 * it is not acknowledged as decoded. The acknowledgement of the next frame covers it,
+	 * servers count the frames in flight from the last acknowledged frame id. */
 	const UINT status = gdi_call_update_surfaces(context);
 	gdi->inGfxFrame = FALSE;
+
+	if (rc != CHANNEL_RC_OK)
+	{
+		WLog_ERR(TAG, "frame %" PRIu32 ": decoding queued surface commands failed with %" PRIu32,
+		         endFrame->frameId, rc);
+		return rc;
+	}
 	return status;
 }
 
@@ -337,33 +359,343 @@ static UINT gdi_interFrameUpdate(rdpGdi* gdi, RdpgfxClientContext* context)
 	return status;
 }
 
+typedef struct
+{
+	rdpGdi* gdi;
+	RdpgfxClientContext* context;
+	gdiGfxSurface* surface;
+	RDPGFX_SURFACE_COMMAND cmd;
+	RDPGFX_AVC420_BITMAP_STREAM avc420;
+	RDPGFX_AVC444_BITMAP_STREAM avc444;
+	gdiGfxJobCallback decode;
+	BOOL queued;
+	BOOL skip;
+} gdiGfxSurfaceJob;
+
+static FREERDP_METRICS_CODEC gdi_metrics_codec(UINT32 codecId)
+{
+	switch (codecId)
+	{
+		case RDPGFX_CODECID_UNCOMPRESSED:
+			return FREERDP_METRICS_CODEC_UNCOMPRESSED;
+		case RDPGFX_CODECID_CAVIDEO:
+			return FREERDP_METRICS_CODEC_REMOTEFX;
+		case RDPGFX_CODECID_CLEARCODEC:
+			return FREERDP_METRICS_CODEC_CLEARCODEC;
+		case RDPGFX_CODECID_PLANAR:
+			return FREERDP_METRICS_CODEC_PLANAR;
+		case RDPGFX_CODECID_AVC420:
+			return FREERDP_METRICS_CODEC_AVC420;
+		case RDPGFX_CODECID_AVC444:
+		case RDPGFX_CODECID_AVC444v2:
+			return FREERDP_METRICS_CODEC_AVC444;
+		case RDPGFX_CODECID_ALPHA:
+			return FREERDP_METRICS_CODEC_ALPHA;
+		case RDPGFX_CODECID_CAPROGRESSIVE:
+			return FREERDP_METRICS_CODEC_PROGRESSIVE;
+		default:
+			return FREERDP_METRICS_CODEC_COUNT;
+	}
+}
+
+static void gdi_SurfaceCommand_Metrics(rdpGdi* gdi, UINT32 codecId, UINT64 start)
+{
+	WINPR_ASSERT(gdi);
+	WINPR_ASSERT(gdi->context);
+
+	freerdp_metrics_codec_time(gdi->context->metrics, gdi_metrics_codec(codecId), FALSE,
+	                           winpr_GetTickCount64NS() - start);
+}
+
+/* Decode wrapper that records the decode time, queued jobs run it on the scheduler threads */
+static UINT gdi_SurfaceCommand_Decode(void* arg)
+{
+	gdiGfxSurfaceJob* job = arg;
+	WINPR_ASSERT(job);
+	WINPR_ASSERT(job->decode);
+
+	const UINT64 start = winpr_GetTickCount64NS();
+	const UINT status = job->decode(job);
+	gdi_SurfaceCommand_Metrics(job->gdi, job->cmd.codecId, start);
+	return status;
+}
+
+static BOOL gdi_copy_h264_metablock(RDPGFX_H264_METABLOCK* dst, const RDPGFX_H264_METABLOCK* src)
+{
+	WINPR_ASSERT(dst);
+	WINPR_ASSERT(src);
+
+	dst->numRegionRects = src->numRegionRects;
+	dst->regionRects = NULL;
+	dst->quantQualityVals = NULL;
+
+	if (src->numRegionRects == 0)
+		return TRUE;
+
+	dst->regionRects = calloc(src->numRegionRects, sizeof(RECTANGLE_16));
+	dst->quantQualityVals = calloc(src->numRegionRects, sizeof(RDPGFX_H264_QUANT_QUALITY));
+	if (!dst->regionRects || !dst->quantQualityVals)
+		return FALSE;
+
+	memcpy(dst->regionRects, src->regionRects, src->numRegionRects * sizeof(RECTANGLE_16));
+	if (src->quantQualityVals)
+		memcpy(dst->quantQualityVals, src->quantQualityVals,
+		       src->numRegionRects * sizeof(RDPGFX_H264_QUANT_QUALITY));
+	return TRUE;
+}
+
+/* The AVC bitstreams point into the command data, relocate them to the copy */
+static BOOL gdi_copy_avc420_bitstream(RDPGFX_AVC420_BITMAP_STREAM* dst,
+                                      const RDPGFX_AVC420_BITMAP_STREAM* src,
+                                      const RDPGFX_SURFACE_COMMAND* cmd, BYTE* data)
+{
+	WINPR_ASSERT(dst);
+	WINPR_ASSERT(src);
+	WINPR_ASSERT(cmd);
+
+	dst->length = src->length;
+	dst->data = NULL;
+	if (!gdi_copy_h264_metablock(&dst->meta, &src->meta))
+		return FALSE;
+
+	if (src->length == 0)
+		return TRUE;
+
+	if ((src->data < cmd->data) || (src->data > cmd->data + cmd->length) ||
+	    (src->length > (size_t)(cmd->data + cmd->length - src->data)))
+		return FALSE;
+
+	dst->data = data + (src->data - cmd->data);
+	return TRUE;
+}
+
+static void gdi_free_avc420_bitstream(RDPGFX_AVC420_BITMAP_STREAM* bs)
+{
+	WINPR_ASSERT(bs);
+	free(bs->meta.regionRects);
+	free(bs->meta.quantQualityVals);
+}
+
+static void gdi_SurfaceJobFree(void* arg)
+{
+	gdiGfxSurfaceJob* job = arg;
+	if (!job)
+		return;
+
+	gdi_free_avc420_bitstream(&job->avc420);
+	gdi_free_avc420_bitstream(&job->avc444.bitstream[0]);
+	gdi_free_avc420_bitstream(&job->avc444.bitstream[1]);
+	free(job->cmd.data);
+	free(job);
+}
+
+/* Surface commands only reference the channel data, which is released once the
+ * callback returns. Queued jobs need their own copy. */
+static gdiGfxSurfaceJob* gdi_SurfaceJobClone(const gdiGfxSurfaceJob* src)
+{
+	WINPR_ASSERT(src);
+
+	const RDPGFX_SURFACE_COMMAND* cmd = &src->cmd;
+	gdiGfxSurfaceJob* job = calloc(1, sizeof(gdiGfxSurfaceJob));
+	if (!job)
+		return NULL;
+
+	job->gdi = src->gdi;
+	job->context = src->context;
+	job->surface = src->surface;
+	job->decode = src->decode;
+	job->cmd = *cmd;
+	job->cmd.data = NULL;
+	job->cmd.extra = NULL;
+	job->queued = TRUE;
+
+	if (cmd->length > 0)
+	{
+		job->cmd.data = malloc(cmd->length);
+		if (!job->cmd.data)
+			goto fail;
+		memcpy(job->cmd.data, cmd->data, cmd->length);
+	}
+
+	switch (cmd->codecId)
+	{
+		case RDPGFX_CODECID_AVC420:
+		{
+			const RDPGFX_AVC420_BITMAP_STREAM* bs = cmd->extra;
+			if (!bs || !gdi_copy_avc420_bitstream(&job->avc420, bs, cmd, job->cmd.data))
+				goto fail;
+			job->cmd.extra = &job->avc420;
+		}
+		break;
+
+		case RDPGFX_CODECID_AVC444:
+		case RDPGFX_CODECID_AVC444v2:
+		{
+			const RDPGFX_AVC444_BITMAP_STREAM* bs = cmd->extra;
+			if (!bs)
+				goto fail;
+			job->avc444.cbAvc420EncodedBitstream1 = bs->cbAvc420EncodedBitstream1;
+			job->avc444.LC = bs->LC;
+			for (size_t x = 0; x < ARRAYSIZE(bs->bitstream); x++)
+			{
+				if (!gdi_copy_avc420_bitstream(&job->avc444.bitstream[x], &bs->bitstream[x], cmd,
+				                               job->cmd.data))
+					goto fail;
+			}
+			job->cmd.extra = &job->avc444;
+		}
+		break;
+
+		default:
+			break;
+	}
+
+	return job;
+
+fail:
+	gdi_SurfaceJobFree(job);
+	return NULL;
+}
+
+static void gdi_SurfaceJobBounds(const RDPGFX_SURFACE_COMMAND* cmd, RECTANGLE_16* bounds)
+{
+	WINPR_ASSERT(cmd);
+	WINPR_ASSERT(bounds);
+
+	bounds->left = (UINT16)MIN(UINT16_MAX, cmd->left);
+	bounds->top = (UINT16)MIN(UINT16_MAX, cmd->top);
+	bounds->right = (UINT16)MIN(UINT16_MAX, cmd->right);
+	bounds->bottom = (UINT16)MIN(UINT16_MAX, cmd->bottom);
+}
+
+static void gdi_SurfaceJobBoundsMeta(const RDPGFX_H264_METABLOCK* meta, RECTANGLE_16* bounds)
+{
+	WINPR_ASSERT(meta);
+	WINPR_ASSERT(bounds);
+
+	for (UINT32 x = 0; x < meta->numRegionRects; x++)
+	{
+		const RECTANGLE_16* rect = &meta->regionRects[x];
+		bounds->left = MIN(bounds->left, rect->left);
+		bounds->top = MIN(bounds->top, rect->top);
+		bounds->right = MAX(bounds->right, rect->right);
+		bounds->bottom = MAX(bounds->bottom, rect->bottom);
+	}
+}
+
 /**
  * Function description
  *
+ * Decode a surface command on the graphics pipeline scheduler. Inside a frame
+ * the command is queued and decoded concurrently with commands it does not
+ * depend on, otherwise it is processed immediately.
+ *
  * @return 0 on success, otherwise a Win32 error code
  */
-static UINT gdi_SurfaceCommand_Uncompressed(rdpGdi* gdi, RdpgfxClientContext* context,
-                                            const RDPGFX_SURFACE_COMMAND* cmd)
+static UINT gdi_SurfaceCommand_Schedule(rdpGdi* gdi, RdpgfxClientContext* context,
+                                        const RDPGFX_SURFACE_COMMAND* cmd, BOOL exclusive,
+                                        gdiGfxJobCallback decode, gdiGfxJobCallback complete)
 {
-	UINT status = CHANNEL_RC_OK;
-	gdiGfxSurface* surface = NULL;
-	RECTANGLE_16 invalidRect;
-	DWORD bpp = 0;
-	size_t size = 0;
+	RECTANGLE_16 bounds = { 0 };
+	gdiGfxSurfaceJob job = { 0 };
 	WINPR_ASSERT(gdi);
 	WINPR_ASSERT(context);
 	WINPR_ASSERT(cmd);
 
 	WINPR_ASSERT(context->GetSurfaceData);
-	surface =
+	job.gdi = gdi;
+	job.context = context;
+	job.cmd = *cmd;
+	job.decode = decode;
+	job.surface =
 	    (gdiGfxSurface*)context->GetSurfaceData(context, (UINT16)MIN(UINT16_MAX, cmd->surfaceId));
 
-	if (!surface)
+	if (!job.surface)
 	{
 		WLog_ERR(TAG, "unable to retrieve surfaceData for surfaceId=%" PRIu32 "", cmd->surfaceId);
 		return ERROR_NOT_FOUND;
 	}
 
+	if (!gdi->inGfxFrame || !gdi_gfx_scheduler_is_threaded(gdi->gfxScheduler))
+	{
+		UINT status = gdi_SurfaceCommand_Decode(&job);
+		if (status == CHANNEL_RC_OK)
+			status = complete(&job);
+		return status;
+	}
+
+	gdi_SurfaceJobBounds(cmd, &bounds);
+	switch (cmd->codecId)
+	{
+		case RDPGFX_CODECID_AVC420:
+		{
+			const RDPGFX_AVC420_BITMAP_STREAM* bs = cmd->extra;
+			if (bs)
+				gdi_SurfaceJobBoundsMeta(&bs->meta, &bounds);
+		}
+		break;
+		case RDPGFX_CODECID_AVC444:
+		case RDPGFX_CODECID_AVC444v2:
+		{
+			const RDPGFX_AVC444_BITMAP_STREAM* bs = cmd->extra;
+			if (bs)
+			{
+				gdi_SurfaceJobBoundsMeta(&bs->bitstream[0].meta, &bounds);
+				gdi_SurfaceJobBoundsMeta(&bs->bitstream[1].meta, &bounds);
+			}
+		}
+		break;
+		default:
+			break;
+	}
+
+	gdiGfxSurfaceJob* queued = gdi_SurfaceJobClone(&job);
+	if (!queued)
+	{
+		UINT status = CHANNEL_RC_OK;
+		gdi_gfx_scheduler_wait(gdi->gfxScheduler, job.surface->surfaceId, &bounds, exclusive);
+		status = gdi_SurfaceCommand_Decode(&job);
+		if (status == CHANNEL_RC_OK)
+			status = complete(&job);
+		return status;
+	}
+
+	return gdi_gfx_scheduler_submit(gdi->gfxScheduler, job.surface->surfaceId, &bounds, exclusive,
+	                                gdi_SurfaceCommand_Decode, complete, gdi_SurfaceJobFree,
+	                                queued);
+}
+
+static UINT gdi_SurfaceCommand_CompleteRect(void* arg)
+{
+	gdiGfxSurfaceJob* job = arg;
+	RECTANGLE_16 invalidRect = { 0 };
+	WINPR_ASSERT(job);
+
+	gdiGfxSurface* surface = job->surface;
+	WINPR_ASSERT(surface);
+
+	gdi_SurfaceJobBounds(&job->cmd, &invalidRect);
+	region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion), &invalidRect);
+	const UINT status = IFCALLRESULT(CHANNEL_RC_OK, job->context->UpdateSurfaceArea, job->context,
+	                                 surface->surfaceId, 1, &invalidRect);
+
+	if (status != CHANNEL_RC_OK)
+		return status;
+
+	return gdi_interFrameUpdate(job->gdi, job->context);
+}
+
+static UINT gdi_SurfaceCommand_DecodeUncompressed(void* arg)
+{
+	gdiGfxSurfaceJob* job = arg;
+	DWORD bpp = 0;
+	size_t size = 0;
+	WINPR_ASSERT(job);
+
+	const RDPGFX_SURFACE_COMMAND* cmd = &job->cmd;
+	gdiGfxSurface* surface = job->surface;
+	WINPR_ASSERT(surface);
+
 	if (!is_within_surface(surface, cmd))
 		return ERROR_INVALID_DATA;
 
@@ -380,21 +712,20 @@ static UINT gdi_SurfaceCommand_Uncompressed(rdpGdi* gdi, RdpgfxClientContext* co
 	                                   0, 0, NULL, FREERDP_FLIP_NONE))
 		return ERROR_INTERNAL_ERROR;
 
-	invalidRect.left = (UINT16)MIN(UINT16_MAX, cmd->left);
-	invalidRect.top = (UINT16)MIN(UINT16_MAX, cmd->top);
-	invalidRect.right = (UINT16)MIN(UINT16_MAX, cmd->right);
-	invalidRect.bottom = (UINT16)MIN(UINT16_MAX, cmd->bottom);
-	region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion), &invalidRect);
-	status = IFCALLRESULT(CHANNEL_RC_OK, context->UpdateSurfaceArea, context, surface->surfaceId, 1,
-	                      &invalidRect);
-
-	if (status != CHANNEL_RC_OK)
-		goto fail;
-
-	status = gdi_interFrameUpdate(gdi, context);
+	return CHANNEL_RC_OK;
+}
 
-fail:
-	return status;
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT gdi_SurfaceCommand_Uncompressed(rdpGdi* gdi, RdpgfxClientContext* context,
+                                            const RDPGFX_SURFACE_COMMAND* cmd)
+{
+	return gdi_SurfaceCommand_Schedule(gdi, context, cmd, FALSE,
+	                                   gdi_SurfaceCommand_DecodeUncompressed,
+	                                   gdi_SurfaceCommand_CompleteRect);
 }
 
 /**
@@ -443,8 +774,7 @@ static UINT gdi_SurfaceCommand_RemoteFX(rdpGdi* gdi, RdpgfxClientContext* contex
 	if (status != CHANNEL_RC_OK)
 		goto fail;
 
-	for (UINT32 x = 0; x < nrRects; x++)
-		region16_union_rect(&surface->invalidRegion, &surface->invalidRegion, &rects[x]);
+	region16_union_rects(&surface->invalidRegion, &surface->invalidRegion, rects, nrRects);
 
 	status = gdi_interFrameUpdate(gdi, context);
 
@@ -507,56 +837,36 @@ fail:
 	return status;
 }
 
-/**
- * Function description
- *
- * @return 0 on success, otherwise a Win32 error code
- */
-static UINT gdi_SurfaceCommand_Planar(rdpGdi* gdi, RdpgfxClientContext* context,
-                                      const RDPGFX_SURFACE_COMMAND* cmd)
+static UINT gdi_SurfaceCommand_DecodePlanar(void* arg)
 {
+	gdiGfxSurfaceJob* job = arg;
+	BITMAP_PLANAR_CONTEXT* planar = NULL;
 	UINT status = CHANNEL_RC_OK;
-	BYTE* DstData = NULL;
-	gdiGfxSurface* surface = NULL;
-	RECTANGLE_16 invalidRect;
-	WINPR_ASSERT(gdi);
-	WINPR_ASSERT(context);
-	WINPR_ASSERT(cmd);
-
-	WINPR_ASSERT(context->GetSurfaceData);
-	surface =
-	    (gdiGfxSurface*)context->GetSurfaceData(context, (UINT16)MIN(UINT16_MAX, cmd->surfaceId));
-
-	if (!surface)
-	{
-		WLog_ERR(TAG, "unable to retrieve surfaceData for surfaceId=%" PRIu32 "", cmd->surfaceId);
-		return ERROR_NOT_FOUND;
-	}
+	WINPR_ASSERT(job);
 
-	DstData = surface->data;
+	const RDPGFX_SURFACE_COMMAND* cmd = &job->cmd;
+	gdiGfxSurface* surface = job->surface;
+	WINPR_ASSERT(surface);
 
 	if (!is_within_surface(surface, cmd))
 		return ERROR_INVALID_DATA;
 
-	if (!planar_decompress(surface->codecs->planar, cmd->data, cmd->length, cmd->width, cmd->height,
-	                       DstData, surface->format, surface->scanline, cmd->left, cmd->top,
-	                       cmd->width, cmd->height, FALSE))
-		return ERROR_INTERNAL_ERROR;
+	/* The shared planar context is not safe for concurrent use */
+	if (job->queued)
+		planar = gdi_gfx_scheduler_acquire_planar(job->gdi->gfxScheduler, cmd->width, cmd->height);
+	else
+		planar = surface->codecs->planar;
 
-	invalidRect.left = (UINT16)MIN(UINT16_MAX, cmd->left);
-	invalidRect.top = (UINT16)MIN(UINT16_MAX, cmd->top);
-	invalidRect.right = (UINT16)MIN(UINT16_MAX, cmd->right);
-	invalidRect.bottom = (UINT16)MIN(UINT16_MAX, cmd->bottom);
-	region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion), &invalidRect);
-	status = IFCALLRESULT(CHANNEL_RC_OK, context->UpdateSurfaceArea, context, surface->surfaceId, 1,
-	                      &invalidRect);
+	if (!planar)
+		return ERROR_NOT_ENOUGH_MEMORY;
 
-	if (status != CHANNEL_RC_OK)
-		goto fail;
-
-	status = gdi_interFrameUpdate(gdi, context);
+	if (!planar_decompress(planar, cmd->data, cmd->length, cmd->width, cmd->height, surface->data,
+	                       surface->format, surface->scanline, cmd->left, cmd->top, cmd->width,
+	                       cmd->height, FALSE))
+		status = ERROR_INTERNAL_ERROR;
 
-fail:
+	if (job->queued)
+		gdi_gfx_scheduler_release_planar(job->gdi->gfxScheduler, planar);
 	return status;
 }
 
@@ -565,106 +875,140 @@ fail:
  *
  * @return 0 on success, otherwise a Win32 error code
  */
-static UINT gdi_SurfaceCommand_AVC420(rdpGdi* gdi, RdpgfxClientContext* context,
+static UINT gdi_SurfaceCommand_Planar(rdpGdi* gdi, RdpgfxClientContext* context,
                                       const RDPGFX_SURFACE_COMMAND* cmd)
 {
+	return gdi_SurfaceCommand_Schedule(gdi, context, cmd, FALSE, gdi_SurfaceCommand_DecodePlanar,
+	                                   gdi_SurfaceCommand_CompleteRect);
+}
+
 #ifdef WITH_GFX_H264
-	INT32 rc = 0;
-	UINT status = CHANNEL_RC_OK;
-	gdiGfxSurface* surface = NULL;
-	RDPGFX_H264_METABLOCK* meta = NULL;
-	RDPGFX_AVC420_BITMAP_STREAM* bs = NULL;
-	WINPR_ASSERT(gdi);
-	WINPR_ASSERT(context);
-	WINPR_ASSERT(cmd);
+static UINT gdi_SurfaceCommand_CompleteMeta(gdiGfxSurfaceJob* job,
+                                            const RDPGFX_H264_METABLOCK* meta)
+{
+	WINPR_ASSERT(job);
+	WINPR_ASSERT(meta);
 
-	WINPR_ASSERT(context->GetSurfaceData);
-	surface =
-	    (gdiGfxSurface*)context->GetSurfaceData(context, (UINT16)MIN(UINT16_MAX, cmd->surfaceId));
+	gdiGfxSurface* surface = job->surface;
+	WINPR_ASSERT(surface);
 
-	if (!surface)
+	if (!region16_union_rects(&surface->invalidRegion, &surface->invalidRegion,
+	                          meta->regionRects, meta->numRegionRects))
+		return ERROR_NOT_ENOUGH_MEMORY;
+
+	return IFCALLRESULT(CHANNEL_RC_OK, job->context->UpdateSurfaceArea, job->context,
+	                    surface->surfaceId, meta->numRegionRects, meta->regionRects);
+}
+
+static UINT gdi_SurfaceCommand_DecodeAVC420(void* arg)
+{
+	gdiGfxSurfaceJob* job = arg;
+	WINPR_ASSERT(job);
+
+	const RDPGFX_SURFACE_COMMAND* cmd = &job->cmd;
+	gdiGfxSurface* surface = job->surface;
+	WINPR_ASSERT(surface);
+	WINPR_ASSERT(surface->h264);
+
+	RDPGFX_AVC420_BITMAP_STREAM* bs = (RDPGFX_AVC420_BITMAP_STREAM*)cmd->extra;
+	if (!bs)
+		return ERROR_INTERNAL_ERROR;
+
+	RDPGFX_H264_METABLOCK* meta = &(bs->meta);
+	const INT32 rc = avc420_decompress(surface->h264, bs->data, bs->length, surface->data,
+	                                   surface->format, surface->scanline, surface->width,
+	                                   surface->height, meta->regionRects, meta->numRegionRects);
+
+	if (rc < 0)
 	{
-		WLog_ERR(TAG, "unable to retrieve surfaceData for surfaceId=%" PRIu32 "", cmd->surfaceId);
-		return ERROR_NOT_FOUND;
+		WLog_WARN(TAG, "avc420_decompress failure: %" PRId32 ", ignoring update.", rc);
+		job->skip = TRUE;
 	}
 
-	if (!surface->h264)
-	{
-		surface->h264 = h264_context_new(FALSE);
+	return CHANNEL_RC_OK;
+}
 
-		if (!surface->h264)
-		{
-			WLog_ERR(TAG, "unable to create h264 context");
-			return ERROR_NOT_ENOUGH_MEMORY;
-		}
+static UINT gdi_SurfaceCommand_CompleteAVC420(void* arg)
+{
+	gdiGfxSurfaceJob* job = arg;
+	WINPR_ASSERT(job);
 
-		if (!h264_context_reset(surface->h264, surface->width, surface->height))
-			return ERROR_INTERNAL_ERROR;
-	}
+	if (job->skip)
+		return CHANNEL_RC_OK;
 
-	if (!surface->h264)
-		return ERROR_NOT_SUPPORTED;
+	const RDPGFX_AVC420_BITMAP_STREAM* bs = job->cmd.extra;
+	WINPR_ASSERT(bs);
+
+	const UINT status = gdi_SurfaceCommand_CompleteMeta(job, &bs->meta);
+	if (status != CHANNEL_RC_OK)
+		return status;
+
+	return gdi_interFrameUpdate(job->gdi, job->context);
+}
 
-	bs = (RDPGFX_AVC420_BITMAP_STREAM*)cmd->extra;
+static UINT gdi_SurfaceCommand_DecodeAVC444(void* arg)
+{
+	gdiGfxSurfaceJob* job = arg;
+	WINPR_ASSERT(job);
+
+	const RDPGFX_SURFACE_COMMAND* cmd = &job->cmd;
+	gdiGfxSurface* surface = job->surface;
+	WINPR_ASSERT(surface);
+	WINPR_ASSERT(surface->h264);
 
+	RDPGFX_AVC444_BITMAP_STREAM* bs = (RDPGFX_AVC444_BITMAP_STREAM*)cmd->extra;
 	if (!bs)
 		return ERROR_INTERNAL_ERROR;
 
-	meta = &(bs->meta);
-	rc = avc420_decompress(surface->h264, bs->data, bs->length, surface->data, surface->format,
-	                       surface->scanline, surface->width, surface->height, meta->regionRects,
-	                       meta->numRegionRects);
+	RDPGFX_AVC420_BITMAP_STREAM* avc1 = &bs->bitstream[0];
+	RDPGFX_AVC420_BITMAP_STREAM* avc2 = &bs->bitstream[1];
+	RDPGFX_H264_METABLOCK* meta1 = &avc1->meta;
+	RDPGFX_H264_METABLOCK* meta2 = &avc2->meta;
+	const INT32 rc =
+	    avc444_decompress(surface->h264, bs->LC, meta1->regionRects, meta1->numRegionRects,
+	                      avc1->data, avc1->length, meta2->regionRects, meta2->numRegionRects,
+	                      avc2->data, avc2->length, surface->data, surface->format,
+	                      surface->scanline, surface->width, surface->height, cmd->codecId);
 
 	if (rc < 0)
 	{
-		WLog_WARN(TAG, "avc420_decompress failure: %" PRId32 ", ignoring update.", rc);
-		return CHANNEL_RC_OK;
+		WLog_WARN(TAG, "avc444_decompress failure: %" PRId32 ", ignoring update.", rc);
+		job->skip = TRUE;
 	}
 
-	for (UINT32 i = 0; i < meta->numRegionRects; i++)
-	{
-		region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion),
-		                    (RECTANGLE_16*)&(meta->regionRects[i]));
-	}
+	return CHANNEL_RC_OK;
+}
 
-	status = IFCALLRESULT(CHANNEL_RC_OK, context->UpdateSurfaceArea, context, surface->surfaceId,
-	                      meta->numRegionRects, meta->regionRects);
+static UINT gdi_SurfaceCommand_CompleteAVC444(void* arg)
+{
+	gdiGfxSurfaceJob* job = arg;
+	WINPR_ASSERT(job);
+
+	if (job->skip)
+		return CHANNEL_RC_OK;
+
+	const RDPGFX_AVC444_BITMAP_STREAM* bs = job->cmd.extra;
+	WINPR_ASSERT(bs);
 
+	UINT status = gdi_SurfaceCommand_CompleteMeta(job, &bs->bitstream[0].meta);
 	if (status != CHANNEL_RC_OK)
-		goto fail;
+		return status;
 
-	status = gdi_interFrameUpdate(gdi, context);
+	status = gdi_SurfaceCommand_CompleteMeta(job, &bs->bitstream[1].meta);
+	if (status != CHANNEL_RC_OK)
+		return status;
 
-fail:
-	return status;
-#else
-	return ERROR_NOT_SUPPORTED;
-#endif
+	return gdi_interFrameUpdate(job->gdi, job->context);
 }
 
-/**
- * Function description
- *
- * @return 0 on success, otherwise a Win32 error code
- */
-static UINT gdi_SurfaceCommand_AVC444(rdpGdi* gdi, RdpgfxClientContext* context,
-                                      const RDPGFX_SURFACE_COMMAND* cmd)
+static UINT gdi_SurfaceCommand_PrepareH264(RdpgfxClientContext* context,
+                                           const RDPGFX_SURFACE_COMMAND* cmd)
 {
-#ifdef WITH_GFX_H264
-	INT32 rc = 0;
-	UINT status = CHANNEL_RC_OK;
-	gdiGfxSurface* surface = NULL;
-	RDPGFX_AVC444_BITMAP_STREAM* bs = NULL;
-	RDPGFX_AVC420_BITMAP_STREAM* avc1 = NULL;
-	RDPGFX_H264_METABLOCK* meta1 = NULL;
-	RDPGFX_AVC420_BITMAP_STREAM* avc2 = NULL;
-	RDPGFX_H264_METABLOCK* meta2 = NULL;
-	WINPR_ASSERT(gdi);
 	WINPR_ASSERT(context);
 	WINPR_ASSERT(cmd);
 
 	WINPR_ASSERT(context->GetSurfaceData);
-	surface =
+	gdiGfxSurface* surface =
 	    (gdiGfxSurface*)context->GetSurfaceData(context, (UINT16)MIN(UINT16_MAX, cmd->surfaceId));
 
 	if (!surface)
@@ -690,54 +1034,49 @@ static UINT gdi_SurfaceCommand_AVC444(rdpGdi* gdi, RdpgfxClientContext* context,
 	if (!surface->h264)
 		return ERROR_NOT_SUPPORTED;
 
-	bs = (RDPGFX_AVC444_BITMAP_STREAM*)cmd->extra;
-
-	if (!bs)
+	if (!cmd->extra)
 		return ERROR_INTERNAL_ERROR;
 
-	avc1 = &bs->bitstream[0];
-	avc2 = &bs->bitstream[1];
-	meta1 = &avc1->meta;
-	meta2 = &avc2->meta;
-	rc = avc444_decompress(surface->h264, bs->LC, meta1->regionRects, meta1->numRegionRects,
-	                       avc1->data, avc1->length, meta2->regionRects, meta2->numRegionRects,
-	                       avc2->data, avc2->length, surface->data, surface->format,
-	                       surface->scanline, surface->width, surface->height, cmd->codecId);
-
-	if (rc < 0)
-	{
-		WLog_WARN(TAG, "avc444_decompress failure: %" PRIu32 ", ignoring update.", status);
-		return CHANNEL_RC_OK;
-	}
-
-	for (UINT32 i = 0; i < meta1->numRegionRects; i++)
-	{
-		region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion),
-		                    &(meta1->regionRects[i]));
-	}
-
-	status = IFCALLRESULT(CHANNEL_RC_OK, context->UpdateSurfaceArea, context, surface->surfaceId,
-	                      meta1->numRegionRects, meta1->regionRects);
+	return CHANNEL_RC_OK;
+}
+#endif
 
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT gdi_SurfaceCommand_AVC420(rdpGdi* gdi, RdpgfxClientContext* context,
+                                      const RDPGFX_SURFACE_COMMAND* cmd)
+{
+#ifdef WITH_GFX_H264
+	const UINT status = gdi_SurfaceCommand_PrepareH264(context, cmd);
 	if (status != CHANNEL_RC_OK)
-		goto fail;
+		return status;
 
-	for (UINT32 i = 0; i < meta2->numRegionRects; i++)
-	{
-		region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion),
-		                    &(meta2->regionRects[i]));
-	}
-
-	status = IFCALLRESULT(CHANNEL_RC_OK, context->UpdateSurfaceArea, context, surface->surfaceId,
-	                      meta2->numRegionRects, meta2->regionRects);
+	/* The decoder state is per surface, so commands on the same surface stay ordered */
+	return gdi_SurfaceCommand_Schedule(gdi, context, cmd, TRUE, gdi_SurfaceCommand_DecodeAVC420,
+	                                   gdi_SurfaceCommand_CompleteAVC420);
+#else
+	return ERROR_NOT_SUPPORTED;
+#endif
+}
 
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT gdi_SurfaceCommand_AVC444(rdpGdi* gdi, RdpgfxClientContext* context,
+                                      const RDPGFX_SURFACE_COMMAND* cmd)
+{
+#ifdef WITH_GFX_H264
+	const UINT status = gdi_SurfaceCommand_PrepareH264(context, cmd);
 	if (status != CHANNEL_RC_OK)
-		goto fail;
+		return status;
 
-	status = gdi_interFrameUpdate(gdi, context);
-
-fail:
-	return status;
+	return gdi_SurfaceCommand_Schedule(gdi, context, cmd, TRUE, gdi_SurfaceCommand_DecodeAVC444,
+	                                   gdi_SurfaceCommand_CompleteAVC444);
 #else
 	return ERROR_NOT_SUPPORTED;
 #endif
@@ -1010,8 +1349,7 @@ static UINT gdi_SurfaceCommand_Progressive(rdpGdi* gdi, RdpgfxClientContext* con
 	if (status != CHANNEL_RC_OK)
 		goto fail;
 
-	for (UINT32 x = 0; x < nrRects; x++)
-		region16_union_rect(&surface->invalidRegion, &surface->invalidRegion, &rects[x]);
+	region16_union_rects(&surface->invalidRegion, &surface->invalidRegion, rects, nrRects);
 
 	region16_uninit(&invalidRegion);
 
@@ -1050,6 +1388,26 @@ static UINT gdi_SurfaceCommand(RdpgfxClientContext* context, const RDPGFX_SURFAC
 	dump_cmd(cmd, gdi->frameId);
 #endif
 
+	/* Only uncompressed, planar and AVC commands are decoded on the scheduler,
+	 * the other codecs keep state shared between surfaces and run in order. */
+	BOOL scheduled = FALSE;
+	switch (cmd->codecId)
+	{
+		case RDPGFX_CODECID_UNCOMPRESSED:
+		case RDPGFX_CODECID_PLANAR:
+		case RDPGFX_CODECID_AVC420:
+		case RDPGFX_CODECID_AVC444:
+		case RDPGFX_CODECID_AVC444v2:
+			scheduled = TRUE;
+			break;
+
+		default:
+			gdi_gfx_scheduler_wait(gdi->gfxScheduler, (UINT16)MIN(UINT16_MAX, cmd->surfaceId),
+			                       NULL, FALSE);
+			break;
+	}
+
+	const UINT64 start = winpr_GetTickCount64NS();
 	switch (cmd->codecId)
 	{
 		case RDPGFX_CODECID_UNCOMPRESSED:
@@ -1096,6 +1454,10 @@ static UINT gdi_SurfaceCommand(RdpgfxClientContext* context, const RDPGFX_SURFAC
 			break;
 	}
 
+	/* scheduled codecs record their decode time in gdi_SurfaceCommand_Decode */
+	if (!scheduled)
+		gdi_SurfaceCommand_Metrics(gdi, cmd->codecId, start);
+
 	LeaveCriticalSection(&context->mux);
 	return status;
 }
@@ -1204,8 +1566,13 @@ static UINT gdi_DeleteSurface(RdpgfxClientContext* context,
 	UINT res = ERROR_INTERNAL_ERROR;
 	rdpCodecs* codecs = NULL;
 	gdiGfxSurface* surface = NULL;
+	rdpGdi* gdi = (rdpGdi*)context->custom;
 	EnterCriticalSection(&context->mux);
 
+	/* Completion of queued commands references the surface, flush them all */
+	if (gdi_gfx_scheduler_join(gdi->gfxScheduler) != CHANNEL_RC_OK)
+		WLog_WARN(TAG, "pending surface commands failed before surface deletion");
+
 	WINPR_ASSERT(context->GetSurfaceData);
 	surface = (gdiGfxSurface*)context->GetSurfaceData(context, deleteSurface->surfaceId);
 
@@ -1294,6 +1661,8 @@ static UINT gdi_SolidFill(RdpgfxClientContext* context, const RDPGFX_SOLID_FILL_
 		if (!intersect_rect(rect, surface, &invalidRect))
 			goto fail;
 
+		gdi_gfx_scheduler_wait(gdi->gfxScheduler, surface->surfaceId, &invalidRect, FALSE);
+
 		const UINT32 nWidth = invalidRect.right - invalidRect.left;
 		const UINT32 nHeight = invalidRect.bottom - invalidRect.top;
 
@@ -1357,6 +1726,7 @@ static UINT gdi_SurfaceToSurface(RdpgfxClientContext* context,
 
 	nWidth = rectSrc->right - rectSrc->left;
 	nHeight = rectSrc->bottom - rectSrc->top;
+	gdi_gfx_scheduler_wait(gdi->gfxScheduler, surfaceSrc->surfaceId, rectSrc, FALSE);
 
 	for (UINT16 index = 0; index < surfaceToSurface->destPtsCount; index++)
 	{
@@ -1367,6 +1737,8 @@ static UINT gdi_SurfaceToSurface(RdpgfxClientContext* context,
 		if (!is_rect_valid(&rect, surfaceDst->width, surfaceDst->height))
 			goto fail;
 
+		gdi_gfx_scheduler_wait(gdi->gfxScheduler, surfaceDst->surfaceId, &rect, FALSE);
+
 		if (surfaceDst == surfaceSrc)
 		{
 			if (!freerdp_image_copy_overlap(
@@ -1447,6 +1819,7 @@ static UINT gdi_SurfaceToCache(RdpgfxClientContext* context,
 	gdiGfxSurface* surface = NULL;
 	gdiGfxCacheEntry* cacheEntry = NULL;
 	UINT rc = ERROR_INTERNAL_ERROR;
+	rdpGdi* gdi = (rdpGdi*)context->custom;
 	EnterCriticalSection(&context->mux);
 	rect = &(surfaceToCache->rectSrc);
 
@@ -1459,6 +1832,8 @@ static UINT gdi_SurfaceToCache(RdpgfxClientContext* context,
 	if (!is_rect_valid(rect, surface->width, surface->height))
 		goto fail;
 
+	gdi_gfx_scheduler_wait(gdi->gfxScheduler, surface->surfaceId, rect, FALSE);
+
 	cacheEntry = gdi_GfxCacheEntryNew(surfaceToCache->cacheKey, (UINT32)(rect->right - rect->left),
 	                                  (UINT32)(rect->bottom - rect->top), surface->format);
 
@@ -1525,6 +1900,8 @@ static UINT gdi_CacheToSurface(RdpgfxClientContext* context,
 		if (!is_rect_valid(&rect, surface->width, surface->height))
 			goto fail;
 
+		gdi_gfx_scheduler_wait(gdi->gfxScheduler, surface->surfaceId, &rect, FALSE);
+
 		if (!freerdp_image_copy_no_overlap(surface->data, surface->format, surface->scanline,
 		                                   destPt->x, destPt->y, cacheEntry->width,
 		                                   cacheEntry->height, cacheEntry->data, cacheEntry->format,
@@ -1901,6 +2278,10 @@ BOOL gdi_graphics_pipeline_init_ex(rdpGdi* gdi, RdpgfxClientContext* gfx,
 			return FALSE;
 		if (!freerdp_client_codecs_prepare(gfx->codecs, FREERDP_CODEC_ALL, w, h))
 			return FALSE;
+
+		gdi->gfxScheduler = gdi_gfx_scheduler_new(flags);
+		if (!gdi->gfxScheduler)
+			return FALSE;
 	}
 	InitializeCriticalSection(&gfx->mux);
 	PROFILER_CREATE(gfx->SurfaceProfiler, "GFX-PROFILER")
@@ -1925,7 +2306,11 @@ BOOL gdi_graphics_pipeline_init_ex(rdpGdi* gdi, RdpgfxClientContext* gfx,
 void gdi_graphics_pipeline_uninit(rdpGdi* gdi, RdpgfxClientContext* gfx)
 {
 	if (gdi)
+	{
+		gdi_gfx_scheduler_free(gdi->gfxScheduler);
+		gdi->gfxScheduler = NULL;
 		gdi->gfx = NULL;
+	}
 
 	if (!gfx)
 		return;
@@ -0,0 +1,457 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * GDI Graphics Pipeline Frame Scheduler
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/assert.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+#include <winpr/pool.h>
+#include <winpr/wtsapi.h>
+
+#include <freerdp/log.h>
+#include <freerdp/settings.h>
+#include <freerdp/codec/region.h>
+
+#include "gfx_scheduler.h"
+
+#define TAG FREERDP_TAG("gdi.gfx.scheduler")
+
+typedef struct s_gdi_gfx_job gdiGfxJob;
+
+struct s_gdi_gfx_job
+{
+	gdiGfxScheduler* scheduler;
+	UINT16 surfaceId;
+	RECTANGLE_16 bounds;
+	BOOL exclusive;
+	gdiGfxJobCallback decode;
+	gdiGfxJobCallback complete;
+	gdiGfxJobFree fkt;
+	void* arg;
+
+	PTP_WORK work;
+	UINT status;
+	BOOL done;
+	size_t pending;
+	gdiGfxJob** dependents;
+	size_t dependentCount;
+	size_t dependentSize;
+};
+
+struct gdi_gfx_scheduler
+{
+	BOOL useThreads;
+	PTP_POOL threadPool;
+	TP_CALLBACK_ENVIRON ThreadPoolEnv;
+
+	CRITICAL_SECTION lock;
+	HANDLE progress;
+
+	gdiGfxJob** jobs;
+	size_t jobCount;
+	size_t jobSize;
+	size_t finished;
+
+	BITMAP_PLANAR_CONTEXT** planar;
+	size_t planarCount;
+	size_t planarSize;
+};
+
+static BOOL gdi_gfx_job_conflicts(const gdiGfxJob* job, UINT16 surfaceId,
+                                  const RECTANGLE_16* rect, BOOL exclusive)
+{
+	WINPR_ASSERT(job);
+
+	if (job->surfaceId != surfaceId)
+		return FALSE;
+
+	if (!rect)
+		return TRUE;
+
+	if (exclusive && job->exclusive)
+		return TRUE;
+
+	return rectangles_intersects(&job->bounds, rect);
+}
+
+static BOOL gdi_gfx_job_add_dependent(gdiGfxJob* job, gdiGfxJob* dependent)
+{
+	WINPR_ASSERT(job);
+	WINPR_ASSERT(dependent);
+
+	if (job->dependentCount >= job->dependentSize)
+	{
+		const size_t size = (job->dependentSize == 0) ? 4 : job->dependentSize * 2;
+		gdiGfxJob** tmp = realloc(job->dependents, size * sizeof(gdiGfxJob*));
+		if (!tmp)
+			return FALSE;
+		job->dependents = tmp;
+		job->dependentSize = size;
+	}
+
+	job->dependents[job->dependentCount++] = dependent;
+	dependent->pending++;
+	return TRUE;
+}
+
+static void gdi_gfx_job_remove_dependent(gdiGfxJob* job, const gdiGfxJob* dependent)
+{
+	WINPR_ASSERT(job);
+
+	for (size_t x = 0; x < job->dependentCount; x++)
+	{
+		if (job->dependents[x] != dependent)
+			continue;
+
+		memmove(&job->dependents[x], &job->dependents[x + 1],
+		        (job->dependentCount - x - 1) * sizeof(gdiGfxJob*));
+		job->dependentCount--;
+		return;
+	}
+}
+
+static void gdi_gfx_job_free(gdiGfxJob* job)
+{
+	if (!job)
+		return;
+
+	if (job->work)
+		CloseThreadpoolWork(job->work);
+	if (job->fkt)
+		job->fkt(job->arg);
+	free(job->dependents);
+	free(job);
+}
+
+static void CALLBACK gdi_gfx_job_work_callback(PTP_CALLBACK_INSTANCE instance, void* context,
+                                               PTP_WORK work)
+{
+	gdiGfxJob* job = (gdiGfxJob*)context;
+	WINPR_UNUSED(instance);
+	WINPR_UNUSED(work);
+	WINPR_ASSERT(job);
+
+	gdiGfxScheduler* scheduler = job->scheduler;
+	WINPR_ASSERT(scheduler);
+
+	job->status = job->decode(job->arg);
+
+	EnterCriticalSection(&scheduler->lock);
+	job->done = TRUE;
+	scheduler->finished++;
+
+	for (size_t x = 0; x < job->dependentCount; x++)
+	{
+		gdiGfxJob* dependent = job->dependents[x];
+		WINPR_ASSERT(dependent->pending > 0);
+
+		dependent->pending--;
+		if (dependent->pending == 0)
+			SubmitThreadpoolWork(dependent->work);
+	}
+	LeaveCriticalSection(&scheduler->lock);
+
+	(void)SetEvent(scheduler->progress);
+}
+
+static UINT gdi_gfx_scheduler_run_inline(gdiGfxJobCallback decode, gdiGfxJobCallback complete,
+                                         gdiGfxJobFree fkt, void* arg)
+{
+	UINT status = decode(arg);
+
+	if ((status == CHANNEL_RC_OK) && complete)
+		status = complete(arg);
+
+	if (fkt)
+		fkt(arg);
+	return status;
+}
+
+gdiGfxScheduler* gdi_gfx_scheduler_new(UINT32 ThreadingFlags)
+{
+	return gdi_gfx_scheduler_new_ex(ThreadingFlags, FALSE);
+}
+
+gdiGfxScheduler* gdi_gfx_scheduler_new_ex(UINT32 ThreadingFlags, BOOL forceThreads)
+{
+	gdiGfxScheduler* scheduler = calloc(1, sizeof(gdiGfxScheduler));
+	if (!scheduler)
+		return NULL;
+
+	if (!InitializeCriticalSectionAndSpinCount(&scheduler->lock, 4000))
+	{
+		free(scheduler);
+		return NULL;
+	}
+
+	if (!(ThreadingFlags & THREADING_FLAGS_DISABLE_THREADS))
+	{
+		SYSTEM_INFO sysInfos = { 0 };
+		GetNativeSystemInfo(&sysInfos);
+		scheduler->useThreads = forceThreads || (sysInfos.dwNumberOfProcessors > 1);
+	}
+
+	if (scheduler->useThreads)
+	{
+		scheduler->progress = CreateEvent(NULL, TRUE, FALSE, NULL);
+		if (!scheduler->progress)
+			goto fail;
+
+		scheduler->threadPool = CreateThreadpool(NULL);
+		if (!scheduler->threadPool)
+			goto fail;
+
+		InitializeThreadpoolEnvironment(&scheduler->ThreadPoolEnv);
+		SetThreadpoolCallbackPool(&scheduler->ThreadPoolEnv, scheduler->threadPool);
+	}
+
+	return scheduler;
+
+fail:
+	WINPR_PRAGMA_DIAG_PUSH
+	WINPR_PRAGMA_DIAG_IGNORED_MISMATCHED_DEALLOC
+	gdi_gfx_scheduler_free(scheduler);
+	WINPR_PRAGMA_DIAG_POP
+	return NULL;
+}
+
+void gdi_gfx_scheduler_free(gdiGfxScheduler* scheduler)
+{
+	if (!scheduler)
+		return;
+
+	(void)gdi_gfx_scheduler_join(scheduler);
+
+	if (scheduler->threadPool)
+	{
+		CloseThreadpool(scheduler->threadPool);
+		DestroyThreadpoolEnvironment(&scheduler->ThreadPoolEnv);
+	}
+
+	for (size_t x = 0; x < scheduler->planarCount; x++)
+		freerdp_bitmap_planar_context_free(scheduler->planar[x]);
+
+	if (scheduler->progress)
+		(void)CloseHandle(scheduler->progress);
+	free(scheduler->planar);
+	free(scheduler->jobs);
+	DeleteCriticalSection(&scheduler->lock);
+	free(scheduler);
+}
+
+BOOL gdi_gfx_scheduler_is_threaded(const gdiGfxScheduler* scheduler)
+{
+	if (!scheduler)
+		return FALSE;
+	return scheduler->useThreads;
+}
+
+UINT gdi_gfx_scheduler_submit(gdiGfxScheduler* scheduler, UINT16 surfaceId,
+                              const RECTANGLE_16* bounds, BOOL exclusive, gdiGfxJobCallback decode,
+                              gdiGfxJobCallback complete, gdiGfxJobFree fkt, void* arg)
+{
+	WINPR_ASSERT(bounds);
+	WINPR_ASSERT(decode);
+
+	if (!gdi_gfx_scheduler_is_threaded(scheduler))
+		return gdi_gfx_scheduler_run_inline(decode, complete, fkt, arg);
+
+	gdiGfxJob* job = calloc(1, sizeof(gdiGfxJob));
+	if (!job)
+		goto fallback;
+
+	job->scheduler = scheduler;
+	job->surfaceId = surfaceId;
+	job->bounds = *bounds;
+	job->exclusive = exclusive;
+	job->decode = decode;
+	job->complete = complete;
+	job->work = CreateThreadpoolWork(gdi_gfx_job_work_callback, job, &scheduler->ThreadPoolEnv);
+	if (!job->work)
+		goto fallback;
+
+	EnterCriticalSection(&scheduler->lock);
+	if (scheduler->jobCount >= scheduler->jobSize)
+	{
+		const size_t size = (scheduler->jobSize == 0) ? 32 : scheduler->jobSize * 2;
+		gdiGfxJob** tmp = realloc(scheduler->jobs, size * sizeof(gdiGfxJob*));
+		if (!tmp)
+		{
+			LeaveCriticalSection(&scheduler->lock);
+			goto fallback;
+		}
+		scheduler->jobs = tmp;
+		scheduler->jobSize = size;
+	}
+
+	for (size_t x = 0; x < scheduler->jobCount; x++)
+	{
+		gdiGfxJob* cur = scheduler->jobs[x];
+		if (cur->done || !gdi_gfx_job_conflicts(cur, surfaceId, bounds, exclusive))
+			continue;
+
+		if (!gdi_gfx_job_add_dependent(cur, job))
+		{
+			for (size_t y = 0; y < x; y++)
+				gdi_gfx_job_remove_dependent(scheduler->jobs[y], job);
+			LeaveCriticalSection(&scheduler->lock);
+			WLog_WARN(TAG, "failed to queue job, decoding surface %" PRIu16 " inline",
+			          surfaceId);
+			goto fallback;
+		}
+	}
+
+	job->fkt = fkt;
+	job->arg = arg;
+	scheduler->jobs[scheduler->jobCount++] = job;
+	if (job->pending == 0)
+		SubmitThreadpoolWork(job->work);
+	LeaveCriticalSection(&scheduler->lock);
+	return CHANNEL_RC_OK;
+
+fallback:
+	gdi_gfx_job_free(job);
+	gdi_gfx_scheduler_wait(scheduler, surfaceId, bounds, exclusive);
+	return gdi_gfx_scheduler_run_inline(decode, complete, fkt, arg);
+}
+
+void gdi_gfx_scheduler_wait(gdiGfxScheduler* scheduler, UINT16 surfaceId,
+                            const RECTANGLE_16* rect, BOOL exclusive)
+{
+	if (!gdi_gfx_scheduler_is_threaded(scheduler))
+		return;
+
+	for (;;)
+	{
+		BOOL busy = FALSE;
+
+		EnterCriticalSection(&scheduler->lock);
+		(void)ResetEvent(scheduler->progress);
+		for (size_t x = 0; x < scheduler->jobCount; x++)
+		{
+			const gdiGfxJob* job = scheduler->jobs[x];
+			if (!job->done && gdi_gfx_job_conflicts(job, surfaceId, rect, exclusive))
+			{
+				busy = TRUE;
+				break;
+			}
+		}
+		LeaveCriticalSection(&scheduler->lock);
+
+		if (!busy)
+			return;
+
+		/* The event is reset under the lock before checking, so no completion is missed */
+		(void)WaitForSingleObject(scheduler->progress, INFINITE);
+	}
+}
+
+UINT gdi_gfx_scheduler_join(gdiGfxScheduler* scheduler)
+{
+	UINT status = CHANNEL_RC_OK;
+
+	if (!gdi_gfx_scheduler_is_threaded(scheduler))
+		return CHANNEL_RC_OK;
+
+	for (;;)
+	{
+		EnterCriticalSection(&scheduler->lock);
+		(void)ResetEvent(scheduler->progress);
+		const BOOL idle = scheduler->finished == scheduler->jobCount;
+		LeaveCriticalSection(&scheduler->lock);
+
+		if (idle)
+			break;
+
+		(void)WaitForSingleObject(scheduler->progress, INFINITE);
+	}
+
+	if (scheduler->jobCount == 0)
+		return CHANNEL_RC_OK;
+
+	/* All jobs are marked done, make sure their callbacks have returned as well */
+	for (size_t x = 0; x < scheduler->jobCount; x++)
+		WaitForThreadpoolWorkCallbacks(scheduler->jobs[x]->work, FALSE);
+
+	for (size_t x = 0; x < scheduler->jobCount; x++)
+	{
+		gdiGfxJob* job = scheduler->jobs[x];
+		UINT rc = job->status;
+
+		if ((rc == CHANNEL_RC_OK) && job->complete)
+			rc = job->complete(job->arg);
+
+		if ((rc != CHANNEL_RC_OK) && (status == CHANNEL_RC_OK))
+			status = rc;
+
+		gdi_gfx_job_free(job);
+		scheduler->jobs[x] = NULL;
+	}
+
+	scheduler->jobCount = 0;
+	scheduler->finished = 0;
+	return status;
+}
+
+BITMAP_PLANAR_CONTEXT* gdi_gfx_scheduler_acquire_planar(gdiGfxScheduler* scheduler, UINT32 width,
+                                                        UINT32 height)
+{
+	BITMAP_PLANAR_CONTEXT* planar = NULL;
+	WINPR_ASSERT(scheduler);
+
+	EnterCriticalSection(&scheduler->lock);
+	if (scheduler->planarCount > 0)
+		planar = scheduler->planar[--scheduler->planarCount];
+	LeaveCriticalSection(&scheduler->lock);
+
+	if (!planar)
+		return freerdp_bitmap_planar_context_new(0, width, height);
+
+	if (!freerdp_bitmap_planar_context_reset(planar, width, height))
+	{
+		freerdp_bitmap_planar_context_free(planar);
+		return NULL;
+	}
+	return planar;
+}
+
+void gdi_gfx_scheduler_release_planar(gdiGfxScheduler* scheduler, BITMAP_PLANAR_CONTEXT* planar)
+{
+	WINPR_ASSERT(scheduler);
+
+	if (!planar)
+		return;
+
+	EnterCriticalSection(&scheduler->lock);
+	if (scheduler->planarCount >= scheduler->planarSize)
+	{
+		const size_t size = (scheduler->planarSize == 0) ? 4 : scheduler->planarSize * 2;
+		BITMAP_PLANAR_CONTEXT** tmp =
+		    realloc(scheduler->planar, size * sizeof(BITMAP_PLANAR_CONTEXT*));
+		if (!tmp)
+		{
+			LeaveCriticalSection(&scheduler->lock);
+			freerdp_bitmap_planar_context_free(planar);
+			return;
+		}
+		scheduler->planar = tmp;
+		scheduler->planarSize = size;
+	}
+	scheduler->planar[scheduler->planarCount++] = planar;
+	LeaveCriticalSection(&scheduler->lock);
+}
@@ -0,0 +1,112 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * GDI Graphics Pipeline Frame Scheduler
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_GDI_GFX_SCHEDULER_H
+#define FREERDP_LIB_GDI_GFX_SCHEDULER_H
+
+#include <winpr/wtypes.h>
+
+#include <freerdp/api.h>
+#include <freerdp/types.h>
+#include <freerdp/codec/planar.h>
+#include <freerdp/gdi/gdi.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	/** @brief decode or completion step of a scheduled surface command
+	 *
+	 *  The decode step runs on a worker thread, the completion step runs on the
+	 *  thread calling gdi_gfx_scheduler_join in submission order.
+	 *
+	 *  @return 0 on success, otherwise a Win32 error code
+	 */
+	typedef UINT (*gdiGfxJobCallback)(void* arg);
+	typedef void (*gdiGfxJobFree)(void* arg);
+
+	FREERDP_LOCAL void gdi_gfx_scheduler_free(gdiGfxScheduler* scheduler);
+
+	WINPR_ATTR_MALLOC(gdi_gfx_scheduler_free, 1)
+	FREERDP_LOCAL gdiGfxScheduler* gdi_gfx_scheduler_new(UINT32 ThreadingFlags);
+
+	/** @brief like gdi_gfx_scheduler_new, \b forceThreads uses worker threads even on a
+	 *  single CPU (unless disabled by \b ThreadingFlags)
+	 */
+	WINPR_ATTR_MALLOC(gdi_gfx_scheduler_free, 1)
+	FREERDP_LOCAL gdiGfxScheduler* gdi_gfx_scheduler_new_ex(UINT32 ThreadingFlags,
+	                                                        BOOL forceThreads);
+
+	/** @brief check if jobs are dispatched to worker threads
+	 *
+	 *  If this returns \b FALSE gdi_gfx_scheduler_submit executes every job inline.
+	 */
+	FREERDP_LOCAL BOOL gdi_gfx_scheduler_is_threaded(const gdiGfxScheduler* scheduler);
+
+	/** @brief queue a surface command for the current frame
+	 *
+	 *  The job is started as soon as all previously submitted jobs it depends on
+	 *  have finished decoding. A job depends on an earlier one if both target the
+	 *  same surface and either their bounds intersect or both are \b exclusive
+	 *  (e.g. they share the per surface H.264 decoder state).
+	 *
+	 *  The scheduler takes ownership of \b arg, \b fkt is called once the job is
+	 *  completed, even on failure.
+	 *
+	 *  @return 0 on success, otherwise a Win32 error code. For inline execution the
+	 *          result of the decode and completion steps.
+	 */
+	FREERDP_LOCAL UINT gdi_gfx_scheduler_submit(gdiGfxScheduler* scheduler, UINT16 surfaceId,
+	                                            const RECTANGLE_16* bounds, BOOL exclusive,
+	                                            gdiGfxJobCallback decode,
+	                                            gdiGfxJobCallback complete, gdiGfxJobFree fkt,
+	                                            void* arg);
+
+	/** @brief wait until all queued jobs touching \b rect of a surface are decoded
+	 *
+	 *  Must be called before the surface memory covered by \b rect is accessed
+	 *  directly (SolidFill, SurfaceToSurface, CacheToSurface, ...)
+	 *
+	 *  @param rect The area to wait for or \b NULL for the whole surface
+	 *  @param exclusive Also wait for all exclusive jobs of the surface, required before
+	 *         running an exclusive job inline
+	 */
+	FREERDP_LOCAL void gdi_gfx_scheduler_wait(gdiGfxScheduler* scheduler, UINT16 surfaceId,
+	                                          const RECTANGLE_16* rect, BOOL exclusive);
+
+	/** @brief wait for all queued jobs and run their completion steps in order
+	 *
+	 *  @return 0 on success, otherwise the first Win32 error code of a failed job
+	 */
+	FREERDP_LOCAL UINT gdi_gfx_scheduler_join(gdiGfxScheduler* scheduler);
+
+	/** @brief borrow a planar decoder for a worker thread
+	 *
+	 *  The shared codec contexts can not be used concurrently, so planar jobs
+	 *  use one of these instead.
+	 */
+	FREERDP_LOCAL BITMAP_PLANAR_CONTEXT*
+	gdi_gfx_scheduler_acquire_planar(gdiGfxScheduler* scheduler, UINT32 width, UINT32 height);
+	FREERDP_LOCAL void gdi_gfx_scheduler_release_planar(gdiGfxScheduler* scheduler,
+	                                                    BITMAP_PLANAR_CONTEXT* planar);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_LIB_GDI_GFX_SCHEDULER_H */
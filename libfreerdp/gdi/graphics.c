@@ -22,6 +22,8 @@
 #include <freerdp/config.h>
 
 #include <winpr/crt.h>
+#include <winpr/assert.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/log.h>
 #include <freerdp/freerdp.h>
@@ -29,6 +31,7 @@
 #include <freerdp/gdi/shape.h>
 #include <freerdp/gdi/region.h>
 #include <freerdp/gdi/bitmap.h>
+#include <freerdp/primitives.h>
 
 #include "clipping.h"
 #include "drawing.h"
@@ -190,6 +193,7 @@ static BOOL gdi_Bitmap_Decompress(rdpContext* context, rdpBitmap* bitmap, const
 		}
 		else if (bpp < 32)
 		{
+			const UINT64 start = winpr_GetTickCount64NS();
 			if (!interleaved_decompress(context->codecs->interleaved, pSrcData, SrcSize, DstWidth,
 			                            DstHeight, bpp, bitmap->data, bitmap->format, 0, 0, 0,
 			                            DstWidth, DstHeight, &gdi->palette))
@@ -197,12 +201,16 @@ static BOOL gdi_Bitmap_Decompress(rdpContext* context, rdpBitmap* bitmap, const
 				WLog_ERR(TAG, "interleaved_decompress failed");
 				return FALSE;
 			}
+
+			freerdp_metrics_codec_time(context->metrics, FREERDP_METRICS_CODEC_INTERLEAVED, FALSE,
+			                           winpr_GetTickCount64NS() - start);
 		}
 		else
 		{
 			const BOOL fidelity =
 			    freerdp_settings_get_bool(context->settings, FreeRDP_DrawAllowDynamicColorFidelity);
 			freerdp_planar_switch_bgr(context->codecs->planar, fidelity);
+			const UINT64 start = winpr_GetTickCount64NS();
 			if (!planar_decompress(context->codecs->planar, pSrcData, SrcSize, DstWidth, DstHeight,
 			                       bitmap->data, bitmap->format, 0, 0, 0, DstWidth, DstHeight,
 			                       TRUE))
@@ -210,6 +218,9 @@ static BOOL gdi_Bitmap_Decompress(rdpContext* context, rdpBitmap* bitmap, const
 				WLog_ERR(TAG, "planar_decompress failed");
 				return FALSE;
 			}
+
+			freerdp_metrics_codec_time(context->metrics, FREERDP_METRICS_CODEC_PLANAR, FALSE,
+			                           winpr_GetTickCount64NS() - start);
 		}
 	}
 	else
@@ -317,111 +328,301 @@ static void gdi_Glyph_Free(rdpContext* context, rdpGlyph* glyph)
 	}
 }
 
+/* A glyph run collects the coverage of all glyphs of a text order in a PRIM_MASK_* mask and
+ * paints the opaque rectangle, the glyph cells and the glyphs in a single pass in EndDraw. */
+struct gdi_glyph_run
+{
+	BOOL active;
+	BOOL prepared;
+	UINT32 foreColor; /* glyph pixels, in the format of the drawing surface */
+	UINT32 backColor; /* opaque rectangle and glyph cells */
+
+	/* right and bottom are exclusive */
+	GDI_RECT op;
+	GDI_RECT bounds;
+
+	BYTE* mask;
+	size_t maskSize;
+	UINT32 maskStep;
+};
+
+void gdi_glyph_run_free(gdiGlyphRun* run)
+{
+	if (!run)
+		return;
+
+	winpr_aligned_free(run->mask);
+	free(run);
+}
+
+static void gdi_glyph_run_add_rect(GDI_RECT* rect, INT32 x, INT32 y, INT32 width, INT32 height)
+{
+	WINPR_ASSERT(rect);
+
+	if ((width <= 0) || (height <= 0))
+		return;
+
+	if ((rect->right <= rect->left) || (rect->bottom <= rect->top))
+	{
+		rect->left = x;
+		rect->top = y;
+		rect->right = x + width;
+		rect->bottom = y + height;
+		return;
+	}
+
+	rect->left = MIN(rect->left, x);
+	rect->top = MIN(rect->top, y);
+	rect->right = MAX(rect->right, x + width);
+	rect->bottom = MAX(rect->bottom, y + height);
+}
+
+static void gdi_glyph_run_clip_rect(GDI_RECT* rect, const HGDI_BITMAP surface)
+{
+	WINPR_ASSERT(rect);
+	WINPR_ASSERT(surface);
+
+	rect->left = MAX(rect->left, 0);
+	rect->top = MAX(rect->top, 0);
+	rect->right = MIN(rect->right, surface->width);
+	rect->bottom = MIN(rect->bottom, surface->height);
+
+	if ((rect->right <= rect->left) || (rect->bottom <= rect->top))
+		rect->right = rect->left = rect->bottom = rect->top = 0;
+}
+
+/* Restrict a run rectangle to the ORDER_BOUNDS clip set by gdi_set_bounds */
+static void gdi_glyph_run_clip_region(GDI_RECT* rect, const HGDI_RGN clip)
+{
+	WINPR_ASSERT(rect);
+
+	if (!clip || clip->null)
+		return;
+
+	rect->left = MAX(rect->left, clip->x);
+	rect->top = MAX(rect->top, clip->y);
+	rect->right = MIN(rect->right, clip->x + clip->w);
+	rect->bottom = MIN(rect->bottom, clip->y + clip->h);
+
+	if ((rect->right <= rect->left) || (rect->bottom <= rect->top))
+		rect->right = rect->left = rect->bottom = rect->top = 0;
+}
+
+/* Size the coverage mask to the run once all its rectangles are known */
+static BOOL gdi_glyph_run_prepare(gdiGlyphRun* run, const HGDI_DC hdc, const HGDI_BITMAP surface)
+{
+	WINPR_ASSERT(run);
+	WINPR_ASSERT(hdc);
+
+	if (run->prepared)
+		return TRUE;
+
+	gdi_glyph_run_clip_region(&run->bounds, hdc->clip);
+	gdi_glyph_run_clip_region(&run->op, hdc->clip);
+	gdi_glyph_run_clip_rect(&run->bounds, surface);
+	gdi_glyph_run_clip_rect(&run->op, surface);
+
+	const UINT32 width = (UINT32)(run->bounds.right - run->bounds.left);
+	const UINT32 height = (UINT32)(run->bounds.bottom - run->bounds.top);
+	const size_t size = 1ull * width * height;
+
+	if (size > run->maskSize)
+	{
+		BYTE* mask = winpr_aligned_malloc(size, 16);
+		if (!mask)
+			return FALSE;
+
+		winpr_aligned_free(run->mask);
+		run->mask = mask;
+		run->maskSize = size;
+	}
+
+	run->maskStep = width;
+	if (size > 0)
+		memset(run->mask, PRIM_MASK_NONE, size);
+
+	for (INT32 y = run->op.top; y < run->op.bottom; y++)
+	{
+		BYTE* line = &run->mask[1ull * (UINT32)(y - run->bounds.top) * run->maskStep];
+		memset(&line[run->op.left - run->bounds.left], PRIM_MASK_BACK,
+		       (size_t)(run->op.right - run->op.left));
+	}
+
+	run->prepared = TRUE;
+	return TRUE;
+}
+
+static BOOL gdi_glyph_run_paint(rdpGdi* gdi, const gdiGlyphRun* run)
+{
+	WINPR_ASSERT(gdi);
+	WINPR_ASSERT(run);
+
+	const HGDI_BITMAP surface = gdi->drawing->bitmap;
+	const INT32 width = run->bounds.right - run->bounds.left;
+	const INT32 height = run->bounds.bottom - run->bounds.top;
+
+	if ((width <= 0) || (height <= 0))
+		return TRUE;
+
+	const UINT32 bpp = FreeRDPGetBytesPerPixel(surface->format);
+	BYTE* dst = &surface->data[1ull * (UINT32)run->bounds.top * surface->scanline +
+	                           1ull * (UINT32)run->bounds.left * bpp];
+
+	if (bpp == 4)
+	{
+		const primitives_t* prims = primitives_get();
+		if (prims->expandMask_8u32u(run->mask, run->maskStep, dst, surface->scanline,
+		                            (UINT32)width, (UINT32)height, run->foreColor,
+		                            run->backColor) != PRIMITIVES_SUCCESS)
+			return FALSE;
+	}
+	else
+	{
+		for (INT32 y = 0; y < height; y++)
+		{
+			const BYTE* mask = &run->mask[1ull * (UINT32)y * run->maskStep];
+			BYTE* line = &dst[1ull * (UINT32)y * surface->scanline];
+
+			for (INT32 x = 0; x < width; x++)
+			{
+				if (mask[x] == PRIM_MASK_FORE)
+					FreeRDPWriteColor(&line[1ull * (UINT32)x * bpp], surface->format,
+					                  run->foreColor);
+				else if (mask[x] != PRIM_MASK_NONE)
+					FreeRDPWriteColor(&line[1ull * (UINT32)x * bpp], surface->format,
+					                  run->backColor);
+			}
+		}
+	}
+
+	return gdi_InvalidateRegion(gdi->drawing->hdc, run->bounds.left, run->bounds.top, width,
+	                            height);
+}
+
 static BOOL gdi_Glyph_Draw(rdpContext* context, const rdpGlyph* glyph, INT32 x, INT32 y, INT32 w,
                            INT32 h, INT32 sx, INT32 sy, BOOL fOpRedundant)
 {
 	const gdiGlyph* gdi_glyph = NULL;
 	rdpGdi* gdi = NULL;
-	HGDI_BRUSH brush = NULL;
-	BOOL rc = FALSE;
+	gdiGlyphRun* run = NULL;
 
-	if (!context || !glyph)
+	if (!context || !context->gdi || !glyph)
 		return FALSE;
 
 	gdi = context->gdi;
 	gdi_glyph = (const gdiGlyph*)glyph;
+	run = gdi->glyphRun;
 
-	if (!fOpRedundant)
-	{
-		GDI_RECT rect = { 0 };
+	if (!run || !run->active || !gdi->drawing || !gdi->drawing->hdc)
+		return FALSE;
 
-		if (x > 0)
-			rect.left = x;
+	if (!gdi_glyph_run_prepare(run, gdi->drawing->hdc, gdi->drawing->bitmap))
+		return FALSE;
 
-		if (y > 0)
-			rect.top = y;
+	if (x < run->bounds.left)
+	{
+		sx += run->bounds.left - x;
+		w -= run->bounds.left - x;
+		x = run->bounds.left;
+	}
 
-		if (x + w > 0)
-			rect.right = x + w - 1;
+	if (y < run->bounds.top)
+	{
+		sy += run->bounds.top - y;
+		h -= run->bounds.top - y;
+		y = run->bounds.top;
+	}
 
-		if (y + h > 0)
-			rect.bottom = y + h - 1;
+	w = MIN(w, run->bounds.right - x);
+	h = MIN(h, run->bounds.bottom - y);
+	w = MIN(w, gdi_glyph->bitmap->width - sx);
+	h = MIN(h, gdi_glyph->bitmap->height - sy);
 
-		if ((rect.left < rect.right) && (rect.top < rect.bottom))
-		{
-			brush = gdi_CreateSolidBrush(gdi->drawing->hdc->bkColor);
+	if ((w <= 0) || (h <= 0) || (sx < 0) || (sy < 0))
+		return TRUE;
 
-			if (!brush)
-				return FALSE;
+	/* glyph pixels win over the cells of overlapping glyphs */
+	const BYTE cell = fOpRedundant ? PRIM_MASK_NONE : PRIM_MASK_BACK;
+
+	for (INT32 line = 0; line < h; line++)
+	{
+		const BYTE* src =
+		    &gdi_glyph->bitmap->data[1ull * (UINT32)(sy + line) * gdi_glyph->bitmap->scanline +
+		                             (UINT32)sx];
+		BYTE* dst = &run->mask[1ull * (UINT32)(y - run->bounds.top + line) * run->maskStep +
+		                       (UINT32)(x - run->bounds.left)];
 
-			gdi_FillRect(gdi->drawing->hdc, &rect, brush);
-			gdi_DeleteObject((HGDIOBJECT)brush);
+		for (INT32 col = 0; col < w; col++)
+		{
+			const BYTE value = (src[col] != 0) ? PRIM_MASK_FORE : cell;
+			dst[col] = MAX(dst[col], value);
 		}
 	}
 
-	brush = gdi_CreateSolidBrush(gdi->drawing->hdc->textColor);
-
-	if (!brush)
-		return FALSE;
-
-	gdi_SelectObject(gdi->drawing->hdc, (HGDIOBJECT)brush);
-	rc = gdi_BitBlt(gdi->drawing->hdc, x, y, w, h, gdi_glyph->hdc, sx, sy, GDI_GLYPH_ORDER,
-	                &context->gdi->palette);
-	gdi_DeleteObject((HGDIOBJECT)brush);
-	return rc;
+	return TRUE;
 }
 
 static BOOL gdi_Glyph_BeginDraw(rdpContext* context, INT32 x, INT32 y, INT32 width, INT32 height,
                                 UINT32 bgcolor, UINT32 fgcolor, BOOL fOpRedundant)
 {
 	rdpGdi* gdi = NULL;
+	gdiGlyphRun* run = NULL;
+	UINT32 format = 0;
 
 	if (!context || !context->gdi)
 		return FALSE;
 
 	gdi = context->gdi;
 
-	if (!gdi->drawing || !gdi->drawing->hdc)
+	if (!gdi->drawing || !gdi->drawing->hdc || !gdi->drawing->bitmap)
 		return FALSE;
 
-	if (!fOpRedundant)
+	if (!gdi->glyphRun)
 	{
-		if (!gdi_decode_color(gdi, bgcolor, &bgcolor, NULL))
+		gdi->glyphRun = calloc(1, sizeof(gdiGlyphRun));
+		if (!gdi->glyphRun)
 			return FALSE;
+	}
 
-		if (!gdi_decode_color(gdi, fgcolor, &fgcolor, NULL))
-			return FALSE;
+	run = gdi->glyphRun;
 
-		gdi_SetClipRgn(gdi->drawing->hdc, x, y, width, height);
-		gdi_SetTextColor(gdi->drawing->hdc, bgcolor);
-		gdi_SetBkColor(gdi->drawing->hdc, fgcolor);
+	/* the order calls the text color BackColor and the opaque rectangle color ForeColor */
+	if (!gdi_decode_color(gdi, bgcolor, &run->foreColor, &format))
+		return FALSE;
 
-		if (1)
-		{
-			GDI_RECT rect = { 0 };
-			HGDI_BRUSH brush = gdi_CreateSolidBrush(fgcolor);
+	if (!gdi_decode_color(gdi, fgcolor, &run->backColor, NULL))
+		return FALSE;
 
-			if (!brush)
-				return FALSE;
+	const UINT32 surfaceFormat = gdi->drawing->bitmap->format;
+	if (surfaceFormat != format)
+	{
+		run->foreColor = FreeRDPConvertColor(run->foreColor, format, surfaceFormat, &gdi->palette);
+		run->backColor = FreeRDPConvertColor(run->backColor, format, surfaceFormat, &gdi->palette);
+	}
 
-			if (x > 0)
-				rect.left = x;
+	run->op = (GDI_RECT){ 0 };
+	if (!fOpRedundant)
+		gdi_glyph_run_add_rect(&run->op, x, y, width, height);
 
-			if (y > 0)
-				rect.top = y;
+	run->bounds = run->op;
+	run->prepared = FALSE;
+	run->active = TRUE;
+	return TRUE;
+}
 
-			rect.right = x + width - 1;
-			rect.bottom = y + height - 1;
+static BOOL gdi_Glyph_SetBounds(rdpContext* context, INT32 x, INT32 y, INT32 width, INT32 height)
+{
+	gdiGlyphRun* run = NULL;
 
-			if ((x + width > rect.left) && (y + height > rect.top))
-				gdi_FillRect(gdi->drawing->hdc, &rect, brush);
+	if (!context || !context->gdi)
+		return FALSE;
 
-			gdi_DeleteObject((HGDIOBJECT)brush);
-		}
+	run = context->gdi->glyphRun;
 
-		return gdi_SetNullClipRgn(gdi->drawing->hdc);
-	}
+	if (!run || !run->active || run->prepared)
+		return FALSE;
 
+	gdi_glyph_run_add_rect(&run->bounds, x, y, width, height);
 	return TRUE;
 }
 
@@ -429,17 +630,27 @@ static BOOL gdi_Glyph_EndDraw(rdpContext* context, INT32 x, INT32 y, INT32 width
                               UINT32 bgcolor, UINT32 fgcolor)
 {
 	rdpGdi* gdi = NULL;
+	gdiGlyphRun* run = NULL;
+	BOOL rc = FALSE;
 
 	if (!context || !context->gdi)
 		return FALSE;
 
 	gdi = context->gdi;
+	run = gdi->glyphRun;
 
 	if (!gdi->drawing || !gdi->drawing->hdc)
 		return FALSE;
 
+	if (!run || !run->active)
+		return FALSE;
+
+	if (gdi_glyph_run_prepare(run, gdi->drawing->hdc, gdi->drawing->bitmap))
+		rc = gdi_glyph_run_paint(gdi, run);
+
+	run->active = FALSE;
 	gdi_SetNullClipRgn(gdi->drawing->hdc);
-	return TRUE;
+	return rc;
 }
 
 /* Graphics Module */
@@ -460,6 +671,7 @@ BOOL gdi_register_graphics(rdpGraphics* graphics)
 	glyph.Draw = gdi_Glyph_Draw;
 	glyph.BeginDraw = gdi_Glyph_BeginDraw;
 	glyph.EndDraw = gdi_Glyph_EndDraw;
+	glyph.SetBounds = gdi_Glyph_SetBounds;
 	graphics_register_glyph(graphics, &glyph);
 	return TRUE;
 }
@@ -32,4 +32,6 @@ FREERDP_LOCAL HGDI_BITMAP gdi_create_bitmap(rdpGdi* gdi, UINT32 width, UINT32 he
 
 FREERDP_LOCAL BOOL gdi_register_graphics(rdpGraphics* graphics);
 
+FREERDP_LOCAL void gdi_glyph_run_free(gdiGlyphRun* run);
+
 #endif /* FREERDP_LIB_GDI_GRAPHICS_H */
@@ -0,0 +1,288 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/interlocked.h>
+
+#include <freerdp/settings.h>
+
+#include "gfx_scheduler.h"
+
+#define JOB_COUNT 16
+
+typedef struct
+{
+	CRITICAL_SECTION lock;
+	LONG active;
+	LONG maxActive;
+	UINT32 decoded[JOB_COUNT];
+	size_t decodedCount;
+	UINT32 completed[JOB_COUNT];
+	size_t completedCount;
+	LONG freed;
+} TestState;
+
+typedef struct
+{
+	TestState* state;
+	UINT32 id;
+	UINT status;
+	DWORD delay;
+} TestJob;
+
+static UINT test_job_decode(void* arg)
+{
+	TestJob* job = arg;
+	TestState* state = job->state;
+
+	const LONG active = InterlockedIncrement(&state->active);
+	EnterCriticalSection(&state->lock);
+	if (active > state->maxActive)
+		state->maxActive = active;
+	LeaveCriticalSection(&state->lock);
+
+	Sleep(job->delay);
+
+	EnterCriticalSection(&state->lock);
+	state->decoded[state->decodedCount++] = job->id;
+	LeaveCriticalSection(&state->lock);
+
+	InterlockedDecrement(&state->active);
+	return job->status;
+}
+
+static UINT test_job_complete(void* arg)
+{
+	TestJob* job = arg;
+	TestState* state = job->state;
+
+	state->completed[state->completedCount++] = job->id;
+	return CHANNEL_RC_OK;
+}
+
+static void test_job_free(void* arg)
+{
+	TestJob* job = arg;
+	InterlockedIncrement(&job->state->freed);
+	free(job);
+}
+
+static UINT test_submit(gdiGfxScheduler* scheduler, TestState* state, UINT32 id, UINT16 surfaceId,
+                        const RECTANGLE_16* bounds, BOOL exclusive, UINT status, DWORD delay)
+{
+	TestJob* job = calloc(1, sizeof(TestJob));
+	if (!job)
+		return CHANNEL_RC_NO_MEMORY;
+
+	job->state = state;
+	job->id = id;
+	job->status = status;
+	job->delay = delay;
+	return gdi_gfx_scheduler_submit(scheduler, surfaceId, bounds, exclusive, test_job_decode,
+	                                test_job_complete, test_job_free, job);
+}
+
+static void test_state_reset(TestState* state)
+{
+	EnterCriticalSection(&state->lock);
+	state->active = 0;
+	state->maxActive = 0;
+	state->decodedCount = 0;
+	state->completedCount = 0;
+	state->freed = 0;
+	LeaveCriticalSection(&state->lock);
+}
+
+static BOOL test_completed_in_order(const TestState* state, size_t count)
+{
+	if (state->completedCount != count)
+		return FALSE;
+
+	for (size_t x = 0; x < count; x++)
+	{
+		if (state->completed[x] != x)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/* Jobs with overlapping bounds on one surface decode in submission order, completion steps
+ * always run in submission order. */
+static BOOL test_ordering(gdiGfxScheduler* scheduler, TestState* state)
+{
+	const RECTANGLE_16 overlapping = { 0, 0, 64, 64 };
+	test_state_reset(state);
+
+	for (UINT32 x = 0; x < JOB_COUNT; x++)
+	{
+		/* later jobs are faster, they would overtake earlier ones if they were not ordered */
+		if (test_submit(scheduler, state, x, 1, &overlapping, FALSE, CHANNEL_RC_OK,
+		                (JOB_COUNT - x) % 3) != CHANNEL_RC_OK)
+			return FALSE;
+	}
+
+	if (gdi_gfx_scheduler_join(scheduler) != CHANNEL_RC_OK)
+		return FALSE;
+
+	if (state->decodedCount != JOB_COUNT)
+		return FALSE;
+	for (size_t x = 0; x < JOB_COUNT; x++)
+	{
+		if (state->decoded[x] != x)
+		{
+			(void)fprintf(stderr, "job %" PRIu32 " decoded at position %" PRIuz "\n",
+			              state->decoded[x], x);
+			return FALSE;
+		}
+	}
+
+	test_state_reset(state);
+	for (UINT32 x = 0; x < JOB_COUNT; x++)
+	{
+		const RECTANGLE_16 disjoint = { (UINT16)(x * 64), 0, (UINT16)(x * 64 + 64), 64 };
+		if (test_submit(scheduler, state, x, 1, &disjoint, FALSE, CHANNEL_RC_OK,
+		                (JOB_COUNT - x) % 3) != CHANNEL_RC_OK)
+			return FALSE;
+	}
+
+	if (gdi_gfx_scheduler_join(scheduler) != CHANNEL_RC_OK)
+		return FALSE;
+	return test_completed_in_order(state, JOB_COUNT) && (state->freed == JOB_COUNT);
+}
+
+/* Exclusive jobs of one surface never run concurrently, even with disjoint bounds */
+static BOOL test_exclusive(gdiGfxScheduler* scheduler, TestState* state)
+{
+	test_state_reset(state);
+
+	for (UINT32 x = 0; x < JOB_COUNT; x++)
+	{
+		const RECTANGLE_16 disjoint = { (UINT16)(x * 64), 0, (UINT16)(x * 64 + 64), 64 };
+		if (test_submit(scheduler, state, x, 2, &disjoint, TRUE, CHANNEL_RC_OK, 2) !=
+		    CHANNEL_RC_OK)
+			return FALSE;
+	}
+
+	/* an exclusive job run inline must wait for all of them */
+	const RECTANGLE_16 unrelated = { 4000, 4000, 4001, 4001 };
+	gdi_gfx_scheduler_wait(scheduler, 2, &unrelated, TRUE);
+	EnterCriticalSection(&state->lock);
+	const size_t decoded = state->decodedCount;
+	LeaveCriticalSection(&state->lock);
+	if (decoded != JOB_COUNT)
+	{
+		(void)fprintf(stderr, "exclusive wait returned with %" PRIuz " jobs decoded\n", decoded);
+		return FALSE;
+	}
+
+	if (gdi_gfx_scheduler_join(scheduler) != CHANNEL_RC_OK)
+		return FALSE;
+
+	if (state->maxActive != 1)
+	{
+		(void)fprintf(stderr, "%" PRId32 " exclusive jobs ran concurrently\n", state->maxActive);
+		return FALSE;
+	}
+	return test_completed_in_order(state, JOB_COUNT);
+}
+
+/* The first failure is reported by join, the failed job is not completed but freed */
+static BOOL test_errors(gdiGfxScheduler* scheduler, TestState* state)
+{
+	test_state_reset(state);
+
+	for (UINT32 x = 0; x < 4; x++)
+	{
+		const RECTANGLE_16 disjoint = { (UINT16)(x * 64), 0, (UINT16)(x * 64 + 64), 64 };
+		UINT status = CHANNEL_RC_OK;
+		if (x == 1)
+			status = ERROR_INVALID_DATA;
+		else if (x == 2)
+			status = ERROR_INTERNAL_ERROR;
+
+		if (test_submit(scheduler, state, x, 3, &disjoint, FALSE, status, 1) != CHANNEL_RC_OK)
+			return FALSE;
+	}
+
+	if (gdi_gfx_scheduler_join(scheduler) != ERROR_INVALID_DATA)
+		return FALSE;
+
+	if ((state->completedCount != 2) || (state->completed[0] != 0) ||
+	    (state->completed[1] != 3) || (state->freed != 4))
+		return FALSE;
+
+	/* the next frame starts clean */
+	test_state_reset(state);
+	const RECTANGLE_16 rect = { 0, 0, 64, 64 };
+	if (test_submit(scheduler, state, 0, 3, &rect, FALSE, CHANNEL_RC_OK, 0) != CHANNEL_RC_OK)
+		return FALSE;
+	return gdi_gfx_scheduler_join(scheduler) == CHANNEL_RC_OK;
+}
+
+/* Without threads jobs run inline and report their status directly */
+static BOOL test_inline(TestState* state)
+{
+	const RECTANGLE_16 rect = { 0, 0, 64, 64 };
+	gdiGfxScheduler* scheduler = gdi_gfx_scheduler_new(THREADING_FLAGS_DISABLE_THREADS);
+	if (!scheduler)
+		return FALSE;
+
+	test_state_reset(state);
+	BOOL rc = !gdi_gfx_scheduler_is_threaded(scheduler);
+	if (test_submit(scheduler, state, 0, 1, &rect, FALSE, CHANNEL_RC_OK, 0) != CHANNEL_RC_OK)
+		rc = FALSE;
+	if (test_submit(scheduler, state, 1, 1, &rect, FALSE, ERROR_INVALID_DATA, 0) !=
+	    ERROR_INVALID_DATA)
+		rc = FALSE;
+	if ((state->completedCount != 1) || (state->freed != 2))
+		rc = FALSE;
+
+	gdi_gfx_scheduler_free(scheduler);
+	return rc;
+}
+
+int TestGdiGfxScheduler(int argc, char* argv[])
+{
+	int rc = -1;
+	TestState state = { 0 };
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!InitializeCriticalSectionAndSpinCount(&state.lock, 4000))
+		return -1;
+
+	gdiGfxScheduler* scheduler = gdi_gfx_scheduler_new_ex(0, TRUE);
+	if (!scheduler || !gdi_gfx_scheduler_is_threaded(scheduler))
+		goto fail;
+
+	if (!test_ordering(scheduler, &state))
+	{
+		(void)fprintf(stderr, "test_ordering failed\n");
+		goto fail;
+	}
+
+	if (!test_exclusive(scheduler, &state))
+	{
+		(void)fprintf(stderr, "test_exclusive failed\n");
+		goto fail;
+	}
+
+	if (!test_errors(scheduler, &state))
+	{
+		(void)fprintf(stderr, "test_errors failed\n");
+		goto fail;
+	}
+
+	if (!test_inline(&state))
+	{
+		(void)fprintf(stderr, "test_inline failed\n");
+		goto fail;
+	}
+
+	rc = 0;
+fail:
+	gdi_gfx_scheduler_free(scheduler);
+	DeleteCriticalSection(&state.lock);
+	return rc;
+}
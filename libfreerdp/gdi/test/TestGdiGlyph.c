@@ -0,0 +1,169 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/gdi/gdi.h>
+#include <freerdp/codec/color.h>
+
+#define SURFACE_SIZE 32
+#define SURFACE_FILL 0x11
+
+/* ORDER_BOUNDS clip, inclusive like the order encoding */
+#define CLIP_LEFT 10
+#define CLIP_TOP 10
+#define CLIP_RIGHT 21
+#define CLIP_BOTTOM 21
+
+/* 8x8 solid glyph placed at 8/8 */
+#define GLYPH_X 8
+#define GLYPH_Y 8
+#define GLYPH_SIZE 8
+
+static BOOL in_rect(INT32 x, INT32 y, INT32 left, INT32 top, INT32 right, INT32 bottom)
+{
+	return (x >= left) && (x <= right) && (y >= top) && (y <= bottom);
+}
+
+static UINT32 read_pixel(const rdpGdi* gdi, INT32 x, INT32 y)
+{
+	const BYTE* data = gdi->primary_buffer;
+	const size_t bpp = FreeRDPGetBytesPerPixel(gdi->dstFormat);
+	return FreeRDPReadColor(&data[1ull * (UINT32)y * gdi->stride + bpp * (UINT32)x],
+	                        gdi->dstFormat);
+}
+
+static BOOL test_glyph_setup(freerdp* instance)
+{
+	rdpContext* context = instance->context;
+	rdpSettings* settings = context->settings;
+
+	if (!freerdp_settings_set_uint32(settings, FreeRDP_DesktopWidth, SURFACE_SIZE) ||
+	    !freerdp_settings_set_uint32(settings, FreeRDP_DesktopHeight, SURFACE_SIZE) ||
+	    !freerdp_settings_set_uint32(settings, FreeRDP_ColorDepth, 32))
+		return FALSE;
+
+	if (!gdi_init(instance, PIXEL_FORMAT_BGRX32))
+		return FALSE;
+
+	BYTE aj[GLYPH_SIZE] = { 0 };
+	memset(aj, 0xFF, sizeof(aj));
+
+	CACHE_GLYPH_ORDER cacheGlyph = { 0 };
+	cacheGlyph.cacheId = 0;
+	cacheGlyph.cGlyphs = 1;
+	cacheGlyph.glyphData[0].cacheIndex = 0;
+	cacheGlyph.glyphData[0].cx = GLYPH_SIZE;
+	cacheGlyph.glyphData[0].cy = GLYPH_SIZE;
+	cacheGlyph.glyphData[0].cb = sizeof(aj);
+	cacheGlyph.glyphData[0].aj = aj;
+	return context->update->secondary->CacheGlyph(context, &cacheGlyph);
+}
+
+/* Draw the glyph with a bounded GlyphIndex order and check no pixel outside the bounds moved */
+static BOOL test_glyph_bounds(freerdp* instance, BOOL fOpRedundant)
+{
+	rdpContext* context = instance->context;
+	rdpGdi* gdi = context->gdi;
+	const rdpBounds bounds = { CLIP_LEFT, CLIP_TOP, CLIP_RIGHT, CLIP_BOTTOM };
+	GLYPH_INDEX_ORDER order = { 0 };
+
+	memset(gdi->primary_buffer, SURFACE_FILL, 1ull * gdi->stride * gdi->height);
+	const UINT32 fill = read_pixel(gdi, 0, 0);
+
+	order.cacheId = 0;
+	order.fOpRedundant = fOpRedundant;
+	order.backColor = 0x0000FF;
+	order.foreColor = 0x00FF00;
+	order.bkLeft = GLYPH_X;
+	order.bkTop = GLYPH_Y;
+	order.bkRight = GLYPH_X + GLYPH_SIZE - 1;
+	order.bkBottom = GLYPH_Y + GLYPH_SIZE - 1;
+	order.opLeft = 4;
+	order.opTop = 4;
+	order.opRight = 27;
+	order.opBottom = 27;
+	order.x = GLYPH_X;
+	order.y = GLYPH_Y;
+	order.cbData = 2;
+	order.data[0] = 0; /* cache index */
+	order.data[1] = 0; /* offset */
+
+	if (!context->update->SetBounds(context, &bounds))
+		return FALSE;
+
+	if (!context->update->primary->GlyphIndex(context, &order))
+		return FALSE;
+
+	if (!context->update->SetBounds(context, NULL))
+		return FALSE;
+
+	const UINT32 text = read_pixel(gdi, CLIP_LEFT, CLIP_TOP);
+	const UINT32 opaque = read_pixel(gdi, CLIP_RIGHT, CLIP_BOTTOM);
+
+	if ((text == fill) || (!fOpRedundant && ((opaque == fill) || (opaque == text))))
+	{
+		fprintf(stderr, "glyph run was not drawn inside the bounds\n");
+		return FALSE;
+	}
+
+	for (INT32 y = 0; y < SURFACE_SIZE; y++)
+	{
+		for (INT32 x = 0; x < SURFACE_SIZE; x++)
+		{
+			const BOOL clip = in_rect(x, y, CLIP_LEFT, CLIP_TOP, CLIP_RIGHT, CLIP_BOTTOM);
+			const BOOL glyph = in_rect(x, y, GLYPH_X, GLYPH_Y, GLYPH_X + GLYPH_SIZE - 1,
+			                           GLYPH_Y + GLYPH_SIZE - 1);
+			UINT32 expect = fill;
+
+			if (clip && glyph)
+				expect = text;
+			else if (clip && !fOpRedundant)
+				expect = opaque;
+
+			const UINT32 pixel = read_pixel(gdi, x, y);
+			if (pixel != expect)
+			{
+				fprintf(stderr,
+				        "fOpRedundant=%d pixel %" PRId32 "x%" PRId32 " 0x%08" PRIx32
+				        " expected 0x%08" PRIx32 "\n",
+				        fOpRedundant, x, y, pixel, expect);
+				return FALSE;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+int TestGdiGlyph(int argc, char* argv[])
+{
+	int rc = -1;
+	freerdp* instance = NULL;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	instance = freerdp_new();
+	if (!instance || !freerdp_context_new(instance))
+		goto fail;
+
+	if (!test_glyph_setup(instance))
+		goto fail;
+
+	if (!test_glyph_bounds(instance, TRUE))
+		goto fail;
+
+	if (!test_glyph_bounds(instance, FALSE))
+		goto fail;
+
+	rc = 0;
+fail:
+	if (instance)
+	{
+		gdi_free(instance);
+		freerdp_context_free(instance);
+	}
+	freerdp_free(instance);
+	return rc;
+}
@@ -0,0 +1,456 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Optimized RGB to YUV conversion operations (AVX2)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/wtypes.h>
+#include <freerdp/config.h>
+
+#include <winpr/sysinfo.h>
+#include <winpr/crt.h>
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+
+#include "prim_internal.h"
+
+#if defined(WITH_SSE2)
+#include <immintrin.h>
+
+/* The SSSE3 implementations these kernels replace, used for formats and sizes not handled
+ * here. The results of both are bit exact. */
+static __RGBToYUV420_8u_P3AC4R_t fallbackRGBToYUV420 = NULL;
+static __RGBToAVC444YUV_t fallbackRGBToAVC444YUV = NULL;
+static __RGBToAVC444YUV_t fallbackRGBToAVC444YUVv2 = NULL;
+
+/* Same factors as the SSSE3 kernels, bytes in B G R X order */
+#define BGRX_Y_FACTORS _mm256_set1_epi32(0x001b5c09)  /*    9   92   27 0 */
+#define BGRX_U_FACTORS _mm256_set1_epi32(0x00e39d7f)  /*  127  -99  -29 0 */
+#define BGRX_V_FACTORS _mm256_set1_epi32(0x007f8cf4)  /*  -12 -116  127 0 */
+#define CONST128_FACTORS _mm256_set1_epi8(-128)
+
+#define Y_SHIFT 7
+#define U_SHIFT 8
+#define V_SHIFT 8
+
+/* hadd and pack work on 128bit lanes, this puts the 4 pixel groups back in order */
+#define LANE_ORDER _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7)
+
+/* compute the luma (Y) of 32 BGRX pixels */
+static INLINE __m256i avx2_BGRX_Y(const __m256i x[4])
+{
+	const __m256i y_factors = BGRX_Y_FACTORS;
+	const __m256i y1 = _mm256_srli_epi16(_mm256_hadd_epi16(_mm256_maddubs_epi16(x[0], y_factors),
+	                                                       _mm256_maddubs_epi16(x[1], y_factors)),
+	                                     Y_SHIFT);
+	const __m256i y2 = _mm256_srli_epi16(_mm256_hadd_epi16(_mm256_maddubs_epi16(x[2], y_factors),
+	                                                       _mm256_maddubs_epi16(x[3], y_factors)),
+	                                     Y_SHIFT);
+	return _mm256_permutevar8x32_epi32(_mm256_packus_epi16(y1, y2), LANE_ORDER);
+}
+
+/* compute one chrominance (U or V) component of 32 BGRX pixels */
+static INLINE __m256i avx2_BGRX_chroma(const __m256i x[4], __m256i factors)
+{
+	const __m256i c1 = _mm256_srai_epi16(
+	    _mm256_hadd_epi16(_mm256_maddubs_epi16(x[0], factors), _mm256_maddubs_epi16(x[1], factors)),
+	    U_SHIFT);
+	const __m256i c2 = _mm256_srai_epi16(
+	    _mm256_hadd_epi16(_mm256_maddubs_epi16(x[2], factors), _mm256_maddubs_epi16(x[3], factors)),
+	    U_SHIFT);
+	const __m256i c = _mm256_sub_epi8(_mm256_packs_epi16(c1, c2), CONST128_FACTORS);
+	return _mm256_permutevar8x32_epi32(c, LANE_ORDER);
+}
+
+/* compute U (low half) and V (high half) of 16 BGRX pixels */
+static INLINE __m256i avx2_BGRX_UV(__m256i x1, __m256i x2)
+{
+	const __m256i u_factors = BGRX_U_FACTORS;
+	const __m256i v_factors = BGRX_V_FACTORS;
+	const __m256i u = _mm256_srai_epi16(
+	    _mm256_hadd_epi16(_mm256_maddubs_epi16(x1, u_factors), _mm256_maddubs_epi16(x2, u_factors)),
+	    U_SHIFT);
+	const __m256i v = _mm256_srai_epi16(
+	    _mm256_hadd_epi16(_mm256_maddubs_epi16(x1, v_factors), _mm256_maddubs_epi16(x2, v_factors)),
+	    V_SHIFT);
+	const __m256i uv = _mm256_sub_epi8(_mm256_packs_epi16(u, v), CONST128_FACTORS);
+	return _mm256_permutevar8x32_epi32(uv, LANE_ORDER);
+}
+
+static INLINE __m128i avx2_even_bytes(__m256i v)
+{
+	const __m256i mask = _mm256_setr_epi8(
+	    0, 2, 4, 6, 8, 10, 12, 14, -128, -128, -128, -128, -128, -128, -128, -128, 0, 2, 4, 6, 8,
+	    10, 12, 14, -128, -128, -128, -128, -128, -128, -128, -128);
+	const __m256i s = _mm256_shuffle_epi8(v, mask);
+	return _mm256_castsi256_si128(_mm256_permute4x64_epi64(s, _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+static INLINE __m128i avx2_odd_bytes(__m256i v)
+{
+	const __m256i mask = _mm256_setr_epi8(
+	    1, 3, 5, 7, 9, 11, 13, 15, -128, -128, -128, -128, -128, -128, -128, -128, 1, 3, 5, 7, 9,
+	    11, 13, 15, -128, -128, -128, -128, -128, -128, -128, -128);
+	const __m256i s = _mm256_shuffle_epi8(v, mask);
+	return _mm256_castsi256_si128(_mm256_permute4x64_epi64(s, _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+/* truncated average of each 2x2 block, the same as the SSSE3 (a + b + c + d) >> 2 */
+static INLINE __m128i avx2_average_2x2(__m256i even, __m256i odd)
+{
+	const __m256i ones = _mm256_set1_epi8(1);
+	const __m256i sum =
+	    _mm256_add_epi16(_mm256_maddubs_epi16(even, ones), _mm256_maddubs_epi16(odd, ones));
+	const __m256i avg = _mm256_srli_epi16(sum, 2);
+	const __m256i packed = _mm256_packus_epi16(avg, avg);
+	return _mm256_castsi256_si128(_mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+/* store bytes 4x to \b dst1 and bytes 4x+2 to \b dst2 */
+static INLINE void avx2_store_quarters(__m256i v, BYTE* WINPR_RESTRICT dst1,
+                                       BYTE* WINPR_RESTRICT dst2)
+{
+	const __m256i mask =
+	    _mm256_setr_epi8(0, 4, 8, 12, 2, 6, 10, 14, -128, -128, -128, -128, -128, -128, -128, -128,
+	                     0, 4, 8, 12, 2, 6, 10, 14, -128, -128, -128, -128, -128, -128, -128, -128);
+	const __m256i s = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, mask), LANE_ORDER);
+	const __m128i q = _mm256_castsi256_si128(s);
+	_mm_storel_epi64((__m128i*)dst1, q);
+	_mm_storel_epi64((__m128i*)dst2, _mm_srli_si128(q, 8));
+}
+
+static INLINE void avx2_load_BGRX(const BYTE* WINPR_RESTRICT src, __m256i x[4])
+{
+	const __m256i* argb = (const __m256i*)src;
+	x[0] = _mm256_loadu_si256(argb++);
+	x[1] = _mm256_loadu_si256(argb++);
+	x[2] = _mm256_loadu_si256(argb++);
+	x[3] = _mm256_loadu_si256(argb++);
+}
+
+/****************************************************************************/
+/* AVX2 RGB -> YUV420 conversion                                            */
+/****************************************************************************/
+
+/* subsample 16x2 pixels to 8 pixels, in order */
+static INLINE __m256i avx2_subsample_2x2(__m256i a1, __m256i a2, __m256i b1, __m256i b2)
+{
+	const __m256i x1 = _mm256_avg_epu8(a1, b1);
+	const __m256i x2 = _mm256_avg_epu8(a2, b2);
+	const __m256 f1 = _mm256_castsi256_ps(x1);
+	const __m256 f2 = _mm256_castsi256_ps(x2);
+	const __m256i even = _mm256_castps_si256(_mm256_shuffle_ps(f1, f2, 0x88));
+	const __m256i odd = _mm256_castps_si256(_mm256_shuffle_ps(f1, f2, 0xdd));
+	return _mm256_permute4x64_epi64(_mm256_avg_epu8(even, odd), _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+static INLINE void avx2_RGBToYUV420_BGRX_DOUBLE_ROW(const BYTE* WINPR_RESTRICT src1,
+                                                    const BYTE* WINPR_RESTRICT src2,
+                                                    BYTE* WINPR_RESTRICT ydst1,
+                                                    BYTE* WINPR_RESTRICT ydst2,
+                                                    BYTE* WINPR_RESTRICT udst,
+                                                    BYTE* WINPR_RESTRICT vdst, UINT32 width)
+{
+	for (UINT32 x = 0; x < width; x += 32)
+	{
+		__m256i xe[4];
+		__m256i xo[4];
+		avx2_load_BGRX(&src1[4ULL * x], xe);
+		avx2_load_BGRX(&src2[4ULL * x], xo);
+		_mm256_storeu_si256((__m256i*)&ydst1[x], avx2_BGRX_Y(xe));
+
+		if (ydst2)
+			_mm256_storeu_si256((__m256i*)&ydst2[x], avx2_BGRX_Y(xo));
+
+		{
+			const __m256i s1 = avx2_subsample_2x2(xe[0], xe[1], xo[0], xo[1]);
+			const __m256i s2 = avx2_subsample_2x2(xe[2], xe[3], xo[2], xo[3]);
+			const __m256i uv = avx2_BGRX_UV(s1, s2);
+			_mm_storeu_si128((__m128i*)&udst[x / 2], _mm256_castsi256_si128(uv));
+			_mm_storeu_si128((__m128i*)&vdst[x / 2], _mm256_extracti128_si256(uv, 1));
+		}
+	}
+}
+
+static pstatus_t avx2_RGBToYUV420_BGRX(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcFormat,
+                                       UINT32 srcStep, BYTE* WINPR_RESTRICT pDst[],
+                                       const UINT32 dstStep[],
+                                       const prim_size_t* WINPR_RESTRICT roi)
+{
+	const BYTE* argb = pSrc;
+	BYTE* ydst = pDst[0];
+	BYTE* udst = pDst[1];
+	BYTE* vdst = pDst[2];
+
+	if (roi->height < 1 || roi->width < 1)
+		return !PRIMITIVES_SUCCESS;
+
+	if (roi->width % 32)
+		return fallbackRGBToYUV420(pSrc, srcFormat, srcStep, pDst, dstStep, roi);
+
+	for (UINT32 y = 0; y < roi->height - 1; y += 2)
+	{
+		avx2_RGBToYUV420_BGRX_DOUBLE_ROW(argb, argb + srcStep, ydst, ydst + dstStep[0], udst, vdst,
+		                                 roi->width);
+		argb += 2ULL * srcStep;
+		ydst += 2ULL * dstStep[0];
+		udst += dstStep[1];
+		vdst += dstStep[2];
+	}
+
+	if (roi->height & 1)
+	{
+		/* pass the same last line of an odd height twice for UV */
+		avx2_RGBToYUV420_BGRX_DOUBLE_ROW(argb, argb, ydst, NULL, udst, vdst, roi->width);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_RGBToYUV420(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcFormat, UINT32 srcStep,
+                                  BYTE* WINPR_RESTRICT pDst[], const UINT32 dstStep[],
+                                  const prim_size_t* WINPR_RESTRICT roi)
+{
+	switch (srcFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx2_RGBToYUV420_BGRX(pSrc, srcFormat, srcStep, pDst, dstStep, roi);
+
+		default:
+			return fallbackRGBToYUV420(pSrc, srcFormat, srcStep, pDst, dstStep, roi);
+	}
+}
+
+/****************************************************************************/
+/* AVX2 RGB -> AVC444-YUV conversion                                       **/
+/****************************************************************************/
+
+/* Both rows are converted once and every output plane, main and auxiliary view, is written
+ * from the same registers. See ssse3_RGBToAVC444YUV_BGRX_DOUBLE_ROW for the layout. */
+static INLINE void avx2_RGBToAVC444YUV_BGRX_DOUBLE_ROW(
+    const BYTE* WINPR_RESTRICT srcEven, const BYTE* WINPR_RESTRICT srcOdd,
+    BYTE* WINPR_RESTRICT b1Even, BYTE* WINPR_RESTRICT b1Odd, BYTE* WINPR_RESTRICT b2,
+    BYTE* WINPR_RESTRICT b3, BYTE* WINPR_RESTRICT b4, BYTE* WINPR_RESTRICT b5,
+    BYTE* WINPR_RESTRICT b6, BYTE* WINPR_RESTRICT b7, UINT32 width)
+{
+	for (UINT32 x = 0; x < width; x += 32)
+	{
+		__m256i xe[4];
+		avx2_load_BGRX(&srcEven[4ULL * x], xe);
+		const __m256i ue = avx2_BGRX_chroma(xe, BGRX_U_FACTORS);
+		const __m256i ve = avx2_BGRX_chroma(xe, BGRX_V_FACTORS);
+		_mm256_storeu_si256((__m256i*)&b1Even[x], avx2_BGRX_Y(xe));
+
+		if (b1Odd)
+		{
+			__m256i xo[4];
+			avx2_load_BGRX(&srcOdd[4ULL * x], xo);
+			const __m256i uo = avx2_BGRX_chroma(xo, BGRX_U_FACTORS);
+			const __m256i vo = avx2_BGRX_chroma(xo, BGRX_V_FACTORS);
+			_mm256_storeu_si256((__m256i*)&b1Odd[x], avx2_BGRX_Y(xo));
+			/* 2x 2y -> b2, b3 */
+			_mm_storeu_si128((__m128i*)&b2[x / 2], avx2_average_2x2(ue, uo));
+			_mm_storeu_si128((__m128i*)&b3[x / 2], avx2_average_2x2(ve, vo));
+			/* x 2y+1 -> b4, b5 */
+			_mm256_storeu_si256((__m256i*)&b4[x], uo);
+			_mm256_storeu_si256((__m256i*)&b5[x], vo);
+		}
+		else
+		{
+			_mm_storeu_si128((__m128i*)&b2[x / 2], avx2_even_bytes(ue));
+			_mm_storeu_si128((__m128i*)&b3[x / 2], avx2_even_bytes(ve));
+		}
+
+		/* 2x+1 2y -> b6, b7 */
+		_mm_storeu_si128((__m128i*)&b6[x / 2], avx2_odd_bytes(ue));
+		_mm_storeu_si128((__m128i*)&b7[x / 2], avx2_odd_bytes(ve));
+	}
+}
+
+static pstatus_t avx2_RGBToAVC444YUV_BGRX(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcFormat,
+                                          UINT32 srcStep, BYTE* WINPR_RESTRICT pDst1[],
+                                          const UINT32 dst1Step[], BYTE* WINPR_RESTRICT pDst2[],
+                                          const UINT32 dst2Step[],
+                                          const prim_size_t* WINPR_RESTRICT roi)
+{
+	if (roi->height < 1 || roi->width < 1)
+		return !PRIMITIVES_SUCCESS;
+
+	if (roi->width % 32)
+		return fallbackRGBToAVC444YUV(pSrc, srcFormat, srcStep, pDst1, dst1Step, pDst2, dst2Step,
+		                              roi);
+
+	for (UINT32 y = 0; y < roi->height; y += 2)
+	{
+		const BOOL last = (y >= (roi->height - 1));
+		const BYTE* srcEven = pSrc + 1ULL * y * srcStep;
+		const BYTE* srcOdd = !last ? srcEven + srcStep : NULL;
+		const UINT32 i = y >> 1;
+		const UINT32 n = (i & ~7) + i;
+		BYTE* b1Even = pDst1[0] + 1ULL * y * dst1Step[0];
+		BYTE* b1Odd = !last ? (b1Even + dst1Step[0]) : NULL;
+		BYTE* b2 = pDst1[1] + 1ULL * (y / 2) * dst1Step[1];
+		BYTE* b3 = pDst1[2] + 1ULL * (y / 2) * dst1Step[2];
+		BYTE* b4 = pDst2[0] + 1ULL * dst2Step[0] * n;
+		BYTE* b5 = b4 + 8ULL * dst2Step[0];
+		BYTE* b6 = pDst2[1] + 1ULL * (y / 2) * dst2Step[1];
+		BYTE* b7 = pDst2[2] + 1ULL * (y / 2) * dst2Step[2];
+		avx2_RGBToAVC444YUV_BGRX_DOUBLE_ROW(srcEven, srcOdd, b1Even, b1Odd, b2, b3, b4, b5, b6, b7,
+		                                    roi->width);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_RGBToAVC444YUV(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcFormat,
+                                     UINT32 srcStep, BYTE* WINPR_RESTRICT pDst1[],
+                                     const UINT32 dst1Step[], BYTE* WINPR_RESTRICT pDst2[],
+                                     const UINT32 dst2Step[],
+                                     const prim_size_t* WINPR_RESTRICT roi)
+{
+	switch (srcFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx2_RGBToAVC444YUV_BGRX(pSrc, srcFormat, srcStep, pDst1, dst1Step, pDst2,
+			                                dst2Step, roi);
+
+		default:
+			return fallbackRGBToAVC444YUV(pSrc, srcFormat, srcStep, pDst1, dst1Step, pDst2,
+			                              dst2Step, roi);
+	}
+}
+
+/* See ssse3_RGBToAVC444YUVv2_BGRX_DOUBLE_ROW for the layout */
+static INLINE void avx2_RGBToAVC444YUVv2_BGRX_DOUBLE_ROW(
+    const BYTE* WINPR_RESTRICT srcEven, const BYTE* WINPR_RESTRICT srcOdd,
+    BYTE* WINPR_RESTRICT yLumaDstEven, BYTE* WINPR_RESTRICT yLumaDstOdd,
+    BYTE* WINPR_RESTRICT uLumaDst, BYTE* WINPR_RESTRICT vLumaDst,
+    BYTE* WINPR_RESTRICT yEvenChromaDst1, BYTE* WINPR_RESTRICT yEvenChromaDst2,
+    BYTE* WINPR_RESTRICT yOddChromaDst1, BYTE* WINPR_RESTRICT yOddChromaDst2,
+    BYTE* WINPR_RESTRICT uChromaDst1, BYTE* WINPR_RESTRICT uChromaDst2,
+    BYTE* WINPR_RESTRICT vChromaDst1, BYTE* WINPR_RESTRICT vChromaDst2, UINT32 width)
+{
+	for (UINT32 x = 0; x < width; x += 32)
+	{
+		__m256i xe[4];
+		avx2_load_BGRX(&srcEven[4ULL * x], xe);
+		const __m256i ue = avx2_BGRX_chroma(xe, BGRX_U_FACTORS);
+		const __m256i ve = avx2_BGRX_chroma(xe, BGRX_V_FACTORS);
+		_mm256_storeu_si256((__m256i*)&yLumaDstEven[x], avx2_BGRX_Y(xe));
+		/* 2x+1 y -> yChromaDst1, yChromaDst2 */
+		_mm_storeu_si128((__m128i*)&yEvenChromaDst1[x / 2], avx2_odd_bytes(ue));
+		_mm_storeu_si128((__m128i*)&yEvenChromaDst2[x / 2], avx2_odd_bytes(ve));
+
+		if (yLumaDstOdd)
+		{
+			__m256i xo[4];
+			avx2_load_BGRX(&srcOdd[4ULL * x], xo);
+			const __m256i uo = avx2_BGRX_chroma(xo, BGRX_U_FACTORS);
+			const __m256i vo = avx2_BGRX_chroma(xo, BGRX_V_FACTORS);
+			_mm256_storeu_si256((__m256i*)&yLumaDstOdd[x], avx2_BGRX_Y(xo));
+			_mm_storeu_si128((__m128i*)&yOddChromaDst1[x / 2], avx2_odd_bytes(uo));
+			_mm_storeu_si128((__m128i*)&yOddChromaDst2[x / 2], avx2_odd_bytes(vo));
+			/* 4x 2y+1 -> uChromaDst, 4x+2 2y+1 -> vChromaDst */
+			avx2_store_quarters(uo, &uChromaDst1[x / 4], &vChromaDst1[x / 4]);
+			avx2_store_quarters(vo, &uChromaDst2[x / 4], &vChromaDst2[x / 4]);
+			/* 2x 2y -> uLumaDst, vLumaDst */
+			_mm_storeu_si128((__m128i*)&uLumaDst[x / 2], avx2_average_2x2(ue, uo));
+			_mm_storeu_si128((__m128i*)&vLumaDst[x / 2], avx2_average_2x2(ve, vo));
+		}
+		else
+		{
+			_mm_storeu_si128((__m128i*)&uLumaDst[x / 2], avx2_even_bytes(ue));
+			_mm_storeu_si128((__m128i*)&vLumaDst[x / 2], avx2_even_bytes(ve));
+		}
+	}
+}
+
+static pstatus_t avx2_RGBToAVC444YUVv2_BGRX(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcFormat,
+                                            UINT32 srcStep, BYTE* WINPR_RESTRICT pDst1[],
+                                            const UINT32 dst1Step[], BYTE* WINPR_RESTRICT pDst2[],
+                                            const UINT32 dst2Step[],
+                                            const prim_size_t* WINPR_RESTRICT roi)
+{
+	if (roi->height < 1 || roi->width < 1)
+		return !PRIMITIVES_SUCCESS;
+
+	if (roi->width % 32)
+		return fallbackRGBToAVC444YUVv2(pSrc, srcFormat, srcStep, pDst1, dst1Step, pDst2,
+		                                dst2Step, roi);
+
+	for (UINT32 y = 0; y < roi->height; y += 2)
+	{
+		const BOOL last = (y >= (roi->height - 1));
+		const BYTE* srcEven = pSrc + 1ULL * y * srcStep;
+		const BYTE* srcOdd = !last ? srcEven + srcStep : NULL;
+		BYTE* dstLumaYEven = pDst1[0] + 1ULL * y * dst1Step[0];
+		BYTE* dstLumaYOdd = !last ? (dstLumaYEven + dst1Step[0]) : NULL;
+		BYTE* dstLumaU = pDst1[1] + 1ULL * (y / 2) * dst1Step[1];
+		BYTE* dstLumaV = pDst1[2] + 1ULL * (y / 2) * dst1Step[2];
+		BYTE* dstEvenChromaY1 = pDst2[0] + 1ULL * y * dst2Step[0];
+		BYTE* dstEvenChromaY2 = dstEvenChromaY1 + roi->width / 2;
+		BYTE* dstOddChromaY1 = dstEvenChromaY1 + dst2Step[0];
+		BYTE* dstOddChromaY2 = dstEvenChromaY2 + dst2Step[0];
+		BYTE* dstChromaU1 = pDst2[1] + 1ULL * (y / 2) * dst2Step[1];
+		BYTE* dstChromaV1 = pDst2[2] + 1ULL * (y / 2) * dst2Step[2];
+		BYTE* dstChromaU2 = dstChromaU1 + roi->width / 4;
+		BYTE* dstChromaV2 = dstChromaV1 + roi->width / 4;
+		avx2_RGBToAVC444YUVv2_BGRX_DOUBLE_ROW(srcEven, srcOdd, dstLumaYEven, dstLumaYOdd, dstLumaU,
+		                                      dstLumaV, dstEvenChromaY1, dstEvenChromaY2,
+		                                      dstOddChromaY1, dstOddChromaY2, dstChromaU1,
+		                                      dstChromaU2, dstChromaV1, dstChromaV2, roi->width);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_RGBToAVC444YUVv2(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcFormat,
+                                       UINT32 srcStep, BYTE* WINPR_RESTRICT pDst1[],
+                                       const UINT32 dst1Step[], BYTE* WINPR_RESTRICT pDst2[],
+                                       const UINT32 dst2Step[],
+                                       const prim_size_t* WINPR_RESTRICT roi)
+{
+	switch (srcFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx2_RGBToAVC444YUVv2_BGRX(pSrc, srcFormat, srcStep, pDst1, dst1Step, pDst2,
+			                                  dst2Step, roi);
+
+		default:
+			return fallbackRGBToAVC444YUVv2(pSrc, srcFormat, srcStep, pDst1, dst1Step, pDst2,
+			                                dst2Step, roi);
+	}
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_YUV_avx2(primitives_t* WINPR_RESTRICT prims)
+{
+#if defined(WITH_SSE2)
+	if (IsProcessorFeaturePresent(PF_AVX2_INSTRUCTIONS_AVAILABLE))
+	{
+		fallbackRGBToYUV420 = prims->RGBToYUV420_8u_P3AC4R;
+		fallbackRGBToAVC444YUV = prims->RGBToAVC444YUV;
+		fallbackRGBToAVC444YUVv2 = prims->RGBToAVC444YUVv2;
+		prims->RGBToYUV420_8u_P3AC4R = avx2_RGBToYUV420;
+		prims->RGBToAVC444YUV = avx2_RGBToAVC444YUV;
+		prims->RGBToAVC444YUVv2 = avx2_RGBToAVC444YUVv2;
+	}
+#else
+	WINPR_UNUSED(prims);
+#endif
+}
@@ -1512,4 +1512,6 @@ void primitives_init_YUV_opt(primitives_t* WINPR_RESTRICT prims)
 		prims->YUV444ToRGB_8u_P3AC4R = ssse3_YUV444ToRGB_8u_P3AC4R;
 		prims->YUV420CombineToYUV444 = ssse3_YUV420CombineToYUV444;
 	}
+
+	primitives_init_YUV_avx2(prims);
 }
@@ -0,0 +1,53 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * Glyph mask expansion
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+
+#include "prim_internal.h"
+
+/* ----------------------------------------------------------------------------
+ * Expand an 8 bit coverage mask to 32 bit pixels.
+ * 0x00 keeps the destination, 0xFF writes the fore color, anything else the back color.
+ */
+static pstatus_t general_expandMask_8u32u(const BYTE* WINPR_RESTRICT pMask, UINT32 maskStep,
+                                          BYTE* WINPR_RESTRICT pDst, UINT32 dstStep, UINT32 width,
+                                          UINT32 height, UINT32 foreColor, UINT32 backColor)
+{
+	for (UINT32 y = 0; y < height; y++)
+	{
+		const BYTE* mask = &pMask[1ull * y * maskStep];
+		UINT32* dst = (UINT32*)&pDst[1ull * y * dstStep];
+
+		for (UINT32 x = 0; x < width; x++)
+		{
+			const BYTE m = mask[x];
+
+			if (m == PRIM_MASK_FORE)
+				dst[x] = foreColor;
+			else if (m != PRIM_MASK_NONE)
+				dst[x] = backColor;
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_glyph(primitives_t* prims)
+{
+	prims->expandMask_8u32u = general_expandMask_8u32u;
+}
@@ -0,0 +1,108 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * Optimized glyph mask expansion
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+#include <winpr/sysinfo.h>
+
+#ifdef WITH_SSE2
+#include <emmintrin.h>
+#endif /* WITH_SSE2 */
+
+#include "prim_internal.h"
+
+static primitives_t* generic = NULL;
+
+#ifdef WITH_SSE2
+/* Select 4 pixels, keep and fore hold one mask byte widened to each 32 bit lane */
+static INLINE __m128i sse2_select_4px(__m128i keep, __m128i fore, __m128i dst, __m128i fg,
+                                      __m128i bg)
+{
+	const __m128i px = _mm_or_si128(_mm_and_si128(fore, fg), _mm_andnot_si128(fore, bg));
+	return _mm_or_si128(_mm_and_si128(keep, dst), _mm_andnot_si128(keep, px));
+}
+
+static pstatus_t sse2_expandMask_8u32u(const BYTE* WINPR_RESTRICT pMask, UINT32 maskStep,
+                                       BYTE* WINPR_RESTRICT pDst, UINT32 dstStep, UINT32 width,
+                                       UINT32 height, UINT32 foreColor, UINT32 backColor)
+{
+	const UINT32 blocks = width & ~15u;
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_set1_epi8((char)PRIM_MASK_FORE);
+	const __m128i fg = _mm_set1_epi32((int)foreColor);
+	const __m128i bg = _mm_set1_epi32((int)backColor);
+
+	for (UINT32 y = 0; y < height; y++)
+	{
+		const BYTE* mask = &pMask[1ull * y * maskStep];
+		BYTE* dst = &pDst[1ull * y * dstStep];
+
+		for (UINT32 x = 0; x < blocks; x += 16)
+		{
+			const __m128i m = _mm_loadu_si128((const __m128i*)&mask[x]);
+			const __m128i keep = _mm_cmpeq_epi8(m, zero);
+			const __m128i fore = _mm_cmpeq_epi8(m, ones);
+			const int keepBits = _mm_movemask_epi8(keep);
+
+			/* sparse text leaves most of a run untouched */
+			if (keepBits == 0xFFFF)
+				continue;
+
+			const __m128i keepLo = _mm_unpacklo_epi8(keep, keep);
+			const __m128i keepHi = _mm_unpackhi_epi8(keep, keep);
+			const __m128i foreLo = _mm_unpacklo_epi8(fore, fore);
+			const __m128i foreHi = _mm_unpackhi_epi8(fore, fore);
+			const __m128i keep32[4] = { _mm_unpacklo_epi16(keepLo, keepLo),
+				                        _mm_unpackhi_epi16(keepLo, keepLo),
+				                        _mm_unpacklo_epi16(keepHi, keepHi),
+				                        _mm_unpackhi_epi16(keepHi, keepHi) };
+			const __m128i fore32[4] = { _mm_unpacklo_epi16(foreLo, foreLo),
+				                        _mm_unpackhi_epi16(foreLo, foreLo),
+				                        _mm_unpacklo_epi16(foreHi, foreHi),
+				                        _mm_unpackhi_epi16(foreHi, foreHi) };
+
+			for (size_t k = 0; k < 4; k++)
+			{
+				__m128i* out = (__m128i*)&dst[4ull * (x + 4 * k)];
+				/* fully covered pixels do not need the destination */
+				const __m128i d = (keepBits != 0) ? _mm_loadu_si128(out) : zero;
+				_mm_storeu_si128(out, sse2_select_4px(keep32[k], fore32[k], d, fg, bg));
+			}
+		}
+	}
+
+	if (blocks == width)
+		return PRIMITIVES_SUCCESS;
+
+	return generic->expandMask_8u32u(&pMask[blocks], maskStep, &pDst[4ull * blocks], dstStep,
+	                                 width - blocks, height, foreColor, backColor);
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_glyph_opt(primitives_t* WINPR_RESTRICT prims)
+{
+	generic = primitives_get_generic();
+	primitives_init_glyph(prims);
+#if defined(WITH_SSE2)
+
+	if (IsProcessorFeaturePresent(PF_SSE2_INSTRUCTIONS_AVAILABLE))
+	{
+		prims->expandMask_8u32u = sse2_expandMask_8u32u;
+	}
+
+#endif
+}
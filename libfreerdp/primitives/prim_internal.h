@@ -268,6 +268,7 @@ FREERDP_LOCAL void primitives_init_copy(primitives_t* prims);
 FREERDP_LOCAL void primitives_init_set(primitives_t* prims);
 FREERDP_LOCAL void primitives_init_add(primitives_t* prims);
 FREERDP_LOCAL void primitives_init_andor(primitives_t* prims);
+FREERDP_LOCAL void primitives_init_glyph(primitives_t* prims);
 FREERDP_LOCAL void primitives_init_shift(primitives_t* prims);
 FREERDP_LOCAL void primitives_init_sign(primitives_t* prims);
 FREERDP_LOCAL void primitives_init_alphaComp(primitives_t* prims);
@@ -280,6 +281,7 @@ FREERDP_LOCAL void primitives_init_copy_opt(primitives_t* prims);
 FREERDP_LOCAL void primitives_init_set_opt(primitives_t* prims);
 FREERDP_LOCAL void primitives_init_add_opt(primitives_t* prims);
 FREERDP_LOCAL void primitives_init_andor_opt(primitives_t* prims);
+FREERDP_LOCAL void primitives_init_glyph_opt(primitives_t* prims);
 FREERDP_LOCAL void primitives_init_shift_opt(primitives_t* prims);
 FREERDP_LOCAL void primitives_init_sign_opt(primitives_t* prims);
 FREERDP_LOCAL void primitives_init_alphaComp_opt(primitives_t* prims);
@@ -288,6 +290,10 @@ FREERDP_LOCAL void primitives_init_YCoCg_opt(primitives_t* prims);
 FREERDP_LOCAL void primitives_init_YUV_opt(primitives_t* prims);
 #endif
 
+#if defined(WITH_SSE2)
+FREERDP_LOCAL void primitives_init_YUV_avx2(primitives_t* prims);
+#endif
+
 #if defined(WITH_OPENCL)
 FREERDP_LOCAL BOOL primitives_init_opencl(primitives_t* prims);
 #endif
@@ -69,6 +69,7 @@ static BOOL primitives_init_generic(primitives_t* prims)
 {
 	primitives_init_add(prims);
 	primitives_init_andor(prims);
+	primitives_init_glyph(prims);
 	primitives_init_alphaComp(prims);
 	primitives_init_copy(prims);
 	primitives_init_set(prims);
@@ -96,6 +97,7 @@ static BOOL primitives_init_optimized(primitives_t* prims)
 #if defined(HAVE_CPU_OPTIMIZED_PRIMITIVES)
 	primitives_init_add_opt(prims);
 	primitives_init_andor_opt(prims);
+	primitives_init_glyph_opt(prims);
 	primitives_init_alphaComp_opt(prims);
 	primitives_init_copy_opt(prims);
 	primitives_init_set_opt(prims);
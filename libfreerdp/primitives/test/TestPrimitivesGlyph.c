@@ -0,0 +1,144 @@
+/* test_glyph.c
+ * vi:ts=4 sw=4
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/sysinfo.h>
+#include "prim_test.h"
+
+#define TEST_WIDTH 67
+#define TEST_HEIGHT 13
+#define TEST_FORE (0xFF102030U)
+#define TEST_BACK (0xFFC0C0C0U)
+
+/* ========================================================================= */
+static BOOL test_expandMask_impl(const char* name, __expandMask_8u32u_t fkt, const BYTE* mask,
+                                 const UINT32* org, UINT32* dst, UINT32 width)
+{
+	const UINT32 maskStep = TEST_WIDTH + 1;
+	const UINT32 dstStep = (TEST_WIDTH + 1) * sizeof(UINT32);
+
+	memcpy(dst, org, 1ull * (TEST_WIDTH + 1) * TEST_HEIGHT * sizeof(UINT32));
+
+	pstatus_t status = fkt(mask, maskStep, (BYTE*)dst, dstStep, width, TEST_HEIGHT, TEST_FORE,
+	                       TEST_BACK);
+	if (status != PRIMITIVES_SUCCESS)
+		return FALSE;
+
+	for (size_t y = 0; y < TEST_HEIGHT; y++)
+	{
+		for (size_t x = 0; x < TEST_WIDTH + 1; x++)
+		{
+			const size_t i = y * (TEST_WIDTH + 1) + x;
+			UINT32 expect = org[i];
+
+			if ((x < width) && (mask[y * maskStep + x] == PRIM_MASK_FORE))
+				expect = TEST_FORE;
+			else if ((x < width) && (mask[y * maskStep + x] != PRIM_MASK_NONE))
+				expect = TEST_BACK;
+
+			if (dst[i] != expect)
+			{
+				printf("EXPAND %s FAIL[%" PRIuz ",%" PRIuz "] mask 0x%02" PRIx8
+				       " expected 0x%08" PRIx32 ", got 0x%08" PRIx32 "\n",
+				       name, x, y, mask[y * maskStep + x], expect, dst[i]);
+				return FALSE;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+static BOOL test_expandMask_func(void)
+{
+	BYTE mask[(TEST_WIDTH + 1) * TEST_HEIGHT] = { 0 };
+	UINT32 org[(TEST_WIDTH + 1) * TEST_HEIGHT] = { 0 };
+	UINT32 dst[(TEST_WIDTH + 1) * TEST_HEIGHT] = { 0 };
+
+	winpr_RAND(org, sizeof(org));
+	winpr_RAND(mask, sizeof(mask));
+
+	/* mostly empty and fully covered blocks with a few background bytes */
+	for (size_t i = 0; i < ARRAYSIZE(mask); i++)
+	{
+		if (mask[i] < 0x80)
+			mask[i] = PRIM_MASK_NONE;
+		else if (mask[i] < 0xF0)
+			mask[i] = PRIM_MASK_FORE;
+		else if (i % 32 < 16)
+			mask[i] = PRIM_MASK_NONE;
+	}
+	memset(&mask[TEST_WIDTH + 1], PRIM_MASK_FORE, 32);
+	memset(&mask[2 * (TEST_WIDTH + 1)], PRIM_MASK_BACK, 32);
+
+	/* odd widths cover the scalar tail of the optimized version */
+	const UINT32 widths[] = { TEST_WIDTH, 64, 16, 15, 1 };
+	for (size_t x = 0; x < ARRAYSIZE(widths); x++)
+	{
+		if (!test_expandMask_impl("generic->expandMask_8u32u", generic->expandMask_8u32u, mask,
+		                          org, dst, widths[x]))
+			return FALSE;
+		if (!test_expandMask_impl("optimized->expandMask_8u32u", optimized->expandMask_8u32u,
+		                          mask, org, dst, widths[x]))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* ------------------------------------------------------------------------- */
+static BOOL test_expandMask_speed(void)
+{
+	const UINT32 width = 1024;
+	const UINT32 height = 32;
+	BYTE* mask = calloc(1ull * width, height);
+	UINT32* dst = calloc(1ull * width * height, sizeof(UINT32));
+	BOOL rc = FALSE;
+
+	if (!mask || !dst)
+		goto fail;
+
+	/* a line of text, about a fifth of the pixels are set */
+	winpr_RAND(mask, 1ull * width * height);
+	for (size_t i = 0; i < 1ull * width * height; i++)
+		mask[i] = (mask[i] < 0x33) ? PRIM_MASK_FORE : PRIM_MASK_NONE;
+
+	rc = speed_test("expandMask_8u32u", "text", g_Iterations,
+	                (speed_test_fkt)generic->expandMask_8u32u,
+	                (speed_test_fkt)optimized->expandMask_8u32u, mask, width, dst,
+	                width * sizeof(UINT32), width, height, TEST_FORE, TEST_BACK);
+fail:
+	free(mask);
+	free(dst);
+	return rc;
+}
+
+int TestPrimitivesGlyph(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	prim_test_setup(FALSE);
+
+	if (!test_expandMask_func())
+		return -1;
+
+	if (g_TestPrimitivesPerformance)
+	{
+		if (!test_expandMask_speed())
+			return -1;
+	}
+
+	return 0;
+}
@@ -873,6 +873,287 @@ fail:
 	return res;
 }
 
+#if defined(WITH_SSE2)
+/* Scalar model of the fixed point arithmetic of the SSSE3 and AVX2 BGRX kernels.
+ * The optimized implementations must match it bit by bit. */
+static BYTE ref_Y(const BYTE* bgrx)
+{
+	return (BYTE)((9 * bgrx[0] + 92 * bgrx[1] + 27 * bgrx[2]) >> 7);
+}
+
+static BYTE ref_U(const BYTE* bgrx)
+{
+	return (BYTE)(((127 * bgrx[0] - 99 * bgrx[1] - 29 * bgrx[2]) >> 8) + 128);
+}
+
+static BYTE ref_V(const BYTE* bgrx)
+{
+	return (BYTE)(((-12 * bgrx[0] - 116 * bgrx[1] + 127 * bgrx[2]) >> 8) + 128);
+}
+
+static BYTE ref_avg(BYTE a, BYTE b)
+{
+	return (BYTE)((a + b + 1) / 2);
+}
+
+static void ref_RGBToYUV420(const BYTE* pSrc, UINT32 srcStep, BYTE* pDst[3],
+                            const UINT32 dstStep[3], const prim_size_t* roi)
+{
+	for (UINT32 y = 0; y < roi->height; y++)
+	{
+		for (UINT32 x = 0; x < roi->width; x++)
+			pDst[0][y * dstStep[0] + x] = ref_Y(&pSrc[y * srcStep + 4 * x]);
+	}
+
+	for (UINT32 y = 0; y < roi->height; y += 2)
+	{
+		const BYTE* even = &pSrc[y * srcStep];
+		const BYTE* odd = (y + 1 < roi->height) ? even + srcStep : even;
+
+		for (UINT32 x = 0; x < roi->width; x += 2)
+		{
+			BYTE px[4] = { 0 };
+
+			for (size_t c = 0; c < 4; c++)
+			{
+				const BYTE left = ref_avg(even[4 * x + c], odd[4 * x + c]);
+				const BYTE right = ref_avg(even[4 * x + 4 + c], odd[4 * x + 4 + c]);
+				px[c] = ref_avg(left, right);
+			}
+
+			pDst[1][y / 2 * dstStep[1] + x / 2] = ref_U(px);
+			pDst[2][y / 2 * dstStep[2] + x / 2] = ref_V(px);
+		}
+	}
+}
+
+static BYTE ref_avg2x2(const BYTE* even, const BYTE* odd, UINT32 x,
+                       BYTE (*component)(const BYTE* bgrx))
+{
+	const UINT32 sum = component(&even[8 * x]) + component(&even[8 * x + 4]) +
+	                   component(&odd[8 * x]) + component(&odd[8 * x + 4]);
+	return (BYTE)(sum >> 2);
+}
+
+static void ref_RGBToAVC444YUV(UINT32 version, const BYTE* pSrc, UINT32 srcStep, BYTE* pDst1[3],
+                               const UINT32 dst1Step[3], BYTE* pDst2[3], const UINT32 dst2Step[3],
+                               const prim_size_t* roi)
+{
+	for (UINT32 y = 0; y < roi->height; y += 2)
+	{
+		const BOOL last = (y + 1 >= roi->height);
+		const BYTE* even = &pSrc[y * srcStep];
+		const BYTE* odd = even + srcStep;
+		const UINT32 rows = last ? 1 : 2;
+
+		for (UINT32 r = 0; r < rows; r++)
+		{
+			const BYTE* src = (r == 0) ? even : odd;
+			BYTE* yLuma = &pDst1[0][(y + r) * dst1Step[0]];
+
+			for (UINT32 x = 0; x < roi->width; x++)
+				yLuma[x] = ref_Y(&src[4 * x]);
+		}
+
+		for (UINT32 x = 0; x < roi->width / 2; x++)
+		{
+			BYTE* uLuma = &pDst1[1][y / 2 * dst1Step[1]];
+			BYTE* vLuma = &pDst1[2][y / 2 * dst1Step[2]];
+			uLuma[x] = last ? ref_U(&even[8 * x]) : ref_avg2x2(even, odd, x, ref_U);
+			vLuma[x] = last ? ref_V(&even[8 * x]) : ref_avg2x2(even, odd, x, ref_V);
+		}
+
+		if (version == 1)
+		{
+			const UINT32 i = y / 2;
+			const UINT32 n = (i & ~7u) + i;
+
+			for (UINT32 x = 0; x < roi->width / 2; x++)
+			{
+				pDst2[1][y / 2 * dst2Step[1] + x] = ref_U(&even[8 * x + 4]);
+				pDst2[2][y / 2 * dst2Step[2] + x] = ref_V(&even[8 * x + 4]);
+			}
+
+			for (UINT32 x = 0; !last && (x < roi->width); x++)
+			{
+				pDst2[0][n * dst2Step[0] + x] = ref_U(&odd[4 * x]);
+				pDst2[0][(n + 8) * dst2Step[0] + x] = ref_V(&odd[4 * x]);
+			}
+		}
+		else
+		{
+			for (UINT32 r = 0; r < rows; r++)
+			{
+				const BYTE* src = (r == 0) ? even : odd;
+				BYTE* yChroma = &pDst2[0][(y + r) * dst2Step[0]];
+
+				for (UINT32 x = 0; x < roi->width / 2; x++)
+				{
+					yChroma[x] = ref_U(&src[8 * x + 4]);
+					yChroma[roi->width / 2 + x] = ref_V(&src[8 * x + 4]);
+				}
+			}
+
+			for (UINT32 x = 0; !last && (x < roi->width / 4); x++)
+			{
+				BYTE* uChroma = &pDst2[1][y / 2 * dst2Step[1]];
+				BYTE* vChroma = &pDst2[2][y / 2 * dst2Step[2]];
+				uChroma[x] = ref_U(&odd[16 * x]);
+				vChroma[x] = ref_U(&odd[16 * x + 8]);
+				uChroma[roi->width / 4 + x] = ref_V(&odd[16 * x]);
+				vChroma[roi->width / 4 + x] = ref_V(&odd[16 * x + 8]);
+			}
+		}
+	}
+}
+
+static BOOL compare_yuv420_exact(BYTE** planesA, BYTE** planesB, UINT32 width, UINT32 height,
+                                 const char* name)
+{
+	const size_t uvsize = (height + 1) / 2 * ((width + 1) / 2);
+	const size_t sizes[3] = { 1ull * width * height, uvsize, uvsize };
+
+	for (size_t x = 0; x < 3; x++)
+	{
+		for (size_t i = 0; i < sizes[x]; i++)
+		{
+			if (planesA[x][i] != planesB[x][i])
+			{
+				fprintf(stderr,
+				        "%s plane %" PRIuz " differs at %" PRIuz ": %02" PRIX8 " != %02" PRIX8 "\n",
+				        name, x, i, planesA[x][i], planesB[x][i]);
+				return FALSE;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+static pstatus_t run_rgb_to_yuv(const primitives_t* prims, UINT32 version, const BYTE* rgb,
+                                UINT32 stride, BYTE* luma[3], BYTE* chroma[3],
+                                const UINT32 step[3], const prim_size_t* roi)
+{
+	switch (version)
+	{
+		case 0:
+			return prims->RGBToYUV420_8u_P3AC4R(rgb, PIXEL_FORMAT_BGRX32, stride, luma, step, roi);
+		case 1:
+			return prims->RGBToAVC444YUV(rgb, PIXEL_FORMAT_BGRX32, stride, luma, step, chroma,
+			                             step, roi);
+		default:
+			return prims->RGBToAVC444YUVv2(rgb, PIXEL_FORMAT_BGRX32, stride, luma, step, chroma,
+			                               step, roi);
+	}
+}
+
+/* @return the throughput in MPixel/s or a negative value on failure */
+static double time_rgb_to_yuv(const primitives_t* prims, UINT32 version, const BYTE* rgb,
+                              UINT32 stride, BYTE* luma[3], BYTE* chroma[3], const UINT32 step[3],
+                              prim_size_t roi)
+{
+	const UINT32 iterations = 10;
+	const UINT64 start = winpr_GetTickCount64NS();
+
+	for (UINT32 x = 0; x < iterations; x++)
+	{
+		if (run_rgb_to_yuv(prims, version, rgb, stride, luma, chroma, step, &roi) !=
+		    PRIMITIVES_SUCCESS)
+			return -1.0;
+	}
+
+	const UINT64 ns = winpr_GetTickCount64NS() - start;
+	return 1000.0 * iterations * roi.width * roi.height / (double)MAX(ns, 1);
+}
+
+static void fill_yuv420(BYTE** planes, UINT32 width, UINT32 height)
+{
+	const size_t uvsize = (height + 1) / 2 * ((width + 1) / 2);
+	memset(planes[0], PADDING_FILL_VALUE, 1ull * width * height);
+	memset(planes[1], PADDING_FILL_VALUE, uvsize);
+	memset(planes[2], PADDING_FILL_VALUE, uvsize);
+}
+
+/* Compare the optimized BGRX encoder kernels to the scalar model and report their throughput */
+static BOOL TestPrimitiveRgbToYUVExact(primitives_t* prims, prim_size_t roi)
+{
+	BOOL res = FALSE;
+	BYTE* rgb = NULL;
+	BYTE* luma[3] = { 0 };
+	BYTE* chroma[3] = { 0 };
+	BYTE* lumaRef[3] = { 0 };
+	BYTE* chromaRef[3] = { 0 };
+	const size_t padding = 0x1000;
+	const UINT32 awidth = (roi.width + 15) & ~15u;
+	const UINT32 aheight = (roi.height + 15) & ~15u;
+	const UINT32 stride = awidth * sizeof(UINT32);
+	const size_t size = 1ull * awidth * aheight;
+	const UINT32 step[3] = { awidth, (awidth + 1) / 2, (awidth + 1) / 2 };
+	const char* names[] = { "RGBToYUV420", "RGBToAVC444YUV", "RGBToAVC444YUVv2" };
+
+	if (!prims || !generic)
+		return FALSE;
+
+	fprintf(stderr, "Running bit exact RGB to YUV on frame size %" PRIu32 "x%" PRIu32 "\n",
+	        roi.width, roi.height);
+
+	if (!(rgb = set_padding(size * sizeof(UINT32), padding)))
+		goto fail;
+
+	if (!allocate_yuv420(luma, awidth, aheight, padding) ||
+	    !allocate_yuv420(chroma, awidth, aheight, padding) ||
+	    !allocate_yuv420(lumaRef, awidth, aheight, padding) ||
+	    !allocate_yuv420(chromaRef, awidth, aheight, padding))
+		goto fail;
+
+	winpr_RAND(rgb, size * sizeof(UINT32));
+
+	for (UINT32 version = 0; version < ARRAYSIZE(names); version++)
+	{
+		double opt = 0.0;
+		double soft = 0.0;
+
+		if (version == 0)
+			ref_RGBToYUV420(rgb, stride, lumaRef, step, &roi);
+		else
+			ref_RGBToAVC444YUV(version, rgb, stride, lumaRef, step, chromaRef, step, &roi);
+
+		opt = time_rgb_to_yuv(prims, version, rgb, stride, luma, chroma, step, roi);
+		if (opt < 0.0)
+			goto fail;
+
+		if (!check_yuv420(luma, awidth, aheight, padding) ||
+		    !check_yuv420(chroma, awidth, aheight, padding))
+			goto fail;
+
+		if (!compare_yuv420_exact(luma, lumaRef, awidth, aheight, names[version]) ||
+		    !compare_yuv420_exact(chroma, chromaRef, awidth, aheight, names[version]))
+			goto fail;
+
+		soft = time_rgb_to_yuv(generic, version, rgb, stride, luma, chroma, step, roi);
+		if (soft < 0.0)
+			goto fail;
+
+		printf("%-18s optimized %9.1f MPixel/s, generic %9.1f MPixel/s\n", names[version], opt,
+		       soft);
+
+		fill_yuv420(luma, awidth, aheight);
+		fill_yuv420(chroma, awidth, aheight);
+		fill_yuv420(lumaRef, awidth, aheight);
+		fill_yuv420(chromaRef, awidth, aheight);
+	}
+
+	res = TRUE;
+fail:
+	free_padding(rgb, padding);
+	free_yuv420(luma, padding);
+	free_yuv420(chroma, padding);
+	free_yuv420(lumaRef, padding);
+	free_yuv420(chromaRef, padding);
+	return res;
+}
+#endif
+
 int TestPrimitivesYUV(int argc, char* argv[])
 {
 	BOOL large = (argc > 1);
@@ -973,6 +1254,27 @@ int TestPrimitivesYUV(int argc, char* argv[])
 		printf("---------------------- END --------------------------\n");
 	}
 
+#if defined(WITH_SSE2)
+	if (prims->RGBToAVC444YUV != generic->RGBToAVC444YUV)
+	{
+		/* multiples of 32 use the widest kernels, 16 and 48 the SSSE3 ones */
+		const prim_size_t sizes[] = { { 16, 16 }, { 48, 33 }, { 64, 63 }, { 1920, 1080 } };
+
+		printf("------------------- OPTIMIZED -----------------------\n");
+
+		for (size_t x = 0; x < ARRAYSIZE(sizes); x++)
+		{
+			if (!TestPrimitiveRgbToYUVExact(prims, sizes[x]))
+			{
+				printf("TestPrimitiveRgbToYUVExact failed.\n");
+				goto end;
+			}
+		}
+
+		printf("---------------------- END --------------------------\n");
+	}
+#endif
+
 	rc = 0;
 end:
 	return rc;
@@ -19,6 +19,8 @@
  * limitations under the License.
  */
 
+#include <string.h>
+
 #include <freerdp/utils/drdynvc.h>
 #include <freerdp/channels/drdynvc.h>
 
@@ -48,3 +50,31 @@ const char* drdynvc_get_packet_type(BYTE cmd)
 			return "UNKNOWN";
 	}
 }
+
+BOOL drdynvc_channel_name_in_list(const char* list, const char* name)
+{
+	if (!list || !name)
+		return FALSE;
+
+	const size_t length = strlen(name);
+	const char* cur = list;
+
+	while (*cur != '\0')
+	{
+		const char* end = strchr(cur, ',');
+		if (!end)
+			end = cur + strlen(cur);
+
+		const size_t entry = (size_t)(end - cur);
+		if ((entry == 1) && (*cur == '*'))
+			return TRUE;
+		if ((entry == length) && (strncmp(cur, name, length) == 0))
+			return TRUE;
+
+		if (*end == '\0')
+			break;
+		cur = end + 1;
+	}
+
+	return FALSE;
+}
@@ -0,0 +1,335 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ *
+ * Dynamic virtual channel send scheduler
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/crt.h>
+#include <winpr/assert.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/types.h>
+#include <freerdp/utils/dvc_scheduler.h>
+
+/* Roughly 70%, 20%, 7% and 2% of the bandwidth, the charges Windows servers announce */
+static const UINT16 dvc_default_charges[DVC_PRIORITY_CLASSES] = { 936, 3276, 9362, 37449 };
+
+typedef struct s_dvc_scheduler_item
+{
+	struct s_dvc_scheduler_item* next;
+	wStream* s;
+	size_t length;
+	UINT64 enqueued;
+} DVC_SCHEDULER_ITEM;
+
+typedef struct s_dvc_scheduler_channel
+{
+	struct s_dvc_scheduler_channel* next;
+	UINT32 channelId;
+	BYTE priority;
+	DVC_SCHEDULER_ITEM* head;
+	DVC_SCHEDULER_ITEM* tail;
+} DVC_SCHEDULER_CHANNEL;
+
+typedef struct
+{
+	/* channels with queued PDUs, served round robin */
+	DVC_SCHEDULER_CHANNEL* head;
+	DVC_SCHEDULER_CHANNEL* tail;
+
+	UINT16 charge;
+	UINT64 pass;
+	DVC_SCHEDULER_STATS stats;
+} DVC_SCHEDULER_CLASS;
+
+struct s_rdp_dvc_scheduler
+{
+	CRITICAL_SECTION lock;
+	pfnDvcSchedulerStreamFree fnStreamFree;
+
+	/* virtual time, the pass of the class served last */
+	UINT64 vtime;
+	DVC_SCHEDULER_CLASS classes[DVC_PRIORITY_CLASSES];
+};
+
+static DVC_SCHEDULER_CHANNEL* dvc_scheduler_find_channel(rdpDvcScheduler* scheduler,
+                                                         UINT32 channelId)
+{
+	WINPR_ASSERT(scheduler);
+
+	for (size_t x = 0; x < DVC_PRIORITY_CLASSES; x++)
+	{
+		for (DVC_SCHEDULER_CHANNEL* channel = scheduler->classes[x].head; channel;
+		     channel = channel->next)
+		{
+			if (channel->channelId == channelId)
+				return channel;
+		}
+	}
+
+	return NULL;
+}
+
+static void dvc_scheduler_channel_append(DVC_SCHEDULER_CLASS* cls, DVC_SCHEDULER_CHANNEL* channel)
+{
+	WINPR_ASSERT(cls);
+	WINPR_ASSERT(channel);
+
+	channel->next = NULL;
+	if (cls->tail)
+		cls->tail->next = channel;
+	else
+		cls->head = channel;
+	cls->tail = channel;
+}
+
+void dvc_scheduler_set_priority_charges(rdpDvcScheduler* scheduler, const UINT16* charges,
+                                        size_t count)
+{
+	if (!scheduler)
+		return;
+
+	EnterCriticalSection(&scheduler->lock);
+	for (size_t x = 0; x < DVC_PRIORITY_CLASSES; x++)
+	{
+		const UINT16 charge = (charges && (x < count)) ? charges[x] : 0;
+		scheduler->classes[x].charge = (charge != 0) ? charge : dvc_default_charges[x];
+	}
+	LeaveCriticalSection(&scheduler->lock);
+}
+
+void dvc_scheduler_get_priority_charges(rdpDvcScheduler* scheduler, UINT16* charges,
+                                        size_t count)
+{
+	if (!scheduler || !charges)
+		return;
+
+	EnterCriticalSection(&scheduler->lock);
+	for (size_t x = 0; x < MIN(count, DVC_PRIORITY_CLASSES); x++)
+		charges[x] = scheduler->classes[x].charge;
+	LeaveCriticalSection(&scheduler->lock);
+}
+
+BOOL dvc_scheduler_enqueue(rdpDvcScheduler* scheduler, UINT32 channelId, BYTE priority,
+                           wStream* s)
+{
+	BOOL rc = FALSE;
+
+	if (!scheduler || !s)
+		return FALSE;
+
+	DVC_SCHEDULER_ITEM* item = calloc(1, sizeof(DVC_SCHEDULER_ITEM));
+	if (!item)
+	{
+		scheduler->fnStreamFree(s);
+		return FALSE;
+	}
+
+	item->s = s;
+	item->length = Stream_GetPosition(s);
+	item->enqueued = winpr_GetTickCount64NS();
+
+	EnterCriticalSection(&scheduler->lock);
+
+	/* A channel keeps its class while PDUs are queued, so its PDUs stay in order */
+	DVC_SCHEDULER_CHANNEL* channel = dvc_scheduler_find_channel(scheduler, channelId);
+	if (!channel)
+	{
+		channel = calloc(1, sizeof(DVC_SCHEDULER_CHANNEL));
+		if (!channel)
+			goto out;
+
+		channel->channelId = channelId;
+		channel->priority = MIN(priority, DVC_PRIORITY_CLASSES - 1);
+
+		/* A class that was idle must not catch up on the time it did not use */
+		DVC_SCHEDULER_CLASS* cls = &scheduler->classes[channel->priority];
+		if (!cls->head)
+			cls->pass = MAX(cls->pass, scheduler->vtime);
+		dvc_scheduler_channel_append(cls, channel);
+	}
+
+	if (channel->tail)
+		channel->tail->next = item;
+	else
+		channel->head = item;
+	channel->tail = item;
+
+	DVC_SCHEDULER_STATS* stats = &scheduler->classes[channel->priority].stats;
+	stats->QueuedChunks++;
+	stats->QueuedBytes += item->length;
+	stats->MaxQueuedBytes = MAX(stats->MaxQueuedBytes, stats->QueuedBytes);
+	item = NULL;
+	rc = TRUE;
+
+out:
+	LeaveCriticalSection(&scheduler->lock);
+	if (item)
+	{
+		scheduler->fnStreamFree(item->s);
+		free(item);
+	}
+	return rc;
+}
+
+wStream* dvc_scheduler_dequeue(rdpDvcScheduler* scheduler)
+{
+	wStream* s = NULL;
+	DVC_SCHEDULER_CLASS* cls = NULL;
+
+	if (!scheduler)
+		return NULL;
+
+	EnterCriticalSection(&scheduler->lock);
+	for (size_t x = 0; x < DVC_PRIORITY_CLASSES; x++)
+	{
+		DVC_SCHEDULER_CLASS* cur = &scheduler->classes[x];
+		if (cur->head && (!cls || (cur->pass < cls->pass)))
+			cls = cur;
+	}
+
+	if (cls)
+	{
+		DVC_SCHEDULER_CHANNEL* channel = cls->head;
+		DVC_SCHEDULER_ITEM* item = channel->head;
+		WINPR_ASSERT(item);
+
+		channel->head = item->next;
+		if (!channel->head)
+			channel->tail = NULL;
+
+		/* rotate the channel to the end of its class or drop it if it has nothing left */
+		cls->head = channel->next;
+		if (!cls->head)
+			cls->tail = NULL;
+		if (channel->head)
+			dvc_scheduler_channel_append(cls, channel);
+		else
+			free(channel);
+
+		scheduler->vtime = cls->pass;
+		cls->pass += 1ull * MAX(item->length, 1) * cls->charge;
+
+		const UINT64 waitUs = (winpr_GetTickCount64NS() - item->enqueued) / 1000ull;
+		DVC_SCHEDULER_STATS* stats = &cls->stats;
+		stats->QueuedChunks--;
+		stats->QueuedBytes -= item->length;
+		stats->SentChunks++;
+		stats->SentBytes += item->length;
+		stats->TotalWaitUs += waitUs;
+		stats->MaxWaitUs = MAX(stats->MaxWaitUs, waitUs);
+
+		s = item->s;
+		free(item);
+	}
+	LeaveCriticalSection(&scheduler->lock);
+	return s;
+}
+
+size_t dvc_scheduler_pending(rdpDvcScheduler* scheduler)
+{
+	size_t pending = 0;
+
+	if (!scheduler)
+		return 0;
+
+	EnterCriticalSection(&scheduler->lock);
+	for (size_t x = 0; x < DVC_PRIORITY_CLASSES; x++)
+		pending += scheduler->classes[x].stats.QueuedChunks;
+	LeaveCriticalSection(&scheduler->lock);
+	return pending;
+}
+
+void dvc_scheduler_clear(rdpDvcScheduler* scheduler)
+{
+	if (!scheduler)
+		return;
+
+	EnterCriticalSection(&scheduler->lock);
+	for (size_t x = 0; x < DVC_PRIORITY_CLASSES; x++)
+	{
+		DVC_SCHEDULER_CLASS* cls = &scheduler->classes[x];
+		DVC_SCHEDULER_CHANNEL* channel = cls->head;
+
+		while (channel)
+		{
+			DVC_SCHEDULER_CHANNEL* nextChannel = channel->next;
+			DVC_SCHEDULER_ITEM* item = channel->head;
+
+			while (item)
+			{
+				DVC_SCHEDULER_ITEM* next = item->next;
+				scheduler->fnStreamFree(item->s);
+				free(item);
+				item = next;
+			}
+
+			free(channel);
+			channel = nextChannel;
+		}
+
+		cls->head = cls->tail = NULL;
+		cls->pass = 0;
+		cls->stats.QueuedChunks = 0;
+		cls->stats.QueuedBytes = 0;
+	}
+	scheduler->vtime = 0;
+	LeaveCriticalSection(&scheduler->lock);
+}
+
+BOOL dvc_scheduler_get_stats(rdpDvcScheduler* scheduler, BYTE priority,
+                             DVC_SCHEDULER_STATS* stats)
+{
+	if (!scheduler || !stats || (priority >= DVC_PRIORITY_CLASSES))
+		return FALSE;
+
+	EnterCriticalSection(&scheduler->lock);
+	*stats = scheduler->classes[priority].stats;
+	LeaveCriticalSection(&scheduler->lock);
+	return TRUE;
+}
+
+rdpDvcScheduler* dvc_scheduler_new(pfnDvcSchedulerStreamFree fnStreamFree)
+{
+	if (!fnStreamFree)
+		return NULL;
+
+	rdpDvcScheduler* scheduler = calloc(1, sizeof(rdpDvcScheduler));
+	if (!scheduler)
+		return NULL;
+
+	if (!InitializeCriticalSectionAndSpinCount(&scheduler->lock, 4000))
+	{
+		free(scheduler);
+		return NULL;
+	}
+
+	scheduler->fnStreamFree = fnStreamFree;
+	dvc_scheduler_set_priority_charges(scheduler, NULL, 0);
+	return scheduler;
+}
+
+void dvc_scheduler_free(rdpDvcScheduler* scheduler)
+{
+	if (!scheduler)
+		return;
+
+	dvc_scheduler_clear(scheduler);
+	DeleteCriticalSection(&scheduler->lock);
+	free(scheduler);
+}
@@ -0,0 +1,228 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/stream.h>
+
+#include <freerdp/types.h>
+#include <freerdp/utils/dvc_scheduler.h>
+
+#define TEST_CHUNK_SIZE 1600
+
+static size_t test_freed = 0;
+
+static void test_stream_free(wStream* s)
+{
+	test_freed++;
+	Stream_Free(s, TRUE);
+}
+
+/* Each PDU carries its channel and sequence number */
+static BOOL test_enqueue(rdpDvcScheduler* scheduler, UINT32 channelId, BYTE priority,
+                         UINT32 sequence, size_t length)
+{
+	wStream* s = Stream_New(NULL, MAX(length, 8));
+	if (!s)
+		return FALSE;
+
+	Stream_Write_UINT32(s, channelId);
+	Stream_Write_UINT32(s, sequence);
+	Stream_SetPosition(s, MAX(length, 8));
+	return dvc_scheduler_enqueue(scheduler, channelId, priority, s);
+}
+
+static BOOL test_dequeue(rdpDvcScheduler* scheduler, UINT32* channelId, UINT32* sequence)
+{
+	wStream* s = dvc_scheduler_dequeue(scheduler);
+	if (!s)
+		return FALSE;
+
+	Stream_SetPosition(s, 0);
+	Stream_Read_UINT32(s, *channelId);
+	Stream_Read_UINT32(s, *sequence);
+	Stream_Free(s, TRUE);
+	return TRUE;
+}
+
+/* Channels of one class alternate, every channel keeps its own order */
+static BOOL test_round_robin(rdpDvcScheduler* scheduler)
+{
+	const UINT32 count = 10;
+	UINT32 next[3] = { 0 };
+	UINT32 last = UINT32_MAX;
+
+	for (UINT32 x = 0; x < count; x++)
+	{
+		for (UINT32 channel = 0; channel < ARRAYSIZE(next); channel++)
+		{
+			if (!test_enqueue(scheduler, channel, 1, x, TEST_CHUNK_SIZE))
+				return FALSE;
+		}
+	}
+
+	if (dvc_scheduler_pending(scheduler) != count * ARRAYSIZE(next))
+		return FALSE;
+
+	for (size_t x = 0; x < count * ARRAYSIZE(next); x++)
+	{
+		UINT32 channelId = 0;
+		UINT32 sequence = 0;
+
+		if (!test_dequeue(scheduler, &channelId, &sequence) || (channelId >= ARRAYSIZE(next)))
+			return FALSE;
+		if ((sequence != next[channelId]++) || (channelId == last))
+		{
+			fprintf(stderr, "channel %" PRIu32 " PDU %" PRIu32 " out of order\n", channelId,
+			        sequence);
+			return FALSE;
+		}
+		last = channelId;
+	}
+
+	return dvc_scheduler_dequeue(scheduler) == NULL;
+}
+
+/* Saturated classes share the bytes sent in inverse proportion to their charges */
+static BOOL test_weighted_share(rdpDvcScheduler* scheduler)
+{
+	const size_t count = 400;
+	size_t sent[DVC_PRIORITY_CLASSES] = { 0 };
+
+	for (UINT32 x = 0; x < count; x++)
+	{
+		for (BYTE priority = 0; priority < DVC_PRIORITY_CLASSES; priority++)
+		{
+			if (!test_enqueue(scheduler, 100 + priority, priority, x, TEST_CHUNK_SIZE))
+				return FALSE;
+		}
+	}
+
+	/* only look at the first quarter, while all classes still have data */
+	for (size_t x = 0; x < count; x++)
+	{
+		UINT32 channelId = 0;
+		UINT32 sequence = 0;
+
+		if (!test_dequeue(scheduler, &channelId, &sequence))
+			return FALSE;
+		sent[channelId - 100]++;
+	}
+
+	printf("share: %" PRIuz " %" PRIuz " %" PRIuz " %" PRIuz "\n", sent[0], sent[1], sent[2],
+	       sent[3]);
+
+	/* default charges give about 70%, 20%, 7% and 2% */
+	if ((sent[0] < count * 60 / 100) || (sent[0] > count * 80 / 100))
+		return FALSE;
+	if ((sent[1] < count * 15 / 100) || (sent[1] > count * 25 / 100))
+		return FALSE;
+	if ((sent[2] < sent[3]) || (sent[3] == 0))
+		return FALSE;
+
+	DVC_SCHEDULER_STATS stats = { 0 };
+	if (!dvc_scheduler_get_stats(scheduler, 0, &stats))
+		return FALSE;
+	if ((stats.SentChunks != sent[0]) || (stats.QueuedChunks != count - sent[0]) ||
+	    (stats.MaxQueuedBytes != count * TEST_CHUNK_SIZE))
+		return FALSE;
+
+	test_freed = 0;
+	dvc_scheduler_clear(scheduler);
+	if ((dvc_scheduler_pending(scheduler) != 0) ||
+	    (test_freed != count * DVC_PRIORITY_CLASSES - count))
+		return FALSE;
+
+	return TRUE;
+}
+
+/* A class that was idle gets no backlog of credit when it becomes active */
+static BOOL test_idle_class(rdpDvcScheduler* scheduler)
+{
+	for (UINT32 x = 0; x < 100; x++)
+	{
+		UINT32 channelId = 0;
+		UINT32 sequence = 0;
+
+		if (!test_enqueue(scheduler, 3, 3, x, TEST_CHUNK_SIZE) ||
+		    !test_dequeue(scheduler, &channelId, &sequence))
+			return FALSE;
+	}
+
+	for (UINT32 x = 0; x < 10; x++)
+	{
+		if (!test_enqueue(scheduler, 0, 0, x, TEST_CHUNK_SIZE) ||
+		    !test_enqueue(scheduler, 3, 3, x, TEST_CHUNK_SIZE))
+			return FALSE;
+	}
+
+	/* The low priority channel may go first once, then the high priority one dominates */
+	size_t low = 0;
+	for (size_t x = 0; x < 10; x++)
+	{
+		UINT32 channelId = 0;
+		UINT32 sequence = 0;
+
+		if (!test_dequeue(scheduler, &channelId, &sequence))
+			return FALSE;
+		if (channelId == 3)
+			low++;
+	}
+
+	dvc_scheduler_clear(scheduler);
+	return low <= 1;
+}
+
+int TestDvcScheduler(int argc, char* argv[])
+{
+	int rc = -1;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	rdpDvcScheduler* scheduler = dvc_scheduler_new(test_stream_free);
+	if (!scheduler)
+		return -1;
+
+	if (!test_round_robin(scheduler))
+	{
+		fprintf(stderr, "round robin test failed\n");
+		goto fail;
+	}
+
+	if (!test_weighted_share(scheduler))
+	{
+		fprintf(stderr, "weighted share test failed\n");
+		goto fail;
+	}
+
+	if (!test_idle_class(scheduler))
+	{
+		fprintf(stderr, "idle class test failed\n");
+		goto fail;
+	}
+
+	/* equal charges degrade to round robin over the classes */
+	const UINT16 charges[] = { 1000, 1000, 1000, 1000 };
+	dvc_scheduler_set_priority_charges(scheduler, charges, ARRAYSIZE(charges));
+	for (UINT32 x = 0; x < 4; x++)
+	{
+		if (!test_enqueue(scheduler, x, (BYTE)x, 0, TEST_CHUNK_SIZE) ||
+		    !test_enqueue(scheduler, x, (BYTE)x, 1, TEST_CHUNK_SIZE))
+			goto fail;
+	}
+	for (UINT32 x = 0; x < 8; x++)
+	{
+		UINT32 channelId = 0;
+		UINT32 sequence = 0;
+
+		if (!test_dequeue(scheduler, &channelId, &sequence) || (channelId != x % 4))
+		{
+			fprintf(stderr, "equal charges test failed\n");
+			goto fail;
+		}
+	}
+
+	rc = 0;
+fail:
+	dvc_scheduler_free(scheduler);
+	return rc;
+}
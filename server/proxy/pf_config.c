@@ -67,6 +67,7 @@ static const char* boolstr(BOOL rc)
 static const char* section_server = "Server";
 static const char* key_host = "Host";
 static const char* key_port = "Port";
+static const char* key_metrics_interval = "MetricsInterval";
 
 static const char* section_target = "Target";
 static const char* key_target_fixed = "FixedTarget";
@@ -113,6 +114,9 @@ static const char* key_security_client_nla = "ClientNlaSecurity";
 static const char* key_security_client_tls = "ClientTlsSecurity";
 static const char* key_security_client_rdp = "ClientRdpSecurity";
 static const char* key_security_client_fallback = "ClientAllowFallbackToTls";
+static const char* key_security_tls_cache_size = "TlsSessionCacheSize";
+static const char* key_security_tls_lifetime = "TlsSessionLifetime";
+static const char* key_security_tls_cache_name = "TlsSessionCacheName";
 
 static const char* section_certificates = "Certificates";
 static const char* key_private_key_file = "PrivateKeyFile";
@@ -234,6 +238,10 @@ static BOOL pf_config_load_server(wIniFile* ini, proxyConfig* config)
 	const char* host = NULL;
 
 	WINPR_ASSERT(config);
+	if (!pf_config_get_uint32(ini, section_server, key_metrics_interval, &config->MetricsInterval,
+	                          FALSE))
+		return FALSE;
+
 	host = pf_config_get_str(ini, section_server, key_host, FALSE);
 
 	if (!host)
@@ -355,6 +363,25 @@ static BOOL pf_config_load_security(wIniFile* ini, proxyConfig* config)
 	    pf_config_get_bool(ini, section_security, key_security_client_rdp, TRUE);
 	config->ClientAllowFallbackToTls =
 	    pf_config_get_bool(ini, section_security, key_security_client_fallback, TRUE);
+	if (!pf_config_get_uint32(ini, section_security, key_security_tls_cache_size,
+	                          &config->TlsSessionCacheSize, FALSE))
+		return FALSE;
+	if (!pf_config_get_uint32(ini, section_security, key_security_tls_lifetime,
+	                          &config->TlsSessionLifetime, FALSE))
+		return FALSE;
+	if (config->TlsSessionLifetime == 0)
+	{
+		WLog_ERR(TAG, "%s.%s must not be 0", section_security, key_security_tls_lifetime);
+		return FALSE;
+	}
+
+	const char* name = pf_config_get_str(ini, section_security, key_security_tls_cache_name, FALSE);
+	if (name)
+	{
+		config->TlsSessionCacheName = _strdup(name);
+		if (!config->TlsSessionCacheName)
+			return FALSE;
+	}
 	return TRUE;
 }
 
@@ -583,6 +610,8 @@ proxyConfig* server_config_load_ini(wIniFile* ini)
 	{
 		/* Set default values != 0 */
 		config->TargetTlsSecLevel = 1;
+		config->TlsSessionCacheSize = 1024;
+		config->TlsSessionLifetime = 3600;
 
 		/* Load from ini */
 		if (!pf_config_load_server(ini, config))
@@ -633,6 +662,8 @@ BOOL pf_server_config_dump(const char* file)
 		goto fail;
 	if (IniFile_SetKeyValueInt(ini, section_server, key_port, 3389) < 0)
 		goto fail;
+	if (IniFile_SetKeyValueInt(ini, section_server, key_metrics_interval, 0) < 0)
+		goto fail;
 
 	/* Target configuration */
 	if (IniFile_SetKeyValueString(ini, section_target, key_host, "somehost.example.com") < 0)
@@ -702,6 +733,10 @@ BOOL pf_server_config_dump(const char* file)
 	if (IniFile_SetKeyValueString(ini, section_security, key_security_client_fallback,
 	                              bool_str_true) < 0)
 		goto fail;
+	if (IniFile_SetKeyValueInt(ini, section_security, key_security_tls_cache_size, 1024) < 0)
+		goto fail;
+	if (IniFile_SetKeyValueInt(ini, section_security, key_security_tls_lifetime, 3600) < 0)
+		goto fail;
 
 	/* Module configuration */
 	if (IniFile_SetKeyValueString(ini, section_plugins, key_plugins_modules,
@@ -810,6 +845,7 @@ void pf_server_config_print(const proxyConfig* config)
 	CONFIG_PRINT_SECTION(section_server);
 	CONFIG_PRINT_STR(config, Host);
 	CONFIG_PRINT_UINT16(config, Port);
+	CONFIG_PRINT_UINT32(config, MetricsInterval);
 
 	if (config->FixedTarget)
 	{
@@ -837,6 +873,10 @@ void pf_server_config_print(const proxyConfig* config)
 	CONFIG_PRINT_BOOL(config, ClientTlsSecurity);
 	CONFIG_PRINT_BOOL(config, ClientRdpSecurity);
 	CONFIG_PRINT_BOOL(config, ClientAllowFallbackToTls);
+	CONFIG_PRINT_UINT32(config, TlsSessionCacheSize);
+	CONFIG_PRINT_UINT32(config, TlsSessionLifetime);
+	if (config->TlsSessionCacheName)
+		CONFIG_PRINT_STR(config, TlsSessionCacheName);
 
 	CONFIG_PRINT_SECTION(section_channels);
 	CONFIG_PRINT_BOOL(config, GFX);
@@ -908,6 +948,7 @@ void pf_server_config_free(proxyConfig* config)
 	if (config->PrivateKeyPEM)
 		memset(config->PrivateKeyPEM, 0, config->PrivateKeyPEMLength);
 	free(config->PrivateKeyPEM);
+	free(config->TlsSessionCacheName);
 	IniFile_Free(config->ini);
 	free(config);
 }
@@ -1033,6 +1074,8 @@ BOOL pf_config_clone(proxyConfig** dst, const proxyConfig* config)
 	if (!pf_config_copy_string_n(&tmp->PrivateKeyPEM, config->PrivateKeyPEM,
 	                             config->PrivateKeyPEMLength))
 		goto fail;
+	if (!pf_config_copy_string(&tmp->TlsSessionCacheName, config->TlsSessionCacheName))
+		goto fail;
 
 	tmp->ini = IniFile_Clone(config->ini);
 	if (!tmp->ini)
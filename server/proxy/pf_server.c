@@ -30,6 +30,7 @@
 #include <winpr/string.h>
 #include <winpr/winsock.h>
 #include <winpr/thread.h>
+#include <winpr/sysinfo.h>
 #include <errno.h>
 
 #include <freerdp/freerdp.h>
@@ -521,6 +522,9 @@ static BOOL pf_server_initialize_peer_connection(freerdp_peer* peer)
 		return FALSE;
 	if (!freerdp_settings_set_bool(settings, FreeRDP_NlaSecurity, config->ServerNlaSecurity))
 		return FALSE;
+	if (server->tlsSessionCache &&
+	    !freerdp_peer_set_tls_session_cache(peer, server->tlsSessionCache))
+		return FALSE;
 
 	if (!freerdp_settings_set_uint32(settings, FreeRDP_EncryptionLevel,
 	                                 ENCRYPTION_LEVEL_CLIENT_COMPATIBLE))
@@ -552,6 +556,42 @@ static BOOL pf_server_initialize_peer_connection(freerdp_peer* peer)
 	return TRUE;
 }
 
+/* Log the metrics of one side of the session, the peer or the connection to the target */
+static void pf_server_log_metrics(const proxyData* pdata, rdpContext* context, const char* side)
+{
+	char prefix[128] = { 0 };
+	char* ctx = NULL;
+
+	WINPR_ASSERT(pdata);
+	WINPR_ASSERT(side);
+
+	if (!context)
+		return;
+
+	FREERDP_METRICS_SNAPSHOT* snapshot = freerdp_metrics_snapshot(context->metrics, FALSE);
+	if (!snapshot)
+		return;
+
+	(void)_snprintf(prefix, sizeof(prefix), "[SessionID=%s]: %s ", pdata->session_id, side);
+	char* text = freerdp_metrics_snapshot_format(snapshot, prefix);
+	freerdp_metrics_snapshot_free(snapshot);
+	if (!text)
+		return;
+
+	for (char* line = strtok_s(text, "\n", &ctx); line; line = strtok_s(NULL, "\n", &ctx))
+		WLog_INFO(TAG, "%s", line);
+	free(text);
+}
+
+static void pf_server_log_session_metrics(const proxyData* pdata, freerdp_peer* client)
+{
+	WINPR_ASSERT(pdata);
+	WINPR_ASSERT(client);
+
+	pf_server_log_metrics(pdata, client->context, "peer");
+	pf_server_log_metrics(pdata, pdata->pc ? &pdata->pc->context : NULL, "target");
+}
+
 /**
  * Handles an incoming client connection, to be run in it's own thread.
  *
@@ -599,6 +639,9 @@ static DWORD WINAPI pf_server_handle_peer(LPVOID arg)
 	if (!pf_modules_run_hook(pdata->module, HOOK_TYPE_SERVER_SESSION_STARTED, pdata, client))
 		goto out_free_peer;
 
+	const UINT64 metricsInterval = 1000ull * pdata->config->MetricsInterval;
+	UINT64 metricsDue = (metricsInterval > 0) ? GetTickCount64() + metricsInterval : 0;
+
 	while (1)
 	{
 		HANDLE ChannelEvent = INVALID_HANDLE_VALUE;
@@ -661,6 +704,12 @@ static DWORD WINAPI pf_server_handle_peer(LPVOID arg)
 			break;
 		}
 
+		if ((metricsDue > 0) && (GetTickCount64() >= metricsDue))
+		{
+			pf_server_log_session_metrics(pdata, client);
+			metricsDue = GetTickCount64() + metricsInterval;
+		}
+
 		switch (WTSVirtualChannelManagerGetDrdynvcState(ps->vcm))
 		{
 			/* Dynamic channel status may have been changed after processing */
@@ -696,6 +745,9 @@ fail:
 	/* Abort the client. */
 	proxy_data_abort_connect(pdata);
 
+	if (pdata->config->MetricsInterval > 0)
+		pf_server_log_session_metrics(pdata, client);
+
 	pf_modules_run_hook(pdata->module, HOOK_TYPE_SERVER_SESSION_END, pdata, client);
 
 	PROXY_LOG_INFO(TAG, ps, "freeing server's channels");
@@ -945,6 +997,15 @@ proxyServer* pf_server_new(const proxyConfig* config)
 	if (!server->peer_list)
 		goto out;
 
+	if (server->config->TlsSessionCacheSize > 0)
+	{
+		server->tlsSessionCache = freerdp_tls_session_cache_new(
+		    server->config->TlsSessionCacheSize, server->config->TlsSessionLifetime,
+		    server->config->TlsSessionCacheName);
+		if (!server->tlsSessionCache)
+			goto out;
+	}
+
 	obj = ArrayList_Object(server->peer_list);
 	WINPR_ASSERT(obj);
 
@@ -1054,6 +1115,7 @@ void pf_server_free(proxyServer* server)
 	}
 	ArrayList_Free(server->peer_list);
 	freerdp_listener_free(server->listener);
+	freerdp_tls_session_cache_free(server->tlsSessionCache);
 
 	if (server->stopEvent)
 		CloseHandle(server->stopEvent);
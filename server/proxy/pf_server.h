@@ -26,6 +26,7 @@
 
 #include <winpr/collections.h>
 #include <freerdp/listener.h>
+#include <freerdp/crypto/tls_session_cache.h>
 
 #include <freerdp/server/proxy/proxy_config.h>
 #include "proxy_modules.h"
@@ -38,6 +39,7 @@ struct proxy_server
 	freerdp_listener* listener;
 	HANDLE stopEvent; /* an event used to signal the main thread to stop */
 	wArrayList* peer_list;
+	rdpTlsSessionCache* tlsSessionCache; /* shared by all peers */
 };
 
 #endif /* INT_FREERDP_SERVER_PROXY_SERVER_H */
@@ -80,6 +80,19 @@ int main(int argc, char** argv)
 		  "Kerberos host ccache file for NLA authentication" },
 		{ "tls-secrets-file", COMMAND_LINE_VALUE_REQUIRED, "<file>", NULL, NULL, -1, NULL,
 		  "file where tls secrets shall be stored" },
+		{ "tls-session-cache", COMMAND_LINE_VALUE_REQUIRED, "<number>", "1024", NULL, -1, NULL,
+		  "TLS sessions kept for fast reconnects, 0 to deactivate" },
+		{ "tls-session-lifetime", COMMAND_LINE_VALUE_REQUIRED, "<seconds>", "3600", NULL, -1, NULL,
+		  "Lifetime of resumable TLS sessions and of the session ticket key" },
+		{ "metrics-interval", COMMAND_LINE_VALUE_REQUIRED, "<seconds>", "0", NULL, -1, NULL,
+		  "Log the connection metrics of each client periodically and on disconnect, 0 to "
+		  "deactivate" },
+		{ "bitmap-cache", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueTrue, NULL, -1, NULL,
+		  "Send repeating tiles to clients without graphics pipeline once and draw them from "
+		  "the client bitmap cache" },
+		{ "bitmap-cache-persist", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL,
+		  "Trust the keys of bitmaps clients load from their persistent cache, only for clients "
+		  "that restore those bitmaps" },
 		{ "gfx-progressive", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueTrue, NULL, -1, NULL,
 		  "Allow GFX progressive codec" },
 		{ "gfx-rfx", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueTrue, NULL, -1, NULL,
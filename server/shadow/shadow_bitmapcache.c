@@ -0,0 +1,535 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Shadow Server Bitmap Cache Mirror
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <string.h>
+
+#include <winpr/assert.h>
+
+#include <freerdp/peer.h>
+#include <freerdp/secondary.h>
+#include <freerdp/settings.h>
+
+#include "shadow_bitmapcache.h"
+
+#include <freerdp/log.h>
+#define TAG SERVER_TAG("shadow.bitmapcache")
+
+#define SHADOW_BITMAP_CACHE_MAX_CELLS 5
+#define SHADOW_BITMAP_CACHE_NONE UINT32_MAX
+
+typedef struct
+{
+	UINT64 key;
+	UINT64 check; /* second half of the 128 bit content key, not sent to the client */
+	BOOL trusted; /* restored from the persistent key list, there is no check */
+	UINT32 older;
+	UINT32 newer;
+	UINT32 chain;
+	UINT32 cell;
+} SHADOW_BITMAP_CACHE_ENTRY;
+
+typedef struct
+{
+	UINT32 first;
+	UINT32 size;
+	UINT32 used;
+	UINT32 newest;
+	UINT32 oldest;
+	UINT32 maxPixels;
+	BOOL persistent;
+} SHADOW_BITMAP_CACHE_CELL;
+
+struct rdp_shadow_bitmap_cache
+{
+	UINT32 numCells;
+	UINT32 bpp;
+	SHADOW_BITMAP_CACHE_CELL cells[SHADOW_BITMAP_CACHE_MAX_CELLS];
+
+	BOOL persistentKeys;
+	BOOL seeded;
+
+	SHADOW_BITMAP_CACHE_ENTRY* entries;
+	UINT32 maxEntries;
+
+	UINT32* buckets;
+	UINT32 bucketMask;
+};
+
+static UINT32 shadow_bitmap_cache_bucket(const rdpShadowBitmapCache* cache, UINT64 key)
+{
+	return (UINT32)(key ^ (key >> 32)) & cache->bucketMask;
+}
+
+static void shadow_bitmap_cache_hash(rdpShadowBitmapCache* cache, UINT32 index)
+{
+	SHADOW_BITMAP_CACHE_ENTRY* entry = &cache->entries[index];
+	const UINT32 bucket = shadow_bitmap_cache_bucket(cache, entry->key);
+
+	entry->chain = cache->buckets[bucket];
+	cache->buckets[bucket] = index;
+}
+
+static void shadow_bitmap_cache_unhash(rdpShadowBitmapCache* cache, UINT32 index)
+{
+	SHADOW_BITMAP_CACHE_ENTRY* entry = &cache->entries[index];
+	UINT32* link = &cache->buckets[shadow_bitmap_cache_bucket(cache, entry->key)];
+
+	while (*link != SHADOW_BITMAP_CACHE_NONE)
+	{
+		if (*link == index)
+		{
+			*link = entry->chain;
+			break;
+		}
+
+		link = &cache->entries[*link].chain;
+	}
+
+	entry->chain = SHADOW_BITMAP_CACHE_NONE;
+}
+
+static void shadow_bitmap_cache_unlink(rdpShadowBitmapCache* cache, UINT32 index)
+{
+	SHADOW_BITMAP_CACHE_ENTRY* entry = &cache->entries[index];
+	SHADOW_BITMAP_CACHE_CELL* cell = &cache->cells[entry->cell];
+
+	if (entry->older != SHADOW_BITMAP_CACHE_NONE)
+		cache->entries[entry->older].newer = entry->newer;
+	else
+		cell->oldest = entry->newer;
+
+	if (entry->newer != SHADOW_BITMAP_CACHE_NONE)
+		cache->entries[entry->newer].older = entry->older;
+	else
+		cell->newest = entry->older;
+
+	entry->older = entry->newer = SHADOW_BITMAP_CACHE_NONE;
+}
+
+static void shadow_bitmap_cache_link_newest(rdpShadowBitmapCache* cache, UINT32 index)
+{
+	SHADOW_BITMAP_CACHE_ENTRY* entry = &cache->entries[index];
+	SHADOW_BITMAP_CACHE_CELL* cell = &cache->cells[entry->cell];
+
+	entry->older = cell->newest;
+	entry->newer = SHADOW_BITMAP_CACHE_NONE;
+
+	if (cell->newest != SHADOW_BITMAP_CACHE_NONE)
+		cache->entries[cell->newest].newer = index;
+	else
+		cell->oldest = index;
+
+	cell->newest = index;
+}
+
+static UINT32 shadow_bitmap_cache_find(const rdpShadowBitmapCache* cache, UINT64 key,
+                                       UINT64 check)
+{
+	UINT32 index = cache->buckets[shadow_bitmap_cache_bucket(cache, key)];
+
+	while (index != SHADOW_BITMAP_CACHE_NONE)
+	{
+		const SHADOW_BITMAP_CACHE_ENTRY* entry = &cache->entries[index];
+
+		if ((entry->key == key) && (entry->trusted || (entry->check == check)))
+			break;
+
+		if (entry->key == key)
+			WLog_DBG(TAG, "key 0x%016" PRIx64 " collides with different pixels", key);
+
+		index = entry->chain;
+	}
+
+	return index;
+}
+
+static void shadow_bitmap_cache_rehash(rdpShadowBitmapCache* cache)
+{
+	memset(cache->buckets, 0xFF, sizeof(UINT32) * (cache->bucketMask + 1ull));
+
+	for (UINT32 x = 0; x < cache->numCells; x++)
+	{
+		const SHADOW_BITMAP_CACHE_CELL* cell = &cache->cells[x];
+
+		for (UINT32 y = 0; y < cell->used; y++)
+		{
+			/* A zero key never matches */
+			if (cache->entries[cell->first + y].key)
+				shadow_bitmap_cache_hash(cache, cell->first + y);
+		}
+	}
+}
+
+static BOOL shadow_bitmap_cache_resize(rdpShadowBitmapCache* cache, UINT32 count)
+{
+	UINT32 buckets = 16;
+
+	while (buckets < count)
+		buckets *= 2;
+
+	if (count > cache->maxEntries)
+	{
+		SHADOW_BITMAP_CACHE_ENTRY* entries = (SHADOW_BITMAP_CACHE_ENTRY*)realloc(
+		    cache->entries, sizeof(SHADOW_BITMAP_CACHE_ENTRY) * count);
+		if (!entries)
+			return FALSE;
+
+		memset(&entries[cache->maxEntries], 0,
+		       sizeof(SHADOW_BITMAP_CACHE_ENTRY) * (count - cache->maxEntries));
+		cache->entries = entries;
+		cache->maxEntries = count;
+	}
+
+	if (buckets - 1 != cache->bucketMask)
+	{
+		UINT32* table = (UINT32*)realloc(cache->buckets, sizeof(UINT32) * buckets);
+		if (!table)
+			return FALSE;
+
+		cache->buckets = table;
+		cache->bucketMask = buckets - 1;
+	}
+
+	return TRUE;
+}
+
+static BOOL shadow_bitmap_cache_supported(const rdpSettings* settings)
+{
+	const BYTE* orders = freerdp_settings_get_pointer(settings, FreeRDP_OrderSupport);
+
+	if (!orders || !orders[NEG_MEMBLT_INDEX])
+		return FALSE;
+
+	/* Only set by the revision 2 capability set, which also describes the cells */
+	if (!freerdp_settings_get_bool(settings, FreeRDP_BitmapCacheEnabled))
+		return FALSE;
+
+	switch (freerdp_settings_get_uint32(settings, FreeRDP_ColorDepth))
+	{
+		case 8:
+		case 16:
+		case 24:
+		case 32:
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
+static void shadow_bitmap_cache_restore_keys(rdpShadowBitmapCache* cache, freerdp_peer* peer,
+                                             UINT32 id)
+{
+	const UINT64* keys = NULL;
+	UINT32 count = 0;
+	SHADOW_BITMAP_CACHE_CELL* cell = &cache->cells[id];
+
+	if (!peer || !freerdp_peer_get_persistent_keys(peer, id, &keys, &count))
+		return;
+
+	count = MIN(count, cell->size);
+
+	for (UINT32 x = 0; x < count; x++)
+	{
+		const UINT32 index = cell->first + x;
+		SHADOW_BITMAP_CACHE_ENTRY* entry = &cache->entries[index];
+
+		entry->key = keys[x];
+		entry->check = 0;
+		entry->trusted = TRUE;
+		entry->cell = id;
+		shadow_bitmap_cache_link_newest(cache, index);
+	}
+
+	cell->used = count;
+
+	if (count > 0)
+		WLog_DBG(TAG, "restored %" PRIu32 " persistent keys of cell %" PRIu32, count, id);
+}
+
+static BOOL shadow_bitmap_cache_same_layout(const rdpShadowBitmapCache* cache,
+                                            const SHADOW_BITMAP_CACHE_CELL* cells,
+                                            UINT32 numCells, UINT32 bpp)
+{
+	if ((cache->numCells != numCells) || (cache->bpp != bpp))
+		return FALSE;
+
+	for (UINT32 x = 0; x < numCells; x++)
+	{
+		if ((cache->cells[x].first != cells[x].first) || (cache->cells[x].size != cells[x].size) ||
+		    (cache->cells[x].persistent != cells[x].persistent))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+BOOL shadow_bitmap_cache_reset(rdpShadowBitmapCache* cache, rdpContext* context)
+{
+	UINT32 total = 0;
+	UINT32 numCells = 0;
+	SHADOW_BITMAP_CACHE_CELL cells[SHADOW_BITMAP_CACHE_MAX_CELLS] = { 0 };
+
+	WINPR_ASSERT(cache);
+	WINPR_ASSERT(context);
+
+	const rdpSettings* settings = context->settings;
+	WINPR_ASSERT(settings);
+
+	const UINT32 bpp = freerdp_settings_get_uint32(settings, FreeRDP_ColorDepth);
+
+	if (shadow_bitmap_cache_supported(settings))
+	{
+		numCells = MIN(SHADOW_BITMAP_CACHE_MAX_CELLS,
+		               freerdp_settings_get_uint32(settings, FreeRDP_BitmapCacheV2NumCells));
+	}
+
+	const BOOL persist = freerdp_settings_get_bool(settings, FreeRDP_BitmapCachePersistEnabled);
+
+	for (UINT32 x = 0; x < numCells; x++)
+	{
+		const BITMAP_CACHE_V2_CELL_INFO* info =
+		    freerdp_settings_get_pointer_array(settings, FreeRDP_BitmapCacheV2CellInfo, x);
+		SHADOW_BITMAP_CACHE_CELL* cell = &cells[x];
+
+		if (!info)
+			return FALSE;
+
+		/* Cell x holds bitmaps of up to 256 * 4^x pixels, the last index is reserved */
+		cell->first = total;
+		cell->size = MIN(info->numEntries, BITMAP_CACHE_WAITING_LIST_INDEX);
+		cell->newest = cell->oldest = SHADOW_BITMAP_CACHE_NONE;
+		cell->maxPixels = 256u << (2 * x);
+		cell->persistent = persist && info->persistent;
+		total += cell->size;
+	}
+
+	if (total == 0)
+		numCells = 0;
+
+	/* The client keeps its persistent cells across reactivations, but not across a change of
+	 * their layout or the color depth */
+	if (shadow_bitmap_cache_same_layout(cache, cells, numCells, bpp))
+	{
+		for (UINT32 x = 0; x < numCells; x++)
+		{
+			SHADOW_BITMAP_CACHE_CELL* cell = &cache->cells[x];
+
+			if (cell->persistent)
+				continue;
+
+			for (UINT32 y = 0; y < cell->used; y++)
+				cache->entries[cell->first + y].key = 0;
+
+			cell->used = 0;
+			cell->newest = cell->oldest = SHADOW_BITMAP_CACHE_NONE;
+		}
+	}
+	else
+	{
+		cache->numCells = 0;
+
+		if ((total > 0) && !shadow_bitmap_cache_resize(cache, total))
+			return FALSE;
+
+		for (UINT32 x = 0; x < total; x++)
+			cache->entries[x].key = 0;
+
+		memcpy(cache->cells, cells, sizeof(cells));
+		cache->numCells = numCells;
+		cache->bpp = bpp;
+	}
+
+	if (cache->numCells == 0)
+		return TRUE;
+
+	/* The key list describes the cells at connect time only */
+	if (!cache->seeded)
+	{
+		for (UINT32 x = 0; cache->persistentKeys && (x < cache->numCells); x++)
+		{
+			if (cache->cells[x].persistent)
+				shadow_bitmap_cache_restore_keys(cache, context->peer, x);
+		}
+
+		cache->seeded = TRUE;
+	}
+
+	shadow_bitmap_cache_rehash(cache);
+	return TRUE;
+}
+
+BOOL shadow_bitmap_cache_enabled(const rdpShadowBitmapCache* cache)
+{
+	return cache && (cache->numCells > 0);
+}
+
+static INLINE UINT64 shadow_bitmap_cache_mix(UINT64 h, UINT64 value)
+{
+	h = (h ^ value) * 0x9E3779B97F4A7C15ull;
+	return h ^ (h >> 29);
+}
+
+/* The check lane uses another multiplier and rotates the input, so a collision of the key
+ * lane does not carry over */
+static INLINE UINT64 shadow_bitmap_cache_mix_check(UINT64 h, UINT64 value)
+{
+	h = (h ^ ((value << 23) | (value >> 41))) * 0xC2B2AE3D27D4EB4Full;
+	return h ^ (h >> 31);
+}
+
+static INLINE UINT64 shadow_bitmap_cache_final(UINT64 h)
+{
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDull;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ull;
+	h ^= h >> 33;
+	return h;
+}
+
+UINT64 shadow_bitmap_cache_key(const BYTE* data, UINT32 step, UINT32 width, UINT32 height,
+                               UINT32 bpp, UINT64* check)
+{
+	const size_t size = 4ull * width;
+	const UINT64 shape = ((UINT64)bpp << 48) | ((UINT64)height << 24) | width;
+	UINT64 h = shadow_bitmap_cache_mix(0, shape);
+	UINT64 c = shadow_bitmap_cache_mix_check(0x243F6A8885A308D3ull, shape);
+
+	WINPR_ASSERT(data);
+	WINPR_ASSERT(check);
+
+	for (UINT32 y = 0; y < height; y++)
+	{
+		const BYTE* line = &data[1ull * y * step];
+		size_t x = 0;
+
+		for (; x + 8 <= size; x += 8)
+		{
+			UINT64 value = 0;
+			memcpy(&value, &line[x], sizeof(value));
+			h = shadow_bitmap_cache_mix(h, value);
+			c = shadow_bitmap_cache_mix_check(c, value);
+		}
+
+		if (x < size)
+		{
+			UINT32 value = 0;
+			memcpy(&value, &line[x], sizeof(value));
+			h = shadow_bitmap_cache_mix(h, value);
+			c = shadow_bitmap_cache_mix_check(c, value);
+		}
+	}
+
+	*check = shadow_bitmap_cache_final(c ^ h);
+	h *= 0xBF58476D1CE4E5B9ull;
+	h ^= h >> 32;
+	return h ? h : 1;
+}
+
+BOOL shadow_bitmap_cache_lookup(rdpShadowBitmapCache* cache, UINT64 key, UINT64 check,
+                                UINT16* cacheId, UINT16* cacheIndex)
+{
+	WINPR_ASSERT(cache);
+	WINPR_ASSERT(cacheId);
+	WINPR_ASSERT(cacheIndex);
+
+	if (cache->numCells == 0)
+		return FALSE;
+
+	const UINT32 index = shadow_bitmap_cache_find(cache, key, check);
+
+	if (index == SHADOW_BITMAP_CACHE_NONE)
+		return FALSE;
+
+	const SHADOW_BITMAP_CACHE_ENTRY* entry = &cache->entries[index];
+	shadow_bitmap_cache_unlink(cache, index);
+	shadow_bitmap_cache_link_newest(cache, index);
+	*cacheId = (UINT16)entry->cell;
+	*cacheIndex = (UINT16)(index - cache->cells[entry->cell].first);
+	return TRUE;
+}
+
+BOOL shadow_bitmap_cache_insert(rdpShadowBitmapCache* cache, UINT64 key, UINT64 check,
+                                UINT32 width, UINT32 height, UINT16* cacheId, UINT16* cacheIndex,
+                                BOOL* persistent)
+{
+	UINT32 index = 0;
+	SHADOW_BITMAP_CACHE_CELL* cell = NULL;
+
+	WINPR_ASSERT(cache);
+	WINPR_ASSERT(cacheId);
+	WINPR_ASSERT(cacheIndex);
+	WINPR_ASSERT(persistent);
+
+	for (UINT32 x = 0; x < cache->numCells; x++)
+	{
+		if ((cache->cells[x].size > 0) && (1ull * width * height <= cache->cells[x].maxPixels))
+		{
+			cell = &cache->cells[x];
+			*cacheId = (UINT16)x;
+			break;
+		}
+	}
+
+	if (!cell)
+		return FALSE;
+
+	index = (cell->used < cell->size) ? cell->first + cell->used : cell->oldest;
+	SHADOW_BITMAP_CACHE_ENTRY* entry = &cache->entries[index];
+
+	if (cell->used < cell->size)
+		cell->used++;
+	else
+	{
+		shadow_bitmap_cache_unlink(cache, index);
+		shadow_bitmap_cache_unhash(cache, index);
+	}
+
+	entry->key = key;
+	entry->check = check;
+	entry->trusted = FALSE;
+	entry->cell = *cacheId;
+	shadow_bitmap_cache_hash(cache, index);
+	shadow_bitmap_cache_link_newest(cache, index);
+
+	*cacheIndex = (UINT16)(index - cell->first);
+	*persistent = cell->persistent;
+	return TRUE;
+}
+
+rdpShadowBitmapCache* shadow_bitmap_cache_new(BOOL persistentKeys)
+{
+	rdpShadowBitmapCache* cache = (rdpShadowBitmapCache*)calloc(1, sizeof(rdpShadowBitmapCache));
+
+	if (!cache)
+		return NULL;
+
+	cache->persistentKeys = persistentKeys;
+	return cache;
+}
+
+void shadow_bitmap_cache_free(rdpShadowBitmapCache* cache)
+{
+	if (!cache)
+		return;
+
+	free(cache->entries);
+	free(cache->buckets);
+	free(cache);
+}
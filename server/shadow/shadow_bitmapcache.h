@@ -0,0 +1,82 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Shadow Server Bitmap Cache Mirror
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_SERVER_SHADOW_BITMAPCACHE_H
+#define FREERDP_SERVER_SHADOW_BITMAPCACHE_H
+
+#include <winpr/wtypes.h>
+
+#include <freerdp/api.h>
+#include <freerdp/freerdp.h>
+
+/** Model of the bitmap cache v2 cells of a client
+ *
+ *  Every entry holds the 128 bit content key of the bitmap the client stores at that cell
+ *  index, no pixels. Full cells evict their least recently used entry.
+ *
+ *  Memory cost: 40 bytes per cell entry plus up to 8 bytes of hash buckets. A client
+ *  announces at most 5 cells of 32767 entries, so a connection needs at most about 8 MiB,
+ *  the default FreeRDP client cells need less than 0.5 MiB.
+ */
+typedef struct rdp_shadow_bitmap_cache rdpShadowBitmapCache;
+
+/** @brief configure the cells negotiated by \b context
+ *
+ *  Entries of persistent cells are kept while the cell layout does not change, all other
+ *  entries are forgotten. The first reset of a connection restores the entries the client
+ *  loaded from its persistent cache from its key list, if the cache trusts those keys.
+ *  Without negotiated bitmap cache v2 and MemBlt support the cache stays disabled.
+ */
+FREERDP_LOCAL BOOL shadow_bitmap_cache_reset(rdpShadowBitmapCache* cache, rdpContext* context);
+
+FREERDP_LOCAL BOOL shadow_bitmap_cache_enabled(const rdpShadowBitmapCache* cache);
+
+/** @brief content key of \b width x \b height 32bpp pixels encoded with \b bpp
+ *
+ *  @param check receives the second, independent half of the 128 bit content key
+ *  @return the key sent to the client as persistent key, never 0
+ */
+FREERDP_LOCAL UINT64 shadow_bitmap_cache_key(const BYTE* data, UINT32 step, UINT32 width,
+                                             UINT32 height, UINT32 bpp, UINT64* check);
+
+/** @brief find the cell holding the bitmap of \b key and \b check and mark it as recently used
+ *
+ *  Entries whose key matches but whose check differs are not returned. Entries restored from
+ *  the persistent key list only compare the key.
+ */
+FREERDP_LOCAL BOOL shadow_bitmap_cache_lookup(rdpShadowBitmapCache* cache, UINT64 key,
+                                              UINT64 check, UINT16* cacheId, UINT16* cacheIndex);
+
+/** @brief pick the cell the client has to store the new \b width x \b height bitmap in
+ *
+ *  @return FALSE if no cell takes bitmaps of this size
+ */
+FREERDP_LOCAL BOOL shadow_bitmap_cache_insert(rdpShadowBitmapCache* cache, UINT64 key,
+                                              UINT64 check, UINT32 width, UINT32 height,
+                                              UINT16* cacheId, UINT16* cacheIndex,
+                                              BOOL* persistent);
+
+FREERDP_LOCAL void shadow_bitmap_cache_free(rdpShadowBitmapCache* cache);
+
+/** @brief \b persistentKeys trusts the keys the client offers for its persistent cells
+ *
+ *  A trusted key is drawn from the client cache without knowing the pixels it stands for.
+ */
+WINPR_ATTR_MALLOC(shadow_bitmap_cache_free, 1)
+FREERDP_LOCAL rdpShadowBitmapCache* shadow_bitmap_cache_new(BOOL persistentKeys);
+
+#endif /* FREERDP_SERVER_SHADOW_BITMAPCACHE_H */
@@ -30,12 +30,17 @@
 #include <winpr/interlocked.h>
 
 #include <freerdp/log.h>
+#include <freerdp/autodetect.h>
 #include <freerdp/channels/drdynvc.h>
 
 #include "shadow.h"
 
 #define TAG CLIENT_TAG("shadow")
 
+/* Interval between progressive refinement passes, and the size limit of one refinement frame */
+#define SHADOW_REFINE_INTERVAL_MS 50
+#define SHADOW_REFINE_MAX_SIZE (64 * 1024)
+
 typedef struct
 {
 	BOOL gfxOpened;
@@ -82,6 +87,10 @@ static INLINE BOOL shadow_client_rdpgfx_new_surface(rdpShadowClient* client)
 		return FALSE;
 	}
 
+	/* The new surface holds no tiles, refinement must start over */
+	if (client->encoder && client->encoder->progressive)
+		progressive_context_reset(client->encoder->progressive);
+
 	return TRUE;
 }
 
@@ -178,6 +187,35 @@ static void shadow_client_context_free(freerdp_peer* peer, rdpContext* context)
 	client->vcm = NULL;
 }
 
+static BOOL shadow_client_rtt_measure_response(rdpAutoDetect* autodetect,
+                                               RDP_TRANSPORT_TYPE transport, UINT16 sequenceNumber)
+{
+	WINPR_ASSERT(autodetect);
+	WINPR_UNUSED(transport);
+	WINPR_UNUSED(sequenceNumber);
+
+	rdpShadowClient* client = (rdpShadowClient*)autodetect->context;
+	if (client && client->encoder)
+		shadow_rate_control_rtt(&client->encoder->rateControl, autodetect->netCharAverageRTT);
+	return TRUE;
+}
+
+static BOOL shadow_client_bandwidth_measure_results(rdpAutoDetect* autodetect,
+                                                    RDP_TRANSPORT_TYPE transport,
+                                                    UINT16 sequenceNumber, UINT16 responseType,
+                                                    UINT32 timeDelta, UINT32 byteCount)
+{
+	WINPR_ASSERT(autodetect);
+	WINPR_UNUSED(transport);
+	WINPR_UNUSED(sequenceNumber);
+	WINPR_UNUSED(responseType);
+
+	rdpShadowClient* client = (rdpShadowClient*)autodetect->context;
+	if (client && client->encoder)
+		shadow_rate_control_bandwidth(&client->encoder->rateControl, timeDelta, byteCount);
+	return TRUE;
+}
+
 static BOOL shadow_client_context_new(freerdp_peer* peer, rdpContext* context)
 {
 	BOOL NSCodec = 0;
@@ -234,6 +272,20 @@ static BOOL shadow_client_context_new(freerdp_peer* peer, rdpContext* context)
 		return FALSE;
 	if (!freerdp_settings_set_uint32(settings, FreeRDP_CompressionLevel, PACKET_COMPR_TYPE_RDP8))
 		return FALSE;
+	if (server->tlsSessionCache &&
+	    !freerdp_peer_set_tls_session_cache(peer, server->tlsSessionCache))
+		return FALSE;
+
+	/* Whether the client has a bitmap cache is known after the capability exchange */
+	if (server->bitmapCache)
+	{
+		BYTE* OrderSupport = freerdp_settings_get_pointer_writable(settings, FreeRDP_OrderSupport);
+		if (!OrderSupport)
+			return FALSE;
+
+		OrderSupport[NEG_MEMBLT_INDEX] = TRUE;
+		OrderSupport[NEG_MEMBLT_V2_INDEX] = TRUE;
+	}
 
 	if (server->ipcSocket && (strncmp(bind_address, server->ipcSocket,
 	                                  strnlen(bind_address, sizeof(bind_address))) != 0))
@@ -263,6 +315,13 @@ static BOOL shadow_client_context_new(freerdp_peer* peer, rdpContext* context)
 	if (!(client->encoder = shadow_encoder_new(client)))
 		goto fail;
 
+	rdpAutoDetect* autodetect = autodetect_get(context);
+	if (autodetect)
+	{
+		autodetect->RTTMeasureResponse = shadow_client_rtt_measure_response;
+		autodetect->BandwidthMeasureResults = shadow_client_bandwidth_measure_results;
+	}
+
 	if (!ArrayList_Append(server->clients, (void*)client))
 		goto fail;
 
@@ -290,10 +349,7 @@ static INLINE void shadow_client_mark_invalid(rdpShadowClient* client, UINT32 nu
 	/* Mark client invalid region. No rectangle means full screen */
 	if (numRects > 0)
 	{
-		for (UINT32 index = 0; index < numRects; index++)
-		{
-			region16_union_rect(&(client->invalidRegion), &(client->invalidRegion), &rects[index]);
-		}
+		region16_union_rects(&(client->invalidRegion), &(client->invalidRegion), rects, numRects);
 	}
 	else
 	{
@@ -732,7 +788,56 @@ static INLINE void shadow_client_common_frame_acknowledge(rdpShadowClient* clien
 	 */
 	WINPR_ASSERT(client);
 	WINPR_ASSERT(client->encoder);
-	client->encoder->lastAckframeId = frameId;
+	shadow_encoder_frame_acknowledge(client->encoder, frameId);
+}
+
+/**
+ * Measure round trip time and bandwidth while a frame is sent, the results feed the
+ * H.264 rate control. Probes are spaced out so they do not add noticeable traffic.
+ *
+ * @return TRUE if a bandwidth measurement was started and must be stopped
+ */
+static BOOL shadow_client_start_network_probe(rdpShadowClient* client, UINT16* sequenceNumber)
+{
+	BOOL rc = FALSE;
+	rdpContext* context = (rdpContext*)client;
+
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(client->encoder);
+
+	if (!freerdp_settings_get_bool(context->settings, FreeRDP_NetworkAutoDetect))
+		return FALSE;
+
+	if (!shadow_rate_control_probe_due(&client->encoder->rateControl, GetTickCount64(),
+	                                   sequenceNumber))
+		return FALSE;
+
+	rdpAutoDetect* autodetect = autodetect_get(context);
+	if (!autodetect)
+		return FALSE;
+
+	IFCALLRET(autodetect->RTTMeasureRequest, rc, autodetect, RDP_TRANSPORT_TCP, *sequenceNumber);
+	if (!rc)
+		WLog_DBG(TAG, "RTT measure request failed");
+
+	rc = FALSE;
+	IFCALLRET(autodetect->BandwidthMeasureStart, rc, autodetect, RDP_TRANSPORT_TCP,
+	          *sequenceNumber);
+	return rc;
+}
+
+static void shadow_client_stop_network_probe(rdpShadowClient* client, UINT16 sequenceNumber)
+{
+	BOOL rc = FALSE;
+	rdpAutoDetect* autodetect = autodetect_get((rdpContext*)client);
+
+	if (!autodetect)
+		return;
+
+	IFCALLRET(autodetect->BandwidthMeasureStop, rc, autodetect, RDP_TRANSPORT_TCP,
+	          sequenceNumber, 0);
+	if (!rc)
+		WLog_DBG(TAG, "bandwidth measure stop failed");
 }
 
 static BOOL shadow_client_surface_frame_acknowledge(rdpContext* context, UINT32 frameId)
@@ -1043,6 +1148,14 @@ static INLINE UINT32 rdpgfx_estimate_h264_avc420(RDPGFX_AVC420_BITMAP_STREAM* ha
 	       havc420->length;
 }
 
+static void shadow_client_encode_time(rdpShadowClient* client, FREERDP_METRICS_CODEC codec,
+                                      UINT64 start)
+{
+	WINPR_ASSERT(client);
+	freerdp_metrics_codec_time(client->context.metrics, codec, TRUE,
+	                           winpr_GetTickCount64NS() - start);
+}
+
 /**
  * Function description
  *
@@ -1117,11 +1230,13 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 		regionRect.top = (UINT16)cmd.top;
 		regionRect.right = (UINT16)cmd.right;
 		regionRect.bottom = (UINT16)cmd.bottom;
+		const UINT64 start = winpr_GetTickCount64NS();
 		rc = avc444_compress(encoder->h264, pSrcData, cmd.format, nSrcStep, nWidth, nHeight,
 		                     version, &regionRect, &avc444.LC, &avc444.bitstream[0].data,
 		                     &avc444.bitstream[0].length, &avc444.bitstream[1].data,
 		                     &avc444.bitstream[1].length, &avc444.bitstream[0].meta,
 		                     &avc444.bitstream[1].meta);
+		shadow_client_encode_time(client, FREERDP_METRICS_CODEC_AVC444, start);
 		if (rc < 0)
 		{
 			WLog_ERR(TAG, "avc420_compress failed for avc444");
@@ -1166,8 +1281,10 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 		regionRect.top = (UINT16)cmd.top;
 		regionRect.right = (UINT16)cmd.right;
 		regionRect.bottom = (UINT16)cmd.bottom;
+		const UINT64 start = winpr_GetTickCount64NS();
 		rc = avc420_compress(encoder->h264, pSrcData, cmd.format, nSrcStep, nWidth, nHeight,
 		                     &regionRect, &avc420.data, &avc420.length, &avc420.meta);
+		shadow_client_encode_time(client, FREERDP_METRICS_CODEC_AVC420, start);
 		if (rc < 0)
 		{
 			WLog_ERR(TAG, "avc420_compress failed");
@@ -1217,7 +1334,9 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 		rect.width = (UINT16)cmd.right - cmd.left;
 		rect.height = (UINT16)cmd.bottom - cmd.top;
 
+		const UINT64 start = winpr_GetTickCount64NS();
 		rc = rfx_compose_message(encoder->rfx, s, &rect, 1, pSrcData, nWidth, nHeight, nSrcStep);
+		shadow_client_encode_time(client, FREERDP_METRICS_CODEC_REMOTEFX, start);
 
 		if (!rc)
 		{
@@ -1269,8 +1388,10 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 		regionRect.bottom = (UINT16)cmd.bottom;
 		region16_init(&region);
 		region16_union_rect(&region, &region, &regionRect);
+		const UINT64 start = winpr_GetTickCount64NS();
 		rc = progressive_compress(encoder->progressive, pSrcData, nSrcStep * nHeight, cmd.format,
 		                          nWidth, nHeight, nSrcStep, &region, &cmd.data, &cmd.length);
+		shadow_client_encode_time(client, FREERDP_METRICS_CODEC_PROGRESSIVE, start);
 		region16_uninit(&region);
 		if (rc < 0)
 		{
@@ -1310,8 +1431,10 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 		WINPR_ASSERT(rc);
 		freerdp_planar_topdown_image(encoder->planar, TRUE);
 
+		const UINT64 start = winpr_GetTickCount64NS();
 		cmd.data = freerdp_bitmap_compress_planar(encoder->planar, src, SrcFormat, w, h, nSrcStep,
 		                                          NULL, &cmd.length);
+		shadow_client_encode_time(client, FREERDP_METRICS_CODEC_PLANAR, start);
 		WINPR_ASSERT(cmd.data || (cmd.length == 0));
 
 		cmd.codecId = RDPGFX_CODECID_PLANAR;
@@ -1355,6 +1478,80 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 	return TRUE;
 }
 
+static BOOL shadow_client_refinement_pending(rdpShadowClient* client,
+                                             const SHADOW_GFX_STATUS* pStatus)
+{
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(pStatus);
+
+	if (!pStatus->gfxSurfaceCreated || !client->encoder || !client->encoder->progressive)
+		return FALSE;
+
+	return progressive_compress_pending(client->encoder->progressive) > 0;
+}
+
+/**
+ * Function description
+ * Send the next progressive upgrade pass, it is due every SHADOW_REFINE_INTERVAL_MS.
+ *
+ * @return TRUE on success (or nothing need to be refined)
+ */
+static BOOL shadow_client_send_surface_refinement(rdpShadowClient* client,
+                                                  const SHADOW_GFX_STATUS* pStatus)
+{
+	int rc = 0;
+	UINT error = CHANNEL_RC_OK;
+	rdpShadowEncoder* encoder = NULL;
+	RDPGFX_SURFACE_COMMAND cmd = { 0 };
+	RDPGFX_START_FRAME_PDU cmdstart = { 0 };
+	RDPGFX_END_FRAME_PDU cmdend = { 0 };
+	SYSTEMTIME sTime = { 0 };
+
+	if (!shadow_client_refinement_pending(client, pStatus) || !client->activated ||
+	    client->suppressOutput)
+		return TRUE;
+
+	encoder = client->encoder;
+
+	/* Leave the bandwidth to screen updates while the client lags behind */
+	if (shadow_encoder_inflight_frames(encoder) > 1)
+		return TRUE;
+
+	rc = progressive_compress_upgrade(encoder->progressive, SHADOW_REFINE_MAX_SIZE, &cmd.data,
+	                                  &cmd.length);
+	if (rc < 0)
+	{
+		WLog_ERR(TAG, "progressive_compress_upgrade failed");
+		return FALSE;
+	}
+
+	if (rc == 0)
+		return TRUE;
+
+	cmdstart.frameId = shadow_encoder_create_frame_id(encoder);
+	GetSystemTime(&sTime);
+	cmdstart.timestamp = (UINT32)(sTime.wHour << 22U | sTime.wMinute << 16U | sTime.wSecond << 10U |
+	                              sTime.wMilliseconds);
+	cmdend.frameId = cmdstart.frameId;
+	cmd.surfaceId = client->surfaceId;
+	cmd.codecId = RDPGFX_CODECID_CAPROGRESSIVE;
+	cmd.format = PIXEL_FORMAT_BGRX32;
+	cmd.right = encoder->width;
+	cmd.bottom = encoder->height;
+	cmd.width = encoder->width;
+	cmd.height = encoder->height;
+
+	IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart, &cmdend);
+
+	if (error)
+	{
+		WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
 /**
  * Function description
  *
@@ -1411,11 +1608,13 @@ static BOOL shadow_client_send_surface_bits(rdpShadowClient* client, BYTE* pSrcD
 
 		const UINT32 MultifragMaxRequestSize =
 		    freerdp_settings_get_uint32(settings, FreeRDP_MultifragMaxRequestSize);
+		const UINT64 start = winpr_GetTickCount64NS();
 		RFX_MESSAGE_LIST* messages =
 		    rfx_encode_messages(encoder->rfx, &rect, 1, pSrcData,
 		                        freerdp_settings_get_uint32(settings, FreeRDP_DesktopWidth),
 		                        freerdp_settings_get_uint32(settings, FreeRDP_DesktopHeight),
 		                        nSrcStep, &numMessages, MultifragMaxRequestSize);
+		shadow_client_encode_time(client, FREERDP_METRICS_CODEC_REMOTEFX, start);
 		if (!messages)
 		{
 			WLog_ERR(TAG, "rfx_encode_messages failed");
@@ -1481,7 +1680,9 @@ static BOOL shadow_client_send_surface_bits(rdpShadowClient* client, BYTE* pSrcD
 		s = encoder->bs;
 		Stream_SetPosition(s, 0);
 		pSrcData = &pSrcData[(nYSrc * nSrcStep) + (nXSrc * 4)];
+		const UINT64 start = winpr_GetTickCount64NS();
 		nsc_compose_message(encoder->nsc, s, pSrcData, nWidth, nHeight, nSrcStep);
+		shadow_client_encode_time(client, FREERDP_METRICS_CODEC_NSCODEC, start);
 		cmd.cmdType = CMDTYPE_SET_SURFACE_BITS;
 		cmd.bmp.bpp = 32;
 		WINPR_ASSERT(nsID <= UINT16_MAX);
@@ -1512,9 +1713,66 @@ static BOOL shadow_client_send_surface_bits(rdpShadowClient* client, BYTE* pSrcD
 	return ret;
 }
 
+static BOOL shadow_client_send_memblt(rdpContext* context, const BITMAP_DATA* bitmap,
+                                      UINT16 cacheId, UINT16 cacheIndex)
+{
+	MEMBLT_ORDER memblt = { 0 };
+
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(context->update);
+	WINPR_ASSERT(bitmap);
+
+	memblt.cacheId = cacheId;
+	memblt.cacheIndex = cacheIndex;
+	memblt.nLeftRect = (INT32)bitmap->destLeft;
+	memblt.nTopRect = (INT32)bitmap->destTop;
+	memblt.nWidth = (INT32)bitmap->width;
+	memblt.nHeight = (INT32)bitmap->height;
+	memblt.bRop = 0xCC; /* SRCCOPY */
+
+	return IFCALLRESULT(FALSE, context->update->primary->MemBlt, context, &memblt);
+}
+
+static BOOL shadow_client_send_cache_bitmap(rdpContext* context, const BITMAP_DATA* bitmap,
+                                            UINT64 key, UINT16 cacheId, UINT16 cacheIndex,
+                                            BOOL persistent)
+{
+	CACHE_BITMAP_V2_ORDER order = { 0 };
+
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(context->update);
+	WINPR_ASSERT(bitmap);
+
+	order.cacheId = cacheId;
+	order.cacheIndex = cacheIndex;
+	order.flags = CBR2_NO_BITMAP_COMPRESSION_HDR;
+	order.bitmapBpp = bitmap->bitsPerPixel;
+	order.bitmapWidth = bitmap->width;
+	order.bitmapHeight = bitmap->height;
+	order.bitmapLength = bitmap->bitmapLength;
+	order.bitmapDataStream = bitmap->bitmapDataStream;
+	order.compressed = TRUE;
+
+	if (bitmap->width == bitmap->height)
+		order.flags |= CBR2_HEIGHT_SAME_AS_WIDTH;
+
+	/* The client keeps persistent entries across sessions and offers the key again */
+	if (persistent)
+	{
+		order.flags |= CBR2_PERSISTENT_KEY_PRESENT;
+		order.key1 = (UINT32)key;
+		order.key2 = (UINT32)(key >> 32);
+	}
+
+	return IFCALLRESULT(FALSE, context->update->secondary->CacheBitmapV2, context, &order);
+}
+
 /**
  * Function description
  *
+ * Tiles the client bitmap cache already holds are drawn with MemBlt, new tiles are stored in
+ * the cache first when it takes bitmaps of their size.
+ *
  * @return TRUE on success
  */
 static BOOL shadow_client_send_bitmap_update(rdpShadowClient* client, BYTE* pSrcData,
@@ -1553,6 +1811,8 @@ static BOOL shadow_client_send_bitmap_update(rdpShadowClient* client, BYTE* pSrc
 
 	const UINT32 maxUpdateSize =
 	    freerdp_settings_get_uint32(settings, FreeRDP_MultifragMaxRequestSize);
+	const UINT32 colorDepth = freerdp_settings_get_uint32(settings, FreeRDP_ColorDepth);
+	const BOOL useCache = shadow_bitmap_cache_enabled(encoder->bitmapCache);
 	if (freerdp_settings_get_uint32(settings, FreeRDP_ColorDepth) < 32)
 	{
 		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_INTERLEAVED) < 0)
@@ -1595,6 +1855,12 @@ static BOOL shadow_client_send_bitmap_update(rdpShadowClient* client, BYTE* pSrc
 
 	bitmapUpdate.rectangles = bitmapData;
 
+	if (useCache && !IFCALLRESULT(FALSE, update->BeginPaint, context))
+	{
+		free(bitmapData);
+		return FALSE;
+	}
+
 	if ((nWidth % 4) != 0)
 	{
 		nWidth += (4 - (nWidth % 4));
@@ -1628,15 +1894,42 @@ static BOOL shadow_client_send_bitmap_update(rdpShadowClient* client, BYTE* pSrc
 			if ((bitmap->width < 4) || (bitmap->height < 4))
 				continue;
 
+			const BYTE* tile = &pSrcData[(bitmap->destTop * nSrcStep) + (bitmap->destLeft * 4)];
+			UINT64 key = 0;
+			UINT64 check = 0;
+			UINT16 cacheId = 0;
+			UINT16 cacheIndex = 0;
+
+			if (useCache)
+			{
+				key = shadow_bitmap_cache_key(tile, nSrcStep, bitmap->width, bitmap->height,
+				                              colorDepth, &check);
+
+				if (shadow_bitmap_cache_lookup(encoder->bitmapCache, key, check, &cacheId,
+				                               &cacheIndex))
+				{
+					if (!shadow_client_send_memblt(context, bitmap, cacheId, cacheIndex))
+					{
+						WLog_ERR(TAG, "MemBlt failed");
+						ret = FALSE;
+						goto out;
+					}
+
+					continue;
+				}
+			}
+
 			if (freerdp_settings_get_uint32(settings, FreeRDP_ColorDepth) < 32)
 			{
 				UINT32 bitsPerPixel = freerdp_settings_get_uint32(settings, FreeRDP_ColorDepth);
 				UINT32 bytesPerPixel = (bitsPerPixel + 7) / 8;
 				DstSize = 64 * 64 * 4;
 				buffer = encoder->grid[k];
+				const UINT64 start = winpr_GetTickCount64NS();
 				interleaved_compress(encoder->interleaved, buffer, &DstSize, bitmap->width,
 				                     bitmap->height, pSrcData, SrcFormat, nSrcStep,
 				                     bitmap->destLeft, bitmap->destTop, NULL, bitsPerPixel);
+				shadow_client_encode_time(client, FREERDP_METRICS_CODEC_INTERLEAVED, start);
 				bitmap->bitmapDataStream = buffer;
 				bitmap->bitmapLength = DstSize;
 				bitmap->bitsPerPixel = bitsPerPixel;
@@ -1649,9 +1942,11 @@ static BOOL shadow_client_send_bitmap_update(rdpShadowClient* client, BYTE* pSrc
 				buffer = encoder->grid[k];
 				data = &pSrcData[(bitmap->destTop * nSrcStep) + (bitmap->destLeft * 4)];
 
+				const UINT64 start = winpr_GetTickCount64NS();
 				buffer =
 				    freerdp_bitmap_compress_planar(encoder->planar, data, SrcFormat, bitmap->width,
 				                                   bitmap->height, nSrcStep, buffer, &dstSize);
+				shadow_client_encode_time(client, FREERDP_METRICS_CODEC_PLANAR, start);
 				bitmap->bitmapDataStream = buffer;
 				bitmap->bitmapLength = dstSize;
 				bitmap->bitsPerPixel = 32;
@@ -1659,6 +1954,27 @@ static BOOL shadow_client_send_bitmap_update(rdpShadowClient* client, BYTE* pSrc
 				bitmap->cbUncompressedSize = bitmap->width * bitmap->height * 4;
 			}
 
+			if (useCache)
+			{
+				BOOL persistent = FALSE;
+
+				if (shadow_bitmap_cache_insert(encoder->bitmapCache, key, check, bitmap->width,
+				                               bitmap->height, &cacheId, &cacheIndex,
+				                               &persistent))
+				{
+					if (!shadow_client_send_cache_bitmap(context, bitmap, key, cacheId, cacheIndex,
+					                                     persistent) ||
+					    !shadow_client_send_memblt(context, bitmap, cacheId, cacheIndex))
+					{
+						WLog_ERR(TAG, "CacheBitmapV2 failed");
+						ret = FALSE;
+						goto out;
+					}
+
+					continue;
+				}
+			}
+
 			bitmap->cbCompFirstRowSize = 0;
 			bitmap->cbCompMainBodySize = bitmap->bitmapLength;
 			totalBitmapSize += bitmap->bitmapLength;
@@ -1719,7 +2035,7 @@ static BOOL shadow_client_send_bitmap_update(rdpShadowClient* client, BYTE* pSrc
 
 		free(fragBitmapData);
 	}
-	else
+	else if (k > 0)
 	{
 		IFCALLRET(update->BitmapUpdate, ret, context, &bitmapUpdate);
 
@@ -1730,6 +2046,9 @@ static BOOL shadow_client_send_bitmap_update(rdpShadowClient* client, BYTE* pSrc
 	}
 
 out:
+	if (useCache && !IFCALLRESULT(FALSE, update->EndPaint, context))
+		ret = FALSE;
+
 	free(bitmapData);
 	return ret;
 }
@@ -1781,9 +2100,7 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 
 	EnterCriticalSection(&surface->lock);
 	rects = region16_rects(&(surface->invalidRegion), &numRects);
-
-	for (UINT32 index = 0; index < numRects; index++)
-		region16_union_rect(&invalidRegion, &invalidRegion, &rects[index]);
+	region16_union_rects(&invalidRegion, &invalidRegion, rects, numRects);
 
 	surfaceRect.left = 0;
 	surfaceRect.top = 0;
@@ -1858,8 +2175,12 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 			WINPR_ASSERT(nWidth <= UINT16_MAX);
 			WINPR_ASSERT(nHeight >= 0);
 			WINPR_ASSERT(nHeight <= UINT16_MAX);
+			UINT16 sequenceNumber = 0;
+			const BOOL probe = shadow_client_start_network_probe(client, &sequenceNumber);
 			ret = shadow_client_send_surface_gfx(client, pSrcData, nSrcStep, SrcFormat, 0, 0,
 			                                     (UINT16)nWidth, (UINT16)nHeight);
+			if (probe)
+				shadow_client_stop_network_probe(client, sequenceNumber);
 		}
 		else
 		{
@@ -2100,6 +2421,30 @@ static int shadow_client_subsystem_process_message(rdpShadowClient* client, wMes
 	return 1;
 }
 
+static void shadow_client_log_metrics(rdpShadowClient* client)
+{
+	char prefix[64] = { 0 };
+	char* context = NULL;
+	rdpContext* ctx = (rdpContext*)client;
+
+	WINPR_ASSERT(ctx);
+	WINPR_ASSERT(ctx->peer);
+
+	FREERDP_METRICS_SNAPSHOT* snapshot = freerdp_metrics_snapshot(ctx->metrics, FALSE);
+	if (!snapshot)
+		return;
+
+	(void)_snprintf(prefix, sizeof(prefix), "[%s] ", ctx->peer->hostname);
+	char* text = freerdp_metrics_snapshot_format(snapshot, prefix);
+	freerdp_metrics_snapshot_free(snapshot);
+	if (!text)
+		return;
+
+	for (char* line = strtok_s(text, "\n", &context); line; line = strtok_s(NULL, "\n", &context))
+		WLog_INFO(TAG, "%s", line);
+	free(text);
+}
+
 static DWORD WINAPI shadow_client_thread(LPVOID arg)
 {
 	rdpShadowClient* client = (rdpShadowClient*)arg;
@@ -2121,6 +2466,8 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 	/* This should only be visited in client thread */
 	SHADOW_GFX_STATUS gfxstatus = { 0 };
 	rdpUpdate* update = NULL;
+	UINT64 metricsDue = 0;
+	UINT64 refineDue = 0;
 
 	WINPR_ASSERT(client);
 
@@ -2177,6 +2524,9 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 	WINPR_ASSERT(rc);
 	rc = freerdp_settings_set_bool(settings, FreeRDP_SupportMonitorLayoutPdu, TRUE);
 	WINPR_ASSERT(rc);
+	if (server->metricsInterval > 0)
+		metricsDue = GetTickCount64() + 1000ull * server->metricsInterval;
+
 	while (1)
 	{
 		HANDLE events[MAXIMUM_WAIT_OBJECTS] = { 0 };
@@ -2203,11 +2553,52 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 			events[nCount++] = gfxevent;
 #endif
 
-		status = WaitForMultipleObjects(nCount, events, FALSE, INFINITE);
+		/* Wake up to refine progressive tiles, the deadline is kept across loop iterations so a
+		 * continuous stream of updates does not postpone the refinement forever */
+		DWORD timeout = INFINITE;
+
+		if (shadow_client_refinement_pending(client, &gfxstatus))
+		{
+			const UINT64 now = GetTickCount64();
+
+			if (refineDue == 0)
+				refineDue = now + SHADOW_REFINE_INTERVAL_MS;
+
+			timeout = (DWORD)((refineDue > now) ? refineDue - now : 0);
+		}
+		else
+			refineDue = 0;
+
+		/* and to log the connection metrics */
+		if (metricsDue > 0)
+		{
+			const UINT64 now = GetTickCount64();
+			const UINT64 remaining = (metricsDue > now) ? metricsDue - now : 0;
+			timeout = (DWORD)MIN(timeout, remaining);
+		}
+
+		status = WaitForMultipleObjects(nCount, events, FALSE, timeout);
 
 		if (status == WAIT_FAILED)
 			goto fail;
 
+		if ((metricsDue > 0) && (GetTickCount64() >= metricsDue))
+		{
+			shadow_client_log_metrics(client);
+			metricsDue = GetTickCount64() + 1000ull * server->metricsInterval;
+		}
+
+		if ((refineDue > 0) && (GetTickCount64() >= refineDue))
+		{
+			refineDue = 0;
+
+			if (!shadow_client_send_surface_refinement(client, &gfxstatus))
+			{
+				WLog_ERR(TAG, "Failed to send surface refinement");
+				break;
+			}
+		}
+
 		if (WaitForSingleObject(UpdateEvent, 0) == WAIT_OBJECT_0)
 		{
 			/* The UpdateEvent means to start sending current frame. It is
@@ -2453,6 +2844,9 @@ fail:
 		subsystem->ClientDisconnect(subsystem, client);
 	}
 
+	if (server->metricsInterval > 0)
+		shadow_client_log_metrics(client);
+
 out:
 	WINPR_ASSERT(peer->Disconnect);
 	peer->Disconnect(peer);
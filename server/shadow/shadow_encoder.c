@@ -19,6 +19,7 @@
 #include <freerdp/config.h>
 
 #include <winpr/assert.h>
+#include <winpr/sysinfo.h>
 
 #include "shadow.h"
 
@@ -49,6 +50,46 @@ UINT32 shadow_encoder_inflight_frames(rdpShadowEncoder* encoder)
 	           : encoder->frameId - encoder->lastAckframeId;
 }
 
+static BOOL shadow_encoder_apply_rate_control(rdpShadowEncoder* encoder)
+{
+	WINPR_ASSERT(encoder);
+	WINPR_ASSERT(encoder->server);
+
+	const rdpShadowServer* server = encoder->server;
+	const SHADOW_RATE_CONTROL_METRICS* m = &encoder->rateControl.metrics;
+	UINT32 videoQPOffset = m->videoQPOffset;
+
+	if (!encoder->h264)
+		return TRUE;
+
+	/* The bit rate is only honoured by the encoder in VBR mode, constant QP mode
+	 * trades quality for size through the QP itself. */
+	if (server->h264RateControlMode == H264_RATECONTROL_VBR)
+	{
+		if (!h264_context_set_option(encoder->h264, H264_CONTEXT_OPTION_BITRATE,
+		                             MIN(m->bitRate, server->h264BitRate)))
+			return FALSE;
+	}
+	else
+	{
+		if (!h264_context_set_option(encoder->h264, H264_CONTEXT_OPTION_QP,
+		                             MIN(server->h264QP + m->qpOffset, 51)))
+			return FALSE;
+
+		/* The region hints are relative to the frame QP which already carries qpOffset */
+		videoQPOffset -= MIN(m->qpOffset, videoQPOffset);
+	}
+
+	if (!h264_context_set_option(encoder->h264, H264_CONTEXT_OPTION_FRAMERATE,
+	                             MIN(m->fps, server->h264FrameRate)))
+		return FALSE;
+	if (!h264_context_set_option(encoder->h264, H264_CONTEXT_OPTION_TEXT_QP_OFFSET,
+	                             m->textQPOffset))
+		return FALSE;
+	return h264_context_set_option(encoder->h264, H264_CONTEXT_OPTION_VIDEO_QP_OFFSET,
+	                               videoQPOffset);
+}
+
 UINT32 shadow_encoder_create_frame_id(rdpShadowEncoder* encoder)
 {
 	UINT32 frameId = 0;
@@ -71,13 +112,43 @@ UINT32 shadow_encoder_create_frame_id(rdpShadowEncoder* encoder)
 			encoder->fps = encoder->maxFps;
 	}
 
+	const UINT64 now = GetTickCount64();
+	if (shadow_rate_control_update(&encoder->rateControl, inFlightFrames, now) &&
+	    !shadow_encoder_apply_rate_control(encoder))
+		WLog_WARN(TAG, "failed to apply rate control decisions");
+
+	encoder->fps = MIN(encoder->fps, encoder->rateControl.metrics.fps);
+
 	if (encoder->fps < 1)
 		encoder->fps = 1;
 
 	frameId = ++encoder->frameId;
+	shadow_rate_control_frame_sent(&encoder->rateControl, frameId, now);
+	if (encoder->client)
+		freerdp_metrics_frame_sent(encoder->client->context.metrics, frameId);
 	return frameId;
 }
 
+void shadow_encoder_frame_acknowledge(rdpShadowEncoder* encoder, UINT32 frameId)
+{
+	WINPR_ASSERT(encoder);
+
+	encoder->lastAckframeId = frameId;
+	shadow_rate_control_frame_acked(&encoder->rateControl, frameId, GetTickCount64());
+	if (encoder->client)
+		freerdp_metrics_frame_acked(encoder->client->context.metrics, frameId);
+}
+
+BOOL shadow_encoder_get_rate_control_metrics(rdpShadowEncoder* encoder,
+                                             SHADOW_RATE_CONTROL_METRICS* metrics)
+{
+	if (!encoder || !metrics)
+		return FALSE;
+
+	*metrics = encoder->rateControl.metrics;
+	return TRUE;
+}
+
 static int shadow_encoder_init_grid(rdpShadowEncoder* encoder)
 {
 	UINT32 tileSize = 0;
@@ -197,8 +268,9 @@ static int shadow_encoder_init_planar(rdpShadowEncoder* encoder)
 
 	if (!encoder->planar)
 	{
-		encoder->planar = freerdp_bitmap_planar_context_new(planarFlags, encoder->maxTileWidth,
-		                                                    encoder->maxTileHeight);
+		encoder->planar = freerdp_bitmap_planar_context_new_ex(
+		    planarFlags, encoder->maxTileWidth, encoder->maxTileHeight,
+		    freerdp_settings_get_uint32(encoder->server->settings, FreeRDP_ThreadingFlags));
 	}
 
 	if (!encoder->planar)
@@ -255,6 +327,8 @@ static int shadow_encoder_init_h264(rdpShadowEncoder* encoder)
 		goto fail;
 	if (!h264_context_set_option(encoder->h264, H264_CONTEXT_OPTION_QP, encoder->server->h264QP))
 		goto fail;
+	if (!shadow_encoder_apply_rate_control(encoder))
+		goto fail;
 
 	encoder->codecs |= FREERDP_CODEC_AVC420 | FREERDP_CODEC_AVC444;
 	return 1;
@@ -275,10 +349,15 @@ static int shadow_encoder_init_progressive(rdpShadowEncoder* encoder)
 	if (!progressive_context_reset(encoder->progressive))
 		goto fail;
 
+	/* Send changed tiles coarse first, the client loop refines them periodically */
+	if (!progressive_context_set_refinement(encoder->progressive, TRUE))
+		goto fail;
+
 	encoder->codecs |= FREERDP_CODEC_PROGRESSIVE;
 	return 1;
 fail:
 	progressive_context_free(encoder->progressive);
+	encoder->progressive = NULL;
 	return -1;
 }
 
@@ -402,6 +481,8 @@ int shadow_encoder_reset(rdpShadowEncoder* encoder)
 	UINT32 codecs = encoder->codecs;
 	rdpContext* context = (rdpContext*)encoder->client;
 	rdpSettings* settings = context->settings;
+	shadow_rate_control_reset(&encoder->rateControl, encoder->server->h264BitRate,
+	                          encoder->maxFps);
 	status = shadow_encoder_uninit(encoder);
 
 	if (status < 0)
@@ -422,6 +503,10 @@ int shadow_encoder_reset(rdpShadowEncoder* encoder)
 	encoder->frameId = 0;
 	encoder->lastAckframeId = 0;
 	encoder->frameAck = freerdp_settings_get_bool(settings, FreeRDP_SurfaceFrameMarkerEnabled);
+
+	if (!shadow_bitmap_cache_reset(encoder->bitmapCache, context))
+		return -1;
+
 	return 1;
 }
 
@@ -500,9 +585,12 @@ rdpShadowEncoder* shadow_encoder_new(rdpShadowClient* client)
 	encoder->server = server;
 	encoder->fps = 16;
 	encoder->maxFps = 32;
+	shadow_rate_control_reset(&encoder->rateControl, server->h264BitRate, encoder->maxFps);
+	encoder->bitmapCache = shadow_bitmap_cache_new(server->bitmapCachePersist);
 
-	if (shadow_encoder_init(encoder) < 0)
+	if (!encoder->bitmapCache || (shadow_encoder_init(encoder) < 0))
 	{
+		shadow_bitmap_cache_free(encoder->bitmapCache);
 		free(encoder);
 		return NULL;
 	}
@@ -516,5 +604,6 @@ void shadow_encoder_free(rdpShadowEncoder* encoder)
 		return;
 
 	shadow_encoder_uninit(encoder);
+	shadow_bitmap_cache_free(encoder->bitmapCache);
 	free(encoder);
 }
@@ -27,6 +27,9 @@
 
 #include <freerdp/server/shadow.h>
 
+#include "shadow_bitmapcache.h"
+#include "shadow_ratecontrol.h"
+
 struct rdp_shadow_encoder
 {
 	rdpShadowClient* client;
@@ -58,6 +61,9 @@ struct rdp_shadow_encoder
 	UINT32 frameId;
 	UINT32 lastAckframeId;
 	UINT32 queueDepth;
+
+	rdpShadowRateControl rateControl;
+	rdpShadowBitmapCache* bitmapCache;
 };
 
 #ifdef __cplusplus
@@ -68,6 +74,7 @@ extern "C"
 	int shadow_encoder_reset(rdpShadowEncoder* encoder);
 	int shadow_encoder_prepare(rdpShadowEncoder* encoder, UINT32 codecs);
 	UINT32 shadow_encoder_create_frame_id(rdpShadowEncoder* encoder);
+	void shadow_encoder_frame_acknowledge(rdpShadowEncoder* encoder, UINT32 frameId);
 
 	void shadow_encoder_free(rdpShadowEncoder* encoder);
 
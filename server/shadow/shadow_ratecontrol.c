@@ -0,0 +1,189 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Shadow Server H.264 Rate Control
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/assert.h>
+
+#include "shadow_ratecontrol.h"
+
+#include <freerdp/log.h>
+#define TAG SERVER_TAG("shadow.ratecontrol")
+
+#define SHADOW_RATE_CONTROL_INTERVAL_MS 250
+#define SHADOW_RATE_CONTROL_WINDOW_MS 10000
+#define SHADOW_RATE_CONTROL_PROBE_MS 2000
+#define SHADOW_RATE_CONTROL_MIN_QUEUE_MS 50
+#define SHADOW_RATE_CONTROL_MIN_BITRATE 256000
+#define SHADOW_RATE_CONTROL_MIN_FPS 5
+#define SHADOW_RATE_CONTROL_TEXT_QP_OFFSET 6
+#define SHADOW_RATE_CONTROL_MAX_QP_OFFSET 10
+
+void shadow_rate_control_reset(rdpShadowRateControl* rc, UINT32 maxBitRate, UINT32 maxFps)
+{
+	WINPR_ASSERT(rc);
+
+	const SHADOW_RATE_CONTROL_METRICS metrics = rc->metrics;
+	const rdpShadowRateControl empty = { 0 };
+	*rc = empty;
+
+	rc->maxBitRate = MAX(maxBitRate, SHADOW_RATE_CONTROL_MIN_BITRATE);
+	rc->maxFps = MAX(maxFps, SHADOW_RATE_CONTROL_MIN_FPS);
+	rc->windowMinLatency = UINT32_MAX;
+
+	/* Counters survive a reset so monitoring sees the whole session */
+	rc->metrics.congestionEvents = metrics.congestionEvents;
+	rc->metrics.decisions = metrics.decisions;
+	rc->metrics.bitRate = rc->maxBitRate;
+	rc->metrics.fps = rc->maxFps;
+	rc->metrics.textQPOffset = SHADOW_RATE_CONTROL_TEXT_QP_OFFSET;
+}
+
+void shadow_rate_control_frame_sent(rdpShadowRateControl* rc, UINT32 frameId, UINT64 now)
+{
+	WINPR_ASSERT(rc);
+
+	SHADOW_RATE_CONTROL_FRAME* frame = &rc->frames[frameId % SHADOW_RATE_CONTROL_HISTORY];
+	frame->frameId = frameId;
+	frame->sent = now;
+}
+
+void shadow_rate_control_frame_acked(rdpShadowRateControl* rc, UINT32 frameId, UINT64 now)
+{
+	WINPR_ASSERT(rc);
+
+	const SHADOW_RATE_CONTROL_FRAME* frame = &rc->frames[frameId % SHADOW_RATE_CONTROL_HISTORY];
+
+	/* Too old or acknowledged twice */
+	if ((frame->frameId != frameId) || (frame->sent == 0) || (now < frame->sent))
+		return;
+
+	const UINT32 latency = (UINT32)MIN(now - frame->sent, UINT32_MAX);
+	SHADOW_RATE_CONTROL_METRICS* m = &rc->metrics;
+
+	if (m->ackLatency == 0)
+		m->ackLatency = latency;
+	else
+		m->ackLatency = (m->ackLatency * 7 + latency) / 8;
+
+	/* The base latency follows the minimum of the last window so it recovers from path
+	 * changes instead of remembering a single lucky sample forever. */
+	rc->windowMinLatency = MIN(rc->windowMinLatency, latency);
+	if ((m->baseLatency == 0) || (latency < m->baseLatency))
+		m->baseLatency = latency;
+
+	if (rc->windowStart == 0)
+		rc->windowStart = now;
+	else if (now - rc->windowStart >= SHADOW_RATE_CONTROL_WINDOW_MS)
+	{
+		m->baseLatency = rc->windowMinLatency;
+		rc->windowMinLatency = UINT32_MAX;
+		rc->windowStart = now;
+	}
+
+	rc->frames[frameId % SHADOW_RATE_CONTROL_HISTORY].sent = 0;
+}
+
+void shadow_rate_control_bandwidth(rdpShadowRateControl* rc, UINT32 timeDelta, UINT32 byteCount)
+{
+	WINPR_ASSERT(rc);
+
+	if (timeDelta == 0)
+		return;
+
+	/* bytes per ms times 8 is kbit/s */
+	const UINT64 kbps = (8ull * byteCount) / timeDelta;
+	rc->metrics.bandwidth = (UINT32)MIN(kbps, UINT32_MAX);
+}
+
+void shadow_rate_control_rtt(rdpShadowRateControl* rc, UINT32 rtt)
+{
+	WINPR_ASSERT(rc);
+	rc->metrics.rtt = rtt;
+}
+
+static UINT32 shadow_rate_control_ceiling(const rdpShadowRateControl* rc)
+{
+	UINT64 ceiling = rc->maxBitRate;
+
+	/* Leave headroom for other channels and protocol overhead */
+	if (rc->metrics.bandwidth > 0)
+		ceiling = MIN(ceiling, 1000ull * rc->metrics.bandwidth * 85 / 100);
+
+	return (UINT32)MAX(ceiling, SHADOW_RATE_CONTROL_MIN_BITRATE);
+}
+
+BOOL shadow_rate_control_update(rdpShadowRateControl* rc, UINT32 inflight, UINT64 now)
+{
+	WINPR_ASSERT(rc);
+
+	if (now - rc->lastUpdate < SHADOW_RATE_CONTROL_INTERVAL_MS)
+		return FALSE;
+	rc->lastUpdate = now;
+
+	SHADOW_RATE_CONTROL_METRICS* m = &rc->metrics;
+	const SHADOW_RATE_CONTROL_METRICS old = *m;
+	const UINT32 queue = (m->ackLatency > m->baseLatency) ? m->ackLatency - m->baseLatency : 0;
+	const UINT32 threshold = MAX(SHADOW_RATE_CONTROL_MIN_QUEUE_MS, m->baseLatency / 2);
+	const UINT32 ceiling = shadow_rate_control_ceiling(rc);
+
+	if ((inflight > 2) || (queue > threshold))
+	{
+		m->bitRate = MAX(m->bitRate / 4 * 3, SHADOW_RATE_CONTROL_MIN_BITRATE);
+		m->fps = MAX(m->fps * 3 / 4, SHADOW_RATE_CONTROL_MIN_FPS);
+		m->congestionEvents++;
+	}
+	else if (queue < threshold / 2)
+	{
+		m->bitRate = MIN(m->bitRate + rc->maxBitRate / 20, ceiling);
+		m->fps = MIN(m->fps + 2, rc->maxFps);
+	}
+
+	m->bitRate = MIN(m->bitRate, ceiling);
+
+	/* Spend the remaining bits where they are most visible: natural content is
+	 * quantized coarser the further the bit rate dropped, text keeps its finer QP. */
+	const UINT64 deficit = rc->maxBitRate - m->bitRate;
+	m->videoQPOffset = (UINT32)(deficit * SHADOW_RATE_CONTROL_MAX_QP_OFFSET / rc->maxBitRate);
+	m->qpOffset = m->videoQPOffset / 2;
+	m->textQPOffset = SHADOW_RATE_CONTROL_TEXT_QP_OFFSET;
+
+	if ((m->bitRate == old.bitRate) && (m->fps == old.fps) && (m->qpOffset == old.qpOffset) &&
+	    (m->videoQPOffset == old.videoQPOffset))
+		return FALSE;
+
+	m->decisions++;
+	WLog_DBG(TAG,
+	         "latency %" PRIu32 "/%" PRIu32 "ms, bandwidth %" PRIu32 "kbit/s, rtt %" PRIu32
+	         "ms, inflight %" PRIu32 " -> bitrate %" PRIu32 ", fps %" PRIu32 ", qp +%" PRIu32,
+	         m->ackLatency, m->baseLatency, m->bandwidth, m->rtt, inflight, m->bitRate, m->fps,
+	         m->videoQPOffset);
+	return TRUE;
+}
+
+BOOL shadow_rate_control_probe_due(rdpShadowRateControl* rc, UINT64 now, UINT16* sequence)
+{
+	WINPR_ASSERT(rc);
+	WINPR_ASSERT(sequence);
+
+	if ((rc->lastProbe != 0) && (now - rc->lastProbe < SHADOW_RATE_CONTROL_PROBE_MS))
+		return FALSE;
+
+	rc->lastProbe = now;
+	*sequence = rc->probeSequence++;
+	return TRUE;
+}
@@ -0,0 +1,82 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Shadow Server H.264 Rate Control
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_SERVER_SHADOW_RATECONTROL_H
+#define FREERDP_SERVER_SHADOW_RATECONTROL_H
+
+#include <winpr/wtypes.h>
+
+#include <freerdp/api.h>
+#include <freerdp/server/shadow.h>
+
+/** Number of sent frames whose send time is remembered for latency measurement */
+#define SHADOW_RATE_CONTROL_HISTORY 64
+
+typedef struct
+{
+	UINT32 frameId;
+	UINT64 sent;
+} SHADOW_RATE_CONTROL_FRAME;
+
+/** AIMD controller fed by frame acknowledge latency and connection autodetect results
+ *
+ *  Queueing delay is the smoothed acknowledge latency above the lowest latency seen in
+ *  the last few seconds. Growing queues reduce bit rate and frame rate multiplicatively,
+ *  short queues let them recover additively up to the configured and measured limits.
+ */
+typedef struct
+{
+	UINT32 maxBitRate;
+	UINT32 maxFps;
+	UINT64 lastUpdate;
+
+	SHADOW_RATE_CONTROL_FRAME frames[SHADOW_RATE_CONTROL_HISTORY];
+
+	UINT32 windowMinLatency;
+	UINT64 windowStart;
+
+	UINT64 lastProbe;
+	UINT16 probeSequence;
+
+	SHADOW_RATE_CONTROL_METRICS metrics;
+} rdpShadowRateControl;
+
+FREERDP_LOCAL void shadow_rate_control_reset(rdpShadowRateControl* rc, UINT32 maxBitRate,
+                                             UINT32 maxFps);
+
+FREERDP_LOCAL void shadow_rate_control_frame_sent(rdpShadowRateControl* rc, UINT32 frameId,
+                                                  UINT64 now);
+FREERDP_LOCAL void shadow_rate_control_frame_acked(rdpShadowRateControl* rc, UINT32 frameId,
+                                                   UINT64 now);
+
+/** @brief record the result of a bandwidth measurement of \b byteCount bytes in \b timeDelta ms */
+FREERDP_LOCAL void shadow_rate_control_bandwidth(rdpShadowRateControl* rc, UINT32 timeDelta,
+                                                 UINT32 byteCount);
+FREERDP_LOCAL void shadow_rate_control_rtt(rdpShadowRateControl* rc, UINT32 rtt);
+
+/** @brief reevaluate the decisions, at most once per update interval
+ *
+ *  @return TRUE if any decision changed and the encoder must be reconfigured
+ */
+FREERDP_LOCAL BOOL shadow_rate_control_update(rdpShadowRateControl* rc, UINT32 inflight,
+                                              UINT64 now);
+
+/** @brief TRUE if a new bandwidth and round trip probe should be sent, updates \b sequence */
+FREERDP_LOCAL BOOL shadow_rate_control_probe_due(rdpShadowRateControl* rc, UINT64 now,
+                                                 UINT16* sequence);
+
+#endif /* FREERDP_SERVER_SHADOW_RATECONTROL_H */
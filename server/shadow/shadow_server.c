@@ -230,6 +230,41 @@ int shadow_server_parse_command_line(rdpShadowServer* server, int argc, char** a
 				return -1;
 			server->maxClientsConnected = val;
 		}
+		CommandLineSwitchCase(arg, "tls-session-cache")
+		{
+			errno = 0;
+			unsigned long val = strtoul(arg->Value, NULL, 0);
+
+			if ((errno != 0) || (val > UINT32_MAX))
+				return -1;
+			server->tlsSessionCacheSize = val;
+		}
+		CommandLineSwitchCase(arg, "tls-session-lifetime")
+		{
+			errno = 0;
+			unsigned long val = strtoul(arg->Value, NULL, 0);
+
+			if ((errno != 0) || (val == 0) || (val > UINT32_MAX))
+				return -1;
+			server->tlsSessionLifetime = (UINT32)val;
+		}
+		CommandLineSwitchCase(arg, "metrics-interval")
+		{
+			errno = 0;
+			unsigned long val = strtoul(arg->Value, NULL, 0);
+
+			if ((errno != 0) || (val > UINT32_MAX))
+				return -1;
+			server->metricsInterval = (UINT32)val;
+		}
+		CommandLineSwitchCase(arg, "bitmap-cache")
+		{
+			server->bitmapCache = arg->Value ? TRUE : FALSE;
+		}
+		CommandLineSwitchCase(arg, "bitmap-cache-persist")
+		{
+			server->bitmapCachePersist = arg->Value ? TRUE : FALSE;
+		}
 		CommandLineSwitchCase(arg, "rect")
 		{
 			char* p = NULL;
@@ -902,6 +937,14 @@ int shadow_server_init(rdpShadowServer* server)
 	if (!shadow_server_init_certificate(server))
 		goto fail;
 
+	if (server->tlsSessionCacheSize > 0)
+	{
+		server->tlsSessionCache = freerdp_tls_session_cache_new(
+		    server->tlsSessionCacheSize, server->tlsSessionLifetime, NULL);
+		if (!server->tlsSessionCache)
+			goto fail;
+	}
+
 	server->listener = freerdp_listener_new();
 
 	if (!server->listener)
@@ -938,6 +981,8 @@ int shadow_server_uninit(rdpShadowServer* server)
 	server->subsystem = NULL;
 	freerdp_listener_free(server->listener);
 	server->listener = NULL;
+	freerdp_tls_session_cache_free(server->tlsSessionCache);
+	server->tlsSessionCache = NULL;
 	free(server->CertificateFile);
 	server->CertificateFile = NULL;
 	free(server->PrivateKeyFile);
@@ -969,6 +1014,9 @@ rdpShadowServer* shadow_server_new(void)
 	server->h264FrameRate = 30;
 	server->h264QP = 0;
 	server->authentication = TRUE;
+	server->tlsSessionCacheSize = 1024;
+	server->tlsSessionLifetime = 3600;
+	server->bitmapCache = TRUE;
 	server->settings = freerdp_settings_new(FREERDP_SETTINGS_SERVER_MODE);
 	return server;
 }
@@ -0,0 +1,295 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/stream.h>
+
+#include <freerdp/peer.h>
+#include <freerdp/settings.h>
+
+#include "../shadow_bitmapcache.h"
+#include "../../../libfreerdp/core/activation.h"
+
+#define TEST_CELL_SIZE 4
+#define TEST_KEY_1 0x1122334455667788ull
+#define TEST_KEY_2 0x0102030405060708ull
+#define TEST_KEY_3 0x0A0B0C0D0E0F1011ull
+
+/* cell 0 takes 16x16 tiles, the persistent cell 1 32x32 and cell 2 64x64 tiles */
+static BOOL test_configure(rdpSettings* settings, UINT32 colorDepth)
+{
+	BYTE* orders = freerdp_settings_get_pointer_writable(settings, FreeRDP_OrderSupport);
+	if (!orders)
+		return FALSE;
+	orders[NEG_MEMBLT_INDEX] = TRUE;
+
+	for (UINT32 x = 0; x < 3; x++)
+	{
+		const BITMAP_CACHE_V2_CELL_INFO info = { TEST_CELL_SIZE, x == 1 };
+		if (!freerdp_settings_set_pointer_array(settings, FreeRDP_BitmapCacheV2CellInfo, x, &info))
+			return FALSE;
+	}
+
+	return freerdp_settings_set_bool(settings, FreeRDP_BitmapCacheEnabled, TRUE) &&
+	       freerdp_settings_set_bool(settings, FreeRDP_BitmapCachePersistEnabled, TRUE) &&
+	       freerdp_settings_set_uint32(settings, FreeRDP_BitmapCacheV2NumCells, 3) &&
+	       freerdp_settings_set_uint32(settings, FreeRDP_ColorDepth, colorDepth);
+}
+
+/* a persistent key list PDU offering \b count keys for cell 1 */
+static BOOL test_offer_keys(rdpContext* context, const UINT64* keys, UINT16 count)
+{
+	wStream* s = Stream_New(NULL, 24 + 8ull * count);
+	if (!s)
+		return FALSE;
+
+	for (size_t x = 0; x < 10; x++)
+		Stream_Write_UINT16(s, ((x % 5) == 1) ? count : 0);
+	Stream_Write_UINT8(s, PERSIST_FIRST_PDU | PERSIST_LAST_PDU);
+	Stream_Zero(s, 3);
+	for (size_t x = 0; x < count; x++)
+	{
+		Stream_Write_UINT32(s, (UINT32)keys[x]);
+		Stream_Write_UINT32(s, (UINT32)(keys[x] >> 32));
+	}
+	Stream_SealLength(s);
+	Stream_SetPosition(s, 0);
+
+	const BOOL rc = rdp_server_accept_client_persistent_key_list_pdu(context->rdp, s);
+	Stream_Free(s, TRUE);
+	return rc;
+}
+
+static BYTE* test_tile(UINT32 size, BYTE seed)
+{
+	BYTE* tile = calloc(size, 4ull * size);
+	if (!tile)
+		return NULL;
+
+	for (size_t x = 0; x < 4ull * size * size; x++)
+		tile[x] = (BYTE)(x * 7 + seed);
+	return tile;
+}
+
+static BOOL test_lookup(rdpShadowBitmapCache* cache, const BYTE* tile, UINT32 size,
+                        UINT16 cacheId, UINT16 cacheIndex)
+{
+	UINT16 id = 0;
+	UINT16 index = 0;
+	UINT64 check = 0;
+	const UINT64 key = shadow_bitmap_cache_key(tile, 4 * size, size, size, 32, &check);
+
+	if (!shadow_bitmap_cache_lookup(cache, key, check, &id, &index))
+		return FALSE;
+	return (id == cacheId) && (index == cacheIndex);
+}
+
+static BOOL test_insert(rdpShadowBitmapCache* cache, const BYTE* tile, UINT32 size,
+                        UINT16 cacheId, UINT16 cacheIndex)
+{
+	UINT16 id = 0;
+	UINT16 index = 0;
+	BOOL persistent = FALSE;
+	UINT64 check = 0;
+	const UINT64 key = shadow_bitmap_cache_key(tile, 4 * size, size, size, 32, &check);
+
+	if (!shadow_bitmap_cache_insert(cache, key, check, size, size, &id, &index, &persistent))
+		return FALSE;
+	return (id == cacheId) && (index == cacheIndex) && (persistent == (cacheId == 1));
+}
+
+/* Tiles land in the smallest cell taking their size, full cells evict the least recently
+ * used entry */
+static BOOL test_mirror(rdpContext* context)
+{
+	BOOL rc = FALSE;
+	BYTE* tiles[TEST_CELL_SIZE + 1] = { 0 };
+	BYTE* large = test_tile(64, 0x55);
+	rdpShadowBitmapCache* cache = shadow_bitmap_cache_new(FALSE);
+
+	if (!large || !cache || !test_configure(context->settings, 32) ||
+	    !shadow_bitmap_cache_reset(cache, context) || !shadow_bitmap_cache_enabled(cache))
+		goto fail;
+
+	for (size_t x = 0; x < ARRAYSIZE(tiles); x++)
+	{
+		tiles[x] = test_tile(16, (BYTE)x);
+		if (!tiles[x])
+			goto fail;
+	}
+
+	for (UINT16 x = 0; x < TEST_CELL_SIZE; x++)
+	{
+		if (test_lookup(cache, tiles[x], 16, 0, x) || !test_insert(cache, tiles[x], 16, 0, x) ||
+		    !test_lookup(cache, tiles[x], 16, 0, x))
+			goto fail;
+	}
+
+	if (!test_insert(cache, large, 64, 2, 0) || !test_lookup(cache, large, 64, 2, 0))
+		goto fail;
+
+	/* tile 0 was used last, tile 1 is evicted */
+	if (!test_lookup(cache, tiles[0], 16, 0, 0) ||
+	    !test_insert(cache, tiles[TEST_CELL_SIZE], 16, 0, 1) ||
+	    test_lookup(cache, tiles[1], 16, 0, 1) ||
+	    !test_lookup(cache, tiles[TEST_CELL_SIZE], 16, 0, 1) ||
+	    !test_lookup(cache, tiles[2], 16, 0, 2))
+		goto fail;
+
+	/* without MemBlt support the mirror stays off */
+	BYTE* orders = freerdp_settings_get_pointer_writable(context->settings, FreeRDP_OrderSupport);
+	orders[NEG_MEMBLT_INDEX] = FALSE;
+	if (!shadow_bitmap_cache_reset(cache, context) || shadow_bitmap_cache_enabled(cache) ||
+	    test_lookup(cache, tiles[0], 16, 0, 0))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	for (size_t x = 0; x < ARRAYSIZE(tiles); x++)
+		free(tiles[x]);
+	free(large);
+	shadow_bitmap_cache_free(cache);
+	return rc;
+}
+
+/* A matching key is only a hit if the second half of the content key matches as well */
+static BOOL test_collision(rdpContext* context)
+{
+	BOOL rc = FALSE;
+	UINT16 id = 0;
+	UINT16 index = 0;
+	BOOL persistent = FALSE;
+	BYTE* first = test_tile(16, 1);
+	BYTE* second = test_tile(16, 2);
+	rdpShadowBitmapCache* cache = shadow_bitmap_cache_new(FALSE);
+
+	if (!first || !second || !cache || !test_configure(context->settings, 32) ||
+	    !shadow_bitmap_cache_reset(cache, context))
+		goto fail;
+
+	/* both tiles under the key of the first one */
+	UINT64 checkFirst = 0;
+	UINT64 checkSecond = 0;
+	const UINT64 key = shadow_bitmap_cache_key(first, 64, 16, 16, 32, &checkFirst);
+	const UINT64 other = shadow_bitmap_cache_key(second, 64, 16, 16, 32, &checkSecond);
+	if ((key == other) || (checkFirst == checkSecond))
+		goto fail;
+
+	if (!shadow_bitmap_cache_insert(cache, key, checkFirst, 16, 16, &id, &index, &persistent) ||
+	    shadow_bitmap_cache_lookup(cache, key, checkSecond, &id, &index))
+		goto fail;
+
+	if (!shadow_bitmap_cache_insert(cache, key, checkSecond, 16, 16, &id, &index, &persistent) ||
+	    (index != 1))
+		goto fail;
+
+	if (!shadow_bitmap_cache_lookup(cache, key, checkFirst, &id, &index) || (index != 0) ||
+	    !shadow_bitmap_cache_lookup(cache, key, checkSecond, &id, &index) || (index != 1))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	free(first);
+	free(second);
+	shadow_bitmap_cache_free(cache);
+	return rc;
+}
+
+static BOOL test_key_hit(rdpShadowBitmapCache* cache, UINT64 key, const BYTE* tile,
+                         UINT16 cacheIndex)
+{
+	UINT16 id = 0;
+	UINT16 index = 0;
+	UINT64 check = 0;
+
+	/* restored keys carry no check, any check matches */
+	(void)shadow_bitmap_cache_key(tile, 128, 32, 32, 32, &check);
+	if (!shadow_bitmap_cache_lookup(cache, key, check, &id, &index))
+		return FALSE;
+	return (id == 1) && (index == cacheIndex);
+}
+
+/* Offered keys are trusted only when enabled and seed the persistent cell once per
+ * connection, persistent entries survive resets with the same layout */
+static BOOL test_persistent(rdpContext* context)
+{
+	BOOL rc = FALSE;
+	const UINT64 keys[] = { TEST_KEY_1, TEST_KEY_2 };
+	BYTE* small = test_tile(16, 3);
+	BYTE* tile = test_tile(32, 4);
+	rdpShadowBitmapCache* trusting = shadow_bitmap_cache_new(TRUE);
+	rdpShadowBitmapCache* cache = shadow_bitmap_cache_new(FALSE);
+
+	if (!small || !tile || !trusting || !cache || !test_configure(context->settings, 32) ||
+	    !test_offer_keys(context, keys, ARRAYSIZE(keys)) ||
+	    !shadow_bitmap_cache_reset(trusting, context) || !shadow_bitmap_cache_reset(cache, context))
+		goto fail;
+
+	if (test_key_hit(cache, TEST_KEY_1, tile, 0) || !test_key_hit(trusting, TEST_KEY_1, tile, 0) ||
+	    !test_key_hit(trusting, TEST_KEY_2, tile, 1))
+		goto fail;
+
+	if (!test_insert(trusting, tile, 32, 1, 2) || !test_insert(trusting, small, 16, 0, 0))
+		goto fail;
+
+	/* keys offered later do not reseed the cell */
+	const UINT64 later[] = { TEST_KEY_3 };
+	if (!test_offer_keys(context, later, ARRAYSIZE(later)) ||
+	    !shadow_bitmap_cache_reset(trusting, context))
+		goto fail;
+
+	if (!test_key_hit(trusting, TEST_KEY_1, tile, 0) ||
+	    !test_key_hit(trusting, TEST_KEY_2, tile, 1) ||
+	    test_key_hit(trusting, TEST_KEY_3, tile, 0) || !test_lookup(trusting, tile, 32, 1, 2) ||
+	    test_lookup(trusting, small, 16, 0, 0))
+		goto fail;
+
+	/* a new color depth drops all entries */
+	if (!test_configure(context->settings, 16) || !shadow_bitmap_cache_reset(trusting, context) ||
+	    test_key_hit(trusting, TEST_KEY_1, tile, 0) || test_lookup(trusting, tile, 32, 1, 2))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	free(small);
+	free(tile);
+	shadow_bitmap_cache_free(trusting);
+	shadow_bitmap_cache_free(cache);
+	return rc;
+}
+
+int TestShadowBitmapCache(int argc, char* argv[])
+{
+	int rc = -1;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	freerdp_peer* peer = freerdp_peer_new(-1);
+	if (!peer || !freerdp_peer_context_new(peer))
+		goto fail;
+
+	if (!test_mirror(peer->context))
+	{
+		(void)fprintf(stderr, "test_mirror failed\n");
+		goto fail;
+	}
+
+	if (!test_collision(peer->context))
+	{
+		(void)fprintf(stderr, "test_collision failed\n");
+		goto fail;
+	}
+
+	if (!test_persistent(peer->context))
+	{
+		(void)fprintf(stderr, "test_persistent failed\n");
+		goto fail;
+	}
+
+	rc = 0;
+fail:
+	if (peer)
+		freerdp_peer_context_free(peer);
+	freerdp_peer_free(peer);
+	return rc;
+}
@@ -0,0 +1,101 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+
+#include "../shadow_ratecontrol.h"
+
+#define TEST_MAX_BITRATE 1000000
+#define TEST_MAX_FPS 30
+#define TEST_NOW 1000
+
+typedef struct
+{
+	const char* name;
+
+	/* state before the update */
+	UINT32 bitRate;
+	UINT32 fps;
+	UINT32 ackLatency;
+	UINT32 baseLatency;
+	UINT32 bandwidth;
+	UINT32 inflight;
+
+	/* decisions after the update */
+	BOOL changed;
+	UINT32 expectBitRate;
+	UINT32 expectFps;
+	UINT32 expectCongestion;
+	UINT32 expectQPOffset;
+	UINT32 expectVideoQPOffset;
+} TestRateControlCase;
+
+static const TestRateControlCase test_cases[] = {
+	/* additive increase while the queue is short */
+	{ "increase", 500000, 20, 50, 50, 0, 0, TRUE, 550000, 22, 0, 2, 4 },
+	{ "increase clamped to max", 980000, 29, 50, 50, 0, 0, TRUE, 1000000, 30, 0, 0, 0 },
+	{ "increase clamped to bandwidth", 400000, 20, 50, 50, 500, 0, TRUE, 425000, 22, 0, 2, 5 },
+
+	/* multiplicative decrease on a growing queue or too many frames in flight */
+	{ "decrease on queue", 1000000, 30, 200, 50, 0, 0, TRUE, 750000, 22, 1, 1, 2 },
+	{ "decrease on inflight", 1000000, 30, 50, 50, 0, 3, TRUE, 750000, 22, 1, 1, 2 },
+	{ "decrease threshold scales", 1000000, 30, 310, 200, 0, 0, TRUE, 750000, 22, 1, 1, 2 },
+	{ "decrease clamped to min", 300000, 6, 50, 50, 0, 3, TRUE, 256000, 5, 1, 3, 7 },
+
+	/* a queue between both thresholds holds, the bandwidth ceiling still applies */
+	{ "hold", 1000000, 30, 80, 50, 0, 0, FALSE, 1000000, 30, 0, 0, 0 },
+	{ "hold below scaled threshold", 1000000, 30, 290, 200, 0, 2, FALSE, 1000000, 30, 0, 0, 0 },
+	{ "hold clamped to bandwidth", 1000000, 30, 80, 50, 500, 0, TRUE, 425000, 30, 0, 2, 5 },
+};
+
+static BOOL test_rate_control_case(const TestRateControlCase* test)
+{
+	rdpShadowRateControl rc = { 0 };
+
+	shadow_rate_control_reset(&rc, TEST_MAX_BITRATE, TEST_MAX_FPS);
+
+	SHADOW_RATE_CONTROL_METRICS* m = &rc.metrics;
+	m->bitRate = test->bitRate;
+	m->fps = test->fps;
+	m->ackLatency = test->ackLatency;
+	m->baseLatency = test->baseLatency;
+	m->bandwidth = test->bandwidth;
+
+	const BOOL changed = shadow_rate_control_update(&rc, test->inflight, TEST_NOW);
+
+	/* The encoder applies qpOffset to the frame and hints the rest for natural content */
+	if ((changed != test->changed) || (m->bitRate != test->expectBitRate) ||
+	    (m->fps != test->expectFps) || (m->congestionEvents != test->expectCongestion) ||
+	    (m->qpOffset != test->expectQPOffset) || (m->videoQPOffset != test->expectVideoQPOffset) ||
+	    (m->qpOffset > m->videoQPOffset))
+	{
+		fprintf(stderr,
+		        "%s: changed %d bitrate %" PRIu32 " fps %" PRIu32 " congestion %" PRIu32
+		        " qp +%" PRIu32 " video qp +%" PRIu32 "\n",
+		        test->name, changed, m->bitRate, m->fps, m->congestionEvents, m->qpOffset,
+		        m->videoQPOffset);
+		return FALSE;
+	}
+
+	/* Decisions are reevaluated at most once per interval */
+	if (shadow_rate_control_update(&rc, test->inflight + 3, TEST_NOW + 1))
+	{
+		fprintf(stderr, "%s: updated twice in one interval\n", test->name);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+int TestShadowRateControl(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	for (size_t x = 0; x < ARRAYSIZE(test_cases); x++)
+	{
+		if (!test_rate_control_case(&test_cases[x]))
+			return -1;
+	}
+
+	return 0;
+}
@@ -139,6 +139,186 @@ static wClipboardSynthesizer* ClipboardFindSynthesizer(wClipboardFormat* format,
 	return NULL;
 }
 
+/**
+ * Synthesized data is cached per (content key, source format, target format) so repeated
+ * requests for the same clipboard content do not convert again, even if the owner sets the
+ * same data again before each request. Synthesizers with side effects (file lists) are
+ * registered uncached and run on every request.
+ */
+typedef struct
+{
+	UINT32 srcFormatId;
+	UINT32 dstFormatId;
+	void* data;
+	UINT32 size;
+} wClipboardConversion;
+
+static void ClipboardConversionFree(void* obj)
+{
+	wClipboardConversion* conversion = (wClipboardConversion*)obj;
+
+	if (!conversion)
+		return;
+
+	free(conversion->data);
+	free(conversion);
+}
+
+#define CLIPBOARD_PRIME64_1 0x9E3779B185EBCA87ull
+#define CLIPBOARD_PRIME64_2 0xC2B2AE3D27D4EB4Full
+#define CLIPBOARD_PRIME64_3 0x165667B19E3779F9ull
+#define CLIPBOARD_PRIME64_4 0x85EBCA77C2B2AE63ull
+
+static INLINE UINT64 ClipboardRotl64(UINT64 x, UINT32 r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static INLINE UINT64 ClipboardMix64(UINT64 x)
+{
+	x ^= x >> 33;
+	x *= 0xFF51AFD7ED558CCDull;
+	x ^= x >> 33;
+	x *= 0xC4CEB9FE1A85EC53ull;
+	x ^= x >> 33;
+	return x;
+}
+
+static INLINE void ClipboardKeyRound(UINT64 key[2], UINT64 val)
+{
+	key[0] = ClipboardRotl64(key[0] + val * CLIPBOARD_PRIME64_2, 31) * CLIPBOARD_PRIME64_1;
+	key[1] = ClipboardRotl64(key[1] ^ (val * CLIPBOARD_PRIME64_4), 29) * CLIPBOARD_PRIME64_3;
+}
+
+/**
+ * 128bit key of the clipboard content, two independent multiply/rotate lanes so a change is
+ * only missed if both collide. A single pass over the data, cheaper than any conversion.
+ */
+static void ClipboardContentKey(const BYTE* data, size_t size, UINT64 key[2])
+{
+	size_t x = 0;
+
+	key[0] = CLIPBOARD_PRIME64_1 ^ size;
+	key[1] = CLIPBOARD_PRIME64_3 + size;
+
+	for (; x + sizeof(UINT64) <= size; x += sizeof(UINT64))
+	{
+		UINT64 val = 0;
+		memcpy(&val, &data[x], sizeof(UINT64));
+		ClipboardKeyRound(key, val);
+	}
+
+	if (x < size)
+	{
+		UINT64 val = 0;
+		memcpy(&val, &data[x], size - x);
+		ClipboardKeyRound(key, val);
+	}
+
+	key[0] = ClipboardMix64(key[0]);
+	key[1] = ClipboardMix64(key[1]);
+}
+
+/* Drops the cached conversions if the content changed since they were made */
+static void ClipboardCheckConversions(wClipboard* clipboard)
+{
+	WINPR_ASSERT(clipboard);
+
+	if (clipboard->contentKeyValid)
+		return;
+
+	UINT64 key[2] = { 0 };
+	ClipboardContentKey(clipboard->data, clipboard->size, key);
+
+	if ((key[0] != clipboard->contentKey[0]) || (key[1] != clipboard->contentKey[1]) ||
+	    (clipboard->formatId != clipboard->contentFormatId) ||
+	    (clipboard->size != clipboard->contentSize))
+	{
+		ArrayList_Clear(clipboard->conversions);
+		clipboard->contentKey[0] = key[0];
+		clipboard->contentKey[1] = key[1];
+		clipboard->contentFormatId = clipboard->formatId;
+		clipboard->contentSize = clipboard->size;
+	}
+
+	clipboard->contentKeyValid = TRUE;
+}
+
+static wClipboardConversion* ClipboardFindConversion(wClipboard* clipboard, UINT32 srcFormatId,
+                                                     UINT32 dstFormatId)
+{
+	WINPR_ASSERT(clipboard);
+
+	ClipboardCheckConversions(clipboard);
+
+	const size_t count = ArrayList_Count(clipboard->conversions);
+	for (size_t x = 0; x < count; x++)
+	{
+		wClipboardConversion* conversion = ArrayList_GetItem(clipboard->conversions, x);
+		if ((conversion->srcFormatId == srcFormatId) && (conversion->dstFormatId == dstFormatId))
+			return conversion;
+	}
+
+	return NULL;
+}
+
+static void* ClipboardSynthesize(wClipboard* clipboard, wClipboardFormat* format, UINT32 formatId,
+                                 UINT32* pSize)
+{
+	WINPR_ASSERT(clipboard);
+	WINPR_ASSERT(format);
+	WINPR_ASSERT(pSize);
+
+	wClipboardSynthesizer* synthesizer = ClipboardFindSynthesizer(format, formatId);
+
+	if (!synthesizer || !synthesizer->pfnSynthesize)
+		return NULL;
+
+	wClipboardConversion* conversion =
+	    synthesizer->cached ? ClipboardFindConversion(clipboard, format->formatId, formatId)
+	                        : NULL;
+
+	if (!conversion)
+	{
+		UINT32 DstSize = clipboard->size;
+		void* pDstData =
+		    synthesizer->pfnSynthesize(clipboard, format->formatId, clipboard->data, &DstSize);
+
+		if (!synthesizer->cached || !pDstData)
+		{
+			if (pDstData)
+				*pSize = DstSize;
+			return pDstData;
+		}
+
+		conversion = (wClipboardConversion*)calloc(1, sizeof(wClipboardConversion));
+		if (!conversion)
+		{
+			free(pDstData);
+			return NULL;
+		}
+
+		conversion->srcFormatId = format->formatId;
+		conversion->dstFormatId = formatId;
+		conversion->data = pDstData;
+		conversion->size = DstSize;
+
+		if (!ArrayList_Append(clipboard->conversions, conversion))
+		{
+			ClipboardConversionFree(conversion);
+			return NULL;
+		}
+	}
+
+	void* pDstData = malloc(conversion->size);
+	if (!pDstData)
+		return NULL;
+
+	CopyMemory(pDstData, conversion->data, conversion->size);
+	*pSize = conversion->size;
+	return pDstData;
+}
+
 void ClipboardLock(wClipboard* clipboard)
 {
 	if (!clipboard)
@@ -160,6 +340,10 @@ BOOL ClipboardEmpty(wClipboard* clipboard)
 	if (!clipboard)
 		return FALSE;
 
+	ArrayList_Clear(clipboard->conversions);
+	clipboard->contentKeyValid = FALSE;
+	clipboard->contentFormatId = 0;
+
 	if (clipboard->data)
 	{
 		free((void*)clipboard->data);
@@ -292,6 +476,22 @@ BOOL ClipboardRegisterSynthesizer(wClipboard* clipboard, UINT32 formatId, UINT32
 
 	synthesizer->syntheticId = syntheticId;
 	synthesizer->pfnSynthesize = pfnSynthesize;
+	synthesizer->cached = TRUE;
+	return TRUE;
+}
+
+BOOL ClipboardRegisterUncachedSynthesizer(wClipboard* clipboard, UINT32 formatId,
+                                          UINT32 syntheticId, CLIPBOARD_SYNTHESIZE_FN pfnSynthesize)
+{
+	if (!ClipboardRegisterSynthesizer(clipboard, formatId, syntheticId, pfnSynthesize))
+		return FALSE;
+
+	wClipboardFormat* format = ClipboardFindFormat(clipboard, formatId, NULL);
+	wClipboardSynthesizer* synthesizer = ClipboardFindSynthesizer(format, syntheticId);
+	if (!synthesizer)
+		return FALSE;
+
+	synthesizer->cached = FALSE;
 	return TRUE;
 }
 
@@ -434,7 +634,6 @@ void* ClipboardGetData(wClipboard* clipboard, UINT32 formatId, UINT32* pSize)
 	void* pSrcData = NULL;
 	void* pDstData = NULL;
 	wClipboardFormat* format = NULL;
-	wClipboardSynthesizer* synthesizer = NULL;
 
 	if (!clipboard)
 		return NULL;
@@ -463,17 +662,7 @@ void* ClipboardGetData(wClipboard* clipboard, UINT32 formatId, UINT32* pSize)
 		*pSize = DstSize;
 	}
 	else
-	{
-		synthesizer = ClipboardFindSynthesizer(format, formatId);
-
-		if (!synthesizer || !synthesizer->pfnSynthesize)
-			return NULL;
-
-		DstSize = SrcSize;
-		pDstData = synthesizer->pfnSynthesize(clipboard, format->formatId, pSrcData, &DstSize);
-		if (pDstData)
-			*pSize = DstSize;
-	}
+		pDstData = ClipboardSynthesize(clipboard, format, formatId, pSize);
 
 	return pDstData;
 }
@@ -490,11 +679,17 @@ BOOL ClipboardSetData(wClipboard* clipboard, UINT32 formatId, const void* data,
 	if (!format)
 		return FALSE;
 
+	/* the cached conversions are kept until the next request shows the content changed */
+	clipboard->contentKeyValid = FALSE;
 	free((void*)clipboard->data);
 	clipboard->data = malloc(size);
 
 	if (!clipboard->data)
+	{
+		ArrayList_Clear(clipboard->conversions);
+		clipboard->contentFormatId = 0;
 		return FALSE;
+	}
 
 	memcpy(clipboard->data, data, size);
 	clipboard->size = size;
@@ -559,6 +754,12 @@ wClipboard* ClipboardCreate(void)
 	if (!InitializeCriticalSectionAndSpinCount(&(clipboard->lock), 4000))
 		goto fail;
 
+	clipboard->conversions = ArrayList_New(FALSE);
+	if (!clipboard->conversions)
+		goto fail;
+
+	ArrayList_Object(clipboard->conversions)->fnObjectFree = ClipboardConversionFree;
+
 	clipboard->numFormats = 0;
 	clipboard->maxFormats = 64;
 	clipboard->formats = (wClipboardFormat*)calloc(clipboard->maxFormats, sizeof(wClipboardFormat));
@@ -582,6 +783,9 @@ void ClipboardDestroy(wClipboard* clipboard)
 	if (!clipboard)
 		return;
 
+	ArrayList_Free(clipboard->conversions);
+	clipboard->conversions = NULL;
+
 	ArrayList_Free(clipboard->localFiles);
 	clipboard->localFiles = NULL;
 
@@ -29,6 +29,7 @@ typedef struct
 {
 	UINT32 syntheticId;
 	CLIPBOARD_SYNTHESIZE_FN pfnSynthesize;
+	BOOL cached; /* free of side effects, the result is kept until the data changes */
 } wClipboardSynthesizer;
 
 typedef struct
@@ -58,6 +59,14 @@ struct s_wClipboard
 	UINT32 formatId;
 	UINT32 sequenceNumber;
 
+	/* synthesized data of the content with the given key */
+
+	wArrayList* conversions;
+	BOOL contentKeyValid; /* cleared when the data is set, computed on the next conversion */
+	UINT64 contentKey[2];
+	UINT32 contentFormatId;
+	UINT32 contentSize;
+
 	/* clipboard file handling */
 
 	wArrayList* localFiles;
@@ -69,6 +78,9 @@ struct s_wClipboard
 };
 
 WINPR_LOCAL BOOL ClipboardInitSynthesizers(wClipboard* clipboard);
+WINPR_LOCAL BOOL ClipboardRegisterUncachedSynthesizer(wClipboard* clipboard, UINT32 formatId,
+                                                      UINT32 syntheticId,
+                                                      CLIPBOARD_SYNTHESIZE_FN pfnSynthesize);
 
 WINPR_LOCAL char* parse_uri_to_local_file(const char* uri, size_t uri_len);
 
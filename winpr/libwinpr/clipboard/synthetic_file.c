@@ -979,28 +979,33 @@ static BOOL register_file_formats_and_synthesizers(wClipboard* clipboard)
 	obj = ArrayList_Object(clipboard->localFiles);
 	obj->fnObjectFree = array_free_synthetic_file;
 
-	if (!ClipboardRegisterSynthesizer(clipboard, local_file_format_id, file_group_format_id,
-	                                  convert_uri_list_to_filedescriptors))
+	/* The conversions update the local file list, run them for every request */
+	if (!ClipboardRegisterUncachedSynthesizer(clipboard, local_file_format_id, file_group_format_id,
+	                                          convert_uri_list_to_filedescriptors))
 		goto error_free_local_files;
 
-	if (!ClipboardRegisterSynthesizer(clipboard, file_group_format_id, local_file_format_id,
-	                                  convert_filedescriptors_to_uri_list))
+	if (!ClipboardRegisterUncachedSynthesizer(clipboard, file_group_format_id, local_file_format_id,
+	                                          convert_filedescriptors_to_uri_list))
 		goto error_free_local_files;
 
-	if (!ClipboardRegisterSynthesizer(clipboard, local_gnome_file_format_id, file_group_format_id,
-	                                  convert_gnome_copied_files_to_filedescriptors))
+	if (!ClipboardRegisterUncachedSynthesizer(clipboard, local_gnome_file_format_id,
+	                                          file_group_format_id,
+	                                          convert_gnome_copied_files_to_filedescriptors))
 		goto error_free_local_files;
 
-	if (!ClipboardRegisterSynthesizer(clipboard, file_group_format_id, local_gnome_file_format_id,
-	                                  convert_filedescriptors_to_gnome_copied_files))
+	if (!ClipboardRegisterUncachedSynthesizer(clipboard, file_group_format_id,
+	                                          local_gnome_file_format_id,
+	                                          convert_filedescriptors_to_gnome_copied_files))
 		goto error_free_local_files;
 
-	if (!ClipboardRegisterSynthesizer(clipboard, local_mate_file_format_id, file_group_format_id,
-	                                  convert_mate_copied_files_to_filedescriptors))
+	if (!ClipboardRegisterUncachedSynthesizer(clipboard, local_mate_file_format_id,
+	                                          file_group_format_id,
+	                                          convert_mate_copied_files_to_filedescriptors))
 		goto error_free_local_files;
 
-	if (!ClipboardRegisterSynthesizer(clipboard, file_group_format_id, local_mate_file_format_id,
-	                                  convert_filedescriptors_to_mate_copied_files))
+	if (!ClipboardRegisterUncachedSynthesizer(clipboard, file_group_format_id,
+	                                          local_mate_file_format_id,
+	                                          convert_filedescriptors_to_mate_copied_files))
 		goto error_free_local_files;
 
 	return TRUE;
@@ -1,7 +1,158 @@
 
+#include <ctype.h>
+
 #include <winpr/crt.h>
 #include <winpr/print.h>
 #include <winpr/clipboard.h>
+#include <winpr/image.h>
+
+static BOOL test_image_conversion(wClipboard* clipboard)
+{
+	BOOL rc = FALSE;
+	const UINT32 width = 33;
+	const UINT32 height = 17;
+	const UINT32 stride = width * 4;
+	const size_t size = sizeof(BITMAPINFOHEADER) + 1ull * stride * height;
+	BYTE* dib = calloc(1, size);
+	BYTE* png1 = NULL;
+	BYTE* png2 = NULL;
+	wImage* image = winpr_image_new();
+
+	if (!dib || !image)
+		goto fail;
+
+	BITMAPINFOHEADER* hdr = (BITMAPINFOHEADER*)dib;
+	hdr->biSize = sizeof(BITMAPINFOHEADER);
+	hdr->biWidth = (LONG)width;
+	hdr->biHeight = (LONG)height;
+	hdr->biPlanes = 1;
+	hdr->biBitCount = 32;
+	hdr->biCompression = BI_RGB;
+	hdr->biSizeImage = stride * height;
+	for (size_t x = sizeof(BITMAPINFOHEADER); x < size; x++)
+		dib[x] = (BYTE)(x * 7);
+
+	const UINT32 pngFormatId = ClipboardRegisterFormat(clipboard, "image/png");
+	if (!ClipboardSetData(clipboard, CF_DIB, dib, (UINT32)size))
+		goto fail;
+
+	if (!winpr_image_format_is_supported(WINPR_IMAGE_PNG))
+	{
+		rc = TRUE;
+		goto fail;
+	}
+
+	/* The second request must return a copy of the cached result */
+	UINT32 size1 = 0;
+	png1 = ClipboardGetData(clipboard, pngFormatId, &size1);
+
+	UINT32 size2 = 0;
+	png2 = ClipboardGetData(clipboard, pngFormatId, &size2);
+	if (!png1 || !png2 || (png1 == png2) || (size1 != size2) || (memcmp(png1, png2, size1) != 0))
+		goto fail;
+
+	if (winpr_image_read_buffer(image, png1, size1) <= 0)
+		goto fail;
+
+	if ((image->width != width) || (image->height != height))
+		goto fail;
+
+	/* New content must not be served from the cache */
+	hdr->biWidth = (LONG)height;
+	hdr->biHeight = (LONG)width;
+	if (!ClipboardSetData(clipboard, CF_DIB, dib, (UINT32)size))
+		goto fail;
+
+	free(png2);
+	png2 = ClipboardGetData(clipboard, pngFormatId, &size2);
+	if (!png2 || (winpr_image_read_buffer(image, png2, size2) <= 0))
+		goto fail;
+
+	if ((image->width != height) || (image->height != width))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	if (!rc)
+		fprintf(stderr, "image conversion failed\n");
+	winpr_image_free(image, TRUE);
+	free(png1);
+	free(png2);
+	free(dib);
+	return rc;
+}
+
+static size_t test_conversions = 0;
+
+static void* test_synthesize_upper(wClipboard* clipboard, UINT32 formatId, const void* data,
+                                   UINT32* pSize)
+{
+	WINPR_UNUSED(clipboard);
+	WINPR_UNUSED(formatId);
+
+	BYTE* dst = malloc(*pSize);
+	if (!dst)
+		return NULL;
+
+	const BYTE* src = data;
+	for (size_t x = 0; x < *pSize; x++)
+		dst[x] = (BYTE)toupper(src[x]);
+	test_conversions++;
+	return dst;
+}
+
+static BOOL test_get_upper(wClipboard* clipboard, UINT32 formatId, const char* expected)
+{
+	UINT32 size = 0;
+	char* data = ClipboardGetData(clipboard, formatId, &size);
+	const BOOL rc = data && (size == strlen(expected)) && (memcmp(data, expected, size) == 0);
+	free(data);
+	return rc;
+}
+
+/* Owners set their data again before every request, the content decides about the cache */
+static BOOL test_conversion_cache(wClipboard* clipboard)
+{
+	const char* lower = "clipboard content";
+	const char* other = "clipboard CONTENT";
+	const UINT32 srcFormatId = ClipboardRegisterFormat(clipboard, "test/lower");
+	const UINT32 dstFormatId = ClipboardRegisterFormat(clipboard, "test/upper");
+
+	if (!srcFormatId || !dstFormatId ||
+	    !ClipboardRegisterSynthesizer(clipboard, srcFormatId, dstFormatId, test_synthesize_upper))
+		return FALSE;
+
+	test_conversions = 0;
+	for (size_t x = 0; x < 3; x++)
+	{
+		if (!ClipboardSetData(clipboard, srcFormatId, lower, (UINT32)strlen(lower)))
+			return FALSE;
+		if (!test_get_upper(clipboard, dstFormatId, "CLIPBOARD CONTENT"))
+			return FALSE;
+	}
+
+	if (test_conversions != 1)
+	{
+		fprintf(stderr, "same content converted %" PRIuz " times\n", test_conversions);
+		return FALSE;
+	}
+
+	/* same size, different bytes */
+	if (!ClipboardSetData(clipboard, srcFormatId, other, (UINT32)strlen(other)) ||
+	    !test_get_upper(clipboard, dstFormatId, "CLIPBOARD CONTENT") || (test_conversions != 2))
+		return FALSE;
+
+	/* back to the first content, only the last one is kept */
+	if (!ClipboardSetData(clipboard, srcFormatId, lower, (UINT32)strlen(lower)) ||
+	    !test_get_upper(clipboard, dstFormatId, "CLIPBOARD CONTENT") || (test_conversions != 3))
+		return FALSE;
+
+	if (!ClipboardEmpty(clipboard) ||
+	    !ClipboardSetData(clipboard, srcFormatId, lower, (UINT32)strlen(lower)) ||
+	    !test_get_upper(clipboard, dstFormatId, "CLIPBOARD CONTENT") || (test_conversions != 4))
+		return FALSE;
+	return TRUE;
+}
 
 int TestClipboardFormats(int argc, char* argv[])
 {
@@ -77,6 +228,20 @@ int TestClipboardFormats(int argc, char* argv[])
 	}
 
 	free(pFormatIds);
+
+	if (!test_image_conversion(clipboard))
+	{
+		ClipboardDestroy(clipboard);
+		return -1;
+	}
+
+	if (!test_conversion_cache(clipboard))
+	{
+		fprintf(stderr, "conversion cache failed\n");
+		ClipboardDestroy(clipboard);
+		return -1;
+	}
+
 	ClipboardDestroy(clipboard);
 	return 0;
 }
@@ -773,6 +773,7 @@ struct png_mem_encode
 {
 	char* buffer;
 	size_t size;
+	size_t capacity;
 };
 
 static void png_write_data(png_structp png_ptr, png_bytep data, png_size_t length)
@@ -780,20 +781,26 @@ static void png_write_data(png_structp png_ptr, png_bytep data, png_size_t lengt
 	/* with libpng15 next line causes pointer deference error; use libpng12 */
 	struct png_mem_encode* p =
 	    (struct png_mem_encode*)png_get_io_ptr(png_ptr); /* was png_ptr->io_ptr */
-	size_t nsize = p->size + length;
+	const size_t nsize = p->size + length;
 
-	/* allocate or grow buffer */
-	if (p->buffer)
-		p->buffer = realloc(p->buffer, nsize);
-	else
-		p->buffer = malloc(nsize);
+	/* grow the buffer geometrically, libpng writes one call per IDAT chunk */
+	if (nsize > p->capacity)
+	{
+		size_t capacity = (p->capacity > 0) ? p->capacity : 4096;
+		while (capacity < nsize)
+			capacity *= 2;
 
-	if (!p->buffer)
-		png_error(png_ptr, "Write Error");
+		char* tmp = realloc(p->buffer, capacity);
+		if (!tmp)
+			png_error(png_ptr, "Write Error");
+
+		p->buffer = tmp;
+		p->capacity = capacity;
+	}
 
 	/* copy new bytes to end of buffer */
 	memcpy(p->buffer + p->size, data, length);
-	p->size += length;
+	p->size = nsize;
 }
 
 /* This is optional but included to show how png_set_write_fn() is called */
@@ -801,13 +808,12 @@ static void png_flush(png_structp png_ptr)
 {
 }
 
-static SSIZE_T save_png_to_buffer(UINT32 bpp, UINT32 width, UINT32 height, const uint8_t* data,
-                                  size_t size, void** pDstData)
+static SSIZE_T save_png_to_buffer(UINT32 bpp, UINT32 width, UINT32 height, UINT32 stride,
+                                  const uint8_t* data, size_t size, void** pDstData)
 {
-	int rc = -1;
+	SSIZE_T rc = -1;
 	png_structp png_ptr = NULL;
 	png_infop info_ptr = NULL;
-	png_byte** row_pointers = NULL;
 	struct png_mem_encode state = { 0 };
 
 	*pDstData = NULL;
@@ -819,7 +825,10 @@ static SSIZE_T save_png_to_buffer(UINT32 bpp, UINT32 width, UINT32 height, const
 
 	const size_t bytes_per_pixel = (bpp + 7) / 8;
 	const size_t bytes_per_row = width * bytes_per_pixel;
-	if (size < bytes_per_row * height)
+	if (stride == 0)
+		stride = bytes_per_row;
+	if ((stride < bytes_per_row) || (height == 0) ||
+	    (size < 1ull * stride * (height - 1) + bytes_per_row))
 		goto fail;
 
 	/* Initialize the write struct. */
@@ -848,37 +857,19 @@ static SSIZE_T save_png_to_buffer(UINT32 bpp, UINT32 width, UINT32 height, const
 	png_set_IHDR(png_ptr, info_ptr, width, height, 8, colorType, PNG_INTERLACE_NONE,
 	             PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
 
-	/* Initialize rows of PNG. */
-	row_pointers = png_malloc(png_ptr, height * sizeof(png_byte*));
-	for (size_t y = 0; y < height; ++y)
-	{
-		uint8_t* row = png_malloc(png_ptr, sizeof(uint8_t) * bytes_per_row);
-		row_pointers[y] = (png_byte*)row;
-		for (size_t x = 0; x < width; ++x)
-		{
-
-			*row++ = *data++;
-			if (bpp > 8)
-				*row++ = *data++;
-			if (bpp > 16)
-				*row++ = *data++;
-			if (bpp > 24)
-				*row++ = *data++;
-		}
-	}
-
-	/* Actually write the image data. */
+	/* Encode the source rows in a single pass, libpng swaps BGR to RGB in its
+	 * own row buffer so no intermediate copy of the image is required. */
 	png_set_write_fn(png_ptr, &state, png_write_data, png_flush);
-	png_set_rows(png_ptr, info_ptr, row_pointers);
-	png_write_png(png_ptr, info_ptr, PNG_TRANSFORM_BGR, NULL);
+	png_write_info(png_ptr, info_ptr);
+	png_set_bgr(png_ptr);
 
-	/* Cleanup. */
 	for (size_t y = 0; y < height; y++)
-		png_free(png_ptr, row_pointers[y]);
-	png_free(png_ptr, row_pointers);
+		png_write_row(png_ptr, &data[y * stride]);
+
+	png_write_end(png_ptr, info_ptr);
 
 	/* Finish writing. */
-	rc = state.size;
+	rc = (SSIZE_T)state.size;
 	*pDstData = state.buffer;
 fail:
 	png_destroy_write_struct(&png_ptr, &info_ptr);
@@ -981,7 +972,7 @@ static void* winpr_convert_to_png(const void* data, size_t size, UINT32 width, U
 
 #if defined(WINPR_UTILS_IMAGE_PNG)
 	void* dst = NULL;
-	SSIZE_T rc = save_png_to_buffer(bpp, width, height, data, size, &dst);
+	SSIZE_T rc = save_png_to_buffer(bpp, width, height, stride, data, size, &dst);
 	if (rc <= 0)
 		return NULL;
 	*pSize = (UINT32)rc;